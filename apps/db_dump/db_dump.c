@@ -107,25 +107,10 @@ static void free__base_msg(struct P_base_msg *chunk)
 }
 
 
-static int dump__cfg_chunk_process(FILE *db_fd, uint32_t length)
+static int dump__cfg_process(struct PF_cfg *chunk, uint32_t length)
 {
-	struct PF_cfg chunk;
-	int rc;
-
 	cfg_count++;
 
-	memset(&chunk, 0, sizeof(struct PF_cfg));
-
-	if(db_version == 6 || db_version == 5){
-		rc = persist__chunk_cfg_read_v56(db_fd, &chunk);
-	}else{
-		rc = persist__chunk_cfg_read_v234(db_fd, &chunk);
-	}
-	if(rc){
-		fprintf(stderr, "Error: Corrupt persistent database.\n");
-		return rc;
-	}
-
 	if(do_print){
 		printf("DB_CHUNK_CFG:\n");
 	}
@@ -133,94 +118,109 @@ static int dump__cfg_chunk_process(FILE *db_fd, uint32_t length)
 		printf("\tLength: %d\n", length);
 	}
 	if(do_print){
-		printf("\tShutdown: %d\n", chunk.shutdown);
+		printf("\tShutdown: %d\n", chunk->shutdown);
 	}
 	if(do_print){
-		printf("\tDB ID size: %d\n", chunk.dbid_size);
+		printf("\tDB ID size: %d\n", chunk->dbid_size);
 	}
-	if(chunk.dbid_size != sizeof(dbid_t)){
+	if(chunk->dbid_size != sizeof(dbid_t)){
 		fprintf(stderr, "Error: Incompatible database configuration (dbid size is %d bytes, expected %zu)",
-				chunk.dbid_size, sizeof(dbid_t));
+				chunk->dbid_size, sizeof(dbid_t));
 		return MOSQ_ERR_INVAL;
 	}
 	if(do_print){
-		printf("\tLast DB ID: %" PRIu64 "\n", chunk.last_db_id);
+		printf("\tLast DB ID: %" PRIu64 "\n", chunk->last_db_id);
 	}
 
 	return 0;
 }
 
 
-static int dump__client_chunk_process(FILE *db_fd, uint32_t length)
+static int dump__cfg_chunk_process(FILE *db_fd, uint32_t length)
 {
-	struct P_client chunk;
-	int rc = 0;
-	struct client_data *cc = NULL;
-
-	client_count++;
+	struct PF_cfg chunk;
+	int rc;
 
-	memset(&chunk, 0, sizeof(struct P_client));
+	memset(&chunk, 0, sizeof(struct PF_cfg));
 
 	if(db_version == 6 || db_version == 5){
-		rc = persist__chunk_client_read_v56(db_fd, &chunk, db_version);
+		rc = persist__chunk_cfg_read_v56(db_fd, &chunk);
 	}else{
-		rc = persist__chunk_client_read_v234(db_fd, &chunk, db_version);
+		rc = persist__chunk_cfg_read_v234(db_fd, &chunk);
 	}
 	if(rc){
 		fprintf(stderr, "Error: Corrupt persistent database.\n");
 		return rc;
 	}
 
-	if(client_stats && chunk.clientid){
+	return dump__cfg_process(&chunk, length);
+}
+
+
+static int dump__client_process(struct P_client *chunk, uint32_t length)
+{
+	struct client_data *cc = NULL;
+
+	client_count++;
+
+	if(client_stats && chunk->clientid){
 		cc = calloc(1, sizeof(struct client_data));
 		if(!cc){
 			fprintf(stderr, "Error: Out of memory.\n");
-			free(chunk.clientid);
+			free(chunk->clientid);
 			return MOSQ_ERR_NOMEM;
 		}
-		cc->id = strdup(chunk.clientid);
+		cc->id = strdup(chunk->clientid);
 		HASH_ADD_KEYPTR(hh_id, clients_by_id, cc->id, strlen(cc->id), cc);
 	}
 
 	if(do_json){
-		json_add_client(&chunk);
+		json_add_client(chunk);
 	}
 	if(do_print){
-		print__client(&chunk, length);
+		print__client(chunk, length);
 	}
-	free__client(&chunk);
+	free__client(chunk);
 
 	return 0;
 }
 
 
-static int dump__client_msg_chunk_process(FILE *db_fd, uint32_t length)
+static int dump__client_chunk_process(FILE *db_fd, uint32_t length)
 {
-	struct P_client_msg chunk;
-	struct client_data *cc;
-	struct base_msg_chunk *msc;
+	struct P_client chunk;
 	int rc;
 
-	client_msg_count++;
+	memset(&chunk, 0, sizeof(struct P_client));
 
-	memset(&chunk, 0, sizeof(struct P_client_msg));
 	if(db_version == 6 || db_version == 5){
-		rc = persist__chunk_client_msg_read_v56(db_fd, &chunk, length);
+		rc = persist__chunk_client_read_v56(db_fd, &chunk, db_version);
 	}else{
-		rc = persist__chunk_client_msg_read_v234(db_fd, &chunk);
+		rc = persist__chunk_client_read_v234(db_fd, &chunk, db_version);
 	}
 	if(rc){
 		fprintf(stderr, "Error: Corrupt persistent database.\n");
 		return rc;
 	}
 
-	if(client_stats && chunk.clientid){
-		HASH_FIND(hh_id, clients_by_id, chunk.clientid, strlen(chunk.clientid), cc);
+	return dump__client_process(&chunk, length);
+}
+
+
+static int dump__client_msg_process(struct P_client_msg *chunk, uint32_t length)
+{
+	struct client_data *cc;
+	struct base_msg_chunk *msc;
+
+	client_msg_count++;
+
+	if(client_stats && chunk->clientid){
+		HASH_FIND(hh_id, clients_by_id, chunk->clientid, strlen(chunk->clientid), cc);
 		if(cc){
 			cc->messages++;
 			cc->message_size += length;
 
-			HASH_FIND(hh, msgs_by_id, &chunk.F.store_id, sizeof(dbid_t), msc);
+			HASH_FIND(hh, msgs_by_id, &chunk->F.store_id, sizeof(dbid_t), msc);
 			if(msc){
 				cc->message_size += msc->length;
 			}
@@ -228,40 +228,48 @@ static int dump__client_msg_chunk_process(FILE *db_fd, uint32_t length)
 	}
 
 	if(do_json){
-		json_add_client_msg(&chunk);
+		json_add_client_msg(chunk);
 	}
 	if(do_print){
-		print__client_msg(&chunk, length);
+		print__client_msg(chunk, length);
 	}
-	free__client_msg(&chunk);
+	free__client_msg(chunk);
 	return 0;
 }
 
 
-static int dump__base_msg_chunk_process(FILE *db_fptr, uint32_t length)
+static int dump__client_msg_chunk_process(FILE *db_fd, uint32_t length)
 {
-	struct P_base_msg chunk;
-	struct mosquitto__base_msg *stored = NULL;
-	int64_t message_expiry_interval64;
-	uint32_t message_expiry_interval;
-	int rc = 0;
-	struct base_msg_chunk *mcs;
-
-	base_msg_count++;
+	struct P_client_msg chunk;
+	int rc;
 
-	memset(&chunk, 0, sizeof(struct P_base_msg));
+	memset(&chunk, 0, sizeof(struct P_client_msg));
 	if(db_version == 6 || db_version == 5){
-		rc = persist__chunk_base_msg_read_v56(db_fptr, &chunk, length);
+		rc = persist__chunk_client_msg_read_v56(db_fd, &chunk, length);
 	}else{
-		rc = persist__chunk_base_msg_read_v234(db_fptr, &chunk, db_version);
+		rc = persist__chunk_client_msg_read_v234(db_fd, &chunk);
 	}
 	if(rc){
 		fprintf(stderr, "Error: Corrupt persistent database.\n");
 		return rc;
 	}
 
-	if(chunk.F.expiry_time > 0){
-		message_expiry_interval64 = chunk.F.expiry_time - time(NULL);
+	return dump__client_msg_process(&chunk, length);
+}
+
+
+static int dump__base_msg_process(struct P_base_msg *chunk, uint32_t length)
+{
+	struct mosquitto__base_msg *stored = NULL;
+	int64_t message_expiry_interval64;
+	uint32_t message_expiry_interval;
+	int rc = 0;
+	struct base_msg_chunk *mcs;
+
+	base_msg_count++;
+
+	if(chunk->F.expiry_time > 0){
+		message_expiry_interval64 = chunk->F.expiry_time - time(NULL);
 		if(message_expiry_interval64 < 0 || message_expiry_interval64 > UINT32_MAX){
 			message_expiry_interval = 0;
 		}else{
@@ -274,36 +282,36 @@ static int dump__base_msg_chunk_process(FILE *db_fptr, uint32_t length)
 	stored = mosquitto_calloc(1, sizeof(struct mosquitto__base_msg));
 	if(stored == NULL){
 		fprintf(stderr, "Error: Out of memory.\n");
-		mosquitto_free(chunk.source.id);
-		mosquitto_free(chunk.source.username);
-		mosquitto_free(chunk.topic);
-		mosquitto_free(chunk.payload);
+		mosquitto_free(chunk->source.id);
+		mosquitto_free(chunk->source.username);
+		mosquitto_free(chunk->topic);
+		mosquitto_free(chunk->payload);
 		return MOSQ_ERR_NOMEM;
 	}
-	stored->data.store_id = chunk.F.store_id;
-	stored->data.source_mid = chunk.F.source_mid;
-	stored->data.topic = chunk.topic;
-	stored->data.qos = chunk.F.qos;
-	stored->data.retain = chunk.F.retain;
-	stored->data.payloadlen = chunk.F.payloadlen;
-	stored->data.payload =  chunk.payload;
-	stored->data.properties = chunk.properties;
+	stored->data.store_id = chunk->F.store_id;
+	stored->data.source_mid = chunk->F.source_mid;
+	stored->data.topic = chunk->topic;
+	stored->data.qos = chunk->F.qos;
+	stored->data.retain = chunk->F.retain;
+	stored->data.payloadlen = chunk->F.payloadlen;
+	stored->data.payload =  chunk->payload;
+	stored->data.properties = chunk->properties;
 
-	rc = db__message_store(&chunk.source, stored, &message_expiry_interval,
+	rc = db__message_store(&chunk->source, stored, &message_expiry_interval,
 			mosq_mo_client);
 
 	if(do_json){
-		json_add_base_msg(&chunk);
+		json_add_base_msg(chunk);
 	}
 
-	mosquitto_free(chunk.source.id);
-	mosquitto_free(chunk.source.username);
-	chunk.source.id = NULL;
-	chunk.source.username = NULL;
+	mosquitto_free(chunk->source.id);
+	mosquitto_free(chunk->source.username);
+	chunk->source.id = NULL;
+	chunk->source.username = NULL;
 
 	if(rc == MOSQ_ERR_SUCCESS){
-		stored->source_listener = chunk.source.listener;
-		stored->data.store_id = chunk.F.store_id;
+		stored->source_listener = chunk->source.listener;
+		stored->data.store_id = chunk->F.store_id;
 
 		HASH_ADD(hh, db.msg_store, data.store_id, sizeof(dbid_t), stored);
 	}else{
@@ -317,25 +325,42 @@ static int dump__base_msg_chunk_process(FILE *db_fptr, uint32_t length)
 			fprintf(stderr, "Error: Out of memory.\n");
 			return MOSQ_ERR_NOMEM;
 		}
-		mcs->store_id = chunk.F.store_id;
+		mcs->store_id = chunk->F.store_id;
 		mcs->length = length;
 		HASH_ADD(hh, msgs_by_id, store_id, sizeof(dbid_t), mcs);
 	}
 
 	if(do_print){
-		print__base_msg(&chunk, length);
+		print__base_msg(chunk, length);
 	}
-	free__base_msg(&chunk);
+	free__base_msg(chunk);
 
 	return 0;
 }
 
 
-static int dump__retain_chunk_process(FILE *db_fd, uint32_t length)
+static int dump__base_msg_chunk_process(FILE *db_fptr, uint32_t length)
 {
-	struct P_retain chunk;
+	struct P_base_msg chunk;
 	int rc;
 
+	memset(&chunk, 0, sizeof(struct P_base_msg));
+	if(db_version == 6 || db_version == 5){
+		rc = persist__chunk_base_msg_read_v56(db_fptr, &chunk, length);
+	}else{
+		rc = persist__chunk_base_msg_read_v234(db_fptr, &chunk, db_version);
+	}
+	if(rc){
+		fprintf(stderr, "Error: Corrupt persistent database.\n");
+		return rc;
+	}
+
+	return dump__base_msg_process(&chunk, length);
+}
+
+
+static int dump__retain_process(struct P_retain *chunk, uint32_t length)
+{
 	retain_count++;
 	if(do_print){
 		printf("DB_CHUNK_RETAIN:\n");
@@ -344,6 +369,22 @@ static int dump__retain_chunk_process(FILE *db_fd, uint32_t length)
 		printf("\tLength: %d\n", length);
 	}
 
+	if(do_json){
+		json_add_retained_msg(chunk);
+	}
+
+	if(do_print){
+		printf("\tStore ID: %" PRIu64 "\n", chunk->F.store_id);
+	}
+	return 0;
+}
+
+
+static int dump__retain_chunk_process(FILE *db_fd, uint32_t length)
+{
+	struct P_retain chunk;
+	int rc;
+
 	if(db_version == 6 || db_version == 5){
 		rc = persist__chunk_retain_read_v56(db_fd, &chunk);
 	}else{
@@ -354,24 +395,40 @@ static int dump__retain_chunk_process(FILE *db_fd, uint32_t length)
 		return rc;
 	}
 
-	if(do_json){
-		json_add_retained_msg(&chunk);
+	return dump__retain_process(&chunk, length);
+}
+
+
+static int dump__sub_process(struct P_sub *chunk, uint32_t length)
+{
+	struct client_data *cc;
+
+	sub_count++;
+
+	if(client_stats && chunk->clientid){
+		HASH_FIND(hh_id, clients_by_id, chunk->clientid, strlen(chunk->clientid), cc);
+		if(cc){
+			cc->subscriptions++;
+			cc->subscription_size += length;
+		}
 	}
 
+	if(do_json){
+		json_add_subscription(chunk);
+	}
 	if(do_print){
-		printf("\tStore ID: %" PRIu64 "\n", chunk.F.store_id);
+		print__sub(chunk, length);
 	}
+	free__sub(chunk);
+
 	return 0;
 }
 
 
 static int dump__sub_chunk_process(FILE *db_fd, uint32_t length)
 {
-	int rc = 0;
 	struct P_sub chunk;
-	struct client_data *cc;
-
-	sub_count++;
+	int rc;
 
 	memset(&chunk, 0, sizeof(struct P_sub));
 	if(db_version == 6 || db_version == 5){
@@ -384,23 +441,147 @@ static int dump__sub_chunk_process(FILE *db_fd, uint32_t length)
 		return rc;
 	}
 
-	if(client_stats && chunk.clientid){
-		HASH_FIND(hh_id, clients_by_id, chunk.clientid, strlen(chunk.clientid), cc);
-		if(cc){
-			cc->subscriptions++;
-			cc->subscription_size += length;
+	return dump__sub_process(&chunk, length);
+}
+
+
+/* v7 files carry a directory of record tables, so the counts used by --stats
+ * are available without parsing any records. The "length" reported for each
+ * entry is its record size plus the heap bytes it references. */
+static int dump__v7(FILE *db_fd)
+{
+	struct persist__v7 v7;
+	uint64_t count;
+	int rc;
+
+	rc = persist__v7_open(db_fd, &v7);
+	if(rc){
+		fprintf(stderr, "Error: Corrupt persistent database.\n");
+		return rc;
+	}
+
+	if(stats){
+		cfg_count = (long)persist__v7_count(&v7, DB_CHUNK_CFG);
+		base_msg_count = (long)persist__v7_count(&v7, DB_CHUNK_BASE_MSG);
+		client_msg_count = (long)persist__v7_count(&v7, DB_CHUNK_CLIENT_MSG);
+		retain_count = (long)persist__v7_count(&v7, DB_CHUNK_RETAIN);
+		sub_count = (long)persist__v7_count(&v7, DB_CHUNK_SUB);
+		client_count = (long)persist__v7_count(&v7, DB_CHUNK_CLIENT);
+		persist__v7_close(&v7);
+		return 0;
+	}
+
+	if(persist__v7_count(&v7, DB_CHUNK_CFG) > 0){
+		struct PF_cfg chunk;
+
+		rc = persist__chunk_cfg_read_v7(&v7, &chunk);
+		if(rc){
+			goto corrupt;
+		}
+		rc = dump__cfg_process(&chunk, v7.sections[DB_CHUNK_CFG].record_size);
+		if(rc){
+			goto error;
 		}
 	}
 
-	if(do_json){
-		json_add_subscription(&chunk);
+	count = persist__v7_count(&v7, DB_CHUNK_BASE_MSG);
+	for(uint64_t i=0; i<count; i++){
+		struct P_base_msg chunk;
+		uint32_t length;
+
+		memset(&chunk, 0, sizeof(struct P_base_msg));
+		/* Payloads are only needed for output, not for client stats */
+		rc = persist__chunk_base_msg_read_v7(&v7, i, &chunk, do_print || do_json);
+		if(rc){
+			goto corrupt;
+		}
+		length = v7.sections[DB_CHUNK_BASE_MSG].record_size
+				+ chunk.F.source_id_len + chunk.F.source_username_len + chunk.F.topic_len
+				+ chunk.F.payloadlen;
+		rc = dump__base_msg_process(&chunk, length);
+		if(rc){
+			goto error;
+		}
 	}
-	if(do_print){
-		print__sub(&chunk, length);
+
+	count = persist__v7_count(&v7, DB_CHUNK_CLIENT);
+	for(uint64_t i=0; i<count; i++){
+		struct P_client chunk;
+		uint32_t length;
+
+		memset(&chunk, 0, sizeof(struct P_client));
+		rc = persist__chunk_client_read_v7(&v7, i, &chunk);
+		if(rc < 0){
+			fprintf(stderr, "Warning: Empty client entry found in persistent database file.\n");
+			continue;
+		}else if(rc){
+			goto corrupt;
+		}
+		length = v7.sections[DB_CHUNK_CLIENT].record_size
+				+ chunk.F.id_len + chunk.F.username_len;
+		rc = dump__client_process(&chunk, length);
+		if(rc){
+			goto error;
+		}
+	}
+
+	count = persist__v7_count(&v7, DB_CHUNK_CLIENT_MSG);
+	for(uint64_t i=0; i<count; i++){
+		struct P_client_msg chunk;
+		uint32_t length;
+
+		memset(&chunk, 0, sizeof(struct P_client_msg));
+		rc = persist__chunk_client_msg_read_v7(&v7, i, &chunk);
+		if(rc){
+			goto corrupt;
+		}
+		length = v7.sections[DB_CHUNK_CLIENT_MSG].record_size + chunk.F.id_len;
+		rc = dump__client_msg_process(&chunk, length);
+		if(rc){
+			goto error;
+		}
+	}
+
+	count = persist__v7_count(&v7, DB_CHUNK_SUB);
+	for(uint64_t i=0; i<count; i++){
+		struct P_sub chunk;
+		uint32_t length;
+
+		memset(&chunk, 0, sizeof(struct P_sub));
+		rc = persist__chunk_sub_read_v7(&v7, i, &chunk);
+		if(rc){
+			goto corrupt;
+		}
+		length = v7.sections[DB_CHUNK_SUB].record_size
+				+ chunk.F.id_len + chunk.F.topic_len;
+		rc = dump__sub_process(&chunk, length);
+		if(rc){
+			goto error;
+		}
+	}
+
+	count = persist__v7_count(&v7, DB_CHUNK_RETAIN);
+	for(uint64_t i=0; i<count; i++){
+		struct P_retain chunk;
+
+		memset(&chunk, 0, sizeof(struct P_retain));
+		rc = persist__chunk_retain_read_v7(&v7, i, &chunk);
+		if(rc){
+			goto corrupt;
+		}
+		rc = dump__retain_process(&chunk, v7.sections[DB_CHUNK_RETAIN].record_size);
+		if(rc){
+			goto error;
+		}
 	}
-	free__sub(&chunk);
 
+	persist__v7_close(&v7);
 	return 0;
+corrupt:
+	fprintf(stderr, "Error: Corrupt persistent database.\n");
+error:
+	persist__v7_close(&v7);
+	return rc;
 }
 
 
@@ -515,7 +696,13 @@ int main(int argc, char *argv[])
 			}
 		}
 
-		while(persist__chunk_header_read(fd, &chunk, &length) == MOSQ_ERR_SUCCESS){
+		if(db_version == 7){
+			if(dump__v7(fd)){
+				goto error;
+			}
+		}
+
+		while(db_version != 7 && persist__chunk_header_read(fd, &chunk, &length) == MOSQ_ERR_SUCCESS){
 			switch(chunk){
 				case DB_CHUNK_CFG:
 					if(dump__cfg_chunk_process(fd, length)){
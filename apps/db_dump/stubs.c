@@ -67,3 +67,25 @@ int session_expiry__add_from_persistence(struct mosquitto *context, time_t expir
 {
 	UNUSED(context); UNUSED(expiry_time); return 0;
 }
+
+
+void retain__dirty_clear(void)
+{
+}
+
+
+int mosquitto_persist_retain_msg_delete(const char *topic)
+{
+	UNUSED(topic); return 0;
+}
+
+
+void persist__retain_log_compact_next(void)
+{
+}
+
+
+void persist__retain_log_restored(unsigned long records, unsigned long live)
+{
+	UNUSED(records); UNUSED(live);
+}
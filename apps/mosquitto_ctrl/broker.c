@@ -36,6 +36,7 @@ void broker__print_usage(void)
 
 	printf("List plugins    :          listPlugins\n");
 	printf("List listeners  :          listListeners\n");
+	printf("Plugin stats    :          getPluginStats\n");
 }
 
 
@@ -139,6 +140,70 @@ static void print_plugin_info(cJSON *j_response)
 }
 
 
+static double json_get_us(cJSON *j_event, const char *name)
+{
+	cJSON *jtmp = cJSON_GetObjectItem(j_event, name);
+
+	if(jtmp && cJSON_IsNumber(jtmp)){
+		return jtmp->valuedouble/1000.0;
+	}
+	return 0.0;
+}
+
+
+static void print_plugin_stats(cJSON *j_response)
+{
+	cJSON *j_data, *j_plugins, *j_plugin, *j_events, *j_event, *jtmp;
+	const char *stmp;
+	double count;
+
+	j_data = cJSON_GetObjectItem(j_response, "data");
+	if(j_data == NULL || !cJSON_IsObject(j_data)){
+		fprintf(stderr, "Error: Invalid response from server.\n");
+		return;
+	}
+
+	j_plugins = cJSON_GetObjectItem(j_data, "plugins");
+	if(j_plugins == NULL || !cJSON_IsArray(j_plugins)){
+		fprintf(stderr, "Error: Invalid response from server.\n");
+		return;
+	}
+
+	cJSON_ArrayForEach(j_plugin, j_plugins){
+		if(json_get_string(j_plugin, "name", &stmp, false) != MOSQ_ERR_SUCCESS){
+			fprintf(stderr, "Error: Invalid response from server.\n");
+			return;
+		}
+		printf("Plugin: %s\n", stmp);
+
+		j_events = cJSON_GetObjectItem(j_plugin, "events");
+		if(j_events == NULL || !cJSON_IsArray(j_events) || cJSON_GetArraySize(j_events) == 0){
+			printf("\n");
+			continue;
+		}
+		printf("  %-26s %10s %10s %10s %10s %10s %10s\n",
+				"Event", "Count", "Mean (us)", "p50 (us)", "p90 (us)", "p99 (us)", "Max (us)");
+
+		cJSON_ArrayForEach(j_event, j_events){
+			if(json_get_string(j_event, "event", &stmp, false) != MOSQ_ERR_SUCCESS){
+				continue;
+			}
+			jtmp = cJSON_GetObjectItem(j_event, "count");
+			count = (jtmp && cJSON_IsNumber(jtmp))?jtmp->valuedouble:0.0;
+
+			printf("  %-26s %10.0f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+					stmp, count,
+					count > 0.0?json_get_us(j_event, "total-ns")/count:0.0,
+					json_get_us(j_event, "p50-ns"),
+					json_get_us(j_event, "p90-ns"),
+					json_get_us(j_event, "p99-ns"),
+					json_get_us(j_event, "max-ns"));
+		}
+		printf("\n");
+	}
+}
+
+
 static void broker__payload_callback(struct mosq_ctrl *ctrl, long payloadlen, const void *payload)
 {
 	cJSON *tree, *j_responses, *j_response, *j_command;
@@ -185,6 +250,8 @@ static void broker__payload_callback(struct mosq_ctrl *ctrl, long payloadlen, co
 			print_plugin_info(j_response);
 		}else if(!strcasecmp(j_command->valuestring, "listListeners")){
 			print_listeners(j_response);
+		}else if(!strcasecmp(j_command->valuestring, "getPluginStats")){
+			print_plugin_stats(j_response);
 		}else{
 			/* fprintf(stderr, "%s: Success\n", j_command->valuestring); */
 		}
@@ -223,6 +290,21 @@ static int broker__list_listeners(int argc, char *argv[], cJSON *j_command)
 }
 
 
+static int broker__get_plugin_stats(int argc, char *argv[], cJSON *j_command)
+{
+	UNUSED(argc);
+	UNUSED(argv);
+
+	if(cJSON_AddStringToObject(j_command, "command", "getPluginStats") == NULL
+			){
+
+		return MOSQ_ERR_NOMEM;
+	}
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
 /* ################################################################
  * #
  * # Main
@@ -271,6 +353,8 @@ int broker__main(int argc, char *argv[], struct mosq_ctrl *ctrl)
 		rc = broker__list_plugins(argc-1, &argv[1], j_command);
 	}else if(!strcasecmp(argv[0], "listListeners")){
 		rc = broker__list_listeners(argc-1, &argv[1], j_command);
+	}else if(!strcasecmp(argv[0], "getPluginStats")){
+		rc = broker__get_plugin_stats(argc-1, &argv[1], j_command);
 
 	}else{
 		fprintf(stderr, "Command '%s' not recognised.\n", argv[0]);
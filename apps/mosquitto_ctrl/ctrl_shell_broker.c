@@ -47,6 +47,7 @@ static void command_tree_create(void)
 
 	completion_tree_cmd_add(commands_broker, help_arg_list, "listPlugins");
 	completion_tree_cmd_add(commands_broker, help_arg_list, "listListeners");
+	completion_tree_cmd_add(commands_broker, help_arg_list, "getPluginStats");
 	completion_tree_cmd_add(commands_broker, help_arg_list, "disconnect");
 	completion_tree_cmd_add(commands_broker, help_arg_list, "return");
 	completion_tree_cmd_add(commands_broker, help_arg_list, "exit");
@@ -63,6 +64,9 @@ static void print_help(char **saveptr)
 		}else if(!strcasecmp(command, "listListeners")){
 			ctrl_shell_print_help_command("listListeners");
 			ctrl_shell_printf("\nLists current listeners.\n");
+		}else if(!strcasecmp(command, "getPluginStats")){
+			ctrl_shell_print_help_command("getPluginStats");
+			ctrl_shell_printf("\nShows call counts and call times for each plugin event.\n");
 		}else{
 			ctrl_shell_print_help_final(command, "broker");
 		}
@@ -103,6 +107,8 @@ static void line_callback(char *line)
 		ctrl_shell_command_generic_arg0("listPlugins");
 	}else if(!strcasecmp(command, "listListeners")){
 		ctrl_shell_command_generic_arg0("listListeners");
+	}else if(!strcasecmp(command, "getPluginStats")){
+		ctrl_shell_command_generic_arg0("getPluginStats");
 	}else if(!strcasecmp(command, "help")){
 		print_help(&saveptr);
 	}else{
@@ -175,12 +181,54 @@ static void print_listeners(cJSON *j_data)
 }
 
 
+static void print_plugin_stats(cJSON *j_data)
+{
+	cJSON *j_plugins, *j_plugin, *j_events, *j_event;
+
+	j_plugins = cJSON_GetObjectItem(j_data, "plugins");
+
+	cJSON_ArrayForEach(j_plugin, j_plugins){
+		const char *name;
+		if(json_get_string(j_plugin, "name", &name, false) != MOSQ_ERR_SUCCESS){
+			ctrl_shell_printf("Invalid response from broker.\n");
+			return;
+		}
+
+		ctrl_shell_print_label(0, "Plugin:");
+		ctrl_shell_print_value(1, "%s\n", name);
+
+		j_events = cJSON_GetObjectItem(j_plugin, "events");
+		cJSON_ArrayForEach(j_event, j_events){
+			const char *event;
+			int64_t count, p50, p99, max;
+
+			if(json_get_string(j_event, "event", &event, false) != MOSQ_ERR_SUCCESS
+					|| json_get_int64(j_event, "count", &count, false, 0) != MOSQ_ERR_SUCCESS
+					|| json_get_int64(j_event, "p50-ns", &p50, false, 0) != MOSQ_ERR_SUCCESS
+					|| json_get_int64(j_event, "p99-ns", &p99, false, 0) != MOSQ_ERR_SUCCESS
+					|| json_get_int64(j_event, "max-ns", &max, false, 0) != MOSQ_ERR_SUCCESS){
+
+				ctrl_shell_printf("Invalid response from broker.\n");
+				return;
+			}
+
+			ctrl_shell_print_label(1, event);
+			ctrl_shell_print_value(2, "%ld calls, p50 %.1fus, p99 %.1fus, max %.1fus\n",
+					(long)count, (double)p50/1000.0, (double)p99/1000.0, (double)max/1000.0);
+		}
+		ctrl_shell_print_value(0, "\n");
+	}
+}
+
+
 static void handle_response(const char *command, cJSON *j_data, const char *payload)
 {
 	if(!strcmp(command, "listPlugins")){
 		print_plugins(j_data);
 	}else if(!strcmp(command, "listListeners")){
 		print_listeners(j_data);
+	}else if(!strcmp(command, "getPluginStats")){
+		print_plugin_stats(j_data);
 	}else{
 		ctrl_shell_printf("%s %s\n", command, payload);
 	}
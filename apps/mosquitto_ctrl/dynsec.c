@@ -66,6 +66,13 @@ void dynsec__print_usage(void)
 	printf("List all clients:            listClients       [count [offset]]\n");
 	printf("Enable client:               enableClient      <username>\n");
 	printf("Disable client:              disableClient     <username>\n");
+	printf("Create clients from stdin:   createClients\n");
+	printf("    One client per line, either CSV: <username>,[password],[clientid]\n");
+	printf("    or a JSON object as used by the createClient API command.\n");
+	printf("Set client roles from stdin: setClientRolesBulk\n");
+	printf("    One role per line as CSV: <username>,[rolename],[priority]\n");
+	printf("    Lines for the same client must be together. Each client's roles are\n");
+	printf("    replaced, a client with no rolename has all of its roles removed.\n");
 
 	printf("\nGroups\n------\n");
 	printf("Create a new group:          createGroup       <groupname>\n");
@@ -76,6 +83,8 @@ void dynsec__print_usage(void)
 	printf("Add client to a group:       addGroupClient    <groupname> <username> [priority]\n");
 	printf("    Priority sets the group priority for the given client only.\n");
 	printf("    Higher priority (larger numerical value) groups are evaluated first.\n");
+	printf("Add clients from stdin:      addGroupClients   <groupname>\n");
+	printf("    One client per line as CSV: <username>,[priority]\n");
 	printf("Remove client from a group:  removeGroupClient <groupname> <username>\n");
 	printf("Get group information:       getGroup          <groupname>\n");
 	printf("List all groups:             listGroups        [count [offset]]\n");
@@ -92,6 +101,9 @@ void dynsec__print_usage(void)
 	printf("acltype:                     publishClientSend|publishClientReceive\n");
 	printf("                              |subscribeLiteral|subscribePattern\n");
 	printf("                              |unsubscribeLiteral|unsubscribePattern\n");
+	printf("\nThe commands that read from stdin also accept a JSON object per line, and\n");
+	printf("ignore empty lines and lines starting with '#'. Each is sent as a single\n");
+	printf("command that is applied completely or not at all.\n");
 	printf("\nFor more information see:\n");
 	printf("    https://mosquitto.org/documentation/dynamic-security/\n\n");
 }
@@ -835,6 +847,10 @@ int dynsec__main(int argc, char *argv[], struct mosq_ctrl *ctrl)
 		rc = dynsec_client__enable_disable(argc-1, &argv[1], j_command, argv[0]);
 	}else if(!strcasecmp(argv[0], "disableClient")){
 		rc = dynsec_client__enable_disable(argc-1, &argv[1], j_command, argv[0]);
+	}else if(!strcasecmp(argv[0], "createClients")){
+		rc = dynsec_bulk__create_clients(argc-1, &argv[1], j_command);
+	}else if(!strcasecmp(argv[0], "setClientRolesBulk")){
+		rc = dynsec_bulk__set_client_roles(argc-1, &argv[1], j_command);
 
 	}else if(!strcasecmp(argv[0], "createGroup")){
 		rc = dynsec_group__create(argc-1, &argv[1], j_command);
@@ -850,6 +866,8 @@ int dynsec__main(int argc, char *argv[], struct mosq_ctrl *ctrl)
 		rc = dynsec_group__add_remove_role(argc-1, &argv[1], j_command, argv[0]);
 	}else if(!strcasecmp(argv[0], "addGroupClient")){
 		rc = dynsec_group__add_remove_client(argc-1, &argv[1], j_command, argv[0]);
+	}else if(!strcasecmp(argv[0], "addGroupClients")){
+		rc = dynsec_bulk__add_group_clients(argc-1, &argv[1], j_command);
 	}else if(!strcasecmp(argv[0], "removeGroupClient")){
 		rc = dynsec_group__add_remove_client(argc-1, &argv[1], j_command, argv[0]);
 	}else if(!strcasecmp(argv[0], "setAnonymousGroup")){
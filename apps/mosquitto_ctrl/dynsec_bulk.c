@@ -0,0 +1,328 @@
+/*
+Copyright (c) 2026 Roger Light <roger@atchoo.org>
+
+All rights reserved. This program and the accompanying materials
+are made available under the terms of the Eclipse Public License 2.0
+and Eclipse Distribution License v1.0 which accompany this distribution.
+
+The Eclipse Public License is available at
+   https://www.eclipse.org/legal/epl-2.0/
+and the Eclipse Distribution License is available at
+  http://www.eclipse.org/org/documents/edl-v10.php.
+
+SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+
+Contributors:
+   Roger Light - initial implementation and documentation.
+*/
+#include "config.h"
+
+#include <cjson/cJSON.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mosquitto.h"
+#include "mosquitto_ctrl.h"
+#include "json_help.h"
+
+/* The bulk commands read one client per line from stdin. A line starting with
+ * '{' is a JSON object that is sent as it is, anything else is CSV. Empty
+ * lines and lines starting with '#' are ignored. */
+
+#define BULK_MAX_FIELDS 3
+
+typedef int (*bulk__csv_fn)(cJSON *j_items, cJSON **j_item, char **fields, int field_count);
+
+
+/* Read a line of any length, without its line ending. *line is NULL at the
+ * end of the input. */
+static int bulk__read_line(FILE *fptr, char **buf, size_t *buflen, char **line)
+{
+	size_t len = 0;
+	char *tmp;
+
+	*line = NULL;
+	if(*buf == NULL){
+		*buflen = 1024;
+		*buf = malloc(*buflen);
+		if(*buf == NULL){
+			return MOSQ_ERR_NOMEM;
+		}
+	}
+
+	while(fgets(&(*buf)[len], (int)(*buflen - len), fptr)){
+		len += strlen(&(*buf)[len]);
+		if((*buf)[len-1] == '\n'){
+			break;
+		}
+		if(len+1 == *buflen){
+			tmp = realloc(*buf, *buflen*2);
+			if(tmp == NULL){
+				return MOSQ_ERR_NOMEM;
+			}
+			*buf = tmp;
+			*buflen *= 2;
+		}
+	}
+	if(len == 0){
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	while(len > 0 && ((*buf)[len-1] == '\n' || (*buf)[len-1] == '\r')){
+		len--;
+		(*buf)[len] = '\0';
+	}
+	*line = *buf;
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+/* Split a CSV line in place. A field may be quoted with ", and "" in a quoted
+ * field is a literal ". Returns the number of fields, or -1 on error. */
+static int bulk__csv_split(char *line, char **fields, int max_fields)
+{
+	char *rp = line, *wp = line;
+	int count = 0;
+
+	while(1){
+		if(count == max_fields){
+			return -1;
+		}
+		fields[count++] = wp;
+
+		if(*rp == '"'){
+			rp++;
+			while(1){
+				if(*rp == '\0'){
+					return -1;
+				}else if(*rp == '"' && rp[1] == '"'){
+					*wp++ = '"';
+					rp += 2;
+				}else if(*rp == '"'){
+					rp++;
+					break;
+				}else{
+					*wp++ = *rp++;
+				}
+			}
+			if(*rp != ',' && *rp != '\0'){
+				return -1;
+			}
+		}else{
+			while(*rp != ',' && *rp != '\0'){
+				*wp++ = *rp++;
+			}
+		}
+
+		if(*rp == '\0'){
+			*wp = '\0';
+			return count;
+		}
+		rp++;
+		*wp++ = '\0';
+	}
+}
+
+
+static int bulk__read_items(cJSON *j_items, bulk__csv_fn csv_fn)
+{
+	char *buf = NULL, *line;
+	size_t buflen = 0;
+	char *fields[BULK_MAX_FIELDS];
+	int field_count;
+	int lineno = 0;
+	cJSON *j_item = NULL;
+	int rc;
+
+	while((rc = bulk__read_line(stdin, &buf, &buflen, &line)) == MOSQ_ERR_SUCCESS && line){
+		lineno++;
+		while(*line == ' ' || *line == '\t'){
+			line++;
+		}
+		if(line[0] == '\0' || line[0] == '#'){
+			continue;
+		}
+
+		if(line[0] == '{'){
+			j_item = cJSON_ParseWithOpts(line, NULL, true);
+			if(j_item == NULL || !cJSON_IsObject(j_item)){
+				cJSON_Delete(j_item);
+				fprintf(stderr, "Error: Invalid JSON on line %d.\n", lineno);
+				rc = MOSQ_ERR_INVAL;
+				break;
+			}
+			cJSON_AddItemToArray(j_items, j_item);
+		}else{
+			field_count = bulk__csv_split(line, fields, BULK_MAX_FIELDS);
+			if(field_count < 1 || fields[0][0] == '\0'){
+				rc = MOSQ_ERR_INVAL;
+			}else{
+				rc = csv_fn(j_items, &j_item, fields, field_count);
+			}
+			if(rc == MOSQ_ERR_INVAL){
+				fprintf(stderr, "Error: Invalid CSV on line %d.\n", lineno);
+			}
+			if(rc){
+				break;
+			}
+		}
+	}
+	free(buf);
+
+	if(rc == MOSQ_ERR_NOMEM){
+		fprintf(stderr, "Error: Out of memory.\n");
+	}
+	return rc;
+}
+
+
+static cJSON *bulk__add_item(cJSON *j_items, const char *username)
+{
+	cJSON *j_item;
+
+	j_item = cJSON_CreateObject();
+	if(j_item == NULL){
+		return NULL;
+	}
+	cJSON_AddItemToArray(j_items, j_item);
+	if(cJSON_AddStringToObject(j_item, "username", username) == NULL){
+		return NULL;
+	}
+	return j_item;
+}
+
+
+/* username[,password[,clientid]] */
+static int bulk__create_client_csv(cJSON *j_items, cJSON **j_item, char **fields, int field_count)
+{
+	*j_item = bulk__add_item(j_items, fields[0]);
+	if(*j_item == NULL
+			|| (field_count > 1 && fields[1][0] && cJSON_AddStringToObject(*j_item, "password", fields[1]) == NULL)
+			|| (field_count > 2 && fields[2][0] && cJSON_AddStringToObject(*j_item, "clientid", fields[2]) == NULL)
+			){
+
+		return MOSQ_ERR_NOMEM;
+	}
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+/* username[,priority] */
+static int bulk__group_client_csv(cJSON *j_items, cJSON **j_item, char **fields, int field_count)
+{
+	if(field_count > 2){
+		return MOSQ_ERR_INVAL;
+	}
+	*j_item = bulk__add_item(j_items, fields[0]);
+	if(*j_item == NULL
+			|| (field_count > 1 && fields[1][0] && cJSON_AddIntToObject(*j_item, "priority", atoi(fields[1])) == NULL)
+			){
+
+		return MOSQ_ERR_NOMEM;
+	}
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+/* username[,rolename[,priority]]
+ * Consecutive lines for the same client are merged, and a client with no
+ * rolename has all of its roles removed. */
+static int bulk__client_roles_csv(cJSON *j_items, cJSON **j_item, char **fields, int field_count)
+{
+	cJSON *j_roles, *j_role;
+	const char *username;
+
+	if(*j_item == NULL
+			|| json_get_string(*j_item, "username", &username, false) != MOSQ_ERR_SUCCESS
+			|| strcmp(username, fields[0])){
+
+		*j_item = bulk__add_item(j_items, fields[0]);
+		if(*j_item == NULL){
+			return MOSQ_ERR_NOMEM;
+		}
+	}
+
+	j_roles = cJSON_GetObjectItem(*j_item, "roles");
+	if(j_roles == NULL){
+		j_roles = cJSON_AddArrayToObject(*j_item, "roles");
+		if(j_roles == NULL){
+			return MOSQ_ERR_NOMEM;
+		}
+	}
+	if(field_count < 2 || fields[1][0] == '\0'){
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	j_role = cJSON_CreateObject();
+	if(j_role == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	cJSON_AddItemToArray(j_roles, j_role);
+	if(cJSON_AddStringToObject(j_role, "rolename", fields[1]) == NULL
+			|| (field_count > 2 && fields[2][0] && cJSON_AddIntToObject(j_role, "priority", atoi(fields[2])) == NULL)
+			){
+
+		return MOSQ_ERR_NOMEM;
+	}
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+int dynsec_bulk__create_clients(int argc, char *argv[], cJSON *j_command)
+{
+	cJSON *j_clients;
+
+	UNUSED(argv);
+
+	if(argc != 0){
+		return MOSQ_ERR_INVAL;
+	}
+
+	if(cJSON_AddStringToObject(j_command, "command", "createClients") == NULL
+			|| (j_clients = cJSON_AddArrayToObject(j_command, "clients")) == NULL
+			){
+
+		return MOSQ_ERR_NOMEM;
+	}
+	return bulk__read_items(j_clients, bulk__create_client_csv);
+}
+
+
+int dynsec_bulk__add_group_clients(int argc, char *argv[], cJSON *j_command)
+{
+	cJSON *j_clients;
+
+	if(argc != 1){
+		return MOSQ_ERR_INVAL;
+	}
+
+	if(cJSON_AddStringToObject(j_command, "command", "addGroupClients") == NULL
+			|| cJSON_AddStringToObject(j_command, "groupname", argv[0]) == NULL
+			|| (j_clients = cJSON_AddArrayToObject(j_command, "clients")) == NULL
+			){
+
+		return MOSQ_ERR_NOMEM;
+	}
+	return bulk__read_items(j_clients, bulk__group_client_csv);
+}
+
+
+int dynsec_bulk__set_client_roles(int argc, char *argv[], cJSON *j_command)
+{
+	cJSON *j_clients;
+
+	UNUSED(argv);
+
+	if(argc != 0){
+		return MOSQ_ERR_INVAL;
+	}
+
+	if(cJSON_AddStringToObject(j_command, "command", "setClientRolesBulk") == NULL
+			|| (j_clients = cJSON_AddArrayToObject(j_command, "clients")) == NULL
+			){
+
+		return MOSQ_ERR_NOMEM;
+	}
+	return bulk__read_items(j_clients, bulk__client_roles_csv);
+}
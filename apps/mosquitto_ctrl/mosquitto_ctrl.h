@@ -95,6 +95,10 @@ int broker__main(int argc, char *argv[], struct mosq_ctrl *ctrl);
 void dynsec__print_usage(void);
 int dynsec__main(int argc, char *argv[], struct mosq_ctrl *ctrl);
 
+int dynsec_bulk__add_group_clients(int argc, char *argv[], cJSON *j_command);
+int dynsec_bulk__create_clients(int argc, char *argv[], cJSON *j_command);
+int dynsec_bulk__set_client_roles(int argc, char *argv[], cJSON *j_command);
+
 int dynsec_client__add_remove_role(int argc, char *argv[], cJSON *j_command, const char *command);
 int dynsec_client__create(int argc, char *argv[], cJSON *j_command);
 int dynsec_client__delete(int argc, char *argv[], cJSON *j_command);
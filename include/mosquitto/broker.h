@@ -168,6 +168,7 @@ enum mosquitto_plugin_event {
 	MOSQ_EVT_CLIENT_OFFLINE = 28,
 	MOSQ_EVT_PERSIST_WILL_ADD = 29,
 	MOSQ_EVT_PERSIST_WILL_DELETE = 30,
+	MOSQ_EVT_MESSAGE_IN_BATCH = 31,
 };
 
 /* Data for the MOSQ_EVT_RELOAD event */
@@ -245,7 +246,9 @@ struct mosquitto_evt_control {
 	void *future2[4];
 };
 
-/* Data for the MOSQ_EVT_MESSAGE_IN and MOSQ_EVT_MESSAGE_OUT events */
+/* Data for the MOSQ_EVT_MESSAGE_IN and MOSQ_EVT_MESSAGE_OUT events. client
+ * is NULL for the MOSQ_EVT_MESSAGE_OUT callbacks of plugins that have called
+ * mosquitto_plugin_set_message_out_shared(). */
 struct mosquitto_evt_message {
 	void *future;
 	struct mosquitto *client;
@@ -262,6 +265,15 @@ struct mosquitto_evt_message {
 };
 
 
+/* Data for the MOSQ_EVT_MESSAGE_IN_BATCH event */
+struct mosquitto_evt_message_batch {
+	void *future;
+	const struct mosquitto_base_msg **messages;
+	int message_count;
+	void *future2[4];
+};
+
+
 /* Data for the MOSQ_EVT_TICK event */
 struct mosquitto_evt_tick {
 	void *future;
@@ -384,6 +396,10 @@ struct mosquitto_evt_persist_will_msg {
 /* Callback definition */
 typedef int (*MOSQ_FUNC_generic_callback)(int, void *, void *);
 
+/* Job callback definitions, see <mosquitto_job_submit> */
+typedef int (*MOSQ_FUNC_job_run)(void *job_data);
+typedef void (*MOSQ_FUNC_job_complete)(void *job_data, int result);
+
 typedef struct mosquitto_plugin_id_t mosquitto_plugin_id_t;
 
 /*
@@ -398,6 +414,77 @@ mosq_EXPORT int mosquitto_plugin_set_info(
 		const char *plugin_version);
 
 
+/*
+ * Function: mosquitto_plugin_set_acl_cacheable
+ *
+ * Tell the broker whether the results of this plugin's MOSQ_EVT_ACL_CHECK
+ * callback for MOSQ_ACL_READ depend only on the client and the topic, and not
+ * on the payload, QoS, retain flag, properties or time.
+ *
+ * If every ACL check callback that applies to a client is cacheable, the
+ * broker remembers the MOSQ_ACL_READ result for each of the client's
+ * subscriptions that does not contain wildcards, and does not call the
+ * plugins again for later messages on that topic. The remembered results are
+ * discarded when the broker is reloaded, when an ACL check callback is
+ * registered or unregistered, when the client reconnects or its username
+ * changes, and when <mosquitto_acl_cache_invalidate> is called.
+ *
+ * Plugins are not cacheable unless they call this function.
+ *
+ * Parameters:
+ *  identifier - the plugin identifier, as provided by <mosquitto_plugin_init>.
+ *  cacheable - true if the results may be remembered
+ *
+ * Returns:
+ *  MOSQ_ERR_SUCCESS - on success
+ *  MOSQ_ERR_INVAL - if identifier is NULL
+ */
+mosq_EXPORT int mosquitto_plugin_set_acl_cacheable(mosquitto_plugin_id_t *identifier, bool cacheable);
+
+
+/*
+ * Function: mosquitto_plugin_set_message_out_shared
+ *
+ * Tell the broker that this plugin's MOSQ_EVT_MESSAGE_OUT callback makes the
+ * same changes to a message whatever client it is being sent to, for example
+ * adding a timestamp property.
+ *
+ * When a message is published, the callback of a shared plugin is then
+ * called once rather than once for each recipient, and the modified topic,
+ * payload and properties are used for every client that the message is sent
+ * to straight away. Clients that receive the message later, from their queue
+ * or as a retained message, are sent the result of another call made at that
+ * time. The client member of the event data is NULL, and changes to the qos
+ * and retain members are ignored. If the callback returns an error, the
+ * message is not sent to any of those clients.
+ *
+ * If per_listener_settings is true, the callback is called once for each
+ * listener that the message is sent out on.
+ *
+ * Plugins are not shared unless they call this function.
+ *
+ * Parameters:
+ *  identifier - the plugin identifier, as provided by <mosquitto_plugin_init>.
+ *  shared - true if the callback does not depend on the recipient
+ *
+ * Returns:
+ *  MOSQ_ERR_SUCCESS - on success
+ *  MOSQ_ERR_INVAL - if identifier is NULL
+ */
+mosq_EXPORT int mosquitto_plugin_set_message_out_shared(mosquitto_plugin_id_t *identifier, bool shared);
+
+
+/*
+ * Function: mosquitto_acl_cache_invalidate
+ *
+ * Discard all MOSQ_ACL_READ results remembered by the broker. A cacheable
+ * plugin must call this whenever its ACLs change other than on a
+ * MOSQ_EVT_RELOAD event, for example when they are changed through a
+ * $CONTROL topic.
+ */
+mosq_EXPORT void mosquitto_acl_cache_invalidate(void);
+
+
 /*
  * Function: mosquitto_callback_register
  *
@@ -428,10 +515,18 @@ mosq_EXPORT int mosquitto_plugin_set_info(
  *          * MOSQ_EVT_MESSAGE_IN
  *              Called for each incoming PUBLISH message after it has been received
  *              and authorised. The contents of the message can be modified.
+ *          * MOSQ_EVT_MESSAGE_IN_BATCH
+ *              Called once for each pass of the broker main loop, with the
+ *              incoming PUBLISH messages that have been accepted in that pass,
+ *              in the order they were received. A batch holds at most 1000
+ *              messages. The messages must not be modified, and the return
+ *              value is ignored. See also <mosquitto_base_msg_ref_inc>.
  *          * MOSQ_EVT_MESSAGE_OUT
  *              Called for each outgoing PUBLISH message after it has been authorised,
  *              but before it is sent to each subscribing client. The contents of the
- *              message can be modified.
+ *              message can be modified. See also
+ *              <mosquitto_plugin_set_message_out_shared>, for which the
+ *              client is NULL.
  *          * MOSQ_EVT_PSK_KEY
  *              Called when a client connects with TLS-PSK and the broker needs
  *              the PSK information.
@@ -496,11 +591,20 @@ mosq_EXPORT int mosquitto_plugin_set_info(
  *              in its store.
  *
  *  cb_func - the callback function
- *  event_data - event specific data
+ *  event_data - event specific data. For MOSQ_EVT_CONTROL this is the
+ *               $CONTROL topic to register for. For MOSQ_EVT_MESSAGE_IN,
+ *               MOSQ_EVT_MESSAGE_IN_BATCH, MOSQ_EVT_MESSAGE_OUT and
+ *               MOSQ_EVT_ACL_CHECK this can be a
+ *               topic filter, e.g. "sensors/#", in which case the callback is
+ *               only called for messages with a matching topic. ACL checks
+ *               for subscribe and unsubscribe are not filtered. An ACL
+ *               check callback that is not called is treated as if it had
+ *               returned MOSQ_ERR_PLUGIN_IGNORE. Set to NULL to receive
+ *               events for all topics.
  *
  * Returns:
  *	MOSQ_ERR_SUCCESS - on success
- *	MOSQ_ERR_INVAL - if cb_func is NULL
+ *	MOSQ_ERR_INVAL - if cb_func is NULL, or the topic filter is invalid
  *	MOSQ_ERR_NOMEM - on out of memory
  *	MOSQ_ERR_ALREADY_EXISTS - if cb_func has already been registered for this event
  *	MOSQ_ERR_NOT_SUPPORTED - if the event is not supported
@@ -527,6 +631,7 @@ mosq_EXPORT int mosquitto_callback_register(
  *          * MOSQ_EVT_EXT_AUTH_CONTINUE
  *          * MOSQ_EVT_CONTROL
  *          * MOSQ_EVT_MESSAGE_IN
+ *          * MOSQ_EVT_MESSAGE_IN_BATCH
  *          * MOSQ_EVT_MESSAGE_OUT
  *          * MOSQ_EVT_PSK_KEY
  *          * MOSQ_EVT_TICK
@@ -548,11 +653,20 @@ mosq_EXPORT int mosquitto_callback_register(
  *          * MOSQ_EVT_PERSIST_CLIENT_MSG_DELETE
  *          * MOSQ_EVT_PERSIST_CLIENT_MSG_UPDATE
  *  cb_func - the callback function
- *  event_data - event specific data
+ *  event_data - event specific data. For MOSQ_EVT_CONTROL this is the
+ *               $CONTROL topic to register for. For MOSQ_EVT_MESSAGE_IN,
+ *               MOSQ_EVT_MESSAGE_IN_BATCH, MOSQ_EVT_MESSAGE_OUT and
+ *               MOSQ_EVT_ACL_CHECK this can be a
+ *               topic filter, e.g. "sensors/#", in which case the callback is
+ *               only called for messages with a matching topic. ACL checks
+ *               for subscribe and unsubscribe are not filtered. An ACL
+ *               check callback that is not called is treated as if it had
+ *               returned MOSQ_ERR_PLUGIN_IGNORE. Set to NULL to receive
+ *               events for all topics.
  *
  * Returns:
  *	MOSQ_ERR_SUCCESS - on success
- *	MOSQ_ERR_INVAL - if cb_func is NULL
+ *	MOSQ_ERR_INVAL - if cb_func is NULL, or the topic filter is invalid
  *	MOSQ_ERR_NOT_FOUND - if cb_func was not registered for this event
  *	MOSQ_ERR_NOT_SUPPORTED - if the event is not supported
  */
@@ -817,6 +931,12 @@ mosq_EXPORT int mosquitto_apply_on_all_clients(int (*FUNC_client_functor)(const
  * subscription, or to a single client whether or not it has a matching
  * subscription.
  *
+ * This function may be called from any thread, for example a thread started
+ * by the plugin to read from a local device. The message is handed to the
+ * main loop without locking, and the main loop is woken to send it straight
+ * away. Messages published from one thread are sent in the order they were
+ * published. On Windows it must only be called from the main broker thread.
+ *
  * Parameters:
  *  clientid -   optional string. If set to NULL, the message is delivered to all
  *               clients. If non-NULL, the message is delivered only to the
@@ -910,11 +1030,113 @@ mosq_EXPORT int mosquitto_broker_publish_copy(
  *
  * The plugin may use extra threads to handle the authentication requests, but
  * the call to `mosquitto_complete_basic_auth()` must happen in the main
- * mosquitto thread. Using the MOSQ_EVT_TICK event for this is suggested.
+ * mosquitto thread. Using <mosquitto_job_submit> or the MOSQ_EVT_TICK event
+ * for this is suggested.
  */
 mosq_EXPORT void mosquitto_complete_basic_auth(const char *clientid, int result);
 
 
+struct mosquitto_pw;
+
+/* Function: mosquitto_basic_auth_pw_verify
+ *
+ * Check a password from a MOSQ_EVT_BASIC_AUTH event against a password hash,
+ * without blocking the broker.
+ *
+ * Password hashes such as PBKDF2 and argon2id are deliberately slow to
+ * compute. If the broker has password verifier threads (see the
+ * `password_verify_threads` option) and the event is for a client that is
+ * connecting, the check is carried out on one of those threads and
+ * MOSQ_ERR_AUTH_DELAYED is returned. The plugin should return this value
+ * from its callback, and the broker completes the authentication once the
+ * check has finished, as though `mosquitto_complete_basic_auth()` had been
+ * called with MOSQ_ERR_SUCCESS or MOSQ_ERR_AUTH.
+ *
+ * Otherwise the check is carried out immediately.
+ *
+ * `pw` and `password` are copied, so the caller may free them as soon as this
+ * function returns.
+ *
+ * Parameters:
+ *  client - the client being authenticated, as passed in the event data
+ *  pw - the password hash to check against
+ *  password - the password supplied by the client
+ *
+ * Returns:
+ *  MOSQ_ERR_AUTH_DELAYED - the check is in progress
+ *  MOSQ_ERR_SUCCESS - the password matches
+ *  MOSQ_ERR_AUTH - the password does not match
+ *  MOSQ_ERR_INVAL - if client or password are NULL
+ */
+mosq_EXPORT int mosquitto_basic_auth_pw_verify(struct mosquitto *client, struct mosquitto_pw *pw, const char *password);
+
+
+/* Function: mosquitto_job_submit
+ *
+ * Run a slow piece of work, such as a request to an external service, without
+ * blocking the broker.
+ *
+ * `run_func` is called on one of the broker's plugin worker threads (see the
+ * `plugin_worker_threads` option). It must not call any other broker
+ * function. Once it has returned, `complete_func` is called in the main
+ * mosquitto thread with the value returned by `run_func`, and can carry on as
+ * any other callback would. For example, a MOSQ_EVT_BASIC_AUTH callback can
+ * submit a job and return MOSQ_ERR_AUTH_DELAYED, and the complete function
+ * then calls <mosquitto_complete_basic_auth> with the result. A job that
+ * produces a message can publish it with <mosquitto_broker_publish> from the
+ * complete function.
+ *
+ * The plugin owns `job_data`, and should free it in `complete_func` if
+ * needed. `complete_func` is always called, once, and never before this
+ * function has returned. Jobs that are still running when the broker shuts
+ * down are completed before the plugins are cleaned up.
+ *
+ * If the broker has no worker threads, `run_func` is called straight away.
+ *
+ * Parameters:
+ *  identifier - the plugin identifier, as provided by <mosquitto_plugin_init>.
+ *  run_func - the function to call on a worker thread
+ *  complete_func - the function to call in the main thread with the result
+ *  job_data - passed to both functions
+ *
+ * Returns:
+ *  MOSQ_ERR_SUCCESS - on success
+ *  MOSQ_ERR_INVAL - if identifier, run_func or complete_func are NULL
+ *  MOSQ_ERR_NOMEM - on out of memory
+ */
+mosq_EXPORT int mosquitto_job_submit(mosquitto_plugin_id_t *identifier, MOSQ_FUNC_job_run run_func, MOSQ_FUNC_job_complete complete_func, void *job_data);
+
+
+/*
+ * Function: mosquitto_base_msg_ref_inc
+ *
+ * Keep hold of a message passed to a MOSQ_EVT_MESSAGE_IN_BATCH callback after
+ * the callback has returned, for example to write it out from a job started
+ * with <mosquitto_job_submit>. The message, including its topic, payload and
+ * properties, remains valid and unchanged until <mosquitto_base_msg_ref_dec>
+ * is called for it. The message must not be modified.
+ *
+ * Both functions must only be called from the main broker thread. Messages
+ * that are still held when the broker shuts down are freed before the plugin
+ * cleanup function is called, and must not be used by it.
+ *
+ * Parameters:
+ *  msg - a message from a struct mosquitto_evt_message_batch
+ */
+mosq_EXPORT void mosquitto_base_msg_ref_inc(const struct mosquitto_base_msg *msg);
+
+
+/*
+ * Function: mosquitto_base_msg_ref_dec
+ *
+ * Release a message previously held with <mosquitto_base_msg_ref_inc>.
+ *
+ * Parameters:
+ *  msg - the message to release
+ */
+mosq_EXPORT void mosquitto_base_msg_ref_dec(const struct mosquitto_base_msg *msg);
+
+
 /* Function: mosquitto_broker_node_id_set
  *
  * Set a node ID for this broker between 0-1023 inclusive. This is used to help
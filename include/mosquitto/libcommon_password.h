@@ -50,6 +50,59 @@ libmosqcommon_EXPORT int mosquitto_pw_verify(struct mosquitto_pw *pw, const char
 libmosqcommon_EXPORT int mosquitto_pw_set_param(struct mosquitto_pw *pw, int param, int value);
 libmosqcommon_EXPORT int mosquitto_pw_decode(struct mosquitto_pw *pw, const char *encoded_password);
 
+/* Function: mosquitto_pw_cache_init
+ *
+ * Enable the verified credential cache. Once a password has been verified
+ * against a stored hash and added with <mosquitto_pw_cache_add>,
+ * <mosquitto_pw_cache_check> reports it as verified for the next `ttl`
+ * seconds without recomputing the hash. Any existing entries are removed.
+ *
+ * The cache is not thread safe.
+ *
+ * Parameters:
+ *  max_entries - the maximum number of entries to hold. The least recently
+ *                used entry is removed once this is reached. Set to 0 to
+ *                disable the cache.
+ *  ttl - how long in seconds an entry remains valid
+ *
+ * Returns:
+ *  MOSQ_ERR_SUCCESS - on success
+ *  MOSQ_ERR_NOT_SUPPORTED - if built without TLS support
+ *  MOSQ_ERR_UNKNOWN - if a random secret could not be generated
+ */
+libmosqcommon_EXPORT int mosquitto_pw_cache_init(unsigned int max_entries, int ttl);
+
+/* Function: mosquitto_pw_cache_cleanup
+ *
+ * Remove all entries and disable the verified credential cache.
+ */
+libmosqcommon_EXPORT void mosquitto_pw_cache_cleanup(void);
+
+/* Function: mosquitto_pw_cache_clear
+ *
+ * Remove all entries from the verified credential cache, for example when
+ * the password data is reloaded.
+ */
+libmosqcommon_EXPORT void mosquitto_pw_cache_clear(void);
+
+/* Function: mosquitto_pw_cache_check
+ *
+ * Check whether `password` has recently been verified against `pw` for
+ * `username`.
+ *
+ * Returns:
+ *  MOSQ_ERR_SUCCESS - the password was verified within the ttl
+ *  MOSQ_ERR_NOT_FOUND - the password must be verified with <mosquitto_pw_verify>
+ */
+libmosqcommon_EXPORT int mosquitto_pw_cache_check(const char *username, struct mosquitto_pw *pw, const char *password);
+
+/* Function: mosquitto_pw_cache_add
+ *
+ * Record that `password` has been successfully verified against `pw` for
+ * `username`. Does nothing if the cache is not enabled.
+ */
+libmosqcommon_EXPORT int mosquitto_pw_cache_add(const char *username, struct mosquitto_pw *pw, const char *password);
+
 #ifdef __cplusplus
 }
 #endif
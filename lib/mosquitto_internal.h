@@ -235,6 +235,7 @@ struct mosquitto_msg_data {
 #ifdef WITH_BROKER
 	struct mosquitto__client_msg *inflight;
 	struct mosquitto__client_msg *queued;
+	struct mosquitto__conflate_entry *queued_by_topic;
 	long inflight_bytes;
 	long inflight_bytes12;
 	int inflight_count;
@@ -462,6 +463,23 @@ struct mosquitto {
 	UT_hash_handle hh_sock;
 	struct mosquitto *for_free_next;
 	struct session_expiry_list *expiry_list_item;
+	/* Client message records still in the persistence file, see
+	 * persistence_lazy_queues */
+	uint64_t lazy_queue_first;
+	uint64_t lazy_queue_count;
+	uint64_t lazy_queue_next_first;
+	/* Queued messages that have been moved to disk, see
+	 * queue_spillover_bytes */
+	struct spillover_queue *spillover;
+	/* Password check running on a verifier thread, see
+	 * password_verify_threads */
+	struct auth_verify_job *auth_verify_job;
+	/* Queued messages are checked against the ACLs again after a reconnect,
+	 * a slice at a time. See db__check_acl_of_all_messages() */
+	uint64_t acl_epoch;
+	struct mosquitto__client_msg *acl_recheck_msg;
+	struct mosquitto *acl_recheck_next;
+	struct mosquitto *acl_recheck_prev;
 	uint16_t remote_port;
 #  ifndef WITH_OLD_KEEPALIVE
 	struct mosquitto *keepalive_next;
@@ -183,7 +183,7 @@ FILE *mosquitto_fopen(const char *path, const char *mode, bool restrict_read)
 			}else if(mode[i] == 't'){
 			}else if(mode[i] == 'b'){
 			}else if(mode[i] == '+'){
-				open_flags |= O_RDWR;
+				open_flags = (open_flags & ~O_ACCMODE) | O_RDWR;
 			}
 		}
 		int fd = open(path, open_flags, 0600);
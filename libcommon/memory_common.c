@@ -41,6 +41,8 @@ Contributors:
 #  endif
 #endif
 
+/* The broker lets plugins call mosquitto_broker_publish() from their own
+ * threads, so the counters may be updated from several threads at once. */
 static unsigned long memcount = 0;
 static unsigned long max_memcount = 0;
 
@@ -55,17 +57,65 @@ void mosquitto_memory_set_limit(size_t lim)
 
 unsigned long mosquitto_memory_used(void)
 {
+#ifdef REAL_WITH_MEMORY_TRACKING
+	return __atomic_load_n(&memcount, __ATOMIC_RELAXED);
+#else
 	return memcount;
+#endif
 }
 
 
 unsigned long mosquitto_max_memory_used(void)
 {
+#ifdef REAL_WITH_MEMORY_TRACKING
+	return __atomic_load_n(&max_memcount, __ATOMIC_RELAXED);
+#else
 	return max_memcount;
+#endif
 }
 
 #ifdef REAL_WITH_MEMORY_TRACKING
 
+static void memcount_add(size_t size)
+{
+	unsigned long count, max;
+
+	count = __atomic_add_fetch(&memcount, size, __ATOMIC_RELAXED);
+	max = __atomic_load_n(&max_memcount, __ATOMIC_RELAXED);
+	while(count > max
+			&& !__atomic_compare_exchange_n(&max_memcount, &max, count, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+	}
+}
+
+
+static void memcount_sub(size_t size)
+{
+	unsigned long count, sub;
+
+	count = __atomic_load_n(&memcount, __ATOMIC_RELAXED);
+	do{
+		/* Avoid counter underflow due to mismatched memory allocation function usage */
+		sub = size > count ? count : size;
+	}while(!__atomic_compare_exchange_n(&memcount, &count, count - sub, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+
+/* The limit check is made before the allocation, so concurrent allocations
+ * may overshoot the limit by the size of the allocations in flight. */
+static bool memcount_over_limit(size_t free_size, size_t size)
+{
+	unsigned long count;
+
+	if(mem_limit == 0){
+		return false;
+	}
+	count = __atomic_load_n(&memcount, __ATOMIC_RELAXED);
+	if(free_size > count){
+		free_size = count;
+	}
+	return count - free_size + size > mem_limit;
+}
+
 /* ==================================================
  * Alloc mismatch tracking
  * ================================================== */
@@ -156,16 +206,13 @@ BROKER_EXPORT void *mosquitto_malloc(size_t size)
 {
 	void *mem;
 
-	if(mem_limit && memcount + size > mem_limit){
+	if(memcount_over_limit(0, size)){
 		return NULL;
 	}
 	mem = malloc(size + ALLOC_MARKER_SIZE);
 	if(mem){
 		size = malloc_usable_size(mem);
-		memcount += size;
-		if(memcount > max_memcount){
-			max_memcount = memcount;
-		}
+		memcount_add(size);
 		set_alloc_marker(mem, size);
 	}
 
@@ -182,11 +229,7 @@ BROKER_EXPORT void *mosquitto_realloc(void *ptr, size_t size)
 	bool alloc_mismatch = free_size > 0 && !check_alloc_marker(ptr, free_size);
 #endif
 
-	/* Avoid counter underflow due to mismatched memory allocation function usage */
-	if(free_size > memcount){
-		free_size = memcount;
-	}
-	if(mem_limit && memcount - free_size + size > mem_limit){
+	if(memcount_over_limit(free_size, size)){
 		return NULL;
 	}
 	mem = realloc(ptr, size + ALLOC_MARKER_SIZE);
@@ -199,14 +242,11 @@ BROKER_EXPORT void *mosquitto_realloc(void *ptr, size_t size)
 
 	if(mem){
 		size = malloc_usable_size(mem);
-		memcount -= free_size;
-		memcount += size;
-		if(memcount > max_memcount){
-			max_memcount = memcount;
-		}
+		memcount_sub(free_size);
+		memcount_add(size);
 		set_alloc_marker(mem, size);
 	}else if(size == 0){
-		memcount -= free_size;
+		memcount_sub(free_size);
 	}
 
 	return mem;
@@ -234,11 +274,7 @@ BROKER_EXPORT void mosquitto_free(void *mem)
 	free(mem);
 #endif /* ALLOC_MARKER_SIZE */
 
-	/* Avoid counter underflow due to mismatched memory function allocation usage */
-	if(free_size > memcount){
-		free_size = memcount;
-	}
-	memcount -= free_size;
+	memcount_sub(free_size);
 }
 
 #else /* #ifdef WITH_REAL_MEMORY_TRACKING */
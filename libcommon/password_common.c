@@ -20,15 +20,18 @@ Contributors:
 
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
 
 #ifdef WITH_TLS
 #  include <openssl/opensslv.h>
 #  include <openssl/evp.h>
+#  include <openssl/hmac.h>
 #  include <openssl/rand.h>
 #  define HASH_LEN EVP_MAX_MD_SIZE
 #endif
 
 #include "mosquitto.h"
+#include "uthash.h"
 
 #ifdef WITH_TLS
 #  define HASH_LEN EVP_MAX_MD_SIZE
@@ -686,3 +689,196 @@ void mosquitto_pw_cleanup(struct mosquitto_pw *pw)
 		mosquitto_free(pw);
 	}
 }
+
+
+/* ==================================================
+ * Verified credential cache
+ *
+ * Remembers that a password has recently been verified against a stored
+ * hash, so that a client that reconnects often only pays the cost of the
+ * hash once per ttl. Entries are keyed by an HMAC-SHA256, under a random per
+ * process secret, of the username, the encoded stored hash and the presented
+ * password. No password or password derived value that is useful outside
+ * this process is kept. Changing a password changes the stored hash, so old
+ * entries can never match again and simply age out.
+ *
+ * The cache is not thread safe.
+ * ================================================== */
+
+#define PW_CACHE_KEY_LEN 32
+
+struct pw_cache_entry {
+	UT_hash_handle hh;
+	unsigned char key[PW_CACHE_KEY_LEN];
+	time_t expiry;
+};
+
+static struct pw_cache_entry *pw_cache = NULL;
+static unsigned int pw_cache_max = 0;
+static int pw_cache_ttl = 0;
+#ifdef WITH_TLS
+static unsigned char pw_cache_secret[32];
+#endif
+
+
+#ifdef WITH_TLS
+static int pw_cache__key(const char *username, struct mosquitto_pw *pw, const char *password, unsigned char *key)
+{
+	const char *encoded;
+	unsigned char *buf;
+	size_t ulen, elen, plen;
+	unsigned int key_len = PW_CACHE_KEY_LEN;
+
+	encoded = mosquitto_pw_get_encoded(pw);
+	if(username == NULL || encoded == NULL || password == NULL){
+		return MOSQ_ERR_INVAL;
+	}
+	ulen = strlen(username);
+	elen = strlen(encoded);
+	plen = strlen(password);
+
+	buf = mosquitto_malloc(ulen + 1 + elen + 1 + plen);
+	if(buf == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	memcpy(buf, username, ulen+1);
+	memcpy(&buf[ulen+1], encoded, elen+1);
+	memcpy(&buf[ulen+1+elen+1], password, plen);
+
+	if(HMAC(EVP_sha256(), pw_cache_secret, sizeof(pw_cache_secret),
+				buf, ulen + 1 + elen + 1 + plen, key, &key_len) == NULL){
+
+		key_len = 0;
+	}
+	memset(buf, 0, ulen + 1 + elen + 1 + plen);
+	mosquitto_free(buf);
+
+	return key_len == PW_CACHE_KEY_LEN ? MOSQ_ERR_SUCCESS : MOSQ_ERR_UNKNOWN;
+}
+#endif
+
+
+static void pw_cache__remove(struct pw_cache_entry *entry)
+{
+	HASH_DELETE(hh, pw_cache, entry);
+	mosquitto_free(entry);
+}
+
+
+int mosquitto_pw_cache_init(unsigned int max_entries, int ttl)
+{
+#ifdef WITH_TLS
+	mosquitto_pw_cache_cleanup();
+	if(max_entries == 0 || ttl <= 0){
+		return MOSQ_ERR_SUCCESS;
+	}
+	if(RAND_bytes(pw_cache_secret, sizeof(pw_cache_secret)) != 1){
+		return MOSQ_ERR_UNKNOWN;
+	}
+	pw_cache_max = max_entries;
+	pw_cache_ttl = ttl;
+	return MOSQ_ERR_SUCCESS;
+#else
+	UNUSED(max_entries);
+	UNUSED(ttl);
+	return MOSQ_ERR_NOT_SUPPORTED;
+#endif
+}
+
+
+void mosquitto_pw_cache_clear(void)
+{
+	struct pw_cache_entry *entry, *entry_tmp;
+
+	HASH_ITER(hh, pw_cache, entry, entry_tmp){
+		pw_cache__remove(entry);
+	}
+}
+
+
+void mosquitto_pw_cache_cleanup(void)
+{
+	mosquitto_pw_cache_clear();
+	pw_cache_max = 0;
+	pw_cache_ttl = 0;
+#ifdef WITH_TLS
+	memset(pw_cache_secret, 0, sizeof(pw_cache_secret));
+#endif
+}
+
+
+int mosquitto_pw_cache_check(const char *username, struct mosquitto_pw *pw, const char *password)
+{
+#ifdef WITH_TLS
+	struct pw_cache_entry *entry;
+	unsigned char key[PW_CACHE_KEY_LEN];
+
+	if(pw_cache_max == 0 || !mosquitto_pw_is_valid(pw)){
+		return MOSQ_ERR_NOT_FOUND;
+	}
+	if(pw_cache__key(username, pw, password, key)){
+		return MOSQ_ERR_NOT_FOUND;
+	}
+
+	HASH_FIND(hh, pw_cache, key, PW_CACHE_KEY_LEN, entry);
+	if(entry == NULL){
+		return MOSQ_ERR_NOT_FOUND;
+	}
+	if(entry->expiry <= mosquitto_time()){
+		pw_cache__remove(entry);
+		return MOSQ_ERR_NOT_FOUND;
+	}
+
+	/* Most recently used entries are kept at the end */
+	HASH_DELETE(hh, pw_cache, entry);
+	HASH_ADD(hh, pw_cache, key, PW_CACHE_KEY_LEN, entry);
+	return MOSQ_ERR_SUCCESS;
+#else
+	UNUSED(username);
+	UNUSED(pw);
+	UNUSED(password);
+	return MOSQ_ERR_NOT_FOUND;
+#endif
+}
+
+
+int mosquitto_pw_cache_add(const char *username, struct mosquitto_pw *pw, const char *password)
+{
+#ifdef WITH_TLS
+	struct pw_cache_entry *entry;
+	unsigned char key[PW_CACHE_KEY_LEN];
+	int rc;
+
+	if(pw_cache_max == 0){
+		return MOSQ_ERR_SUCCESS;
+	}
+	rc = pw_cache__key(username, pw, password, key);
+	if(rc){
+		return rc;
+	}
+
+	HASH_FIND(hh, pw_cache, key, PW_CACHE_KEY_LEN, entry);
+	if(entry){
+		HASH_DELETE(hh, pw_cache, entry);
+	}else{
+		if(HASH_COUNT(pw_cache) >= pw_cache_max){
+			/* Evict the least recently used entry */
+			pw_cache__remove(pw_cache);
+		}
+		entry = mosquitto_calloc(1, sizeof(struct pw_cache_entry));
+		if(entry == NULL){
+			return MOSQ_ERR_NOMEM;
+		}
+		memcpy(entry->key, key, PW_CACHE_KEY_LEN);
+	}
+	entry->expiry = mosquitto_time() + pw_cache_ttl;
+	HASH_ADD(hh, pw_cache, key, PW_CACHE_KEY_LEN, entry);
+
+	return MOSQ_ERR_SUCCESS;
+#else
+	UNUSED(username);
+	UNUSED(pw);
+	UNUSED(password);
+	return MOSQ_ERR_NOT_SUPPORTED;
+#endif
+}
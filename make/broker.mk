@@ -49,6 +49,7 @@ endif
 
 ifeq ($(WITH_THREADING),yes)
 	LOCAL_CFLAGS+=-pthread
+	LOCAL_CPPFLAGS+=-DWITH_THREADING
 	LOCAL_LDFLAGS+=-pthread
 endif
 
@@ -26,27 +26,103 @@ Contributors:
 #include "mosquitto.h"
 
 
+struct acl__match {
+	const char *clientid;
+	size_t clientid_len;
+	const char *username;
+	size_t username_len;
+	int access;
+	bool deny;
+};
+
+
+/* Walk the tree for a topic, or for a subscription filter. A filter level of
+ * "+" is only covered by a "+" or "#" ACL, and a filter level of "#" is only
+ * covered by a "#" ACL, so the same walk works for both. */
+static void acl__tree_match(struct acl__node *node, const char *level, bool is_root, bool is_sys, struct acl__match *match)
+{
+	struct acl__node *child;
+	const char *end, *next;
+	size_t len;
+
+	/* Wildcards and patterns in the first level never match topics starting
+	 * with $ */
+	if(!(is_root && is_sys)){
+		match->deny |= node->deny_hash;
+		match->access |= node->access_hash;
+	}
+	if(level == NULL){
+		match->deny |= node->deny;
+		match->access |= node->access;
+		return;
+	}
+	if(match->deny){
+		return;
+	}
+
+	end = strchr(level, '/');
+	if(end){
+		len = (size_t)(end - level);
+		next = end + 1;
+	}else{
+		len = strlen(level);
+		next = NULL;
+	}
+	if(len == 1 && level[0] == '#'){
+		return;
+	}
+
+	HASH_FIND(hh, node->children, level, len, child);
+	if(child){
+		acl__tree_match(child, next, false, false, match);
+	}
+	if(is_root && is_sys){
+		return;
+	}
+	if(node->plus){
+		acl__tree_match(node->plus, next, false, false, match);
+	}
+	if(len == 1 && level[0] == '+'){
+		return;
+	}
+	if(node->clientid && match->clientid_len == len && len > 0
+			&& !memcmp(match->clientid, level, len)){
+
+		acl__tree_match(node->clientid, next, false, false, match);
+	}
+	if(node->username && match->username_len == len && len > 0
+			&& !memcmp(match->username, level, len)){
+
+		acl__tree_match(node->username, next, false, false, match);
+	}
+}
+
+
 int acl_file__check(int event, void *event_data, void *userdata)
 {
 	struct mosquitto_evt_acl_check *ed = event_data;
 	struct acl__user *acl_user;
-	struct acl__entry *acl_root;
-	bool result;
+	struct acl__match match;
 	struct acl_file_data *data = userdata;
 	const char *clientid;
 	const char *username;
+	bool is_sys;
 
 	UNUSED(event);
 
 	// FIXME if(ed->client->bridge) return MOSQ_ERR_SUCCESS;
-	if(ed->access == MOSQ_ACL_SUBSCRIBE || ed->access == MOSQ_ACL_UNSUBSCRIBE){
-		return MOSQ_ERR_SUCCESS;                                                                        /* FIXME - implement ACL subscription strings. */
-
+	if(ed->access == MOSQ_ACL_UNSUBSCRIBE){
+		return MOSQ_ERR_SUCCESS;
+	}
+	if(ed->access == MOSQ_ACL_SUBSCRIBE && !data->acl_subscribe){
+		/* Subscriptions are only checked if there are "subscribe" ACLs, so
+		 * that existing ACL files keep working as before. */
+		return MOSQ_ERR_SUCCESS;
 	}
 	clientid = mosquitto_client_id(ed->client);
 	username = mosquitto_client_username(ed->client);
 
-	if(!data->acl_file && !data->acl_users && !data->acl_patterns){
+	if(!data->acl_file && !data->acl_users && !data->acl_patterns && !data->acl_patterns_username){
 		return MOSQ_ERR_PLUGIN_IGNORE;
 	}
 
@@ -55,42 +131,27 @@ int acl_file__check(int event, void *event_data, void *userdata)
 	}else{
 		acl_user = &data->acl_anon;
 	}
-	if(!acl_user && !data->acl_patterns){
+	if(!acl_user && !data->acl_patterns && !data->acl_patterns_username){
 		return MOSQ_ERR_ACL_DENIED;
 	}
 
-	if(acl_user){
-		acl_root = acl_user->acl;
-	}else{
-		acl_root = NULL;
-	}
-
-	/* Loop through all ACLs for this client. ACL denials are iterated over first. */
-	while(acl_root){
-		/* Loop through the topic looking for matches to this ACL. */
+	is_sys = (ed->topic[0] == '$');
+	memset(&match, 0, sizeof(match));
 
-		/* If subscription starts with $, acl_root->topic must also start with $. */
-		if(ed->topic[0] == '$' && acl_root->topic[0] != '$'){
-			acl_root = acl_root->next;
-			continue;
+	/* Check the ACLs for this client. ACL denials take priority. */
+	if(acl_user && acl_user->acl){
+		acl__tree_match(acl_user->acl, ed->topic, true, is_sys, &match);
+		if(match.deny){
+			/* Access was explicitly denied for this topic. */
+			return MOSQ_ERR_ACL_DENIED;
 		}
-		mosquitto_topic_matches_sub(acl_root->topic, ed->topic, &result);
-		if(result){
-			if(acl_root->access == MOSQ_ACL_NONE){
-				/* Access was explicitly denied for this topic. */
-				return MOSQ_ERR_ACL_DENIED;
-			}
-			if(ed->access & acl_root->access){
-				/* And access is allowed. */
-				return MOSQ_ERR_SUCCESS;
-			}
+		if(ed->access & match.access){
+			/* And access is allowed. */
+			return MOSQ_ERR_SUCCESS;
 		}
-		acl_root = acl_root->next;
 	}
 
-	acl_root = data->acl_patterns;
-
-	if(acl_root){
+	if(data->acl_patterns || data->acl_patterns_username){
 		/* We are using pattern based acls. Check whether the username or
 		 * client id contains a + or # and if so deny access.
 		 *
@@ -109,32 +170,29 @@ int acl_file__check(int event, void *event_data, void *userdata)
 		}
 	}
 
-	/* Loop through all pattern ACLs. ACL denial patterns are iterated over first. */
+	/* Check all pattern ACLs. ACL denial patterns take priority. */
 	if(!clientid){
 		return MOSQ_ERR_ACL_DENIED;
 	}
 
-	while(acl_root){
-		if(acl_root->ucount && !username){
-			acl_root = acl_root->next;
-			continue;
-		}
-
-		if(mosquitto_topic_matches_sub_with_pattern(acl_root->topic, ed->topic, clientid, username, &result)){
-			return MOSQ_ERR_ACL_DENIED;
-		}
-		if(result){
-			if(acl_root->access == MOSQ_ACL_NONE){
-				/* Access was explicitly denied for this topic pattern. */
-				return MOSQ_ERR_ACL_DENIED;
-			}
-			if(ed->access & acl_root->access){
-				/* And access is allowed. */
-				return MOSQ_ERR_SUCCESS;
-			}
-		}
-
-		acl_root = acl_root->next;
+	memset(&match, 0, sizeof(match));
+	match.clientid = clientid;
+	match.clientid_len = strlen(clientid);
+	if(data->acl_patterns){
+		acl__tree_match(data->acl_patterns, ed->topic, true, is_sys, &match);
+	}
+	if(username && data->acl_patterns_username){
+		match.username = username;
+		match.username_len = strlen(username);
+		acl__tree_match(data->acl_patterns_username, ed->topic, true, is_sys, &match);
+	}
+	if(match.deny){
+		/* Access was explicitly denied for this topic pattern. */
+		return MOSQ_ERR_ACL_DENIED;
+	}
+	if(ed->access & match.access){
+		/* And access is allowed. */
+		return MOSQ_ERR_SUCCESS;
 	}
 
 	return MOSQ_ERR_ACL_DENIED;
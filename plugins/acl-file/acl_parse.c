@@ -22,36 +22,117 @@ Contributors:
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
-#include <utlist.h>
 
 #include "mosquitto.h"
 #include "acl_file.h"
 
 
-static int acl__add_to_user(struct acl__user *acl_user, const char *topic, int access)
+static struct acl__node *acl__node_new(const char *level, size_t len)
 {
-	struct acl__entry *acl;
+	struct acl__node *node;
 
-	acl = mosquitto_calloc(1, sizeof(struct acl__entry));
-	if(!acl){
-		return MOSQ_ERR_NOMEM;
+	node = mosquitto_calloc(1, sizeof(struct acl__node) + len + 1);
+	if(node){
+		memcpy(node->level, level, len);
 	}
-	acl->access = access;
+	return node;
+}
 
-	acl->topic = mosquitto_strdup(topic);
-	if(!acl->topic){
-		return MOSQ_ERR_NOMEM;
+
+static void acl__node_free(struct acl__node *node)
+{
+	struct acl__node *child, *child_tmp;
+
+	if(node == NULL){
+		return;
 	}
 
-	/* Add acl to user acl list */
-	if(access == MOSQ_ACL_NONE){
-		/* Put "deny" acls at front of the list */
-		DL_PREPEND(acl_user->acl, acl);
-	}else{
-		DL_APPEND(acl_user->acl, acl);
+	HASH_ITER(hh, node->children, child, child_tmp){
+		HASH_DELETE(hh, node->children, child);
+		acl__node_free(child);
+	}
+	acl__node_free(node->plus);
+	acl__node_free(node->clientid);
+	acl__node_free(node->username);
+	mosquitto_FREE(node);
+}
+
+
+static struct acl__node *acl__node_child(struct acl__node *node, const char *level, size_t len, bool pattern)
+{
+	struct acl__node **special = NULL;
+	struct acl__node *child;
+
+	if(len == 1 && level[0] == '+'){
+		special = &node->plus;
+	}else if(pattern && len == 2 && level[0] == '%' && level[1] == 'c'){
+		special = &node->clientid;
+	}else if(pattern && len == 2 && level[0] == '%' && level[1] == 'u'){
+		special = &node->username;
 	}
 
-	return MOSQ_ERR_SUCCESS;
+	if(special){
+		if(*special == NULL){
+			*special = acl__node_new(level, len);
+		}
+		return *special;
+	}
+
+	HASH_FIND(hh, node->children, level, len, child);
+	if(child == NULL){
+		child = acl__node_new(level, len);
+		if(child == NULL){
+			return NULL;
+		}
+		HASH_ADD(hh, node->children, level, len, child);
+	}
+	return child;
+}
+
+
+/* Add a topic, which has already been checked with mosquitto_sub_topic_check() */
+static int acl__tree_add(struct acl__node **root, const char *topic, int access, bool pattern)
+{
+	struct acl__node *node;
+	const char *level = topic;
+	const char *end;
+	size_t len;
+
+	if(*root == NULL){
+		*root = acl__node_new("", 0);
+		if(*root == NULL){
+			return MOSQ_ERR_NOMEM;
+		}
+	}
+	node = *root;
+
+	while(1){
+		end = strchr(level, '/');
+		len = end ? (size_t)(end - level) : strlen(level);
+
+		if(len == 1 && level[0] == '#'){
+			if(access == MOSQ_ACL_NONE){
+				node->deny_hash = true;
+			}else{
+				node->access_hash |= access;
+			}
+			return MOSQ_ERR_SUCCESS;
+		}
+
+		node = acl__node_child(node, level, len, pattern);
+		if(node == NULL){
+			return MOSQ_ERR_NOMEM;
+		}
+		if(end == NULL){
+			if(access == MOSQ_ACL_NONE){
+				node->deny = true;
+			}else{
+				node->access |= access;
+			}
+			return MOSQ_ERR_SUCCESS;
+		}
+		level = end + 1;
+	}
 }
 
 
@@ -97,77 +178,27 @@ static int acl__add(struct acl_file_data *data, const char *user, unsigned user_
 		return MOSQ_ERR_NOMEM;
 	}
 
-	return acl__add_to_user(acl_user, topic, access);
+	return acl__tree_add(&acl_user->acl, topic, access, false);
 }
 
 
 static int acl__add_pattern(struct acl_file_data *data, const char *topic, int access)
 {
-	struct acl__entry *acl, *acl_tail;
-	char *local_topic;
-	char *s;
-
-	if(!data| !topic){
+	if(!data || !topic){
 		return MOSQ_ERR_INVAL;
 	}
 
-	local_topic = mosquitto_strdup(topic);
-	if(!local_topic){
-		return MOSQ_ERR_NOMEM;
-	}
-
-	acl = mosquitto_malloc(sizeof(struct acl__entry));
-	if(!acl){
-		mosquitto_FREE(local_topic);
-		return MOSQ_ERR_NOMEM;
-	}
-	acl->access = access;
-	acl->topic = local_topic;
-	acl->next = NULL;
-
-	acl->ccount = 0;
-	s = local_topic;
-	while(s){
-		s = strstr(s, "%c");
-		if(s){
-			acl->ccount++;
-			s+=2;
-		}
-	}
-
-	acl->ucount = 0;
-	s = local_topic;
-	while(s){
-		s = strstr(s, "%u");
-		if(s){
-			acl->ucount++;
-			s+=2;
-		}
-	}
-
-	if(acl->ccount == 0 && acl->ucount == 0){
-		mosquitto_log_printf(MOSQ_LOG_WARNING,
-				"Warning: ACL pattern '%s' does not contain '%%c' or '%%u'.",
-				topic);
-	}
-
-	if(data->acl_patterns){
-		acl_tail = data->acl_patterns;
-		if(access == MOSQ_ACL_NONE){
-			/* Put "deny" acls at front of the list */
-			acl->next = acl_tail;
-			data->acl_patterns = acl;
-		}else{
-			while(acl_tail->next){
-				acl_tail = acl_tail->next;
-			}
-			acl_tail->next = acl;
-		}
+	if(strstr(topic, "%u")){
+		/* Only checked for clients with a username */
+		return acl__tree_add(&data->acl_patterns_username, topic, access, true);
 	}else{
-		data->acl_patterns = acl;
+		if(strstr(topic, "%c") == NULL){
+			mosquitto_log_printf(MOSQ_LOG_WARNING,
+					"Warning: ACL pattern '%s' does not contain '%%c' or '%%u'.",
+					topic);
+		}
+		return acl__tree_add(&data->acl_patterns, topic, access, true);
 	}
-
-	return MOSQ_ERR_SUCCESS;
 }
 
 
@@ -207,7 +238,7 @@ int acl_file__parse(struct acl_file_data *data)
 		return MOSQ_ERR_UNKNOWN;
 	}
 
-	/* topic [read|write] <topic>
+	/* topic [read|write|readwrite|subscribe|deny] <topic>
 	 * user <user>
 	 */
 
@@ -249,6 +280,9 @@ int acl_file__parse(struct acl_file_data *data)
 						access = MOSQ_ACL_WRITE;
 					}else if(!strcmp(access_s, "readwrite")){
 						access = MOSQ_ACL_READ | MOSQ_ACL_WRITE;
+					}else if(!strcmp(access_s, "subscribe")){
+						access = MOSQ_ACL_SUBSCRIBE;
+						data->acl_subscribe = true;
 					}else if(!strcmp(access_s, "deny")){
 						access = MOSQ_ACL_NONE;
 					}else{
@@ -311,19 +345,6 @@ int acl_file__parse(struct acl_file_data *data)
 }
 
 
-static void acl__free_entries(struct acl__entry *entry)
-{
-	while(entry){
-		struct acl__entry *next = entry->next;
-
-		mosquitto_FREE(entry->topic);
-		mosquitto_FREE(entry);
-
-		entry = next;
-	}
-}
-
-
 void acl_file__cleanup(struct acl_file_data *data)
 {
 	struct acl__user *user, *user_tmp;
@@ -331,15 +352,19 @@ void acl_file__cleanup(struct acl_file_data *data)
 	HASH_ITER(hh, data->acl_users, user, user_tmp){
 		HASH_DELETE(hh, data->acl_users, user);
 		mosquitto_FREE(user->username);
-		acl__free_entries(user->acl);
+		acl__node_free(user->acl);
 		mosquitto_FREE(user);
 	}
 
-	acl__free_entries(data->acl_anon.acl);
+	acl__node_free(data->acl_anon.acl);
 	data->acl_anon.acl = NULL;
 
-	acl__free_entries(data->acl_patterns);
+	acl__node_free(data->acl_patterns);
 	data->acl_patterns = NULL;
+	acl__node_free(data->acl_patterns_username);
+	data->acl_patterns_username = NULL;
+
+	data->acl_subscribe = false;
 }
 
 
@@ -52,6 +52,7 @@ int mosquitto_plugin_init(mosquitto_plugin_id_t *identifier, void **user_data, s
 
 	mosq_pid = identifier;
 	mosquitto_plugin_set_info(identifier, PLUGIN_NAME, NULL);
+	mosquitto_plugin_set_acl_cacheable(identifier, true);
 
 	rc = handle_options(data, options, option_count);
 	if(rc){
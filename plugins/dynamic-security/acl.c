@@ -24,8 +24,8 @@ Contributors:
 
 typedef int (*MOSQ_FUNC_acl_check)(struct dynsec__data *data, struct mosquitto_evt_acl_check *, struct dynsec__rolelist *);
 
-
-/* FIXME - CACHE! */
+/* The maximum number of topics remembered per client, per direction */
+#define ACL_CACHE_MAX_TOPICS 1000
 
 
 /* ################################################################
@@ -48,6 +48,17 @@ static int acl_check_publish_c_recv(struct dynsec__data *data, struct mosquitto_
 	username = mosquitto_client_username(ed->client);
 
 	HASH_ITER(hh, base_rolelist, rolelist, rolelist_tmp){
+		if(rolelist->role->acls.publish_c_recv_trie){
+			acl = dynsec_acl_trie__match(rolelist->role->acls.publish_c_recv_trie, ed->topic, clientid, username);
+			if(acl){
+				if(acl->allow){
+					return MOSQ_ERR_SUCCESS;
+				}else{
+					return MOSQ_ERR_ACL_DENIED;
+				}
+			}
+			continue;
+		}
 		HASH_ITER(hh, rolelist->role->acls.publish_c_recv, acl, acl_tmp){
 			if(mosquitto_topic_matches_sub_with_pattern(acl->topic, ed->topic, clientid, username, &result)){
 				return MOSQ_ERR_ACL_DENIED;
@@ -85,6 +96,17 @@ static int acl_check_publish_c_send(struct dynsec__data *data, struct mosquitto_
 	username = mosquitto_client_username(ed->client);
 
 	HASH_ITER(hh, base_rolelist, rolelist, rolelist_tmp){
+		if(rolelist->role->acls.publish_c_send_trie){
+			acl = dynsec_acl_trie__match(rolelist->role->acls.publish_c_send_trie, ed->topic, clientid, username);
+			if(acl){
+				if(acl->allow){
+					return MOSQ_ERR_SUCCESS;
+				}else{
+					return MOSQ_ERR_ACL_DENIED;
+				}
+			}
+			continue;
+		}
 		HASH_ITER(hh, rolelist->role->acls.publish_c_send, acl, acl_tmp){
 			if(mosquitto_topic_matches_sub_with_pattern(acl->topic, ed->topic, clientid, username, &result)){
 				return MOSQ_ERR_ACL_DENIED;
@@ -261,6 +283,158 @@ static int acl_check(struct dynsec__data *data, struct mosquitto_evt_acl_check *
 }
 
 
+/* ################################################################
+ * #
+ * # ACL check - decision cache
+ * #
+ * ################################################################ */
+
+/* Publish checks are made for every message a client sends, and for every
+ * subscriber each message is delivered to. The result of a check depends only
+ * on the client id, the username, the topic and the plugin configuration, so
+ * each client keeps the results of its recent publish checks keyed by topic.
+ * Every configuration change increments data->acl_generation, which makes all
+ * cached results stale at once.
+ */
+
+static void acl_cache__entries_free(struct dynsec__acl_cache_entry **entries)
+{
+	struct dynsec__acl_cache_entry *entry, *entry_tmp;
+
+	HASH_ITER(hh, *entries, entry, entry_tmp){
+		HASH_DELETE(hh, *entries, entry);
+		mosquitto_free(entry);
+	}
+}
+
+
+static void acl_cache__free(struct dynsec__data *data, struct dynsec__acl_cache *cache)
+{
+	HASH_DELETE(hh, data->acl_cache, cache);
+	acl_cache__entries_free(&cache->publish_c_send);
+	acl_cache__entries_free(&cache->publish_c_recv);
+	mosquitto_free(cache->username);
+	mosquitto_free(cache);
+}
+
+
+void dynsec__acl_cache_cleanup(struct dynsec__data *data)
+{
+	struct dynsec__acl_cache *cache, *cache_tmp;
+
+	HASH_ITER(hh, data->acl_cache, cache, cache_tmp){
+		acl_cache__free(data, cache);
+	}
+}
+
+
+static bool username_equal(const char *a, const char *b)
+{
+	if(a == NULL || b == NULL){
+		return a == b;
+	}
+	return !strcmp(a, b);
+}
+
+
+static struct dynsec__acl_cache *acl_cache__get(struct dynsec__data *data, struct mosquitto *client)
+{
+	struct dynsec__acl_cache *cache;
+	const char *clientid, *username;
+	size_t len;
+
+	clientid = mosquitto_client_id(client);
+	if(clientid == NULL){
+		return NULL;
+	}
+	username = mosquitto_client_username(client);
+	len = strlen(clientid);
+
+	HASH_FIND(hh, data->acl_cache, clientid, len, cache);
+	if(cache){
+		if(cache->generation == data->acl_generation && username_equal(cache->username, username)){
+			return cache;
+		}
+		acl_cache__free(data, cache);
+	}
+
+	cache = mosquitto_calloc(1, sizeof(struct dynsec__acl_cache) + len + 1);
+	if(cache == NULL){
+		return NULL;
+	}
+	if(username){
+		cache->username = mosquitto_strdup(username);
+		if(cache->username == NULL){
+			mosquitto_free(cache);
+			return NULL;
+		}
+	}
+	cache->generation = data->acl_generation;
+	memcpy(cache->clientid, clientid, len);
+	HASH_ADD(hh, data->acl_cache, clientid, len, cache);
+
+	return cache;
+}
+
+
+static int acl_check_cached(struct dynsec__data *data, struct mosquitto_evt_acl_check *ed, MOSQ_FUNC_acl_check check, bool acl_default_access)
+{
+	struct dynsec__acl_cache *cache;
+	struct dynsec__acl_cache_entry **entries, *entry;
+	size_t len;
+	int rc;
+
+	cache = acl_cache__get(data, ed->client);
+	if(cache == NULL){
+		return acl_check(data, ed, check, acl_default_access);
+	}
+	if(ed->access == MOSQ_ACL_WRITE){
+		entries = &cache->publish_c_send;
+	}else{
+		entries = &cache->publish_c_recv;
+	}
+
+	len = strlen(ed->topic);
+	HASH_FIND(hh, *entries, ed->topic, len, entry);
+	if(entry){
+		return entry->rc;
+	}
+
+	rc = acl_check(data, ed, check, acl_default_access);
+
+	if(HASH_COUNT(*entries) >= ACL_CACHE_MAX_TOPICS){
+		acl_cache__entries_free(entries);
+	}
+	entry = mosquitto_malloc(sizeof(struct dynsec__acl_cache_entry) + len + 1);
+	if(entry){
+		entry->rc = rc;
+		memcpy(entry->topic, ed->topic, len+1);
+		HASH_ADD(hh, *entries, topic, len, entry);
+	}
+	return rc;
+}
+
+
+int dynsec__acl_disconnect_callback(int event, void *event_data, void *userdata)
+{
+	struct mosquitto_evt_disconnect *ed = event_data;
+	struct dynsec__data *data = userdata;
+	struct dynsec__acl_cache *cache;
+	const char *clientid;
+
+	UNUSED(event);
+
+	clientid = mosquitto_client_id(ed->client);
+	if(clientid){
+		HASH_FIND(hh, data->acl_cache, clientid, strlen(clientid), cache);
+		if(cache){
+			acl_cache__free(data, cache);
+		}
+	}
+	return MOSQ_ERR_SUCCESS;
+}
+
+
 /* ################################################################
  * #
  * # ACL check - plugin callback
@@ -294,10 +468,10 @@ int dynsec__acl_check_callback(int event, void *event_data, void *userdata)
 			return acl_check(data, event_data, acl_check_unsubscribe, data->default_access.unsubscribe);
 			break;
 		case MOSQ_ACL_WRITE: /* Client to broker */
-			return acl_check(data, event_data, acl_check_publish_c_send, data->default_access.publish_c_send);
+			return acl_check_cached(data, event_data, acl_check_publish_c_send, data->default_access.publish_c_send);
 			break;
 		case MOSQ_ACL_READ:
-			return acl_check(data, event_data, acl_check_publish_c_recv, data->default_access.publish_c_recv);
+			return acl_check_cached(data, event_data, acl_check_publish_c_recv, data->default_access.publish_c_recv);
 			break;
 		default:
 			return MOSQ_ERR_PLUGIN_DEFER;
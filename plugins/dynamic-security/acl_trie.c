@@ -0,0 +1,260 @@
+/*
+Copyright (c) 2026 Roger Light <roger@atchoo.org>
+
+All rights reserved. This program and the accompanying materials
+are made available under the terms of the Eclipse Public License 2.0
+and Eclipse Distribution License v1.0 which accompany this distribution.
+
+The Eclipse Public License is available at
+   https://www.eclipse.org/legal/epl-2.0/
+and the Eclipse Distribution License is available at
+  http://www.eclipse.org/org/documents/edl-v10.php.
+
+SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+
+Contributors:
+   Roger Light - initial implementation and documentation.
+*/
+
+#include "config.h"
+
+#include <string.h>
+
+#include "mosquitto.h"
+
+#include "dynamic_security.h"
+
+/* Publish ACL topic trie
+ *
+ * The publish ACLs of a role are compiled into a trie with one node per topic
+ * level. Each node has literal children, plus a child for each of `+`, `%c`
+ * and `%u`. An ACL ending at a node is stored in `acl`, and an ACL ending in
+ * `/#` is stored in `acl_hash` of the node for the level before the `#`.
+ * Every ACL is given its position in the priority ordered list, so checking a
+ * topic is a single walk of the trie, keeping the matching ACL with the lowest
+ * position - the same ACL that checking the list in order would have found
+ * first.
+ *
+ * Only lists where every topic passes mosquitto_sub_topic_check() are
+ * compiled, because the matching rules for invalid topics depend on the
+ * topic being checked. Those lists are still checked one ACL at a time.
+ */
+
+struct acl_trie_match {
+	const char *clientid;
+	size_t clientid_len;
+	const char *username;
+	size_t username_len;
+	struct dynsec__acl *acl;
+	int order;
+};
+
+
+static struct dynsec__acl_trie_node *node__new(const char *level, size_t len)
+{
+	struct dynsec__acl_trie_node *node;
+
+	node = mosquitto_calloc(1, sizeof(struct dynsec__acl_trie_node) + len + 1);
+	if(node){
+		memcpy(node->level, level, len);
+	}
+	return node;
+}
+
+
+void dynsec_acl_trie__free(struct dynsec__acl_trie_node **node)
+{
+	struct dynsec__acl_trie_node *child, *child_tmp;
+
+	if(*node == NULL){
+		return;
+	}
+
+	HASH_ITER(hh, (*node)->children, child, child_tmp){
+		HASH_DELETE(hh, (*node)->children, child);
+		dynsec_acl_trie__free(&child);
+	}
+	dynsec_acl_trie__free(&(*node)->plus);
+	dynsec_acl_trie__free(&(*node)->clientid);
+	dynsec_acl_trie__free(&(*node)->username);
+	mosquitto_free(*node);
+	*node = NULL;
+}
+
+
+static struct dynsec__acl_trie_node *node__child(struct dynsec__acl_trie_node *node, const char *level, size_t len)
+{
+	struct dynsec__acl_trie_node **special = NULL;
+	struct dynsec__acl_trie_node *child;
+
+	if(len == 1 && level[0] == '+'){
+		special = &node->plus;
+	}else if(len == 2 && level[0] == '%' && level[1] == 'c'){
+		special = &node->clientid;
+	}else if(len == 2 && level[0] == '%' && level[1] == 'u'){
+		special = &node->username;
+	}
+
+	if(special){
+		if(*special == NULL){
+			*special = node__new(level, len);
+		}
+		return *special;
+	}
+
+	HASH_FIND(hh, node->children, level, len, child);
+	if(child == NULL){
+		child = node__new(level, len);
+		if(child == NULL){
+			return NULL;
+		}
+		HASH_ADD(hh, node->children, level, len, child);
+	}
+	return child;
+}
+
+
+static int trie__add(struct dynsec__acl_trie_node *root, struct dynsec__acl *acl, int order)
+{
+	struct dynsec__acl_trie_node *node = root;
+	const char *level = acl->topic;
+	const char *end;
+	size_t len;
+
+	while(1){
+		end = strchr(level, '/');
+		len = end ? (size_t)(end - level) : strlen(level);
+
+		if(len == 1 && level[0] == '#'){
+			/* Only the first ACL, in priority order, for a topic is used */
+			if(node->acl_hash == NULL){
+				node->acl_hash = acl;
+				node->order_hash = order;
+			}
+			return MOSQ_ERR_SUCCESS;
+		}
+
+		node = node__child(node, level, len);
+		if(node == NULL){
+			return MOSQ_ERR_NOMEM;
+		}
+		if(end == NULL){
+			if(node->acl == NULL){
+				node->acl = acl;
+				node->order = order;
+			}
+			return MOSQ_ERR_SUCCESS;
+		}
+		level = end + 1;
+	}
+}
+
+
+int dynsec_acl_trie__build(struct dynsec__acl *acllist, struct dynsec__acl_trie_node **root)
+{
+	struct dynsec__acl *acl, *acl_tmp;
+	int order = 0;
+	int rc;
+
+	dynsec_acl_trie__free(root);
+	if(acllist == NULL){
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	HASH_ITER(hh, acllist, acl, acl_tmp){
+		if(mosquitto_sub_topic_check(acl->topic) != MOSQ_ERR_SUCCESS){
+			return MOSQ_ERR_INVAL;
+		}
+	}
+
+	*root = node__new("", 0);
+	if(*root == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	HASH_ITER(hh, acllist, acl, acl_tmp){
+		rc = trie__add(*root, acl, order);
+		if(rc){
+			dynsec_acl_trie__free(root);
+			return rc;
+		}
+		order++;
+	}
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+static void match__candidate(struct acl_trie_match *match, struct dynsec__acl *acl, int order)
+{
+	if(acl && (match->acl == NULL || order < match->order)){
+		match->acl = acl;
+		match->order = order;
+	}
+}
+
+
+static void trie__match(struct dynsec__acl_trie_node *node, const char *level, bool is_root, bool is_sys, struct acl_trie_match *match)
+{
+	struct dynsec__acl_trie_node *child;
+	const char *end, *next;
+	size_t len;
+
+	/* Wildcards and patterns in the first level never match topics starting
+	 * with $ */
+	if(!(is_root && is_sys)){
+		match__candidate(match, node->acl_hash, node->order_hash);
+	}
+	if(level == NULL){
+		match__candidate(match, node->acl, node->order);
+		return;
+	}
+	if(match->acl && match->order == 0){
+		/* Nothing can take priority over the first ACL */
+		return;
+	}
+
+	end = strchr(level, '/');
+	if(end){
+		len = (size_t)(end - level);
+		next = end + 1;
+	}else{
+		len = strlen(level);
+		next = NULL;
+	}
+
+	HASH_FIND(hh, node->children, level, len, child);
+	if(child){
+		trie__match(child, next, false, false, match);
+	}
+	if(is_root && is_sys){
+		return;
+	}
+	if(node->plus){
+		trie__match(node->plus, next, false, false, match);
+	}
+	if(node->clientid && match->clientid_len == len && len > 0
+			&& !memcmp(match->clientid, level, len)){
+
+		trie__match(node->clientid, next, false, false, match);
+	}
+	if(node->username && match->username_len == len && len > 0
+			&& !memcmp(match->username, level, len)){
+
+		trie__match(node->username, next, false, false, match);
+	}
+}
+
+
+struct dynsec__acl *dynsec_acl_trie__match(struct dynsec__acl_trie_node *root, const char *topic, const char *clientid, const char *username)
+{
+	struct acl_trie_match match;
+
+	memset(&match, 0, sizeof(match));
+	match.clientid = clientid;
+	match.clientid_len = clientid ? strlen(clientid) : 0;
+	match.username = username;
+	match.username_len = username ? strlen(username) : 0;
+
+	trie__match(root, topic, true, topic[0] == '$', &match);
+
+	return match.acl;
+}
@@ -58,10 +58,13 @@ int dynsec_auth__basic_auth_callback(int event, void *event_data, void *userdata
 				return MOSQ_ERR_AUTH;
 			}
 		}
-		if(mosquitto_pw_verify(client->pw, ed->password) == MOSQ_ERR_SUCCESS){
-			return MOSQ_ERR_SUCCESS;
-		}else{
-			return MOSQ_ERR_AUTH;
+		switch(mosquitto_basic_auth_pw_verify(ed->client, dynsec_clients__pw(client), ed->password)){
+			case MOSQ_ERR_SUCCESS:
+				return MOSQ_ERR_SUCCESS;
+			case MOSQ_ERR_AUTH_DELAYED:
+				return MOSQ_ERR_AUTH_DELAYED;
+			default:
+				return MOSQ_ERR_AUTH;
 		}
 	}else{
 		return MOSQ_ERR_PLUGIN_DEFER;
@@ -100,7 +100,7 @@ cJSON *dynsec_clientlist__all_to_json(struct dynsec__clientlist *base_clientlist
 }
 
 
-int dynsec_clientlist__add(struct dynsec__clientlist **base_clientlist, struct dynsec__client *client, int priority)
+static int clientlist__add(struct dynsec__clientlist **base_clientlist, struct dynsec__client *client, int priority, bool inorder)
 {
 	struct dynsec__clientlist *clientlist;
 
@@ -117,12 +117,53 @@ int dynsec_clientlist__add(struct dynsec__clientlist **base_clientlist, struct d
 
 	clientlist->client = client;
 	clientlist->priority = priority;
-	HASH_ADD_KEYPTR_INORDER(hh, *base_clientlist, client->username, strlen(client->username), clientlist, dynsec_clientlist__cmp);
+	if(inorder){
+		HASH_ADD_KEYPTR_INORDER(hh, *base_clientlist, client->username, strlen(client->username), clientlist, dynsec_clientlist__cmp);
+	}else{
+		HASH_ADD_KEYPTR(hh, *base_clientlist, client->username, strlen(client->username), clientlist);
+	}
 
 	return MOSQ_ERR_SUCCESS;
 }
 
 
+int dynsec_clientlist__add(struct dynsec__clientlist **base_clientlist, struct dynsec__client *client, int priority)
+{
+	return clientlist__add(base_clientlist, client, priority, true);
+}
+
+
+/* As dynsec_clientlist__add(), but the client goes on the end of the list.
+ * Inserting in order means walking the list, so when adding many clients it
+ * is much cheaper to append them all and sort the list once afterwards. */
+int dynsec_clientlist__append(struct dynsec__clientlist **base_clientlist, struct dynsec__client *client, int priority)
+{
+	return clientlist__add(base_clientlist, client, priority, false);
+}
+
+
+/* Sort the client lists of every role and group that has had clients
+ * appended to it. */
+void dynsec_clientlist__sort_all(struct dynsec__data *data)
+{
+	struct dynsec__role *role, *role_tmp;
+	struct dynsec__group *group, *group_tmp;
+
+	HASH_ITER(hh, data->roles, role, role_tmp){
+		if(role->clientlist_unsorted){
+			HASH_SORT(role->clientlist, dynsec_clientlist__cmp);
+			role->clientlist_unsorted = false;
+		}
+	}
+	HASH_ITER(hh, data->groups, group, group_tmp){
+		if(group->clientlist_unsorted){
+			HASH_SORT(group->clientlist, dynsec_clientlist__cmp);
+			group->clientlist_unsorted = false;
+		}
+	}
+}
+
+
 void dynsec_clientlist__cleanup(struct dynsec__clientlist **base_clientlist)
 {
 	struct dynsec__clientlist *clientlist, *clientlist_tmp;
@@ -87,6 +87,7 @@ static void client__free_item(struct dynsec__data *data, struct dynsec__client *
 	dynsec_rolelist__cleanup(&client->rolelist);
 	dynsec__remove_client_from_all_groups(data, client->username);
 	mosquitto_pw_cleanup(client->pw);
+	mosquitto_free(client->encoded_password);
 	mosquitto_free(client->text_name);
 	mosquitto_free(client->text_description);
 	mosquitto_free(client->clientid);
@@ -94,6 +95,16 @@ static void client__free_item(struct dynsec__data *data, struct dynsec__client *
 }
 
 
+/* Remove a client that is in data->clients, along with its group and role
+ * memberships. */
+static void client__delete(struct dynsec__data *data, struct dynsec__client *client)
+{
+	dynsec__remove_client_from_all_groups(data, client->username);
+	client__remove_all_roles(client);
+	client__free_item(data, client);
+}
+
+
 void dynsec_clients__cleanup(struct dynsec__data *data)
 {
 	struct dynsec__client *client, *client_tmp;
@@ -111,171 +122,203 @@ void dynsec_clients__cleanup(struct dynsec__data *data)
  * ################################################################ */
 
 
-int dynsec_clients__config_load(struct dynsec__data *data, cJSON *tree)
+struct mosquitto_pw *dynsec_clients__pw(struct dynsec__client *client)
 {
-	cJSON *j_clients, *j_client = NULL, *j_roles, *j_role;
+	if(client->pw == NULL && client->encoded_password){
+		if(mosquitto_pw_new(&client->pw, MOSQ_PW_DEFAULT)){
+			return NULL;
+		}
+		if(mosquitto_pw_decode(client->pw, client->encoded_password) == MOSQ_ERR_NOMEM){
+			mosquitto_pw_cleanup(client->pw);
+			client->pw = NULL;
+			return NULL;
+		}
+		/* If the encoding can't be decoded pw is left invalid, so the password
+		 * is not saved again. */
+		mosquitto_FREE(client->encoded_password);
+	}
+	return client->pw;
+}
+
+
+int dynsec_clients__config_load_item(struct dynsec__data *data, cJSON *j_client)
+{
+	cJSON *j_roles, *j_role;
 	struct dynsec__client *client;
 	struct dynsec__role *role;
 	int priority;
 
-	j_clients = cJSON_GetObjectItem(tree, "clients");
-	if(j_clients == NULL){
+	/* Username */
+	const char *username;
+	if(json_get_string(j_client, "username", &username, false) != MOSQ_ERR_SUCCESS){
+		return 0;
+	}
+	size_t username_len = strlen(username);
+	if(username_len == 0){
+		return 0;
+	}
+	if(dynsec_clients__find(data, username)){
 		return 0;
 	}
 
-	if(cJSON_IsArray(j_clients) == false){
-		return 1;
+	client = mosquitto_calloc(1, sizeof(struct dynsec__client) + username_len + 1);
+	if(client == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	strncpy(client->username, username, username_len);
+
+	bool disabled;
+	if(json_get_bool(j_client, "disabled", &disabled, false, false) == MOSQ_ERR_SUCCESS){
+		client->disabled = disabled;
 	}
-	cJSON_ArrayForEach(j_client, j_clients){
-		if(cJSON_IsObject(j_client) == true){
-			/* Username */
-			const char *username;
-			if(json_get_string(j_client, "username", &username, false) != MOSQ_ERR_SUCCESS){
-				continue;
-			}
-			size_t username_len = strlen(username);
-			if(username_len == 0){
-				continue;
-			}
-			if(dynsec_clients__find(data, username)){
-				continue;
-			}
 
-			client = mosquitto_calloc(1, sizeof(struct dynsec__client) + username_len + 1);
-			if(client == NULL){
+	/* The password is kept encoded until the client first authenticates, see
+	 * dynsec_clients__pw() */
+	const char *password;
+	if(json_get_string(j_client, "encoded_password", &password, false) == MOSQ_ERR_SUCCESS){
+		if(password[0] == '$'){
+			client->encoded_password = mosquitto_strdup(password);
+			if(client->encoded_password == NULL){
+				mosquitto_free(client);
 				return MOSQ_ERR_NOMEM;
 			}
-			strncpy(client->username, username, username_len);
-
-			bool disabled;
-			if(json_get_bool(j_client, "disabled", &disabled, false, false) == MOSQ_ERR_SUCCESS){
-				client->disabled = disabled;
+		}
+	}else{
+		/* sha512-pbkdf2 only */
+		int iterations;
+		const char *salt;
+		json_get_int(j_client, "iterations", &iterations, true, 0);
+		if(json_get_string(j_client, "salt", &salt, false) == MOSQ_ERR_SUCCESS
+				&& json_get_string(j_client, "password", &password, false) == MOSQ_ERR_SUCCESS
+				&& iterations > 0){
+
+			char buf[1024];
+			snprintf(buf, sizeof(buf), "$7$%d$%s$%s", iterations, salt, password);
+			client->encoded_password = mosquitto_strdup(buf);
+			if(client->encoded_password == NULL){
+				mosquitto_free(client);
+				return MOSQ_ERR_NOMEM;
 			}
+		}
+	}
 
-			const char *password;
-			if(json_get_string(j_client, "encoded_password", &password, false) == MOSQ_ERR_SUCCESS){
-				if(!client->pw && mosquitto_pw_new(&client->pw, MOSQ_PW_DEFAULT)){
-					return MOSQ_ERR_NOMEM;
-				}
-				if(mosquitto_pw_decode(client->pw, password) == MOSQ_ERR_NOMEM){
-					return MOSQ_ERR_NOMEM;
-				}
-			}else{
-				/* sha512-pbkdf2 only */
-				int iterations;
-				const char *salt;
-				json_get_int(j_client, "iterations", &iterations, true, 0);
-				if(json_get_string(j_client, "salt", &salt, false) == MOSQ_ERR_SUCCESS
-						&& json_get_string(j_client, "password", &password, false) == MOSQ_ERR_SUCCESS
-						&& iterations > 0){
-
-					char buf[1024];
-					if(!client->pw && mosquitto_pw_new(&client->pw, MOSQ_PW_SHA512_PBKDF2)){
-						return MOSQ_ERR_NOMEM;
+	/* Client id */
+	const char *clientid;
+	if(json_get_string(j_client, "clientid", &clientid, false) == MOSQ_ERR_SUCCESS){
+		client->clientid = mosquitto_strdup(clientid);
+		if(client->clientid == NULL){
+			mosquitto_free(client->encoded_password);
+			mosquitto_free(client);
+			return 0;
+		}
+	}
+
+	/* Text name */
+	const char *textname;
+	if(json_get_string(j_client, "textname", &textname, false) == MOSQ_ERR_SUCCESS){
+		client->text_name = mosquitto_strdup(textname);
+		if(client->text_name == NULL){
+			mosquitto_free(client->clientid);
+			mosquitto_free(client->encoded_password);
+			mosquitto_free(client);
+			return 0;
+		}
+	}
+
+	/* Text description */
+	const char *textdescription;
+	if(json_get_string(j_client, "textdescription", &textdescription, false) == MOSQ_ERR_SUCCESS){
+		client->text_description = mosquitto_strdup(textdescription);
+		if(client->text_description == NULL){
+			mosquitto_free(client->text_name);
+			mosquitto_free(client->clientid);
+			mosquitto_free(client->encoded_password);
+			mosquitto_free(client);
+			return 0;
+		}
+	}
+
+	/* Roles */
+	j_roles = cJSON_GetObjectItem(j_client, "roles");
+	if(j_roles && cJSON_IsArray(j_roles)){
+		cJSON_ArrayForEach(j_role, j_roles){
+			if(cJSON_IsObject(j_role)){
+				const char *rolename;
+				if(json_get_string(j_role, "rolename", &rolename, false) == MOSQ_ERR_SUCCESS){
+					json_get_int(j_role, "priority", &priority, true, -1);
+					if(priority > PRIORITY_MAX){
+						priority = PRIORITY_MAX;
 					}
-					snprintf(buf, sizeof(buf), "$7$%d$%s$%s", iterations, salt, password);
-					mosquitto_pw_decode(client->pw, buf);
-				}else{
-					mosquitto_pw_set_valid(client->pw, false);
+					if(priority < -PRIORITY_MAX){
+						priority = -PRIORITY_MAX;
+					}
+					role = dynsec_roles__find(data, rolename);
+					dynsec_rolelist__client_add(client, role, priority);
 				}
 			}
+		}
+	}
 
-			/* Client id */
-			const char *clientid;
-			if(json_get_string(j_client, "clientid", &clientid, false) == MOSQ_ERR_SUCCESS){
-				client->clientid = mosquitto_strdup(clientid);
-				if(client->clientid == NULL){
-					mosquitto_free(client);
-					continue;
-				}
-			}
+	HASH_ADD(hh, data->clients, username, username_len, client);
 
-			/* Text name */
-			const char *textname;
-			if(json_get_string(j_client, "textname", &textname, false) == MOSQ_ERR_SUCCESS){
-				client->text_name = mosquitto_strdup(textname);
-				if(client->text_name == NULL){
-					mosquitto_free(client->clientid);
-					mosquitto_free(client);
-					continue;
-				}
-			}
+	return 0;
+}
 
-			/* Text description */
-			const char *textdescription;
-			if(json_get_string(j_client, "textdescription", &textdescription, false) == MOSQ_ERR_SUCCESS){
-				client->text_description = mosquitto_strdup(textdescription);
-				if(client->text_description == NULL){
-					mosquitto_free(client->text_name);
-					mosquitto_free(client->clientid);
-					mosquitto_free(client);
-					continue;
-				}
-			}
 
-			/* Roles */
-			j_roles = cJSON_GetObjectItem(j_client, "roles");
-			if(j_roles && cJSON_IsArray(j_roles)){
-				cJSON_ArrayForEach(j_role, j_roles){
-					if(cJSON_IsObject(j_role)){
-						const char *rolename;
-						if(json_get_string(j_role, "rolename", &rolename, false) == MOSQ_ERR_SUCCESS){
-							json_get_int(j_role, "priority", &priority, true, -1);
-							if(priority > PRIORITY_MAX){
-								priority = PRIORITY_MAX;
-							}
-							if(priority < -PRIORITY_MAX){
-								priority = -PRIORITY_MAX;
-							}
-							role = dynsec_roles__find(data, rolename);
-							dynsec_rolelist__client_add(client, role, priority);
-						}
-					}
-				}
-			}
+static cJSON *client__config_item(struct dynsec__client *client)
+{
+	cJSON *j_client, *j_roles;
+
+	j_client = cJSON_CreateObject();
+	if(j_client == NULL){
+		return NULL;
+	}
+
+	if(cJSON_AddStringToObject(j_client, "username", client->username) == NULL
+			|| (client->clientid && cJSON_AddStringToObject(j_client, "clientid", client->clientid) == NULL)
+			|| (client->text_name && cJSON_AddStringToObject(j_client, "textname", client->text_name) == NULL)
+			|| (client->text_description && cJSON_AddStringToObject(j_client, "textdescription", client->text_description) == NULL)
+			|| (client->disabled && cJSON_AddBoolToObject(j_client, "disabled", true) == NULL)
+			){
+
+		cJSON_Delete(j_client);
+		return NULL;
+	}
+
+	j_roles = dynsec_rolelist__all_to_json(client->rolelist);
+	if(j_roles == NULL){
+		cJSON_Delete(j_client);
+		return NULL;
+	}
+	cJSON_AddItemToObject(j_client, "roles", j_roles);
 
-			HASH_ADD(hh, data->clients, username, username_len, client);
+	if(mosquitto_pw_is_valid(client->pw)){
+		if(cJSON_AddStringToObject(j_client, "encoded_password", mosquitto_pw_get_encoded(client->pw)) == NULL){
+			cJSON_Delete(j_client);
+			return NULL;
+		}
+	}else if(client->encoded_password){
+		if(cJSON_AddStringToObject(j_client, "encoded_password", client->encoded_password) == NULL){
+			cJSON_Delete(j_client);
+			return NULL;
 		}
 	}
-	HASH_SORT(data->clients, client_cmp);
 
-	return 0;
+	return j_client;
 }
 
 
 static int dynsec__config_add_clients(struct dynsec__data *data, cJSON *j_clients)
 {
 	struct dynsec__client *client, *client_tmp;
-	cJSON *j_client, *j_roles;
+	cJSON *j_client;
 
 	HASH_ITER(hh, data->clients, client, client_tmp){
-		j_client = cJSON_CreateObject();
+		j_client = client__config_item(client);
 		if(j_client == NULL){
 			return 1;
 		}
 		cJSON_AddItemToArray(j_clients, j_client);
-
-		if(cJSON_AddStringToObject(j_client, "username", client->username) == NULL
-				|| (client->clientid && cJSON_AddStringToObject(j_client, "clientid", client->clientid) == NULL)
-				|| (client->text_name && cJSON_AddStringToObject(j_client, "textname", client->text_name) == NULL)
-				|| (client->text_description && cJSON_AddStringToObject(j_client, "textdescription", client->text_description) == NULL)
-				|| (client->disabled && cJSON_AddBoolToObject(j_client, "disabled", true) == NULL)
-				){
-
-			return 1;
-		}
-
-		j_roles = dynsec_rolelist__all_to_json(client->rolelist);
-		if(j_roles == NULL){
-			return 1;
-		}
-		cJSON_AddItemToObject(j_client, "roles", j_roles);
-
-		if(mosquitto_pw_is_valid(client->pw)){
-			if(cJSON_AddStringToObject(j_client, "encoded_password", mosquitto_pw_get_encoded(client->pw)) == NULL){
-				return 1;
-			}
-		}
 	}
 
 	return 0;
@@ -297,83 +340,159 @@ int dynsec_clients__config_save(struct dynsec__data *data, cJSON *tree)
 }
 
 
-int dynsec_clients__process_create(struct dynsec__data *data, struct mosquitto_control_cmd *cmd)
+/* ################################################################
+ * #
+ * # Journal
+ * #
+ * ################################################################ */
+
+
+/* A journal record for a client also carries its group memberships, so the
+ * record on its own describes every relationship the client owns. */
+cJSON *dynsec_clients__journal_item(struct dynsec__client *client)
+{
+	cJSON *j_client, *j_groups;
+
+	j_client = client__config_item(client);
+	if(j_client == NULL){
+		return NULL;
+	}
+	j_groups = dynsec_grouplist__all_to_json(client->grouplist);
+	if(j_groups == NULL){
+		cJSON_Delete(j_client);
+		return NULL;
+	}
+	cJSON_AddItemToObject(j_client, "groups", j_groups);
+
+	return j_client;
+}
+
+
+void dynsec_clients__journal_delete(struct dynsec__data *data, const char *username)
 {
-	const char *username, *password, *clientid = NULL;
-	const char *text_name, *text_description;
 	struct dynsec__client *client;
-	int rc;
+
+	client = dynsec_clients__find(data, username);
+	if(client){
+		client__delete(data, client);
+	}
+}
+
+
+/* Replace any existing client with the one described by a journal record. */
+int dynsec_clients__journal_apply(struct dynsec__data *data, cJSON *j_client)
+{
 	cJSON *j_groups, *j_group;
+	const char *username, *groupname;
 	int priority;
-	const char *admin_clientid, *admin_username;
+	int rc;
+
+	if(json_get_string(j_client, "username", &username, false) != MOSQ_ERR_SUCCESS){
+		return MOSQ_ERR_INVAL;
+	}
+	dynsec_clients__journal_delete(data, username);
+
+	rc = dynsec_clients__config_load_item(data, j_client);
+	if(rc){
+		return rc;
+	}
+
+	j_groups = cJSON_GetObjectItem(j_client, "groups");
+	if(j_groups && cJSON_IsArray(j_groups)){
+		cJSON_ArrayForEach(j_group, j_groups){
+			if(cJSON_IsObject(j_group)
+					&& json_get_string(j_group, "groupname", &groupname, false) == MOSQ_ERR_SUCCESS){
+
+				json_get_int(j_group, "priority", &priority, true, -1);
+				dynsec_groups__add_client(data, username, groupname, priority, false);
+			}
+		}
+	}
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+void dynsec_clients__sort(struct dynsec__data *data)
+{
+	HASH_SORT(data->clients, client_cmp);
+}
+
+
+/* Build a new client from a createClient command, or from one item of a
+ * createClients command. The client is not added to data->clients, and
+ * neither its roles nor any groups refer to it yet. */
+static int client__new_from_json(struct dynsec__data *data, cJSON *j_client, struct dynsec__client **client_out, const char **error)
+{
+	const char *username, *password, *clientid = NULL;
+	const char *text_name, *text_description;
+	struct dynsec__client *client;
 	size_t username_len;
+	int rc;
 
-	if(json_get_string(cmd->j_command, "username", &username, false) != MOSQ_ERR_SUCCESS){
-		mosquitto_control_command_reply(cmd, "Invalid/missing username");
+	*client_out = NULL;
+
+	if(json_get_string(j_client, "username", &username, false) != MOSQ_ERR_SUCCESS){
+		*error = "Invalid/missing username";
 		return MOSQ_ERR_INVAL;
 	}
 	username_len = strlen(username);
 	if(username_len == 0){
-		mosquitto_control_command_reply(cmd, "Empty username");
+		*error = "Empty username";
 		return MOSQ_ERR_INVAL;
 	}
 	if(mosquitto_validate_utf8(username, (int)username_len) != MOSQ_ERR_SUCCESS){
-		mosquitto_control_command_reply(cmd, "Username not valid UTF-8");
+		*error = "Username not valid UTF-8";
 		return MOSQ_ERR_INVAL;
 	}
 
-	if(json_get_string(cmd->j_command, "password", &password, true) != MOSQ_ERR_SUCCESS){
-		mosquitto_control_command_reply(cmd, "Invalid/missing password");
+	if(json_get_string(j_client, "password", &password, true) != MOSQ_ERR_SUCCESS){
+		*error = "Invalid/missing password";
 		return MOSQ_ERR_INVAL;
 	}
 
-	if(json_get_string(cmd->j_command, "clientid", &clientid, true) != MOSQ_ERR_SUCCESS){
-		mosquitto_control_command_reply(cmd, "Invalid/missing client id");
+	if(json_get_string(j_client, "clientid", &clientid, true) != MOSQ_ERR_SUCCESS){
+		*error = "Invalid/missing client id";
 		return MOSQ_ERR_INVAL;
 	}
 	if(clientid && mosquitto_validate_utf8(clientid, (int)strlen(clientid)) != MOSQ_ERR_SUCCESS){
-		mosquitto_control_command_reply(cmd, "Client ID not valid UTF-8");
+		*error = "Client ID not valid UTF-8";
 		return MOSQ_ERR_INVAL;
 	}
 
-
-	if(json_get_string(cmd->j_command, "textname", &text_name, true) != MOSQ_ERR_SUCCESS){
-		mosquitto_control_command_reply(cmd, "Invalid/missing textname");
+	if(json_get_string(j_client, "textname", &text_name, true) != MOSQ_ERR_SUCCESS){
+		*error = "Invalid/missing textname";
 		return MOSQ_ERR_INVAL;
 	}
 
-	if(json_get_string(cmd->j_command, "textdescription", &text_description, true) != MOSQ_ERR_SUCCESS){
-		mosquitto_control_command_reply(cmd, "Invalid/missing textdescription");
+	if(json_get_string(j_client, "textdescription", &text_description, true) != MOSQ_ERR_SUCCESS){
+		*error = "Invalid/missing textdescription";
 		return MOSQ_ERR_INVAL;
 	}
 
-	client = dynsec_clients__find(data, username);
-	if(client){
-		mosquitto_control_command_reply(cmd, "Client already exists");
-		return MOSQ_ERR_SUCCESS;
+	if(dynsec_clients__find(data, username)){
+		*error = "Client already exists";
+		return MOSQ_ERR_ALREADY_EXISTS;
 	}
 
 	client = mosquitto_calloc(1, sizeof(struct dynsec__client) + username_len + 1);
 	if(client == NULL){
-		mosquitto_control_command_reply(cmd, "Internal error");
+		*error = "Internal error";
 		return MOSQ_ERR_NOMEM;
 	}
 	strncpy(client->username, username, username_len);
 
+	*error = "Internal error";
+	rc = MOSQ_ERR_NOMEM;
 	if(text_name){
 		client->text_name = mosquitto_strdup(text_name);
 		if(client->text_name == NULL){
-			mosquitto_control_command_reply(cmd, "Internal error");
-			client__free_item(data, client);
-			return MOSQ_ERR_NOMEM;
+			goto error;
 		}
 	}
 	if(text_description){
 		client->text_description = mosquitto_strdup(text_description);
 		if(client->text_description == NULL){
-			mosquitto_control_command_reply(cmd, "Internal error");
-			client__free_item(data, client);
-			return MOSQ_ERR_NOMEM;
+			goto error;
 		}
 	}
 
@@ -382,38 +501,88 @@ int dynsec_clients__process_create(struct dynsec__data *data, struct mosquitto_c
 				|| mosquitto_pw_hash_encoded(client->pw, password)
 				){
 
-			mosquitto_control_command_reply(cmd, "Internal error");
-			client__free_item(data, client);
-			return MOSQ_ERR_NOMEM;
+			goto error;
 		}
 	}
 	if(clientid && strlen(clientid) > 0){
 		client->clientid = mosquitto_strdup(clientid);
 		if(client->clientid == NULL){
-			mosquitto_control_command_reply(cmd, "Internal error");
-			client__free_item(data, client);
-			return MOSQ_ERR_NOMEM;
+			goto error;
 		}
 	}
 
-	rc = dynsec_rolelist__load_from_json(data, cmd->j_command, &client->rolelist);
+	rc = dynsec_rolelist__load_from_json(data, j_client, &client->rolelist);
 	if(rc == MOSQ_ERR_SUCCESS || rc == ERR_LIST_NOT_FOUND){
 	}else if(rc == MOSQ_ERR_NOT_FOUND){
-		mosquitto_control_command_reply(cmd, "Role not found");
-		client__free_item(data, client);
-		return MOSQ_ERR_INVAL;
+		*error = "Role not found";
+		rc = MOSQ_ERR_INVAL;
+		goto error;
 	}else{
 		if(rc == MOSQ_ERR_INVAL){
-			mosquitto_control_command_reply(cmd, "'roles' not an array or missing/invalid rolename");
+			*error = "'roles' not an array or missing/invalid rolename";
+		}
+		rc = MOSQ_ERR_INVAL;
+		goto error;
+	}
+
+	*error = NULL;
+	*client_out = client;
+	return MOSQ_ERR_SUCCESS;
+error:
+	client__free_item(data, client);
+	return rc;
+}
+
+
+/* Add a new client to the client lists of the roles in its rolelist. With
+ * append set the role client lists are left for dynsec_clientlist__sort_all()
+ * to put in order. */
+static int client__link_roles(struct dynsec__client *client, bool append)
+{
+	struct dynsec__rolelist *rolelist, *rolelist_tmp;
+	int rc;
+
+	HASH_ITER(hh, client->rolelist, rolelist, rolelist_tmp){
+		if(append){
+			rc = dynsec_clientlist__append(&rolelist->role->clientlist, client, rolelist->priority);
+			rolelist->role->clientlist_unsorted = true;
 		}else{
-			mosquitto_control_command_reply(cmd, "Internal error");
+			rc = dynsec_clientlist__add(&rolelist->role->clientlist, client, rolelist->priority);
 		}
-		client__free_item(data, client);
-		return MOSQ_ERR_INVAL;
+		if(rc){
+			return rc;
+		}
+	}
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+int dynsec_clients__process_create(struct dynsec__data *data, struct mosquitto_control_cmd *cmd)
+{
+	struct dynsec__client *client;
+	const char *error;
+	int rc;
+	cJSON *j_groups, *j_group;
+	int priority;
+	const char *admin_clientid, *admin_username;
+
+	rc = client__new_from_json(data, cmd->j_command, &client, &error);
+	if(rc == MOSQ_ERR_ALREADY_EXISTS){
+		mosquitto_control_command_reply(cmd, error);
+		return MOSQ_ERR_SUCCESS;
+	}else if(rc){
+		mosquitto_control_command_reply(cmd, error);
+		return rc;
 	}
 
 	/* Must add user before groups, otherwise adding groups will fail */
-	HASH_ADD_INORDER(hh, data->clients, username, username_len, client, client_cmp);
+	HASH_ADD_INORDER(hh, data->clients, username, strlen(client->username), client, client_cmp);
+
+	if(client__link_roles(client, false)){
+		mosquitto_control_command_reply(cmd, "Internal error");
+		client__delete(data, client);
+		return MOSQ_ERR_NOMEM;
+	}
 
 	j_groups = cJSON_GetObjectItem(cmd->j_command, "groups");
 	if(j_groups && cJSON_IsArray(j_groups)){
@@ -425,14 +594,14 @@ int dynsec_clients__process_create(struct dynsec__data *data, struct mosquitto_c
 					if(priority > PRIORITY_MAX){
 						priority = PRIORITY_MAX;
 					}
-					rc = dynsec_groups__add_client(data, username, groupname, priority, false);
+					rc = dynsec_groups__add_client(data, client->username, groupname, priority, false);
 					if(rc == ERR_GROUP_NOT_FOUND){
 						mosquitto_control_command_reply(cmd, "Group not found");
-						client__free_item(data, client);
+						client__delete(data, client);
 						return MOSQ_ERR_INVAL;
 					}else if(rc != MOSQ_ERR_SUCCESS){
 						mosquitto_control_command_reply(cmd, "Internal error");
-						client__free_item(data, client);
+						client__delete(data, client);
 						return MOSQ_ERR_INVAL;
 					}
 				}
@@ -447,12 +616,166 @@ int dynsec_clients__process_create(struct dynsec__data *data, struct mosquitto_c
 	admin_clientid = mosquitto_client_id(cmd->client);
 	admin_username = mosquitto_client_username(cmd->client);
 	mosquitto_log_printf(MOSQ_LOG_INFO, "dynsec: %s/%s | createClient | username=%s | password=%s",
-			admin_clientid, admin_username, username, password?"*****":"no password");
+			admin_clientid, admin_username, client->username, client->pw?"*****":"no password");
 
 	return MOSQ_ERR_SUCCESS;
 }
 
 
+/* Add a client that is in data->clients to the groups given in its
+ * createClients item. The groups have already been checked. */
+static int client__add_bulk_groups(struct dynsec__data *data, struct dynsec__client *client, cJSON *j_client)
+{
+	cJSON *j_groups, *j_group;
+	struct dynsec__group *group;
+	const char *groupname;
+	int priority;
+	int rc;
+
+	j_groups = cJSON_GetObjectItem(j_client, "groups");
+	if(j_groups == NULL || !cJSON_IsArray(j_groups)){
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	cJSON_ArrayForEach(j_group, j_groups){
+		if(cJSON_IsObject(j_group)
+				&& json_get_string(j_group, "groupname", &groupname, false) == MOSQ_ERR_SUCCESS){
+
+			group = dynsec_groups__find(data, groupname);
+			json_get_int(j_group, "priority", &priority, true, -1);
+			if(priority > PRIORITY_MAX){
+				priority = PRIORITY_MAX;
+			}
+			rc = dynsec_clientlist__append(&group->clientlist, client, priority);
+			if(rc){
+				return rc;
+			}
+			group->clientlist_unsorted = true;
+			rc = dynsec_grouplist__add(&client->grouplist, group, priority);
+			if(rc){
+				dynsec_clientlist__remove(&group->clientlist, client);
+				return rc;
+			}
+		}
+	}
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+/* createClients: as createClient, for an array of clients. Either every
+ * client is created or none are. */
+int dynsec_clients__process_create_bulk(struct dynsec__data *data, struct mosquitto_control_cmd *cmd)
+{
+	cJSON *j_clients, *j_client, *j_groups, *j_group;
+	struct dynsec__client *new_clients = NULL;
+	struct dynsec__client *client, *client_tmp;
+	const char *username, *groupname;
+	const char *error;
+	int index, count, failed_index;
+	int rc;
+	const char *admin_clientid, *admin_username;
+
+	j_clients = cJSON_GetObjectItem(cmd->j_command, "clients");
+	if(j_clients == NULL || !cJSON_IsArray(j_clients)){
+		mosquitto_control_command_reply(cmd, "Invalid/missing clients");
+		return MOSQ_ERR_INVAL;
+	}
+
+	/* Build every client before changing anything */
+	index = 0;
+	cJSON_ArrayForEach(j_client, j_clients){
+		if(!cJSON_IsObject(j_client)){
+			error = "Client not an object";
+			rc = MOSQ_ERR_INVAL;
+			goto error;
+		}
+		rc = client__new_from_json(data, j_client, &client, &error);
+		if(rc){
+			if(rc == MOSQ_ERR_ALREADY_EXISTS){
+				rc = MOSQ_ERR_INVAL;
+			}
+			goto error;
+		}
+		HASH_FIND(hh, new_clients, client->username, strlen(client->username), client_tmp);
+		if(client_tmp){
+			client__free_item(data, client);
+			error = "Duplicate username";
+			rc = MOSQ_ERR_INVAL;
+			goto error;
+		}
+		HASH_ADD(hh, new_clients, username, strlen(client->username), client);
+
+		j_groups = cJSON_GetObjectItem(j_client, "groups");
+		if(j_groups && cJSON_IsArray(j_groups)){
+			cJSON_ArrayForEach(j_group, j_groups){
+				if(cJSON_IsObject(j_group)
+						&& json_get_string(j_group, "groupname", &groupname, false) == MOSQ_ERR_SUCCESS
+						&& dynsec_groups__find(data, groupname) == NULL){
+
+					error = "Group not found";
+					rc = MOSQ_ERR_INVAL;
+					goto error;
+				}
+			}
+		}
+		index++;
+	}
+	count = index;
+
+	/* Only running out of memory can fail from here on */
+	index = 0;
+	cJSON_ArrayForEach(j_client, j_clients){
+		json_get_string(j_client, "username", &username, false);
+		HASH_FIND(hh, new_clients, username, strlen(username), client);
+		HASH_DELETE(hh, new_clients, client);
+		HASH_ADD(hh, data->clients, username, strlen(client->username), client);
+
+		if(client__link_roles(client, true) || client__add_bulk_groups(data, client, j_client)){
+			/* Undo this client and those before it */
+			failed_index = index;
+			client__delete(data, client);
+			cJSON_ArrayForEach(j_client, j_clients){
+				if(index == 0){
+					break;
+				}
+				json_get_string(j_client, "username", &username, false);
+				client__delete(data, dynsec_clients__find(data, username));
+				index--;
+			}
+			dynsec_clientlist__sort_all(data);
+			index = failed_index;
+			error = "Internal error";
+			rc = MOSQ_ERR_NOMEM;
+			goto error;
+		}
+		index++;
+	}
+
+	/* Sorting once is much cheaper than inserting each client in order */
+	dynsec_clients__sort(data);
+	dynsec_clientlist__sort_all(data);
+
+	dynsec__config_batch_save(data);
+
+	mosquitto_control_command_reply(cmd, NULL);
+
+	admin_clientid = mosquitto_client_id(cmd->client);
+	admin_username = mosquitto_client_username(cmd->client);
+	mosquitto_log_printf(MOSQ_LOG_INFO, "dynsec: %s/%s | createClients | count=%d",
+			admin_clientid, admin_username, count);
+
+	return MOSQ_ERR_SUCCESS;
+
+error:
+	HASH_ITER(hh, new_clients, client, client_tmp){
+		HASH_DELETE(hh, new_clients, client);
+		client__free_item(data, client);
+	}
+	dynsec__command_reply_item(cmd, "clients", index, error);
+	return rc;
+}
+
+
 int dynsec_clients__process_delete(struct dynsec__data *data, struct mosquitto_control_cmd *cmd)
 {
 	const char *username;
@@ -466,9 +789,7 @@ int dynsec_clients__process_delete(struct dynsec__data *data, struct mosquitto_c
 
 	client = dynsec_clients__find(data, username);
 	if(client){
-		dynsec__remove_client_from_all_groups(data, username);
-		client__remove_all_roles(client);
-		client__free_item(data, client);
+		client__delete(data, client);
 		dynsec__config_batch_save(data);
 		mosquitto_control_command_reply(cmd, NULL);
 
@@ -625,6 +946,7 @@ int dynsec_clients__process_set_id(struct dynsec__data *data, struct mosquitto_c
 
 static int client__set_password(struct dynsec__client *client, const char *password)
 {
+	mosquitto_FREE(client->encoded_password);
 	if(!client->pw){
 		if(mosquitto_pw_new(&client->pw, MOSQ_PW_DEFAULT)){
 			return MOSQ_ERR_NOMEM;
@@ -703,6 +1025,194 @@ static void client__remove_all_roles(struct dynsec__client *client)
 }
 
 
+/* Add a client to the client lists of the roles in new_rolelist that it
+ * doesn't already have. The client's own rolelist is left alone. */
+static int client__link_new_roles(struct dynsec__client *client, struct dynsec__rolelist *new_rolelist)
+{
+	struct dynsec__rolelist *rolelist, *rolelist_tmp, *found;
+	int rc;
+
+	HASH_ITER(hh, new_rolelist, rolelist, rolelist_tmp){
+		HASH_FIND(hh, client->rolelist, rolelist->rolename, strlen(rolelist->rolename), found);
+		if(found == NULL){
+			rc = dynsec_clientlist__append(&rolelist->role->clientlist, client, rolelist->priority);
+			if(rc){
+				return rc;
+			}
+			rolelist->role->clientlist_unsorted = true;
+		}
+	}
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+/* Undo client__link_new_roles(), including when it only partly succeeded. */
+static void client__unlink_new_roles(struct dynsec__client *client, struct dynsec__rolelist *new_rolelist)
+{
+	struct dynsec__rolelist *rolelist, *rolelist_tmp, *found;
+
+	HASH_ITER(hh, new_rolelist, rolelist, rolelist_tmp){
+		HASH_FIND(hh, client->rolelist, rolelist->rolename, strlen(rolelist->rolename), found);
+		if(found == NULL){
+			dynsec_clientlist__remove(&rolelist->role->clientlist, client);
+		}
+	}
+}
+
+
+/* Replace the roles of a client whose new roles have been linked with
+ * client__link_new_roles(). This only frees memory, so can't fail. */
+static void client__swap_roles(struct dynsec__client *client, struct dynsec__rolelist **new_rolelist)
+{
+	struct dynsec__rolelist *rolelist, *rolelist_tmp, *found;
+	struct dynsec__clientlist *clientlist;
+
+	HASH_ITER(hh, client->rolelist, rolelist, rolelist_tmp){
+		HASH_FIND(hh, *new_rolelist, rolelist->rolename, strlen(rolelist->rolename), found);
+		if(found){
+			/* Kept, but the priority may have changed */
+			HASH_FIND(hh, rolelist->role->clientlist, client->username, strlen(client->username), clientlist);
+			if(clientlist){
+				clientlist->priority = found->priority;
+			}
+		}else{
+			dynsec_clientlist__remove(&rolelist->role->clientlist, client);
+		}
+	}
+	dynsec_rolelist__cleanup(&client->rolelist);
+	client->rolelist = *new_rolelist;
+	*new_rolelist = NULL;
+}
+
+
+/* setClientRolesBulk: replace the roles of each of an array of clients. Every
+ * item is checked before any client is changed, and either every client gets
+ * its new roles or none do. */
+int dynsec_clients__process_set_roles_bulk(struct dynsec__data *data, struct mosquitto_control_cmd *cmd)
+{
+	cJSON *j_clients, *j_client;
+	struct dynsec__rolelist **rolelists = NULL;
+	struct dynsec__client **clients = NULL;
+	struct dynsec__clientlist *seen = NULL, *clientlist;
+	struct dynsec__client *client;
+	const char *username;
+	const char *error = NULL;
+	int index, count, i;
+	int rc = MOSQ_ERR_SUCCESS;
+	const char *admin_clientid, *admin_username;
+
+	j_clients = cJSON_GetObjectItem(cmd->j_command, "clients");
+	if(j_clients == NULL || !cJSON_IsArray(j_clients)){
+		mosquitto_control_command_reply(cmd, "Invalid/missing clients");
+		return MOSQ_ERR_INVAL;
+	}
+	count = cJSON_GetArraySize(j_clients);
+	if(count > 0){
+		rolelists = mosquitto_calloc((size_t)count, sizeof(struct dynsec__rolelist *));
+		clients = mosquitto_calloc((size_t)count, sizeof(struct dynsec__client *));
+		if(rolelists == NULL || clients == NULL){
+			mosquitto_free(rolelists);
+			mosquitto_free(clients);
+			mosquitto_control_command_reply(cmd, "Internal error");
+			return MOSQ_ERR_NOMEM;
+		}
+	}
+
+	index = 0;
+	cJSON_ArrayForEach(j_client, j_clients){
+		if(!cJSON_IsObject(j_client)){
+			error = "Client not an object";
+			rc = MOSQ_ERR_INVAL;
+			goto cleanup;
+		}
+		if(json_get_string(j_client, "username", &username, false) != MOSQ_ERR_SUCCESS){
+			error = "Invalid/missing username";
+			rc = MOSQ_ERR_INVAL;
+			goto cleanup;
+		}
+		client = dynsec_clients__find(data, username);
+		if(client == NULL){
+			error = "Client not found";
+			rc = MOSQ_ERR_INVAL;
+			goto cleanup;
+		}
+		HASH_FIND(hh, seen, username, strlen(username), clientlist);
+		if(clientlist){
+			error = "Duplicate username";
+			rc = MOSQ_ERR_INVAL;
+			goto cleanup;
+		}
+		if(dynsec_clientlist__append(&seen, client, 0)){
+			error = "Internal error";
+			rc = MOSQ_ERR_NOMEM;
+			goto cleanup;
+		}
+		clients[index] = client;
+
+		rc = dynsec_rolelist__load_from_json(data, j_client, &rolelists[index]);
+		if(rc == ERR_LIST_NOT_FOUND){
+			error = "Invalid/missing roles";
+			rc = MOSQ_ERR_INVAL;
+			goto cleanup;
+		}else if(rc == MOSQ_ERR_NOT_FOUND){
+			error = "Role not found";
+			rc = MOSQ_ERR_INVAL;
+			goto cleanup;
+		}else if(rc){
+			error = "'roles' not an array or missing/invalid rolename";
+			rc = MOSQ_ERR_INVAL;
+			goto cleanup;
+		}
+		index++;
+	}
+
+	/* Add every client to its new roles while each still has its old
+	 * rolelist. Only running out of memory can fail here, and undoing it
+	 * only frees memory. */
+	for(index=0; index<count; index++){
+		rc = client__link_new_roles(clients[index], rolelists[index]);
+		if(rc){
+			for(i=index; i>=0; i--){
+				client__unlink_new_roles(clients[i], rolelists[i]);
+			}
+			dynsec_clientlist__sort_all(data);
+			error = "Internal error";
+			goto cleanup;
+		}
+	}
+
+	/* Nothing can fail from here on */
+	for(i=0; i<count; i++){
+		client__swap_roles(clients[i], &rolelists[i]);
+
+		/* Enforce any changes */
+		dynsec_kicklist__add(data, clients[i]->username);
+	}
+
+	dynsec_clientlist__sort_all(data);
+	dynsec__config_batch_save(data);
+
+	mosquitto_control_command_reply(cmd, NULL);
+
+	admin_clientid = mosquitto_client_id(cmd->client);
+	admin_username = mosquitto_client_username(cmd->client);
+	mosquitto_log_printf(MOSQ_LOG_INFO, "dynsec: %s/%s | setClientRolesBulk | count=%d",
+			admin_clientid, admin_username, count);
+
+cleanup:
+	if(error){
+		dynsec__command_reply_item(cmd, "clients", index, error);
+	}
+	for(i=0; i<count; i++){
+		dynsec_rolelist__cleanup(&rolelists[i]);
+	}
+	mosquitto_free(rolelists);
+	mosquitto_free(clients);
+	dynsec_clientlist__cleanup(&seen);
+	return rc;
+}
+
+
 int dynsec_clients__process_modify(struct dynsec__data *data, struct mosquitto_control_cmd *cmd)
 {
 	const char *username;
@@ -25,11 +25,15 @@ Contributors:
 #include <string.h>
 #include <sys/stat.h>
 
+#ifndef WIN32
+#  include <strings.h>
+#endif
+
 #include "dynamic_security.h"
 #include "json_help.h"
 
 
-static int dynsec__general_config_load(struct dynsec__data *data, cJSON *tree)
+int dynsec__general_config_load(struct dynsec__data *data, cJSON *tree)
 {
 	cJSON *j_default_access;
 
@@ -46,7 +50,7 @@ static int dynsec__general_config_load(struct dynsec__data *data, cJSON *tree)
 }
 
 
-static int dynsec__general_config_save(struct dynsec__data *data, cJSON *tree)
+int dynsec__general_config_save(struct dynsec__data *data, cJSON *tree)
 {
 	cJSON *j_default_access;
 
@@ -71,28 +75,274 @@ static int dynsec__general_config_save(struct dynsec__data *data, cJSON *tree)
 }
 
 
-int dynsec__config_from_json(struct dynsec__data *data, const char *json_str)
+/* The config is not parsed into a single cJSON tree, because for a large
+ * config that costs several times the size of the file in allocations. The
+ * top level object is scanned here instead, and each client, group and role
+ * is parsed on its own, loaded and freed before the next one is read. Roles
+ * are loaded first, then clients, then groups, because they refer to each
+ * other in that order, so the clients/groups/roles arrays are found first and
+ * their positions remembered. Everything else at the top level is small and
+ * is collected into one tree for dynsec__general_config_load().
+ */
+
+struct config_scan {
+	const char *buf;
+	size_t len;
+	size_t pos;
+};
+
+typedef int (*config_scan__load_item_fn)(struct dynsec__data *data, cJSON *j_item);
+
+
+/* Returns the next character that isn't whitespace, without consuming it, or
+ * 0 at the end of the buffer. */
+static char config_scan__peek(struct config_scan *scan)
 {
-	cJSON *tree;
+	while(scan->pos < scan->len){
+		switch(scan->buf[scan->pos]){
+			case ' ':
+			case '\t':
+			case '\r':
+			case '\n':
+				scan->pos++;
+				break;
+			default:
+				return scan->buf[scan->pos];
+		}
+	}
+	return '\0';
+}
+
+
+static cJSON *config_scan__value(struct config_scan *scan)
+{
+	const char *end = NULL;
+	cJSON *item;
+
+	config_scan__peek(scan);
+	item = cJSON_ParseWithLengthOpts(&scan->buf[scan->pos], scan->len - scan->pos, &end, false);
+	if(item){
+		scan->pos = (size_t)(end - scan->buf);
+	}
+	return item;
+}
+
+
+/* Move past an array or object without parsing it. Only the brackets are
+ * matched here, the contents are checked when they are parsed later. */
+static int config_scan__skip(struct config_scan *scan)
+{
+	size_t depth = 0;
+	bool in_string = false;
+	char c;
+
+	while(scan->pos < scan->len){
+		c = scan->buf[scan->pos++];
+		if(in_string){
+			if(c == '\\'){
+				scan->pos++;
+			}else if(c == '"'){
+				in_string = false;
+			}
+		}else if(c == '"'){
+			in_string = true;
+		}else if(c == '[' || c == '{'){
+			depth++;
+		}else if(c == ']' || c == '}'){
+			if(depth == 0){
+				return MOSQ_ERR_INVAL;
+			}
+			depth--;
+			if(depth == 0){
+				return MOSQ_ERR_SUCCESS;
+			}
+		}
+	}
+	return MOSQ_ERR_INVAL;
+}
+
+
+static int config_scan__array(struct dynsec__data *data, struct config_scan *scan, config_scan__load_item_fn load_item)
+{
+	cJSON *j_item;
+	int rc;
+
+	if(config_scan__peek(scan) != '['){
+		return MOSQ_ERR_INVAL;
+	}
+	scan->pos++;
+	if(config_scan__peek(scan) == ']'){
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	while(1){
+		j_item = config_scan__value(scan);
+		if(j_item == NULL){
+			return MOSQ_ERR_INVAL;
+		}
+		rc = MOSQ_ERR_SUCCESS;
+		if(cJSON_IsObject(j_item)){
+			rc = load_item(data, j_item);
+		}
+		cJSON_Delete(j_item);
+		if(rc){
+			return rc;
+		}
+
+		switch(config_scan__peek(scan)){
+			case ',':
+				scan->pos++;
+				break;
+			case ']':
+				scan->pos++;
+				return MOSQ_ERR_SUCCESS;
+			default:
+				return MOSQ_ERR_INVAL;
+		}
+	}
+}
+
+
+/* Read the top level object, collecting everything except the three arrays
+ * into tree. The offsets of the arrays are left at 0 if they aren't present. */
+static int config_scan__top(struct config_scan *scan, cJSON *tree, size_t *roles, size_t *clients, size_t *groups)
+{
+	cJSON *j_key, *j_value;
+	size_t *offset;
+	char c;
+	int rc;
+
+	scan->pos++;
+	if(config_scan__peek(scan) == '}'){
+		return MOSQ_ERR_SUCCESS;
+	}
 
-	tree = cJSON_Parse(json_str);
+	while(1){
+		j_key = config_scan__value(scan);
+		if(!cJSON_IsString(j_key) || config_scan__peek(scan) != ':'){
+			cJSON_Delete(j_key);
+			return MOSQ_ERR_INVAL;
+		}
+		scan->pos++;
+
+		if(!strcasecmp(j_key->valuestring, "roles")){
+			offset = roles;
+		}else if(!strcasecmp(j_key->valuestring, "clients")){
+			offset = clients;
+		}else if(!strcasecmp(j_key->valuestring, "groups")){
+			offset = groups;
+		}else{
+			offset = NULL;
+		}
+
+		c = config_scan__peek(scan);
+		if(offset){
+			/* Only the first of a repeated key is used. Anything other than an
+			 * array is rejected when it is loaded. */
+			if(*offset == 0){
+				*offset = scan->pos;
+			}
+			if(c == '[' || c == '{'){
+				rc = config_scan__skip(scan);
+			}else{
+				j_value = config_scan__value(scan);
+				rc = j_value?MOSQ_ERR_SUCCESS:MOSQ_ERR_INVAL;
+				cJSON_Delete(j_value);
+			}
+		}else{
+			j_value = config_scan__value(scan);
+			if(j_value){
+				cJSON_AddItemToObject(tree, j_key->valuestring, j_value);
+				rc = MOSQ_ERR_SUCCESS;
+			}else{
+				rc = MOSQ_ERR_INVAL;
+			}
+		}
+		cJSON_Delete(j_key);
+		if(rc){
+			return rc;
+		}
+
+		switch(config_scan__peek(scan)){
+			case ',':
+				scan->pos++;
+				break;
+			case '}':
+				scan->pos++;
+				return MOSQ_ERR_SUCCESS;
+			default:
+				return MOSQ_ERR_INVAL;
+		}
+	}
+}
+
+
+int dynsec__config_from_json(struct dynsec__data *data, const char *json_str, size_t json_len)
+{
+	struct config_scan scan;
+	size_t roles = 0, clients = 0, groups = 0;
+	cJSON *tree, *j_value;
+	const char *groupname;
+	int rc;
+
+	scan.buf = json_str;
+	scan.len = json_len;
+	scan.pos = 0;
+	if(json_len >= 3 && !memcmp(json_str, "\xEF\xBB\xBF", 3)){
+		/* UTF-8 byte order mark */
+		scan.pos = 3;
+	}
+
+	if(config_scan__peek(&scan) != '{'){
+		/* Valid, but nothing to load */
+		j_value = config_scan__value(&scan);
+		if(j_value == NULL){
+			mosquitto_log_printf(MOSQ_LOG_ERR, "Error loading Dynamic security plugin config: File is not valid JSON.");
+			return 1;
+		}
+		cJSON_Delete(j_value);
+		return 0;
+	}
+
+	tree = cJSON_CreateObject();
 	if(tree == NULL){
+		mosquitto_log_printf(MOSQ_LOG_ERR, "Error: Out of memory.");
+		return 1;
+	}
+	if(config_scan__top(&scan, tree, &roles, &clients, &groups)){
 		mosquitto_log_printf(MOSQ_LOG_ERR, "Error loading Dynamic security plugin config: File is not valid JSON.");
+		cJSON_Delete(tree);
 		return 1;
 	}
 
-	if(dynsec__general_config_load(data, tree)
-			|| dynsec_roles__config_load(data, tree)
-			|| dynsec_clients__config_load(data, tree)
-			|| dynsec_groups__config_load(data, tree)
-			){
+	dynsec__general_config_load(data, tree);
 
-		cJSON_Delete(tree);
-		return 1;
+	rc = MOSQ_ERR_SUCCESS;
+	if(roles){
+		scan.pos = roles;
+		rc = config_scan__array(data, &scan, dynsec_roles__config_load_item);
+		dynsec_roles__sort(data);
+	}
+	if(rc == MOSQ_ERR_SUCCESS && clients){
+		scan.pos = clients;
+		rc = config_scan__array(data, &scan, dynsec_clients__config_load_item);
+		dynsec_clients__sort(data);
+	}
+	if(rc == MOSQ_ERR_SUCCESS && groups){
+		scan.pos = groups;
+		rc = config_scan__array(data, &scan, dynsec_groups__config_load_item);
+		dynsec_groups__sort(data);
+	}
+	if(rc == MOSQ_ERR_INVAL){
+		mosquitto_log_printf(MOSQ_LOG_ERR, "Error loading Dynamic security plugin config: File is not valid JSON.");
+	}
+
+	if(rc == MOSQ_ERR_SUCCESS && json_get_string(tree, "anonymousGroup", &groupname, false) == MOSQ_ERR_SUCCESS){
+		data->anonymous_group = dynsec_groups__find(data, groupname);
 	}
 
 	cJSON_Delete(tree);
-	return 0;
+	return rc;
 }
 
 
@@ -146,8 +396,15 @@ int dynsec__config_load(struct dynsec__data *data)
 	}
 	fclose(fptr);
 
-	rc = dynsec__config_from_json(data, json_str);
-	free(json_str);
+	rc = dynsec__config_from_json(data, json_str, flen);
+	mosquitto_free(json_str);
+	if(rc == MOSQ_ERR_SUCCESS){
+		rc = dynsec_journal__load(data);
+	}
+	if(rc == MOSQ_ERR_SUCCESS && data->journal_records > 0 && data->journal == false){
+		/* The journal has been turned off, so fold it into the config */
+		dynsec__config_save(data);
+	}
 	return rc;
 }
 
@@ -212,11 +469,24 @@ void dynsec__config_batch_save(struct dynsec__data *data)
 {
 	data->changeindex++;
 	data->need_save = true;
+	/* Any change may alter ACL decisions */
+	data->acl_generation++;
+	mosquitto_acl_cache_invalidate();
 }
 
 
 void dynsec__config_save(struct dynsec__data *data)
 {
 	data->need_save = false;
-	mosquitto_write_file(data->config_file, true, &dynsec__write_json_config, data, &dynsec__log_write_error);
+	if(data->journal){
+		/* The journal is appended to even when the config is about to be
+		 * rewritten, so replaying it still gives the current state if it can't
+		 * be removed afterwards. */
+		if(dynsec_journal__append(data) == MOSQ_ERR_SUCCESS && dynsec_journal__compact_due(data) == false){
+			return;
+		}
+	}
+	if(mosquitto_write_file(data->config_file, true, &dynsec__write_json_config, data, &dynsec__log_write_error) == MOSQ_ERR_SUCCESS){
+		dynsec_journal__remove(data);
+	}
 }
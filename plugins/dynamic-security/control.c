@@ -34,6 +34,7 @@ Contributors:
 static int dynsec__handle_command(struct mosquitto_control_cmd *cmd, void *userdata)
 {
 	struct dynsec__data *data = userdata;
+	int64_t changeindex = data->changeindex;
 	int rc = MOSQ_ERR_SUCCESS;
 
 	/* Plugin */
@@ -47,6 +48,8 @@ static int dynsec__handle_command(struct mosquitto_control_cmd *cmd, void *userd
 		/* Clients */
 	}else if(!strcasecmp(cmd->command_name, "createClient")){
 		rc = dynsec_clients__process_create(data, cmd);
+	}else if(!strcasecmp(cmd->command_name, "createClients")){
+		rc = dynsec_clients__process_create_bulk(data, cmd);
 	}else if(!strcasecmp(cmd->command_name, "deleteClient")){
 		rc = dynsec_clients__process_delete(data, cmd);
 	}else if(!strcasecmp(cmd->command_name, "getClient")){
@@ -63,6 +66,8 @@ static int dynsec__handle_command(struct mosquitto_control_cmd *cmd, void *userd
 		rc = dynsec_clients__process_add_role(data, cmd);
 	}else if(!strcasecmp(cmd->command_name, "removeClientRole")){
 		rc = dynsec_clients__process_remove_role(data, cmd);
+	}else if(!strcasecmp(cmd->command_name, "setClientRolesBulk")){
+		rc = dynsec_clients__process_set_roles_bulk(data, cmd);
 	}else if(!strcasecmp(cmd->command_name, "enableClient")){
 		rc = dynsec_clients__process_enable(data, cmd);
 	}else if(!strcasecmp(cmd->command_name, "disableClient")){
@@ -71,6 +76,8 @@ static int dynsec__handle_command(struct mosquitto_control_cmd *cmd, void *userd
 		/* Groups */
 	}else if(!strcasecmp(cmd->command_name, "addGroupClient")){
 		rc = dynsec_groups__process_add_client(data, cmd);
+	}else if(!strcasecmp(cmd->command_name, "addGroupClients")){
+		rc = dynsec_groups__process_add_clients(data, cmd);
 	}else if(!strcasecmp(cmd->command_name, "createGroup")){
 		rc = dynsec_groups__process_create(data, cmd);
 	}else if(!strcasecmp(cmd->command_name, "deleteGroup")){
@@ -114,10 +121,25 @@ static int dynsec__handle_command(struct mosquitto_control_cmd *cmd, void *userd
 		rc = MOSQ_ERR_INVAL;
 	}
 
+	if(data->changeindex != changeindex){
+		dynsec_journal__mark(data, cmd);
+	}
+
 	return rc;
 }
 
 
+/* Reply with an error that refers to one item of an array in the command,
+ * e.g. "clients[3]: Client not found". */
+void dynsec__command_reply_item(struct mosquitto_control_cmd *cmd, const char *array_name, int index, const char *error)
+{
+	char buf[200];
+
+	snprintf(buf, sizeof(buf), "%s[%d]: %s", array_name, index, error);
+	mosquitto_control_command_reply(cmd, buf);
+}
+
+
 int dynsec_control_callback(int event, void *event_data, void *userdata)
 {
 	struct mosquitto_evt_control *ed = event_data;
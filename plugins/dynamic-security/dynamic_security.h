@@ -82,6 +82,7 @@ struct dynsec__kicklist {
 struct dynsec__client {
 	UT_hash_handle hh;
 	struct mosquitto_pw *pw;
+	char *encoded_password; /* As loaded, until decoded into pw on first use */
 	struct dynsec__rolelist *rolelist;
 	struct dynsec__grouplist *grouplist;
 	char *clientid;
@@ -97,6 +98,7 @@ struct dynsec__group {
 	struct dynsec__clientlist *clientlist;
 	char *text_name;
 	char *text_description;
+	bool clientlist_unsorted; /* See dynsec_clientlist__append() */
 	char groupname[];
 };
 
@@ -108,6 +110,19 @@ struct dynsec__acl {
 	char topic[];
 };
 
+struct dynsec__acl_trie_node {
+	UT_hash_handle hh;
+	struct dynsec__acl_trie_node *children;
+	struct dynsec__acl_trie_node *plus;
+	struct dynsec__acl_trie_node *clientid;
+	struct dynsec__acl_trie_node *username;
+	struct dynsec__acl *acl;
+	struct dynsec__acl *acl_hash;
+	int order;
+	int order_hash;
+	char level[];
+};
+
 struct dynsec__acls {
 	struct dynsec__acl *publish_c_send;
 	struct dynsec__acl *publish_c_recv;
@@ -115,6 +130,8 @@ struct dynsec__acls {
 	struct dynsec__acl *subscribe_pattern;
 	struct dynsec__acl *unsubscribe_literal;
 	struct dynsec__acl *unsubscribe_pattern;
+	struct dynsec__acl_trie_node *publish_c_send_trie;
+	struct dynsec__acl_trie_node *publish_c_recv_trie;
 };
 
 struct dynsec__role {
@@ -125,9 +142,31 @@ struct dynsec__role {
 	char *text_name;
 	char *text_description;
 	bool allow_wildcard_subs;
+	bool clientlist_unsorted; /* See dynsec_clientlist__append() */
 	char rolename[];
 };
 
+struct dynsec__acl_cache_entry {
+	UT_hash_handle hh;
+	int rc;
+	char topic[];
+};
+
+struct dynsec__acl_cache {
+	UT_hash_handle hh;
+	struct dynsec__acl_cache_entry *publish_c_send;
+	struct dynsec__acl_cache_entry *publish_c_recv;
+	char *username;
+	uint64_t generation;
+	char clientid[];
+};
+
+struct dynsec__journal_mark {
+	UT_hash_handle hh;
+	bool deleted;
+	char key[]; /* Entity type followed by its name */
+};
+
 struct dynsec__acl_default_access {
 	bool publish_c_send;
 	bool publish_c_recv;
@@ -150,9 +189,16 @@ struct dynsec__data {
 	struct dynsec__group *anonymous_group;
 	struct dynsec__kicklist *kicklist;
 	struct dynsec__acl_default_access default_access;
+	struct dynsec__acl_cache *acl_cache;
+	struct dynsec__journal_mark *journal_marks;
+	uint64_t acl_generation;
 	int64_t changeindex;
+	unsigned long journal_records; /* Appended since the config was last written */
+	unsigned long journal_live; /* Entities when the config was last written */
 	int init_mode;
 	bool need_save;
+	bool journal;
+	bool journal_compact;
 };
 
 /* ################################################################
@@ -166,8 +212,11 @@ void dynsec__config_save(struct dynsec__data *data);
 void dynsec__config_batch_save(struct dynsec__data *data);
 int dynsec__config_load(struct dynsec__data *data);
 char *dynsec__config_to_json(struct dynsec__data *data);
-int dynsec__config_from_json(struct dynsec__data *data, const char *json_str);
+int dynsec__config_from_json(struct dynsec__data *data, const char *json_str, size_t json_len);
+int dynsec__general_config_load(struct dynsec__data *data, cJSON *tree);
+int dynsec__general_config_save(struct dynsec__data *data, cJSON *tree);
 void dynsec__command_reply(cJSON *j_responses, struct mosquitto *context, const char *command, const char *error, const char *correlation_data);
+void dynsec__command_reply_item(struct mosquitto_control_cmd *cmd, const char *array_name, int index, const char *error);
 int dynsec_control_callback(int event, void *event_data, void *userdata);
 
 
@@ -178,10 +227,23 @@ int dynsec_control_callback(int event, void *event_data, void *userdata);
  * ################################################################ */
 
 int dynsec__acl_check_callback(int event, void *event_data, void *userdata);
+int dynsec__acl_disconnect_callback(int event, void *event_data, void *userdata);
+void dynsec__acl_cache_cleanup(struct dynsec__data *data);
 int dynsec__process_set_default_acl_access(struct dynsec__data *data, struct mosquitto_control_cmd *cmd);
 int dynsec__process_get_default_acl_access(struct dynsec__data *data, struct mosquitto_control_cmd *cmd);
 
 
+/* ################################################################
+ * #
+ * # ACL Trie Functions
+ * #
+ * ################################################################ */
+
+int dynsec_acl_trie__build(struct dynsec__acl *acllist, struct dynsec__acl_trie_node **root);
+void dynsec_acl_trie__free(struct dynsec__acl_trie_node **root);
+struct dynsec__acl *dynsec_acl_trie__match(struct dynsec__acl_trie_node *root, const char *topic, const char *clientid, const char *username);
+
+
 /* ################################################################
  * #
  * # Auth Functions
@@ -199,10 +261,11 @@ int dynsec_auth__basic_auth_callback(int event, void *event_data, void *userdata
  * ################################################################ */
 
 void dynsec_clients__cleanup(struct dynsec__data *data);
-int dynsec_clients__config_load(struct dynsec__data *data, cJSON *tree);
+int dynsec_clients__config_load_item(struct dynsec__data *data, cJSON *j_client);
 int dynsec_clients__config_save(struct dynsec__data *data, cJSON *tree);
 int dynsec_clients__process_add_role(struct dynsec__data *data, struct mosquitto_control_cmd *cmd);
 int dynsec_clients__process_create(struct dynsec__data *data, struct mosquitto_control_cmd *cmd);
+int dynsec_clients__process_create_bulk(struct dynsec__data *data, struct mosquitto_control_cmd *cmd);
 int dynsec_clients__process_delete(struct dynsec__data *data, struct mosquitto_control_cmd *cmd);
 int dynsec_clients__process_disable(struct dynsec__data *data, struct mosquitto_control_cmd *cmd);
 int dynsec_clients__process_enable(struct dynsec__data *data, struct mosquitto_control_cmd *cmd);
@@ -212,7 +275,13 @@ int dynsec_clients__process_modify(struct dynsec__data *data, struct mosquitto_c
 int dynsec_clients__process_remove_role(struct dynsec__data *data, struct mosquitto_control_cmd *cmd);
 int dynsec_clients__process_set_id(struct dynsec__data *data, struct mosquitto_control_cmd *cmd);
 int dynsec_clients__process_set_password(struct dynsec__data *data, struct mosquitto_control_cmd *cmd);
+int dynsec_clients__process_set_roles_bulk(struct dynsec__data *data, struct mosquitto_control_cmd *cmd);
 struct dynsec__client *dynsec_clients__find(struct dynsec__data *data, const char *username);
+int dynsec_clients__journal_apply(struct dynsec__data *data, cJSON *j_client);
+void dynsec_clients__journal_delete(struct dynsec__data *data, const char *username);
+cJSON *dynsec_clients__journal_item(struct dynsec__client *client);
+void dynsec_clients__sort(struct dynsec__data *data);
+struct mosquitto_pw *dynsec_clients__pw(struct dynsec__client *client);
 
 
 /* ################################################################
@@ -223,9 +292,11 @@ struct dynsec__client *dynsec_clients__find(struct dynsec__data *data, const cha
 
 cJSON *dynsec_clientlist__all_to_json(struct dynsec__clientlist *base_clientlist);
 int dynsec_clientlist__add(struct dynsec__clientlist **base_clientlist, struct dynsec__client *client, int priority);
+int dynsec_clientlist__append(struct dynsec__clientlist **base_clientlist, struct dynsec__client *client, int priority);
 void dynsec_clientlist__cleanup(struct dynsec__clientlist **base_clientlist);
 void dynsec_clientlist__remove(struct dynsec__clientlist **base_clientlist, struct dynsec__client *client);
 void dynsec_clientlist__kick_all(struct dynsec__data *data, struct dynsec__clientlist *base_clientlist);
+void dynsec_clientlist__sort_all(struct dynsec__data *data);
 
 
 /* ################################################################
@@ -235,10 +306,11 @@ void dynsec_clientlist__kick_all(struct dynsec__data *data, struct dynsec__clien
  * ################################################################ */
 
 void dynsec_groups__cleanup(struct dynsec__data *data);
-int dynsec_groups__config_load(struct dynsec__data *data, cJSON *tree);
+int dynsec_groups__config_load_item(struct dynsec__data *data, cJSON *j_group);
 int dynsec_groups__add_client(struct dynsec__data *data, const char *username, const char *groupname, int priority, bool update_config);
 int dynsec_groups__config_save(struct dynsec__data *data, cJSON *tree);
 int dynsec_groups__process_add_client(struct dynsec__data *data, struct mosquitto_control_cmd *cmd);
+int dynsec_groups__process_add_clients(struct dynsec__data *data, struct mosquitto_control_cmd *cmd);
 int dynsec_groups__process_add_role(struct dynsec__data *data, struct mosquitto_control_cmd *cmd);
 int dynsec_groups__process_create(struct dynsec__data *data, struct mosquitto_control_cmd *cmd);
 int dynsec_groups__process_delete(struct dynsec__data *data, struct mosquitto_control_cmd *cmd);
@@ -251,6 +323,10 @@ int dynsec_groups__process_get_anonymous_group(struct dynsec__data *data, struct
 int dynsec_groups__process_set_anonymous_group(struct dynsec__data *data, struct mosquitto_control_cmd *cmd);
 int dynsec_groups__remove_client(struct dynsec__data *data, const char *username, const char *groupname, bool update_config);
 struct dynsec__group *dynsec_groups__find(struct dynsec__data *data, const char *groupname);
+int dynsec_groups__journal_apply(struct dynsec__data *data, cJSON *j_group);
+void dynsec_groups__journal_delete(struct dynsec__data *data, const char *groupname);
+cJSON *dynsec_groups__journal_item(struct dynsec__group *group);
+void dynsec_groups__sort(struct dynsec__data *data);
 
 
 /* ################################################################
@@ -272,7 +348,7 @@ void dynsec_grouplist__remove(struct dynsec__grouplist **base_grouplist, struct
  * ################################################################ */
 
 void dynsec_roles__cleanup(struct dynsec__data *data);
-int dynsec_roles__config_load(struct dynsec__data *data, cJSON *tree);
+int dynsec_roles__config_load_item(struct dynsec__data *data, cJSON *j_role);
 int dynsec_roles__config_save(struct dynsec__data *data, cJSON *tree);
 int dynsec_roles__process_add_acl(struct dynsec__data *data, struct mosquitto_control_cmd *cmd);
 int dynsec_roles__process_create(struct dynsec__data *data, struct mosquitto_control_cmd *cmd);
@@ -282,6 +358,11 @@ int dynsec_roles__process_list(struct dynsec__data *data, struct mosquitto_contr
 int dynsec_roles__process_modify(struct dynsec__data *data, struct mosquitto_control_cmd *cmd);
 int dynsec_roles__process_remove_acl(struct dynsec__data *data, struct mosquitto_control_cmd *cmd);
 struct dynsec__role *dynsec_roles__find(struct dynsec__data *data, const char *rolename);
+void dynsec_roles__acl_trie_update(struct dynsec__role *role);
+int dynsec_roles__journal_apply(struct dynsec__data *data, cJSON *j_role);
+void dynsec_roles__journal_delete(struct dynsec__data *data, const char *rolename);
+cJSON *dynsec_roles__journal_item(struct dynsec__role *role);
+void dynsec_roles__sort(struct dynsec__data *data);
 
 
 /* ################################################################
@@ -298,6 +379,19 @@ int dynsec_rolelist__load_from_json(struct dynsec__data *data, cJSON *command, s
 void dynsec_rolelist__cleanup(struct dynsec__rolelist **base_rolelist);
 cJSON *dynsec_rolelist__all_to_json(struct dynsec__rolelist *base_rolelist);
 
+/* ################################################################
+ * #
+ * # Journal Functions
+ * #
+ * ################################################################ */
+
+int dynsec_journal__append(struct dynsec__data *data);
+void dynsec_journal__cleanup(struct dynsec__data *data);
+bool dynsec_journal__compact_due(struct dynsec__data *data);
+int dynsec_journal__load(struct dynsec__data *data);
+void dynsec_journal__mark(struct dynsec__data *data, struct mosquitto_control_cmd *cmd);
+void dynsec_journal__remove(struct dynsec__data *data);
+
 /* ################################################################
  * #
  * # Kick List Functions
@@ -196,9 +196,8 @@ void dynsec_groups__cleanup(struct dynsec__data *data)
  * ################################################################ */
 
 
-int dynsec_groups__config_load(struct dynsec__data *data, cJSON *tree)
+int dynsec_groups__config_load_item(struct dynsec__data *data, cJSON *j_group)
 {
-	cJSON *j_groups, *j_group;
 	cJSON *j_clientlist;
 	cJSON *j_roles;
 	const char *groupname;
@@ -207,114 +206,96 @@ int dynsec_groups__config_load(struct dynsec__data *data, cJSON *tree)
 	struct dynsec__role *role;
 	int priority;
 
-	j_groups = cJSON_GetObjectItem(tree, "groups");
-	if(j_groups == NULL){
+	/* Group name */
+	size_t groupname_len;
+	if(json_get_string(j_group, "groupname", &groupname, false) != MOSQ_ERR_SUCCESS){
+		return 0;
+	}
+	groupname_len = strlen(groupname);
+	if(groupname_len == 0){
+		return 0;
+	}
+	if(dynsec_groups__find(data, groupname)){
 		return 0;
 	}
 
-	if(cJSON_IsArray(j_groups) == false){
-		return 1;
+	group = mosquitto_calloc(1, sizeof(struct dynsec__group) + groupname_len + 1);
+	if(group == NULL){
+		return MOSQ_ERR_NOMEM;
 	}
+	strncpy(group->groupname, groupname, groupname_len+1);
 
-	cJSON_ArrayForEach(j_group, j_groups){
-		if(cJSON_IsObject(j_group) == true){
-			/* Group name */
-			size_t groupname_len;
-			if(json_get_string(j_group, "groupname", &groupname, false) != MOSQ_ERR_SUCCESS){
-				continue;
-			}
-			groupname_len = strlen(groupname);
-			if(groupname_len == 0){
-				continue;
-			}
-			if(dynsec_groups__find(data, groupname)){
-				continue;
+	/* Text name */
+	const char *textname;
+	if(json_get_string(j_group, "textname", &textname, false) == MOSQ_ERR_SUCCESS){
+		if(textname){
+			group->text_name = mosquitto_strdup(textname);
+			if(group->text_name == NULL){
+				mosquitto_free(group);
+				return 0;
 			}
+		}
+	}
 
-			group = mosquitto_calloc(1, sizeof(struct dynsec__group) + groupname_len + 1);
-			if(group == NULL){
-				return MOSQ_ERR_NOMEM;
-			}
-			strncpy(group->groupname, groupname, groupname_len+1);
-
-			/* Text name */
-			const char *textname;
-			if(json_get_string(j_group, "textname", &textname, false) == MOSQ_ERR_SUCCESS){
-				if(textname){
-					group->text_name = mosquitto_strdup(textname);
-					if(group->text_name == NULL){
-						mosquitto_free(group);
-						continue;
-					}
-				}
+	/* Text description */
+	const char *textdescription;
+	if(json_get_string(j_group, "textdescription", &textdescription, false) == MOSQ_ERR_SUCCESS){
+		if(textdescription){
+			group->text_description = mosquitto_strdup(textdescription);
+			if(group->text_description == NULL){
+				mosquitto_free(group->text_name);
+				mosquitto_free(group);
+				return 0;
 			}
+		}
+	}
 
-			/* Text description */
-			const char *textdescription;
-			if(json_get_string(j_group, "textdescription", &textdescription, false) == MOSQ_ERR_SUCCESS){
-				if(textdescription){
-					group->text_description = mosquitto_strdup(textdescription);
-					if(group->text_description == NULL){
-						mosquitto_free(group->text_name);
-						mosquitto_free(group);
-						continue;
-					}
-				}
-			}
+	/* Roles */
+	j_roles = cJSON_GetObjectItem(j_group, "roles");
+	if(j_roles && cJSON_IsArray(j_roles)){
+		cJSON *j_role;
 
-			/* Roles */
-			j_roles = cJSON_GetObjectItem(j_group, "roles");
-			if(j_roles && cJSON_IsArray(j_roles)){
-				cJSON *j_role;
-
-				cJSON_ArrayForEach(j_role, j_roles){
-					if(cJSON_IsObject(j_role)){
-						const char *rolename;
-						if(json_get_string(j_role, "rolename", &rolename, false) == MOSQ_ERR_SUCCESS){
-							json_get_int(j_role, "priority", &priority, true, -1);
-							if(priority > PRIORITY_MAX){
-								priority = PRIORITY_MAX;
-							}
-							if(priority < -PRIORITY_MAX){
-								priority = -PRIORITY_MAX;
-							}
-							role = dynsec_roles__find(data, rolename);
-							dynsec_rolelist__group_add(group, role, priority);
-						}
+		cJSON_ArrayForEach(j_role, j_roles){
+			if(cJSON_IsObject(j_role)){
+				const char *rolename;
+				if(json_get_string(j_role, "rolename", &rolename, false) == MOSQ_ERR_SUCCESS){
+					json_get_int(j_role, "priority", &priority, true, -1);
+					if(priority > PRIORITY_MAX){
+						priority = PRIORITY_MAX;
+					}
+					if(priority < -PRIORITY_MAX){
+						priority = -PRIORITY_MAX;
 					}
+					role = dynsec_roles__find(data, rolename);
+					dynsec_rolelist__group_add(group, role, priority);
 				}
 			}
+		}
+	}
+
+	/* This must go before clients are loaded, otherwise the group won't be found */
+	HASH_ADD(hh, data->groups, groupname, groupname_len, group);
 
-			/* This must go before clients are loaded, otherwise the group won't be found */
-			HASH_ADD(hh, data->groups, groupname, groupname_len, group);
-
-			/* Clients */
-			j_clientlist = cJSON_GetObjectItem(j_group, "clients");
-			if(j_clientlist && cJSON_IsArray(j_clientlist)){
-				cJSON *j_client;
-				cJSON_ArrayForEach(j_client, j_clientlist){
-					if(cJSON_IsObject(j_client)){
-						const char *username;
-						if(json_get_string(j_client, "username", &username, false) == MOSQ_ERR_SUCCESS){
-							json_get_int(j_client, "priority", &priority, true, -1);
-							if(priority > PRIORITY_MAX){
-								priority = PRIORITY_MAX;
-							}
-							if(priority < -PRIORITY_MAX){
-								priority = -PRIORITY_MAX;
-							}
-							dynsec_groups__add_client(data, username, group->groupname, priority, false);
-						}
+	/* Clients */
+	j_clientlist = cJSON_GetObjectItem(j_group, "clients");
+	if(j_clientlist && cJSON_IsArray(j_clientlist)){
+		cJSON *j_client;
+		cJSON_ArrayForEach(j_client, j_clientlist){
+			if(cJSON_IsObject(j_client)){
+				const char *username;
+				if(json_get_string(j_client, "username", &username, false) == MOSQ_ERR_SUCCESS){
+					json_get_int(j_client, "priority", &priority, true, -1);
+					if(priority > PRIORITY_MAX){
+						priority = PRIORITY_MAX;
+					}
+					if(priority < -PRIORITY_MAX){
+						priority = -PRIORITY_MAX;
 					}
+					dynsec_groups__add_client(data, username, group->groupname, priority, false);
 				}
 			}
 		}
 	}
-	HASH_SORT(data->groups, group_cmp);
-
-	if(json_get_string(tree, "anonymousGroup", &groupname, false) == MOSQ_ERR_SUCCESS){
-		data->anonymous_group = dynsec_groups__find(data, groupname);
-	}
 
 	return 0;
 }
@@ -327,37 +308,53 @@ int dynsec_groups__config_load(struct dynsec__data *data, cJSON *tree)
  * ################################################################ */
 
 
-static int dynsec__config_add_groups(struct dynsec__data *data, cJSON *j_groups)
+static cJSON *group__config_item(struct dynsec__group *group)
 {
-	struct dynsec__group *group, *group_tmp = NULL;
 	cJSON *j_group, *j_clients, *j_roles;
 
-	HASH_ITER(hh, data->groups, group, group_tmp){
-		j_group = cJSON_CreateObject();
-		if(j_group == NULL){
-			return 1;
-		}
-		cJSON_AddItemToArray(j_groups, j_group);
+	j_group = cJSON_CreateObject();
+	if(j_group == NULL){
+		return NULL;
+	}
 
-		if(cJSON_AddStringToObject(j_group, "groupname", group->groupname) == NULL
-				|| (group->text_name && cJSON_AddStringToObject(j_group, "textname", group->text_name) == NULL)
-				|| (group->text_description && cJSON_AddStringToObject(j_group, "textdescription", group->text_description) == NULL)
-				){
+	if(cJSON_AddStringToObject(j_group, "groupname", group->groupname) == NULL
+			|| (group->text_name && cJSON_AddStringToObject(j_group, "textname", group->text_name) == NULL)
+			|| (group->text_description && cJSON_AddStringToObject(j_group, "textdescription", group->text_description) == NULL)
+			){
 
-			return 1;
-		}
+		cJSON_Delete(j_group);
+		return NULL;
+	}
 
-		j_roles = dynsec_rolelist__all_to_json(group->rolelist);
-		if(j_roles == NULL){
-			return 1;
-		}
-		cJSON_AddItemToObject(j_group, "roles", j_roles);
+	j_roles = dynsec_rolelist__all_to_json(group->rolelist);
+	if(j_roles == NULL){
+		cJSON_Delete(j_group);
+		return NULL;
+	}
+	cJSON_AddItemToObject(j_group, "roles", j_roles);
 
-		j_clients = dynsec_clientlist__all_to_json(group->clientlist);
-		if(j_clients == NULL){
+	j_clients = dynsec_clientlist__all_to_json(group->clientlist);
+	if(j_clients == NULL){
+		cJSON_Delete(j_group);
+		return NULL;
+	}
+	cJSON_AddItemToObject(j_group, "clients", j_clients);
+
+	return j_group;
+}
+
+
+static int dynsec__config_add_groups(struct dynsec__data *data, cJSON *j_groups)
+{
+	struct dynsec__group *group, *group_tmp = NULL;
+	cJSON *j_group;
+
+	HASH_ITER(hh, data->groups, group, group_tmp){
+		j_group = group__config_item(group);
+		if(j_group == NULL){
 			return 1;
 		}
-		cJSON_AddItemToObject(j_group, "clients", j_clients);
+		cJSON_AddItemToArray(j_groups, j_group);
 	}
 
 	return 0;
@@ -387,6 +384,61 @@ int dynsec_groups__config_save(struct dynsec__data *data, cJSON *tree)
 }
 
 
+/* ################################################################
+ * #
+ * # Journal
+ * #
+ * ################################################################ */
+
+
+cJSON *dynsec_groups__journal_item(struct dynsec__group *group)
+{
+	return group__config_item(group);
+}
+
+
+void dynsec_groups__journal_delete(struct dynsec__data *data, const char *groupname)
+{
+	struct dynsec__group *group;
+
+	group = dynsec_groups__find(data, groupname);
+	if(group){
+		if(group == data->anonymous_group){
+			data->anonymous_group = NULL;
+		}
+		dynsec__remove_all_roles_from_group(group);
+		group__free_item(data, group);
+	}
+}
+
+
+/* Replace any existing group with the one described by a journal record. */
+int dynsec_groups__journal_apply(struct dynsec__data *data, cJSON *j_group)
+{
+	const char *groupname;
+	bool anonymous;
+	int rc;
+
+	if(json_get_string(j_group, "groupname", &groupname, false) != MOSQ_ERR_SUCCESS){
+		return MOSQ_ERR_INVAL;
+	}
+	anonymous = (data->anonymous_group && !strcmp(data->anonymous_group->groupname, groupname));
+	dynsec_groups__journal_delete(data, groupname);
+
+	rc = dynsec_groups__config_load_item(data, j_group);
+	if(anonymous){
+		data->anonymous_group = dynsec_groups__find(data, groupname);
+	}
+	return rc;
+}
+
+
+void dynsec_groups__sort(struct dynsec__data *data)
+{
+	HASH_SORT(data->groups, group_cmp);
+}
+
+
 int dynsec_groups__process_create(struct dynsec__data *data, struct mosquitto_control_cmd *cmd)
 {
 	const char *groupname, *text_name, *text_description;
@@ -615,6 +667,140 @@ int dynsec_groups__process_add_client(struct dynsec__data *data, struct mosquitt
 }
 
 
+/* Take the first count clients of an addGroupClients command back out of the
+ * group. */
+static void group__remove_bulk_clients(struct dynsec__data *data, struct dynsec__group *group, cJSON *j_clients, int count)
+{
+	cJSON *j_client;
+	struct dynsec__client *client;
+	const char *username;
+
+	cJSON_ArrayForEach(j_client, j_clients){
+		if(count == 0){
+			break;
+		}
+		json_get_string(j_client, "username", &username, false);
+		client = dynsec_clients__find(data, username);
+		dynsec_clientlist__remove(&group->clientlist, client);
+		dynsec_grouplist__remove(&client->grouplist, group);
+		count--;
+	}
+	group->clientlist_unsorted = false;
+}
+
+
+/* addGroupClients: add an array of clients to one group. Either all of the
+ * clients are added or none are. */
+int dynsec_groups__process_add_clients(struct dynsec__data *data, struct mosquitto_control_cmd *cmd)
+{
+	cJSON *j_clients, *j_client;
+	struct dynsec__group *group;
+	struct dynsec__client *client;
+	struct dynsec__clientlist *clientlist;
+	const char *groupname, *username;
+	const char *error;
+	int index, count, priority;
+	int rc;
+	const char *admin_clientid, *admin_username;
+
+	if(json_get_string(cmd->j_command, "groupname", &groupname, false) != MOSQ_ERR_SUCCESS){
+		mosquitto_control_command_reply(cmd, "Invalid/missing groupname");
+		return MOSQ_ERR_INVAL;
+	}
+	if(mosquitto_validate_utf8(groupname, (int)strlen(groupname)) != MOSQ_ERR_SUCCESS){
+		mosquitto_control_command_reply(cmd, "Group name not valid UTF-8");
+		return MOSQ_ERR_INVAL;
+	}
+	j_clients = cJSON_GetObjectItem(cmd->j_command, "clients");
+	if(j_clients == NULL || !cJSON_IsArray(j_clients)){
+		mosquitto_control_command_reply(cmd, "Invalid/missing clients");
+		return MOSQ_ERR_INVAL;
+	}
+
+	group = dynsec_groups__find(data, groupname);
+	if(group == NULL){
+		mosquitto_control_command_reply(cmd, "Group not found");
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	/* Each client goes on the end of the group's client list as it is
+	 * checked, which also catches a client given twice. */
+	index = 0;
+	cJSON_ArrayForEach(j_client, j_clients){
+		if(!cJSON_IsObject(j_client)){
+			error = "Client not an object";
+			rc = MOSQ_ERR_INVAL;
+			goto error;
+		}
+		if(json_get_string(j_client, "username", &username, false) != MOSQ_ERR_SUCCESS){
+			error = "Invalid/missing username";
+			rc = MOSQ_ERR_INVAL;
+			goto error;
+		}
+		client = dynsec_clients__find(data, username);
+		if(client == NULL){
+			error = "Client not found";
+			rc = MOSQ_ERR_INVAL;
+			goto error;
+		}
+		HASH_FIND(hh, group->clientlist, username, strlen(username), clientlist);
+		if(clientlist){
+			error = "Client is already in this group";
+			rc = MOSQ_ERR_INVAL;
+			goto error;
+		}
+		json_get_int(j_client, "priority", &priority, true, -1);
+		if(priority > PRIORITY_MAX){
+			priority = PRIORITY_MAX;
+		}
+		if(priority < -PRIORITY_MAX){
+			priority = -PRIORITY_MAX;
+		}
+		rc = dynsec_clientlist__append(&group->clientlist, client, priority);
+		if(rc){
+			error = "Internal error";
+			goto error;
+		}
+		group->clientlist_unsorted = true;
+		index++;
+	}
+	count = index;
+
+	cJSON_ArrayForEach(j_client, j_clients){
+		json_get_string(j_client, "username", &username, false);
+		HASH_FIND(hh, group->clientlist, username, strlen(username), clientlist);
+		rc = dynsec_grouplist__add(&clientlist->client->grouplist, group, clientlist->priority);
+		if(rc){
+			group__remove_bulk_clients(data, group, j_clients, count);
+			mosquitto_control_command_reply(cmd, "Internal error");
+			return rc;
+		}
+	}
+	dynsec_clientlist__sort_all(data);
+
+	cJSON_ArrayForEach(j_client, j_clients){
+		json_get_string(j_client, "username", &username, false);
+		/* Enforce any changes */
+		dynsec_kicklist__add(data, username);
+	}
+
+	dynsec__config_batch_save(data);
+	mosquitto_control_command_reply(cmd, NULL);
+
+	admin_clientid = mosquitto_client_id(cmd->client);
+	admin_username = mosquitto_client_username(cmd->client);
+	mosquitto_log_printf(MOSQ_LOG_INFO, "dynsec: %s/%s | addGroupClients | groupname=%s | count=%d",
+			admin_clientid, admin_username, groupname, count);
+
+	return MOSQ_ERR_SUCCESS;
+
+error:
+	group__remove_bulk_clients(data, group, j_clients, index);
+	dynsec__command_reply_item(cmd, "clients", index, error);
+	return rc;
+}
+
+
 static int dynsec__remove_all_clients_from_group(struct dynsec__group *group)
 {
 	struct dynsec__clientlist *clientlist, *clientlist_tmp = NULL;
@@ -0,0 +1,418 @@
+/*
+Copyright (c) 2026 Roger Light <roger@atchoo.org>
+
+All rights reserved. This program and the accompanying materials
+are made available under the terms of the Eclipse Public License 2.0
+and Eclipse Distribution License v1.0 which accompany this distribution.
+
+The Eclipse Public License is available at
+   https://www.eclipse.org/legal/epl-2.0/
+and the Eclipse Distribution License is available at
+  http://www.eclipse.org/org/documents/edl-v10.php.
+
+SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+
+Contributors:
+   Roger Light - initial implementation and documentation.
+*/
+
+#include "config.h"
+
+#include <cjson/cJSON.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uthash.h>
+
+#ifndef WIN32
+#  include <strings.h>
+#  include <unistd.h>
+#endif
+
+#include "dynamic_security.h"
+#include "json_help.h"
+
+/* The journal is an append-only file alongside the config file, holding one
+ * JSON object per line. Each record is the complete current state of a
+ * client, group or role, the deletion of one, or the general settings.
+ * Replaying the records in order over the config file gives the current
+ * state, so saving after a change only costs the size of what changed.
+ *
+ * A client record carries the groups the client is in and a group record the
+ * clients in the group, so whichever end of a membership was written last
+ * describes it correctly. Only clients and groups refer to roles.
+ *
+ * Once the journal holds more records than there are entities, and at least
+ * this many, the config file is rewritten and the journal removed. */
+#define JOURNAL_COMPACT_MIN 1024
+
+#define JOURNAL_CLIENT 'c'
+#define JOURNAL_GROUP 'g'
+#define JOURNAL_ROLE 'r'
+
+
+static char *journal__path(struct dynsec__data *data)
+{
+	char *path;
+	size_t len;
+
+	len = strlen(data->config_file) + strlen(".journal") + 1;
+	path = mosquitto_malloc(len);
+	if(path){
+		snprintf(path, len, "%s.journal", data->config_file);
+	}
+	return path;
+}
+
+
+static unsigned long journal__live_count(struct dynsec__data *data)
+{
+	return HASH_COUNT(data->clients) + HASH_COUNT(data->groups) + HASH_COUNT(data->roles);
+}
+
+
+static void journal__marks_clear(struct dynsec__data *data)
+{
+	struct dynsec__journal_mark *mark, *mark_tmp;
+
+	HASH_ITER(hh, data->journal_marks, mark, mark_tmp){
+		HASH_DELETE(hh, data->journal_marks, mark);
+		mosquitto_free(mark);
+	}
+}
+
+
+static void journal__mark_entity(struct dynsec__data *data, char type, const char *name, bool deleted)
+{
+	struct dynsec__journal_mark *mark, *found = NULL;
+	size_t keylen;
+
+	keylen = 1 + strlen(name);
+	mark = mosquitto_calloc(1, sizeof(struct dynsec__journal_mark) + keylen + 1);
+	if(mark == NULL){
+		/* The change can't be tracked, so write the whole config instead */
+		data->journal_compact = true;
+		return;
+	}
+	mark->key[0] = type;
+	memcpy(&mark->key[1], name, keylen);
+
+	HASH_FIND(hh, data->journal_marks, mark->key, keylen, found);
+	if(found){
+		mosquitto_free(mark);
+		mark = found;
+	}else{
+		HASH_ADD(hh, data->journal_marks, key, keylen, mark);
+	}
+	if(deleted){
+		mark->deleted = true;
+	}
+}
+
+
+/* Record the entities named by a command that has changed the config. */
+void dynsec_journal__mark(struct dynsec__data *data, struct mosquitto_control_cmd *cmd)
+{
+	cJSON *j_clients, *j_client;
+	const char *name;
+
+	if(data->journal == false){
+		return;
+	}
+
+	if(json_get_string(cmd->j_command, "username", &name, false) == MOSQ_ERR_SUCCESS){
+		journal__mark_entity(data, JOURNAL_CLIENT, name, !strcasecmp(cmd->command_name, "deleteClient"));
+	}
+	/* Bulk commands */
+	j_clients = cJSON_GetObjectItem(cmd->j_command, "clients");
+	if(j_clients && cJSON_IsArray(j_clients)){
+		cJSON_ArrayForEach(j_client, j_clients){
+			if(json_get_string(j_client, "username", &name, false) == MOSQ_ERR_SUCCESS){
+				journal__mark_entity(data, JOURNAL_CLIENT, name, false);
+			}
+		}
+	}
+	if(json_get_string(cmd->j_command, "groupname", &name, false) == MOSQ_ERR_SUCCESS){
+		journal__mark_entity(data, JOURNAL_GROUP, name, !strcasecmp(cmd->command_name, "deleteGroup"));
+	}
+	if(json_get_string(cmd->j_command, "rolename", &name, false) == MOSQ_ERR_SUCCESS){
+		journal__mark_entity(data, JOURNAL_ROLE, name, !strcasecmp(cmd->command_name, "deleteRole"));
+	}
+}
+
+
+/* Write a single record, taking ownership of j_item. */
+static int journal__record_write(FILE *fptr, const char *type, cJSON *j_item)
+{
+	cJSON *j_record;
+	char *json_str;
+	int rc = MOSQ_ERR_SUCCESS;
+
+	if(j_item == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	j_record = cJSON_CreateObject();
+	if(j_record == NULL){
+		cJSON_Delete(j_item);
+		return MOSQ_ERR_NOMEM;
+	}
+	cJSON_AddItemToObject(j_record, type, j_item);
+
+	json_str = cJSON_PrintUnformatted(j_record);
+	cJSON_Delete(j_record);
+	if(json_str == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	if(fputs(json_str, fptr) == EOF || fputc('\n', fptr) == EOF){
+		rc = MOSQ_ERR_ERRNO;
+	}
+	mosquitto_free(json_str);
+	return rc;
+}
+
+
+static int journal__mark_write(struct dynsec__data *data, FILE *fptr, struct dynsec__journal_mark *mark)
+{
+	const char *name = &mark->key[1];
+	const char *set_type, *delete_type;
+	cJSON *j_item = NULL;
+	bool found = false;
+	int rc;
+
+	if(mark->key[0] == JOURNAL_CLIENT){
+		struct dynsec__client *client = dynsec_clients__find(data, name);
+		set_type = "client";
+		delete_type = "deleteClient";
+		if(client){
+			found = true;
+			j_item = dynsec_clients__journal_item(client);
+		}
+	}else if(mark->key[0] == JOURNAL_GROUP){
+		struct dynsec__group *group = dynsec_groups__find(data, name);
+		set_type = "group";
+		delete_type = "deleteGroup";
+		if(group){
+			found = true;
+			j_item = dynsec_groups__journal_item(group);
+		}
+	}else{
+		struct dynsec__role *role = dynsec_roles__find(data, name);
+		set_type = "role";
+		delete_type = "deleteRole";
+		if(role){
+			found = true;
+			j_item = dynsec_roles__journal_item(role);
+		}
+	}
+
+	/* An entity that was deleted and created again in the same batch must not
+	 * keep anything from before the deletion when replayed. */
+	if(mark->deleted || found == false){
+		rc = journal__record_write(fptr, delete_type, cJSON_CreateString(name));
+		if(rc){
+			cJSON_Delete(j_item);
+			return rc;
+		}
+	}
+	if(found){
+		return journal__record_write(fptr, set_type, j_item);
+	}
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+static int journal__general_write(struct dynsec__data *data, FILE *fptr)
+{
+	cJSON *j_general;
+
+	j_general = cJSON_CreateObject();
+	if(j_general == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	if(dynsec__general_config_save(data, j_general)
+			|| (data->anonymous_group
+				&& cJSON_AddStringToObject(j_general, "anonymousGroup", data->anonymous_group->groupname) == NULL)){
+
+		cJSON_Delete(j_general);
+		return MOSQ_ERR_NOMEM;
+	}
+	return journal__record_write(fptr, "general", j_general);
+}
+
+
+/* Append the entities changed since the last save to the journal. */
+int dynsec_journal__append(struct dynsec__data *data)
+{
+	const char order[] = {JOURNAL_ROLE, JOURNAL_CLIENT, JOURNAL_GROUP};
+	struct dynsec__journal_mark *mark, *mark_tmp;
+	unsigned long records = 0;
+	char *path;
+	FILE *fptr;
+	size_t i;
+	int rc = MOSQ_ERR_SUCCESS;
+
+	path = journal__path(data);
+	if(path == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	fptr = mosquitto_fopen(path, "ab", true);
+	if(fptr == NULL){
+		mosquitto_log_printf(MOSQ_LOG_ERR, "Error saving Dynamic security plugin config: Unable to open journal %s: %s.", path, strerror(errno));
+		mosquitto_free(path);
+		return MOSQ_ERR_ERRNO;
+	}
+
+	for(i=0; i<sizeof(order) && rc == MOSQ_ERR_SUCCESS; i++){
+		HASH_ITER(hh, data->journal_marks, mark, mark_tmp){
+			if(mark->key[0] == order[i]){
+				rc = journal__mark_write(data, fptr, mark);
+				if(rc){
+					break;
+				}
+				records++;
+			}
+		}
+	}
+	if(rc == MOSQ_ERR_SUCCESS){
+		rc = journal__general_write(data, fptr);
+		records++;
+	}
+
+#ifndef WIN32
+	if(rc == MOSQ_ERR_SUCCESS && (fflush(fptr) != 0 || fsync(fileno(fptr)) != 0)){
+		rc = MOSQ_ERR_ERRNO;
+	}
+#endif
+	if(fclose(fptr) != 0 && rc == MOSQ_ERR_SUCCESS){
+		rc = MOSQ_ERR_ERRNO;
+	}
+	if(rc == MOSQ_ERR_ERRNO){
+		mosquitto_log_printf(MOSQ_LOG_ERR, "Error saving Dynamic security plugin config: Unable to write journal %s: %s.", path, strerror(errno));
+	}
+	mosquitto_free(path);
+
+	if(rc == MOSQ_ERR_SUCCESS){
+		data->journal_records += records;
+		journal__marks_clear(data);
+	}
+	return rc;
+}
+
+
+bool dynsec_journal__compact_due(struct dynsec__data *data)
+{
+	return data->journal_compact
+		|| (data->journal_records >= JOURNAL_COMPACT_MIN && data->journal_records > data->journal_live);
+}
+
+
+/* Called once the whole config has been written, so the journal is no longer
+ * needed. */
+void dynsec_journal__remove(struct dynsec__data *data)
+{
+	char *path;
+
+	path = journal__path(data);
+	if(path){
+		if(remove(path) != 0 && errno != ENOENT){
+			mosquitto_log_printf(MOSQ_LOG_WARNING, "Warning: Unable to remove Dynamic security plugin journal %s: %s.", path, strerror(errno));
+		}
+		mosquitto_free(path);
+	}
+	journal__marks_clear(data);
+	data->journal_records = 0;
+	data->journal_live = journal__live_count(data);
+	data->journal_compact = false;
+}
+
+
+static int journal__record_apply(struct dynsec__data *data, cJSON *j_item)
+{
+	const char *type = j_item->string;
+	const char *groupname;
+
+	if(!strcmp(type, "client") && cJSON_IsObject(j_item)){
+		return dynsec_clients__journal_apply(data, j_item);
+	}else if(!strcmp(type, "deleteClient") && cJSON_IsString(j_item)){
+		dynsec_clients__journal_delete(data, j_item->valuestring);
+	}else if(!strcmp(type, "group") && cJSON_IsObject(j_item)){
+		return dynsec_groups__journal_apply(data, j_item);
+	}else if(!strcmp(type, "deleteGroup") && cJSON_IsString(j_item)){
+		dynsec_groups__journal_delete(data, j_item->valuestring);
+	}else if(!strcmp(type, "role") && cJSON_IsObject(j_item)){
+		return dynsec_roles__journal_apply(data, j_item);
+	}else if(!strcmp(type, "deleteRole") && cJSON_IsString(j_item)){
+		dynsec_roles__journal_delete(data, j_item->valuestring);
+	}else if(!strcmp(type, "general") && cJSON_IsObject(j_item)){
+		dynsec__general_config_load(data, j_item);
+		if(json_get_string(j_item, "anonymousGroup", &groupname, false) == MOSQ_ERR_SUCCESS){
+			data->anonymous_group = dynsec_groups__find(data, groupname);
+		}else{
+			data->anonymous_group = NULL;
+		}
+	}
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+/* Replay the journal over the config that has just been loaded. A record that
+ * can't be parsed, such as a partly written final line, is ignored. */
+int dynsec_journal__load(struct dynsec__data *data)
+{
+	char *path, *buf, *line, *next;
+	unsigned long records = 0;
+	cJSON *j_record;
+	int rc = MOSQ_ERR_SUCCESS;
+
+	path = journal__path(data);
+	if(path == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	if(mosquitto_read_file(path, true, &buf, NULL) != MOSQ_ERR_SUCCESS || buf == NULL){
+		/* No journal */
+		mosquitto_free(path);
+		data->journal_live = journal__live_count(data);
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	for(line = buf; line && rc != MOSQ_ERR_NOMEM; line = next){
+		next = strchr(line, '\n');
+		if(next){
+			*next = '\0';
+			next++;
+		}
+		if(line[0] == '\0'){
+			continue;
+		}
+
+		j_record = cJSON_Parse(line);
+		if(j_record == NULL || cJSON_IsObject(j_record) == false || j_record->child == NULL){
+			mosquitto_log_printf(MOSQ_LOG_WARNING, "Warning: Ignoring unreadable record in Dynamic security plugin journal %s.", path);
+			cJSON_Delete(j_record);
+			continue;
+		}
+		rc = journal__record_apply(data, j_record->child);
+		cJSON_Delete(j_record);
+		records++;
+	}
+	mosquitto_free(buf);
+
+	dynsec_clients__sort(data);
+	dynsec_groups__sort(data);
+	dynsec_roles__sort(data);
+
+	mosquitto_log_printf(MOSQ_LOG_INFO, "Dynamic security plugin replayed %lu journal records from %s.", records, path);
+	mosquitto_free(path);
+
+	data->journal_records = records;
+	data->journal_live = journal__live_count(data);
+
+	return rc == MOSQ_ERR_NOMEM ? rc : MOSQ_ERR_SUCCESS;
+}
+
+
+void dynsec_journal__cleanup(struct dynsec__data *data)
+{
+	journal__marks_clear(data);
+}
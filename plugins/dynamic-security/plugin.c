@@ -68,6 +68,8 @@ int mosquitto_plugin_init(mosquitto_plugin_id_t *identifier, void **user_data, s
 			if(dynsec_data.config_file == NULL){
 				return MOSQ_ERR_NOMEM;
 			}
+		}else if(!strcasecmp(options[i].key, "journal")){
+			dynsec_data.journal = !strcasecmp(options[i].value, "true");
 		}else if(!strcasecmp(options[i].key, "password_init_file")){
 			dynsec_data.password_init_file = mosquitto_strdup(options[i].value);
 			if(dynsec_data.password_init_file == NULL){
@@ -82,6 +84,7 @@ int mosquitto_plugin_init(mosquitto_plugin_id_t *identifier, void **user_data, s
 
 	plg_id = identifier;
 	mosquitto_plugin_set_info(identifier, "dynamic-security", NULL);
+	mosquitto_plugin_set_acl_cacheable(identifier, true);
 
 	dynsec__config_load(&dynsec_data);
 
@@ -127,6 +130,14 @@ int mosquitto_plugin_init(mosquitto_plugin_id_t *identifier, void **user_data, s
 		goto error;
 	}
 
+	rc = mosquitto_callback_register(plg_id, MOSQ_EVT_DISCONNECT, dynsec__acl_disconnect_callback, NULL, &dynsec_data);
+	if(rc == MOSQ_ERR_NOMEM){
+		mosquitto_log_printf(MOSQ_LOG_ERR, "Error: Out of memory.");
+		goto error;
+	}else if(rc != MOSQ_ERR_SUCCESS){
+		goto error;
+	}
+
 	return MOSQ_ERR_SUCCESS;
 error:
 	mosquitto_free(dynsec_data.config_file);
@@ -141,10 +152,17 @@ int mosquitto_plugin_cleanup(void *user_data, struct mosquitto_opt *options, int
 	UNUSED(options);
 	UNUSED(option_count);
 
+	if(dynsec_data.config_file && dynsec_data.journal_records > 0){
+		/* Leave a complete config file behind */
+		dynsec_data.journal_compact = true;
+		dynsec__config_save(&dynsec_data);
+	}
+	dynsec_journal__cleanup(&dynsec_data);
 	dynsec_groups__cleanup(&dynsec_data);
 	dynsec_clients__cleanup(&dynsec_data);
 	dynsec_roles__cleanup(&dynsec_data);
 	dynsec_kicklist__cleanup(&dynsec_data);
+	dynsec__acl_cache_cleanup(&dynsec_data);
 
 	mosquitto_free(dynsec_data.config_file);
 	dynsec_data.config_file = NULL;
@@ -156,6 +174,7 @@ int mosquitto_plugin_cleanup(void *user_data, struct mosquitto_opt *options, int
 	mosquitto_callback_unregister(plg_id, MOSQ_EVT_BASIC_AUTH, dynsec_auth__basic_auth_callback, NULL);
 	mosquitto_callback_unregister(plg_id, MOSQ_EVT_ACL_CHECK, dynsec__acl_check_callback, NULL);
 	mosquitto_callback_unregister(plg_id, MOSQ_EVT_TICK, dynsec__tick_callback, NULL);
+	mosquitto_callback_unregister(plg_id, MOSQ_EVT_DISCONNECT, dynsec__acl_disconnect_callback, NULL);
 
 	return MOSQ_ERR_SUCCESS;
 }
@@ -83,9 +83,24 @@ static void role__free_item(struct dynsec__data *data, struct dynsec__role *role
 	role__free_all_acls(&role->acls.subscribe_pattern);
 	role__free_all_acls(&role->acls.unsubscribe_literal);
 	role__free_all_acls(&role->acls.unsubscribe_pattern);
+	dynsec_acl_trie__free(&role->acls.publish_c_send_trie);
+	dynsec_acl_trie__free(&role->acls.publish_c_recv_trie);
 	mosquitto_free(role);
 }
 
+/* Recompile the publish ACL tries after the ACLs have changed. If a trie can't
+ * be built the ACL list is checked directly instead. */
+void dynsec_roles__acl_trie_update(struct dynsec__role *role)
+{
+	if(dynsec_acl_trie__build(role->acls.publish_c_send, &role->acls.publish_c_send_trie) == MOSQ_ERR_NOMEM){
+		mosquitto_log_printf(MOSQ_LOG_WARNING, "dynsec: Out of memory compiling ACLs for role %s.", role->rolename);
+	}
+	if(dynsec_acl_trie__build(role->acls.publish_c_recv, &role->acls.publish_c_recv_trie) == MOSQ_ERR_NOMEM){
+		mosquitto_log_printf(MOSQ_LOG_WARNING, "dynsec: Out of memory compiling ACLs for role %s.", role->rolename);
+	}
+}
+
+
 struct dynsec__role *dynsec_roles__find(struct dynsec__data *data, const char *rolename)
 {
 	struct dynsec__role *role = NULL;
@@ -262,93 +277,174 @@ static int dynsec_roles__acl_load(cJSON *j_acls, const char *key, struct dynsec_
 }
 
 
-int dynsec_roles__config_load(struct dynsec__data *data, cJSON *tree)
+int dynsec_roles__config_load_item(struct dynsec__data *data, cJSON *j_role)
 {
-	cJSON *j_roles, *j_role, *j_acls;
+	cJSON *j_acls;
 	struct dynsec__role *role;
 	size_t rolename_len;
 
-	j_roles = cJSON_GetObjectItem(tree, "roles");
-	if(j_roles == NULL){
+	/* Role name */
+	const char *rolename;
+	if(json_get_string(j_role, "rolename", &rolename, false) != MOSQ_ERR_SUCCESS){
+		return 0;
+	}
+	rolename_len = strlen(rolename);
+	if(rolename_len == 0){
+		return 0;
+	}
+	if(dynsec_roles__find(data, rolename)){
 		return 0;
 	}
 
-	if(cJSON_IsArray(j_roles) == false){
-		return 1;
+	role = mosquitto_calloc(1, sizeof(struct dynsec__role) + rolename_len + 1);
+	if(role == NULL){
+		return MOSQ_ERR_NOMEM;
 	}
+	strncpy(role->rolename, rolename, rolename_len+1);
 
-	cJSON_ArrayForEach(j_role, j_roles){
-		if(cJSON_IsObject(j_role) == true){
-			/* Role name */
-			const char *rolename;
-			if(json_get_string(j_role, "rolename", &rolename, false) != MOSQ_ERR_SUCCESS){
-				continue;
-			}
-			rolename_len = strlen(rolename);
-			if(rolename_len == 0){
-				continue;
-			}
-			if(dynsec_roles__find(data, rolename)){
-				continue;
-			}
+	/* Text name */
+	const char *textname;
+	if(json_get_string(j_role, "textname", &textname, false) == MOSQ_ERR_SUCCESS){
+		role->text_name = mosquitto_strdup(textname);
+		if(role->text_name == NULL){
+			mosquitto_free(role);
+			return 0;
+		}
+	}
 
-			role = mosquitto_calloc(1, sizeof(struct dynsec__role) + rolename_len + 1);
-			if(role == NULL){
-				return MOSQ_ERR_NOMEM;
-			}
-			strncpy(role->rolename, rolename, rolename_len+1);
-
-			/* Text name */
-			const char *textname;
-			if(json_get_string(j_role, "textname", &textname, false) == MOSQ_ERR_SUCCESS){
-				role->text_name = mosquitto_strdup(textname);
-				if(role->text_name == NULL){
-					mosquitto_free(role);
-					continue;
-				}
-			}
+	/* Text description */
+	const char *textdescription;
+	if(json_get_string(j_role, "textdescription", &textdescription, false) == MOSQ_ERR_SUCCESS){
+		role->text_description = mosquitto_strdup(textdescription);
+		if(role->text_description == NULL){
+			mosquitto_free(role->text_name);
+			mosquitto_free(role);
+			return 0;
+		}
+	}
 
-			/* Text description */
-			const char *textdescription;
-			if(json_get_string(j_role, "textdescription", &textdescription, false) == MOSQ_ERR_SUCCESS){
-				role->text_description = mosquitto_strdup(textdescription);
-				if(role->text_description == NULL){
-					mosquitto_free(role->text_name);
-					mosquitto_free(role);
-					continue;
-				}
-			}
+	/* Allow wildcard subs */
+	json_get_bool(j_role, "allowwildcardsubs", &role->allow_wildcard_subs, true, true);
 
-			/* Allow wildcard subs */
-			json_get_bool(j_role, "allowwildcardsubs", &role->allow_wildcard_subs, true, true);
-
-			/* ACLs */
-			j_acls = cJSON_GetObjectItem(j_role, "acls");
-			if(j_acls && cJSON_IsArray(j_acls)){
-				if(dynsec_roles__acl_load(j_acls, ACL_TYPE_PUB_C_SEND, &role->acls.publish_c_send) != 0
-						|| dynsec_roles__acl_load(j_acls, ACL_TYPE_PUB_C_RECV, &role->acls.publish_c_recv) != 0
-						|| dynsec_roles__acl_load(j_acls, ACL_TYPE_SUB_LITERAL, &role->acls.subscribe_literal) != 0
-						|| dynsec_roles__acl_load(j_acls, ACL_TYPE_SUB_PATTERN, &role->acls.subscribe_pattern) != 0
-						|| dynsec_roles__acl_load(j_acls, ACL_TYPE_UNSUB_LITERAL, &role->acls.unsubscribe_literal) != 0
-						|| dynsec_roles__acl_load(j_acls, ACL_TYPE_UNSUB_PATTERN, &role->acls.unsubscribe_pattern) != 0
-						){
-
-					mosquitto_free(role->text_name);
-					mosquitto_free(role->text_description);
-					mosquitto_free(role);
-					continue;
-				}
-			}
+	/* ACLs */
+	j_acls = cJSON_GetObjectItem(j_role, "acls");
+	if(j_acls && cJSON_IsArray(j_acls)){
+		if(dynsec_roles__acl_load(j_acls, ACL_TYPE_PUB_C_SEND, &role->acls.publish_c_send) != 0
+				|| dynsec_roles__acl_load(j_acls, ACL_TYPE_PUB_C_RECV, &role->acls.publish_c_recv) != 0
+				|| dynsec_roles__acl_load(j_acls, ACL_TYPE_SUB_LITERAL, &role->acls.subscribe_literal) != 0
+				|| dynsec_roles__acl_load(j_acls, ACL_TYPE_SUB_PATTERN, &role->acls.subscribe_pattern) != 0
+				|| dynsec_roles__acl_load(j_acls, ACL_TYPE_UNSUB_LITERAL, &role->acls.unsubscribe_literal) != 0
+				|| dynsec_roles__acl_load(j_acls, ACL_TYPE_UNSUB_PATTERN, &role->acls.unsubscribe_pattern) != 0
+				){
 
-			HASH_ADD(hh, data->roles, rolename, rolename_len, role);
+			mosquitto_free(role->text_name);
+			mosquitto_free(role->text_description);
+			mosquitto_free(role);
+			return 0;
 		}
 	}
-	HASH_SORT(data->roles, role_cmp);
+	dynsec_roles__acl_trie_update(role);
+
+	HASH_ADD(hh, data->roles, rolename, rolename_len, role);
 
 	return 0;
 }
 
 
+/* ################################################################
+ * #
+ * # Journal
+ * #
+ * ################################################################ */
+
+
+cJSON *dynsec_roles__journal_item(struct dynsec__role *role)
+{
+	return add_role_to_json(role, true);
+}
+
+
+void dynsec_roles__journal_delete(struct dynsec__data *data, const char *rolename)
+{
+	struct dynsec__role *role;
+	struct dynsec__clientlist *clientlist, *clientlist_tmp = NULL;
+	struct dynsec__grouplist *grouplist, *grouplist_tmp = NULL;
+
+	role = dynsec_roles__find(data, rolename);
+	if(role){
+		HASH_ITER(hh, role->clientlist, clientlist, clientlist_tmp){
+			dynsec_rolelist__client_remove(clientlist->client, role);
+		}
+		HASH_ITER(hh, role->grouplist, grouplist, grouplist_tmp){
+			dynsec_rolelist__group_remove(grouplist->group, role);
+		}
+		role__free_item(data, role, true);
+	}
+}
+
+
+/* Update a role from a journal record. An existing role is updated in place,
+ * because the clients and groups that hold it are recorded against them. */
+int dynsec_roles__journal_apply(struct dynsec__data *data, cJSON *j_role)
+{
+	struct dynsec__role *role;
+	const char *rolename, *str;
+	cJSON *j_acls;
+
+	if(json_get_string(j_role, "rolename", &rolename, false) != MOSQ_ERR_SUCCESS){
+		return MOSQ_ERR_INVAL;
+	}
+	role = dynsec_roles__find(data, rolename);
+	if(role == NULL){
+		return dynsec_roles__config_load_item(data, j_role);
+	}
+
+	mosquitto_free(role->text_name);
+	role->text_name = NULL;
+	if(json_get_string(j_role, "textname", &str, false) == MOSQ_ERR_SUCCESS){
+		role->text_name = mosquitto_strdup(str);
+	}
+	mosquitto_free(role->text_description);
+	role->text_description = NULL;
+	if(json_get_string(j_role, "textdescription", &str, false) == MOSQ_ERR_SUCCESS){
+		role->text_description = mosquitto_strdup(str);
+	}
+	json_get_bool(j_role, "allowwildcardsubs", &role->allow_wildcard_subs, true, true);
+
+	dynsec_acl_trie__free(&role->acls.publish_c_send_trie);
+	dynsec_acl_trie__free(&role->acls.publish_c_recv_trie);
+	role__free_all_acls(&role->acls.publish_c_send);
+	role__free_all_acls(&role->acls.publish_c_recv);
+	role__free_all_acls(&role->acls.subscribe_literal);
+	role__free_all_acls(&role->acls.subscribe_pattern);
+	role__free_all_acls(&role->acls.unsubscribe_literal);
+	role__free_all_acls(&role->acls.unsubscribe_pattern);
+
+	j_acls = cJSON_GetObjectItem(j_role, "acls");
+	if(j_acls && cJSON_IsArray(j_acls)){
+		if(dynsec_roles__acl_load(j_acls, ACL_TYPE_PUB_C_SEND, &role->acls.publish_c_send) != 0
+				|| dynsec_roles__acl_load(j_acls, ACL_TYPE_PUB_C_RECV, &role->acls.publish_c_recv) != 0
+				|| dynsec_roles__acl_load(j_acls, ACL_TYPE_SUB_LITERAL, &role->acls.subscribe_literal) != 0
+				|| dynsec_roles__acl_load(j_acls, ACL_TYPE_SUB_PATTERN, &role->acls.subscribe_pattern) != 0
+				|| dynsec_roles__acl_load(j_acls, ACL_TYPE_UNSUB_LITERAL, &role->acls.unsubscribe_literal) != 0
+				|| dynsec_roles__acl_load(j_acls, ACL_TYPE_UNSUB_PATTERN, &role->acls.unsubscribe_pattern) != 0
+				){
+
+			return MOSQ_ERR_NOMEM;
+		}
+	}
+	dynsec_roles__acl_trie_update(role);
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+void dynsec_roles__sort(struct dynsec__data *data)
+{
+	HASH_SORT(data->roles, role_cmp);
+}
+
+
 int dynsec_roles__process_create(struct dynsec__data *data, struct mosquitto_control_cmd *cmd)
 {
 	const char *rolename;
@@ -435,7 +531,7 @@ int dynsec_roles__process_create(struct dynsec__data *data, struct mosquitto_con
 			goto error;
 		}
 	}
-
+	dynsec_roles__acl_trie_update(role);
 
 	HASH_ADD_INORDER(hh, data->roles, rolename, rolename_len, role, role_cmp);
 
@@ -701,6 +797,7 @@ int dynsec_roles__process_add_acl(struct dynsec__data *data, struct mosquitto_co
 	json_get_bool(cmd->j_command, "allow", &acl->allow, true, false);
 
 	HASH_ADD_INORDER(hh, *acllist, topic, topic_len, acl, insert_acl_cmp);
+	dynsec_roles__acl_trie_update(role);
 	dynsec__config_batch_save(data);
 	mosquitto_control_command_reply(cmd, NULL);
 
@@ -778,6 +875,7 @@ int dynsec_roles__process_remove_acl(struct dynsec__data *data, struct mosquitto
 	HASH_FIND(hh, *acllist, topic, strlen(topic), acl);
 	if(acl){
 		role__free_acl(acllist, acl);
+		dynsec_roles__acl_trie_update(role);
 		dynsec__config_batch_save(data);
 		mosquitto_control_command_reply(cmd, NULL);
 
@@ -942,6 +1040,7 @@ int dynsec_roles__process_modify(struct dynsec__data *data, struct mosquitto_con
 		role->acls.subscribe_pattern = tmp_subscribe_pattern;
 		role->acls.unsubscribe_literal = tmp_unsubscribe_literal;
 		role->acls.unsubscribe_pattern = tmp_unsubscribe_pattern;
+		dynsec_roles__acl_trie_update(role);
 		do_kick = true;
 	}
 
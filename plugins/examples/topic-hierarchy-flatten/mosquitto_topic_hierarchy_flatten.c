@@ -27,6 +27,11 @@ Contributors:
  * message is published for each matching message. If set to false, the
  * original message has its topic replaced with the output topic.
  *
+ * The broker can do the same as "plugin_opt_republish false" itself, using the
+ * topic_rewrite option in mosquitto.conf:
+ *
+ *   topic_rewrite my/+/topics the/single/output/topic
+ *
  * Compile with:
  *   gcc -I<path to mosquitto-repo/include> -fPIC -shared mosquitto_topic_hierarchy_flatten.c -o mosquitto_topic_hierarchy_flatten.so
  *
@@ -37,6 +37,11 @@ Contributors:
  *
  * You should be very sure of what you are doing before making use of this feature.
  *
+ * If only the topics of incoming messages need changing, for all clients, the
+ * broker can do this itself using the topic_rewrite option in mosquitto.conf:
+ *
+ *   topic_rewrite # %c/%1
+ *
  * Compile with:
  *   gcc -I<path to mosquitto-repo/include> -fPIC -shared mosquitto_topic_jail.c -o mosquitto_topic_jail.so
  *
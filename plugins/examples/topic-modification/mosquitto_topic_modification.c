@@ -23,6 +23,12 @@ Contributors:
  *
  * You should be very sure of what you are doing before making use of this feature.
  *
+ * The broker can make simple changes like this one itself, without a plugin
+ * and without allocating for messages that do not match, using the
+ * topic_rewrite option in mosquitto.conf:
+ *
+ *   topic_rewrite device/+/data/uplink device/%1/data
+ *
  * Compile with:
  *   gcc -I<path to mosquitto-repo/include> -fPIC -shared mosquitto_topic_modification.c -o mosquitto_topic_modification.so
  *
@@ -42,7 +42,7 @@ int password_file__check(int event, void *event_data, void *userdata)
 	if(u){
 		if(u->pw){
 			if(ed->password){
-				return mosquitto_pw_verify(u->pw, ed->password);
+				return mosquitto_basic_auth_pw_verify(ed->client, u->pw, ed->password);
 			}else{
 				return MOSQ_ERR_AUTH;
 			}
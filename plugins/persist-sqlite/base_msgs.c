@@ -19,10 +19,9 @@ Contributors:
 #include <string.h>
 #include <sqlite3.h>
 #include <stdio.h>
-#include <stdlib.h>
-#include <cjson/cJSON.h>
 
 #include "mosquitto.h"
+#include "mosquitto/broker.h"
 #include "persist_sqlite.h"
 #include "util.h"
 
@@ -31,49 +30,10 @@ int persist_sqlite__base_msg_add_cb(int event, void *event_data, void *userdata)
 {
 	struct mosquitto_evt_persist_base_msg *ed = event_data;
 	struct mosquitto_sqlite *ms = userdata;
-	int rc = MOSQ_ERR_UNKNOWN;
-	char *str = NULL;
-	UNUSED(event);
-
 
-	rc = 0;
-	rc += sqlite3_bind_int64(ms->base_msg_add_stmt, 1, (int64_t)ed->data.store_id);
-	rc += sqlite3_bind_int64(ms->base_msg_add_stmt, 2, ed->data.expiry_time);
-	rc += sqlite3_bind_text(ms->base_msg_add_stmt, 3, ed->data.topic, (int)strlen(ed->data.topic), SQLITE_STATIC);
-	if(ed->data.payload){
-		rc += sqlite3_bind_blob(ms->base_msg_add_stmt, 4, ed->data.payload, (int)ed->data.payloadlen, SQLITE_STATIC);
-	}else{
-		rc += sqlite3_bind_null(ms->base_msg_add_stmt, 4);
-	}
-	if(ed->data.source_id){
-		rc += sqlite3_bind_text(ms->base_msg_add_stmt, 5, ed->data.source_id, (int)strlen(ed->data.source_id), SQLITE_STATIC);
-	}else{
-		rc += sqlite3_bind_null(ms->base_msg_add_stmt, 5);
-	}
-	if(ed->data.source_username){
-		rc += sqlite3_bind_text(ms->base_msg_add_stmt, 6, ed->data.source_username, (int)strlen(ed->data.source_username), SQLITE_STATIC);
-	}else{
-		rc += sqlite3_bind_null(ms->base_msg_add_stmt, 6);
-	}
-	rc += sqlite3_bind_int(ms->base_msg_add_stmt, 7, (int)ed->data.payloadlen);
-	rc += sqlite3_bind_int(ms->base_msg_add_stmt, 8, ed->data.source_mid);
-	rc += sqlite3_bind_int(ms->base_msg_add_stmt, 9, ed->data.source_port);
-	rc += sqlite3_bind_int(ms->base_msg_add_stmt, 10, ed->data.qos);
-	rc += sqlite3_bind_int(ms->base_msg_add_stmt, 11, ed->data.retain);
-	if(ed->data.properties){
-		str = properties_to_json_str(ed->data.properties);
-	}
-	if(str){
-		rc += sqlite3_bind_text(ms->base_msg_add_stmt, 12, str, (int)strlen(str), SQLITE_STATIC);
-	}else{
-		rc += sqlite3_bind_null(ms->base_msg_add_stmt, 12);
-	}
-
-	rc = sqlite3_single_step_stmt(rc, ms, ms->base_msg_add_stmt);
-	sqlite3_reset(ms->base_msg_add_stmt);
-	free(str);
+	UNUSED(event);
 
-	return rc;
+	return persist_sqlite__base_msg_row_add(ms, ed);
 }
 
 
@@ -85,6 +45,7 @@ int persist_sqlite__base_msg_remove_cb(int event, void *event_data, void *userda
 
 	UNUSED(event);
 
+	persist_sqlite__batch_flush(ms);
 	if(sqlite3_bind_int64(ms->base_msg_remove_stmt, 1, (int64_t)ed->data.store_id) == SQLITE_OK){
 		rc = sqlite3_single_step_stmt(0, ms, ms->base_msg_remove_stmt);
 	}
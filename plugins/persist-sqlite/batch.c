@@ -0,0 +1,287 @@
+/*
+Copyright (c) 2026 Roger Light <roger@atchoo.org>
+
+All rights reserved. This program and the accompanying materials
+are made available under the terms of the Eclipse Public License 2.0
+and Eclipse Distribution License v1.0 which accompany this distribution.
+
+The Eclipse Public License is available at
+   https://www.eclipse.org/legal/epl-2.0/
+and the Eclipse Distribution License is available at
+  http://www.eclipse.org/org/documents/edl-v10.php.
+
+SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+
+Contributors:
+   Roger Light - initial implementation and documentation.
+*/
+
+/* Base messages and client messages are added far more often than anything
+ * else, so their add events are buffered and written with a single multi-row
+ * INSERT once PERSIST_SQLITE_BATCH_ROWS rows are waiting. Anything that could
+ * observe the buffered rows - a remove, an update, or the end of the
+ * transaction - flushes the buffers first.
+ */
+
+#include <sqlite3.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mosquitto.h"
+#include "mosquitto/broker.h"
+#include "persist_sqlite.h"
+#include "util.h"
+
+#define BASE_MSG_COLUMNS 12
+#define CLIENT_MSG_COLUMNS 10
+
+
+static int bind_base_msg_row(sqlite3_stmt *stmt, int offset, const struct persist_sqlite_base_msg_row *row)
+{
+	int rc = 0;
+
+	rc += sqlite3_bind_int64(stmt, offset+1, row->store_id);
+	rc += sqlite3_bind_int64(stmt, offset+2, row->expiry_time);
+	rc += sqlite3_bind_text_from_c_str(stmt, offset+3, row->topic);
+	rc += sqlite3_bind_blob_optional(stmt, offset+4, row->payload, (int)row->payloadlen);
+	rc += sqlite3_bind_text_from_optional_c_str(stmt, offset+5, row->source_id);
+	rc += sqlite3_bind_text_from_optional_c_str(stmt, offset+6, row->source_username);
+	rc += sqlite3_bind_int(stmt, offset+7, (int)row->payloadlen);
+	rc += sqlite3_bind_int(stmt, offset+8, row->source_mid);
+	rc += sqlite3_bind_int(stmt, offset+9, row->source_port);
+	rc += sqlite3_bind_int(stmt, offset+10, row->qos);
+	rc += sqlite3_bind_int(stmt, offset+11, row->retain);
+	rc += sqlite3_bind_blob_optional(stmt, offset+12, row->properties, row->properties_len);
+
+	return rc;
+}
+
+
+static int bind_client_msg_row(sqlite3_stmt *stmt, int offset, const struct persist_sqlite_client_msg_row *row)
+{
+	int rc = 0;
+
+	rc += sqlite3_bind_text_from_c_str(stmt, offset+1, row->clientid);
+	rc += sqlite3_bind_int64(stmt, offset+2, row->cmsg_id);
+	rc += sqlite3_bind_int64(stmt, offset+3, row->store_id);
+	rc += sqlite3_bind_int(stmt, offset+4, row->dup);
+	rc += sqlite3_bind_int(stmt, offset+5, row->direction);
+	rc += sqlite3_bind_int(stmt, offset+6, row->mid);
+	rc += sqlite3_bind_int(stmt, offset+7, row->qos);
+	rc += sqlite3_bind_int(stmt, offset+8, row->retain);
+	rc += sqlite3_bind_int(stmt, offset+9, row->state);
+	rc += sqlite3_bind_int(stmt, offset+10, (int)row->subscription_identifier);
+
+	return rc;
+}
+
+
+static void base_msg_row_free(struct persist_sqlite_base_msg_row *row)
+{
+	free(row->topic);
+	free(row->payload);
+	free(row->source_id);
+	free(row->source_username);
+	free(row->properties);
+	memset(row, 0, sizeof(struct persist_sqlite_base_msg_row));
+}
+
+
+static void client_msg_row_free(struct persist_sqlite_client_msg_row *row)
+{
+	free(row->clientid);
+	memset(row, 0, sizeof(struct persist_sqlite_client_msg_row));
+}
+
+
+static int base_msgs_flush(struct mosquitto_sqlite *ms)
+{
+	int rc = MOSQ_ERR_SUCCESS;
+	int i;
+
+	if(ms->base_msg_row_count == 0){
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	if(ms->base_msg_row_count == PERSIST_SQLITE_BATCH_ROWS){
+		int brc = 0;
+		for(i=0; i<PERSIST_SQLITE_BATCH_ROWS; i++){
+			brc += bind_base_msg_row(ms->base_msg_add_batch_stmt, i*BASE_MSG_COLUMNS, &ms->base_msg_rows[i]);
+		}
+		if(brc == SQLITE_OK && sqlite3_step(ms->base_msg_add_batch_stmt) == SQLITE_DONE){
+			ms->event_count += PERSIST_SQLITE_BATCH_ROWS;
+			ms->base_msg_row_count = 0;
+		}
+		sqlite3_reset(ms->base_msg_add_batch_stmt);
+		sqlite3_clear_bindings(ms->base_msg_add_batch_stmt);
+	}
+
+	/* Partial batches, and full batches that failed as a whole, are written a
+	 * row at a time so that a single bad row does not lose the others. */
+	for(i=0; i<ms->base_msg_row_count; i++){
+		int brc = bind_base_msg_row(ms->base_msg_add_stmt, 0, &ms->base_msg_rows[i]);
+		if(sqlite3_single_step_stmt(brc, ms, ms->base_msg_add_stmt) != MOSQ_ERR_SUCCESS){
+			rc = MOSQ_ERR_UNKNOWN;
+		}
+		sqlite3_reset(ms->base_msg_add_stmt);
+	}
+	sqlite3_clear_bindings(ms->base_msg_add_stmt);
+
+	for(i=0; i<PERSIST_SQLITE_BATCH_ROWS; i++){
+		base_msg_row_free(&ms->base_msg_rows[i]);
+	}
+	ms->base_msg_row_count = 0;
+
+	return rc;
+}
+
+
+static int client_msgs_flush(struct mosquitto_sqlite *ms)
+{
+	int rc = MOSQ_ERR_SUCCESS;
+	int i;
+
+	if(ms->client_msg_row_count == 0){
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	if(ms->client_msg_row_count == PERSIST_SQLITE_BATCH_ROWS){
+		int brc = 0;
+		for(i=0; i<PERSIST_SQLITE_BATCH_ROWS; i++){
+			brc += bind_client_msg_row(ms->client_msg_add_batch_stmt, i*CLIENT_MSG_COLUMNS, &ms->client_msg_rows[i]);
+		}
+		if(brc == SQLITE_OK && sqlite3_step(ms->client_msg_add_batch_stmt) == SQLITE_DONE){
+			ms->event_count += PERSIST_SQLITE_BATCH_ROWS;
+			ms->client_msg_row_count = 0;
+		}
+		sqlite3_reset(ms->client_msg_add_batch_stmt);
+		sqlite3_clear_bindings(ms->client_msg_add_batch_stmt);
+	}
+
+	for(i=0; i<ms->client_msg_row_count; i++){
+		int brc = bind_client_msg_row(ms->client_msg_add_stmt, 0, &ms->client_msg_rows[i]);
+		if(sqlite3_single_step_stmt(brc, ms, ms->client_msg_add_stmt) != MOSQ_ERR_SUCCESS){
+			rc = MOSQ_ERR_UNKNOWN;
+		}
+		sqlite3_reset(ms->client_msg_add_stmt);
+	}
+	sqlite3_clear_bindings(ms->client_msg_add_stmt);
+
+	for(i=0; i<PERSIST_SQLITE_BATCH_ROWS; i++){
+		client_msg_row_free(&ms->client_msg_rows[i]);
+	}
+	ms->client_msg_row_count = 0;
+
+	return rc;
+}
+
+
+int persist_sqlite__base_msg_row_add(struct mosquitto_sqlite *ms, const struct mosquitto_evt_persist_base_msg *ed)
+{
+	struct persist_sqlite_base_msg_row *row;
+
+	if(ms->base_msg_row_count == PERSIST_SQLITE_BATCH_ROWS){
+		base_msgs_flush(ms);
+	}
+
+	row = &ms->base_msg_rows[ms->base_msg_row_count];
+	row->store_id = (int64_t)ed->data.store_id;
+	row->expiry_time = ed->data.expiry_time;
+	row->payloadlen = ed->data.payloadlen;
+	row->source_mid = ed->data.source_mid;
+	row->source_port = ed->data.source_port;
+	row->qos = ed->data.qos;
+	row->retain = ed->data.retain;
+
+	row->topic = strdup(ed->data.topic);
+	if(row->topic == NULL){
+		goto error;
+	}
+	if(ed->data.payload && ed->data.payloadlen){
+		row->payload = malloc(ed->data.payloadlen);
+		if(row->payload == NULL){
+			goto error;
+		}
+		memcpy(row->payload, ed->data.payload, ed->data.payloadlen);
+	}
+	if(ed->data.source_id){
+		row->source_id = strdup(ed->data.source_id);
+		if(row->source_id == NULL){
+			goto error;
+		}
+	}
+	if(ed->data.source_username){
+		row->source_username = strdup(ed->data.source_username);
+		if(row->source_username == NULL){
+			goto error;
+		}
+	}
+	if(persist_sqlite__properties_to_blob(ed->data.properties, &row->properties, &row->properties_len)){
+		goto error;
+	}
+
+	ms->base_msg_row_count++;
+	if(ms->base_msg_row_count == PERSIST_SQLITE_BATCH_ROWS){
+		return base_msgs_flush(ms);
+	}
+	return MOSQ_ERR_SUCCESS;
+error:
+	base_msg_row_free(row);
+	return MOSQ_ERR_NOMEM;
+}
+
+
+int persist_sqlite__client_msg_row_add(struct mosquitto_sqlite *ms, const struct mosquitto_evt_persist_client_msg *ed)
+{
+	struct persist_sqlite_client_msg_row *row;
+
+	if(ms->client_msg_row_count == PERSIST_SQLITE_BATCH_ROWS){
+		client_msgs_flush(ms);
+	}
+
+	row = &ms->client_msg_rows[ms->client_msg_row_count];
+	row->clientid = strdup(ed->data.clientid);
+	if(row->clientid == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	row->cmsg_id = (int64_t)ed->data.cmsg_id;
+	row->store_id = (int64_t)ed->data.store_id;
+	row->subscription_identifier = ed->data.subscription_identifier;
+	row->mid = ed->data.mid;
+	row->dup = ed->data.dup;
+	row->direction = ed->data.direction;
+	row->qos = ed->data.qos;
+	row->retain = ed->data.retain;
+	row->state = ed->data.state;
+
+	ms->client_msg_row_count++;
+	if(ms->client_msg_row_count == PERSIST_SQLITE_BATCH_ROWS){
+		return client_msgs_flush(ms);
+	}
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+int persist_sqlite__batch_flush(struct mosquitto_sqlite *ms)
+{
+	int rc;
+
+	rc = base_msgs_flush(ms);
+	if(client_msgs_flush(ms)){
+		rc = MOSQ_ERR_UNKNOWN;
+	}
+	return rc;
+}
+
+
+void persist_sqlite__batch_cleanup(struct mosquitto_sqlite *ms)
+{
+	int i;
+
+	for(i=0; i<PERSIST_SQLITE_BATCH_ROWS; i++){
+		base_msg_row_free(&ms->base_msg_rows[i]);
+		client_msg_row_free(&ms->client_msg_rows[i]);
+	}
+	ms->base_msg_row_count = 0;
+	ms->client_msg_row_count = 0;
+}
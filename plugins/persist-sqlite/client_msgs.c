@@ -28,34 +28,10 @@ int persist_sqlite__client_msg_add_cb(int event, void *event_data, void *userdat
 {
 	struct mosquitto_evt_persist_client_msg *ed = event_data;
 	struct mosquitto_sqlite *ms = userdata;
-	int rc = MOSQ_ERR_UNKNOWN;
 
 	UNUSED(event);
 
-	if(sqlite3_bind_text(ms->client_msg_add_stmt, 1, ed->data.clientid, (int)strlen(ed->data.clientid), SQLITE_STATIC) == SQLITE_OK
-			&& sqlite3_bind_int64(ms->client_msg_add_stmt, 2, (int64_t)ed->data.cmsg_id) == SQLITE_OK
-			&& sqlite3_bind_int64(ms->client_msg_add_stmt, 3, (int64_t)ed->data.store_id) == SQLITE_OK
-			&& sqlite3_bind_int(ms->client_msg_add_stmt, 4, ed->data.dup) == SQLITE_OK
-			&& sqlite3_bind_int(ms->client_msg_add_stmt, 5, ed->data.direction) == SQLITE_OK
-			&& sqlite3_bind_int(ms->client_msg_add_stmt, 6, ed->data.mid) == SQLITE_OK
-			&& sqlite3_bind_int(ms->client_msg_add_stmt, 7, ed->data.qos) == SQLITE_OK
-			&& sqlite3_bind_int(ms->client_msg_add_stmt, 8, ed->data.retain) == SQLITE_OK
-			&& sqlite3_bind_int(ms->client_msg_add_stmt, 9, ed->data.state) == SQLITE_OK
-			&& sqlite3_bind_int(ms->client_msg_add_stmt, 10, (int)ed->data.subscription_identifier) == SQLITE_OK
-
-			){
-
-		ms->event_count++;
-		rc = sqlite3_step(ms->client_msg_add_stmt);
-		if(rc == SQLITE_DONE){
-			rc = MOSQ_ERR_SUCCESS;
-		}else{
-			rc = MOSQ_ERR_UNKNOWN;
-		}
-	}
-	sqlite3_reset(ms->client_msg_add_stmt);
-
-	return rc;
+	return persist_sqlite__client_msg_row_add(ms, ed);
 }
 
 
@@ -65,6 +41,7 @@ int persist_sqlite__client_msg_remove_cb(int event, void *event_data, void *user
 	struct mosquitto_sqlite *ms = userdata;
 
 	UNUSED(event);
+	persist_sqlite__batch_flush(ms);
 	ms->event_count++;
 	return persist_sqlite__client_msg_remove(ms, ed->data.clientid, (int64_t)ed->data.store_id, ed->data.direction);
 }
@@ -78,6 +55,7 @@ int persist_sqlite__client_msg_update_cb(int event, void *event_data, void *user
 
 	UNUSED(event);
 
+	persist_sqlite__batch_flush(ms);
 	if(sqlite3_bind_int(ms->client_msg_update_stmt, 1, ed->data.state) == SQLITE_OK
 			&& sqlite3_bind_int(ms->client_msg_update_stmt, 2, ed->data.dup) == SQLITE_OK
 			&& sqlite3_bind_text(ms->client_msg_update_stmt, 3, ed->data.clientid, (int)strlen(ed->data.clientid), SQLITE_STATIC) == SQLITE_OK
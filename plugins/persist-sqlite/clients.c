@@ -80,6 +80,7 @@ int persist_sqlite__client_remove_cb(int event, void *event_data, void *userdata
 
 	UNUSED(event);
 
+	persist_sqlite__batch_flush(ms);
 	if(sqlite3_bind_text(ms->subscription_clear_stmt, 1,
 			ed->data.clientid, (int)strlen(ed->data.clientid), SQLITE_STATIC) == SQLITE_OK){
 
@@ -16,6 +16,7 @@ Contributors:
    Roger Light - initial implementation and documentation.
 */
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sqlite3.h>
@@ -274,6 +275,40 @@ close_db:
 }
 
 
+/* Build "INSERT INTO <prefix> VALUES (?,..),(?,..),..." with
+ * PERSIST_SQLITE_BATCH_ROWS rows of `columns` parameters each. */
+static int prepare_batch_statement(struct mosquitto_sqlite *ms, const char *prefix, int columns, sqlite3_stmt **stmt)
+{
+	char *sql, *ptr;
+	size_t len;
+	int rc;
+
+	len = strlen(prefix) + (size_t)PERSIST_SQLITE_BATCH_ROWS*((size_t)columns*2+3) + 1;
+	sql = malloc(len);
+	if(sql == NULL){
+		return SQLITE_NOMEM;
+	}
+	ptr = sql;
+	ptr += sprintf(ptr, "%s", prefix);
+	for(int i=0; i<PERSIST_SQLITE_BATCH_ROWS; i++){
+		*(ptr++) = i == 0 ? ' ' : ',';
+		*(ptr++) = '(';
+		for(int j=0; j<columns; j++){
+			if(j > 0){
+				*(ptr++) = ',';
+			}
+			*(ptr++) = '?';
+		}
+		*(ptr++) = ')';
+	}
+	*ptr = '\0';
+
+	rc = sqlite3_prepare_v3(ms->db, sql, -1, SQLITE_PREPARE_PERSISTENT, stmt, NULL);
+	free(sql);
+	return rc;
+}
+
+
 static int prepare_statements(struct mosquitto_sqlite *ms)
 {
 	int rc;
@@ -347,6 +382,15 @@ static int prepare_statements(struct mosquitto_sqlite *ms)
 		goto fail;
 	}
 
+	rc = prepare_batch_statement(ms,
+			"INSERT INTO client_msgs "
+			"(client_id,cmsg_id,store_id,dup,direction,mid,qos,retain,state,subscription_identifier) "
+			"VALUES",
+			10, &ms->client_msg_add_batch_stmt);
+	if(rc){
+		goto fail;
+	}
+
 	rc = sqlite3_prepare_v3(ms->db,
 			"DELETE FROM client_msgs WHERE client_id=? AND store_id=? AND direction=?",
 			-1, SQLITE_PREPARE_PERSISTENT,
@@ -392,6 +436,16 @@ static int prepare_statements(struct mosquitto_sqlite *ms)
 		goto fail;
 	}
 
+	rc = prepare_batch_statement(ms,
+			"INSERT INTO base_msgs "
+			"(store_id, expiry_time, topic, payload, source_id, source_username, "
+			"payloadlen, source_mid, source_port, qos, retain, properties) "
+			"VALUES",
+			12, &ms->base_msg_add_batch_stmt);
+	if(rc){
+		goto fail;
+	}
+
 	rc = sqlite3_prepare_v3(ms->db,
 			"DELETE FROM base_msgs WHERE store_id=?",
 			-1, SQLITE_PREPARE_PERSISTENT,
@@ -486,7 +540,8 @@ int persist_sqlite__init(struct mosquitto_sqlite *ms)
 	if(rc){
 		goto fail;
 	}
-	rc = sqlite3_exec(ms->db, "PRAGMA journal_mode=WAL;", NULL, NULL, NULL);
+	snprintf(buf, sizeof(buf), "PRAGMA journal_mode=%s;", ms->journal_mode);
+	rc = sqlite3_exec(ms->db, buf, NULL, NULL, NULL);
 	if(rc){
 		goto fail;
 	}
@@ -499,6 +554,21 @@ int persist_sqlite__init(struct mosquitto_sqlite *ms)
 	if(rc){
 		goto fail;
 	}
+	if(ms->mmap_size > 0){
+		snprintf(buf, sizeof(buf), "PRAGMA mmap_size=%" PRId64 ";", ms->mmap_size);
+		rc = sqlite3_exec(ms->db, buf, NULL, NULL, NULL);
+		if(rc){
+			goto fail;
+		}
+	}
+	if(ms->cache_size > 0){
+		/* Negative values are in KiB rather than pages */
+		snprintf(buf, sizeof(buf), "PRAGMA cache_size=-%u;", ms->cache_size);
+		rc = sqlite3_exec(ms->db, buf, NULL, NULL, NULL);
+		if(rc){
+			goto fail;
+		}
+	}
 
 	rc = create_tables(ms);
 	if(rc){
@@ -520,6 +590,11 @@ fail:
 
 void persist_sqlite__cleanup(struct mosquitto_sqlite *ms)
 {
+	if(ms->db){
+		persist_sqlite__batch_flush(ms);
+	}
+	persist_sqlite__batch_cleanup(ms);
+
 	if(ms->db){
 		int rc = sqlite3_exec(ms->db, "END;", NULL, NULL, NULL);
 		if(rc !=  SQLITE_OK){
@@ -534,11 +609,13 @@ void persist_sqlite__cleanup(struct mosquitto_sqlite *ms)
 	sqlite3_finalize(ms->subscription_remove_stmt);
 	sqlite3_finalize(ms->subscription_clear_stmt);
 	sqlite3_finalize(ms->client_msg_add_stmt);
+	sqlite3_finalize(ms->client_msg_add_batch_stmt);
 	sqlite3_finalize(ms->client_msg_remove_stmt);
 	sqlite3_finalize(ms->client_msg_update_stmt);
 	sqlite3_finalize(ms->client_msg_clear_stmt);
 	sqlite3_finalize(ms->client_msg_clear_all_stmt);
 	sqlite3_finalize(ms->base_msg_add_stmt);
+	sqlite3_finalize(ms->base_msg_add_batch_stmt);
 	sqlite3_finalize(ms->base_msg_remove_stmt);
 	sqlite3_finalize(ms->base_msg_remove_for_clientid_stmt);
 	sqlite3_finalize(ms->base_msg_load_stmt);
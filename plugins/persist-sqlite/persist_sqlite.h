@@ -23,10 +23,44 @@ Contributors:
 #include <time.h>
 #include <stdint.h>
 
+#include "mosquitto.h"
+
 #ifndef UNUSED
 #  define UNUSED(A) (void)(A)
 #endif
 
+/* Number of rows written by a single multi-row INSERT. */
+#define PERSIST_SQLITE_BATCH_ROWS 32
+
+struct persist_sqlite_base_msg_row {
+	int64_t store_id;
+	int64_t expiry_time;
+	char *topic;
+	void *payload;
+	char *source_id;
+	char *source_username;
+	void *properties;
+	int properties_len;
+	uint32_t payloadlen;
+	uint16_t source_mid;
+	uint16_t source_port;
+	uint8_t qos;
+	uint8_t retain;
+};
+
+struct persist_sqlite_client_msg_row {
+	char *clientid;
+	int64_t cmsg_id;
+	int64_t store_id;
+	uint32_t subscription_identifier;
+	uint16_t mid;
+	uint8_t dup;
+	uint8_t direction;
+	uint8_t qos;
+	uint8_t retain;
+	uint8_t state;
+};
+
 struct mosquitto_sqlite {
 	char *db_file;
 	sqlite3 *db;
@@ -37,11 +71,13 @@ struct mosquitto_sqlite {
 	sqlite3_stmt *subscription_remove_stmt;
 	sqlite3_stmt *subscription_clear_stmt;
 	sqlite3_stmt *client_msg_add_stmt;
+	sqlite3_stmt *client_msg_add_batch_stmt;
 	sqlite3_stmt *client_msg_remove_stmt;
 	sqlite3_stmt *client_msg_update_stmt;
 	sqlite3_stmt *client_msg_clear_stmt;
 	sqlite3_stmt *client_msg_clear_all_stmt;
 	sqlite3_stmt *base_msg_add_stmt;
+	sqlite3_stmt *base_msg_add_batch_stmt;
 	sqlite3_stmt *base_msg_remove_stmt;
 	sqlite3_stmt *base_msg_remove_for_clientid_stmt;
 	sqlite3_stmt *base_msg_load_stmt;
@@ -49,7 +85,14 @@ struct mosquitto_sqlite {
 	sqlite3_stmt *retain_msg_remove_stmt;
 	sqlite3_stmt *will_add_stmt;
 	sqlite3_stmt *will_remove_stmt;
+	struct persist_sqlite_base_msg_row base_msg_rows[PERSIST_SQLITE_BATCH_ROWS];
+	struct persist_sqlite_client_msg_row client_msg_rows[PERSIST_SQLITE_BATCH_ROWS];
+	int base_msg_row_count;
+	int client_msg_row_count;
+	const char *journal_mode;
+	int64_t mmap_size;
 	int synchronous;
+	unsigned int cache_size;
 	unsigned int event_count;
 	unsigned int flush_period;
 	unsigned int page_size;
@@ -60,6 +103,17 @@ void persist_sqlite__cleanup(struct mosquitto_sqlite *ms);
 
 int persist_sqlite__restore_cb(int event, void *event_data, void *userdata);
 
+struct mosquitto_evt_persist_base_msg;
+struct mosquitto_evt_persist_client_msg;
+
+int persist_sqlite__base_msg_row_add(struct mosquitto_sqlite *ms, const struct mosquitto_evt_persist_base_msg *ed);
+int persist_sqlite__client_msg_row_add(struct mosquitto_sqlite *ms, const struct mosquitto_evt_persist_client_msg *ed);
+int persist_sqlite__batch_flush(struct mosquitto_sqlite *ms);
+void persist_sqlite__batch_cleanup(struct mosquitto_sqlite *ms);
+
+int persist_sqlite__properties_to_blob(const mosquitto_property *properties, void **blob, int *blob_len);
+mosquitto_property *persist_sqlite__blob_to_properties(const void *blob, int blob_len);
+
 int persist_sqlite__client_msg_remove(struct mosquitto_sqlite *ms, const char *clientid, int64_t store_id, int direction);
 
 int persist_sqlite__client_add_cb(int event, void *event_data, void *userdata);
@@ -64,6 +64,8 @@ static void set_defaults(void)
 	plg_data.flush_period = 5;
 
 	plg_data.page_size = 4 * 1024;
+
+	plg_data.journal_mode = "WAL";
 }
 
 
@@ -138,6 +140,36 @@ int mosquitto_plugin_init(mosquitto_plugin_id_t *identifier, void **user_data, s
 			if(rc){
 				return rc;
 			}
+		}else if(!strcasecmp(options[i].key, "journal_mode")){
+			if(!strcasecmp(options[i].value, "wal")){
+				plg_data.journal_mode = "WAL";
+			}else if(!strcasecmp(options[i].value, "delete")){
+				plg_data.journal_mode = "DELETE";
+			}else if(!strcasecmp(options[i].value, "truncate")){
+				plg_data.journal_mode = "TRUNCATE";
+			}else if(!strcasecmp(options[i].value, "persist")){
+				plg_data.journal_mode = "PERSIST";
+			}else if(!strcasecmp(options[i].value, "memory")){
+				plg_data.journal_mode = "MEMORY";
+			}else if(!strcasecmp(options[i].value, "off")){
+				plg_data.journal_mode = "OFF";
+			}else{
+				mosquitto_log_printf(MOSQ_LOG_ERR, "Sqlite persistence: Invalid plugin_opt_journal_mode value '%s'.", options[i].value);
+				return MOSQ_ERR_INVAL;
+			}
+		}else if(!strcasecmp(options[i].key, "mmap_size")){
+			char *endptr = NULL;
+			long long v = strtoll(options[i].value, &endptr, 10);
+			if(v < 0 || endptr == options[i].value || (endptr && *endptr != '\0')){
+				mosquitto_log_printf(MOSQ_LOG_ERR, "Error: Invalid 'mmap_size' value '%s' in configuration.", options[i].value);
+				return MOSQ_ERR_INVAL;
+			}
+			plg_data.mmap_size = (int64_t)v;
+		}else if(!strcasecmp(options[i].key, "cache_size")){
+			rc = conf_parse_uint(options[i].value, "cache_size", &plg_data.cache_size, 0);
+			if(rc){
+				return rc;
+			}
 		}
 	}
 	if(plg_data.db_file == NULL){
@@ -0,0 +1,291 @@
+/*
+Copyright (c) 2026 Roger Light <roger@atchoo.org>
+
+All rights reserved. This program and the accompanying materials
+are made available under the terms of the Eclipse Public License 2.0
+and Eclipse Distribution License v1.0 which accompany this distribution.
+
+The Eclipse Public License is available at
+   https://www.eclipse.org/legal/epl-2.0/
+and the Eclipse Distribution License is available at
+  http://www.eclipse.org/org/documents/edl-v10.php.
+
+SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+
+Contributors:
+   Roger Light - initial implementation and documentation.
+*/
+
+/* Binary property encoding for the base_msgs table.
+ *
+ * Each property is written as:
+ *   identifier  1 byte
+ *   type        1 byte (MQTT_PROP_TYPE_*)
+ *   value       byte: 1 byte
+ *               int16: 2 bytes, big endian
+ *               int32/varint: 4 bytes, big endian
+ *               binary/string: 2 byte big endian length, then data
+ *               string pair: name as string, then value as string
+ *
+ * Older databases and migrated databases hold properties as a JSON string,
+ * which can be told apart by the column type.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mosquitto.h"
+#include "mosquitto/broker.h"
+#include "mosquitto/mqtt_protocol.h"
+#include "persist_sqlite.h"
+
+
+static unsigned char *write_uint16(unsigned char *ptr, uint16_t value)
+{
+	ptr[0] = (unsigned char)((value >> 8) & 0xFF);
+	ptr[1] = (unsigned char)(value & 0xFF);
+	return ptr+2;
+}
+
+
+static unsigned char *write_uint32(unsigned char *ptr, uint32_t value)
+{
+	ptr[0] = (unsigned char)((value >> 24) & 0xFF);
+	ptr[1] = (unsigned char)((value >> 16) & 0xFF);
+	ptr[2] = (unsigned char)((value >> 8) & 0xFF);
+	ptr[3] = (unsigned char)(value & 0xFF);
+	return ptr+4;
+}
+
+
+static unsigned char *write_bytes(unsigned char *ptr, const void *value, uint16_t len)
+{
+	ptr = write_uint16(ptr, len);
+	if(len){
+		memcpy(ptr, value, len);
+	}
+	return ptr+len;
+}
+
+
+static size_t property_blob_len(const mosquitto_property *prop)
+{
+	switch(mosquitto_property_type(prop)){
+		case MQTT_PROP_TYPE_BYTE:
+			return 2+1;
+		case MQTT_PROP_TYPE_INT16:
+			return 2+2;
+		case MQTT_PROP_TYPE_INT32:
+		case MQTT_PROP_TYPE_VARINT:
+			return 2+4;
+		case MQTT_PROP_TYPE_BINARY:
+			return 2+2+mosquitto_property_binary_value_length(prop);
+		case MQTT_PROP_TYPE_STRING:
+			return 2+2+mosquitto_property_string_value_length(prop);
+		case MQTT_PROP_TYPE_STRING_PAIR:
+			return 2+2+(size_t)mosquitto_property_string_name_length(prop)
+					+2+(size_t)mosquitto_property_string_value_length(prop);
+		default:
+			return 0;
+	}
+}
+
+
+int persist_sqlite__properties_to_blob(const mosquitto_property *properties, void **blob, int *blob_len)
+{
+	const mosquitto_property *prop;
+	unsigned char *buf, *ptr;
+	size_t len = 0;
+
+	*blob = NULL;
+	*blob_len = 0;
+
+	for(prop = properties; prop; prop = mosquitto_property_next(prop)){
+		len += property_blob_len(prop);
+	}
+	if(len == 0){
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	buf = malloc(len);
+	if(buf == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	ptr = buf;
+	for(prop = properties; prop; prop = mosquitto_property_next(prop)){
+		int type = mosquitto_property_type(prop);
+
+		if(property_blob_len(prop) == 0){
+			continue;
+		}
+		*(ptr++) = (unsigned char)mosquitto_property_identifier(prop);
+		*(ptr++) = (unsigned char)type;
+		switch(type){
+			case MQTT_PROP_TYPE_BYTE:
+				*(ptr++) = mosquitto_property_byte_value(prop);
+				break;
+			case MQTT_PROP_TYPE_INT16:
+				ptr = write_uint16(ptr, mosquitto_property_int16_value(prop));
+				break;
+			case MQTT_PROP_TYPE_INT32:
+				ptr = write_uint32(ptr, mosquitto_property_int32_value(prop));
+				break;
+			case MQTT_PROP_TYPE_VARINT:
+				ptr = write_uint32(ptr, mosquitto_property_varint_value(prop));
+				break;
+			case MQTT_PROP_TYPE_BINARY:
+				ptr = write_bytes(ptr, mosquitto_property_binary_value(prop),
+						mosquitto_property_binary_value_length(prop));
+				break;
+			case MQTT_PROP_TYPE_STRING:
+				ptr = write_bytes(ptr, mosquitto_property_string_value(prop),
+						mosquitto_property_string_value_length(prop));
+				break;
+			case MQTT_PROP_TYPE_STRING_PAIR:
+				ptr = write_bytes(ptr, mosquitto_property_string_name(prop),
+						mosquitto_property_string_name_length(prop));
+				ptr = write_bytes(ptr, mosquitto_property_string_value(prop),
+						mosquitto_property_string_value_length(prop));
+				break;
+		}
+	}
+
+	*blob = buf;
+	*blob_len = (int)len;
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+static int read_bytes(const unsigned char **ptr, const unsigned char *end, const unsigned char **value, uint16_t *len)
+{
+	if(end - *ptr < 2){
+		return MOSQ_ERR_MALFORMED_PACKET;
+	}
+	*len = (uint16_t)(((*ptr)[0]<<8) + (*ptr)[1]);
+	*ptr += 2;
+	if(end - *ptr < *len){
+		return MOSQ_ERR_MALFORMED_PACKET;
+	}
+	*value = *ptr;
+	*ptr += *len;
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+static char *bytes_to_string(const unsigned char *value, uint16_t len)
+{
+	char *str;
+
+	str = malloc((size_t)len+1);
+	if(str){
+		memcpy(str, value, len);
+		str[len] = '\0';
+	}
+	return str;
+}
+
+
+mosquitto_property *persist_sqlite__blob_to_properties(const void *blob, int blob_len)
+{
+	mosquitto_property *properties = NULL;
+	const unsigned char *ptr = blob;
+	const unsigned char *end;
+	const unsigned char *value, *name;
+	uint16_t len, name_len;
+	char *str, *name_str;
+	int identifier, type;
+	int rc = MOSQ_ERR_SUCCESS;
+
+	if(blob == NULL || blob_len <= 0){
+		return NULL;
+	}
+	end = ptr + blob_len;
+
+	while(ptr < end && rc == MOSQ_ERR_SUCCESS){
+		if(end - ptr < 2){
+			rc = MOSQ_ERR_MALFORMED_PACKET;
+			break;
+		}
+		identifier = ptr[0];
+		type = ptr[1];
+		ptr += 2;
+
+		switch(type){
+			case MQTT_PROP_TYPE_BYTE:
+				if(end - ptr < 1){
+					rc = MOSQ_ERR_MALFORMED_PACKET;
+					break;
+				}
+				rc = mosquitto_property_add_byte(&properties, identifier, ptr[0]);
+				ptr += 1;
+				break;
+			case MQTT_PROP_TYPE_INT16:
+				if(end - ptr < 2){
+					rc = MOSQ_ERR_MALFORMED_PACKET;
+					break;
+				}
+				rc = mosquitto_property_add_int16(&properties, identifier, (uint16_t)((ptr[0]<<8) + ptr[1]));
+				ptr += 2;
+				break;
+			case MQTT_PROP_TYPE_INT32:
+			case MQTT_PROP_TYPE_VARINT:
+				if(end - ptr < 4){
+					rc = MOSQ_ERR_MALFORMED_PACKET;
+					break;
+				}
+				if(type == MQTT_PROP_TYPE_INT32){
+					rc = mosquitto_property_add_int32(&properties, identifier,
+							((uint32_t)ptr[0]<<24) + ((uint32_t)ptr[1]<<16) + ((uint32_t)ptr[2]<<8) + ptr[3]);
+				}else{
+					rc = mosquitto_property_add_varint(&properties, identifier,
+							((uint32_t)ptr[0]<<24) + ((uint32_t)ptr[1]<<16) + ((uint32_t)ptr[2]<<8) + ptr[3]);
+				}
+				ptr += 4;
+				break;
+			case MQTT_PROP_TYPE_BINARY:
+				rc = read_bytes(&ptr, end, &value, &len);
+				if(rc == MOSQ_ERR_SUCCESS){
+					rc = mosquitto_property_add_binary(&properties, identifier, value, len);
+				}
+				break;
+			case MQTT_PROP_TYPE_STRING:
+				rc = read_bytes(&ptr, end, &value, &len);
+				if(rc == MOSQ_ERR_SUCCESS){
+					str = bytes_to_string(value, len);
+					if(str){
+						rc = mosquitto_property_add_string(&properties, identifier, str);
+						free(str);
+					}else{
+						rc = MOSQ_ERR_NOMEM;
+					}
+				}
+				break;
+			case MQTT_PROP_TYPE_STRING_PAIR:
+				rc = read_bytes(&ptr, end, &name, &name_len);
+				if(rc == MOSQ_ERR_SUCCESS){
+					rc = read_bytes(&ptr, end, &value, &len);
+				}
+				if(rc == MOSQ_ERR_SUCCESS){
+					name_str = bytes_to_string(name, name_len);
+					str = bytes_to_string(value, len);
+					if(name_str && str){
+						rc = mosquitto_property_add_string_pair(&properties, identifier, name_str, str);
+					}else{
+						rc = MOSQ_ERR_NOMEM;
+					}
+					free(name_str);
+					free(str);
+				}
+				break;
+			default:
+				rc = MOSQ_ERR_MALFORMED_PACKET;
+				break;
+		}
+	}
+	if(rc){
+		mosquitto_log_printf(MOSQ_LOG_WARNING, "Sqlite persistence: Ignoring invalid properties whilst restoring");
+		mosquitto_property_free_all(&properties);
+	}
+
+	return properties;
+}
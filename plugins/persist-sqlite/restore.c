@@ -209,7 +209,7 @@ static int client_restore(struct mosquitto_sqlite *ms)
 			"SELECT client_id,username,will_delay_time,session_expiry_time,"
 			"listener_port,max_packet_size,max_qos,"
 			"retain_available,session_expiry_interval,will_delay_interval "
-			"FROM clients",
+			"FROM clients ORDER BY rowid",
 			-1, &stmt, NULL);
 
 	if(rc != SQLITE_OK){
@@ -260,7 +260,7 @@ static int subscription_restore(struct mosquitto_sqlite *ms)
 
 	rc = sqlite3_prepare_v2(ms->db,
 			"SELECT client_id,topic,subscription_options,subscription_identifier "
-			"FROM subscriptions",
+			"FROM subscriptions ORDER BY rowid",
 			-1, &stmt, NULL);
 
 	if(rc != SQLITE_OK){
@@ -301,7 +301,7 @@ static int base_msg_restore(struct mosquitto_sqlite *ms)
 
 	rc = sqlite3_prepare_v2(ms->db,
 			"SELECT store_id, expiry_time, topic, payload, source_id, source_username, payloadlen, source_mid, source_port, qos, retain, properties "
-			"FROM base_msgs",
+			"FROM base_msgs ORDER BY rowid",
 			-1, &stmt, NULL);
 
 	if(rc != SQLITE_OK){
@@ -340,7 +340,12 @@ static int base_msg_restore(struct mosquitto_sqlite *ms)
 		base_msg.source_port = (uint16_t)sqlite3_column_int(stmt, 8);
 		base_msg.qos = (uint8_t)sqlite3_column_int(stmt, 9);
 		base_msg.retain = sqlite3_column_int(stmt, 10);
-		base_msg.properties = json_to_properties((const char *)sqlite3_column_text(stmt, 11));
+		if(sqlite3_column_type(stmt, 11) == SQLITE_BLOB){
+			base_msg.properties = persist_sqlite__blob_to_properties(sqlite3_column_blob(stmt, 11), sqlite3_column_bytes(stmt, 11));
+		}else{
+			/* Databases written by older versions, or by the migration script */
+			base_msg.properties = json_to_properties((const char *)sqlite3_column_text(stmt, 11));
+		}
 
 		rc = mosquitto_persist_base_msg_add(&base_msg);
 		if(rc == MOSQ_ERR_SUCCESS){
@@ -475,7 +480,8 @@ static int will_restore(struct mosquitto_sqlite *ms)
 			"SELECT w.client_id,w.topic,w.payload,w.payloadlen,w.qos,w.retain,w.properties,"
 			" c.session_expiry_time,c.will_delay_interval"
 			" FROM wills w"
-			" LEFT OUTER JOIN clients c ON c.client_id = w.client_id",
+			" LEFT OUTER JOIN clients c ON c.client_id = w.client_id"
+			" ORDER BY w.rowid",
 			-1, &stmt, NULL);
 
 	if(rc != SQLITE_OK){
@@ -33,6 +33,7 @@ int persist_sqlite__tick_cb(int event, void *event_data, void *userdata)
 
 	UNUSED(event);
 
+	persist_sqlite__batch_flush(ms);
 	if(ms->event_count > 0){
 		ms->event_count = 0;
 		sqlite3_exec(ms->db, "END;", NULL, NULL, NULL);
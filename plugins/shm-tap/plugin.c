@@ -0,0 +1,157 @@
+/*
+Copyright (c) 2026 Roger Light <roger@atchoo.org>
+
+All rights reserved. This program and the accompanying materials
+are made available under the terms of the Eclipse Public License 2.0
+and Eclipse Distribution License v1.0 which accompany this distribution.
+
+The Eclipse Public License is available at
+   https://www.eclipse.org/legal/epl-2.0/
+and the Eclipse Distribution License is available at
+  http://www.eclipse.org/org/documents/edl-v10.php.
+
+SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+
+Contributors:
+   Roger Light - initial implementation and documentation.
+*/
+
+/*
+ * Copy every incoming message that matches a topic filter into a ring in
+ * shared memory, so that processes on the same host can read the message
+ * stream without connecting to the broker, and without MQTT framing.
+ *
+ * Messages are taken from MOSQ_EVT_MESSAGE_IN_BATCH, so only PUBLISH packets
+ * received from clients and incoming bridges are copied. Messages that the
+ * broker creates itself are not, including those published by plugins with
+ * mosquitto_broker_publish(), will messages, bridge notifications and $SYS
+ * updates.
+ *
+ * Options:
+ *
+ *   plugin_opt_path <file>      Required. The file to create, which should be
+ *                               on a tmpfs such as /dev/shm. Anything already
+ *                               at the path is replaced. It is removed when
+ *                               the broker exits.
+ *   plugin_opt_slots <n>        Number of message descriptors in the ring, a
+ *                               power of two. Defaults to 65536.
+ *   plugin_opt_data_size <n>    Size in bytes of the topic and payload area, a
+ *                               power of two. Defaults to 64MiB. Messages
+ *                               larger than half of this are not copied.
+ *   plugin_opt_topic <filter>   Only messages matching this filter are copied.
+ *                               Defaults to #.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "mosquitto.h"
+#include "mosquitto/broker.h"
+#include "mosquitto/broker_plugin.h"
+#include "plugin_global.h"
+
+MOSQUITTO_PLUGIN_DECLARE_VERSION(5);
+
+static mosquitto_plugin_id_t *mosq_pid = NULL;
+static struct shm_tap__ring ring;
+
+
+static int callback_message_in_batch(int event, void *event_data, void *userdata)
+{
+	struct mosquitto_evt_message_batch *ed = event_data;
+
+	UNUSED(event);
+	UNUSED(userdata);
+
+	for(int i=0; i<ed->message_count; i++){
+		ring__write(&ring, ed->messages[i]);
+	}
+	ring__wake(&ring);
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+static int parse_power_of_two(const char *key, const char *value, uint64_t max, uint64_t *result)
+{
+	char *endptr;
+	unsigned long long v;
+
+	errno = 0;
+	v = strtoull(value, &endptr, 10);
+	if(errno || endptr == value || *endptr != '\0' || v < 2 || v > max || (v & (v-1))){
+		mosquitto_log_printf(MOSQ_LOG_ERR, PLUGIN_NAME ": Invalid %s '%s', must be a power of two.", key, value);
+		return MOSQ_ERR_INVAL;
+	}
+	*result = v;
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+int mosquitto_plugin_init(mosquitto_plugin_id_t *identifier, void **user_data, struct mosquitto_opt *options, int option_count)
+{
+	const char *path = NULL;
+	const char *topic = "#";
+	uint64_t slot_count = SHM_TAP_DEFAULT_SLOTS;
+	uint64_t data_size = SHM_TAP_DEFAULT_DATA_SIZE;
+	int rc;
+
+	UNUSED(user_data);
+
+	for(int i=0; i<option_count; i++){
+		if(!strcasecmp(options[i].key, "path")){
+			path = options[i].value;
+		}else if(!strcasecmp(options[i].key, "slots")){
+			if(parse_power_of_two("slots", options[i].value, UINT32_MAX/2+1, &slot_count)){
+				return MOSQ_ERR_INVAL;
+			}
+		}else if(!strcasecmp(options[i].key, "data_size")){
+			if(parse_power_of_two("data_size", options[i].value, (uint64_t)SIZE_MAX/4, &data_size)){
+				return MOSQ_ERR_INVAL;
+			}
+		}else if(!strcasecmp(options[i].key, "topic")){
+			topic = options[i].value;
+		}
+	}
+	if(path == NULL){
+		mosquitto_log_printf(MOSQ_LOG_ERR, PLUGIN_NAME ": plugin_opt_path must be set.");
+		return MOSQ_ERR_INVAL;
+	}
+	if(mosquitto_sub_topic_check(topic) != MOSQ_ERR_SUCCESS){
+		mosquitto_log_printf(MOSQ_LOG_ERR, PLUGIN_NAME ": Invalid topic '%s'.", topic);
+		return MOSQ_ERR_INVAL;
+	}
+
+	mosq_pid = identifier;
+	mosquitto_plugin_set_info(identifier, PLUGIN_NAME, PLUGIN_VERSION);
+
+	rc = ring__open(&ring, path, (uint32_t)slot_count, data_size);
+	if(rc){
+		return rc;
+	}
+
+	rc = mosquitto_callback_register(mosq_pid, MOSQ_EVT_MESSAGE_IN_BATCH, callback_message_in_batch, topic, NULL);
+	if(rc){
+		ring__close(&ring);
+		return rc;
+	}
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+int mosquitto_plugin_cleanup(void *user_data, struct mosquitto_opt *options, int option_count)
+{
+	UNUSED(user_data);
+	UNUSED(options);
+	UNUSED(option_count);
+
+	mosquitto_callback_unregister(mosq_pid, MOSQ_EVT_MESSAGE_IN_BATCH, callback_message_in_batch, NULL);
+	ring__close(&ring);
+
+	return MOSQ_ERR_SUCCESS;
+}
@@ -0,0 +1,53 @@
+/*
+Copyright (c) 2026 Roger Light <roger@atchoo.org>
+
+All rights reserved. This program and the accompanying materials
+are made available under the terms of the Eclipse Public License 2.0
+and Eclipse Distribution License v1.0 which accompany this distribution.
+
+The Eclipse Public License is available at
+   https://www.eclipse.org/legal/epl-2.0/
+and the Eclipse Distribution License is available at
+  http://www.eclipse.org/org/documents/edl-v10.php.
+
+SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+
+Contributors:
+   Roger Light - initial implementation and documentation.
+*/
+
+#ifndef PLUGIN_GLOBAL_H
+#define PLUGIN_GLOBAL_H
+
+#include "config.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mosquitto/broker.h"
+#include "shm_tap.h"
+
+/* PLUGIN_NAME and PLUGIN_VERSION reported to the broker */
+#define PLUGIN_NAME "shm-tap"
+#define PLUGIN_VERSION "1.0"
+
+#define SHM_TAP_DEFAULT_SLOTS 65536
+#define SHM_TAP_DEFAULT_DATA_SIZE (64*1024*1024)
+
+struct shm_tap__ring {
+	char *path;
+	void *map;
+	size_t map_size;
+	struct shm_tap_header *header;
+	struct shm_tap_slot *slots;
+	uint8_t *data;
+	uint64_t data_size;
+	uint32_t slot_count;
+};
+
+int ring__open(struct shm_tap__ring *ring, const char *path, uint32_t slot_count, uint64_t data_size);
+void ring__close(struct shm_tap__ring *ring);
+void ring__write(struct shm_tap__ring *ring, const struct mosquitto_base_msg *msg);
+void ring__wake(struct shm_tap__ring *ring);
+
+#endif
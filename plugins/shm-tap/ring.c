@@ -0,0 +1,187 @@
+/*
+Copyright (c) 2026 Roger Light <roger@atchoo.org>
+
+All rights reserved. This program and the accompanying materials
+are made available under the terms of the Eclipse Public License 2.0
+and Eclipse Distribution License v1.0 which accompany this distribution.
+
+The Eclipse Public License is available at
+   https://www.eclipse.org/legal/epl-2.0/
+and the Eclipse Distribution License is available at
+  http://www.eclipse.org/org/documents/edl-v10.php.
+
+SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+
+Contributors:
+   Roger Light - initial implementation and documentation.
+*/
+
+/* Writer side of the shared memory ring. See shm_tap.h for the layout and the
+ * reader protocol. */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#  include <linux/futex.h>
+#  include <sys/syscall.h>
+#endif
+
+#include "mosquitto.h"
+#include "mosquitto/broker.h"
+#include "plugin_global.h"
+
+#define SHM_TAP_ALIGN(A, B) (((A) + (B) - 1) & ~((uint64_t)(B) - 1))
+
+/* Readers rely on the layout not changing */
+_Static_assert(sizeof(struct shm_tap_header) == 128, "shm_tap_header size");
+_Static_assert(sizeof(struct shm_tap_slot) == 40, "shm_tap_slot size");
+
+
+int ring__open(struct shm_tap__ring *ring, const char *path, uint32_t slot_count, uint64_t data_size)
+{
+	uint64_t data_offset;
+	int fd;
+
+	memset(ring, 0, sizeof(struct shm_tap__ring));
+
+	data_offset = SHM_TAP_ALIGN(sizeof(struct shm_tap_header) + (uint64_t)slot_count*sizeof(struct shm_tap_slot), 4096);
+	ring->map_size = (size_t)(data_offset + data_size);
+	ring->slot_count = slot_count;
+	ring->data_size = data_size;
+
+	ring->path = mosquitto_strdup(path);
+	if(ring->path == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+
+	/* The file is normally in a shared directory such as /dev/shm, so always
+	 * create a new one rather than opening whatever is at the path, which
+	 * could be a symlink to another file. */
+	if(unlink(path) < 0 && errno != ENOENT){
+		mosquitto_log_printf(MOSQ_LOG_ERR, PLUGIN_NAME ": Unable to remove old '%s': %s.", path, strerror(errno));
+		mosquitto_FREE(ring->path);
+		return MOSQ_ERR_UNKNOWN;
+	}
+	fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0640);
+	if(fd < 0){
+		mosquitto_log_printf(MOSQ_LOG_ERR, PLUGIN_NAME ": Unable to create '%s': %s.", path, strerror(errno));
+		mosquitto_FREE(ring->path);
+		return MOSQ_ERR_UNKNOWN;
+	}
+	if(ftruncate(fd, (off_t)ring->map_size) < 0){
+		mosquitto_log_printf(MOSQ_LOG_ERR, PLUGIN_NAME ": Unable to size '%s': %s.", path, strerror(errno));
+		close(fd);
+		goto error;
+	}
+	ring->map = mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(ring->map == MAP_FAILED){
+		ring->map = NULL;
+		mosquitto_log_printf(MOSQ_LOG_ERR, PLUGIN_NAME ": Unable to map '%s': %s.", path, strerror(errno));
+		goto error;
+	}
+
+	ring->header = ring->map;
+	ring->slots = (struct shm_tap_slot *)((uint8_t *)ring->map + sizeof(struct shm_tap_header));
+	ring->data = (uint8_t *)ring->map + data_offset;
+
+	/* The file is newly created, so everything else is already zero.
+	 * Readers do not look at a slot until write_seq shows it has been
+	 * written. */
+	ring->header->header_size = sizeof(struct shm_tap_header);
+	ring->header->slot_count = slot_count;
+	ring->header->data_offset = data_offset;
+	ring->header->data_size = data_size;
+	ring->header->version = SHM_TAP_VERSION;
+	__atomic_store_n(&ring->header->magic, SHM_TAP_MAGIC, __ATOMIC_RELEASE);
+
+	return MOSQ_ERR_SUCCESS;
+error:
+	unlink(path);
+	mosquitto_FREE(ring->path);
+	return MOSQ_ERR_UNKNOWN;
+}
+
+
+void ring__close(struct shm_tap__ring *ring)
+{
+	if(ring->map){
+		munmap(ring->map, ring->map_size);
+		ring->map = NULL;
+	}
+	if(ring->path){
+		unlink(ring->path);
+		mosquitto_FREE(ring->path);
+	}
+}
+
+
+void ring__write(struct shm_tap__ring *ring, const struct mosquitto_base_msg *msg)
+{
+	struct shm_tap_header *header = ring->header;
+	struct shm_tap_slot *slot;
+	uint64_t seq, pos, offset, len;
+	size_t topic_len;
+
+	topic_len = strlen(msg->topic);
+	len = SHM_TAP_ALIGN(topic_len + msg->payloadlen, 8);
+	if(len > ring->data_size/2){
+		__atomic_store_n(&header->dropped, header->dropped+1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	/* This is the only writer, so plain reads of our own fields are fine */
+	seq = header->write_seq;
+	pos = header->data_head;
+	offset = pos & (ring->data_size-1);
+	if(offset + len > ring->data_size){
+		/* Never split a message across the end of the data area */
+		pos += ring->data_size - offset;
+		offset = 0;
+	}
+
+	/* Claim the data before overwriting it, so readers of older messages in
+	 * the same space see that they have been overwritten. */
+	__atomic_store_n(&header->data_head, pos + len, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	/* Likewise invalidate the slot before changing its fields */
+	slot = &ring->slots[seq & (ring->slot_count-1)];
+	__atomic_store_n(&slot->seq, UINT64_MAX, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	memcpy(&ring->data[offset], msg->topic, topic_len);
+	if(msg->payloadlen){
+		memcpy(&ring->data[offset+topic_len], msg->payload, msg->payloadlen);
+	}
+
+	slot->data_pos = pos;
+	slot->store_id = msg->store_id;
+	slot->topic_len = (uint32_t)topic_len;
+	slot->payload_len = msg->payloadlen;
+	slot->qos = msg->qos;
+	slot->retain = msg->retain;
+
+	__atomic_store_n(&slot->seq, seq, __ATOMIC_RELEASE);
+	__atomic_store_n(&header->write_seq, seq+1, __ATOMIC_RELEASE);
+}
+
+
+/* Called once per batch of messages, rather than per message, so readers
+ * that are waiting are woken with at most one system call per batch. */
+void ring__wake(struct shm_tap__ring *ring)
+{
+	__atomic_add_fetch(&ring->header->wake, 1, __ATOMIC_SEQ_CST);
+#ifdef __linux__
+	if(__atomic_load_n(&ring->header->waiters, __ATOMIC_SEQ_CST) > 0){
+		syscall(SYS_futex, &ring->header->wake, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+	}
+#endif
+}
@@ -0,0 +1,87 @@
+/*
+Copyright (c) 2026 Roger Light <roger@atchoo.org>
+
+All rights reserved. This program and the accompanying materials
+are made available under the terms of the Eclipse Public License 2.0
+and Eclipse Distribution License v1.0 which accompany this distribution.
+
+The Eclipse Public License is available at
+   https://www.eclipse.org/legal/epl-2.0/
+and the Eclipse Distribution License is available at
+  http://www.eclipse.org/org/documents/edl-v10.php.
+
+SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+
+Contributors:
+   Roger Light - initial implementation and documentation.
+*/
+
+#ifndef SHM_TAP_H
+#define SHM_TAP_H
+
+/* Layout of the shared memory ring written by the shm-tap plugin.
+ *
+ * This header is self contained so that it can be used by readers as well as
+ * the plugin. The file is made of three parts:
+ *
+ *   struct shm_tap_header
+ *   struct shm_tap_slot slots[slot_count], starting at header_size
+ *   data area of data_size bytes, starting at data_offset
+ *
+ * Each message has a sequence number, starting at 0. The descriptor for
+ * message seq is in slots[seq & (slot_count-1)]. Its topic and then its
+ * payload are in the data area at position data_pos, where a position is
+ * turned into an offset in the data area with pos & (data_size-1). A topic and
+ * payload never wrap around the end of the data area.
+ *
+ * There is a single writer, and readers are never waited for, so a slow reader
+ * can have messages overwritten before it gets to them. To read message seq:
+ *
+ * 1. Wait until seq < write_seq.
+ * 2. Check slot->seq == seq, otherwise the slot has been reused and the
+ *    message is lost.
+ * 3. Copy the slot fields, then the topic and payload.
+ * 4. Check slot->seq is still seq and data_head - data_pos <= data_size,
+ *    otherwise the message was overwritten while it was being read.
+ *
+ * write_seq, data_head and slot->seq must be read with acquire ordering.
+ *
+ * On Linux, a reader that has caught up can wait on the wake futex, rather
+ * than polling write_seq: increment waiters, check write_seq again, call
+ * FUTEX_WAIT on wake with the value it had before checking, then decrement
+ * waiters. This is not a private futex, because the writer is in another
+ * process.
+ */
+
+#include <stdint.h>
+
+#define SHM_TAP_MAGIC 0x5041544DU /* "MTAP" */
+#define SHM_TAP_VERSION 1
+
+struct shm_tap_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t slot_count;  /* Power of two */
+	uint64_t data_offset;
+	uint64_t data_size;   /* Power of two */
+	uint64_t write_seq;   /* Sequence number of the next message to be written */
+	uint64_t data_head;   /* Position after the last byte reserved in the data area */
+	uint64_t dropped;     /* Messages too large for the data area */
+	uint32_t wake;        /* Futex word, incremented after each batch of messages */
+	uint32_t waiters;     /* Number of readers waiting on wake */
+	uint8_t padding[64];
+};
+
+struct shm_tap_slot {
+	uint64_t seq;         /* Written last */
+	uint64_t data_pos;
+	uint64_t store_id;
+	uint32_t topic_len;   /* Not including a terminating 0, which is not stored */
+	uint32_t payload_len;
+	uint8_t qos;
+	uint8_t retain;
+	uint8_t padding[6];
+};
+
+#endif
@@ -46,6 +46,7 @@ int broker_acl_file__init(void)
 					config__plugin_add_secopt(db.config->listeners[i].security_options->pid, db.config->listeners[i].security_options);
 				}
 
+				mosquitto_plugin_set_acl_cacheable(db.config->listeners[i].security_options->pid, true);
 				mosquitto_callback_register(db.config->listeners[i].security_options->pid,
 						MOSQ_EVT_ACL_CHECK, acl_file__check, NULL, &db.config->listeners[i].security_options->acl_data);
 			}
@@ -61,6 +62,7 @@ int broker_acl_file__init(void)
 				config__plugin_add_secopt(db.config->security_options.pid, &db.config->security_options);
 			}
 
+			mosquitto_plugin_set_acl_cacheable(db.config->security_options.pid, true);
 			mosquitto_callback_register(db.config->security_options.pid,
 					MOSQ_EVT_ACL_CHECK, acl_file__check, NULL, &db.config->security_options.acl_data);
 		}
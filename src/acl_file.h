@@ -18,21 +18,31 @@ Contributors:
 #ifndef ACL_FILE_H
 #define ACL_FILE_H
 
+#include <stdbool.h>
 #include <uthash.h>
 
-struct acl__entry {
-	struct acl__entry *next, *prev;
-	char *topic;
-	int access;
-	int ucount;
-	int ccount;
+/* ACLs are stored as a tree of topic levels. The result of an ACL check does
+ * not depend on the order of the ACLs, because "deny" ACLs are always
+ * considered first, so each level only needs to record the access granted or
+ * denied by the ACLs that end there. */
+struct acl__node {
+	UT_hash_handle hh;
+	struct acl__node *children;
+	struct acl__node *plus;
+	struct acl__node *clientid; /* %c, pattern ACLs only */
+	struct acl__node *username; /* %u, pattern ACLs only */
+	int access; /* Access granted by ACLs ending at this level */
+	int access_hash; /* Access granted by ACLs ending with a # after this level */
+	bool deny;
+	bool deny_hash;
+	char level[];
 };
 
 
 struct acl__user {
 	UT_hash_handle hh;
 	char *username;
-	struct acl__entry *acl;
+	struct acl__node *acl;
 };
 
 
@@ -40,7 +50,9 @@ struct acl_file_data {
 	char *acl_file;
 	struct acl__user *acl_users;
 	struct acl__user acl_anon;
-	struct acl__entry *acl_patterns;
+	struct acl__node *acl_patterns;
+	struct acl__node *acl_patterns_username; /* Patterns that contain %u */
+	bool acl_subscribe; /* Check subscriptions, only if there are "subscribe" ACLs */
 };
 
 
@@ -0,0 +1,230 @@
+/*
+Copyright (c) 2026 Roger Light <roger@atchoo.org>
+
+All rights reserved. This program and the accompanying materials
+are made available under the terms of the Eclipse Public License 2.0
+and Eclipse Distribution License v1.0 which accompany this distribution.
+
+The Eclipse Public License is available at
+   https://www.eclipse.org/legal/epl-2.0/
+and the Eclipse Distribution License is available at
+  http://www.eclipse.org/org/documents/edl-v10.php.
+
+SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+
+Contributors:
+   Roger Light - initial implementation and documentation.
+*/
+
+/* Password verifier threads
+ *
+ * Checking a password against a PBKDF2 or argon2id hash takes milliseconds of
+ * CPU time, which is a long time to hold up the main loop when many clients
+ * connect at once. mosquitto_basic_auth_pw_verify() lets the authentication
+ * plugins hand the check to a small pool of threads instead, and the client
+ * is left in the delayed auth state until the result is collected by the
+ * main loop.
+ *
+ * The worker threads only ever call mosquitto_pw_verify() on a copy of the
+ * hash and password that belongs to the job, and wake the main loop when it
+ * is done. Everything else, including all memory allocation, happens on the
+ * main thread.
+ *
+ * If password_cache_size is set, successful checks are also remembered in the
+ * libcommon verified credential cache so that clients that reconnect often
+ * skip the hash altogether.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "mosquitto_broker_internal.h"
+
+struct auth_verify_job {
+	struct mosquitto__worker_job worker;
+	struct mosquitto *context;
+	struct mosquitto_pw *pw;
+	char *password;
+	int result;
+};
+
+static struct mosquitto__worker_pool *pool = NULL;
+
+/* Main thread only */
+static int in_flight = 0;
+
+
+static void job__free(struct auth_verify_job *job)
+{
+	if(job->context){
+		job->context->auth_verify_job = NULL;
+	}
+	mosquitto_pw_cleanup(job->pw);
+	if(job->password){
+		memset(job->password, 0, strlen(job->password));
+	}
+	mosquitto_FREE(job->password);
+	mosquitto_FREE(job);
+}
+
+
+static void auth_verify__run(struct mosquitto__worker_job *worker)
+{
+	struct auth_verify_job *job = (struct auth_verify_job *)worker;
+
+	job->result = mosquitto_pw_verify(job->pw, job->password);
+}
+
+
+static void jobs__free(struct mosquitto__worker_job *worker)
+{
+	struct mosquitto__worker_job *next;
+
+	for(; worker; worker = next){
+		next = worker->next;
+		job__free((struct auth_verify_job *)worker);
+	}
+}
+
+
+static void auth_verify__cache_init(void)
+{
+	if(db.config->password_cache_size > 0){
+		if(mosquitto_pw_cache_init((unsigned int)db.config->password_cache_size, db.config->password_cache_ttl) != MOSQ_ERR_SUCCESS){
+			log__printf(NULL, MOSQ_LOG_WARNING, "Warning: Unable to enable the password cache.");
+		}
+	}else{
+		mosquitto_pw_cache_cleanup();
+	}
+}
+
+
+int auth_verify__init(void)
+{
+	auth_verify__cache_init();
+
+	pool = worker_pool__new("password verifier", db.config->password_verify_threads);
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+void auth_verify__cleanup(void)
+{
+	struct mosquitto__worker_job *pending, *done;
+
+	worker_pool__free(pool, &pending, &done);
+	pool = NULL;
+
+	/* Clients still waiting are about to be disconnected anyway */
+	jobs__free(pending);
+	jobs__free(done);
+	in_flight = 0;
+
+	mosquitto_pw_cache_cleanup();
+}
+
+
+/* The password data may have changed, so start again with an empty cache,
+ * using the new cache settings. */
+void auth_verify__reload(void)
+{
+	auth_verify__cache_init();
+}
+
+
+/* Called when a client leaves the delayed auth state for any other reason,
+ * so the result of its job is thrown away. */
+void auth_verify__cancel(struct mosquitto *context)
+{
+	if(context->auth_verify_job){
+		context->auth_verify_job->context = NULL;
+		context->auth_verify_job = NULL;
+	}
+}
+
+
+void auth_verify__check(void)
+{
+	struct mosquitto__worker_job *worker, *next;
+	struct auth_verify_job *job;
+	struct mosquitto *context;
+
+	if(in_flight == 0 || pool == NULL){
+		return;
+	}
+
+	for(worker = worker_pool__take_done(pool); worker; worker = next){
+		next = worker->next;
+		job = (struct auth_verify_job *)worker;
+		in_flight--;
+
+		context = job->context;
+		if(context){
+			if(job->result == MOSQ_ERR_SUCCESS){
+				mosquitto_pw_cache_add(context->username, job->pw, job->password);
+			}
+			context->auth_verify_job = NULL;
+			job->context = NULL;
+			mosquitto_complete_basic_auth(context->id, job->result == MOSQ_ERR_SUCCESS ? MOSQ_ERR_SUCCESS : MOSQ_ERR_AUTH);
+		}
+		job__free(job);
+	}
+}
+
+
+static int verify__inline(struct mosquitto *client, struct mosquitto_pw *pw, const char *password)
+{
+	int rc;
+
+	rc = mosquitto_pw_verify(pw, password);
+	if(rc == MOSQ_ERR_SUCCESS){
+		mosquitto_pw_cache_add(client->username, pw, password);
+	}
+	return rc;
+}
+
+
+BROKER_EXPORT int mosquitto_basic_auth_pw_verify(struct mosquitto *client, struct mosquitto_pw *pw, const char *password)
+{
+	struct auth_verify_job *job;
+	const char *encoded;
+
+	if(client == NULL || password == NULL){
+		return MOSQ_ERR_INVAL;
+	}
+
+	if(mosquitto_pw_cache_check(client->username, pw, password) == MOSQ_ERR_SUCCESS){
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	encoded = mosquitto_pw_get_encoded(pw);
+	if(pool == NULL || !db.auth_verify_allowed
+			|| !mosquitto_pw_is_valid(pw) || encoded == NULL
+			|| client->id == NULL || client->auth_verify_job){
+
+		return verify__inline(client, pw, password);
+	}
+
+	job = mosquitto_calloc(1, sizeof(struct auth_verify_job));
+	if(job == NULL){
+		return verify__inline(client, pw, password);
+	}
+	job->password = mosquitto_strdup(password);
+	if(job->password == NULL
+			|| mosquitto_pw_new(&job->pw, MOSQ_PW_DEFAULT) != MOSQ_ERR_SUCCESS
+			|| mosquitto_pw_decode(job->pw, encoded) != MOSQ_ERR_SUCCESS){
+
+		job__free(job);
+		return verify__inline(client, pw, password);
+	}
+
+	job->worker.run = auth_verify__run;
+	job->context = client;
+	client->auth_verify_job = job;
+	in_flight++;
+
+	worker_pool__submit(pool, &job->worker);
+
+	return MOSQ_ERR_AUTH_DELAYED;
+}
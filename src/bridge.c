@@ -80,6 +80,9 @@ static struct mosquitto *bridge__new(struct mosquitto__bridge *bridge)
 	if(new_context){
 		/* (possible from persistent db) */
 		mosquitto_FREE(local_id);
+#ifdef WITH_PERSISTENCE
+		persist__lazy_queue_load(new_context);
+#endif
 	}else{
 		/* id wasn't found, so generate a new context */
 		new_context = context__init();
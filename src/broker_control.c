@@ -208,6 +208,46 @@ internal_error:
 }
 
 
+static int broker__process_get_plugin_stats(struct mosquitto_control_cmd *cmd)
+{
+	cJSON *tree, *j_data, *j_plugins;
+	const char *admin_clientid, *admin_username;
+
+	tree = cJSON_CreateObject();
+	if(tree == NULL){
+		mosquitto_control_command_reply(cmd, "Internal error");
+		return MOSQ_ERR_NOMEM;
+	}
+
+	admin_clientid = mosquitto_client_id(cmd->client);
+	admin_username = mosquitto_client_username(cmd->client);
+	mosquitto_log_printf(MOSQ_LOG_INFO, "Broker: %s/%s | getPluginStats",
+			admin_clientid, admin_username);
+
+	if(cJSON_AddStringToObject(tree, "command", "getPluginStats") == NULL
+			|| ((j_data = cJSON_AddObjectToObject(tree, "data")) == NULL)
+			|| (cmd->correlation_data && cJSON_AddStringToObject(tree, "correlationData", cmd->correlation_data) == NULL)
+			){
+
+		goto internal_error;
+	}
+
+	j_plugins = cJSON_AddArrayToObject(j_data, "plugins");
+	if(j_plugins == NULL || plugin_stats__add_json(j_plugins)){
+		goto internal_error;
+	}
+
+	cJSON_AddItemToArray(cmd->j_responses, tree);
+
+	return MOSQ_ERR_SUCCESS;
+
+internal_error:
+	cJSON_Delete(tree);
+	mosquitto_control_command_reply(cmd, "Internal error");
+	return MOSQ_ERR_NOMEM;
+}
+
+
 static int broker_control_callback(int event, void *event_data, void *userdata)
 {
 	struct mosquitto_evt_control *ed = event_data;
@@ -258,6 +298,8 @@ static int broker__handle_control(struct mosquitto_control_cmd *cmd, void *userd
 		rc = broker__process_list_plugins(cmd);
 	}else if(!strcasecmp(cmd->command_name, "listListeners")){
 		rc = broker__process_list_listeners(cmd);
+	}else if(!strcasecmp(cmd->command_name, "getPluginStats")){
+		rc = broker__process_get_plugin_stats(cmd);
 
 		/* Unknown */
 	}else{
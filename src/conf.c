@@ -297,6 +297,8 @@ static void config__init_reload(struct mosquitto__config *config)
 
 	config->autosave_interval = 1800;
 	config->autosave_on_changes = false;
+	config->persistence_incremental_retain = false;
+	config->persistence_lazy_queues = false;
 
 	mosquitto_FREE(config->clientid_prefixes);
 
@@ -343,8 +345,13 @@ static void config__init_reload(struct mosquitto__config *config)
 	config->persistence = false;
 	mosquitto_FREE(config->persistence_location);
 	mosquitto_FREE(config->persistence_file);
+	config->password_cache_size = 0;
+	config->password_cache_ttl = 300;
+	config->password_verify_threads = 2;
+	config->plugin_worker_threads = 2;
 	config->persistent_client_expiration = 0;
 	config->queue_qos0_messages = false;
+	config->queue_spillover_bytes = 0;
 	config->retain_available = true;
 	config->retain_expiry_interval = 0;
 	config->set_tcp_nodelay = false;
@@ -401,6 +408,8 @@ void config__cleanup(struct mosquitto__config *config)
 	mosquitto_FREE(config->persistence_location);
 	mosquitto_FREE(config->persistence_file);
 	mosquitto_FREE(config->persistence_filepath);
+	mosquitto_FREE(config->queue_spillover_location);
+	topic_rewrite__cleanup(&config->topic_rewrites);
 	mosquitto_FREE(config->security_options.auto_id_prefix);
 	mosquitto_FREE(config->security_options.acl_data.acl_file);
 	mosquitto_FREE(config->security_options.password_data.password_file);
@@ -673,6 +682,8 @@ static void config__copy(struct mosquitto__config *src, struct mosquitto__config
 	acl_file__cleanup(&dest->security_options.acl_data);
 	dest->security_options.acl_data.acl_users = src->security_options.acl_data.acl_users;
 	dest->security_options.acl_data.acl_patterns = src->security_options.acl_data.acl_patterns;
+	dest->security_options.acl_data.acl_patterns_username = src->security_options.acl_data.acl_patterns_username;
+	dest->security_options.acl_data.acl_subscribe = src->security_options.acl_data.acl_subscribe;
 	dest->security_options.acl_data.acl_anon.username = src->security_options.acl_data.acl_anon.username;
 	dest->security_options.acl_data.acl_anon.acl = src->security_options.acl_data.acl_anon.acl;
 
@@ -719,6 +730,9 @@ static void config__copy(struct mosquitto__config *src, struct mosquitto__config
 
 	dest->message_size_limit = src->message_size_limit;
 
+	dest->password_cache_size = src->password_cache_size;
+	dest->password_cache_ttl = src->password_cache_ttl;
+
 	dest->persistence = src->persistence;
 
 	mosquitto_FREE(dest->persistence_location);
@@ -735,6 +749,10 @@ static void config__copy(struct mosquitto__config *src, struct mosquitto__config
 
 	dest->queue_qos0_messages = src->queue_qos0_messages;
 	dest->sys_interval = src->sys_interval;
+
+	topic_rewrite__cleanup(&dest->topic_rewrites);
+	dest->topic_rewrites = src->topic_rewrites;
+
 	dest->upgrade_outgoing_qos = src->upgrade_outgoing_qos;
 
 #if defined(WITH_WEBSOCKETS) && WITH_WEBSOCKETS == WS_IS_LWS
@@ -1701,6 +1719,11 @@ static int config__read_file_core(struct mosquitto__config *config, bool reload,
 					if(conf__parse_string(&token, "clientid_prefixes", &config->clientid_prefixes, &saveptr)){
 						return MOSQ_ERR_INVAL;
 					}
+				}else if(!strcmp(token, "conflate_queued_messages")){
+					REQUIRE_LISTENER_OR_DEFAULT_LISTENER(token);
+					if(conf__parse_bool(&token, "conflate_queued_messages", &cur_listener->conflate_queued_messages, &saveptr)){
+						return MOSQ_ERR_INVAL;
+					}
 				}else if(!strcmp(token, "connection")){
 #ifdef WITH_BRIDGE
 					token = strtok_r(NULL, " ", &saveptr);
@@ -2337,6 +2360,22 @@ static int config__read_file_core(struct mosquitto__config *config, bool reload,
 #else
 					log__printf(NULL, MOSQ_LOG_WARNING, "Warning: Bridge support not available.");
 #endif
+				}else if(!strcmp(token, "password_cache_size")){
+					if(conf__parse_int(&token, "password_cache_size", &config->password_cache_size, &saveptr)){
+						return MOSQ_ERR_INVAL;
+					}
+					if(config->password_cache_size < 0){
+						log__printf(NULL, MOSQ_LOG_ERR, "Error: Invalid 'password_cache_size' value (%d).", config->password_cache_size);
+						return MOSQ_ERR_INVAL;
+					}
+				}else if(!strcmp(token, "password_cache_ttl")){
+					if(conf__parse_int(&token, "password_cache_ttl", &config->password_cache_ttl, &saveptr)){
+						return MOSQ_ERR_INVAL;
+					}
+					if(config->password_cache_ttl < 1){
+						log__printf(NULL, MOSQ_LOG_ERR, "Error: Invalid 'password_cache_ttl' value (%d).", config->password_cache_ttl);
+						return MOSQ_ERR_INVAL;
+					}
 				}else if(!strcmp(token, "password_file")){
 					REQUIRE_LISTENER_IF_PER_LISTENER(token);
 					conf__set_cur_security_options(config, &cur_listener, &cur_security_options, token);
@@ -2344,6 +2383,17 @@ static int config__read_file_core(struct mosquitto__config *config, bool reload,
 					if(conf__parse_string(&token, "password_file", &cur_security_options->password_data.password_file, &saveptr)){
 						return MOSQ_ERR_INVAL;
 					}
+				}else if(!strcmp(token, "password_verify_threads")){
+					if(reload){
+						continue;        /* Threads are only started once. */
+					}
+					if(conf__parse_int(&token, "password_verify_threads", &config->password_verify_threads, &saveptr)){
+						return MOSQ_ERR_INVAL;
+					}
+					if(config->password_verify_threads < 0){
+						log__printf(NULL, MOSQ_LOG_ERR, "Error: Invalid 'password_verify_threads' value (%d).", config->password_verify_threads);
+						return MOSQ_ERR_INVAL;
+					}
 				}else if(!strcmp(token, "per_listener_settings")){
 					OPTION_DEPRECATED(token, "Please see the documentation for how to achieve the same effect.");
 					if(config->per_listener_settings){
@@ -2365,6 +2415,14 @@ static int config__read_file_core(struct mosquitto__config *config, bool reload,
 					if(conf__parse_string(&token, "persistence_file", &config->persistence_file, &saveptr)){
 						return MOSQ_ERR_INVAL;
 					}
+				}else if(!strcmp(token, "persistence_incremental_retain")){
+					if(conf__parse_bool(&token, "persistence_incremental_retain", &config->persistence_incremental_retain, &saveptr)){
+						return MOSQ_ERR_INVAL;
+					}
+				}else if(!strcmp(token, "persistence_lazy_queues")){
+					if(conf__parse_bool(&token, "persistence_lazy_queues", &config->persistence_lazy_queues, &saveptr)){
+						return MOSQ_ERR_INVAL;
+					}
 				}else if(!strcmp(token, "persistence_location")){
 					if(conf__parse_string(&token, "persistence_location", &config->persistence_location, &saveptr)){
 						return MOSQ_ERR_INVAL;
@@ -2411,6 +2469,17 @@ static int config__read_file_core(struct mosquitto__config *config, bool reload,
 					if(conf__parse_string(&token, "pid_file", &config->pid_file, &saveptr)){
 						return MOSQ_ERR_INVAL;
 					}
+				}else if(!strcmp(token, "plugin_worker_threads")){
+					if(reload){
+						continue;        /* Threads are only started once. */
+					}
+					if(conf__parse_int(&token, "plugin_worker_threads", &config->plugin_worker_threads, &saveptr)){
+						return MOSQ_ERR_INVAL;
+					}
+					if(config->plugin_worker_threads < 0){
+						log__printf(NULL, MOSQ_LOG_ERR, "Error: Invalid 'plugin_worker_threads' value (%d).", config->plugin_worker_threads);
+						return MOSQ_ERR_INVAL;
+					}
 				}else if(!strcmp(token, "port")){
 					OPTION_DEPRECATED(token, "Please use 'listener' instead.");
 					config->local_only = false;
@@ -2503,6 +2572,24 @@ static int config__read_file_core(struct mosquitto__config *config, bool reload,
 					if(conf__parse_bool(&token, token, &config->queue_qos0_messages, &saveptr)){
 						return MOSQ_ERR_INVAL;
 					}
+				}else if(!strcmp(token, "queue_spillover_bytes")){
+					if(reload){
+						continue;        /* Not valid for reloading. */
+					}
+					if(conf__parse_int(&token, "queue_spillover_bytes", &tmp_int, &saveptr)){
+						return MOSQ_ERR_INVAL;
+					}
+					if(tmp_int < 0){
+						tmp_int = 0;
+					}
+					config->queue_spillover_bytes = (size_t)tmp_int;
+				}else if(!strcmp(token, "queue_spillover_location")){
+					if(reload){
+						continue;        /* Not valid for reloading. */
+					}
+					if(conf__parse_string(&token, "queue_spillover_location", &config->queue_spillover_location, &saveptr)){
+						return MOSQ_ERR_INVAL;
+					}
 				}else if(!strcmp(token, "require_certificate")){
 #ifdef WITH_TLS
 					REQUIRE_LISTENER_OR_DEFAULT_LISTENER(token);
@@ -2831,6 +2918,22 @@ static int config__read_file_core(struct mosquitto__config *config, bool reload,
 						return MOSQ_ERR_INVAL;
 					}
 					cur_listener->max_topic_alias_broker = (uint16_t)tmp_int;
+				}else if(!strcmp(token, "topic_rewrite")){
+					char *filter, *replacement;
+
+					filter = strtok_r(NULL, " ", &saveptr);
+					REQUIRE_NON_EMPTY_OPTION(filter, "topic_rewrite");
+					replacement = strtok_r(NULL, " ", &saveptr);
+					REQUIRE_NON_EMPTY_OPTION(replacement, "topic_rewrite");
+
+					rc = topic_rewrite__add(&config->topic_rewrites, filter, replacement);
+					if(rc == MOSQ_ERR_ALREADY_EXISTS){
+						log__printf(NULL, MOSQ_LOG_ERR, "Error: Duplicate 'topic_rewrite' topic filter (%s).", filter);
+						return MOSQ_ERR_INVAL;
+					}else if(rc){
+						log__printf(NULL, MOSQ_LOG_ERR, "Error: Invalid 'topic_rewrite' value (%s %s).", filter, replacement);
+						return rc;
+					}
 				}else if(!strcmp(token, "try_private")){
 #ifdef WITH_BRIDGE
 					REQUIRE_BRIDGE(token);
@@ -177,11 +177,16 @@ void context__cleanup(struct mosquitto *context, bool force_free)
 	mosquitto_FREE(context->auth_method);
 	mosquitto_FREE(context->username);
 	mosquitto_FREE(context->password);
+	auth_verify__cancel(context);
 
 	net__socket_close(context);
 	if(force_free){
 		sub__clean_session(context);
 	}
+#ifdef WITH_PERSISTENCE
+	persist__lazy_queue_drop(context);
+#endif
+	db__check_acl_cancel(context);
 	db__messages_delete(context, force_free);
 
 	mosquitto_FREE(context->address);
@@ -278,6 +283,8 @@ void context__disconnect(struct mosquitto *context, int reason)
 	}
 
 	net__socket_close(context);
+	/* Any queued messages not yet checked are checked on the next reconnect */
+	db__check_acl_cancel(context);
 #ifdef WITH_BRIDGE
 	if(context->bridge == NULL)
 	/* Outgoing bridge connection never expire */
@@ -380,5 +387,6 @@ void context__remove_from_by_id(struct mosquitto *context)
 	HASH_FIND(hh_id, db.contexts_by_id_delayed_auth, context->id, strlen(context->id), context_found);
 	if(context_found == context){
 		HASH_DELETE(hh_id, db.contexts_by_id_delayed_auth, context_found);
+		auth_verify__cancel(context);
 	}
 }
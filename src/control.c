@@ -83,7 +83,7 @@ int control__process(struct mosquitto *context, struct mosquitto__base_msg *base
 		event_data.reason_code = MQTT_RC_SUCCESS;
 		event_data.reason_string = NULL;
 
-		rc = cb_found->cb(MOSQ_EVT_CONTROL, &event_data, cb_found->userdata);
+		rc = plugin__callback_call(cb_found, MOSQ_EVT_CONTROL, &event_data);
 		if(rc){
 			if(context->protocol == mosq_p_mqtt5 && event_data.reason_string){
 				/* Not a critical error if this fails */
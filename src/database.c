@@ -27,6 +27,13 @@ Contributors:
 #include "sys_tree.h"
 #include "util_mosq.h"
 
+/* Maximum number of queued messages checked against the ACLs per call of
+ * db__check_acl_of_queued_messages() */
+#define ACL_RECHECK_BUDGET 1000
+
+static struct mosquitto *acl_recheck_list = NULL;
+static uint64_t acl_epoch = 0;
+
 
 /**
  * Is this context ready to take more in flight messages right now?
@@ -115,6 +122,10 @@ bool db__ready_for_queue(struct mosquitto *context, int qos, struct mosquitto_ms
 		source_bytes = (ssize_t)msg_data->queued_bytes12;
 		source_count = msg_data->queued_count12;
 	}
+	if(msg_data == &context->msgs_out && context->spillover){
+		source_bytes += context->spillover->bytes12;
+		source_count += context->spillover->count12;
+	}
 	adjust_count = msg_data->inflight_maximum;
 
 	/* nothing in flight for offline clients */
@@ -170,8 +181,59 @@ void db__msg_add_to_queued_stats(struct mosquitto_msg_data *msg_data, struct mos
 }
 
 
+static void db__conflate_index_add(struct mosquitto_msg_data *msg_data, struct mosquitto__client_msg *client_msg)
+{
+	struct mosquitto__conflate_entry *entry;
+	const char *topic = client_msg->base_msg->data.topic;
+
+	HASH_FIND(hh, msg_data->queued_by_topic, topic, strlen(topic), entry);
+	if(entry){
+		/* Only the most recent message on a topic can be replaced. The key
+		 * belongs to the message, so must be updated along with it. */
+		HASH_DELETE(hh, msg_data->queued_by_topic, entry);
+	}else{
+		entry = mosquitto_malloc(sizeof(struct mosquitto__conflate_entry));
+		if(entry == NULL){
+			/* The message is still queued, it just can't be replaced */
+			return;
+		}
+	}
+	entry->client_msg = client_msg;
+	HASH_ADD_KEYPTR(hh, msg_data->queued_by_topic, topic, strlen(topic), entry);
+}
+
+
+static void db__conflate_index_remove(struct mosquitto_msg_data *msg_data, struct mosquitto__client_msg *client_msg)
+{
+	struct mosquitto__conflate_entry *entry;
+	const char *topic = client_msg->base_msg->data.topic;
+
+	HASH_FIND(hh, msg_data->queued_by_topic, topic, strlen(topic), entry);
+	if(entry && entry->client_msg == client_msg){
+		HASH_DELETE(hh, msg_data->queued_by_topic, entry);
+		mosquitto_FREE(entry);
+	}
+}
+
+
+static void db__conflate_index_clear(struct mosquitto_msg_data *msg_data)
+{
+	struct mosquitto__conflate_entry *entry, *entry_tmp;
+
+	HASH_ITER(hh, msg_data->queued_by_topic, entry, entry_tmp){
+		HASH_DELETE(hh, msg_data->queued_by_topic, entry);
+		mosquitto_FREE(entry);
+	}
+}
+
+
+/* Messages removed from a queued list one at a time all pass through here,
+ * which keeps the conflation index in step with the queue. */
 static void db__msg_remove_from_queued_stats(struct mosquitto_msg_data *msg_data, struct mosquitto__client_msg *client_msg)
 {
+	if(msg_data->queued_by_topic){
+		db__conflate_index_remove(msg_data, client_msg);
+	}
 	msg_data->queued_count--;
 	msg_data->queued_bytes -= client_msg->base_msg->data.payloadlen;
 	if(client_msg->data.qos != 0){
@@ -225,7 +287,7 @@ static void subhier_clean(struct mosquitto__subhier **subhier)
 		leaf = peer->subs;
 		while(leaf){
 			nextleaf = leaf->next;
-			mosquitto_FREE(leaf);
+			sub__leaf_free(&leaf);
 			leaf = nextleaf;
 		}
 		subhier_clean(&peer->children);
@@ -273,6 +335,7 @@ void db__msg_store_free(struct mosquitto__base_msg *base_msg)
 		}
 		mosquitto_FREE(base_msg->dest_ids);
 	}
+	plugin__message_out_free(base_msg);
 	mosquitto_FREE(base_msg->data.topic);
 	mosquitto_property_free_all(&base_msg->data.properties);
 	mosquitto_FREE(base_msg->data.payload);
@@ -288,7 +351,7 @@ void db__msg_store_remove(struct mosquitto__base_msg *base_msg, bool notify)
 	HASH_DELETE(hh, db.msg_store, base_msg);
 	db.msg_store_count--;
 	db.msg_store_bytes -= base_msg->data.payloadlen;
-	if(notify == true){
+	if(notify == true && spillover__base_msg_held(base_msg) == false){
 		plugin_persist__handle_base_msg_delete(base_msg);
 	}
 	db__msg_store_free(base_msg);
@@ -351,6 +414,28 @@ static void db__message_remove_inflight(struct mosquitto *context, struct mosqui
 }
 
 
+static void db__acl_recheck_skip(struct mosquitto *context, struct mosquitto__client_msg *client_msg)
+{
+	if(context->acl_recheck_msg == client_msg){
+		context->acl_recheck_msg = client_msg->next;
+	}
+}
+
+
+/* Check a queued outgoing message against the ACLs again, returns true if it
+ * may still be sent. */
+static bool db__message_acl_recheck(struct mosquitto *context, struct mosquitto__client_msg *client_msg)
+{
+	struct mosquitto__base_msg *base_msg = client_msg->base_msg;
+
+	client_msg->acl_epoch = context->acl_epoch;
+	return mosquitto_acl_check(context, base_msg->data.topic,
+			base_msg->data.payloadlen, base_msg->data.payload,
+			base_msg->data.qos, base_msg->data.retain,
+			base_msg->data.properties, MOSQ_ACL_READ) == MOSQ_ERR_SUCCESS;
+}
+
+
 static void db__message_remove_queued(struct mosquitto *context, struct mosquitto_msg_data *msg_data, struct mosquitto__client_msg *item)
 {
 	if(!context || !msg_data || !item){
@@ -358,6 +443,7 @@ static void db__message_remove_queued(struct mosquitto *context, struct mosquitt
 	}
 
 	plugin_persist__handle_client_msg_delete(context, item);
+	db__acl_recheck_skip(context, item);
 
 	DL_DELETE(msg_data->queued, item);
 	if(item->base_msg){
@@ -373,27 +459,36 @@ static void db__fill_inflight_out_from_queue(struct mosquitto *context)
 {
 	struct mosquitto__client_msg *client_msg, *tmp;
 
-	DL_FOREACH_SAFE(context->msgs_out.queued, client_msg, tmp){
-		if(!db__ready_for_flight(context, mosq_md_out, client_msg->data.qos)){
-			return;
-		}
-		switch(client_msg->data.qos){
-			case 0:
-				client_msg->data.state = mosq_ms_publish_qos0;
-				break;
-			case 1:
-				client_msg->data.state = mosq_ms_publish_qos1;
-				break;
-			case 2:
-				client_msg->data.state = mosq_ms_publish_qos2;
-				break;
-		}
-		if(client_msg->base_msg->data.expiry_time && db.now_real_s > client_msg->base_msg->data.expiry_time){
-			db__message_remove_queued(context, &context->msgs_out, client_msg);
-			continue;
+	spillover__queue_refill(context);
+	while(context->msgs_out.queued){
+		DL_FOREACH_SAFE(context->msgs_out.queued, client_msg, tmp){
+			if(!db__ready_for_flight(context, mosq_md_out, client_msg->data.qos)){
+				return;
+			}
+			switch(client_msg->data.qos){
+				case 0:
+					client_msg->data.state = mosq_ms_publish_qos0;
+					break;
+				case 1:
+					client_msg->data.state = mosq_ms_publish_qos1;
+					break;
+				case 2:
+					client_msg->data.state = mosq_ms_publish_qos2;
+					break;
+			}
+			if(client_msg->base_msg->data.expiry_time && db.now_real_s > client_msg->base_msg->data.expiry_time){
+				db__message_remove_queued(context, &context->msgs_out, client_msg);
+				continue;
+			}
+			if(client_msg->acl_epoch != context->acl_epoch && !db__message_acl_recheck(context, client_msg)){
+				db__message_remove_queued(context, &context->msgs_out, client_msg);
+				continue;
+			}
+			plugin_persist__handle_client_msg_update(context, client_msg);
+			db__message_dequeue_first(context, &context->msgs_out);
 		}
-		plugin_persist__handle_client_msg_update(context, client_msg);
-		db__message_dequeue_first(context, &context->msgs_out);
+		/* The in memory queue has drained, fetch more from disk if there are any */
+		spillover__queue_refill(context);
 	}
 }
 
@@ -405,6 +500,7 @@ void db__message_dequeue_first(struct mosquitto *context, struct mosquitto_msg_d
 	UNUSED(context);
 
 	client_msg = msg_data->queued;
+	db__acl_recheck_skip(context, client_msg);
 	DL_DELETE(msg_data->queued, client_msg);
 	DL_APPEND(msg_data->inflight, client_msg);
 	if(msg_data->inflight_quota > 0){
@@ -522,6 +618,7 @@ int db__message_insert_incoming(struct mosquitto *context, uint64_t cmsg_id, str
 		client_msg->data.cmsg_id = ++context->last_cmsg_id;
 	}
 	client_msg->base_msg = base_msg;
+	client_msg->acl_epoch = context->acl_epoch;
 	db__msg_store_ref_inc(client_msg->base_msg);
 	client_msg->data.mid = base_msg->data.source_mid;
 	client_msg->data.direction = mosq_md_in;
@@ -555,13 +652,111 @@ int db__message_insert_incoming(struct mosquitto *context, uint64_t cmsg_id, str
 }
 
 
+/* Move a newly queued message to the spillover store. If that isn't
+ * possible the message stays in memory, unless older messages for the client
+ * are already on disk. Those are only read back once the queue in memory has
+ * drained, so keeping the message would send it ahead of them and break the
+ * ordering of messages on its topic. It is dropped instead. */
+static void db__message_spill(struct mosquitto *context, struct mosquitto__client_msg *client_msg)
+{
+	if(spillover__queue_add(context, client_msg)){
+		if(context->spillover && context->spillover->head){
+			log__printf(NULL, MOSQ_LOG_ERR, "Error: Unable to write queued message for client %s to spillover file, message dropped.", context->id);
+			db__message_remove_queued(context, &context->msgs_out, client_msg);
+		}
+		return;
+	}
+
+	db__acl_recheck_skip(context, client_msg);
+	DL_DELETE(context->msgs_out.queued, client_msg);
+	db__msg_remove_from_queued_stats(&context->msgs_out, client_msg);
+	db__msg_store_ref_dec(&client_msg->base_msg);
+	mosquitto_FREE(client_msg);
+}
+
+
+/* Record that base_msg has been sent to a client, so it isn't sent again
+ * through an overlapping subscription. */
+static int db__msg_add_dest_id(struct mosquitto__base_msg *base_msg, const char *id)
+{
+	char **dest_ids;
+
+	dest_ids = mosquitto_realloc(base_msg->dest_ids, sizeof(char *)*(size_t)(base_msg->dest_id_count+1));
+	if(dest_ids == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	base_msg->dest_ids = dest_ids;
+	base_msg->dest_id_count++;
+	base_msg->dest_ids[base_msg->dest_id_count-1] = mosquitto_strdup(id);
+	if(!base_msg->dest_ids[base_msg->dest_id_count-1]){
+		return MOSQ_ERR_NOMEM;
+	}
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+/* For conflate_queued_messages. If the client has a message queued on the
+ * same topic as base_msg that isn't yet inflight, replace it in place with
+ * base_msg rather than queuing another message. Returns true if a message
+ * was replaced. */
+static bool db__message_conflate(struct mosquitto *context, uint16_t mid, uint8_t qos, bool retain, struct mosquitto__base_msg *base_msg, uint32_t subscription_identifier, bool persist)
+{
+	struct mosquitto_msg_data *msg_data = &context->msgs_out;
+	struct mosquitto__conflate_entry *entry;
+	struct mosquitto__client_msg *client_msg;
+	const char *topic = base_msg->data.topic;
+
+	HASH_FIND(hh, msg_data->queued_by_topic, topic, strlen(topic), entry);
+	if(entry == NULL){
+		return false;
+	}
+	client_msg = entry->client_msg;
+	if(client_msg->base_msg == base_msg){
+		/* The same message through an overlapping subscription */
+		return false;
+	}
+
+	if(persist && context->is_persisted){
+		plugin_persist__handle_client_msg_delete(context, client_msg);
+	}
+	/* This also removes the index entry */
+	db__msg_remove_from_queued_stats(msg_data, client_msg);
+	db__msg_store_ref_dec(&client_msg->base_msg);
+
+	client_msg->base_msg = base_msg;
+	db__msg_store_ref_inc(client_msg->base_msg);
+	client_msg->data.cmsg_id = ++context->last_cmsg_id;
+	client_msg->data.mid = mid;
+	if(qos > context->max_qos){
+		client_msg->data.qos = context->max_qos;
+	}else{
+		client_msg->data.qos = qos;
+	}
+	client_msg->data.retain = retain;
+	client_msg->data.subscription_identifier = subscription_identifier;
+	client_msg->acl_epoch = context->acl_epoch;
+
+	db__msg_add_to_queued_stats(msg_data, client_msg);
+	db__conflate_index_add(msg_data, client_msg);
+
+	if(persist && context->is_persisted){
+		plugin_persist__handle_base_msg_add(client_msg->base_msg);
+		plugin_persist__handle_client_msg_add(context, client_msg);
+	}
+#ifdef WITH_PERSISTENCE
+	db.persistence_changes++;
+#endif
+	return true;
+}
+
+
 int db__message_insert_outgoing(struct mosquitto *context, uint64_t cmsg_id, uint16_t mid, uint8_t qos, bool retain, struct mosquitto__base_msg *base_msg, uint32_t subscription_identifier, bool update, bool persist)
 {
 	struct mosquitto__client_msg *client_msg;
 	struct mosquitto_msg_data *msg_data;
 	enum mosquitto_msg_state state = mosq_ms_invalid;
 	int rc = 0;
-	char **dest_ids;
+	bool conflate;
 
 	assert(base_msg);
 	if(!context){
@@ -610,6 +805,19 @@ int db__message_insert_outgoing(struct mosquitto *context, uint64_t cmsg_id, uin
 		}
 	}
 
+	/* QoS 0 messages are never queued for a connected client, so mustn't
+	 * replace a message that is. */
+	conflate = context->listener && context->listener->conflate_queued_messages;
+	if(conflate && cmsg_id == 0 && msg_data->queued_by_topic
+			&& (qos > 0 || !net__is_connected(context))
+			&& db__message_conflate(context, mid, qos, retain, base_msg, subscription_identifier, persist)){
+
+		if(db.config->allow_duplicate_messages == false && retain == false){
+			return db__msg_add_dest_id(base_msg, context->id);
+		}
+		return MOSQ_ERR_SUCCESS;
+	}
+
 	if(net__is_connected(context)){
 		if(db__ready_for_flight(context, mosq_md_out, qos)){
 			switch(qos){
@@ -671,6 +879,7 @@ int db__message_insert_outgoing(struct mosquitto *context, uint64_t cmsg_id, uin
 		client_msg->data.cmsg_id = ++context->last_cmsg_id;
 	}
 	client_msg->base_msg = base_msg;
+	client_msg->acl_epoch = context->acl_epoch;
 	db__msg_store_ref_inc(client_msg->base_msg);
 	client_msg->data.mid = mid;
 	client_msg->data.direction = mosq_md_out;
@@ -687,6 +896,9 @@ int db__message_insert_outgoing(struct mosquitto *context, uint64_t cmsg_id, uin
 	if(state == mosq_ms_queued){
 		DL_APPEND(msg_data->queued, client_msg);
 		db__msg_add_to_queued_stats(msg_data, client_msg);
+		if(conflate){
+			db__conflate_index_add(msg_data, client_msg);
+		}
 	}else{
 		DL_APPEND(msg_data->inflight, client_msg);
 		db__msg_add_to_inflight_stats(msg_data, client_msg);
@@ -705,22 +917,15 @@ int db__message_insert_outgoing(struct mosquitto *context, uint64_t cmsg_id, uin
 		 * multiple times for overlapping subscriptions, although this is only the
 		 * case for SUBSCRIPTION with multiple subs in so is a minor concern.
 		 */
-		dest_ids = mosquitto_realloc(base_msg->dest_ids, sizeof(char *)*(size_t)(base_msg->dest_id_count+1));
-		if(dest_ids){
-			base_msg->dest_ids = dest_ids;
-			base_msg->dest_id_count++;
-			base_msg->dest_ids[base_msg->dest_id_count-1] = mosquitto_strdup(context->id);
-			if(!base_msg->dest_ids[base_msg->dest_id_count-1]){
-				return MOSQ_ERR_NOMEM;
-			}
-		}else{
+		if(db__msg_add_dest_id(base_msg, context->id)){
 			return MOSQ_ERR_NOMEM;
 		}
 	}
 #ifdef WITH_BRIDGE
 	if(context->bridge && context->bridge->start_type == bst_lazy
 			&& !net__is_connected(context)
-			&& context->msgs_out.inflight_count + context->msgs_out.queued_count >= context->bridge->threshold){
+			&& context->msgs_out.inflight_count + context->msgs_out.queued_count
+			+ (context->spillover ? context->spillover->count : 0) >= context->bridge->threshold){
 
 		context->bridge->lazy_reconnect = true;
 	}
@@ -730,6 +935,10 @@ int db__message_insert_outgoing(struct mosquitto *context, uint64_t cmsg_id, uin
 		util__decrement_send_quota(context);
 	}
 
+	if(state == mosq_ms_queued && spillover__wanted(context)){
+		db__message_spill(context, client_msg);
+	}
+
 	if(update){
 		rc = db__message_write_inflight_out_latest(context);
 		if(rc){
@@ -820,8 +1029,11 @@ int db__messages_delete_outgoing(struct mosquitto *context)
 		return MOSQ_ERR_INVAL;
 	}
 
+	db__check_acl_cancel(context);
+	db__conflate_index_clear(&context->msgs_out);
 	db__messages_delete_list(&context->msgs_out.inflight);
 	db__messages_delete_list(&context->msgs_out.queued);
+	spillover__queue_clear(context);
 	context->msgs_out.inflight_bytes = 0;
 	context->msgs_out.inflight_bytes12 = 0;
 	context->msgs_out.inflight_count = 0;
@@ -1349,13 +1561,70 @@ void db__check_acl_of_all_messages(struct mosquitto *context)
 	db__client_messages_check_acl(context, &context->msgs_in, &context->msgs_in.inflight, &db__msg_remove_from_inflight_stats);
 	db__client_messages_check_acl(context, &context->msgs_in, &context->msgs_in.queued, &db__msg_remove_from_queued_stats);
 	db__client_messages_check_acl(context, &context->msgs_out, &context->msgs_out.inflight, &db__msg_remove_from_inflight_stats);
-	db__client_messages_check_acl(context, &context->msgs_out, &context->msgs_out.queued, &db__msg_remove_from_queued_stats);
+
+	/* The outgoing queue of an offline client can be very long, so rather
+	 * than checking it all now, every queued message is marked as needing a
+	 * check by moving the client to a new epoch. The queue is then checked
+	 * a slice at a time by db__check_acl_of_queued_messages(), and any
+	 * message that hasn't been checked by the time it is due to be sent is
+	 * checked in db__fill_inflight_out_from_queue(). Messages held in the
+	 * spillover store are also checked as they are sent. */
+	context->acl_epoch = ++acl_epoch;
+	context->acl_recheck_msg = context->msgs_out.queued;
+	if(context->acl_recheck_msg && context->acl_recheck_prev == NULL){
+		DL_APPEND2(acl_recheck_list, context, acl_recheck_prev, acl_recheck_next);
+	}
+}
+
+
+void db__check_acl_cancel(struct mosquitto *context)
+{
+	if(context->acl_recheck_prev){
+		DL_DELETE2(acl_recheck_list, context, acl_recheck_prev, acl_recheck_next);
+		context->acl_recheck_prev = NULL;
+		context->acl_recheck_next = NULL;
+	}
+	context->acl_recheck_msg = NULL;
+}
+
+
+void db__check_acl_of_queued_messages(void)
+{
+	struct mosquitto *context;
+	struct mosquitto__client_msg *client_msg;
+	int budget = ACL_RECHECK_BUDGET;
+
+	while(acl_recheck_list && budget > 0){
+		context = acl_recheck_list;
+		while(context->acl_recheck_msg && budget > 0){
+			client_msg = context->acl_recheck_msg;
+			context->acl_recheck_msg = client_msg->next;
+			if(client_msg->acl_epoch != context->acl_epoch){
+				budget--;
+				if(!db__message_acl_recheck(context, client_msg)){
+					db__message_remove_queued(context, &context->msgs_out, client_msg);
+				}
+			}
+		}
+		if(context->acl_recheck_msg){
+			/* Give the other clients a turn */
+			DL_DELETE2(acl_recheck_list, context, acl_recheck_prev, acl_recheck_next);
+			DL_APPEND2(acl_recheck_list, context, acl_recheck_prev, acl_recheck_next);
+		}else{
+			db__check_acl_cancel(context);
+		}
+	}
+	if(acl_recheck_list){
+		loop__update_next_event(1);
+	}
 }
 
 
 static int db__message_write_inflight_out_single(struct mosquitto *context, struct mosquitto__client_msg *client_msg)
 {
 	struct mosquitto__base_msg *base_msg;
+	const struct mosquitto_base_msg *msg_out;
+	struct mosquitto__message_out msg_out_local;
 	mosquitto_property *base_msg_props = NULL;
 	int rc;
 	uint16_t mid;
@@ -1369,6 +1638,8 @@ static int db__message_write_inflight_out_single(struct mosquitto *context, stru
 	uint32_t subscription_id;
 
 	base_msg = client_msg->base_msg;
+	msg_out = &base_msg->data;
+	memset(&msg_out_local, 0, sizeof(msg_out_local));
 
 	expiry_interval = 0;
 	if(base_msg->data.expiry_time){
@@ -1384,19 +1655,45 @@ static int db__message_write_inflight_out_single(struct mosquitto *context, stru
 			expiry_interval = (uint32_t)(base_msg->data.expiry_time - db.now_real_s);
 		}
 	}
+	if(client_msg->data.state == mosq_ms_publish_qos0
+			|| client_msg->data.state == mosq_ms_publish_qos1
+			|| client_msg->data.state == mosq_ms_publish_qos2){
+
+		rc = plugin__handle_message_out_shared(context, base_msg, &msg_out_local, &msg_out);
+		if(rc != MOSQ_ERR_SUCCESS){
+			plugin__message_out_cleanup(&msg_out_local);
+		}
+		if(rc == MOSQ_ERR_NOMEM){
+			return rc;
+		}else if(rc != MOSQ_ERR_SUCCESS){
+			/* Denied for every recipient, so drop it */
+			log__printf(NULL, MOSQ_LOG_DEBUG, "Denied PUBLISH to %s (q%d, r%d, '%s', ... (%ld bytes))",
+					context->id, client_msg->data.qos, client_msg->data.retain,
+					base_msg->data.topic, (long)base_msg->data.payloadlen);
+
+			if(client_msg->data.qos > 0){
+				util__increment_send_quota(context);
+			}
+			db__message_remove_inflight(context, &context->msgs_out, client_msg);
+			db__fill_inflight_out_from_queue(context);
+			return MOSQ_ERR_SUCCESS;
+		}
+	}
+
 	mid = client_msg->data.mid;
 	retries = client_msg->data.dup;
 	retain = client_msg->data.retain;
-	topic = base_msg->data.topic;
+	topic = msg_out->topic;
 	qos = (uint8_t)client_msg->data.qos;
-	payloadlen = base_msg->data.payloadlen;
-	payload = base_msg->data.payload;
+	payloadlen = msg_out->payloadlen;
+	payload = msg_out->payload;
 	subscription_id = client_msg->data.subscription_identifier;
-	base_msg_props = base_msg->data.properties;
+	base_msg_props = msg_out->properties;
 
 	switch(client_msg->data.state){
 		case mosq_ms_publish_qos0:
 			rc = send__publish(context, mid, topic, payloadlen, payload, qos, retain, retries, subscription_id, base_msg_props, expiry_interval);
+			plugin__message_out_cleanup(&msg_out_local);
 			if(rc == MOSQ_ERR_SUCCESS || rc == MOSQ_ERR_OVERSIZE_PACKET){
 				db__message_remove_inflight(context, &context->msgs_out, client_msg);
 			}else{
@@ -1406,6 +1703,7 @@ static int db__message_write_inflight_out_single(struct mosquitto *context, stru
 
 		case mosq_ms_publish_qos1:
 			rc = send__publish(context, mid, topic, payloadlen, payload, qos, retain, retries, subscription_id, base_msg_props, expiry_interval);
+			plugin__message_out_cleanup(&msg_out_local);
 			if(rc == MOSQ_ERR_SUCCESS){
 				client_msg->data.dup = 1; /* Any retry attempts are a duplicate. */
 				client_msg->data.state = mosq_ms_wait_for_puback;
@@ -1419,6 +1717,7 @@ static int db__message_write_inflight_out_single(struct mosquitto *context, stru
 
 		case mosq_ms_publish_qos2:
 			rc = send__publish(context, mid, topic, payloadlen, payload, qos, retain, retries, subscription_id, base_msg_props, expiry_interval);
+			plugin__message_out_cleanup(&msg_out_local);
 			if(rc == MOSQ_ERR_SUCCESS){
 				client_msg->data.dup = 1; /* Any retry attempts are a duplicate. */
 				client_msg->data.state = mosq_ms_wait_for_pubrec;
@@ -117,8 +117,13 @@ int connect__on_authorised(struct mosquitto *context, void *auth_data_out, uint1
 				connect_ack |= 0x01;
 			}
 
+#ifdef WITH_PERSISTENCE
+			persist__lazy_queue_load(found_context);
+#endif
+
 			if(found_context->msgs_in.inflight || found_context->msgs_in.queued
-					|| found_context->msgs_out.inflight || found_context->msgs_out.queued){
+					|| found_context->msgs_out.inflight || found_context->msgs_out.queued
+					|| found_context->spillover){
 
 				in_quota = context->msgs_in.inflight_quota;
 				out_quota = context->msgs_out.inflight_quota;
@@ -128,9 +133,12 @@ int connect__on_authorised(struct mosquitto *context, void *auth_data_out, uint1
 				memcpy(&context->msgs_in, &found_context->msgs_in, sizeof(struct mosquitto_msg_data));
 				memcpy(&context->msgs_out, &found_context->msgs_out, sizeof(struct mosquitto_msg_data));
 				context->last_cmsg_id = found_context->last_cmsg_id;
+				context->spillover = found_context->spillover;
 
 				memset(&found_context->msgs_in, 0, sizeof(struct mosquitto_msg_data));
 				memset(&found_context->msgs_out, 0, sizeof(struct mosquitto_msg_data));
+				found_context->spillover = NULL;
+				db__check_acl_cancel(found_context);
 
 				context->msgs_in.inflight_quota = in_quota;
 				context->msgs_out.inflight_quota = out_quota;
@@ -241,9 +249,10 @@ int connect__on_authorised(struct mosquitto *context, void *auth_data_out, uint1
 	context->ping_t = 0;
 	context->is_dropping = false;
 
-	/* Remove any queued messages that are no longer allowed through ACL,
-	 * assuming a possible change of username. */
+	/* Remove any messages that are no longer allowed through ACL, assuming a
+	 * possible change of username. Queued messages are checked later. */
 	db__check_acl_of_all_messages(context);
+	sub__acl_cache_reset(context);
 	context__add_to_by_id(context);
 
 #ifdef WITH_PERSISTENCE
@@ -1253,7 +1262,9 @@ int handle__connect(struct mosquitto *context)
 		}else
 #endif
 		{
+			db.auth_verify_allowed = true;
 			rc = mosquitto_basic_auth(context);
+			db.auth_verify_allowed = false;
 			switch(rc){
 				case MOSQ_ERR_SUCCESS:
 					break;
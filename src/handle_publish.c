@@ -128,6 +128,7 @@ int handle__accepted_publish(struct mosquitto *context, struct mosquitto__base_m
 			if(rc){
 				return rc;
 			}
+			plugin__message_in_batch_add(base_msg);
 		}else{
 			/* Client isn't allowed any more incoming messages, so fail early */
 			return process_bad_message(context, base_msg, MQTT_RC_QUOTA_EXCEEDED);
@@ -395,5 +396,18 @@ int handle__publish(struct mosquitto *context)
 #endif
 	}
 
+	/* Access is checked against the topic the client published to, as if the
+	 * rewrite had been made by a plugin in MOSQ_EVT_MESSAGE_IN. */
+	rc = topic_rewrite__apply(db.config->topic_rewrites, context->id, context->username, &base_msg->data.topic);
+	if(rc == MOSQ_ERR_INVAL){
+		log__printf(NULL, MOSQ_LOG_DEBUG,
+				"Rejected PUBLISH from %s, topic_rewrite of '%s' gives an invalid topic.",
+				context->id, base_msg->data.topic);
+		return process_bad_message(context, base_msg, MQTT_RC_TOPIC_NAME_INVALID);
+	}else if(rc){
+		db__msg_store_free(base_msg);
+		return rc;
+	}
+
 	return handle__accepted_publish(context, base_msg, mid, dup, &message_expiry_interval);
 }
@@ -39,6 +39,8 @@ int handle__subscribe(struct mosquitto *context)
 	size_t len;
 	uint16_t slen;
 	char *sub_mount;
+	const char *topic_filter;
+	int prefix_len;
 	mosquitto_property *properties = NULL;
 	bool allowed;
 	struct mosquitto_subscription sub;
@@ -174,6 +176,10 @@ int handle__subscribe(struct mosquitto *context)
 
 
 			if(context->listener && context->listener->mount_point){
+				/* The mount point goes after any $filter/ prefix */
+				topic_filter = sub_filter__topic(sub.topic_filter);
+				prefix_len = topic_filter ? (int)(topic_filter - sub.topic_filter) : 0;
+
 				len = strlen(context->listener->mount_point) + slen + 1;
 				sub_mount = mosquitto_malloc(len+1);
 				if(!sub_mount){
@@ -181,7 +187,8 @@ int handle__subscribe(struct mosquitto *context)
 					mosquitto_FREE(payload);
 					return MOSQ_ERR_NOMEM;
 				}
-				snprintf(sub_mount, len, "%s%s", context->listener->mount_point, sub.topic_filter);
+				snprintf(sub_mount, len, "%.*s%s%s", prefix_len, sub.topic_filter,
+						context->listener->mount_point, &sub.topic_filter[prefix_len]);
 				sub_mount[len] = '\0';
 
 				mosquitto_FREE(sub.topic_filter);
@@ -190,22 +197,39 @@ int handle__subscribe(struct mosquitto *context)
 			}
 
 			allowed = true;
-			rc2 = mosquitto_acl_check(context, sub.topic_filter, 0, NULL, qos, false, properties, MOSQ_ACL_SUBSCRIBE);
-			switch(rc2){
-				case MOSQ_ERR_SUCCESS:
-					break;
-				case MOSQ_ERR_ACL_DENIED:
-					allowed = false;
-					if(context->protocol == mosq_p_mqtt5){
-						qos = MQTT_RC_NOT_AUTHORIZED;
-					}else if(context->protocol == mosq_p_mqtt311){
-						qos = 0x80;
-					}
-					break;
-				default:
-					mosquitto_FREE(sub.topic_filter);
-					mosquitto_FREE(payload);
-					return rc2;
+			rc2 = sub_filter__check(sub.topic_filter);
+			if(rc2 == MOSQ_ERR_INVAL){
+				/* Bad $filter/ payload filter */
+				allowed = false;
+				if(context->protocol == mosq_p_mqtt5){
+					qos = MQTT_RC_TOPIC_FILTER_INVALID;
+				}else if(context->protocol == mosq_p_mqtt311){
+					qos = 0x80;
+				}
+			}else if(rc2){
+				mosquitto_FREE(sub.topic_filter);
+				mosquitto_FREE(payload);
+				return rc2;
+			}else{
+				/* Access is checked against the topic filter, without any
+				 * payload filter */
+				rc2 = mosquitto_acl_check(context, sub_filter__topic(sub.topic_filter), 0, NULL, qos, false, properties, MOSQ_ACL_SUBSCRIBE);
+				switch(rc2){
+					case MOSQ_ERR_SUCCESS:
+						break;
+					case MOSQ_ERR_ACL_DENIED:
+						allowed = false;
+						if(context->protocol == mosq_p_mqtt5){
+							qos = MQTT_RC_NOT_AUTHORIZED;
+						}else if(context->protocol == mosq_p_mqtt311){
+							qos = 0x80;
+						}
+						break;
+					default:
+						mosquitto_FREE(sub.topic_filter);
+						mosquitto_FREE(payload);
+						return rc2;
+				}
 			}
 			if(qos > 127){
 				log__printf(NULL, MOSQ_LOG_DEBUG, "\t%s (denied)", sub.topic_filter);
@@ -39,6 +39,7 @@ int handle__unsubscribe(struct mosquitto *context)
 	mosquitto_property *properties = NULL;
 	bool allowed;
 	struct mosquitto_subscription sub;
+	const char *acl_topic;
 
 	if(!context){
 		return MOSQ_ERR_INVAL;
@@ -120,9 +121,13 @@ int handle__unsubscribe(struct mosquitto *context)
 			return MOSQ_ERR_MALFORMED_PACKET;
 		}
 
-		/* ACL check */
+		/* ACL check, against the topic filter without any $filter/ prefix */
 		allowed = true;
-		rc = mosquitto_acl_check(context, sub.topic_filter, 0, NULL, 0, false, properties, MOSQ_ACL_UNSUBSCRIBE);
+		acl_topic = sub_filter__topic(sub.topic_filter);
+		if(acl_topic == NULL){
+			acl_topic = sub.topic_filter;
+		}
+		rc = mosquitto_acl_check(context, acl_topic, 0, NULL, 0, false, properties, MOSQ_ACL_UNSUBSCRIBE);
 		switch(rc){
 			case MOSQ_ERR_SUCCESS:
 				break;
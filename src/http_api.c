@@ -265,6 +265,35 @@ static enum MHD_Result http_api__process_systree(struct MHD_Connection *connecti
 }
 
 
+static enum MHD_Result http_api__process_plugin_stats(struct MHD_Connection *connection)
+{
+	char *buf;
+	enum MHD_Result ret;
+
+	cJSON *j_tree = cJSON_CreateObject();
+	if(!j_tree){
+		return http_api__send_error_response(connection, "Internal server error.\n", MHD_HTTP_INTERNAL_SERVER_ERROR);
+	}
+
+	cJSON *j_plugins = cJSON_AddArrayToObject(j_tree, "plugins");
+	if(!j_plugins || plugin_stats__add_json(j_plugins)){
+		cJSON_Delete(j_tree);
+		return http_api__send_error_response(connection, "Internal server error.\n", MHD_HTTP_INTERNAL_SERVER_ERROR);
+	}
+
+	buf = cJSON_Print(j_tree);
+	cJSON_Delete(j_tree);
+	if(buf){
+		ret = http_api__send_response_with_headers(connection, buf);
+		free(buf);
+	}else{
+		ret = http_api__send_error_response(connection, "Internal server error.\n", MHD_HTTP_INTERNAL_SERVER_ERROR);
+	}
+
+	return ret;
+}
+
+
 static ssize_t http_file_read_cb(void *cls, uint64_t pos, char *buf, size_t max)
 {
 	FILE *fptr = cls;
@@ -339,6 +368,8 @@ static enum MHD_Result http_api__process_api(struct MHD_Connection *connection,
 		return http_api__process_systree(connection);
 	}else if(strcmp(url, "/api/v1/listeners") == 0){
 		return http_api__process_listeners(connection);
+	}else if(strcmp(url, "/api/v1/plugin-stats") == 0){
+		return http_api__process_plugin_stats(connection);
 	}else if(strcmp(url, "/api/v1/version") == 0){
 		return http_api__process_version(connection);
 	}else{
@@ -33,6 +33,7 @@ void listener__set_defaults(struct mosquitto__listener *listener)
 	listener->max_qos = 2;
 	listener->max_topic_alias = 10;
 	listener->max_topic_alias_broker = 10;
+	listener->conflate_queued_messages = false;
 	listener->protocol = mp_mqtt;
 	mosquitto_FREE(listener->mount_point);
 
@@ -138,12 +138,12 @@ static void read_message_expiry_interval(mosquitto_property **proplist, uint32_t
 
 static void queue_plugin_msgs(void)
 {
-	struct mosquitto__message_v5 *msg, *tmp;
+	struct mosquitto__message_v5 *msg, *next;
 	struct mosquitto *context;
 	uint32_t message_expiry;
 
-	DL_FOREACH_SAFE(db.plugin_msgs, msg, tmp){
-		DL_DELETE(db.plugin_msgs, msg);
+	for(msg = plugin_msgs__take(); msg; msg = next){
+		next = msg->next;
 
 		read_message_expiry_interval(&msg->properties, &message_expiry);
 
@@ -214,8 +214,11 @@ int mosquitto_main_loop(struct mosquitto__listener_sock *listensock, int listens
 		bridge_check();
 #endif
 		plugin__handle_tick();
+		auth_verify__check();
+		plugin_jobs__check();
 		session_expiry__check();
 		will_delay__check();
+		db__check_acl_of_queued_messages();
 
 		rc = mux__handle(listensock, listensock_count);
 		if(rc){
@@ -262,6 +265,8 @@ int mosquitto_main_loop(struct mosquitto__listener_sock *listensock, int listens
 			}
 		}
 #endif
+
+		plugin__handle_message_in_batch();
 	}
 
 	return MOSQ_ERR_SUCCESS;
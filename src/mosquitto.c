@@ -350,6 +350,9 @@ static void post_shutdown_cleanup(void)
 	log__printf(NULL, MOSQ_LOG_INFO, "mosquitto version %s terminating", VERSION);
 
 	broker_control__cleanup();
+	auth_verify__cleanup();
+	plugin__message_in_batch_cleanup();
+	plugin_jobs__cleanup();
 
 #ifdef WITH_PERSISTENCE
 	persist__backup(true);
@@ -376,6 +379,10 @@ static void post_shutdown_cleanup(void)
 #endif
 	context__free_disused();
 	keepalive__cleanup();
+#ifdef WITH_PERSISTENCE
+	persist__lazy_close();
+#endif
+	spillover__cleanup();
 
 #ifdef WITH_TLS
 	mosquitto_FREE(db.tls_keylog);
@@ -445,6 +452,9 @@ int main(int argc, char *argv[])
 #endif
 
 	memset(&db, 0, sizeof(struct mosquitto_db));
+#ifndef WIN32
+	db.main_thread = pthread_self();
+#endif
 	db.now_s = mosquitto_time();
 	db.now_real_s = time(NULL);
 	mosquitto_broker_node_id_set(0);
@@ -555,6 +565,12 @@ int main(int argc, char *argv[])
 		return rc;
 	}
 
+	rc = auth_verify__init();
+	if(rc){
+		post_shutdown_cleanup();
+		return rc;
+	}
+
 	rc = listeners__start();
 	if(rc){
 		post_shutdown_cleanup();
@@ -22,6 +22,9 @@ Contributors:
 
 #include "config.h"
 #include <stdio.h>
+#ifndef WIN32
+#  include <pthread.h>
+#endif
 
 #if defined(WITH_WEBSOCKETS) && WITH_WEBSOCKETS == WS_IS_LWS
 #  include <libwebsockets.h>
@@ -160,6 +163,7 @@ struct mosquitto__callback {
 		char *topic;
 		struct timespec next_tick;
 	} data;
+	char *topic_filter; /* MESSAGE_IN, MESSAGE_OUT, ACL_CHECK only. NULL for all topics */
 	mosquitto_plugin_id_t *identifier;
 };
 
@@ -174,6 +178,7 @@ struct plugin__callbacks {
 	struct mosquitto__callback *ext_auth_continue;
 	struct mosquitto__callback *ext_auth_start;
 	struct mosquitto__callback *message_in;
+	struct mosquitto__callback *message_in_batch;
 	struct mosquitto__callback *message_out;
 	struct mosquitto__callback *psk_key;
 	struct mosquitto__callback *reload;
@@ -224,6 +229,7 @@ enum struct_ident {
 	id_listener = 1,
 	id_client = 2,
 	id_listener_ws = 3,
+	id_wakeup = 4,
 };
 #endif
 
@@ -242,6 +248,7 @@ struct mosquitto__listener {
 	uint8_t max_qos;
 	uint16_t max_topic_alias;
 	uint16_t max_topic_alias_broker;
+	bool conflate_queued_messages;
 #ifdef WITH_TLS
 	char *cafile;
 	char *capath;
@@ -307,6 +314,11 @@ struct plugin_own_callback {
 	enum mosquitto_plugin_event event;
 };
 
+/* One more than the highest MOSQ_EVT_* value */
+#define PLUGIN_EVENT_COUNT (MOSQ_EVT_MESSAGE_IN_BATCH+1)
+
+struct plugin__callback_stats;
+
 struct mosquitto_plugin_id_t {
 	struct mosquitto__plugin_config config;
 	struct mosquitto__plugin_lib lib;
@@ -315,9 +327,14 @@ struct mosquitto_plugin_id_t {
 	char *plugin_version;
 	struct control_endpoint *control_endpoints;
 	struct plugin_own_callback *own_callbacks;
+	struct plugin__callback_stats *callback_stats[PLUGIN_EVENT_COUNT];
 	struct timespec next_tick;
+	bool acl_cacheable;
+	bool message_out_shared;
 };
 
+struct topic_rewrite__node;
+
 struct mosquitto__config {
 	bool allow_duplicate_messages;
 	int autosave_interval;
@@ -359,14 +376,23 @@ struct mosquitto__config {
 	char *persistence_location;
 	char *persistence_file;
 	char *persistence_filepath;
+	bool persistence_incremental_retain;
+	bool persistence_lazy_queues;
 	time_t persistent_client_expiration;
+	int password_cache_size;
+	int password_cache_ttl;
+	int password_verify_threads;
+	int plugin_worker_threads;
 	char *pid_file;
 	bool queue_qos0_messages;
+	size_t queue_spillover_bytes;
+	char *queue_spillover_location;
 	bool per_listener_settings;
 	bool retain_available;
 	int retain_expiry_interval;
 	bool set_tcp_nodelay;
 	int sys_interval;
+	struct topic_rewrite__node *topic_rewrites;
 	bool upgrade_outgoing_qos;
 	char *user;
 #if defined(WITH_WEBSOCKETS) && WITH_WEBSOCKETS == WS_IS_LWS
@@ -397,14 +423,21 @@ struct mosquitto__subhier {
 	char topic[];
 };
 
+struct sub__filter;
+
 struct mosquitto__subleaf {
 	struct mosquitto__subleaf *prev;
 	struct mosquitto__subleaf *next;
 	struct mosquitto *context;
 	struct mosquitto__subhier *hier;
 	struct mosquitto__subshared *shared;
+	struct sub__filter *payload_filter; /* For $filter/ subscriptions */
 	uint32_t identifier;
 	uint8_t subscription_options;
+	/* Memoised MOSQ_ACL_READ result for subscriptions without wildcards,
+	 * valid while acl_read_generation matches db.acl_generation. */
+	int8_t acl_read; /* 0 = unknown, 1 = allowed, -1 = denied */
+	uint64_t acl_read_generation;
 	char topic_filter[];
 };
 
@@ -419,19 +452,37 @@ struct mosquitto__retainhier {
 	struct mosquitto__retainhier *parent;
 	struct mosquitto__retainhier *children;
 	struct mosquitto__base_msg *retained;
+	struct mosquitto__retainhier *dirty_next; /* db.retain_dirty list */
 	uint16_t topic_len;
+	bool dirty; /* Changed since the last retain log save */
 	char topic[];
 };
 
+/* The result of the shared MOSQ_EVT_MESSAGE_OUT callbacks for a base
+ * message, reused for every recipient on the same listener while the message
+ * is being sent out to its subscribers. */
+struct mosquitto__message_out {
+	struct mosquitto__message_out *next;
+	struct mosquitto_base_msg data;
+	struct mosquitto__security_options *listener_opts;
+	int rc;
+	bool free_topic;
+	bool free_payload;
+	bool free_properties;
+};
+
 struct mosquitto__base_msg {
 	UT_hash_handle hh;
 	struct mosquitto_base_msg data;
 	struct mosquitto__listener *source_listener;
+	struct mosquitto__message_out *message_out; /* One per listener, see plugin_message.c */
 	char **dest_ids;
 	int dest_id_count;
 	int ref_count;
+	int fanout_depth; /* Non-zero while sub__messages_queue() is sending this message */
 	enum mosquitto_msg_origin origin;
 	bool stored;
+	bool retain_logged; /* Held by the retain tree and in the retain log */
 };
 
 struct mosquitto__client_msg {
@@ -439,6 +490,36 @@ struct mosquitto__client_msg {
 	struct mosquitto__client_msg *prev;
 	struct mosquitto__client_msg *next;
 	struct mosquitto__base_msg *base_msg;
+	/* The ACLs must be checked again before an outgoing message is sent if
+	 * this doesn't match the client's acl_epoch */
+	uint64_t acl_epoch;
+};
+
+/* Index of the queued outgoing messages of a client by topic, used by
+ * conflate_queued_messages. Only messages in the in memory queue appear
+ * here, not those that are inflight or in the spillover store. */
+struct mosquitto__conflate_entry {
+	UT_hash_handle hh;
+	struct mosquitto__client_msg *client_msg;
+};
+
+/* Index entry for a queued message held in the spillover store */
+struct spillover_item {
+	struct spillover_item *next;
+	struct spillover_segment *segment;
+	uint64_t offset;
+	dbid_t store_id;
+	uint32_t payloadlen;
+	uint8_t qos;
+};
+
+struct spillover_queue {
+	struct spillover_item *head;
+	struct spillover_item *tail;
+	int count;
+	int count12;
+	long bytes;
+	long bytes12;
 };
 
 
@@ -495,14 +576,20 @@ struct mosquitto_db {
 	int retained_count;
 #endif
 	int persistence_changes;
+	struct mosquitto__retainhier *retain_dirty;
 	struct mosquitto *ll_for_free;
+	bool auth_verify_allowed; /* Set while a CONNECT is being authenticated */
+	uint64_t acl_generation; /* Incremented to invalidate memoised ACL results */
 #ifdef WITH_EPOLL
 	int epollfd;
 #endif
 #ifdef WITH_KQUEUE
 	int kqueuefd;
 #endif
-	struct mosquitto__message_v5 *plugin_msgs;
+	struct mosquitto__message_v5 *plugin_msgs; /* Lock free stack, see plugin_public.c */
+#ifndef WIN32
+	pthread_t main_thread;
+#endif
 #ifdef WITH_TLS
 	/* tls_keylog can't be in the config struct because it is used
 	   before the config is allocated. Config probably
@@ -702,6 +789,9 @@ int db__close(void);
 #ifdef WITH_PERSISTENCE
 int persist__backup(bool shutdown);
 int persist__restore(void);
+int persist__lazy_queue_load(struct mosquitto *context);
+void persist__lazy_queue_drop(struct mosquitto *context);
+void persist__lazy_close(void);
 #endif
 /* Return the number of in-flight messages in count. */
 int db__message_count(int *count);
@@ -739,6 +829,8 @@ void db__msg_add_to_queued_stats(struct mosquitto_msg_data *msg_data, struct mos
 uint64_t db__new_msg_id(void);
 void db__expire_all_messages(struct mosquitto *context);
 void db__check_acl_of_all_messages(struct mosquitto *context);
+void db__check_acl_of_queued_messages(void);
+void db__check_acl_cancel(struct mosquitto *context);
 
 /* ============================================================
  * Subscription functions
@@ -750,7 +842,26 @@ void sub__tree_print(struct mosquitto__subhier *root, int level);
 int sub__clean_session(struct mosquitto *context);
 int sub__messages_queue(const char *source_id, const char *topic, uint8_t qos, int retain, struct mosquitto__base_msg **base_msg);
 int sub__topic_tokenise(const char *subtopic, char **local_sub, char ***topics, const char **sharename);
+void sub__acl_cache_reset(struct mosquitto *context);
 void sub__topic_tokens_free(struct sub__token *tokens);
+void sub__leaf_free(struct mosquitto__subleaf **leaf);
+
+/* ============================================================
+ * Subscription payload filter functions
+ * ============================================================ */
+const char *sub_filter__topic(const char *topic_filter);
+int sub_filter__compile(const char *topic_filter, struct sub__filter **filter);
+int sub_filter__check(const char *topic_filter);
+void sub_filter__free(struct sub__filter **filter);
+bool sub_filter__match(const struct sub__filter *filter, const struct mosquitto__base_msg *base_msg);
+void sub_filter__payload_release(void);
+
+/* ============================================================
+ * Topic rewrite functions
+ * ============================================================ */
+int topic_rewrite__add(struct topic_rewrite__node **root, const char *filter, const char *replacement);
+void topic_rewrite__cleanup(struct topic_rewrite__node **root);
+int topic_rewrite__apply(struct topic_rewrite__node *root, const char *clientid, const char *username, char **topic);
 
 /* ============================================================
  * Context functions
@@ -820,6 +931,7 @@ int mux__remove_out(struct mosquitto *context);
 int mux__delete(struct mosquitto *context);
 int mux__wait(void);
 int mux__handle(struct mosquitto__listener_sock *listensock, int listensock_count);
+int mux__wakeup(void);
 int mux__cleanup(void);
 
 /* ============================================================
@@ -850,12 +962,27 @@ void plugin__handle_connect(struct mosquitto *context);
 void plugin__handle_disconnect(struct mosquitto *context, int reason);
 void plugin__handle_client_offline(struct mosquitto *context, int reason);
 int plugin__handle_message_in(struct mosquitto *context, struct mosquitto_base_msg *base_msg);
+struct mosquitto__message_v5 *plugin_msgs__take(void);
+void plugin__message_in_batch_add(struct mosquitto__base_msg *base_msg);
+void plugin__handle_message_in_batch(void);
+void plugin__message_in_batch_cleanup(void);
 int plugin__handle_message_out(struct mosquitto *context, struct mosquitto_base_msg *base_msg);
+int plugin__handle_message_out_shared(struct mosquitto *context, struct mosquitto__base_msg *base_msg, struct mosquitto__message_out *local, const struct mosquitto_base_msg **msg_out);
+void plugin__message_out_cleanup(struct mosquitto__message_out *out);
+void plugin__message_out_free(struct mosquitto__base_msg *base_msg);
 int plugin__handle_subscribe(struct mosquitto *context, struct mosquitto_subscription *sub);
 int plugin__handle_unsubscribe(struct mosquitto *context, struct mosquitto_subscription *sub);
 int plugin__handle_reload(void);
 void plugin__handle_tick(void);
 int plugin__callback_unregister_all(mosquitto_plugin_id_t *identifier);
+bool plugin__callback_matches_topic(const struct mosquitto__callback *cb, const char *topic);
+const char *plugin__event_name(enum mosquitto_plugin_event event);
+int plugin__callback_call(struct mosquitto__callback *cb_base, int event, void *event_data);
+void plugin_stats__cleanup(mosquitto_plugin_id_t *identifier);
+int plugin_stats__add_json(struct cJSON *j_plugins);
+#ifdef WITH_SYS_TREE
+void plugin_stats__sys_tree_update(void);
+#endif
 void plugin_persist__handle_restore(void);
 void plugin_persist__handle_client_add(struct mosquitto *context);
 void plugin_persist__handle_client_delete(struct mosquitto *context);
@@ -899,6 +1026,7 @@ int retain__queue(struct mosquitto *context, const struct mosquitto_subscription
 int retain__store(const char *topic, struct mosquitto__base_msg *base_msg, char **split_topics, bool persist);
 void retain__expiry_check(void);
 void retain__expire(struct mosquitto__retainhier **retainhier);
+void retain__dirty_clear(void);
 
 /* ============================================================
  * Security related functions
@@ -911,6 +1039,7 @@ int config__plugin_add_secopt(mosquitto_plugin_id_t *plugin, struct mosquitto__s
 int mosquitto_security_init(bool reload);
 int mosquitto_security_cleanup(bool reload);
 int mosquitto_acl_check(struct mosquitto *context, const char *topic, uint32_t payloadlen, void *payload, uint8_t qos, bool retain, mosquitto_property *properties, int access);
+bool acl__read_cacheable(struct mosquitto *context);
 int mosquitto_basic_auth(struct mosquitto *context);
 int mosquitto_psk_key_get(struct mosquitto *context, const char *hint, const char *identity, char *key, int max_key_len);
 
@@ -930,6 +1059,47 @@ int mosquitto_security_auth_continue(struct mosquitto *context, const void *data
 
 void unpwd__free_item(struct mosquitto__unpwd **unpwd, struct mosquitto__unpwd *item);
 
+/* ============================================================
+ * Worker thread pools
+ * ============================================================ */
+/* Embedded at the start of each type of job. run() is called on a worker
+ * thread. */
+struct mosquitto__worker_job {
+	struct mosquitto__worker_job *next;
+	void (*run)(struct mosquitto__worker_job *job);
+};
+
+struct mosquitto__worker_pool *worker_pool__new(const char *name, int count);
+void worker_pool__submit(struct mosquitto__worker_pool *pool, struct mosquitto__worker_job *job);
+struct mosquitto__worker_job *worker_pool__take_done(struct mosquitto__worker_pool *pool);
+void worker_pool__free(struct mosquitto__worker_pool *pool, struct mosquitto__worker_job **pending, struct mosquitto__worker_job **done);
+
+/* ============================================================
+ * Password verifier threads
+ * ============================================================ */
+int auth_verify__init(void);
+void auth_verify__cleanup(void);
+void auth_verify__reload(void);
+void auth_verify__cancel(struct mosquitto *context);
+void auth_verify__check(void);
+
+/* ============================================================
+ * Plugin worker threads
+ * ============================================================ */
+void plugin_jobs__cleanup(void);
+void plugin_jobs__check(void);
+
+/* ============================================================
+ * Queue spillover
+ * ============================================================ */
+bool spillover__wanted(struct mosquitto *context);
+bool spillover__base_msg_held(const struct mosquitto__base_msg *base_msg);
+int spillover__queue_add(struct mosquitto *context, struct mosquitto__client_msg *client_msg);
+void spillover__queue_refill(struct mosquitto *context);
+void spillover__queue_clear(struct mosquitto *context);
+int spillover__item_read(const struct spillover_item *item, struct mosquitto__client_msg *client_msg, dbid_t *store_id, struct mosquitto__base_msg **base_msg);
+void spillover__cleanup(void);
+
 /* ============================================================
  * Session expiry
  * ============================================================ */
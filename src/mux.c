@@ -120,6 +120,20 @@ int mux__handle(struct mosquitto__listener_sock *listensock, int listensock_coun
 }
 
 
+/* Make the current or next mux__handle() call return straight away. This may
+ * be called from any thread. */
+int mux__wakeup(void)
+{
+#ifdef WITH_EPOLL
+	return mux_epoll__wakeup();
+#elif defined(WITH_KQUEUE)
+	return mux_kqueue__wakeup();
+#else
+	return mux_poll__wakeup();
+#endif
+}
+
+
 int mux__cleanup(void)
 {
 #ifdef WITH_EPOLL
@@ -29,6 +29,7 @@ int mux_epoll__add_out(struct mosquitto *context);
 int mux_epoll__remove_out(struct mosquitto *context);
 int mux_epoll__delete(struct mosquitto *context);
 int mux_epoll__handle(void);
+int mux_epoll__wakeup(void);
 int mux_epoll__cleanup(void);
 
 int mux_kqueue__init(void);
@@ -39,6 +40,7 @@ int mux_kqueue__add_out(struct mosquitto *context);
 int mux_kqueue__remove_out(struct mosquitto *context);
 int mux_kqueue__delete(struct mosquitto *context);
 int mux_kqueue__handle(void);
+int mux_kqueue__wakeup(void);
 int mux_kqueue__cleanup(void);
 
 int mux_poll__init(void);
@@ -49,6 +51,7 @@ int mux_poll__add_out(struct mosquitto *context);
 int mux_poll__remove_out(struct mosquitto *context);
 int mux_poll__delete(struct mosquitto *context);
 int mux_poll__handle(struct mosquitto__listener_sock *listensock, int listensock_count);
+int mux_poll__wakeup(void);
 int mux_poll__cleanup(void);
 
 #endif
@@ -27,6 +27,8 @@ Contributors:
 
 #ifndef WIN32
 #  include <sys/epoll.h>
+#  include <sys/eventfd.h>
+#  include <unistd.h>
 #  define MAX_EVENTS 1000
 #endif
 
@@ -42,9 +44,16 @@ static void loop_handle_reads_writes(struct mosquitto *context, uint32_t events)
 
 static struct epoll_event ep_events[MAX_EVENTS];
 
+/* Written to by mux_epoll__wakeup(). wakeup_ident stands in for the ident
+ * member of a context in the epoll event data. */
+static int wakeup_fd = -1;
+static int wakeup_ident = id_wakeup;
+
 
 int mux_epoll__init(void)
 {
+	struct epoll_event ev;
+
 	memset(&ep_events, 0, sizeof(struct epoll_event)*MAX_EVENTS);
 
 	db.epollfd = 0;
@@ -53,6 +62,36 @@ int mux_epoll__init(void)
 		return MOSQ_ERR_UNKNOWN;
 	}
 
+	wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(wakeup_fd == -1){
+		log__printf(NULL, MOSQ_LOG_ERR, "Error in eventfd creating: %s", strerror(errno));
+		return MOSQ_ERR_UNKNOWN;
+	}
+	memset(&ev, 0, sizeof(struct epoll_event));
+	ev.data.ptr = &wakeup_ident;
+	ev.events = EPOLLIN;
+	if(epoll_ctl(db.epollfd, EPOLL_CTL_ADD, wakeup_fd, &ev) == -1){
+		log__printf(NULL, MOSQ_LOG_ERR, "Error in epoll initial registering: %s", strerror(errno));
+		(void)close(wakeup_fd);
+		wakeup_fd = -1;
+		return MOSQ_ERR_UNKNOWN;
+	}
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+int mux_epoll__wakeup(void)
+{
+	uint64_t val = 1;
+
+	if(wakeup_fd == -1){
+		return MOSQ_ERR_NOT_SUPPORTED;
+	}
+	/* EAGAIN means the counter is already non-zero, which is all we need */
+	if(write(wakeup_fd, &val, sizeof(val)) == -1 && errno != EAGAIN){
+		return MOSQ_ERR_ERRNO;
+	}
 	return MOSQ_ERR_SUCCESS;
 }
 
@@ -183,6 +222,11 @@ int mux_epoll__handle(void)
 				context = ep_events[i].data.ptr;
 				if(context->ident == id_client){
 					loop_handle_reads_writes(context, ep_events[i].events);
+				}else if(context->ident == id_wakeup){
+					uint64_t val;
+					if(read(wakeup_fd, &val, sizeof(val)) == -1){
+						/* Nothing to do, the counter was already reset */
+					}
 				}else if(context->ident == id_listener){
 					listensock = ep_events[i].data.ptr;
 
@@ -204,6 +248,10 @@ int mux_epoll__handle(void)
 
 int mux_epoll__cleanup(void)
 {
+	if(wakeup_fd != -1){
+		(void)close(wakeup_fd);
+		wakeup_fd = -1;
+	}
 	(void)close(db.epollfd);
 	db.epollfd = 0;
 	return MOSQ_ERR_SUCCESS;
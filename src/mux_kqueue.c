@@ -35,9 +35,15 @@ static void loop_handle_reads_writes(struct mosquitto *context, short events);
 
 static struct kevent event_list[MAX_EVENTS];
 
+/* Triggered by mux_kqueue__wakeup(). wakeup_ident stands in for the ident
+ * member of a context in the event udata. */
+static int wakeup_ident = id_wakeup;
+
 
 int mux_kqueue__init(void)
 {
+	struct kevent ev;
+
 	memset(&event_list, 0, sizeof(struct kevent)*MAX_EVENTS);
 
 	db.kqueuefd = 0;
@@ -46,6 +52,24 @@ int mux_kqueue__init(void)
 		return MOSQ_ERR_UNKNOWN;
 	}
 
+	EV_SET(&ev, 0, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, &wakeup_ident);
+	if(kevent(db.kqueuefd, &ev, 1, NULL, 0, NULL) == -1){
+		log__printf(NULL, MOSQ_LOG_ERR, "Error in kqueue initial registering: %s", strerror(errno));
+		return MOSQ_ERR_UNKNOWN;
+	}
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+int mux_kqueue__wakeup(void)
+{
+	struct kevent ev;
+
+	EV_SET(&ev, 0, EVFILT_USER, 0, NOTE_TRIGGER, 0, &wakeup_ident);
+	if(kevent(db.kqueuefd, &ev, 1, NULL, 0, NULL) == -1){
+		return MOSQ_ERR_ERRNO;
+	}
 	return MOSQ_ERR_SUCCESS;
 }
 
@@ -189,6 +213,8 @@ int mux_kqueue__handle(void)
 					if(event_list[i].flags & (EV_EOF | EV_ERROR)){
 						do_disconnect(context, MOSQ_ERR_CONN_LOST);
 					}
+				}else if(context->ident == id_wakeup){
+					/* Nothing to do, EV_CLEAR resets the event */
 				}else if(context->ident == id_listener){
 					listensock = event_list[i].udata;
 
@@ -26,6 +26,7 @@ Contributors:
 
 #include <assert.h>
 #ifndef WIN32
+#include <fcntl.h>
 #include <poll.h>
 #include <unistd.h>
 #else
@@ -59,6 +60,13 @@ static void loop_handle_reads_writes(void);
 static struct pollfd *pollfds = NULL;
 static size_t pollfd_max, pollfd_current_max = 0;
 
+/* Pipe written to by mux_poll__wakeup(), which takes the pollfd slot after the
+ * listeners. */
+#ifndef WIN32
+static int wakeup_pipe[2] = {-1, -1};
+#endif
+static int wakeup_index = -1;
+
 
 int mux_poll__init(void)
 {
@@ -78,7 +86,43 @@ int mux_poll__init(void)
 		pollfds[i].fd = INVALID_SOCKET;
 	}
 
+#ifndef WIN32
+	if(pipe(wakeup_pipe) == -1){
+		log__printf(NULL, MOSQ_LOG_ERR, "Error creating wakeup pipe: %s", strerror(errno));
+		return MOSQ_ERR_UNKNOWN;
+	}
+	if(fcntl(wakeup_pipe[0], F_SETFL, O_NONBLOCK) == -1
+			|| fcntl(wakeup_pipe[1], F_SETFL, O_NONBLOCK) == -1){
+
+		log__printf(NULL, MOSQ_LOG_ERR, "Error creating wakeup pipe: %s", strerror(errno));
+		(void)close(wakeup_pipe[0]);
+		(void)close(wakeup_pipe[1]);
+		wakeup_pipe[0] = -1;
+		wakeup_pipe[1] = -1;
+		return MOSQ_ERR_UNKNOWN;
+	}
+#endif
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+int mux_poll__wakeup(void)
+{
+#ifndef WIN32
+	char c = 0;
+
+	if(wakeup_pipe[1] == -1){
+		return MOSQ_ERR_NOT_SUPPORTED;
+	}
+	/* EAGAIN means the pipe is already full of wakeups */
+	if(write(wakeup_pipe[1], &c, 1) == -1 && errno != EAGAIN){
+		return MOSQ_ERR_ERRNO;
+	}
 	return MOSQ_ERR_SUCCESS;
+#else
+	return MOSQ_ERR_NOT_SUPPORTED;
+#endif
 }
 
 
@@ -92,6 +136,15 @@ int mux_poll__add_listeners(struct mosquitto__listener_sock *listensock, int lis
 		pollfds[pollfd_index].revents = 0;
 		pollfd_index++;
 	}
+#ifndef WIN32
+	if(wakeup_pipe[0] != -1){
+		pollfds[pollfd_index].fd = wakeup_pipe[0];
+		pollfds[pollfd_index].events = POLLIN;
+		pollfds[pollfd_index].revents = 0;
+		wakeup_index = (int)pollfd_index;
+		pollfd_index++;
+	}
+#endif
 
 	if(pollfd_current_max == 0){
 		pollfd_current_max = pollfd_index-1;
@@ -112,6 +165,12 @@ int mux_poll__delete_listeners(struct mosquitto__listener_sock *listensock, int
 		pollfds[pollfd_index].revents = 0;
 		pollfd_index++;
 	}
+	if(wakeup_index != -1){
+		pollfds[wakeup_index].fd = INVALID_SOCKET;
+		pollfds[wakeup_index].events = 0;
+		pollfds[wakeup_index].revents = 0;
+		wakeup_index = -1;
+	}
 
 	return MOSQ_ERR_SUCCESS;
 }
@@ -230,6 +289,13 @@ int mux_poll__handle(struct mosquitto__listener_sock *listensock, int listensock
 			log__printf(NULL, MOSQ_LOG_ERR, "Error in poll: %s.", strerror(errno));
 		}
 	}else{
+#ifndef WIN32
+		if(wakeup_index != -1 && pollfds[wakeup_index].revents & POLLIN){
+			char buf[64];
+			while(read(wakeup_pipe[0], buf, sizeof(buf)) > 0){
+			}
+		}
+#endif
 		loop_handle_reads_writes();
 
 		for(int i=0; i<listensock_count; i++){
@@ -254,6 +320,14 @@ int mux_poll__handle(struct mosquitto__listener_sock *listensock, int listensock
 int mux_poll__cleanup(void)
 {
 	mosquitto_FREE(pollfds);
+#ifndef WIN32
+	for(int i=0; i<2; i++){
+		if(wakeup_pipe[i] != -1){
+			(void)close(wakeup_pipe[i]);
+			wakeup_pipe[i] = -1;
+		}
+	}
+#endif
 
 	return MOSQ_ERR_SUCCESS;
 }
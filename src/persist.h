@@ -21,7 +21,7 @@ Contributors:
 
 #include "mosquitto_broker_internal.h"
 
-#define MOSQ_DB_VERSION 6
+#define MOSQ_DB_VERSION 7
 
 /* DB read/write */
 extern const unsigned char magic[15];
@@ -31,6 +31,13 @@ extern const unsigned char magic[15];
 #define DB_CHUNK_RETAIN 4
 #define DB_CHUNK_SUB 5
 #define DB_CHUNK_CLIENT 6
+/* v7 sections. The record tables reuse the chunk numbers above, the heaps
+ * hold the variable length data referred to by the tables. */
+#define DB_SECTION_STRINGS 7
+#define DB_SECTION_PAYLOADS 8
+#define DB_SECTION_MAX 8
+/* Only used in the retain log */
+#define DB_CHUNK_RETAIN_CLEAR 9
 /* End DB read/write */
 
 #define read_e(f, b, c) if(fread(b, 1, c, f) != c){ rc = MOSQ_ERR_UNKNOWN; goto error; }
@@ -145,6 +152,115 @@ struct P_retain {
 };
 
 
+/* v7 format
+ *
+ * The file header is followed by one byte of padding, a PF_v7_header and a
+ * directory of section_count PF_v7_section entries. Each record table section
+ * holds `count` fixed size records of `record_size` bytes, so any record can be
+ * found without reading those before it. Strings (client ids, usernames,
+ * topics) live in the string heap, message payloads and properties live in the
+ * payload heap. Records refer to heap data by offset into the heap.
+ *
+ * Sections start on 8 byte boundaries. As with the earlier versions, 16 and 32
+ * bit values are stored in network byte order and 64 bit values in host byte
+ * order. Readers must use `record_size` as the stride through a table, so
+ * members can be appended to the records without a version change.
+ *
+ * The base message table is sorted by store_id, so a single message can be
+ * found by binary search without loading the whole table.
+ */
+#define PERSIST_V7_DIR_OFFSET 24
+
+struct PF_v7_header {
+	uint32_t section_count;
+	uint32_t flags;
+};
+
+struct PF_v7_section {
+	uint32_t type;
+	uint32_t record_size;
+	uint64_t offset;
+	uint64_t length;
+	uint64_t count;
+};
+
+struct PF_v7_client {
+	int64_t session_expiry_time;
+	uint64_t str_offset; /* clientid, then username */
+	uint32_t session_expiry_interval;
+	uint16_t last_mid;
+	uint16_t id_len;
+	uint16_t listener_port;
+	uint16_t username_len;
+};
+
+struct PF_v7_client_msg {
+	dbid_t store_id;
+	uint64_t id_offset;
+	uint32_t subscription_identifier;
+	uint16_t mid;
+	uint16_t id_len;
+	uint8_t qos;
+	uint8_t state;
+	uint8_t retain_dup;
+	uint8_t direction;
+};
+
+struct PF_v7_base_msg {
+	dbid_t store_id;
+	int64_t expiry_time;
+	uint64_t str_offset; /* source_id, then source_username, then topic */
+	uint64_t data_offset; /* payload, then properties */
+	uint32_t payloadlen;
+	uint32_t proplen;
+	uint16_t source_mid;
+	uint16_t source_id_len;
+	uint16_t source_username_len;
+	uint16_t topic_len;
+	uint16_t source_port;
+	uint8_t qos;
+	uint8_t retain;
+};
+
+struct PF_v7_sub {
+	uint64_t id_offset;
+	uint64_t topic_offset;
+	uint32_t identifier;
+	uint16_t id_len;
+	uint16_t topic_len;
+	uint8_t qos;
+	uint8_t options;
+};
+
+struct PF_v7_retain {
+	dbid_t store_id;
+};
+
+/* A v7 file opened for reading. `sections` is indexed by section type and is
+ * in host byte order. */
+struct persist__v7 {
+	const uint8_t *data;
+	size_t len;
+	bool mapped;
+	struct PF_v7_section sections[DB_SECTION_MAX+1];
+};
+
+struct persist__v7_buf {
+	uint8_t *data;
+	size_t len;
+	size_t size;
+	uint64_t count;
+};
+
+struct persist__v7_writer {
+	FILE *db_fptr;
+	struct persist__v7_buf sections[DB_SECTION_MAX+1];
+	uint64_t payloads_len;
+	const char *last_clientid;
+	uint64_t last_clientid_offset;
+};
+
+
 int persist__read_string_len(FILE *db_fptr, char **str, uint16_t len);
 int persist__read_string(FILE *db_fptr, char **str);
 
@@ -166,11 +282,51 @@ int persist__chunk_base_msg_read_v56(FILE *db_fptr, struct P_base_msg *chunk, ui
 int persist__chunk_retain_read_v56(FILE *db_fptr, struct P_retain *chunk);
 int persist__chunk_sub_read_v56(FILE *db_fptr, struct P_sub *chunk);
 
-int persist__chunk_cfg_write_v6(FILE *db_fptr, struct PF_cfg *chunk);
-int persist__chunk_client_write_v6(FILE *db_fptr, struct P_client *chunk);
-int persist__chunk_client_msg_write_v6(FILE *db_fptr, struct P_client_msg *chunk);
-int persist__chunk_message_store_write_v6(FILE *db_fptr, struct P_base_msg *chunk);
-int persist__chunk_retain_write_v6(FILE *db_fptr, struct P_retain *chunk);
-int persist__chunk_sub_write_v6(FILE *db_fptr, struct P_sub *chunk);
+int persist__v7_open(FILE *db_fptr, struct persist__v7 *v7);
+void persist__v7_close(struct persist__v7 *v7);
+void persist__v7_random_access(const struct persist__v7 *v7);
+uint64_t persist__v7_count(const struct persist__v7 *v7, uint32_t type);
+bool persist__v7_base_msgs_sorted(const struct persist__v7 *v7);
+int persist__v7_base_msg_find(const struct persist__v7 *v7, dbid_t store_id, uint64_t *index);
+int persist__chunk_cfg_read_v7(const struct persist__v7 *v7, struct PF_cfg *chunk);
+int persist__chunk_client_read_v7(const struct persist__v7 *v7, uint64_t index, struct P_client *chunk);
+int persist__chunk_client_msg_read_v7(const struct persist__v7 *v7, uint64_t index, struct P_client_msg *chunk);
+int persist__chunk_base_msg_read_v7(const struct persist__v7 *v7, uint64_t index, struct P_base_msg *chunk, bool with_payload);
+int persist__chunk_retain_read_v7(const struct persist__v7 *v7, uint64_t index, struct P_retain *chunk);
+int persist__chunk_sub_read_v7(const struct persist__v7 *v7, uint64_t index, struct P_sub *chunk);
+
+/* Retain log
+ *
+ * With persistence_incremental_retain, retained messages are kept out of the
+ * main persistence file and written to "<persistence_file>.retain" instead.
+ * The retain log has the same header as the main file with version 6, followed
+ * by a stream of v6 chunks:
+ *
+ * DB_CHUNK_BASE_MSG - the retained message for the chunk topic
+ * DB_CHUNK_RETAIN_CLEAR - the topic, which no longer has a retained message
+ *
+ * Each save appends the topics that have changed since the previous save. The
+ * log is periodically rewritten with a single entry per retained message.
+ * Replaying a log is idempotent, so the log is always restored before the
+ * main file.
+ */
+char *persist__retain_log_path(void);
+int persist__retain_log_save(void);
+void persist__retain_log_remove(void);
+void persist__retain_log_compact_next(void);
+void persist__retain_log_restored(unsigned long records, unsigned long live);
+
+const struct persist__v7 *persist__lazy_file(void);
+void persist__lazy_reopen(void);
+
+int persist__v7_writer_init(struct persist__v7_writer *writer, FILE *db_fptr);
+int persist__v7_writer_finish(struct persist__v7_writer *writer);
+void persist__v7_writer_cleanup(struct persist__v7_writer *writer);
+int persist__chunk_cfg_write_v7(struct persist__v7_writer *writer, struct PF_cfg *chunk);
+int persist__chunk_client_write_v7(struct persist__v7_writer *writer, struct P_client *chunk);
+int persist__chunk_client_msg_write_v7(struct persist__v7_writer *writer, struct P_client_msg *chunk);
+int persist__chunk_message_store_write_v7(struct persist__v7_writer *writer, struct P_base_msg *chunk);
+int persist__chunk_retain_write_v7(struct persist__v7_writer *writer, struct P_retain *chunk);
+int persist__chunk_sub_write_v7(struct persist__v7_writer *writer, struct P_sub *chunk);
 
 #endif
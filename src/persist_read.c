@@ -175,52 +175,36 @@ static int persist__client_msg_restore(struct P_client_msg *chunk)
 }
 
 
-static int persist__client_chunk_restore(FILE *db_fptr)
+static int persist__client_restore(struct P_client *chunk)
 {
 	int rc = 0;
 	struct mosquitto *context;
-	struct P_client chunk;
-
-	memset(&chunk, 0, sizeof(struct P_client));
-
-	if(db_version == 6 || db_version == 5){
-		rc = persist__chunk_client_read_v56(db_fptr, &chunk, db_version);
-	}else{
-		rc = persist__chunk_client_read_v234(db_fptr, &chunk, db_version);
-	}
-	if(rc > 0){
-		return rc;
-	}else if(rc < 0){
-		/* Client not loaded, but otherwise not an error */
-		log__printf(NULL, MOSQ_LOG_WARNING, "Warning: Empty client entry found in persistence database, it may be corrupt.");
-		return MOSQ_ERR_SUCCESS;
-	}
 
-	context = persist__find_or_add_context(chunk.clientid, chunk.F.last_mid);
+	context = persist__find_or_add_context(chunk->clientid, chunk->F.last_mid);
 	if(context){
-		context->session_expiry_time = chunk.F.session_expiry_time;
-		context->session_expiry_interval = chunk.F.session_expiry_interval;
-		if(chunk.username && !context->username){
+		context->session_expiry_time = chunk->F.session_expiry_time;
+		context->session_expiry_interval = chunk->F.session_expiry_interval;
+		if(chunk->username && !context->username){
 			/* username is not freed here, it is now owned by context */
-			context->username = chunk.username;
-			chunk.username = NULL;
+			context->username = chunk->username;
+			chunk->username = NULL;
 		}
 		/* in per_listener_settings mode, try to find the listener by persisted port */
-		if(db.config->per_listener_settings && !context->listener && chunk.F.listener_port > 0){
+		if(db.config->per_listener_settings && !context->listener && chunk->F.listener_port > 0){
 			for(int i=0; i < db.config->listener_count; i++){
-				if(db.config->listeners[i].port == chunk.F.listener_port){
+				if(db.config->listeners[i].port == chunk->F.listener_port){
 					context->listener = &db.config->listeners[i];
 					break;
 				}
 			}
 		}
-		session_expiry__add_from_persistence(context, chunk.F.session_expiry_time);
+		session_expiry__add_from_persistence(context, chunk->F.session_expiry_time);
 	}else{
 		rc = 1;
 	}
 
-	mosquitto_FREE(chunk.clientid);
-	mosquitto_FREE(chunk.username);
+	mosquitto_FREE(chunk->clientid);
+	mosquitto_FREE(chunk->username);
 	if(rc == 0){
 		client_count++;
 	}
@@ -228,6 +212,30 @@ static int persist__client_chunk_restore(FILE *db_fptr)
 }
 
 
+static int persist__client_chunk_restore(FILE *db_fptr)
+{
+	int rc = 0;
+	struct P_client chunk;
+
+	memset(&chunk, 0, sizeof(struct P_client));
+
+	if(db_version == 6 || db_version == 5){
+		rc = persist__chunk_client_read_v56(db_fptr, &chunk, db_version);
+	}else{
+		rc = persist__chunk_client_read_v234(db_fptr, &chunk, db_version);
+	}
+	if(rc > 0){
+		return rc;
+	}else if(rc < 0){
+		/* Client not loaded, but otherwise not an error */
+		log__printf(NULL, MOSQ_LOG_WARNING, "Warning: Empty client entry found in persistence database, it may be corrupt.");
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	return persist__client_restore(&chunk);
+}
+
+
 static int persist__client_msg_chunk_restore(FILE *db_fptr, uint32_t length)
 {
 	struct P_client_msg chunk;
@@ -254,41 +262,38 @@ static int persist__client_msg_chunk_restore(FILE *db_fptr, uint32_t length)
 }
 
 
-static int persist__base_msg_chunk_restore(FILE *db_fptr, uint32_t length)
+static int persist__base_msg_restore(struct P_base_msg *chunk)
 {
-	struct P_base_msg chunk;
 	struct mosquitto__base_msg *base_msg = NULL;
 	int64_t message_expiry_interval64;
 	uint32_t message_expiry_interval;
 	uint32_t *p_message_expiry_interval = NULL;
 	int rc = 0;
 
-	memset(&chunk, 0, sizeof(struct P_base_msg));
-
-	if(db_version == 6 || db_version == 5){
-		rc = persist__chunk_base_msg_read_v56(db_fptr, &chunk, length);
-	}else{
-		rc = persist__chunk_base_msg_read_v234(db_fptr, &chunk, db_version);
-	}
-	if(rc){
-		return rc;
-	}
-	if(chunk.F.topic_len == 0){
+	if(chunk->F.topic_len == 0){
 		rc = MOSQ_ERR_INVAL;
 		goto cleanup;
 	}
 
-	if(chunk.F.source_port){
+	HASH_FIND(hh, db.msg_store, &chunk->F.store_id, sizeof(chunk->F.store_id), base_msg);
+	if(base_msg){
+		/* Already restored from the retain log */
+		base_msg = NULL;
+		rc = MOSQ_ERR_SUCCESS;
+		goto cleanup;
+	}
+
+	if(chunk->F.source_port){
 		for(int i=0; i<db.config->listener_count; i++){
-			if(db.config->listeners[i].port == chunk.F.source_port){
-				chunk.source.listener = &db.config->listeners[i];
+			if(db.config->listeners[i].port == chunk->F.source_port){
+				chunk->source.listener = &db.config->listeners[i];
 				break;
 			}
 		}
 	}
 
-	if(chunk.F.expiry_time > 0){
-		message_expiry_interval64 = chunk.F.expiry_time - time(NULL);
+	if(chunk->F.expiry_time > 0){
+		message_expiry_interval64 = chunk->F.expiry_time - time(NULL);
 		if(message_expiry_interval64 < 0 || message_expiry_interval64 > UINT32_MAX){
 			/* Expired message */
 			rc = MOSQ_ERR_SUCCESS;
@@ -306,21 +311,21 @@ static int persist__base_msg_chunk_restore(FILE *db_fptr, uint32_t length)
 		goto cleanup;
 	}
 
-	base_msg->data.store_id = chunk.F.store_id;
-	base_msg->data.source_mid = chunk.F.source_mid;
-	base_msg->data.topic = chunk.topic;
-	base_msg->data.qos = chunk.F.qos;
-	base_msg->data.payloadlen = chunk.F.payloadlen;
-	base_msg->data.retain = chunk.F.retain;
-	base_msg->data.properties = chunk.properties;
-	base_msg->data.payload = chunk.payload;
-	base_msg->source_listener = chunk.source.listener;
-
-	rc = db__message_store(&chunk.source, base_msg, p_message_expiry_interval,
+	base_msg->data.store_id = chunk->F.store_id;
+	base_msg->data.source_mid = chunk->F.source_mid;
+	base_msg->data.topic = chunk->topic;
+	base_msg->data.qos = chunk->F.qos;
+	base_msg->data.payloadlen = chunk->F.payloadlen;
+	base_msg->data.retain = chunk->F.retain;
+	base_msg->data.properties = chunk->properties;
+	base_msg->data.payload = chunk->payload;
+	base_msg->source_listener = chunk->source.listener;
+
+	rc = db__message_store(&chunk->source, base_msg, p_message_expiry_interval,
 			mosq_mo_client);
 
-	mosquitto_FREE(chunk.source.id);
-	mosquitto_FREE(chunk.source.username);
+	mosquitto_FREE(chunk->source.id);
+	mosquitto_FREE(chunk->source.username);
 
 	if(rc == MOSQ_ERR_SUCCESS){
 		base_msg_count++;
@@ -329,34 +334,43 @@ static int persist__base_msg_chunk_restore(FILE *db_fptr, uint32_t length)
 		return rc;
 	}
 cleanup:
-	mosquitto_FREE(chunk.source.id);
-	mosquitto_FREE(chunk.source.username);
-	mosquitto_FREE(chunk.topic);
-	mosquitto_FREE(chunk.payload);
+	mosquitto_FREE(chunk->source.id);
+	mosquitto_FREE(chunk->source.username);
+	mosquitto_FREE(chunk->topic);
+	mosquitto_FREE(chunk->payload);
+	mosquitto_property_free_all(&chunk->properties);
 	return rc;
 }
 
 
-static int persist__retain_chunk_restore(FILE *db_fptr)
+static int persist__base_msg_chunk_restore(FILE *db_fptr, uint32_t length)
 {
-	struct mosquitto__base_msg *base_msg;
-	struct P_retain chunk;
-	int rc;
-	char **split_topics;
-	char *local_topic;
+	struct P_base_msg chunk;
+	int rc = 0;
 
-	memset(&chunk, 0, sizeof(struct P_retain));
+	memset(&chunk, 0, sizeof(struct P_base_msg));
 
 	if(db_version == 6 || db_version == 5){
-		rc = persist__chunk_retain_read_v56(db_fptr, &chunk);
+		rc = persist__chunk_base_msg_read_v56(db_fptr, &chunk, length);
 	}else{
-		rc = persist__chunk_retain_read_v234(db_fptr, &chunk);
+		rc = persist__chunk_base_msg_read_v234(db_fptr, &chunk, db_version);
 	}
 	if(rc){
 		return rc;
 	}
 
-	HASH_FIND(hh, db.msg_store, &chunk.F.store_id, sizeof(chunk.F.store_id), base_msg);
+	return persist__base_msg_restore(&chunk);
+}
+
+
+static int persist__retain_restore(struct P_retain *chunk)
+{
+	struct mosquitto__base_msg *base_msg;
+	int rc;
+	char **split_topics;
+	char *local_topic;
+
+	HASH_FIND(hh, db.msg_store, &chunk->F.store_id, sizeof(chunk->F.store_id), base_msg);
 	if(base_msg){
 		rc = sub__topic_tokenise(base_msg->data.topic, &local_topic, &split_topics, NULL);
 		if(rc){
@@ -373,11 +387,52 @@ static int persist__retain_chunk_restore(FILE *db_fptr)
 }
 
 
+static int persist__retain_chunk_restore(FILE *db_fptr)
+{
+	struct P_retain chunk;
+	int rc;
+
+	memset(&chunk, 0, sizeof(struct P_retain));
+
+	if(db_version == 6 || db_version == 5){
+		rc = persist__chunk_retain_read_v56(db_fptr, &chunk);
+	}else{
+		rc = persist__chunk_retain_read_v234(db_fptr, &chunk);
+	}
+	if(rc){
+		return rc;
+	}
+
+	return persist__retain_restore(&chunk);
+}
+
+
+static int persist__sub_restore(struct P_sub *chunk)
+{
+	int rc;
+	struct mosquitto_subscription sub;
+
+	memset(&sub, 0, sizeof(struct mosquitto_subscription));
+	sub.clientid = chunk->clientid;
+	sub.topic_filter = chunk->topic;
+	sub.options = chunk->F.qos | chunk->F.options;
+	sub.identifier = chunk->F.identifier;
+	rc = persist__restore_sub(&sub);
+
+	mosquitto_FREE(chunk->clientid);
+	mosquitto_FREE(chunk->topic);
+	if(rc == 0){
+		subscription_count++;
+	}
+
+	return rc;
+}
+
+
 static int persist__sub_chunk_restore(FILE *db_fptr)
 {
 	struct P_sub chunk;
 	int rc;
-	struct mosquitto_subscription sub;
 
 	memset(&chunk, 0, sizeof(struct P_sub));
 
@@ -390,18 +445,406 @@ static int persist__sub_chunk_restore(FILE *db_fptr)
 		return rc;
 	}
 
-	sub.clientid = chunk.clientid;
-	sub.topic_filter = chunk.topic;
-	sub.options = chunk.F.qos | chunk.F.options;
-	sub.identifier = chunk.F.identifier;
-	rc = persist__restore_sub(&sub);
+	return persist__sub_restore(&chunk);
+}
+
+
+static int persist__cfg_restore(struct PF_cfg *cfg_chunk)
+{
+	if(cfg_chunk->dbid_size != sizeof(dbid_t)){
+		log__printf(NULL, MOSQ_LOG_ERR, "Error: Incompatible database configuration (dbid size is %d bytes, expected %lu)",
+				cfg_chunk->dbid_size, (unsigned long)sizeof(dbid_t));
+		return MOSQ_ERR_INVAL;
+	}
+	db.last_db_id = cfg_chunk->last_db_id;
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+/* Lazily loaded client queues
+ *
+ * With persistence_lazy_queues set, the client messages in a v7 file are not
+ * restored at start up. Each context instead records the run of client
+ * message records that belongs to it, and the file stays mapped until every
+ * run has been loaded or dropped. Saving copies the unloaded runs into the new
+ * file, after which the runs refer to the new file.
+ */
+static struct persist__v7 lazy_v7;
+static uint64_t lazy_pending = 0;
+static bool lazy_restoring = false;
+
+
+const struct persist__v7 *persist__lazy_file(void)
+{
+	if(lazy_pending == 0){
+		return NULL;
+	}
+	return &lazy_v7;
+}
+
+
+void persist__lazy_close(void)
+{
+	persist__v7_close(&lazy_v7);
+	lazy_pending = 0;
+}
+
+
+void persist__lazy_queue_drop(struct mosquitto *context)
+{
+	if(context->lazy_queue_count == 0){
+		return;
+	}
+	context->lazy_queue_count = 0;
+	if(lazy_pending > 0){
+		lazy_pending--;
+	}
+	if(lazy_pending == 0 && lazy_restoring == false){
+		persist__lazy_close();
+	}
+}
+
+
+/* Make sure base message `store_id` is in memory, if it is in the file. */
+static int persist__lazy_base_msg_load(dbid_t store_id)
+{
+	struct P_base_msg chunk;
+	struct mosquitto__base_msg *base_msg;
+	uint64_t index;
+	int rc;
+
+	HASH_FIND(hh, db.msg_store, &store_id, sizeof(store_id), base_msg);
+	if(base_msg || persist__v7_base_msg_find(&lazy_v7, store_id, &index)){
+		return MOSQ_ERR_SUCCESS;
+	}
 
+	memset(&chunk, 0, sizeof(struct P_base_msg));
+	rc = persist__chunk_base_msg_read_v7(&lazy_v7, index, &chunk, true);
+	if(rc){
+		return rc;
+	}
+	return persist__base_msg_restore(&chunk);
+}
+
+
+static int persist__lazy_client_msg_load(uint64_t index)
+{
+	struct P_client_msg chunk;
+	int rc;
+
+	memset(&chunk, 0, sizeof(struct P_client_msg));
+	rc = persist__chunk_client_msg_read_v7(&lazy_v7, index, &chunk);
+	if(rc){
+		return rc;
+	}
+
+	rc = persist__lazy_base_msg_load(chunk.F.store_id);
+	if(rc == MOSQ_ERR_SUCCESS){
+		rc = persist__client_msg_restore(&chunk);
+	}
 	mosquitto_FREE(chunk.clientid);
-	mosquitto_FREE(chunk.topic);
-	if(rc == 0){
-		subscription_count++;
+
+	return rc;
+}
+
+
+/* Move the messages in `mem`, queued while the client was offline, after
+ * those just loaded from disk. */
+static void persist__lazy_queue_merge(struct mosquitto_msg_data *msg_data, struct mosquitto_msg_data *mem)
+{
+	struct mosquitto__client_msg *cmsg, *tmp;
+
+	DL_FOREACH_SAFE(mem->inflight, cmsg, tmp){
+		DL_DELETE(mem->inflight, cmsg);
+		if(msg_data->queued){
+			cmsg->data.state = mosq_ms_queued;
+			DL_APPEND(msg_data->queued, cmsg);
+			db__msg_add_to_queued_stats(msg_data, cmsg);
+		}else{
+			DL_APPEND(msg_data->inflight, cmsg);
+			db__msg_add_to_inflight_stats(msg_data, cmsg);
+		}
+	}
+	DL_FOREACH_SAFE(mem->queued, cmsg, tmp){
+		DL_DELETE(mem->queued, cmsg);
+		DL_APPEND(msg_data->queued, cmsg);
+		db__msg_add_to_queued_stats(msg_data, cmsg);
+	}
+	/* The conflation index only refers to messages that were queued in
+	 * memory, which are still queued. */
+	msg_data->queued_by_topic = mem->queued_by_topic;
+}
+
+
+static void persist__lazy_msg_data_reset(struct mosquitto_msg_data *msg_data)
+{
+	int inflight_quota = msg_data->inflight_quota;
+	uint16_t inflight_maximum = msg_data->inflight_maximum;
+
+	memset(msg_data, 0, sizeof(struct mosquitto_msg_data));
+	msg_data->inflight_quota = inflight_quota;
+	msg_data->inflight_maximum = inflight_maximum;
+}
+
+
+int persist__lazy_queue_load(struct mosquitto *context)
+{
+	struct mosquitto_msg_data msgs_in, msgs_out;
+	uint64_t first, count;
+	int rc = MOSQ_ERR_SUCCESS;
+
+	if(context->lazy_queue_count == 0){
+		return MOSQ_ERR_SUCCESS;
+	}
+	if(lazy_v7.data == NULL){
+		context->lazy_queue_count = 0;
+		return MOSQ_ERR_SUCCESS;
+	}
+	first = context->lazy_queue_first;
+	count = context->lazy_queue_count;
+
+	memcpy(&msgs_in, &context->msgs_in, sizeof(struct mosquitto_msg_data));
+	memcpy(&msgs_out, &context->msgs_out, sizeof(struct mosquitto_msg_data));
+	persist__lazy_msg_data_reset(&context->msgs_in);
+	persist__lazy_msg_data_reset(&context->msgs_out);
+
+	for(uint64_t i=0; i<count; i++){
+		rc = persist__lazy_client_msg_load(first + i);
+		if(rc){
+			log__printf(NULL, MOSQ_LOG_ERR, "Error: Unable to load queued messages for client %s from persistent database.", context->id);
+			break;
+		}
+	}
+
+	persist__lazy_queue_merge(&context->msgs_in, &msgs_in);
+	persist__lazy_queue_merge(&context->msgs_out, &msgs_out);
+
+	log__printf(NULL, MOSQ_LOG_DEBUG, "Loaded %ld queued messages for client %s from persistent database.", (long)count, context->id);
+	persist__lazy_queue_drop(context);
+
+	return rc;
+}
+
+
+/* Add client message record `index` to the run belonging to `context`. A
+ * context can only have one run, so records that aren't contiguous with it
+ * are loaded straight away, along with the run so far. */
+static int persist__lazy_queue_add(struct mosquitto *context, uint64_t index)
+{
+	int rc;
+
+	if(context->lazy_queue_count > 0
+			&& context->lazy_queue_first + context->lazy_queue_count == index){
+
+		context->lazy_queue_count++;
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	if(context->lazy_queue_count == 0
+			&& context->msgs_in.inflight == NULL && context->msgs_in.queued == NULL
+			&& context->msgs_out.inflight == NULL && context->msgs_out.queued == NULL){
+
+		context->lazy_queue_first = index;
+		context->lazy_queue_count = 1;
+		context->lazy_queue_next_first = UINT64_MAX;
+		lazy_pending++;
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	rc = persist__lazy_queue_load(context);
+	if(rc == MOSQ_ERR_SUCCESS){
+		rc = persist__lazy_client_msg_load(index);
+	}
+	return rc;
+}
+
+
+/* Called once a save has succeeded. Every unloaded run was copied into the
+ * new file, so switch over to it and let the old one go. */
+void persist__lazy_reopen(void)
+{
+	struct persist__v7 v7;
+	struct mosquitto *context, *ctxt_tmp;
+	FILE *fptr;
+	int rc = MOSQ_ERR_ERRNO;
+
+	if(lazy_pending == 0){
+		return;
+	}
+
+	fptr = mosquitto_fopen(db.config->persistence_filepath, "rb", true);
+	if(fptr){
+		rc = persist__v7_open(fptr, &v7);
+		fclose(fptr);
+	}
+	if(rc){
+		log__printf(NULL, MOSQ_LOG_WARNING, "Warning: Unable to reopen persistent database, unloaded client queues will be kept in memory.");
+	}
+
+	HASH_ITER(hh_id, db.contexts_by_id, context, ctxt_tmp){
+		if(context->lazy_queue_count == 0){
+			continue;
+		}
+		if(rc){
+			persist__lazy_queue_load(context);
+		}else if(context->lazy_queue_next_first == UINT64_MAX){
+			/* Not written to the new file */
+			persist__lazy_queue_drop(context);
+		}else{
+			context->lazy_queue_first = context->lazy_queue_next_first;
+			context->lazy_queue_next_first = UINT64_MAX;
+		}
+	}
+
+	if(rc == MOSQ_ERR_SUCCESS){
+		if(lazy_pending > 0){
+			persist__v7_close(&lazy_v7);
+			lazy_v7 = v7;
+			persist__v7_random_access(&lazy_v7);
+		}else{
+			persist__v7_close(&v7);
+		}
+	}
+}
+
+
+/* v7 files are restored a table at a time, in dependency order. */
+static int persist__restore_v7(FILE *db_fptr)
+{
+	struct persist__v7 v7_local;
+	struct persist__v7 *v7 = &v7_local;
+	struct PF_cfg cfg_chunk;
+	uint64_t count;
+	long deferred = 0;
+	bool lazy = false;
+	int rc;
+
+	rc = persist__v7_open(db_fptr, v7);
+	if(rc){
+		log__printf(NULL, MOSQ_LOG_ERR, "Error: Unable to restore persistent database, file is corrupt.");
+		return rc;
+	}
+
+	/* Lazy queues need to find base messages by binary search */
+	if(db.config->persistence_lazy_queues && persist__v7_base_msgs_sorted(v7)){
+		persist__lazy_close();
+		lazy_v7 = v7_local;
+		v7 = &lazy_v7;
+		lazy = true;
+		lazy_restoring = true;
+	}
+
+	if(persist__v7_count(v7, DB_CHUNK_CFG) > 0){
+		memset(&cfg_chunk, 0, sizeof(struct PF_cfg));
+		rc = persist__chunk_cfg_read_v7(v7, &cfg_chunk);
+		if(rc == MOSQ_ERR_SUCCESS){
+			rc = persist__cfg_restore(&cfg_chunk);
+		}
+		if(rc){
+			goto cleanup;
+		}
+	}
+
+	/* In lazy mode, base messages are loaded as they are needed */
+	count = lazy ? 0 : persist__v7_count(v7, DB_CHUNK_BASE_MSG);
+	for(uint64_t i=0; i<count; i++){
+		struct P_base_msg chunk;
+
+		memset(&chunk, 0, sizeof(struct P_base_msg));
+		rc = persist__chunk_base_msg_read_v7(v7, i, &chunk, true);
+		if(rc == MOSQ_ERR_SUCCESS){
+			rc = persist__base_msg_restore(&chunk);
+		}
+		if(rc){
+			goto cleanup;
+		}
+	}
+
+	count = persist__v7_count(v7, DB_CHUNK_CLIENT);
+	for(uint64_t i=0; i<count; i++){
+		struct P_client chunk;
+
+		memset(&chunk, 0, sizeof(struct P_client));
+		rc = persist__chunk_client_read_v7(v7, i, &chunk);
+		if(rc < 0){
+			log__printf(NULL, MOSQ_LOG_WARNING, "Warning: Empty client entry found in persistence database, it may be corrupt.");
+			continue;
+		}else if(rc == MOSQ_ERR_SUCCESS){
+			rc = persist__client_restore(&chunk);
+		}
+		if(rc){
+			goto cleanup;
+		}
+	}
+
+	count = persist__v7_count(v7, DB_CHUNK_CLIENT_MSG);
+	for(uint64_t i=0; i<count; i++){
+		struct P_client_msg chunk;
+
+		memset(&chunk, 0, sizeof(struct P_client_msg));
+		rc = persist__chunk_client_msg_read_v7(v7, i, &chunk);
+		if(rc){
+			goto cleanup;
+		}
+		if(lazy){
+			struct mosquitto *context = persist__find_or_add_context(chunk.clientid, 0);
+			if(context){
+				rc = persist__lazy_queue_add(context, i);
+				deferred++;
+			}
+		}else{
+			rc = persist__client_msg_restore(&chunk);
+			client_msg_count++;
+		}
+		mosquitto_FREE(chunk.clientid);
+		if(rc){
+			goto cleanup;
+		}
+	}
+
+	count = persist__v7_count(v7, DB_CHUNK_SUB);
+	for(uint64_t i=0; i<count; i++){
+		struct P_sub chunk;
+
+		memset(&chunk, 0, sizeof(struct P_sub));
+		rc = persist__chunk_sub_read_v7(v7, i, &chunk);
+		if(rc == MOSQ_ERR_SUCCESS){
+			rc = persist__sub_restore(&chunk);
+		}
+		if(rc){
+			goto cleanup;
+		}
+	}
+
+	count = persist__v7_count(v7, DB_CHUNK_RETAIN);
+	for(uint64_t i=0; i<count; i++){
+		struct P_retain chunk;
+
+		memset(&chunk, 0, sizeof(struct P_retain));
+		rc = persist__chunk_retain_read_v7(v7, i, &chunk);
+		if(rc == MOSQ_ERR_SUCCESS && lazy){
+			rc = persist__lazy_base_msg_load(chunk.F.store_id);
+		}
+		if(rc == MOSQ_ERR_SUCCESS){
+			rc = persist__retain_restore(&chunk);
+		}
+		if(rc){
+			goto cleanup;
+		}
 	}
 
+cleanup:
+	if(lazy){
+		lazy_restoring = false;
+		if(rc || lazy_pending == 0){
+			persist__lazy_close();
+		}else{
+			persist__v7_random_access(v7);
+			log__printf(NULL, MOSQ_LOG_INFO, "Deferred loading of %ld client messages", deferred);
+		}
+	}else{
+		persist__v7_close(v7);
+	}
 	return rc;
 }
 
@@ -416,7 +859,116 @@ int persist__chunk_header_read(FILE *db_fptr, uint32_t *chunk, uint32_t *length)
 }
 
 
-int persist__restore(void)
+char *persist__retain_log_path(void)
+{
+	char *path;
+	size_t len;
+
+	len = strlen(db.config->persistence_filepath) + strlen(".retain") + 1;
+	path = mosquitto_malloc(len);
+	if(path){
+		snprintf(path, len, "%s.retain", db.config->persistence_filepath);
+	}
+	return path;
+}
+
+
+/* Replay the retain log, see persist.h. A partly written final entry is
+ * ignored. */
+static int persist__retain_log_restore(void)
+{
+	FILE *fptr;
+	char *path;
+	char *topic;
+	char header[15];
+	uint32_t crc, version;
+	uint32_t chunk, length;
+	unsigned long records = 0, sets = 0, clears = 0;
+	struct P_base_msg msg_chunk;
+	struct P_retain retain_chunk;
+	struct mosquitto__base_msg *base_msg;
+	int rc = MOSQ_ERR_SUCCESS;
+
+	path = persist__retain_log_path();
+	if(path == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	fptr = mosquitto_fopen(path, "rb", true);
+	if(fptr == NULL){
+		mosquitto_FREE(path);
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	if(fread(header, 1, 15, fptr) != 15 || memcmp(header, magic, 15)
+			|| fread(&crc, 1, sizeof(uint32_t), fptr) != sizeof(uint32_t)
+			|| fread(&version, 1, sizeof(uint32_t), fptr) != sizeof(uint32_t)
+			|| ntohl(version) != 6){
+
+		log__printf(NULL, MOSQ_LOG_ERR, "Error: Unable to restore retain log %s. Unrecognised file format.", path);
+		fclose(fptr);
+		mosquitto_FREE(path);
+		return MOSQ_ERR_INVAL;
+	}
+
+	while(persist__chunk_header_read_v56(fptr, &chunk, &length) == MOSQ_ERR_SUCCESS){
+		if(chunk == DB_CHUNK_BASE_MSG){
+			memset(&msg_chunk, 0, sizeof(struct P_base_msg));
+			if(persist__chunk_base_msg_read_v56(fptr, &msg_chunk, length)){
+				log__printf(NULL, MOSQ_LOG_WARNING, "Warning: Retain log %s is truncated, ignoring the final entry.", path);
+				break;
+			}
+			topic = mosquitto_strdup(msg_chunk.topic);
+			if(topic == NULL){
+				rc = MOSQ_ERR_NOMEM;
+			}else{
+				memset(&retain_chunk, 0, sizeof(struct P_retain));
+				retain_chunk.F.store_id = msg_chunk.F.store_id;
+				rc = persist__base_msg_restore(&msg_chunk);
+			}
+			if(rc == MOSQ_ERR_SUCCESS){
+				HASH_FIND(hh, db.msg_store, &retain_chunk.F.store_id, sizeof(dbid_t), base_msg);
+				if(base_msg){
+					rc = persist__retain_restore(&retain_chunk);
+					base_msg->retain_logged = true;
+					sets++;
+				}else{
+					/* Expired, so replaces any earlier entry with nothing */
+					mosquitto_persist_retain_msg_delete(topic);
+				}
+			}
+			mosquitto_FREE(topic);
+		}else if(chunk == DB_CHUNK_RETAIN_CLEAR){
+			if(length == 0 || length > UINT16_MAX
+					|| persist__read_string_len(fptr, &topic, (uint16_t)length)){
+
+				log__printf(NULL, MOSQ_LOG_WARNING, "Warning: Retain log %s is truncated, ignoring the final entry.", path);
+				break;
+			}
+			mosquitto_persist_retain_msg_delete(topic);
+			mosquitto_FREE(topic);
+			clears++;
+		}else{
+			if(fseek(fptr, length, SEEK_CUR) < 0){
+				break;
+			}
+		}
+		if(rc){
+			break;
+		}
+		records++;
+	}
+	fclose(fptr);
+
+	if(rc == MOSQ_ERR_SUCCESS){
+		log__printf(NULL, MOSQ_LOG_INFO, "Replayed %lu retain log entries from %s", records, path);
+		persist__retain_log_restored(records, sets > clears ? sets - clears : 0);
+	}
+	mosquitto_FREE(path);
+	return rc;
+}
+
+
+static int persist__restore_file(void)
 {
 	FILE *fptr;
 	char header[15];
@@ -428,19 +980,6 @@ int persist__restore(void)
 	char *err;
 	struct PF_cfg cfg_chunk;
 
-	assert(db.config);
-
-	if(!db.config->persistence || db.config->persistence_filepath == NULL){
-		return MOSQ_ERR_SUCCESS;
-	}
-
-	db.msg_store = NULL;
-	base_msg_count = 0;
-	retained_count = 0;
-	client_count = 0;
-	subscription_count = 0;
-	client_msg_count = 0;
-
 	fptr = mosquitto_fopen(db.config->persistence_filepath, "rb", true);
 	if(fptr == NULL){
 		return MOSQ_ERR_SUCCESS;
@@ -462,7 +1001,10 @@ int persist__restore(void)
 		 * Is your DB change still compatible with previous versions?
 		 */
 		if(db_version != MOSQ_DB_VERSION){
-			if(db_version == 5){
+			if(db_version == 6){
+				/* v7 replaced the stream of chunks with a directory of
+				 * record tables and heaps */
+			}else if(db_version == 5){
 				/* Addition of username and listener_port to client chunk in v6 */
 			}else if(db_version == 4){
 			}else if(db_version == 3){
@@ -476,7 +1018,15 @@ int persist__restore(void)
 			}
 		}
 
-		while(persist__chunk_header_read(fptr, &chunk, &length) == MOSQ_ERR_SUCCESS){
+		if(db_version == 7){
+			rc = persist__restore_v7(fptr);
+			if(rc){
+				fclose(fptr);
+				return rc;
+			}
+		}
+
+		while(db_version < 7 && persist__chunk_header_read(fptr, &chunk, &length) == MOSQ_ERR_SUCCESS){
 			switch(chunk){
 				case DB_CHUNK_CFG:
 					if(db_version == 6 || db_version == 5){
@@ -492,13 +1042,11 @@ int persist__restore(void)
 							return rc;
 						}
 					}
-					if(cfg_chunk.dbid_size != sizeof(dbid_t)){
-						log__printf(NULL, MOSQ_LOG_ERR, "Error: Incompatible database configuration (dbid size is %d bytes, expected %lu)",
-								cfg_chunk.dbid_size, (unsigned long)sizeof(dbid_t));
+					rc = persist__cfg_restore(&cfg_chunk);
+					if(rc){
 						fclose(fptr);
-						return MOSQ_ERR_INVAL;
+						return rc;
 					}
-					db.last_db_id = cfg_chunk.last_db_id;
 					break;
 
 				case DB_CHUNK_BASE_MSG:
@@ -574,6 +1122,43 @@ error:
 }
 
 
+int persist__restore(void)
+{
+	long log_retained;
+	int rc;
+
+	assert(db.config);
+
+	if(!db.config->persistence || db.config->persistence_filepath == NULL){
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	db.msg_store = NULL;
+	base_msg_count = 0;
+	retained_count = 0;
+	client_count = 0;
+	subscription_count = 0;
+	client_msg_count = 0;
+
+	rc = persist__retain_log_restore();
+	if(rc){
+		return rc;
+	}
+	log_retained = retained_count;
+
+	rc = persist__restore_file();
+
+	/* Everything restored so far is already on disk */
+	if(db.config->persistence_incremental_retain && retained_count > log_retained){
+		/* Retained messages from the main file need moving to the retain log */
+		persist__retain_log_compact_next();
+	}
+	retain__dirty_clear();
+
+	return rc;
+}
+
+
 static int persist__restore_sub(const struct mosquitto_subscription *sub)
 {
 	struct mosquitto *context;
@@ -0,0 +1,474 @@
+/*
+Copyright (c) 2010-2021 Roger Light <roger@atchoo.org>
+
+All rights reserved. This program and the accompanying materials
+are made available under the terms of the Eclipse Public License 2.0
+and Eclipse Distribution License v1.0 which accompany this distribution.
+
+The Eclipse Public License is available at
+   https://www.eclipse.org/legal/epl-2.0/
+and the Eclipse Distribution License is available at
+  http://www.eclipse.org/org/documents/edl-v10.php.
+
+SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+
+Contributors:
+   Roger Light - initial implementation and documentation.
+*/
+
+
+#include "config.h"
+
+#ifdef WITH_PERSISTENCE
+
+#ifndef WIN32
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "mosquitto_broker_internal.h"
+#include "mosquitto/mqtt_protocol.h"
+#include "persist.h"
+#include "property_mosq.h"
+#include "util_mosq.h"
+
+
+static int v7__load(FILE *db_fptr, struct persist__v7 *v7)
+{
+	long len;
+
+	if(fseek(db_fptr, 0, SEEK_END) < 0){
+		return MOSQ_ERR_ERRNO;
+	}
+	len = ftell(db_fptr);
+	if(len < 0){
+		return MOSQ_ERR_ERRNO;
+	}
+	if((unsigned long)len < PERSIST_V7_DIR_OFFSET + sizeof(struct PF_v7_header)){
+		return MOSQ_ERR_INVAL;
+	}
+	v7->len = (size_t)len;
+
+#ifndef WIN32
+	void *data = mmap(NULL, v7->len, PROT_READ, MAP_PRIVATE, fileno(db_fptr), 0);
+	if(data != MAP_FAILED){
+#  ifdef MADV_SEQUENTIAL
+		madvise(data, v7->len, MADV_SEQUENTIAL);
+#  endif
+		v7->data = data;
+		v7->mapped = true;
+		return MOSQ_ERR_SUCCESS;
+	}
+#endif
+
+	/* No mmap available, read the whole file instead */
+	uint8_t *buf = mosquitto_malloc(v7->len);
+	if(buf == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	if(fseek(db_fptr, 0, SEEK_SET) < 0 || fread(buf, 1, v7->len, db_fptr) != v7->len){
+		mosquitto_FREE(buf);
+		return MOSQ_ERR_ERRNO;
+	}
+	v7->data = buf;
+	v7->mapped = false;
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+int persist__v7_open(FILE *db_fptr, struct persist__v7 *v7)
+{
+	struct PF_v7_header header;
+	struct PF_v7_section section;
+	const uint8_t *dir;
+	uint32_t section_count;
+	int rc;
+
+	memset(v7, 0, sizeof(struct persist__v7));
+
+	rc = v7__load(db_fptr, v7);
+	if(rc){
+		return rc;
+	}
+
+	memcpy(&header, &v7->data[PERSIST_V7_DIR_OFFSET], sizeof(struct PF_v7_header));
+	section_count = ntohl(header.section_count);
+	dir = &v7->data[PERSIST_V7_DIR_OFFSET + sizeof(struct PF_v7_header)];
+	if((uint64_t)section_count*sizeof(struct PF_v7_section) > v7->len - (size_t)(dir - v7->data)){
+		persist__v7_close(v7);
+		return MOSQ_ERR_INVAL;
+	}
+
+	for(uint32_t i=0; i<section_count; i++){
+		memcpy(&section, &dir[i*sizeof(struct PF_v7_section)], sizeof(struct PF_v7_section));
+		section.type = ntohl(section.type);
+		section.record_size = ntohl(section.record_size);
+
+		if(section.offset > v7->len || section.length > v7->len - section.offset){
+			persist__v7_close(v7);
+			return MOSQ_ERR_INVAL;
+		}
+		if(section.count > 0 && (section.record_size == 0
+					|| section.count > section.length / section.record_size)){
+
+			persist__v7_close(v7);
+			return MOSQ_ERR_INVAL;
+		}
+		if(section.type > DB_SECTION_MAX){
+			/* Unknown section from a newer writer, it can be skipped */
+			continue;
+		}
+		v7->sections[section.type] = section;
+	}
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+void persist__v7_close(struct persist__v7 *v7)
+{
+	if(v7->data){
+#ifndef WIN32
+		if(v7->mapped){
+			munmap((void *)v7->data, v7->len);
+		}else
+#endif
+		{
+			mosquitto_free((void *)v7->data);
+		}
+	}
+	memset(v7, 0, sizeof(struct persist__v7));
+}
+
+
+/* Tell the kernel the mapping will now be read a record at a time, rather
+ * than from start to end. */
+void persist__v7_random_access(const struct persist__v7 *v7)
+{
+#if !defined(WIN32) && defined(MADV_RANDOM)
+	if(v7->mapped){
+		madvise((void *)v7->data, v7->len, MADV_RANDOM);
+	}
+#else
+	UNUSED(v7);
+#endif
+}
+
+
+uint64_t persist__v7_count(const struct persist__v7 *v7, uint32_t type)
+{
+	if(type > DB_SECTION_MAX){
+		return 0;
+	}
+	return v7->sections[type].count;
+}
+
+
+static dbid_t v7__base_msg_store_id(const struct persist__v7 *v7, uint64_t index)
+{
+	const struct PF_v7_section *section = &v7->sections[DB_CHUNK_BASE_MSG];
+	dbid_t store_id = 0;
+
+	/* store_id is the first member of the record */
+	memcpy(&store_id, &v7->data[section->offset + index*section->record_size], sizeof(dbid_t));
+	return store_id;
+}
+
+
+/* The broker writes the base message table in store_id order. Files written
+ * by anything else must be checked with this before using
+ * persist__v7_base_msg_find(). */
+bool persist__v7_base_msgs_sorted(const struct persist__v7 *v7)
+{
+	const struct PF_v7_section *section = &v7->sections[DB_CHUNK_BASE_MSG];
+
+	if(section->count > 0 && section->record_size < sizeof(dbid_t)){
+		return false;
+	}
+	for(uint64_t i=1; i<section->count; i++){
+		if(v7__base_msg_store_id(v7, i-1) >= v7__base_msg_store_id(v7, i)){
+			return false;
+		}
+	}
+	return true;
+}
+
+
+int persist__v7_base_msg_find(const struct persist__v7 *v7, dbid_t store_id, uint64_t *index)
+{
+	uint64_t lo = 0, hi = v7->sections[DB_CHUNK_BASE_MSG].count;
+	uint64_t mid;
+	dbid_t id;
+
+	while(lo < hi){
+		mid = lo + (hi - lo)/2;
+		id = v7__base_msg_store_id(v7, mid);
+		if(id == store_id){
+			*index = mid;
+			return MOSQ_ERR_SUCCESS;
+		}else if(id < store_id){
+			lo = mid + 1;
+		}else{
+			hi = mid;
+		}
+	}
+	return MOSQ_ERR_NOT_FOUND;
+}
+
+
+/* Copy record `index` of table `type` into `rec`. Records written by an older
+ * version may be shorter than the current struct, the remainder is zeroed. */
+static int v7__record(const struct persist__v7 *v7, uint32_t type, uint64_t index, void *rec, size_t rec_len)
+{
+	const struct PF_v7_section *section = &v7->sections[type];
+	size_t len;
+
+	if(index >= section->count){
+		return MOSQ_ERR_INVAL;
+	}
+	len = section->record_size < rec_len ? section->record_size : rec_len;
+	memset(rec, 0, rec_len);
+	memcpy(rec, &v7->data[section->offset + index*section->record_size], len);
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+static const uint8_t *v7__heap(const struct persist__v7 *v7, uint32_t type, uint64_t offset, uint64_t len)
+{
+	const struct PF_v7_section *section = &v7->sections[type];
+
+	if(offset > section->length || len > section->length - offset){
+		return NULL;
+	}
+	return &v7->data[section->offset + offset];
+}
+
+
+static int v7__string(const struct persist__v7 *v7, uint64_t offset, uint16_t len, char **str)
+{
+	const uint8_t *src;
+	char *s;
+
+	*str = NULL;
+	if(len == 0){
+		return MOSQ_ERR_SUCCESS;
+	}
+	src = v7__heap(v7, DB_SECTION_STRINGS, offset, len);
+	if(src == NULL){
+		return MOSQ_ERR_INVAL;
+	}
+	s = mosquitto_malloc(len+1U);
+	if(s == NULL){
+		log__printf(NULL, MOSQ_LOG_ERR, "Error: Out of memory.");
+		return MOSQ_ERR_NOMEM;
+	}
+	memcpy(s, src, len);
+	s[len] = '\0';
+	*str = s;
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+int persist__chunk_cfg_read_v7(const struct persist__v7 *v7, struct PF_cfg *chunk)
+{
+	return v7__record(v7, DB_CHUNK_CFG, 0, chunk, sizeof(struct PF_cfg));
+}
+
+
+int persist__chunk_client_read_v7(const struct persist__v7 *v7, uint64_t index, struct P_client *chunk)
+{
+	struct PF_v7_client rec;
+	int rc;
+
+	rc = v7__record(v7, DB_CHUNK_CLIENT, index, &rec, sizeof(struct PF_v7_client));
+	if(rc){
+		return rc;
+	}
+
+	chunk->F.session_expiry_time = rec.session_expiry_time;
+	chunk->F.session_expiry_interval = ntohl(rec.session_expiry_interval);
+	chunk->F.last_mid = ntohs(rec.last_mid);
+	chunk->F.id_len = ntohs(rec.id_len);
+	chunk->F.listener_port = ntohs(rec.listener_port);
+	chunk->F.username_len = ntohs(rec.username_len);
+
+	if(chunk->F.id_len == 0){
+		return -1;
+	}
+	rc = v7__string(v7, rec.str_offset, chunk->F.id_len, &chunk->clientid);
+	if(rc){
+		return rc;
+	}
+	rc = v7__string(v7, rec.str_offset + chunk->F.id_len, chunk->F.username_len, &chunk->username);
+	if(rc){
+		mosquitto_FREE(chunk->clientid);
+		return rc;
+	}
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+int persist__chunk_client_msg_read_v7(const struct persist__v7 *v7, uint64_t index, struct P_client_msg *chunk)
+{
+	struct PF_v7_client_msg rec;
+	int rc;
+
+	rc = v7__record(v7, DB_CHUNK_CLIENT_MSG, index, &rec, sizeof(struct PF_v7_client_msg));
+	if(rc){
+		return rc;
+	}
+
+	chunk->F.store_id = rec.store_id;
+	chunk->F.mid = ntohs(rec.mid);
+	chunk->F.id_len = ntohs(rec.id_len);
+	chunk->F.qos = rec.qos;
+	chunk->F.state = rec.state;
+	chunk->F.retain_dup = rec.retain_dup;
+	chunk->F.direction = rec.direction;
+	chunk->subscription_identifier = ntohl(rec.subscription_identifier);
+
+	return v7__string(v7, rec.id_offset, chunk->F.id_len, &chunk->clientid);
+}
+
+
+int persist__chunk_base_msg_read_v7(const struct persist__v7 *v7, uint64_t index, struct P_base_msg *chunk, bool with_payload)
+{
+	struct PF_v7_base_msg rec;
+	struct mosquitto__packet_in prop_packet;
+	const uint8_t *data;
+	uint64_t offset;
+	uint32_t proplen;
+	int rc;
+
+	rc = v7__record(v7, DB_CHUNK_BASE_MSG, index, &rec, sizeof(struct PF_v7_base_msg));
+	if(rc){
+		return rc;
+	}
+
+	chunk->F.store_id = rec.store_id;
+	chunk->F.expiry_time = rec.expiry_time;
+	chunk->F.payloadlen = ntohl(rec.payloadlen);
+	chunk->F.source_mid = ntohs(rec.source_mid);
+	chunk->F.source_id_len = ntohs(rec.source_id_len);
+	chunk->F.source_username_len = ntohs(rec.source_username_len);
+	chunk->F.topic_len = ntohs(rec.topic_len);
+	chunk->F.source_port = ntohs(rec.source_port);
+	chunk->F.qos = rec.qos;
+	chunk->F.retain = rec.retain;
+	proplen = ntohl(rec.proplen);
+
+	if(chunk->F.payloadlen > MQTT_MAX_PAYLOAD || proplen > MQTT_MAX_PAYLOAD){
+		return MOSQ_ERR_INVAL;
+	}
+
+	offset = rec.str_offset;
+	rc = v7__string(v7, offset, chunk->F.source_id_len, &chunk->source.id);
+	if(rc){
+		goto error;
+	}
+	offset += chunk->F.source_id_len;
+	rc = v7__string(v7, offset, chunk->F.source_username_len, &chunk->source.username);
+	if(rc){
+		goto error;
+	}
+	offset += chunk->F.source_username_len;
+	rc = v7__string(v7, offset, chunk->F.topic_len, &chunk->topic);
+	if(rc){
+		goto error;
+	}
+
+	if(with_payload == false){
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	data = v7__heap(v7, DB_SECTION_PAYLOADS, rec.data_offset, (uint64_t)chunk->F.payloadlen + proplen);
+	if(data == NULL){
+		rc = MOSQ_ERR_INVAL;
+		goto error;
+	}
+	if(chunk->F.payloadlen > 0){
+		chunk->payload = mosquitto_malloc(chunk->F.payloadlen+1);
+		if(chunk->payload == NULL){
+			rc = MOSQ_ERR_NOMEM;
+			goto error;
+		}
+		memcpy(chunk->payload, data, chunk->F.payloadlen);
+		/* Ensure zero terminated regardless of contents */
+		((uint8_t *)chunk->payload)[chunk->F.payloadlen] = 0;
+	}
+
+	if(proplen > 0){
+		memset(&prop_packet, 0, sizeof(struct mosquitto__packet_in));
+		/* Only read from, so the mapping can be used directly */
+		prop_packet.payload = (uint8_t *)&data[chunk->F.payloadlen];
+		prop_packet.remaining_length = proplen;
+		rc = property__read_all(CMD_PUBLISH, &prop_packet, &chunk->properties);
+		if(rc){
+			goto error;
+		}
+	}
+
+	return MOSQ_ERR_SUCCESS;
+error:
+	mosquitto_FREE(chunk->payload);
+	mosquitto_FREE(chunk->source.id);
+	mosquitto_FREE(chunk->source.username);
+	mosquitto_FREE(chunk->topic);
+	return rc;
+}
+
+
+int persist__chunk_retain_read_v7(const struct persist__v7 *v7, uint64_t index, struct P_retain *chunk)
+{
+	struct PF_v7_retain rec;
+	int rc;
+
+	rc = v7__record(v7, DB_CHUNK_RETAIN, index, &rec, sizeof(struct PF_v7_retain));
+	if(rc){
+		return rc;
+	}
+	chunk->F.store_id = rec.store_id;
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+int persist__chunk_sub_read_v7(const struct persist__v7 *v7, uint64_t index, struct P_sub *chunk)
+{
+	struct PF_v7_sub rec;
+	int rc;
+
+	rc = v7__record(v7, DB_CHUNK_SUB, index, &rec, sizeof(struct PF_v7_sub));
+	if(rc){
+		return rc;
+	}
+
+	chunk->F.identifier = ntohl(rec.identifier);
+	chunk->F.id_len = ntohs(rec.id_len);
+	chunk->F.topic_len = ntohs(rec.topic_len);
+	chunk->F.qos = rec.qos;
+	chunk->F.options = rec.options;
+
+	rc = v7__string(v7, rec.id_offset, chunk->F.id_len, &chunk->clientid);
+	if(rc){
+		return rc;
+	}
+	rc = v7__string(v7, rec.topic_offset, chunk->F.topic_len, &chunk->topic);
+	if(rc){
+		mosquitto_FREE(chunk->clientid);
+		return rc;
+	}
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+#endif
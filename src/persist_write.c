@@ -27,22 +27,40 @@ Contributors:
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <time.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
 
 #include "mosquitto_broker_internal.h"
+#include "packet_mosq.h"
 #include "persist.h"
+#include "property_mosq.h"
 #include "util_mosq.h"
 
+struct persist__lazy_ids {
+	dbid_t *ids;
+	size_t count;
+	size_t size;
+};
+
+struct persist__spilled {
+	const struct spillover_item **items;
+	size_t count;
+	size_t size;
+};
 
-static int persist__client_messages_save(FILE *db_fptr, struct mosquitto *context, struct mosquitto__client_msg *queue)
+
+static int persist__client_messages_save(struct persist__v7_writer *writer, struct mosquitto *context, struct mosquitto__client_msg *queue)
 {
 	struct P_client_msg chunk;
 	struct mosquitto__client_msg *cmsg;
 	int rc;
 
-	assert(db_fptr);
+	assert(writer);
 	assert(context);
 
 	cmsg = queue;
@@ -69,7 +87,7 @@ static int persist__client_messages_save(FILE *db_fptr, struct mosquitto *contex
 		chunk.clientid = context->id;
 		chunk.subscription_identifier = cmsg->data.subscription_identifier;
 
-		rc = persist__chunk_client_msg_write_v6(db_fptr, &chunk);
+		rc = persist__chunk_client_msg_write_v7(writer, &chunk);
 		if(rc){
 			return rc;
 		}
@@ -81,68 +99,334 @@ static int persist__client_messages_save(FILE *db_fptr, struct mosquitto *contex
 }
 
 
-static int persist__message_store_save(FILE *db_fptr)
+static bool persist__base_msg_is_saved(const struct mosquitto__base_msg *base_msg)
+{
+	if(base_msg->ref_count < 1 || base_msg->data.topic == NULL){
+		return false;
+	}
+	if(!strncmp(base_msg->data.topic, "$SYS", 4)
+			&& base_msg->ref_count <= 1 && base_msg->dest_id_count == 0){
+
+		/* $SYS messages that are only retained shouldn't be persisted. */
+		return false;
+	}
+	return true;
+}
+
+
+/* True if `base_msg` is only held by the retain tree, and is already in the
+ * retain log, so needn't be written to the main file. */
+static bool persist__base_msg_retain_logged(const struct mosquitto__base_msg *base_msg)
+{
+	return db.config->persistence_incremental_retain
+			&& base_msg->retain_logged
+			&& base_msg->ref_count == 1;
+}
+
+
+static void persist__base_msg_chunk_fill(struct P_base_msg *chunk, const struct mosquitto__base_msg *base_msg)
+{
+	memset(chunk, 0, sizeof(struct P_base_msg));
+
+	if(!strncmp(base_msg->data.topic, "$SYS", 4)){
+		/* Don't save $SYS messages as retained otherwise they can give
+		 * misleading information when reloaded. They should still be saved
+		 * because a disconnected durable client may have them in their
+		 * queue. */
+		chunk->F.retain = 0;
+	}else{
+		chunk->F.retain = (uint8_t)base_msg->data.retain;
+	}
+
+	chunk->F.store_id = base_msg->data.store_id;
+	chunk->F.expiry_time = base_msg->data.expiry_time;
+	chunk->F.payloadlen = base_msg->data.payloadlen;
+	chunk->F.source_mid = base_msg->data.source_mid;
+	if(base_msg->data.source_id){
+		chunk->F.source_id_len = (uint16_t)strlen(base_msg->data.source_id);
+		chunk->source.id = base_msg->data.source_id;
+	}else{
+		chunk->F.source_id_len = 0;
+		chunk->source.id = NULL;
+	}
+	if(base_msg->data.source_username){
+		chunk->F.source_username_len = (uint16_t)strlen(base_msg->data.source_username);
+		chunk->source.username = base_msg->data.source_username;
+	}else{
+		chunk->F.source_username_len = 0;
+		chunk->source.username = NULL;
+	}
+
+	chunk->F.topic_len = (uint16_t)strlen(base_msg->data.topic);
+	chunk->topic = base_msg->data.topic;
+
+	if(base_msg->source_listener){
+		chunk->F.source_port = base_msg->source_listener->port;
+	}else{
+		chunk->F.source_port = 0;
+	}
+	chunk->F.qos = base_msg->data.qos;
+	chunk->payload = base_msg->data.payload;
+	chunk->properties = base_msg->data.properties;
+}
+
+
+static int persist__base_msg_write(struct persist__v7_writer *writer, const struct mosquitto__base_msg *base_msg)
 {
 	struct P_base_msg chunk;
+
+	persist__base_msg_chunk_fill(&chunk, base_msg);
+	return persist__chunk_message_store_write_v7(writer, &chunk);
+}
+
+
+static int persist__message_store_save(struct persist__v7_writer *writer)
+{
 	struct mosquitto__base_msg *base_msg, *base_msg_tmp;
 	int rc;
 
-	assert(db_fptr);
+	assert(writer);
 
 	base_msg = db.msg_store;
 	HASH_ITER(hh, db.msg_store, base_msg, base_msg_tmp){
-		if(base_msg->ref_count < 1 || base_msg->data.topic == NULL){
+		if(!persist__base_msg_is_saved(base_msg) || persist__base_msg_retain_logged(base_msg)){
 			continue;
 		}
 
-		memset(&chunk, 0, sizeof(struct P_base_msg));
+		rc = persist__base_msg_write(writer, base_msg);
+		if(rc){
+			return rc;
+		}
+	}
 
-		if(!strncmp(base_msg->data.topic, "$SYS", 4)){
-			if(base_msg->ref_count <= 1 && base_msg->dest_id_count == 0){
-				/* $SYS messages that are only retained shouldn't be persisted. */
-				continue;
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+/* Copy the client messages of `context` that are still only in the file
+ * loaded with persistence_lazy_queues. The base messages they refer to are
+ * collected in `ids` and copied by persist__lazy_base_msgs_save(). */
+static int persist__lazy_messages_save(struct persist__v7_writer *writer, struct mosquitto *context, struct persist__lazy_ids *ids)
+{
+	const struct persist__v7 *v7;
+	struct P_client_msg chunk;
+	dbid_t *newids;
+	int rc;
+
+	v7 = persist__lazy_file();
+	if(v7 == NULL || context->lazy_queue_count == 0){
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	if(ids->count + context->lazy_queue_count > ids->size){
+		newids = mosquitto_realloc(ids->ids, sizeof(dbid_t)*(ids->count + context->lazy_queue_count));
+		if(newids == NULL){
+			return MOSQ_ERR_NOMEM;
+		}
+		ids->ids = newids;
+		ids->size = ids->count + context->lazy_queue_count;
+	}
+
+	context->lazy_queue_next_first = writer->sections[DB_CHUNK_CLIENT_MSG].count;
+	for(uint64_t i=0; i<context->lazy_queue_count; i++){
+		memset(&chunk, 0, sizeof(struct P_client_msg));
+		rc = persist__chunk_client_msg_read_v7(v7, context->lazy_queue_first + i, &chunk);
+		if(rc){
+			return rc;
+		}
+		mosquitto_FREE(chunk.clientid);
+		chunk.clientid = context->id;
+		chunk.F.id_len = (uint16_t)strlen(context->id);
+
+		rc = persist__chunk_client_msg_write_v7(writer, &chunk);
+		if(rc){
+			return rc;
+		}
+		ids->ids[ids->count++] = chunk.F.store_id;
+	}
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+static int dbid__cmp(const void *a, const void *b)
+{
+	dbid_t ida = *(const dbid_t *)a;
+	dbid_t idb = *(const dbid_t *)b;
+
+	if(ida < idb){
+		return -1;
+	}else if(ida > idb){
+		return 1;
+	}else{
+		return 0;
+	}
+}
+
+
+/* Copy the base messages needed by the client messages copied by
+ * persist__lazy_messages_save() that haven't already been saved from memory. */
+static int persist__lazy_base_msgs_save(struct persist__v7_writer *writer, struct persist__lazy_ids *ids)
+{
+	const struct persist__v7 *v7;
+	struct mosquitto__base_msg *base_msg;
+	struct P_base_msg chunk;
+	uint64_t index;
+	int rc = MOSQ_ERR_SUCCESS;
+
+	v7 = persist__lazy_file();
+	if(v7 == NULL || ids->count == 0){
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	qsort(ids->ids, ids->count, sizeof(dbid_t), dbid__cmp);
+	for(size_t i=0; i<ids->count; i++){
+		if(i > 0 && ids->ids[i] == ids->ids[i-1]){
+			continue;
+		}
+		HASH_FIND(hh, db.msg_store, &ids->ids[i], sizeof(dbid_t), base_msg);
+		if(base_msg && persist__base_msg_is_saved(base_msg)){
+			if(persist__base_msg_retain_logged(base_msg)){
+				rc = persist__base_msg_write(writer, base_msg);
+				if(rc){
+					return rc;
+				}
 			}
-			/* Don't save $SYS messages as retained otherwise they can give
-			 * misleading information when reloaded. They should still be saved
-			 * because a disconnected durable client may have them in their
-			 * queue. */
-			chunk.F.retain = 0;
-		}else{
-			chunk.F.retain = (uint8_t)base_msg->data.retain;
+			continue;
+		}
+		if(persist__v7_base_msg_find(v7, ids->ids[i], &index)){
+			continue;
 		}
 
-		chunk.F.store_id = base_msg->data.store_id;
-		chunk.F.expiry_time = base_msg->data.expiry_time;
-		chunk.F.payloadlen = base_msg->data.payloadlen;
-		chunk.F.source_mid = base_msg->data.source_mid;
-		if(base_msg->data.source_id){
-			chunk.F.source_id_len = (uint16_t)strlen(base_msg->data.source_id);
-			chunk.source.id = base_msg->data.source_id;
-		}else{
-			chunk.F.source_id_len = 0;
-			chunk.source.id = NULL;
+		memset(&chunk, 0, sizeof(struct P_base_msg));
+		rc = persist__chunk_base_msg_read_v7(v7, index, &chunk, true);
+		if(rc == MOSQ_ERR_SUCCESS){
+			rc = persist__chunk_message_store_write_v7(writer, &chunk);
 		}
-		if(base_msg->data.source_username){
-			chunk.F.source_username_len = (uint16_t)strlen(base_msg->data.source_username);
-			chunk.source.username = base_msg->data.source_username;
-		}else{
-			chunk.F.source_username_len = 0;
-			chunk.source.username = NULL;
+		mosquitto_FREE(chunk.source.id);
+		mosquitto_FREE(chunk.source.username);
+		mosquitto_FREE(chunk.topic);
+		mosquitto_FREE(chunk.payload);
+		mosquitto_property_free_all(&chunk.properties);
+		if(rc){
+			return rc;
 		}
+	}
 
-		chunk.F.topic_len = (uint16_t)strlen(base_msg->data.topic);
-		chunk.topic = base_msg->data.topic;
+	return MOSQ_ERR_SUCCESS;
+}
 
-		if(base_msg->source_listener){
-			chunk.F.source_port = base_msg->source_listener->port;
-		}else{
-			chunk.F.source_port = 0;
+
+/* Save the client messages of `context` that are in the spillover store. The
+ * base messages they refer to are saved by persist__spilled_base_msgs_save(). */
+static int persist__spilled_messages_save(struct persist__v7_writer *writer, struct mosquitto *context, struct persist__spilled *spilled)
+{
+	const struct spillover_item *item;
+	const struct spillover_item **newitems;
+	struct mosquitto__client_msg cmsg;
+	struct P_client_msg chunk;
+	dbid_t store_id;
+	int rc;
+
+	if(context->spillover == NULL){
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	if(spilled->count + (size_t)context->spillover->count > spilled->size){
+		newitems = mosquitto_realloc(spilled->items, sizeof(struct spillover_item *)*(spilled->count + (size_t)context->spillover->count));
+		if(newitems == NULL){
+			return MOSQ_ERR_NOMEM;
+		}
+		spilled->items = newitems;
+		spilled->size = spilled->count + (size_t)context->spillover->count;
+	}
+
+	for(item = context->spillover->head; item; item = item->next){
+		memset(&cmsg, 0, sizeof(struct mosquitto__client_msg));
+		rc = spillover__item_read(item, &cmsg, &store_id, NULL);
+		if(rc){
+			return rc;
+		}
+
+		memset(&chunk, 0, sizeof(struct P_client_msg));
+		chunk.F.store_id = store_id;
+		chunk.F.mid = cmsg.data.mid;
+		chunk.F.id_len = (uint16_t)strlen(context->id);
+		chunk.F.qos = cmsg.data.qos;
+		chunk.F.retain_dup = (uint8_t)((cmsg.data.retain&0x0F)<<4);
+		chunk.F.direction = (uint8_t)cmsg.data.direction;
+		chunk.F.state = (uint8_t)cmsg.data.state;
+		chunk.clientid = context->id;
+		chunk.subscription_identifier = cmsg.data.subscription_identifier;
+
+		rc = persist__chunk_client_msg_write_v7(writer, &chunk);
+		if(rc){
+			return rc;
+		}
+		spilled->items[spilled->count++] = item;
+	}
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+static int spillover_item__cmp(const void *a, const void *b)
+{
+	const struct spillover_item *itema = *(const struct spillover_item * const *)a;
+	const struct spillover_item *itemb = *(const struct spillover_item * const *)b;
+
+	if(itema->store_id < itemb->store_id){
+		return -1;
+	}else if(itema->store_id > itemb->store_id){
+		return 1;
+	}else{
+		return 0;
+	}
+}
+
+
+/* Save the base messages needed by the client messages saved by
+ * persist__spilled_messages_save() that haven't already been saved, either
+ * from memory or by persist__lazy_base_msgs_save(). */
+static int persist__spilled_base_msgs_save(struct persist__v7_writer *writer, struct persist__spilled *spilled, struct persist__lazy_ids *lazy_ids)
+{
+	const struct persist__v7 *v7;
+	struct mosquitto__base_msg *base_msg;
+	struct mosquitto__client_msg cmsg;
+	dbid_t store_id;
+	uint64_t index;
+	int rc;
+
+	v7 = persist__lazy_file();
+	qsort(spilled->items, spilled->count, sizeof(struct spillover_item *), spillover_item__cmp);
+	for(size_t i=0; i<spilled->count; i++){
+		store_id = spilled->items[i]->store_id;
+		if(i > 0 && store_id == spilled->items[i-1]->store_id){
+			continue;
+		}
+		HASH_FIND(hh, db.msg_store, &store_id, sizeof(dbid_t), base_msg);
+		if(base_msg && persist__base_msg_is_saved(base_msg)){
+			if(persist__base_msg_retain_logged(base_msg)){
+				rc = persist__base_msg_write(writer, base_msg);
+				if(rc){
+					return rc;
+				}
+			}
+			continue;
 		}
-		chunk.F.qos = base_msg->data.qos;
-		chunk.payload = base_msg->data.payload;
-		chunk.properties = base_msg->data.properties;
+		if(v7 && lazy_ids->count > 0
+				&& bsearch(&store_id, lazy_ids->ids, lazy_ids->count, sizeof(dbid_t), dbid__cmp)
+				&& persist__v7_base_msg_find(v7, store_id, &index) == MOSQ_ERR_SUCCESS){
 
-		rc = persist__chunk_message_store_write_v6(db_fptr, &chunk);
+			continue;
+		}
+
+		rc = spillover__item_read(spilled->items[i], &cmsg, &store_id, &base_msg);
+		if(rc){
+			return rc;
+		}
+		rc = persist__base_msg_write(writer, base_msg);
+		db__msg_store_free(base_msg);
 		if(rc){
 			return rc;
 		}
@@ -152,13 +436,13 @@ static int persist__message_store_save(FILE *db_fptr)
 }
 
 
-static int persist__client_save(FILE *db_fptr)
+static int persist__client_save(struct persist__v7_writer *writer, struct persist__lazy_ids *lazy_ids, struct persist__spilled *spilled)
 {
 	struct mosquitto *context, *ctxt_tmp;
 	struct P_client chunk;
 	int rc;
 
-	assert(db_fptr);
+	assert(writer);
 
 	HASH_ITER(hh_id, db.contexts_by_id, context, ctxt_tmp){
 		memset(&chunk, 0, sizeof(struct P_client));
@@ -198,21 +482,28 @@ static int persist__client_save(FILE *db_fptr)
 				continue;
 			}
 
-			rc = persist__chunk_client_write_v6(db_fptr, &chunk);
+			rc = persist__chunk_client_write_v7(writer, &chunk);
 			if(rc){
 				return rc;
 			}
 
-			if(persist__client_messages_save(db_fptr, context, context->msgs_in.inflight)){
+			/* Messages still on disk are older than those in memory */
+			if(persist__lazy_messages_save(writer, context, lazy_ids)){
+				return 1;
+			}
+			if(persist__client_messages_save(writer, context, context->msgs_in.inflight)){
+				return 1;
+			}
+			if(persist__client_messages_save(writer, context, context->msgs_in.queued)){
 				return 1;
 			}
-			if(persist__client_messages_save(db_fptr, context, context->msgs_in.queued)){
+			if(persist__client_messages_save(writer, context, context->msgs_out.inflight)){
 				return 1;
 			}
-			if(persist__client_messages_save(db_fptr, context, context->msgs_out.inflight)){
+			if(persist__client_messages_save(writer, context, context->msgs_out.queued)){
 				return 1;
 			}
-			if(persist__client_messages_save(db_fptr, context, context->msgs_out.queued)){
+			if(persist__spilled_messages_save(writer, context, spilled)){
 				return 1;
 			}
 		}
@@ -222,7 +513,7 @@ static int persist__client_save(FILE *db_fptr)
 }
 
 
-static int persist__subs_save(FILE *db_fptr, struct mosquitto__subhier *node, const char *topic, int level)
+static int persist__subs_save(struct persist__v7_writer *writer, struct mosquitto__subhier *node, const char *topic, int level)
 {
 	struct mosquitto__subhier *subhier, *subhier_tmp;
 	struct mosquitto__subleaf *sub;
@@ -258,7 +549,7 @@ static int persist__subs_save(FILE *db_fptr, struct mosquitto__subhier *node, co
 			sub_chunk.clientid = sub->context->id;
 			sub_chunk.topic = thistopic;
 
-			rc = persist__chunk_sub_write_v6(db_fptr, &sub_chunk);
+			rc = persist__chunk_sub_write_v7(writer, &sub_chunk);
 			if(rc){
 				mosquitto_FREE(thistopic);
 				return rc;
@@ -268,26 +559,26 @@ static int persist__subs_save(FILE *db_fptr, struct mosquitto__subhier *node, co
 	}
 
 	HASH_ITER(hh, node->children, subhier, subhier_tmp){
-		persist__subs_save(db_fptr, subhier, thistopic, level+1);
+		persist__subs_save(writer, subhier, thistopic, level+1);
 	}
 	mosquitto_FREE(thistopic);
 	return MOSQ_ERR_SUCCESS;
 }
 
 
-static int persist__subs_save_all(FILE *db_fptr)
+static int persist__subs_save_all(struct persist__v7_writer *writer)
 {
 	struct mosquitto__subhier *subhier, *subhier_tmp;
 
 	HASH_ITER(hh, db.normal_subs, subhier, subhier_tmp){
 		if(subhier->children){
-			persist__subs_save(db_fptr, subhier->children, "", 0);
+			persist__subs_save(writer, subhier->children, "", 0);
 		}
 	}
 
 	HASH_ITER(hh, db.shared_subs, subhier, subhier_tmp){
 		if(subhier->children){
-			persist__subs_save(db_fptr, subhier->children, "", 0);
+			persist__subs_save(writer, subhier->children, "", 0);
 		}
 	}
 
@@ -295,7 +586,7 @@ static int persist__subs_save_all(FILE *db_fptr)
 }
 
 
-static int persist__retain_save(FILE *db_fptr, struct mosquitto__retainhier *node, int level)
+static int persist__retain_save(struct persist__v7_writer *writer, struct mosquitto__retainhier *node, int level)
 {
 	struct mosquitto__retainhier *retainhier, *retainhier_tmp;
 	struct P_retain retain_chunk;
@@ -306,26 +597,26 @@ static int persist__retain_save(FILE *db_fptr, struct mosquitto__retainhier *nod
 
 		/* Don't save $SYS messages. */
 		retain_chunk.F.store_id = node->retained->data.store_id;
-		rc = persist__chunk_retain_write_v6(db_fptr, &retain_chunk);
+		rc = persist__chunk_retain_write_v7(writer, &retain_chunk);
 		if(rc){
 			return rc;
 		}
 	}
 
 	HASH_ITER(hh, node->children, retainhier, retainhier_tmp){
-		persist__retain_save(db_fptr, retainhier, level+1);
+		persist__retain_save(writer, retainhier, level+1);
 	}
 	return MOSQ_ERR_SUCCESS;
 }
 
 
-static int persist__retain_save_all(FILE *db_fptr)
+static int persist__retain_save_all(struct persist__v7_writer *writer)
 {
 	struct mosquitto__retainhier *retainhier, *retainhier_tmp;
 
 	HASH_ITER(hh, db.retains, retainhier, retainhier_tmp){
 		if(retainhier->children){
-			persist__retain_save(db_fptr, retainhier->children, 0);
+			persist__retain_save(writer, retainhier->children, 0);
 		}
 	}
 
@@ -341,8 +632,354 @@ static void persist__log_write_error(const char *msg)
 }
 
 
+/* The retain log is rewritten once it holds more appended records than there
+ * were live entries after the last rewrite, and at least this many. */
+#define RETAIN_LOG_COMPACT_MIN 1024
+
+static unsigned long retain_log_records = 0; /* Appended since the last rewrite */
+static unsigned long retain_log_live = 0; /* Written by the last rewrite */
+static bool retain_log_compact = false;
+
+
+void persist__retain_log_compact_next(void)
+{
+	retain_log_compact = true;
+}
+
+
+void persist__retain_log_restored(unsigned long records, unsigned long live)
+{
+	retain_log_records = records > live ? records - live : 0;
+	retain_log_live = live;
+}
+
+
+void persist__retain_log_remove(void)
+{
+	char *path;
+
+	path = persist__retain_log_path();
+	if(path){
+		if(remove(path) == 0){
+			log__printf(NULL, MOSQ_LOG_INFO, "Removed retain log %s.", path);
+		}
+		mosquitto_FREE(path);
+	}
+	retain_log_records = 0;
+	retain_log_live = 0;
+}
+
+
+static int retain_log__header_write(FILE *fptr)
+{
+	uint32_t crc = 0;
+	uint32_t version = htonl(6);
+
+	write_e(fptr, magic, 15);
+	write_e(fptr, &crc, sizeof(uint32_t));
+	write_e(fptr, &version, sizeof(uint32_t));
+
+	return MOSQ_ERR_SUCCESS;
+error:
+	log__printf(NULL, MOSQ_LOG_ERR, "Error: %s.", strerror(errno));
+	return 1;
+}
+
+
+static int retain_log__base_msg_write(FILE *fptr, const struct mosquitto__base_msg *base_msg)
+{
+	struct P_base_msg chunk;
+	struct PF_base_msg F;
+	struct PF_header header;
+	struct mosquitto__packet *prop_packet = NULL;
+	uint32_t proplen = 0;
+	int rc;
+
+	persist__base_msg_chunk_fill(&chunk, base_msg);
+	/* Entries in the retain log are always retained */
+	chunk.F.retain = 1;
+
+	if(chunk.properties){
+		proplen = mosquitto_property_get_remaining_length(chunk.properties);
+	}
+
+	memcpy(&F, &chunk.F, sizeof(struct PF_base_msg));
+	F.payloadlen = htonl(chunk.F.payloadlen);
+	F.source_mid = htons(chunk.F.source_mid);
+	F.source_id_len = htons(chunk.F.source_id_len);
+	F.source_username_len = htons(chunk.F.source_username_len);
+	F.topic_len = htons(chunk.F.topic_len);
+	F.source_port = htons(chunk.F.source_port);
+
+	header.chunk = htonl(DB_CHUNK_BASE_MSG);
+	header.length = htonl((uint32_t)sizeof(struct PF_base_msg) +
+			chunk.F.topic_len + chunk.F.payloadlen +
+			chunk.F.source_id_len + chunk.F.source_username_len + proplen);
+
+	write_e(fptr, &header, sizeof(struct PF_header));
+	write_e(fptr, &F, sizeof(struct PF_base_msg));
+	if(chunk.F.source_id_len){
+		write_e(fptr, chunk.source.id, chunk.F.source_id_len);
+	}
+	if(chunk.F.source_username_len){
+		write_e(fptr, chunk.source.username, chunk.F.source_username_len);
+	}
+	write_e(fptr, chunk.topic, chunk.F.topic_len);
+	if(chunk.F.payloadlen){
+		write_e(fptr, chunk.payload, chunk.F.payloadlen);
+	}
+	if(proplen > 0){
+		prop_packet = mosquitto_calloc(1, sizeof(struct mosquitto__packet)+proplen);
+		if(prop_packet == NULL){
+			return MOSQ_ERR_NOMEM;
+		}
+		prop_packet->remaining_length = proplen;
+		prop_packet->packet_length = proplen;
+		rc = property__write_all(prop_packet, chunk.properties, true);
+		if(rc){
+			mosquitto_FREE(prop_packet);
+			return rc;
+		}
+		write_e(fptr, prop_packet->payload, proplen);
+		mosquitto_FREE(prop_packet);
+	}
+
+	return MOSQ_ERR_SUCCESS;
+error:
+	mosquitto_FREE(prop_packet);
+	log__printf(NULL, MOSQ_LOG_ERR, "Error: %s.", strerror(errno));
+	return 1;
+}
+
+
+/* Rebuild the full topic of `retainhier` from the tree. Topics that don't
+ * start with '$' sit below an extra empty level, see sub__topic_tokenise(). */
+static char *retain_log__topic(const struct mosquitto__retainhier *retainhier)
+{
+	const struct mosquitto__retainhier *node, *top = NULL;
+	size_t len = 0;
+	char *topic, *ptr;
+
+	for(node = retainhier; node->parent; node = node->parent){
+		top = node;
+	}
+	if(top == NULL){
+		return NULL;
+	}
+	if(node->topic_len == 0){
+		if(top == retainhier){
+			return NULL;
+		}
+		/* Skip the extra empty level */
+		for(node = retainhier; node->parent != top; node = node->parent){
+		}
+		top = node;
+	}
+
+	for(node = retainhier; ; node = node->parent){
+		len += node->topic_len + 1U;
+		if(node == top){
+			break;
+		}
+	}
+
+	topic = mosquitto_malloc(len);
+	if(topic == NULL){
+		return NULL;
+	}
+	ptr = &topic[len-1];
+	*ptr = '\0';
+	for(node = retainhier; ; node = node->parent){
+		ptr -= node->topic_len;
+		memcpy(ptr, node->topic, node->topic_len);
+		if(node == top){
+			break;
+		}
+		ptr--;
+		*ptr = '/';
+	}
+
+	return topic;
+}
+
+
+static int retain_log__clear_write(FILE *fptr, const struct mosquitto__retainhier *retainhier)
+{
+	struct PF_header header;
+	char *topic;
+	size_t topic_len;
+
+	topic = retain_log__topic(retainhier);
+	if(topic == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	topic_len = strlen(topic);
+
+	header.chunk = htonl(DB_CHUNK_RETAIN_CLEAR);
+	header.length = htonl((uint32_t)topic_len);
+	write_e(fptr, &header, sizeof(struct PF_header));
+	write_e(fptr, topic, topic_len);
+	mosquitto_FREE(topic);
+
+	return MOSQ_ERR_SUCCESS;
+error:
+	mosquitto_FREE(topic);
+	log__printf(NULL, MOSQ_LOG_ERR, "Error: %s.", strerror(errno));
+	return 1;
+}
+
+
+static int retain_log__tree_write(FILE *fptr, struct mosquitto__retainhier *node)
+{
+	struct mosquitto__retainhier *retainhier, *retainhier_tmp;
+	int rc;
+
+	if(node->retained && strncmp(node->retained->data.topic, "$SYS", 4)){
+		rc = retain_log__base_msg_write(fptr, node->retained);
+		if(rc){
+			return rc;
+		}
+		node->retained->retain_logged = true;
+		retain_log_live++;
+	}
+
+	HASH_ITER(hh, node->children, retainhier, retainhier_tmp){
+		rc = retain_log__tree_write(fptr, retainhier);
+		if(rc){
+			return rc;
+		}
+	}
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+static int retain_log__rewrite(FILE *fptr, void *user_data)
+{
+	struct mosquitto__retainhier *retainhier, *retainhier_tmp;
+
+	UNUSED(user_data);
+
+	if(retain_log__header_write(fptr)){
+		return MOSQ_ERR_UNKNOWN;
+	}
+
+	/* mosquitto_write_file() closes the file on error */
+	retain_log_live = 0;
+	HASH_ITER(hh, db.retains, retainhier, retainhier_tmp){
+		if(retainhier->children && retain_log__tree_write(fptr, retainhier->children)){
+			return MOSQ_ERR_UNKNOWN;
+		}
+	}
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+/* Append the entries changed since the last save to the retain log. */
+static int retain_log__append(const char *path)
+{
+	struct mosquitto__retainhier *retainhier;
+	FILE *fptr;
+	long pos;
+	int rc = MOSQ_ERR_SUCCESS;
+
+	if(db.retain_dirty == NULL){
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	fptr = mosquitto_fopen(path, "ab", true);
+	if(fptr == NULL){
+		log__printf(NULL, MOSQ_LOG_ERR, "Error: Unable to open retain log %s: %s.", path, strerror(errno));
+		return MOSQ_ERR_ERRNO;
+	}
+	/* The position of a file opened for appending is only defined once it has
+	 * been written to */
+	if(fseek(fptr, 0, SEEK_END) < 0 || (pos = ftell(fptr)) < 0){
+		log__printf(NULL, MOSQ_LOG_ERR, "Error: Unable to append to retain log %s: %s.", path, strerror(errno));
+		fclose(fptr);
+		return MOSQ_ERR_ERRNO;
+	}
+	if(pos == 0){
+		rc = retain_log__header_write(fptr);
+	}
+
+	for(retainhier = db.retain_dirty; retainhier && rc == MOSQ_ERR_SUCCESS; retainhier = retainhier->dirty_next){
+		if(retainhier->retained){
+			rc = retain_log__base_msg_write(fptr, retainhier->retained);
+		}else{
+			rc = retain_log__clear_write(fptr, retainhier);
+		}
+		retain_log_records++;
+	}
+
+#ifndef WIN32
+	if(rc == MOSQ_ERR_SUCCESS && (fflush(fptr) != 0 || fsync(fileno(fptr)) != 0)){
+		log__printf(NULL, MOSQ_LOG_ERR, "Error: Unable to sync retain log %s: %s.", path, strerror(errno));
+		rc = MOSQ_ERR_ERRNO;
+	}
+#endif
+	if(fclose(fptr) != 0 && rc == MOSQ_ERR_SUCCESS){
+		rc = MOSQ_ERR_ERRNO;
+	}
+	if(rc){
+		return rc;
+	}
+
+	for(retainhier = db.retain_dirty; retainhier; retainhier = retainhier->dirty_next){
+		if(retainhier->retained){
+			retainhier->retained->retain_logged = true;
+		}
+	}
+	retain__dirty_clear();
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+int persist__retain_log_save(void)
+{
+	struct stat statbuf;
+	char *path;
+	int rc;
+
+	path = persist__retain_log_path();
+	if(path == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+
+	if(stat(path, &statbuf) == 0 && !retain_log_compact
+			&& (retain_log_records < RETAIN_LOG_COMPACT_MIN || retain_log_records <= retain_log_live)){
+
+		rc = retain_log__append(path);
+		mosquitto_FREE(path);
+		return rc;
+	}
+
+	/* Make sure the current log ends with the current state before replacing
+	 * it, so that replaying it over the new log gives the same result. */
+	if(stat(path, &statbuf) == 0){
+		rc = retain_log__append(path);
+		if(rc){
+			mosquitto_FREE(path);
+			return rc;
+		}
+	}
+
+	log__printf(NULL, MOSQ_LOG_INFO, "Rewriting retain log %s.", path);
+	rc = mosquitto_write_file(path, true, &retain_log__rewrite, NULL, &persist__log_write_error);
+	if(rc == MOSQ_ERR_SUCCESS){
+		retain_log_records = 0;
+		retain_log_compact = false;
+		retain__dirty_clear();
+	}
+	mosquitto_FREE(path);
+	return rc;
+}
+
+
 int persist__backup(bool shutdown)
 {
+	int rc;
+
 	if(db.config == NULL){
 		return MOSQ_ERR_INVAL;
 	}
@@ -353,46 +990,76 @@ int persist__backup(bool shutdown)
 		return MOSQ_ERR_INVAL;
 	}
 
+	/* The retain log is written first, it is always restored first. */
+	if(db.config->persistence_incremental_retain){
+		rc = persist__retain_log_save();
+		if(rc){
+			return rc;
+		}
+	}
+
 	log__printf(NULL, MOSQ_LOG_INFO, "Saving in-memory database to %s.", db.config->persistence_filepath);
 
-	return mosquitto_write_file(db.config->persistence_filepath, true, &persist__write_data, &shutdown, &persist__log_write_error);
+	rc = mosquitto_write_file(db.config->persistence_filepath, true, &persist__write_data, &shutdown, &persist__log_write_error);
+	if(rc == MOSQ_ERR_SUCCESS){
+		persist__lazy_reopen();
+		if(!db.config->persistence_incremental_retain){
+			/* Retained messages are now all in the main file */
+			persist__retain_log_remove();
+		}
+	}
+	return rc;
 }
 
 
 static int persist__write_data(FILE *db_fptr, void *user_data)
 {
 	bool shutdown = *(bool *)(user_data);
-	uint32_t db_version_w = htonl(MOSQ_DB_VERSION);
-	uint32_t crc = 0;
 	const char *err;
 	struct PF_cfg cfg_chunk;
+	struct persist__v7_writer writer;
+	struct persist__lazy_ids lazy_ids;
+	struct persist__spilled spilled;
 	int rc = MOSQ_ERR_UNKNOWN;
 
-	/* Header */
-	write_e(db_fptr, magic, 15);
-	write_e(db_fptr, &crc, sizeof(uint32_t));
-	write_e(db_fptr, &db_version_w, sizeof(uint32_t));
+	memset(&lazy_ids, 0, sizeof(struct persist__lazy_ids));
+	memset(&spilled, 0, sizeof(struct persist__spilled));
+	if(persist__v7_writer_init(&writer, db_fptr)){
+		goto error;
+	}
 
 	memset(&cfg_chunk, 0, sizeof(struct PF_cfg));
 	cfg_chunk.last_db_id = db.last_db_id;
 	cfg_chunk.shutdown = shutdown;
 	cfg_chunk.dbid_size = sizeof(dbid_t);
-	if(persist__chunk_cfg_write_v6(db_fptr, &cfg_chunk)){
+	if(persist__chunk_cfg_write_v7(&writer, &cfg_chunk)){
 		goto error;
 	}
 
-	if(persist__message_store_save(db_fptr)){
+	if(persist__message_store_save(&writer)){
 		goto error;
 	}
 
-	if(persist__client_save(db_fptr)
-			|| persist__subs_save_all(db_fptr)
-			|| persist__retain_save_all(db_fptr)){
+	if(persist__client_save(&writer, &lazy_ids, &spilled)
+			|| persist__lazy_base_msgs_save(&writer, &lazy_ids)
+			|| persist__spilled_base_msgs_save(&writer, &spilled, &lazy_ids)
+			|| persist__subs_save_all(&writer)
+			|| (!db.config->persistence_incremental_retain && persist__retain_save_all(&writer))){
 		goto error;
 	}
+
+	if(persist__v7_writer_finish(&writer)){
+		goto error;
+	}
+	persist__v7_writer_cleanup(&writer);
+	mosquitto_FREE(lazy_ids.ids);
+	mosquitto_FREE(spilled.items);
 	return MOSQ_ERR_SUCCESS;
 
 error:
+	persist__v7_writer_cleanup(&writer);
+	mosquitto_FREE(lazy_ids.ids);
+	mosquitto_FREE(spilled.items);
 	err = strerror(errno);
 	log__printf(NULL, MOSQ_LOG_ERR, "Error during saving in-memory database %s: %s.", db.config->persistence_filepath, err);
 	if(db_fptr){
@@ -401,5 +1068,4 @@ error:
 	return rc;
 }
 
-
 #endif
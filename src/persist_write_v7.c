@@ -0,0 +1,403 @@
+/*
+Copyright (c) 2010-2021 Roger Light <roger@atchoo.org>
+
+All rights reserved. This program and the accompanying materials
+are made available under the terms of the Eclipse Public License 2.0
+and Eclipse Distribution License v1.0 which accompany this distribution.
+
+The Eclipse Public License is available at
+   https://www.eclipse.org/legal/epl-2.0/
+and the Eclipse Distribution License is available at
+  http://www.eclipse.org/org/documents/edl-v10.php.
+
+SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+
+Contributors:
+   Roger Light - initial implementation and documentation.
+*/
+
+
+#include "config.h"
+
+#ifdef WITH_PERSISTENCE
+
+#ifndef WIN32
+#include <arpa/inet.h>
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "mosquitto/mqtt_protocol.h"
+#include "mosquitto_broker_internal.h"
+#include "persist.h"
+#include "packet_mosq.h"
+#include "property_common.h"
+#include "property_mosq.h"
+#include "util_mosq.h"
+
+/* Order in which the record tables and string heap are written after the
+ * payload heap. The payload heap is written first because it is streamed
+ * straight to the file, everything else is small enough to be buffered. */
+static const uint32_t buffered_sections[] = {
+	DB_CHUNK_CFG,
+	DB_CHUNK_BASE_MSG,
+	DB_CHUNK_CLIENT,
+	DB_CHUNK_CLIENT_MSG,
+	DB_CHUNK_SUB,
+	DB_CHUNK_RETAIN,
+	DB_SECTION_STRINGS,
+};
+#define SECTION_COUNT (sizeof(buffered_sections)/sizeof(uint32_t) + 1)
+#define PAYLOADS_OFFSET (PERSIST_V7_DIR_OFFSET + sizeof(struct PF_v7_header) + SECTION_COUNT*sizeof(struct PF_v7_section))
+
+
+static int buf__append(struct persist__v7_buf *buf, const void *data, size_t len)
+{
+	uint8_t *newdata;
+	size_t newsize;
+
+	if(len == 0){
+		return MOSQ_ERR_SUCCESS;
+	}
+	if(buf->len + len > buf->size){
+		newsize = buf->size ? buf->size : 4096;
+		while(newsize < buf->len + len){
+			newsize *= 2;
+		}
+		newdata = mosquitto_realloc(buf->data, newsize);
+		if(newdata == NULL){
+			return MOSQ_ERR_NOMEM;
+		}
+		buf->data = newdata;
+		buf->size = newsize;
+	}
+	memcpy(&buf->data[buf->len], data, len);
+	buf->len += len;
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+static int record__add(struct persist__v7_writer *writer, uint32_t type, const void *record, size_t len)
+{
+	int rc;
+
+	rc = buf__append(&writer->sections[type], record, len);
+	if(rc == MOSQ_ERR_SUCCESS){
+		writer->sections[type].count++;
+	}
+	return rc;
+}
+
+
+static int string__add(struct persist__v7_writer *writer, const char *str, uint16_t len, uint64_t *offset)
+{
+	*offset = writer->sections[DB_SECTION_STRINGS].len;
+	if(len == 0){
+		return MOSQ_ERR_SUCCESS;
+	}
+	return buf__append(&writer->sections[DB_SECTION_STRINGS], str, len);
+}
+
+
+static int payload__write(struct persist__v7_writer *writer, const void *data, size_t len)
+{
+	if(len == 0){
+		return MOSQ_ERR_SUCCESS;
+	}
+	if(fwrite(data, 1, len, writer->db_fptr) != len){
+		log__printf(NULL, MOSQ_LOG_ERR, "Error: %s.", strerror(errno));
+		return 1;
+	}
+	writer->payloads_len += len;
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+static int properties__write(struct persist__v7_writer *writer, const mosquitto_property *properties, uint32_t proplen)
+{
+	struct mosquitto__packet *prop_packet;
+	int rc;
+
+	prop_packet = mosquitto_calloc(1, sizeof(struct mosquitto__packet)+proplen);
+	if(prop_packet == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	prop_packet->remaining_length = proplen;
+	prop_packet->packet_length = proplen;
+	rc = property__write_all(prop_packet, properties, true);
+	if(rc == MOSQ_ERR_SUCCESS){
+		rc = payload__write(writer, prop_packet->payload, proplen);
+	}
+	mosquitto_FREE(prop_packet);
+	return rc;
+}
+
+
+int persist__v7_writer_init(struct persist__v7_writer *writer, FILE *db_fptr)
+{
+	uint32_t db_version_w = htonl(MOSQ_DB_VERSION);
+	uint32_t crc = 0;
+	uint8_t zero[PAYLOADS_OFFSET];
+
+	memset(writer, 0, sizeof(struct persist__v7_writer));
+	writer->db_fptr = db_fptr;
+
+	/* Header, then a placeholder for the directory which is filled in once
+	 * the section sizes are known. */
+	memset(zero, 0, sizeof(zero));
+	write_e(db_fptr, magic, 15);
+	write_e(db_fptr, &crc, sizeof(uint32_t));
+	write_e(db_fptr, &db_version_w, sizeof(uint32_t));
+	write_e(db_fptr, zero, PAYLOADS_OFFSET - (15 + 2*sizeof(uint32_t)));
+
+	return MOSQ_ERR_SUCCESS;
+error:
+	log__printf(NULL, MOSQ_LOG_ERR, "Error: %s.", strerror(errno));
+	return 1;
+}
+
+
+static int base_msg__cmp(const void *a, const void *b)
+{
+	dbid_t ida, idb;
+
+	memcpy(&ida, a, sizeof(dbid_t));
+	memcpy(&idb, b, sizeof(dbid_t));
+	if(ida < idb){
+		return -1;
+	}else if(ida > idb){
+		return 1;
+	}else{
+		return 0;
+	}
+}
+
+
+int persist__v7_writer_finish(struct persist__v7_writer *writer)
+{
+	struct PF_v7_header header;
+	struct PF_v7_section dir[SECTION_COUNT];
+	struct persist__v7_buf *buf;
+	uint64_t pos;
+	size_t padding;
+	uint8_t zero[8];
+	uint32_t type;
+
+	memset(zero, 0, sizeof(zero));
+	memset(dir, 0, sizeof(dir));
+
+	/* Readers rely on this order to look up single base messages */
+	buf = &writer->sections[DB_CHUNK_BASE_MSG];
+	if(buf->count > 1){
+		qsort(buf->data, (size_t)buf->count, sizeof(struct PF_v7_base_msg), base_msg__cmp);
+	}
+
+	dir[0].type = htonl(DB_SECTION_PAYLOADS);
+	dir[0].offset = PAYLOADS_OFFSET;
+	dir[0].length = writer->payloads_len;
+
+	pos = PAYLOADS_OFFSET + writer->payloads_len;
+	for(size_t i=0; i<SECTION_COUNT-1; i++){
+		type = buffered_sections[i];
+		buf = &writer->sections[type];
+
+		padding = (size_t)((8 - (pos % 8)) % 8);
+		write_e(writer->db_fptr, zero, padding);
+		pos += padding;
+
+		dir[i+1].type = htonl(type);
+		if(buf->count > 0){
+			dir[i+1].record_size = htonl((uint32_t)(buf->len / buf->count));
+		}
+		dir[i+1].offset = pos;
+		dir[i+1].length = buf->len;
+		dir[i+1].count = buf->count;
+
+		write_e(writer->db_fptr, buf->data, buf->len);
+		pos += buf->len;
+	}
+
+	header.section_count = htonl(SECTION_COUNT);
+	header.flags = 0;
+	if(fseek(writer->db_fptr, PERSIST_V7_DIR_OFFSET, SEEK_SET) < 0){
+		goto error;
+	}
+	write_e(writer->db_fptr, &header, sizeof(struct PF_v7_header));
+	write_e(writer->db_fptr, dir, sizeof(dir));
+	if(fseek(writer->db_fptr, 0, SEEK_END) < 0){
+		goto error;
+	}
+
+	return MOSQ_ERR_SUCCESS;
+error:
+	log__printf(NULL, MOSQ_LOG_ERR, "Error: %s.", strerror(errno));
+	return 1;
+}
+
+
+void persist__v7_writer_cleanup(struct persist__v7_writer *writer)
+{
+	for(int i=0; i<=DB_SECTION_MAX; i++){
+		mosquitto_FREE(writer->sections[i].data);
+	}
+	memset(writer, 0, sizeof(struct persist__v7_writer));
+}
+
+
+int persist__chunk_cfg_write_v7(struct persist__v7_writer *writer, struct PF_cfg *chunk)
+{
+	return record__add(writer, DB_CHUNK_CFG, chunk, sizeof(struct PF_cfg));
+}
+
+
+int persist__chunk_client_write_v7(struct persist__v7_writer *writer, struct P_client *chunk)
+{
+	struct PF_v7_client rec;
+	uint64_t offset;
+	int rc;
+
+	memset(&rec, 0, sizeof(struct PF_v7_client));
+
+	rc = string__add(writer, chunk->clientid, chunk->F.id_len, &rec.str_offset);
+	if(rc){
+		return rc;
+	}
+	rc = string__add(writer, chunk->username, chunk->F.username_len, &offset);
+	if(rc){
+		return rc;
+	}
+	/* Client messages for this client follow, they can share the id */
+	writer->last_clientid = chunk->clientid;
+	writer->last_clientid_offset = rec.str_offset;
+
+	rec.session_expiry_time = chunk->F.session_expiry_time;
+	rec.session_expiry_interval = htonl(chunk->F.session_expiry_interval);
+	rec.last_mid = htons(chunk->F.last_mid);
+	rec.id_len = htons(chunk->F.id_len);
+	rec.listener_port = htons(chunk->F.listener_port);
+	rec.username_len = htons(chunk->F.username_len);
+
+	return record__add(writer, DB_CHUNK_CLIENT, &rec, sizeof(struct PF_v7_client));
+}
+
+
+int persist__chunk_client_msg_write_v7(struct persist__v7_writer *writer, struct P_client_msg *chunk)
+{
+	struct PF_v7_client_msg rec;
+	int rc;
+
+	memset(&rec, 0, sizeof(struct PF_v7_client_msg));
+
+	if(chunk->clientid == writer->last_clientid){
+		rec.id_offset = writer->last_clientid_offset;
+	}else{
+		rc = string__add(writer, chunk->clientid, chunk->F.id_len, &rec.id_offset);
+		if(rc){
+			return rc;
+		}
+	}
+
+	rec.store_id = chunk->F.store_id;
+	rec.subscription_identifier = htonl(chunk->subscription_identifier);
+	rec.mid = htons(chunk->F.mid);
+	rec.id_len = htons(chunk->F.id_len);
+	rec.qos = chunk->F.qos;
+	rec.state = chunk->F.state;
+	rec.retain_dup = chunk->F.retain_dup;
+	rec.direction = chunk->F.direction;
+
+	return record__add(writer, DB_CHUNK_CLIENT_MSG, &rec, sizeof(struct PF_v7_client_msg));
+}
+
+
+int persist__chunk_message_store_write_v7(struct persist__v7_writer *writer, struct P_base_msg *chunk)
+{
+	struct PF_v7_base_msg rec;
+	uint64_t offset;
+	uint32_t proplen = 0;
+	int rc;
+
+	memset(&rec, 0, sizeof(struct PF_v7_base_msg));
+
+	if(chunk->properties){
+		proplen = mosquitto_property_get_remaining_length(chunk->properties);
+	}
+
+	rc = string__add(writer, chunk->source.id, chunk->F.source_id_len, &rec.str_offset);
+	if(rc == MOSQ_ERR_SUCCESS){
+		rc = string__add(writer, chunk->source.username, chunk->F.source_username_len, &offset);
+	}
+	if(rc == MOSQ_ERR_SUCCESS){
+		rc = string__add(writer, chunk->topic, chunk->F.topic_len, &offset);
+	}
+	if(rc){
+		return rc;
+	}
+
+	rec.data_offset = writer->payloads_len;
+	rc = payload__write(writer, chunk->payload, chunk->F.payloadlen);
+	if(rc){
+		return rc;
+	}
+	if(proplen > 0){
+		rc = properties__write(writer, chunk->properties, proplen);
+		if(rc){
+			return rc;
+		}
+	}
+
+	rec.store_id = chunk->F.store_id;
+	rec.expiry_time = chunk->F.expiry_time;
+	rec.payloadlen = htonl(chunk->F.payloadlen);
+	rec.proplen = htonl(proplen);
+	rec.source_mid = htons(chunk->F.source_mid);
+	rec.source_id_len = htons(chunk->F.source_id_len);
+	rec.source_username_len = htons(chunk->F.source_username_len);
+	rec.topic_len = htons(chunk->F.topic_len);
+	rec.source_port = htons(chunk->F.source_port);
+	rec.qos = chunk->F.qos;
+	rec.retain = chunk->F.retain;
+
+	return record__add(writer, DB_CHUNK_BASE_MSG, &rec, sizeof(struct PF_v7_base_msg));
+}
+
+
+int persist__chunk_retain_write_v7(struct persist__v7_writer *writer, struct P_retain *chunk)
+{
+	struct PF_v7_retain rec;
+
+	rec.store_id = chunk->F.store_id;
+	return record__add(writer, DB_CHUNK_RETAIN, &rec, sizeof(struct PF_v7_retain));
+}
+
+
+int persist__chunk_sub_write_v7(struct persist__v7_writer *writer, struct P_sub *chunk)
+{
+	struct PF_v7_sub rec;
+	int rc;
+
+	memset(&rec, 0, sizeof(struct PF_v7_sub));
+
+	rc = string__add(writer, chunk->clientid, chunk->F.id_len, &rec.id_offset);
+	if(rc == MOSQ_ERR_SUCCESS){
+		rc = string__add(writer, chunk->topic, chunk->F.topic_len, &rec.topic_offset);
+	}
+	if(rc){
+		return rc;
+	}
+
+	rec.identifier = htonl(chunk->F.identifier);
+	rec.id_len = htons(chunk->F.id_len);
+	rec.topic_len = htons(chunk->F.topic_len);
+	rec.qos = chunk->F.qos;
+	rec.options = chunk->F.options;
+
+	return record__add(writer, DB_CHUNK_SUB, &rec, sizeof(struct PF_v7_sub));
+}
+#endif
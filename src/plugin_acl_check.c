@@ -104,7 +104,7 @@ static int acl__check_dollar(const char *topic, int access)
 
 static int plugin__acl_check(struct mosquitto__security_options *opts, struct mosquitto *context, const char *topic, uint32_t payloadlen, void *payload, uint8_t qos, bool retain, mosquitto_property *properties, int access)
 {
-	int rc = MOSQ_ERR_PLUGIN_DEFER;
+	int rc = MOSQ_ERR_PLUGIN_IGNORE; /* If every callback is filtered out */
 	struct mosquitto_acl_msg msg;
 	struct mosquitto__callback *cb_base, *cb_next;
 	struct mosquitto_evt_acl_check event_data;
@@ -119,6 +119,14 @@ static int plugin__acl_check(struct mosquitto__security_options *opts, struct mo
 	DL_FOREACH_SAFE(opts->plugin_callbacks.acl_check, cb_base, cb_next){
 		/* FIXME - username deny special chars */
 
+		/* Topic filters only apply to messages, subscribe and unsubscribe
+		 * checks are for topic filters so always reach the plugin. */
+		if((access == MOSQ_ACL_READ || access == MOSQ_ACL_WRITE)
+				&& !plugin__callback_matches_topic(cb_base, topic)){
+
+			continue;
+		}
+
 		memset(&event_data, 0, sizeof(event_data));
 		event_data.client = context;
 		event_data.access = access;
@@ -128,7 +136,7 @@ static int plugin__acl_check(struct mosquitto__security_options *opts, struct mo
 		event_data.qos = qos;
 		event_data.retain = retain;
 		event_data.properties = properties;
-		rc = cb_base->cb(MOSQ_EVT_ACL_CHECK, &event_data, cb_base->userdata);
+		rc = plugin__callback_call(cb_base, MOSQ_EVT_ACL_CHECK, &event_data);
 		if(rc != MOSQ_ERR_PLUGIN_DEFER && rc != MOSQ_ERR_PLUGIN_IGNORE){
 			return rc;
 		}
@@ -138,6 +146,55 @@ static int plugin__acl_check(struct mosquitto__security_options *opts, struct mo
 }
 
 
+static bool acl__callbacks_cacheable(struct mosquitto__security_options *opts)
+{
+	struct mosquitto__callback *cb_base;
+
+	DL_FOREACH(opts->plugin_callbacks.acl_check, cb_base){
+		if(cb_base->identifier == NULL || cb_base->identifier->acl_cacheable == false){
+			return false;
+		}
+	}
+	return true;
+}
+
+
+/* Returns true if every ACL check callback that applies to this client has
+ * declared that its MOSQ_ACL_READ result depends only on the client and the
+ * topic, so the result can be reused for later messages on the same topic.
+ */
+bool acl__read_cacheable(struct mosquitto *context)
+{
+	if(acl__callbacks_cacheable(&db.config->security_options) == false){
+		return false;
+	}
+	if(context->listener && context->listener->security_options
+			&& acl__callbacks_cacheable(context->listener->security_options) == false){
+
+		return false;
+	}
+	return true;
+}
+
+
+BROKER_EXPORT int mosquitto_plugin_set_acl_cacheable(mosquitto_plugin_id_t *identifier, bool cacheable)
+{
+	if(identifier == NULL){
+		return MOSQ_ERR_INVAL;
+	}
+
+	identifier->acl_cacheable = cacheable;
+	db.acl_generation++;
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+BROKER_EXPORT void mosquitto_acl_cache_invalidate(void)
+{
+	db.acl_generation++;
+}
+
+
 int mosquitto_acl_check(struct mosquitto *context, const char *topic, uint32_t payloadlen, void *payload, uint8_t qos, bool retain, mosquitto_property *properties, int access)
 {
 	int rc;
@@ -41,7 +41,7 @@ static int plugin__basic_auth(struct mosquitto__security_options *opts, struct m
 		event_data.username = context->username;
 		event_data.password = context->password;
 		event_data.password_len = context->password_len;
-		rc = cb_base->cb(MOSQ_EVT_BASIC_AUTH, &event_data, cb_base->userdata);
+		rc = plugin__callback_call(cb_base, MOSQ_EVT_BASIC_AUTH, &event_data);
 		if(rc == MOSQ_ERR_PLUGIN_IGNORE){
 			/* Do nothing, this is as if the plugin doesn't exist */
 		}else if(rc == MOSQ_ERR_PLUGIN_DEFER){
@@ -23,7 +23,7 @@ Contributors:
 #include "lib_load.h"
 
 
-static const char *get_event_name(enum mosquitto_plugin_event event)
+const char *plugin__event_name(enum mosquitto_plugin_event event)
 {
 	switch(event){
 		case MOSQ_EVT_RELOAD:
@@ -51,7 +51,7 @@ static const char *get_event_name(enum mosquitto_plugin_event event)
 		case MOSQ_EVT_CONNECT:
 			return "connect";
 		case MOSQ_EVT_CLIENT_OFFLINE:
-			return "connect";
+			return "client-offline";
 		case MOSQ_EVT_SUBSCRIBE:
 			return "subscribe";
 		case MOSQ_EVT_UNSUBSCRIBE:
@@ -86,6 +86,8 @@ static const char *get_event_name(enum mosquitto_plugin_event event)
 			return "persist-will-add";
 		case MOSQ_EVT_PERSIST_WILL_DELETE:
 			return "persist-will-delete";
+		case MOSQ_EVT_MESSAGE_IN_BATCH:
+			return "message-in-batch";
 	}
 	return "";
 }
@@ -166,6 +168,8 @@ static struct mosquitto__callback **plugin__get_callback_base(struct mosquitto__
 			return &security_options->plugin_callbacks.persist_will_add;
 		case MOSQ_EVT_PERSIST_WILL_DELETE:
 			return &security_options->plugin_callbacks.persist_will_delete;
+		case MOSQ_EVT_MESSAGE_IN_BATCH:
+			return &security_options->plugin_callbacks.message_in_batch;
 	}
 	return NULL;
 }
@@ -188,12 +192,16 @@ static int remove_callback(mosquitto_plugin_id_t *plugin, struct plugin_own_call
 		DL_FOREACH_SAFE(*cb_base, tail, tmp){
 			if(tail->identifier == plugin && tail->cb == own->cb_func){
 				DL_DELETE(*cb_base, tail);
+				mosquitto_FREE(tail->topic_filter);
 				mosquitto_FREE(tail);
 				break;
 			}
 		}
 	}
 
+	if(own->event == MOSQ_EVT_ACL_CHECK){
+		db.acl_generation++;
+	}
 	DL_DELETE(plugin->own_callbacks, own);
 	mosquitto_FREE(own);
 
@@ -211,6 +219,7 @@ BROKER_EXPORT int mosquitto_callback_register(
 	struct mosquitto__callback **cb_base = NULL, *cb_new;
 	struct mosquitto__security_options *security_options;
 	struct plugin_own_callback *own_callback;
+	const char *topic_filter = NULL;
 
 	if(cb_func == NULL){
 		return MOSQ_ERR_INVAL;
@@ -240,6 +249,14 @@ BROKER_EXPORT int mosquitto_callback_register(
 		return control__register_callback(identifier, cb_func, event_data, userdata);
 	}
 
+	if(event_data && (event == MOSQ_EVT_MESSAGE_IN || event == MOSQ_EVT_MESSAGE_IN_BATCH
+				|| event == MOSQ_EVT_MESSAGE_OUT || event == MOSQ_EVT_ACL_CHECK)){
+		topic_filter = event_data;
+		if(mosquitto_sub_topic_check(topic_filter) != MOSQ_ERR_SUCCESS){
+			return MOSQ_ERR_INVAL;
+		}
+	}
+
 	own_callback = mosquitto_calloc(1, sizeof(struct plugin_own_callback));
 	if(own_callback == NULL){
 		return MOSQ_ERR_NOMEM;
@@ -250,7 +267,7 @@ BROKER_EXPORT int mosquitto_callback_register(
 
 	if(identifier->config.security_option_count == 0){
 		log__printf(NULL, MOSQ_LOG_WARNING, "Plugin could not register callback '%s'",
-				get_event_name((enum mosquitto_plugin_event)event));
+				plugin__event_name((enum mosquitto_plugin_event)event));
 		return MOSQ_ERR_INVAL;
 	}
 
@@ -267,6 +284,12 @@ BROKER_EXPORT int mosquitto_callback_register(
 		}
 
 		cb_new = mosquitto_calloc(1, sizeof(struct mosquitto__callback));
+		if(cb_new && topic_filter){
+			cb_new->topic_filter = mosquitto_strdup(topic_filter);
+			if(cb_new->topic_filter == NULL){
+				mosquitto_FREE(cb_new);
+			}
+		}
 		if(cb_new == NULL){
 			DL_DELETE(identifier->own_callbacks, own_callback);
 			mosquitto_FREE(own_callback);
@@ -278,19 +301,38 @@ BROKER_EXPORT int mosquitto_callback_register(
 		cb_new->cb = cb_func;
 		cb_new->userdata = userdata;
 	}
+	if(event == MOSQ_EVT_ACL_CHECK){
+		db.acl_generation++;
+	}
 
 	if(identifier->plugin_name){
 		log__printf(NULL, MOSQ_LOG_INFO, "Plugin %s has registered to receive '%s' events.",
-				identifier->plugin_name, get_event_name((enum mosquitto_plugin_event)event));
+				identifier->plugin_name, plugin__event_name((enum mosquitto_plugin_event)event));
 	}else{
 		log__printf(NULL, MOSQ_LOG_INFO, "Plugin has registered to receive '%s' events.",
-				get_event_name((enum mosquitto_plugin_event)event));
+				plugin__event_name((enum mosquitto_plugin_event)event));
 	}
 
 	return MOSQ_ERR_SUCCESS;
 }
 
 
+/* Returns true if the callback should be called for an event on this topic.
+ * A callback registered without a topic filter is called for every topic. */
+bool plugin__callback_matches_topic(const struct mosquitto__callback *cb, const char *topic)
+{
+	bool match = false;
+
+	if(cb->topic_filter == NULL){
+		return true;
+	}
+	if(topic == NULL || mosquitto_topic_matches_sub(cb->topic_filter, topic, &match) != MOSQ_ERR_SUCCESS){
+		return false;
+	}
+	return match;
+}
+
+
 int plugin__callback_unregister_all(mosquitto_plugin_id_t *plugin)
 {
 	struct plugin_own_callback *own, *own_tmp;
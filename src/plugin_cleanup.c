@@ -66,6 +66,7 @@ static void plugin__unload_single(mosquitto_plugin_id_t *plugin)
 	}
 
 	plugin__callback_unregister_all(plugin);
+	plugin_stats__cleanup(plugin);
 	mosquitto_FREE(plugin->plugin_name);
 	mosquitto_FREE(plugin->plugin_version);
 	DL_FOREACH_SAFE(plugin->control_endpoints, ep, tmp){
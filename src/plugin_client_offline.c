@@ -36,7 +36,7 @@ static void plugin__handle_client_offline_single(struct mosquitto__security_opti
 	event_data.client = context;
 	event_data.reason = reason;
 	DL_FOREACH_SAFE(opts->plugin_callbacks.client_offline, cb_base, cb_next){
-		cb_base->cb(MOSQ_EVT_CLIENT_OFFLINE, &event_data, cb_base->userdata);
+		plugin__callback_call(cb_base, MOSQ_EVT_CLIENT_OFFLINE, &event_data);
 	}
 }
 
@@ -31,7 +31,7 @@ static void plugin__handle_connect_single(struct mosquitto__security_options *op
 	memset(&event_data, 0, sizeof(event_data));
 	event_data.client = context;
 	DL_FOREACH_SAFE(opts->plugin_callbacks.connect, cb_base, cb_next){
-		cb_base->cb(MOSQ_EVT_CONNECT, &event_data, cb_base->userdata);
+		plugin__callback_call(cb_base, MOSQ_EVT_CONNECT, &event_data);
 	}
 }
 
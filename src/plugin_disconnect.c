@@ -35,7 +35,7 @@ static void plugin__handle_disconnect_single(struct mosquitto__security_options
 	event_data.client = context;
 	event_data.reason = reason;
 	DL_FOREACH_SAFE(opts->plugin_callbacks.disconnect, cb_base, cb_next){
-		cb_base->cb(MOSQ_EVT_DISCONNECT, &event_data, cb_base->userdata);
+		plugin__callback_call(cb_base, MOSQ_EVT_DISCONNECT, &event_data);
 	}
 }
 
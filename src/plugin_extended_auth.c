@@ -45,7 +45,7 @@ static int plugin__ext_auth_start(struct mosquitto__security_options *opts, stru
 		event_data.data_out = NULL;
 		event_data.data_in_len = data_in_len;
 		event_data.data_out_len = 0;
-		rc = cb_base->cb(MOSQ_EVT_EXT_AUTH_START, &event_data, cb_base->userdata);
+		rc = plugin__callback_call(cb_base, MOSQ_EVT_EXT_AUTH_START, &event_data);
 		if(rc == MOSQ_ERR_PLUGIN_IGNORE){
 			/* Do nothing */
 		}else if(rc == MOSQ_ERR_PLUGIN_DEFER){
@@ -119,7 +119,7 @@ static int plugin__ext_auth_continue(struct mosquitto__security_options *opts, s
 		event_data.data_out = NULL;
 		event_data.data_in_len = data_in_len;
 		event_data.data_out_len = 0;
-		rc = cb_base->cb(MOSQ_EVT_EXT_AUTH_CONTINUE, &event_data, cb_base->userdata);
+		rc = plugin__callback_call(cb_base, MOSQ_EVT_EXT_AUTH_CONTINUE, &event_data);
 		if(rc == MOSQ_ERR_PLUGIN_IGNORE || rc == MOSQ_ERR_PLUGIN_DEFER){
 			/* Do nothing */
 		}else{
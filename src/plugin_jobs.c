@@ -0,0 +1,178 @@
+/*
+Copyright (c) 2026 Roger Light <roger@atchoo.org>
+
+All rights reserved. This program and the accompanying materials
+are made available under the terms of the Eclipse Public License 2.0
+and Eclipse Distribution License v1.0 which accompany this distribution.
+
+The Eclipse Public License is available at
+   https://www.eclipse.org/legal/epl-2.0/
+and the Eclipse Distribution License is available at
+  http://www.eclipse.org/org/documents/edl-v10.php.
+
+SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+
+Contributors:
+   Roger Light - initial implementation and documentation.
+*/
+
+/* Plugin worker threads
+ *
+ * mosquitto_job_submit() lets a plugin run slow work, such as a request to an
+ * external service, on a pool of broker owned threads rather than blocking
+ * the main loop. Each job has a run function, which is called on a worker
+ * thread, and a complete function, which is called on the main loop once the
+ * run function has returned. The complete function is where the plugin acts
+ * on the result, for example by calling mosquitto_complete_basic_auth() or
+ * mosquitto_broker_publish().
+ *
+ * The threads are started when the first job is submitted, and wake the main
+ * loop as each job finishes. Without threads, the run function is called
+ * straight away, but the complete function is still left for the main loop so
+ * that plugins see the same order of events either way.
+ */
+
+#include "config.h"
+
+#include "mosquitto_broker_internal.h"
+
+struct plugin_job {
+	struct mosquitto__worker_job worker;
+	mosquitto_plugin_id_t *identifier;
+	MOSQ_FUNC_job_run run_func;
+	MOSQ_FUNC_job_complete complete_func;
+	void *job_data;
+	int result;
+};
+
+static struct mosquitto__worker_pool *pool = NULL;
+static bool started = false;
+
+/* Main thread only */
+static int in_flight = 0;
+/* Jobs that were run without the pool, waiting to be completed */
+static struct mosquitto__worker_job *local_head = NULL;
+static struct mosquitto__worker_job *local_tail = NULL;
+
+
+static void plugin_job__run(struct mosquitto__worker_job *worker)
+{
+	struct plugin_job *job = (struct plugin_job *)worker;
+
+	job->result = job->run_func(job->job_data);
+}
+
+
+static void local__append(struct mosquitto__worker_job *job)
+{
+	job->next = NULL;
+	if(local_tail){
+		local_tail->next = job;
+	}else{
+		local_head = job;
+	}
+	local_tail = job;
+}
+
+
+static void jobs__complete(struct mosquitto__worker_job *worker)
+{
+	struct mosquitto__worker_job *next;
+	struct plugin_job *job;
+
+	for(; worker; worker = next){
+		next = worker->next;
+		job = (struct plugin_job *)worker;
+		in_flight--;
+
+		job->complete_func(job->job_data, job->result);
+		mosquitto_FREE(job);
+	}
+}
+
+
+/* Stop the threads, then run any jobs that they hadn't started and complete
+ * every job while the clients still exist. Jobs submitted after this are run
+ * and completed straight away. */
+void plugin_jobs__cleanup(void)
+{
+	struct mosquitto__worker_job *pending, *done, *next;
+
+	worker_pool__free(pool, &pending, &done);
+	pool = NULL;
+	started = true;
+
+	for(; done; done = next){
+		next = done->next;
+		local__append(done);
+	}
+	for(; pending; pending = next){
+		next = pending->next;
+		plugin_job__run(pending);
+		local__append(pending);
+	}
+
+	plugin_jobs__check();
+}
+
+
+void plugin_jobs__check(void)
+{
+	struct mosquitto__worker_job *job;
+
+	if(in_flight == 0){
+		return;
+	}
+
+	job = local_head;
+	local_head = NULL;
+	local_tail = NULL;
+	jobs__complete(job);
+
+	if(pool){
+		jobs__complete(worker_pool__take_done(pool));
+	}
+}
+
+
+BROKER_EXPORT int mosquitto_job_submit(mosquitto_plugin_id_t *identifier, MOSQ_FUNC_job_run run_func, MOSQ_FUNC_job_complete complete_func, void *job_data)
+{
+	struct plugin_job *job;
+
+	if(identifier == NULL || run_func == NULL || complete_func == NULL){
+		return MOSQ_ERR_INVAL;
+	}
+
+	if(db.shutdown){
+		/* Nothing will call plugin_jobs__check() again */
+		complete_func(job_data, run_func(job_data));
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	job = mosquitto_calloc(1, sizeof(struct plugin_job));
+	if(job == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	job->worker.run = plugin_job__run;
+	job->identifier = identifier;
+	job->run_func = run_func;
+	job->complete_func = complete_func;
+	job->job_data = job_data;
+
+	if(!started){
+		started = true;
+		pool = worker_pool__new("plugin worker", db.config->plugin_worker_threads);
+	}
+	in_flight++;
+
+	if(pool == NULL){
+		plugin_job__run(&job->worker);
+		local__append(&job->worker);
+		loop__update_next_event(1);
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	worker_pool__submit(pool, &job->worker);
+
+	return MOSQ_ERR_SUCCESS;
+}
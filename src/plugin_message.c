@@ -18,17 +18,51 @@ Contributors:
 
 #include "config.h"
 
+#include <stddef.h>
+
 #include "mosquitto_broker_internal.h"
 #include "utlist.h"
 
+/* The most messages passed in one MOSQ_EVT_MESSAGE_IN_BATCH event */
+#define MESSAGE_IN_BATCH_MAX 1000
+
 struct should_free {
 	bool topic;
 	bool payload;
 	bool properties;
 };
 
+/* Accepted incoming messages waiting for MOSQ_EVT_MESSAGE_IN_BATCH, each
+ * holding a reference. batch_event is used to build the message array for
+ * each callback. */
+static struct mosquitto__base_msg **batch = NULL;
+static const struct mosquitto_base_msg **batch_event = NULL;
+static int batch_count = 0;
+static int batch_alloc = 0;
+
+
+static bool plugin__callback_shared(struct mosquitto__callback *cb)
+{
+	return cb->identifier && cb->identifier->message_out_shared;
+}
+
+
+static bool plugin__has_shared_callbacks(struct mosquitto__callback *callbacks)
+{
+	struct mosquitto__callback *cb_base;
+
+	DL_FOREACH(callbacks, cb_base){
+		if(plugin__callback_shared(cb_base)){
+			return true;
+		}
+	}
+	return false;
+}
+
 
-static int plugin__handle_message_single(struct mosquitto__callback *callbacks, enum mosquitto_plugin_event ev_type, struct should_free *to_free, struct mosquitto *context, struct mosquitto_base_msg *stored)
+/* For MOSQ_EVT_MESSAGE_OUT, only the callbacks of plugins whose shared flag
+ * matches `shared` are called. */
+static int plugin__handle_message_single(struct mosquitto__callback *callbacks, enum mosquitto_plugin_event ev_type, bool shared, struct should_free *to_free, struct mosquitto *context, struct mosquitto_base_msg *stored)
 {
 	struct mosquitto_evt_message event_data;
 	struct mosquitto__callback *cb_base, *cb_next;
@@ -44,7 +78,13 @@ static int plugin__handle_message_single(struct mosquitto__callback *callbacks,
 	event_data.properties = stored->properties;
 
 	DL_FOREACH_SAFE(callbacks, cb_base, cb_next){
-		rc = cb_base->cb((int)ev_type, &event_data, cb_base->userdata);
+		if(!plugin__callback_matches_topic(cb_base, stored->topic)){
+			continue;
+		}
+		if(ev_type == MOSQ_EVT_MESSAGE_OUT && plugin__callback_shared(cb_base) != shared){
+			continue;
+		}
+		rc = plugin__callback_call(cb_base, (int)ev_type, &event_data);
 		if(rc != MOSQ_ERR_SUCCESS){
 			break;
 		}
@@ -91,20 +131,131 @@ int plugin__handle_message_out(struct mosquitto *context, struct mosquitto_base_
 
 	/* Global plugins */
 	rc = plugin__handle_message_single(db.config->security_options.plugin_callbacks.message_out,
-			MOSQ_EVT_MESSAGE_OUT, &to_free, context, stored);
+			MOSQ_EVT_MESSAGE_OUT, false, &to_free, context, stored);
 	if(rc){
 		return rc;
 	}
 
 	if(context->listener){
 		rc = plugin__handle_message_single(context->listener->security_options->plugin_callbacks.message_out,
-				MOSQ_EVT_MESSAGE_OUT, &to_free, context, stored);
+				MOSQ_EVT_MESSAGE_OUT, false, &to_free, context, stored);
+	}
+
+	return rc;
+}
+
+
+/* Free the data that the shared callbacks replaced. */
+void plugin__message_out_cleanup(struct mosquitto__message_out *out)
+{
+	if(out->free_topic){
+		mosquitto_FREE(out->data.topic);
+	}
+	if(out->free_payload){
+		mosquitto_FREE(out->data.payload);
+	}
+	if(out->free_properties){
+		mosquitto_property_free_all(&out->data.properties);
+	}
+	out->free_topic = false;
+	out->free_payload = false;
+	out->free_properties = false;
+}
+
+
+void plugin__message_out_free(struct mosquitto__base_msg *base_msg)
+{
+	struct mosquitto__message_out *out, *next;
+
+	for(out = base_msg->message_out; out; out = next){
+		next = out->next;
+		plugin__message_out_cleanup(out);
+		mosquitto_FREE(out);
+	}
+	base_msg->message_out = NULL;
+}
+
+
+static int plugin__message_out_run(struct mosquitto__security_options *listener_opts, struct mosquitto__base_msg *base_msg, struct mosquitto__message_out *out)
+{
+	struct should_free to_free = {false, false, false};
+	int rc;
+
+	out->data = base_msg->data;
+	out->listener_opts = listener_opts;
+
+	rc = plugin__handle_message_single(db.config->security_options.plugin_callbacks.message_out,
+			MOSQ_EVT_MESSAGE_OUT, true, &to_free, NULL, &out->data);
+	if(rc == MOSQ_ERR_SUCCESS && listener_opts){
+		rc = plugin__handle_message_single(listener_opts->plugin_callbacks.message_out,
+				MOSQ_EVT_MESSAGE_OUT, true, &to_free, NULL, &out->data);
 	}
+	out->rc = rc;
+	out->free_topic = to_free.topic;
+	out->free_payload = to_free.payload;
+	out->free_properties = to_free.properties;
 
 	return rc;
 }
 
 
+/* Call the MOSQ_EVT_MESSAGE_OUT callbacks of plugins that have said their
+ * changes are the same for every recipient. *msg_out is set to the message to
+ * send, which is the base message itself if there are no shared callbacks.
+ *
+ * While sub__messages_queue() is sending the message out, the callbacks are
+ * called once per listener and the results are kept with the base message for
+ * the other recipients, until the fan-out is finished. Clients that receive
+ * the message later, from their queue or as a retained message, get a result
+ * of their own in `local`, so that anything the callbacks add such as a
+ * timestamp is current. The caller must pass `local` to
+ * plugin__message_out_cleanup() once the message has been sent. */
+int plugin__handle_message_out_shared(struct mosquitto *context, struct mosquitto__base_msg *base_msg, struct mosquitto__message_out *local, const struct mosquitto_base_msg **msg_out)
+{
+	struct mosquitto__security_options *listener_opts = NULL;
+	struct mosquitto__message_out *out;
+
+	*msg_out = &base_msg->data;
+
+	/* Recipients on listeners without shared callbacks of their own can all
+	 * use the same result. */
+	if(context->listener
+			&& plugin__has_shared_callbacks(context->listener->security_options->plugin_callbacks.message_out)){
+
+		listener_opts = context->listener->security_options;
+	}
+
+	if(listener_opts == NULL
+			&& !plugin__has_shared_callbacks(db.config->security_options.plugin_callbacks.message_out)){
+
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	if(base_msg->fanout_depth == 0){
+		*msg_out = &local->data;
+		return plugin__message_out_run(listener_opts, base_msg, local);
+	}
+
+	for(out = base_msg->message_out; out; out = out->next){
+		if(out->listener_opts == listener_opts){
+			*msg_out = &out->data;
+			return out->rc;
+		}
+	}
+
+	out = mosquitto_calloc(1, sizeof(struct mosquitto__message_out));
+	if(out == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	plugin__message_out_run(listener_opts, base_msg, out);
+	out->next = base_msg->message_out;
+	base_msg->message_out = out;
+
+	*msg_out = &out->data;
+	return out->rc;
+}
+
+
 int plugin__handle_message_in(struct mosquitto *context, struct mosquitto_base_msg *stored)
 {
 	int rc = MOSQ_ERR_SUCCESS;
@@ -112,15 +263,171 @@ int plugin__handle_message_in(struct mosquitto *context, struct mosquitto_base_m
 
 	/* Global plugins */
 	rc = plugin__handle_message_single(db.config->security_options.plugin_callbacks.message_in,
-			MOSQ_EVT_MESSAGE_IN, &to_free, context, stored);
+			MOSQ_EVT_MESSAGE_IN, false, &to_free, context, stored);
 	if(rc){
 		return rc;
 	}
 
 	if(context->listener){
 		rc = plugin__handle_message_single(context->listener->security_options->plugin_callbacks.message_in,
-				MOSQ_EVT_MESSAGE_IN, &to_free, context, stored);
+				MOSQ_EVT_MESSAGE_IN, false, &to_free, context, stored);
 	}
 
 	return rc;
 }
+
+
+static bool plugin__has_batch_callbacks(struct mosquitto__base_msg *base_msg)
+{
+	if(db.config->security_options.plugin_callbacks.message_in_batch){
+		return true;
+	}
+	return base_msg->source_listener
+			&& base_msg->source_listener->security_options
+			&& base_msg->source_listener->security_options->plugin_callbacks.message_in_batch;
+}
+
+
+/* Hold a newly stored incoming message until the end of this pass of the main
+ * loop, for MOSQ_EVT_MESSAGE_IN_BATCH. */
+void plugin__message_in_batch_add(struct mosquitto__base_msg *base_msg)
+{
+	struct mosquitto__base_msg **new_batch;
+	const struct mosquitto_base_msg **new_event;
+	int new_alloc;
+
+	if(!plugin__has_batch_callbacks(base_msg)){
+		return;
+	}
+
+	if(batch_count == batch_alloc){
+		new_alloc = batch_alloc ? batch_alloc*2 : 64;
+		if(new_alloc > MESSAGE_IN_BATCH_MAX){
+			new_alloc = MESSAGE_IN_BATCH_MAX;
+		}
+		new_batch = mosquitto_realloc(batch, (size_t)new_alloc * sizeof(struct mosquitto__base_msg *));
+		if(new_batch == NULL){
+			return;
+		}
+		batch = new_batch;
+		new_event = mosquitto_realloc(batch_event, (size_t)new_alloc * sizeof(struct mosquitto_base_msg *));
+		if(new_event == NULL){
+			return;
+		}
+		batch_event = new_event;
+		batch_alloc = new_alloc;
+	}
+
+	db__msg_store_ref_inc(base_msg);
+	batch[batch_count] = base_msg;
+	batch_count++;
+
+	if(batch_count == MESSAGE_IN_BATCH_MAX){
+		plugin__handle_message_in_batch();
+	}
+}
+
+
+/* Call each callback with the messages in the batch that it should see. If
+ * listener is set, only messages received on that listener are included. */
+static void plugin__handle_message_in_batch_single(struct mosquitto__callback *callbacks, struct mosquitto__listener *listener)
+{
+	struct mosquitto_evt_message_batch event_data;
+	struct mosquitto__callback *cb_base, *cb_next;
+	int count;
+
+	DL_FOREACH_SAFE(callbacks, cb_base, cb_next){
+		count = 0;
+		for(int i=0; i<batch_count; i++){
+			if(listener && batch[i]->source_listener != listener){
+				continue;
+			}
+			if(!plugin__callback_matches_topic(cb_base, batch[i]->data.topic)){
+				continue;
+			}
+			batch_event[count] = &batch[i]->data;
+			count++;
+		}
+		if(count == 0){
+			continue;
+		}
+
+		memset(&event_data, 0, sizeof(event_data));
+		event_data.messages = batch_event;
+		event_data.message_count = count;
+		plugin__callback_call(cb_base, MOSQ_EVT_MESSAGE_IN_BATCH, &event_data);
+	}
+}
+
+
+void plugin__handle_message_in_batch(void)
+{
+	struct mosquitto__listener *listener;
+
+	if(batch_count == 0){
+		return;
+	}
+
+	/* Global plugins */
+	plugin__handle_message_in_batch_single(db.config->security_options.plugin_callbacks.message_in_batch, NULL);
+
+	for(int i=0; i<db.config->listener_count; i++){
+		listener = &db.config->listeners[i];
+		if(listener->security_options && listener->security_options->plugin_callbacks.message_in_batch){
+			plugin__handle_message_in_batch_single(listener->security_options->plugin_callbacks.message_in_batch, listener);
+		}
+	}
+
+	for(int i=0; i<batch_count; i++){
+		db__msg_store_ref_dec(&batch[i]);
+	}
+	batch_count = 0;
+}
+
+
+void plugin__message_in_batch_cleanup(void)
+{
+	plugin__handle_message_in_batch();
+	mosquitto_FREE(batch);
+	mosquitto_FREE(batch_event);
+	batch_alloc = 0;
+}
+
+
+static struct mosquitto__base_msg *plugin__base_msg_from_data(const struct mosquitto_base_msg *msg)
+{
+	return (struct mosquitto__base_msg *)((uintptr_t)msg - offsetof(struct mosquitto__base_msg, data));
+}
+
+
+BROKER_EXPORT void mosquitto_base_msg_ref_inc(const struct mosquitto_base_msg *msg)
+{
+	if(msg == NULL){
+		return;
+	}
+	db__msg_store_ref_inc(plugin__base_msg_from_data(msg));
+}
+
+
+BROKER_EXPORT void mosquitto_base_msg_ref_dec(const struct mosquitto_base_msg *msg)
+{
+	struct mosquitto__base_msg *base_msg;
+
+	/* The message store has already been freed during shutdown */
+	if(msg == NULL || db.msg_store == NULL){
+		return;
+	}
+	base_msg = plugin__base_msg_from_data(msg);
+	db__msg_store_ref_dec(&base_msg);
+}
+
+
+BROKER_EXPORT int mosquitto_plugin_set_message_out_shared(mosquitto_plugin_id_t *identifier, bool shared)
+{
+	if(identifier == NULL){
+		return MOSQ_ERR_INVAL;
+	}
+
+	identifier->message_out_shared = shared;
+	return MOSQ_ERR_SUCCESS;
+}
@@ -40,7 +40,7 @@ void plugin_persist__handle_restore(void)
 	memset(&event_data, 0, sizeof(event_data));
 
 	DL_FOREACH_SAFE(opts->plugin_callbacks.persist_restore, cb_base, cb_next){
-		cb_base->cb(MOSQ_EVT_PERSIST_RESTORE, &event_data, cb_base->userdata);
+		plugin__callback_call(cb_base, MOSQ_EVT_PERSIST_RESTORE, &event_data);
 	}
 }
 
@@ -74,7 +74,7 @@ void plugin_persist__handle_client_add(struct mosquitto *context)
 	event_data.data.max_packet_size = context->maximum_packet_size;
 
 	DL_FOREACH_SAFE(opts->plugin_callbacks.persist_client_add, cb_base, cb_next){
-		cb_base->cb(MOSQ_EVT_PERSIST_CLIENT_ADD, &event_data, cb_base->userdata);
+		plugin__callback_call(cb_base, MOSQ_EVT_PERSIST_CLIENT_ADD, &event_data);
 	}
 
 	if(context->will){
@@ -117,7 +117,7 @@ void plugin_persist__handle_client_update(struct mosquitto *context)
 	event_data.data.max_packet_size = context->maximum_packet_size;
 
 	DL_FOREACH_SAFE(opts->plugin_callbacks.persist_client_update, cb_base, cb_next){
-		cb_base->cb(MOSQ_EVT_PERSIST_CLIENT_UPDATE, &event_data, cb_base->userdata);
+		plugin__callback_call(cb_base, MOSQ_EVT_PERSIST_CLIENT_UPDATE, &event_data);
 	}
 
 	if(context->will){
@@ -152,7 +152,7 @@ void plugin_persist__handle_client_delete(struct mosquitto *context)
 	event_data.data.clientid = context->id;
 
 	DL_FOREACH_SAFE(opts->plugin_callbacks.persist_client_delete, cb_base, cb_next){
-		cb_base->cb(MOSQ_EVT_PERSIST_CLIENT_DELETE, &event_data, cb_base->userdata);
+		plugin__callback_call(cb_base, MOSQ_EVT_PERSIST_CLIENT_DELETE, &event_data);
 	}
 	context->is_persisted = false;
 }
@@ -176,7 +176,7 @@ void plugin_persist__handle_subscription_add(struct mosquitto *context, const st
 	event_data.data.options = sub->options;
 
 	DL_FOREACH_SAFE(opts->plugin_callbacks.persist_subscription_add, cb_base, cb_next){
-		cb_base->cb(MOSQ_EVT_PERSIST_SUBSCRIPTION_ADD, &event_data, cb_base->userdata);
+		plugin__callback_call(cb_base, MOSQ_EVT_PERSIST_SUBSCRIPTION_ADD, &event_data);
 	}
 }
 
@@ -200,7 +200,7 @@ void plugin_persist__handle_subscription_delete(struct mosquitto *context, char
 	event_data.data.topic_filter = sub;
 
 	DL_FOREACH_SAFE(opts->plugin_callbacks.persist_subscription_delete, cb_base, cb_next){
-		cb_base->cb(MOSQ_EVT_PERSIST_SUBSCRIPTION_DELETE, &event_data, cb_base->userdata);
+		plugin__callback_call(cb_base, MOSQ_EVT_PERSIST_SUBSCRIPTION_DELETE, &event_data);
 	}
 }
 
@@ -239,7 +239,7 @@ void plugin_persist__handle_client_msg_add(struct mosquitto *context, const stru
 	set_client_msg_event_data(&event_data, context, client_msg);
 
 	DL_FOREACH_SAFE(opts->plugin_callbacks.persist_client_msg_add, cb_base, cb_next){
-		cb_base->cb(MOSQ_EVT_PERSIST_CLIENT_MSG_ADD, &event_data, cb_base->userdata);
+		plugin__callback_call(cb_base, MOSQ_EVT_PERSIST_CLIENT_MSG_ADD, &event_data);
 	}
 }
 
@@ -263,7 +263,7 @@ void plugin_persist__handle_client_msg_delete(struct mosquitto *context, const s
 	set_client_msg_event_data(&event_data, context, client_msg);
 
 	DL_FOREACH_SAFE(opts->plugin_callbacks.persist_client_msg_delete, cb_base, cb_next){
-		cb_base->cb(MOSQ_EVT_PERSIST_CLIENT_MSG_DELETE, &event_data, cb_base->userdata);
+		plugin__callback_call(cb_base, MOSQ_EVT_PERSIST_CLIENT_MSG_DELETE, &event_data);
 	}
 }
 
@@ -287,7 +287,7 @@ void plugin_persist__handle_client_msg_update(struct mosquitto *context, const s
 	set_client_msg_event_data(&event_data, context, client_msg);
 
 	DL_FOREACH_SAFE(opts->plugin_callbacks.persist_client_msg_update, cb_base, cb_next){
-		cb_base->cb(MOSQ_EVT_PERSIST_CLIENT_MSG_UPDATE, &event_data, cb_base->userdata);
+		plugin__callback_call(cb_base, MOSQ_EVT_PERSIST_CLIENT_MSG_UPDATE, &event_data);
 	}
 }
 
@@ -323,7 +323,7 @@ void plugin_persist__handle_base_msg_add(struct mosquitto__base_msg *base_msg)
 	event_data.data.retain = base_msg->data.retain;
 
 	DL_FOREACH_SAFE(opts->plugin_callbacks.persist_base_msg_add, cb_base, cb_next){
-		cb_base->cb(MOSQ_EVT_PERSIST_BASE_MSG_ADD, &event_data, cb_base->userdata);
+		plugin__callback_call(cb_base, MOSQ_EVT_PERSIST_BASE_MSG_ADD, &event_data);
 	}
 	base_msg->stored = true;
 }
@@ -345,7 +345,7 @@ void plugin_persist__handle_base_msg_delete(struct mosquitto__base_msg *base_msg
 	event_data.data.store_id = base_msg->data.store_id;
 
 	DL_FOREACH_SAFE(opts->plugin_callbacks.persist_base_msg_delete, cb_base, cb_next){
-		cb_base->cb(MOSQ_EVT_PERSIST_BASE_MSG_DELETE, &event_data, cb_base->userdata);
+		plugin__callback_call(cb_base, MOSQ_EVT_PERSIST_BASE_MSG_DELETE, &event_data);
 	}
 	base_msg->stored = false;
 }
@@ -368,7 +368,7 @@ void plugin_persist__handle_retain_msg_set(struct mosquitto__base_msg *base_msg)
 	event_data.topic = base_msg->data.topic;
 
 	DL_FOREACH_SAFE(opts->plugin_callbacks.persist_retain_msg_set, cb_base, cb_next){
-		cb_base->cb(MOSQ_EVT_PERSIST_RETAIN_MSG_SET, &event_data, cb_base->userdata);
+		plugin__callback_call(cb_base, MOSQ_EVT_PERSIST_RETAIN_MSG_SET, &event_data);
 	}
 }
 
@@ -389,7 +389,7 @@ void plugin_persist__handle_retain_msg_delete(struct mosquitto__base_msg *base_m
 	event_data.topic = base_msg->data.topic;
 
 	DL_FOREACH_SAFE(opts->plugin_callbacks.persist_retain_msg_delete, cb_base, cb_next){
-		cb_base->cb(MOSQ_EVT_PERSIST_RETAIN_MSG_DELETE, &event_data, cb_base->userdata);
+		plugin__callback_call(cb_base, MOSQ_EVT_PERSIST_RETAIN_MSG_DELETE, &event_data);
 	}
 }
 
@@ -417,7 +417,7 @@ void plugin_persist__handle_will_add(struct mosquitto *context)
 	event_data.data.properties = context->will->properties;
 
 	DL_FOREACH_SAFE(opts->plugin_callbacks.persist_will_add, cb_base, cb_next){
-		cb_base->cb(MOSQ_EVT_PERSIST_WILL_ADD, &event_data, cb_base->userdata);
+		plugin__callback_call(cb_base, MOSQ_EVT_PERSIST_WILL_ADD, &event_data);
 	}
 }
 
@@ -437,7 +437,7 @@ void plugin_persist__handle_will_delete(struct mosquitto *context)
 
 	opts = &db.config->security_options;
 	DL_FOREACH_SAFE(opts->plugin_callbacks.persist_will_delete, cb_base, cb_next){
-		cb_base->cb(MOSQ_EVT_PERSIST_WILL_ADD, &event_data, cb_base->userdata);
+		plugin__callback_call(cb_base, MOSQ_EVT_PERSIST_WILL_ADD, &event_data);
 	}
 
 }
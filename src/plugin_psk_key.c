@@ -42,7 +42,7 @@ static int plugin__psk_key_get(struct mosquitto__security_options *opts, struct
 		event_data.identity = identity;
 		event_data.key = key;
 		event_data.max_key_len = max_key_len;
-		rc = cb_base->cb(MOSQ_EVT_PSK_KEY, &event_data, cb_base->userdata);
+		rc = plugin__callback_call(cb_base, MOSQ_EVT_PSK_KEY, &event_data);
 		if(rc == MOSQ_ERR_PLUGIN_IGNORE){
 			/* Do nothing */
 		}else if(rc == MOSQ_ERR_PLUGIN_DEFER){
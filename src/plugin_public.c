@@ -210,6 +210,48 @@ BROKER_EXPORT const char *mosquitto_client_username(const struct mosquitto *clie
 }
 
 
+/* db.plugin_msgs is a lock free stack, so that mosquitto_broker_publish() can
+ * be called from any thread. Returns true if the stack was empty. */
+static bool plugin_msgs__push(struct mosquitto__message_v5 *msg)
+{
+	struct mosquitto__message_v5 *head;
+
+#ifdef _MSC_VER
+	do{
+		head = db.plugin_msgs;
+		msg->next = head;
+	}while(InterlockedCompareExchangePointer((PVOID volatile *)&db.plugin_msgs, msg, head) != head);
+#else
+	head = __atomic_load_n(&db.plugin_msgs, __ATOMIC_RELAXED);
+	do{
+		msg->next = head;
+	}while(!__atomic_compare_exchange_n(&db.plugin_msgs, &head, msg, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+#endif
+
+	return head == NULL;
+}
+
+
+/* Take every message published so far, oldest first. Main thread only. */
+struct mosquitto__message_v5 *plugin_msgs__take(void)
+{
+	struct mosquitto__message_v5 *msg, *next, *list = NULL;
+
+#ifdef _MSC_VER
+	msg = InterlockedExchangePointer((PVOID volatile *)&db.plugin_msgs, NULL);
+#else
+	msg = __atomic_exchange_n(&db.plugin_msgs, NULL, __ATOMIC_ACQUIRE);
+#endif
+
+	for(; msg; msg = next){
+		next = msg->next;
+		msg->next = list;
+		list = msg;
+	}
+	return list;
+}
+
+
 BROKER_EXPORT int mosquitto_broker_publish(
 		const char *clientid,
 		const char *topic,
@@ -257,8 +299,20 @@ BROKER_EXPORT int mosquitto_broker_publish(
 	msg->retain = retain;
 	msg->properties = properties;
 
-	DL_APPEND(db.plugin_msgs, msg);
-
+#ifndef WIN32
+	if(!pthread_equal(pthread_self(), db.main_thread)){
+		/* The main loop may be waiting in mux__handle(). If the stack wasn't
+		 * empty, whoever pushed first has already woken it. */
+		if(plugin_msgs__push(msg)){
+			(void)mux__wakeup();
+		}
+		return MOSQ_ERR_SUCCESS;
+	}
+#endif
+	/* On the main thread there is no need to wake the loop, the message is
+	 * queued on its next pass. Waking it here would make a tick callback that
+	 * publishes and asks to be called again straight away spin the loop. */
+	plugin_msgs__push(msg);
 	loop__update_next_event(1);
 	return MOSQ_ERR_SUCCESS;
 }
@@ -329,6 +383,7 @@ BROKER_EXPORT int mosquitto_set_username(struct mosquitto *client, const char *u
 
 	old = client->username;
 	client->username = u_dup;
+	sub__acl_cache_reset(client);
 
 	mosquitto_FREE(old);
 	return MOSQ_ERR_SUCCESS;
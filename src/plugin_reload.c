@@ -34,7 +34,7 @@ static int plugin__handle_reload_single(struct mosquitto__security_options *opts
 
 	// Using DL_FOREACH_SAFE here, as reload callbacks might unregister themself
 	DL_FOREACH_SAFE(opts->plugin_callbacks.reload, cb_base, cb_next){
-		int rc = cb_base->cb(MOSQ_EVT_RELOAD, &event_data, cb_base->userdata);
+		int rc = plugin__callback_call(cb_base, MOSQ_EVT_RELOAD, &event_data);
 		if(rc){
 			log__printf(NULL, MOSQ_LOG_ERR, "Error: Plugin %s produced error on reload: %s",
 					cb_base->identifier->plugin_name?cb_base->identifier->plugin_name:"",
@@ -52,6 +52,9 @@ int plugin__handle_reload(void)
 	struct mosquitto__security_options *opts;
 	int rc;
 
+	/* Plugins may change their ACLs on reload */
+	db.acl_generation++;
+
 	/* Global plugins */
 	rc = plugin__handle_reload_single(&db.config->security_options);
 	if(rc){
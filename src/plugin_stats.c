@@ -0,0 +1,337 @@
+/*
+Copyright (c) 2026 Roger Light <roger@atchoo.org>
+
+All rights reserved. This program and the accompanying materials
+are made available under the terms of the Eclipse Public License 2.0
+and Eclipse Distribution License v1.0 which accompany this distribution.
+
+The Eclipse Public License is available at
+   https://www.eclipse.org/legal/epl-2.0/
+and the Eclipse Distribution License is available at
+  http://www.eclipse.org/org/documents/edl-v10.php.
+
+SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+
+Contributors:
+   Roger Light - initial implementation and documentation.
+*/
+
+/* Plugin callback statistics
+ *
+ * Every plugin callback is called through plugin__callback_call(), which
+ * times the call and records it against the plugin and event. Each
+ * plugin/event pair has a call count, total and maximum time, and a log
+ * linear histogram of call times. The histogram has four buckets for each
+ * power of two, so a percentile taken from it is within 25% of the true
+ * value, which is enough to tell a 10us callback from a 10ms one.
+ *
+ * The statistics are made available through $SYS, the broker control API
+ * getPluginStats command, and the HTTP API /api/v1/plugin-stats endpoint.
+ */
+
+#include "config.h"
+
+#include <cjson/cJSON.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#ifdef WIN32
+#  include <windows.h>
+#endif
+
+#include "mosquitto_broker_internal.h"
+
+#define STATS_SUB_BITS 2
+#define STATS_SUB_COUNT (1<<STATS_SUB_BITS)
+/* Buckets 140-143 split 2^36 to 2^37 ns, about 69 to 137 s. The last of those
+ * starts at 7<<34 ns, just over two minutes, and also holds anything longer. */
+#define PLUGIN_STATS_BUCKETS 144
+
+#ifdef WITH_SYS_TREE
+#  define SYS_TREE_QOS 2
+#endif
+
+struct plugin__callback_stats {
+	uint64_t count;
+	uint64_t total_ns;
+	uint64_t max_ns;
+	uint64_t sys_count; /* count at the last $SYS update */
+	uint64_t buckets[PLUGIN_STATS_BUCKETS];
+};
+
+
+static uint64_t stats__now_ns(void)
+{
+#ifdef WIN32
+	static LARGE_INTEGER freq = {0};
+	LARGE_INTEGER now;
+
+	if(freq.QuadPart == 0){
+		QueryPerformanceFrequency(&freq);
+	}
+	QueryPerformanceCounter(&now);
+	return (uint64_t)(now.QuadPart / freq.QuadPart) * 1000000000
+		+ (uint64_t)(now.QuadPart % freq.QuadPart) * 1000000000 / (uint64_t)freq.QuadPart;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+
+/* Values below 8ns have their own bucket, above that each power of two is
+ * split into STATS_SUB_COUNT buckets. */
+static int stats__bucket(uint64_t ns)
+{
+	int msb;
+	int bucket;
+
+	if(ns < 2*STATS_SUB_COUNT){
+		return (int)ns;
+	}
+#if defined(__GNUC__) || defined(__clang__)
+	msb = 63 - __builtin_clzll(ns);
+#else
+	msb = 0;
+	for(uint64_t v = ns; v > 1; v >>= 1){
+		msb++;
+	}
+#endif
+	bucket = (msb - STATS_SUB_BITS + 1)*STATS_SUB_COUNT
+		+ (int)((ns >> (msb - STATS_SUB_BITS)) & (STATS_SUB_COUNT-1));
+
+	if(bucket >= PLUGIN_STATS_BUCKETS){
+		bucket = PLUGIN_STATS_BUCKETS-1;
+	}
+	return bucket;
+}
+
+
+static uint64_t stats__bucket_lower(int bucket)
+{
+	int msb;
+
+	if(bucket < 2*STATS_SUB_COUNT){
+		return (uint64_t)bucket;
+	}
+	msb = bucket/STATS_SUB_COUNT + STATS_SUB_BITS - 1;
+	return (uint64_t)(STATS_SUB_COUNT + bucket%STATS_SUB_COUNT) << (msb - STATS_SUB_BITS);
+}
+
+
+/* Returns the upper bound of the bucket holding the given percentile, or the
+ * maximum if that is lower. */
+static uint64_t stats__percentile(const struct plugin__callback_stats *stats, int percentile)
+{
+	uint64_t target, seen = 0;
+
+	if(stats->count == 0){
+		return 0;
+	}
+	target = (stats->count * (uint64_t)percentile + 99) / 100;
+	for(int i=0; i<PLUGIN_STATS_BUCKETS-1; i++){
+		seen += stats->buckets[i];
+		if(seen >= target){
+			uint64_t upper = stats__bucket_lower(i+1) - 1;
+			return upper < stats->max_ns ? upper : stats->max_ns;
+		}
+	}
+	return stats->max_ns;
+}
+
+
+static void stats__record(mosquitto_plugin_id_t *identifier, int event, uint64_t elapsed)
+{
+	struct plugin__callback_stats *stats;
+
+	stats = identifier->callback_stats[event];
+	if(stats == NULL){
+		stats = mosquitto_calloc(1, sizeof(struct plugin__callback_stats));
+		if(stats == NULL){
+			return;
+		}
+		identifier->callback_stats[event] = stats;
+	}
+
+	stats->count++;
+	stats->total_ns += elapsed;
+	if(elapsed > stats->max_ns){
+		stats->max_ns = elapsed;
+	}
+	stats->buckets[stats__bucket(elapsed)]++;
+}
+
+
+int plugin__callback_call(struct mosquitto__callback *cb_base, int event, void *event_data)
+{
+	mosquitto_plugin_id_t *identifier = cb_base->identifier;
+	uint64_t start;
+	int rc;
+
+	if(identifier == NULL || event <= 0 || event >= PLUGIN_EVENT_COUNT){
+		return cb_base->cb(event, event_data, cb_base->userdata);
+	}
+
+	/* The callback may unregister itself, so cb_base must not be used
+	 * after this point. */
+	start = stats__now_ns();
+	rc = cb_base->cb(event, event_data, cb_base->userdata);
+	stats__record(identifier, event, stats__now_ns() - start);
+
+	return rc;
+}
+
+
+void plugin_stats__cleanup(mosquitto_plugin_id_t *identifier)
+{
+	for(int i=0; i<PLUGIN_EVENT_COUNT; i++){
+		mosquitto_FREE(identifier->callback_stats[i]);
+	}
+}
+
+
+static int stats__add_event_json(cJSON *j_events, int event, const struct plugin__callback_stats *stats)
+{
+	cJSON *j_event;
+
+	j_event = cJSON_CreateObject();
+	if(j_event == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	cJSON_AddItemToArray(j_events, j_event);
+
+	if(cJSON_AddStringToObject(j_event, "event", plugin__event_name((enum mosquitto_plugin_event)event)) == NULL
+			|| cJSON_AddNumberToObject(j_event, "count", (double)stats->count) == NULL
+			|| cJSON_AddNumberToObject(j_event, "total-ns", (double)stats->total_ns) == NULL
+			|| cJSON_AddNumberToObject(j_event, "max-ns", (double)stats->max_ns) == NULL
+			|| cJSON_AddNumberToObject(j_event, "p50-ns", (double)stats__percentile(stats, 50)) == NULL
+			|| cJSON_AddNumberToObject(j_event, "p90-ns", (double)stats__percentile(stats, 90)) == NULL
+			|| cJSON_AddNumberToObject(j_event, "p99-ns", (double)stats__percentile(stats, 99)) == NULL
+			){
+
+		return MOSQ_ERR_NOMEM;
+	}
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+static int stats__add_plugin_json(cJSON *j_plugins, mosquitto_plugin_id_t *pid)
+{
+	cJSON *j_plugin, *j_events;
+
+	if(pid->plugin_name == NULL){
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	j_plugin = cJSON_CreateObject();
+	if(j_plugin == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	cJSON_AddItemToArray(j_plugins, j_plugin);
+
+	if(cJSON_AddStringToObject(j_plugin, "name", pid->plugin_name) == NULL
+			|| (pid->listener && cJSON_AddNumberToObject(j_plugin, "port", pid->listener->port) == NULL)
+			|| (j_events = cJSON_AddArrayToObject(j_plugin, "events")) == NULL
+			){
+
+		return MOSQ_ERR_NOMEM;
+	}
+
+	for(int i=0; i<PLUGIN_EVENT_COUNT; i++){
+		if(pid->callback_stats[i] && stats__add_event_json(j_events, i, pid->callback_stats[i])){
+			return MOSQ_ERR_NOMEM;
+		}
+	}
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+/* Adds an object for each named plugin to the j_plugins array. */
+int plugin_stats__add_json(cJSON *j_plugins)
+{
+	for(int i=0; i<db.plugin_count; i++){
+		if(stats__add_plugin_json(j_plugins, db.plugins[i])){
+			return MOSQ_ERR_NOMEM;
+		}
+	}
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+#ifdef WITH_SYS_TREE
+/* The plugin name is used as a single topic level, so topic separators and
+ * wildcards are replaced. Names that can't be used at all are replaced with
+ * the plugin's index. */
+static void stats__sys_plugin_name(const char *plugin_name, int index, char *buf, size_t len)
+{
+	size_t namelen = strlen(plugin_name);
+
+	if(namelen == 0 || namelen >= len
+			|| mosquitto_validate_utf8(plugin_name, (int)namelen) != MOSQ_ERR_SUCCESS){
+
+		snprintf(buf, len, "%d", index);
+		return;
+	}
+	for(size_t i=0; i<namelen; i++){
+		if(plugin_name[i] == '/' || plugin_name[i] == '+' || plugin_name[i] == '#'){
+			buf[i] = '_';
+		}else{
+			buf[i] = plugin_name[i];
+		}
+	}
+	buf[namelen] = '\0';
+}
+
+
+static void stats__sys_publish(const char *plugin_name, const char *event_name, const char *metric, uint64_t value)
+{
+	char topic[300];
+	char buf[30];
+	int len;
+
+	snprintf(topic, sizeof(topic), "$SYS/broker/plugins/%s/%s/%s", plugin_name, event_name, metric);
+	len = snprintf(buf, sizeof(buf), "%" PRIu64, value);
+	db__messages_easy_queue(NULL, topic, SYS_TREE_QOS, (uint32_t)len, buf, 1, MSG_EXPIRY_INFINITE, NULL);
+}
+
+
+/* Called from sys_tree__update(). Only plugin/event pairs that have been
+ * called since the last update are published. */
+void plugin_stats__sys_tree_update(void)
+{
+	mosquitto_plugin_id_t *pid;
+	struct plugin__callback_stats *stats;
+	const char *event_name;
+	char plugin_name[200];
+
+	for(int i=0; i<db.plugin_count; i++){
+		pid = db.plugins[i];
+		if(pid->plugin_name == NULL){
+			continue;
+		}
+		plugin_name[0] = '\0';
+		for(int j=0; j<PLUGIN_EVENT_COUNT; j++){
+			stats = pid->callback_stats[j];
+			if(stats == NULL || stats->count == stats->sys_count){
+				continue;
+			}
+			stats->sys_count = stats->count;
+			if(plugin_name[0] == '\0'){
+				stats__sys_plugin_name(pid->plugin_name, i, plugin_name, sizeof(plugin_name));
+			}
+
+			event_name = plugin__event_name((enum mosquitto_plugin_event)j);
+			stats__sys_publish(plugin_name, event_name, "count", stats->count);
+			stats__sys_publish(plugin_name, event_name, "max-ns", stats->max_ns);
+			stats__sys_publish(plugin_name, event_name, "p50-ns", stats__percentile(stats, 50));
+			stats__sys_publish(plugin_name, event_name, "p90-ns", stats__percentile(stats, 90));
+			stats__sys_publish(plugin_name, event_name, "p99-ns", stats__percentile(stats, 99));
+		}
+	}
+}
+#endif
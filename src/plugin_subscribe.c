@@ -37,7 +37,7 @@ static int plugin__handle_subscribe_single(struct mosquitto__security_options *o
 	event_data.data.properties = sub->properties;
 
 	DL_FOREACH_SAFE(opts->plugin_callbacks.subscribe, cb_base, cb_next){
-		rc = cb_base->cb(MOSQ_EVT_SUBSCRIBE, &event_data, cb_base->userdata);
+		rc = plugin__callback_call(cb_base, MOSQ_EVT_SUBSCRIBE, &event_data);
 		if(rc != MOSQ_ERR_SUCCESS){
 			break;
 		}
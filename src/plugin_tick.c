@@ -41,7 +41,7 @@ static void plugin__handle_tick_single(struct mosquitto__security_options *opts)
 
 			event_data.next_s = 0;
 			event_data.next_ms = 0;
-			cb_base->cb(MOSQ_EVT_TICK, &event_data, cb_base->userdata);
+			plugin__callback_call(cb_base, MOSQ_EVT_TICK, &event_data);
 			loop__update_next_event(event_data.next_s * 1000 + event_data.next_ms);
 
 			cb_base->data.next_tick.tv_sec = event_data.now_s + event_data.next_s;
@@ -35,7 +35,7 @@ static int plugin__handle_unsubscribe_single(struct mosquitto__security_options
 	event_data.data.properties = sub->properties;
 
 	DL_FOREACH_SAFE(opts->plugin_callbacks.unsubscribe, cb_base, cb_next){
-		rc = cb_base->cb(MOSQ_EVT_UNSUBSCRIBE, &event_data, cb_base->userdata);
+		rc = plugin__callback_call(cb_base, MOSQ_EVT_UNSUBSCRIBE, &event_data);
 		if(rc != MOSQ_ERR_SUCCESS){
 			break;
 		}
@@ -124,10 +124,28 @@ BROKER_EXPORT int mosquitto_persist_retain_msg_delete(const char *topic)
 }
 
 
+/* With persistence_incremental_retain, entries whose retained message has
+ * changed are kept on db.retain_dirty until the next save writes them to the
+ * retain log. Dirty entries are not freed, so that a cleared topic can still
+ * be written out. */
+static void retain__mark_dirty(struct mosquitto__retainhier *retainhier, const char *topic)
+{
+	if(db.config == NULL || !db.config->persistence || !db.config->persistence_incremental_retain){
+		return;
+	}
+	if(retainhier->dirty || !strncmp(topic, "$SYS", 4)){
+		return;
+	}
+	retainhier->dirty = true;
+	retainhier->dirty_next = db.retain_dirty;
+	db.retain_dirty = retainhier;
+}
+
+
 void retain__clean_empty_hierarchy(struct mosquitto__retainhier *retainhier)
 {
 	while(retainhier){
-		if(retainhier->children || retainhier->retained || retainhier->parent == NULL){
+		if(retainhier->children || retainhier->retained || retainhier->dirty || retainhier->parent == NULL){
 			/* Entry is being used */
 			return;
 		}else{
@@ -141,6 +159,22 @@ void retain__clean_empty_hierarchy(struct mosquitto__retainhier *retainhier)
 }
 
 
+void retain__dirty_clear(void)
+{
+	struct mosquitto__retainhier *retainhier, *next;
+
+	retainhier = db.retain_dirty;
+	db.retain_dirty = NULL;
+	while(retainhier){
+		next = retainhier->dirty_next;
+		retainhier->dirty = false;
+		retainhier->dirty_next = NULL;
+		retain__clean_empty_hierarchy(retainhier);
+		retainhier = next;
+	}
+}
+
+
 int retain__store(const char *topic, struct mosquitto__base_msg *base_msg, char **split_topics, bool persist)
 {
 	struct mosquitto__retainhier *retainhier;
@@ -185,6 +219,8 @@ int retain__store(const char *topic, struct mosquitto__base_msg *base_msg, char
 			/* This may occur if multiple persistence providers are used */
 			return MOSQ_ERR_SUCCESS;
 		}
+		retain__mark_dirty(retainhier, topic);
+		retainhier->retained->retain_logged = false;
 
 		if(persist && retainhier->retained->data.topic[0] != '$' && base_msg->data.payloadlen == 0){
 			/* Only delete if another retained message isn't replacing this one */
@@ -200,6 +236,7 @@ int retain__store(const char *topic, struct mosquitto__base_msg *base_msg, char
 		}
 	}
 	if(base_msg->data.payloadlen){
+		retain__mark_dirty(retainhier, topic);
 		retainhier->retained = base_msg;
 		db__msg_store_ref_inc(retainhier->retained);
 		if(persist && retainhier->retained->data.topic[0] != '$'){
@@ -219,6 +256,8 @@ static bool retain__delete_expired_msg(struct mosquitto__retainhier *branch)
 {
 	if(branch->retained && branch->retained->data.expiry_time > 0 && db.now_real_s >= branch->retained->data.expiry_time){
 		plugin_persist__handle_retain_msg_delete(branch->retained);
+		retain__mark_dirty(branch, branch->retained->data.topic);
+		branch->retained->retain_logged = false;
 		db__msg_store_ref_dec(&branch->retained);
 		branch->retained = NULL;
 #ifdef WITH_SYS_TREE
@@ -230,7 +269,7 @@ static bool retain__delete_expired_msg(struct mosquitto__retainhier *branch)
 }
 
 
-static int retain__process(struct mosquitto__retainhier *branch, struct mosquitto *context, const struct mosquitto_subscription *sub)
+static int retain__process(struct mosquitto__retainhier *branch, struct mosquitto *context, const struct mosquitto_subscription *sub, const struct sub__filter *filter)
 {
 	int rc = 0;
 	uint8_t qos, sub_qos;
@@ -243,6 +282,14 @@ static int retain__process(struct mosquitto__retainhier *branch, struct mosquitt
 
 	retained = branch->retained;
 
+	if(filter){
+		bool match = sub_filter__match(filter, retained);
+		sub_filter__payload_release();
+		if(!match){
+			return MOSQ_ERR_SUCCESS;
+		}
+	}
+
 	rc = mosquitto_acl_check(context, retained->data.topic, retained->data.payloadlen, retained->data.payload,
 			retained->data.qos, retained->data.retain, retained->data.properties, MOSQ_ACL_READ);
 	if(rc == MOSQ_ERR_ACL_DENIED){
@@ -287,7 +334,7 @@ static int retain__process(struct mosquitto__retainhier *branch, struct mosquitt
 }
 
 
-static int retain__search(struct mosquitto__retainhier *retainhier, char **split_topics, struct mosquitto *context, const struct mosquitto_subscription *sub, int level)
+static int retain__search(struct mosquitto__retainhier *retainhier, char **split_topics, struct mosquitto *context, const struct mosquitto_subscription *sub, const struct sub__filter *filter, int level)
 {
 	struct mosquitto__retainhier *branch, *branch_tmp;
 	int flag = 0;
@@ -300,26 +347,26 @@ static int retain__search(struct mosquitto__retainhier *retainhier, char **split
 			 */
 			flag = -1;
 			if(branch->retained){
-				retain__process(branch, context, sub);
+				retain__process(branch, context, sub, filter);
 			}
 			if(branch->children){
-				retain__search(branch, split_topics, context, sub, level+1);
+				retain__search(branch, split_topics, context, sub, filter, level+1);
 			}
 		}
 	}else{
 		if(!strcmp(split_topics[0], "+")){
 			HASH_ITER(hh, retainhier->children, branch, branch_tmp){
 				if(split_topics[1] != NULL){
-					if(retain__search(branch, &(split_topics[1]), context, sub, level+1) == -1
+					if(retain__search(branch, &(split_topics[1]), context, sub, filter, level+1) == -1
 							|| (split_topics[1] != NULL && !strcmp(split_topics[1], "#") && level>0)){
 
 						if(branch->retained){
-							retain__process(branch, context, sub);
+							retain__process(branch, context, sub, filter);
 						}
 					}
 				}else{
 					if(branch->retained){
-						retain__process(branch, context, sub);
+						retain__process(branch, context, sub, filter);
 					}
 				}
 			}
@@ -327,16 +374,16 @@ static int retain__search(struct mosquitto__retainhier *retainhier, char **split
 			HASH_FIND(hh, retainhier->children, split_topics[0], strlen(split_topics[0]), branch);
 			if(branch){
 				if(split_topics[1] != NULL){
-					if(retain__search(branch, &(split_topics[1]), context, sub, level+1) == -1
+					if(retain__search(branch, &(split_topics[1]), context, sub, filter, level+1) == -1
 							|| (split_topics[1] != NULL && !strcmp(split_topics[1], "#") && level>0)){
 
 						if(branch->retained){
-							retain__process(branch, context, sub);
+							retain__process(branch, context, sub, filter);
 						}
 					}
 				}else{
 					if(branch->retained){
-						retain__process(branch, context, sub);
+						retain__process(branch, context, sub, filter);
 					}
 				}
 			}
@@ -349,6 +396,8 @@ static int retain__search(struct mosquitto__retainhier *retainhier, char **split
 int retain__queue(struct mosquitto *context, const struct mosquitto_subscription *sub)
 {
 	struct mosquitto__retainhier *retainhier;
+	struct sub__filter *filter;
+	const char *topic_filter;
 	char *local_sub;
 	char **split_topics;
 	int rc;
@@ -360,16 +409,27 @@ int retain__queue(struct mosquitto *context, const struct mosquitto_subscription
 		return MOSQ_ERR_SUCCESS;
 	}
 
-	rc = sub__topic_tokenise(sub->topic_filter, &local_sub, &split_topics, NULL);
+	topic_filter = sub_filter__topic(sub->topic_filter);
+	if(topic_filter == NULL){
+		return MOSQ_ERR_INVAL;
+	}
+	rc = sub_filter__compile(sub->topic_filter, &filter);
+	if(rc){
+		return rc;
+	}
+
+	rc = sub__topic_tokenise(topic_filter, &local_sub, &split_topics, NULL);
 	if(rc){
+		sub_filter__free(&filter);
 		return rc;
 	}
 
 	HASH_FIND(hh, db.retains, split_topics[0], strlen(split_topics[0]), retainhier);
 
 	if(retainhier){
-		retain__search(retainhier, split_topics, context, sub, 0);
+		retain__search(retainhier, split_topics, context, sub, filter, 0);
 	}
+	sub_filter__free(&filter);
 	mosquitto_FREE(local_sub);
 	mosquitto_FREE(split_topics);
 
@@ -396,8 +456,12 @@ void retain__clean(struct mosquitto__retainhier **retainhier)
 {
 	struct mosquitto__retainhier *peer, *retainhier_tmp;
 
+	/* The whole tree is being freed */
+	db.retain_dirty = NULL;
+
 	HASH_ITER(hh, *retainhier, peer, retainhier_tmp){
 		if(peer->retained){
+			peer->retained->retain_logged = false;
 			db__msg_store_ref_dec(&peer->retained);
 		}
 		retain__clean(&peer->children);
@@ -89,6 +89,7 @@ int mosquitto_security_cleanup_default(void)
 	if(db.config->per_listener_settings){
 		for(int i=0; i<db.config->listener_count; i++){
 			if(db.config->listeners[i].security_options->pid){
+				plugin_stats__cleanup(db.config->listeners[i].security_options->pid);
 				mosquitto_FREE(db.config->listeners[i].security_options->pid->plugin_name);
 				mosquitto_FREE(db.config->listeners[i].security_options->pid->config.security_options);
 				mosquitto_FREE(db.config->listeners[i].security_options->pid);
@@ -96,6 +97,7 @@ int mosquitto_security_cleanup_default(void)
 		}
 	}else{
 		if(db.config->security_options.pid){
+			plugin_stats__cleanup(db.config->security_options.pid);
 			mosquitto_FREE(db.config->security_options.pid->plugin_name);
 			mosquitto_FREE(db.config->security_options.pid->config.security_options);
 			mosquitto_FREE(db.config->security_options.pid);
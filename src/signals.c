@@ -131,6 +131,7 @@ int signal__flag_check(void)
 			return rc;
 		}
 		broker_control__reload();
+		auth_verify__reload();
 #ifdef WITH_BRIDGE
 		bridge__reload();
 #endif
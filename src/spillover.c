@@ -0,0 +1,656 @@
+/*
+Copyright (c) 2026 Roger Light <roger@atchoo.org>
+
+All rights reserved. This program and the accompanying materials
+are made available under the terms of the Eclipse Public License 2.0
+and Eclipse Distribution License v1.0 which accompany this distribution.
+
+The Eclipse Public License is available at
+   https://www.eclipse.org/legal/epl-2.0/
+and the Eclipse Distribution License is available at
+  http://www.eclipse.org/org/documents/edl-v10.php.
+
+SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+
+Contributors:
+   Roger Light - initial implementation and documentation.
+*/
+
+/* Queue spillover
+ *
+ * Once the in memory queue of a client holds more than queue_spillover_bytes
+ * of payload, newer queued messages are written to an append only store on
+ * disk and only a small index entry is kept in memory. The spilled messages
+ * are always the newest part of the queue, and are read back in order as the
+ * in memory queue drains.
+ *
+ * The store is a series of segment files shared by all clients. A segment is
+ * deleted once no index entries refer to it. The store only lives as long as
+ * the broker process, spilled messages are written to the persistence file
+ * like any other queued message.
+ *
+ * A base message that is only referenced by spilled messages is removed from
+ * the in memory message store, but persistence plugins must not be told it
+ * has been deleted until the last spilled reference has gone.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "mosquitto_broker_internal.h"
+#include "mosquitto/mqtt_protocol.h"
+#include "packet_mosq.h"
+#include "property_mosq.h"
+#include "utlist.h"
+#include "uthash.h"
+
+#define SPILLOVER_SEGMENT_MAX (64*1024*1024)
+
+struct spillover_segment {
+	struct spillover_segment *next;
+	FILE *fptr;
+	char *path;
+	uint64_t len;
+	uint64_t live;
+};
+
+/* Written in host byte order, the store is never read by another process. */
+struct spillover_record {
+	uint64_t cmsg_id;
+	dbid_t store_id;
+	uint64_t acl_epoch;
+	int64_t expiry_time;
+	uint32_t payloadlen;
+	uint32_t proplen;
+	uint32_t subscription_identifier;
+	uint16_t mid;
+	uint16_t source_mid;
+	uint16_t source_port;
+	uint16_t topic_len;
+	uint16_t source_id_len;
+	uint16_t source_username_len;
+	uint8_t qos;
+	uint8_t retain;
+	uint8_t base_qos;
+	uint8_t base_retain;
+	uint8_t origin;
+};
+
+struct spillover_base_ref {
+	UT_hash_handle hh;
+	dbid_t store_id;
+	int count;
+	bool stored;
+};
+
+static struct spillover_segment *segments = NULL;
+static struct spillover_base_ref *base_refs = NULL;
+static struct spillover_segment *current = NULL;
+static unsigned int next_segment = 1;
+
+
+bool spillover__wanted(struct mosquitto *context)
+{
+	if(db.config->queue_spillover_bytes == 0){
+		return false;
+	}
+	/* Once spilling has started, everything newer must follow it */
+	return context->spillover != NULL
+			|| (size_t)context->msgs_out.queued_bytes > db.config->queue_spillover_bytes;
+}
+
+
+bool spillover__base_msg_held(const struct mosquitto__base_msg *base_msg)
+{
+	struct spillover_base_ref *ref;
+
+	HASH_FIND(hh, base_refs, &base_msg->data.store_id, sizeof(dbid_t), ref);
+	if(ref){
+		ref->stored |= base_msg->stored;
+		return true;
+	}
+	return false;
+}
+
+
+static int spillover__base_ref_add(const struct mosquitto__base_msg *base_msg)
+{
+	struct spillover_base_ref *ref;
+
+	HASH_FIND(hh, base_refs, &base_msg->data.store_id, sizeof(dbid_t), ref);
+	if(ref == NULL){
+		ref = mosquitto_calloc(1, sizeof(struct spillover_base_ref));
+		if(ref == NULL){
+			return MOSQ_ERR_NOMEM;
+		}
+		ref->store_id = base_msg->data.store_id;
+		HASH_ADD(hh, base_refs, store_id, sizeof(dbid_t), ref);
+	}
+	ref->count++;
+	ref->stored |= base_msg->stored;
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+/* Drop a spilled reference to a base message. Any in memory copy takes over
+ * the persistence state. */
+static void spillover__base_ref_dec(dbid_t store_id, struct mosquitto__base_msg *base_msg)
+{
+	struct spillover_base_ref *ref;
+	struct mosquitto__base_msg tmp;
+
+	HASH_FIND(hh, base_refs, &store_id, sizeof(dbid_t), ref);
+	if(ref == NULL){
+		return;
+	}
+	if(base_msg == NULL){
+		HASH_FIND(hh, db.msg_store, &store_id, sizeof(dbid_t), base_msg);
+	}
+	if(base_msg){
+		base_msg->stored |= ref->stored;
+	}
+	ref->count--;
+	if(ref->count > 0){
+		return;
+	}
+	HASH_DELETE(hh, base_refs, ref);
+	if(base_msg == NULL && ref->stored){
+		memset(&tmp, 0, sizeof(struct mosquitto__base_msg));
+		tmp.data.store_id = store_id;
+		tmp.stored = true;
+		plugin_persist__handle_base_msg_delete(&tmp);
+	}
+	mosquitto_FREE(ref);
+}
+
+
+static void spillover__segment_free(struct spillover_segment *segment)
+{
+	if(segment->fptr){
+		fclose(segment->fptr);
+	}
+	if(segment->path){
+		(void)remove(segment->path);
+		mosquitto_FREE(segment->path);
+	}
+	mosquitto_FREE(segment);
+}
+
+
+static struct spillover_segment *spillover__segment_new(void)
+{
+	struct spillover_segment *segment;
+	const char *location;
+	size_t len;
+
+	location = db.config->queue_spillover_location;
+	if(location == NULL){
+		location = db.config->persistence_location;
+	}
+	if(location == NULL){
+		location = ".";
+	}
+
+	segment = mosquitto_calloc(1, sizeof(struct spillover_segment));
+	if(segment == NULL){
+		return NULL;
+	}
+	len = strlen(location) + strlen("/mosquitto-spill-4294967295.seg") + 1;
+	segment->path = mosquitto_malloc(len);
+	if(segment->path == NULL){
+		mosquitto_FREE(segment);
+		return NULL;
+	}
+	snprintf(segment->path, len, "%s/mosquitto-spill-%u.seg", location, next_segment);
+	/* Left over from a previous run that didn't exit cleanly */
+	(void)remove(segment->path);
+
+	segment->fptr = mosquitto_fopen(segment->path, "w+b", true);
+	if(segment->fptr == NULL){
+		log__printf(NULL, MOSQ_LOG_ERR, "Error: Unable to open queue spillover file %s: %s.",
+				segment->path, strerror(errno));
+		mosquitto_FREE(segment->path);
+		mosquitto_FREE(segment);
+		return NULL;
+	}
+	next_segment++;
+
+	segment->next = segments;
+	segments = segment;
+	return segment;
+}
+
+
+static void spillover__segment_release(struct spillover_segment *segment)
+{
+	struct spillover_segment **prev;
+
+	segment->live--;
+	if(segment->live > 0){
+		return;
+	}
+	if(segment == current){
+		/* Nothing left in the segment being written, so start it again */
+		segment->len = 0;
+		return;
+	}
+
+	prev = &segments;
+	while(*prev){
+		if(*prev == segment){
+			*prev = segment->next;
+			break;
+		}
+		prev = &(*prev)->next;
+	}
+	spillover__segment_free(segment);
+}
+
+
+static int spillover__write(struct spillover_segment *segment, uint64_t offset, const void *data, size_t len)
+{
+	if(len == 0){
+		return MOSQ_ERR_SUCCESS;
+	}
+	if(fseek(segment->fptr, (long)offset, SEEK_SET) < 0
+			|| fwrite(data, 1, len, segment->fptr) != len){
+
+		return MOSQ_ERR_ERRNO;
+	}
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+int spillover__queue_add(struct mosquitto *context, struct mosquitto__client_msg *client_msg)
+{
+	struct mosquitto__base_msg *base_msg = client_msg->base_msg;
+	struct spillover_record rec;
+	struct spillover_item *item;
+	struct mosquitto__packet *prop_packet = NULL;
+	uint64_t offset;
+	int rc;
+
+	if(current == NULL || current->len >= SPILLOVER_SEGMENT_MAX){
+		current = spillover__segment_new();
+		if(current == NULL){
+			return MOSQ_ERR_ERRNO;
+		}
+	}
+	if(context->spillover == NULL){
+		context->spillover = mosquitto_calloc(1, sizeof(struct spillover_queue));
+		if(context->spillover == NULL){
+			return MOSQ_ERR_NOMEM;
+		}
+		log__printf(NULL, MOSQ_LOG_NOTICE, "Outgoing messages for client %s are being spilled to disk.", context->id);
+	}
+	item = mosquitto_calloc(1, sizeof(struct spillover_item));
+	if(item == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+
+	memset(&rec, 0, sizeof(struct spillover_record));
+	rec.cmsg_id = client_msg->data.cmsg_id;
+	rec.store_id = base_msg->data.store_id;
+	rec.acl_epoch = client_msg->acl_epoch;
+	rec.expiry_time = base_msg->data.expiry_time;
+	rec.payloadlen = base_msg->data.payloadlen;
+	rec.subscription_identifier = client_msg->data.subscription_identifier;
+	rec.mid = client_msg->data.mid;
+	rec.source_mid = base_msg->data.source_mid;
+	if(base_msg->source_listener){
+		rec.source_port = base_msg->source_listener->port;
+	}
+	rec.topic_len = (uint16_t)strlen(base_msg->data.topic);
+	if(base_msg->data.source_id){
+		rec.source_id_len = (uint16_t)strlen(base_msg->data.source_id);
+	}
+	if(base_msg->data.source_username){
+		rec.source_username_len = (uint16_t)strlen(base_msg->data.source_username);
+	}
+	rec.qos = client_msg->data.qos;
+	rec.retain = client_msg->data.retain;
+	rec.base_qos = base_msg->data.qos;
+	rec.base_retain = base_msg->data.retain;
+	rec.origin = (uint8_t)base_msg->origin;
+
+	if(base_msg->data.properties){
+		rec.proplen = mosquitto_property_get_remaining_length(base_msg->data.properties);
+		prop_packet = mosquitto_calloc(1, sizeof(struct mosquitto__packet)+rec.proplen);
+		if(prop_packet == NULL){
+			mosquitto_FREE(item);
+			return MOSQ_ERR_NOMEM;
+		}
+		prop_packet->remaining_length = rec.proplen;
+		prop_packet->packet_length = rec.proplen;
+		rc = property__write_all(prop_packet, base_msg->data.properties, true);
+		if(rc){
+			mosquitto_FREE(prop_packet);
+			mosquitto_FREE(item);
+			return rc;
+		}
+	}
+
+	offset = current->len;
+	rc = spillover__write(current, offset, &rec, sizeof(struct spillover_record));
+	offset += sizeof(struct spillover_record);
+	if(rc == MOSQ_ERR_SUCCESS){
+		rc = spillover__write(current, offset, base_msg->data.topic, rec.topic_len);
+		offset += rec.topic_len;
+	}
+	if(rc == MOSQ_ERR_SUCCESS){
+		rc = spillover__write(current, offset, base_msg->data.source_id, rec.source_id_len);
+		offset += rec.source_id_len;
+	}
+	if(rc == MOSQ_ERR_SUCCESS){
+		rc = spillover__write(current, offset, base_msg->data.source_username, rec.source_username_len);
+		offset += rec.source_username_len;
+	}
+	if(rc == MOSQ_ERR_SUCCESS){
+		rc = spillover__write(current, offset, base_msg->data.payload, rec.payloadlen);
+		offset += rec.payloadlen;
+	}
+	if(rc == MOSQ_ERR_SUCCESS && prop_packet){
+		rc = spillover__write(current, offset, prop_packet->payload, rec.proplen);
+		offset += rec.proplen;
+	}
+	mosquitto_FREE(prop_packet);
+	if(rc){
+		log__printf(NULL, MOSQ_LOG_ERR, "Error: Unable to write to queue spillover file %s: %s.",
+				current->path, strerror(errno));
+		mosquitto_FREE(item);
+		return rc;
+	}
+
+	rc = spillover__base_ref_add(base_msg);
+	if(rc){
+		mosquitto_FREE(item);
+		return rc;
+	}
+
+	item->segment = current;
+	item->offset = current->len;
+	item->store_id = rec.store_id;
+	item->payloadlen = rec.payloadlen;
+	item->qos = rec.qos;
+	current->len = offset;
+	current->live++;
+
+	if(context->spillover->tail){
+		context->spillover->tail->next = item;
+	}else{
+		context->spillover->head = item;
+	}
+	context->spillover->tail = item;
+	context->spillover->count++;
+	context->spillover->bytes += item->payloadlen;
+	if(item->qos > 0){
+		context->spillover->count12++;
+		context->spillover->bytes12 += item->payloadlen;
+	}
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+static int spillover__read(const struct spillover_item *item, uint64_t offset, void *data, size_t len)
+{
+	if(len == 0){
+		return MOSQ_ERR_SUCCESS;
+	}
+	if(fseek(item->segment->fptr, (long)(item->offset + offset), SEEK_SET) < 0
+			|| fread(data, 1, len, item->segment->fptr) != len){
+
+		return MOSQ_ERR_ERRNO;
+	}
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+static int spillover__read_string(const struct spillover_item *item, uint64_t offset, uint16_t len, char **str)
+{
+	int rc;
+
+	*str = NULL;
+	if(len == 0){
+		return MOSQ_ERR_SUCCESS;
+	}
+	*str = mosquitto_malloc(len+1U);
+	if(*str == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	rc = spillover__read(item, offset, *str, len);
+	if(rc){
+		mosquitto_FREE(*str);
+		return rc;
+	}
+	(*str)[len] = '\0';
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+/* Read the client message data of a spilled message, and optionally a copy of
+ * its base message. The base message is not added to the message store. */
+int spillover__item_read(const struct spillover_item *item, struct mosquitto__client_msg *client_msg, dbid_t *store_id, struct mosquitto__base_msg **base_msg_out)
+{
+	struct spillover_record rec;
+	struct mosquitto__base_msg *base_msg;
+	struct mosquitto__packet_in prop_packet;
+	uint64_t offset;
+	int rc;
+
+	rc = spillover__read(item, 0, &rec, sizeof(struct spillover_record));
+	if(rc){
+		return rc;
+	}
+
+	memset(&client_msg->data, 0, sizeof(struct mosquitto_client_msg));
+	client_msg->data.cmsg_id = rec.cmsg_id;
+	client_msg->data.mid = rec.mid;
+	client_msg->data.qos = rec.qos;
+	client_msg->data.retain = rec.retain;
+	client_msg->data.direction = mosq_md_out;
+	client_msg->data.state = mosq_ms_queued;
+	client_msg->data.subscription_identifier = rec.subscription_identifier;
+	client_msg->acl_epoch = rec.acl_epoch;
+	*store_id = rec.store_id;
+
+	if(base_msg_out == NULL){
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	base_msg = mosquitto_calloc(1, sizeof(struct mosquitto__base_msg));
+	if(base_msg == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	base_msg->data.store_id = rec.store_id;
+	base_msg->data.expiry_time = rec.expiry_time;
+	base_msg->data.payloadlen = rec.payloadlen;
+	base_msg->data.source_mid = rec.source_mid;
+	base_msg->data.qos = rec.base_qos;
+	base_msg->data.retain = rec.base_retain;
+	base_msg->origin = (enum mosquitto_msg_origin)rec.origin;
+	if(rec.source_port){
+		for(int i=0; i<db.config->listener_count; i++){
+			if(db.config->listeners[i].port == rec.source_port){
+				base_msg->source_listener = &db.config->listeners[i];
+				break;
+			}
+		}
+	}
+
+	offset = sizeof(struct spillover_record);
+	rc = spillover__read_string(item, offset, rec.topic_len, &base_msg->data.topic);
+	offset += rec.topic_len;
+	if(rc == MOSQ_ERR_SUCCESS){
+		rc = spillover__read_string(item, offset, rec.source_id_len, &base_msg->data.source_id);
+		offset += rec.source_id_len;
+	}
+	if(rc == MOSQ_ERR_SUCCESS){
+		rc = spillover__read_string(item, offset, rec.source_username_len, &base_msg->data.source_username);
+		offset += rec.source_username_len;
+	}
+	if(rc == MOSQ_ERR_SUCCESS && rec.payloadlen > 0){
+		base_msg->data.payload = mosquitto_malloc(rec.payloadlen+1);
+		if(base_msg->data.payload){
+			rc = spillover__read(item, offset, base_msg->data.payload, rec.payloadlen);
+			/* Ensure zero terminated regardless of contents */
+			((uint8_t *)base_msg->data.payload)[rec.payloadlen] = 0;
+		}else{
+			rc = MOSQ_ERR_NOMEM;
+		}
+		offset += rec.payloadlen;
+	}
+	if(rc == MOSQ_ERR_SUCCESS && rec.proplen > 0){
+		memset(&prop_packet, 0, sizeof(struct mosquitto__packet_in));
+		prop_packet.payload = mosquitto_malloc(rec.proplen);
+		if(prop_packet.payload){
+			prop_packet.remaining_length = rec.proplen;
+			rc = spillover__read(item, offset, prop_packet.payload, rec.proplen);
+			if(rc == MOSQ_ERR_SUCCESS){
+				rc = property__read_all(CMD_PUBLISH, &prop_packet, &base_msg->data.properties);
+			}
+			mosquitto_FREE(prop_packet.payload);
+		}else{
+			rc = MOSQ_ERR_NOMEM;
+		}
+	}
+	if(rc){
+		db__msg_store_free(base_msg);
+		return rc;
+	}
+
+	*base_msg_out = base_msg;
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+static void spillover__queue_pop(struct mosquitto *context, struct mosquitto__base_msg *base_msg)
+{
+	struct spillover_queue *spillover = context->spillover;
+	struct spillover_item *item = spillover->head;
+
+	spillover__base_ref_dec(item->store_id, base_msg);
+
+	spillover->head = item->next;
+	if(spillover->head == NULL){
+		spillover->tail = NULL;
+	}
+	spillover->count--;
+	spillover->bytes -= item->payloadlen;
+	if(item->qos > 0){
+		spillover->count12--;
+		spillover->bytes12 -= item->payloadlen;
+	}
+	spillover__segment_release(item->segment);
+	mosquitto_FREE(item);
+}
+
+
+static int spillover__base_msg_get(const struct spillover_item *item, struct mosquitto__client_msg *client_msg)
+{
+	struct mosquitto__base_msg *base_msg;
+	dbid_t store_id;
+	int rc;
+
+	rc = spillover__item_read(item, client_msg, &store_id, NULL);
+	if(rc){
+		return rc;
+	}
+	HASH_FIND(hh, db.msg_store, &store_id, sizeof(store_id), base_msg);
+	if(base_msg == NULL){
+		rc = spillover__item_read(item, client_msg, &store_id, &base_msg);
+		if(rc){
+			return rc;
+		}
+		/* Persistence plugins were never told this message had gone, so
+		 * don't tell them it is back. */
+		rc = db__msg_store_add(base_msg);
+		if(rc){
+			db__msg_store_free(base_msg);
+			return rc;
+		}
+		db.msg_store_count++;
+		db.msg_store_bytes += base_msg->data.payloadlen;
+	}
+	client_msg->base_msg = base_msg;
+	db__msg_store_ref_inc(base_msg);
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+/* Move spilled messages back to the in memory queue once it has drained
+ * below half of queue_spillover_bytes, or is empty. */
+void spillover__queue_refill(struct mosquitto *context)
+{
+	struct spillover_queue *spillover = context->spillover;
+	struct mosquitto__client_msg *client_msg;
+	size_t limit = db.config->queue_spillover_bytes;
+	int rc;
+
+	if(spillover == NULL){
+		return;
+	}
+	if(context->msgs_out.queued && limit > 0
+			&& (size_t)context->msgs_out.queued_bytes >= limit/2){
+		return;
+	}
+
+	while(spillover->head && (context->msgs_out.queued == NULL || limit == 0
+				|| (size_t)context->msgs_out.queued_bytes < limit)){
+
+		client_msg = mosquitto_calloc(1, sizeof(struct mosquitto__client_msg));
+		if(client_msg == NULL){
+			return;
+		}
+		rc = spillover__base_msg_get(spillover->head, client_msg);
+		spillover__queue_pop(context, client_msg->base_msg);
+		if(rc){
+			log__printf(NULL, MOSQ_LOG_ERR, "Error: Unable to read queued message for client %s from spillover file, message dropped.", context->id);
+			mosquitto_FREE(client_msg);
+			continue;
+		}
+		DL_APPEND(context->msgs_out.queued, client_msg);
+		db__msg_add_to_queued_stats(&context->msgs_out, client_msg);
+	}
+
+	if(spillover->head == NULL){
+		mosquitto_FREE(context->spillover);
+	}
+}
+
+
+void spillover__queue_clear(struct mosquitto *context)
+{
+	if(context->spillover == NULL){
+		return;
+	}
+	while(context->spillover->head){
+		spillover__queue_pop(context, NULL);
+	}
+	mosquitto_FREE(context->spillover);
+}
+
+
+void spillover__cleanup(void)
+{
+	struct spillover_segment *segment, *next;
+	struct spillover_base_ref *ref, *ref_tmp;
+
+	segment = segments;
+	while(segment){
+		next = segment->next;
+		spillover__segment_free(segment);
+		segment = next;
+	}
+	segments = NULL;
+	current = NULL;
+
+	HASH_ITER(hh, base_refs, ref, ref_tmp){
+		HASH_DELETE(hh, base_refs, ref);
+		mosquitto_FREE(ref);
+	}
+}
@@ -0,0 +1,547 @@
+/*
+Copyright (c) 2026 Roger Light <roger@atchoo.org>
+
+All rights reserved. This program and the accompanying materials
+are made available under the terms of the Eclipse Public License 2.0
+and Eclipse Distribution License v1.0 which accompany this distribution.
+
+The Eclipse Public License is available at
+   https://www.eclipse.org/legal/epl-2.0/
+and the Eclipse Distribution License is available at
+  http://www.eclipse.org/org/documents/edl-v10.php.
+
+SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+
+Contributors:
+   Roger Light - initial implementation and documentation.
+*/
+
+/* Payload filtered subscriptions.
+ *
+ * A subscription of the form `$filter/<predicate>/<topic filter>` only
+ * receives messages on <topic filter> whose JSON payload matches
+ * <predicate>, for example:
+ *
+ *	$filter/temp>20 && unit=="C"/sensors/#
+ *
+ * The predicate is compiled when the subscription is added, and evaluated
+ * when a message is routed, before it is queued for the client. The payload
+ * of a message is only parsed once however many filtered subscriptions it
+ * is checked against.
+ *
+ * Grammar:
+ *
+ *	or      := and ( "||" and )*
+ *	and     := unary ( "&&" unary )*
+ *	unary   := "!" unary | "(" or ")" | compare
+ *	compare := path [ op value ]
+ *	op      := "==" | "!=" | "<" | "<=" | ">" | ">="
+ *	value   := number | 'string' | "string" | true | false | null
+ *	path    := name ( "." name )*
+ *
+ * A path on its own is true if the field exists and is not false or null. A
+ * numeric name indexes into an array. A comparison is false if the field
+ * does not exist or is of a different type to the value. Strings are
+ * compared with strcmp().
+ */
+
+#include "config.h"
+
+#include <cjson/cJSON.h>
+#include <ctype.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#define CJSON_VERSION_FULL (CJSON_VERSION_MAJOR*1000000+CJSON_VERSION_MINOR*1000+CJSON_VERSION_PATCH)
+
+#include "mosquitto_broker_internal.h"
+
+#define SUB_FILTER_PREFIX "$filter/"
+#define SUB_FILTER_PREFIX_LEN 8
+#define SUB_FILTER_MAX_DEPTH 32
+
+enum sub_filter__op {
+	sfo_or,
+	sfo_and,
+	sfo_not,
+	sfo_exists,
+	sfo_eq,
+	sfo_ne,
+	sfo_lt,
+	sfo_le,
+	sfo_gt,
+	sfo_ge,
+};
+
+struct sub__filter {
+	enum sub_filter__op op;
+	struct sub__filter *left;
+	struct sub__filter *right;
+	char *path; /* Names separated by '\0' */
+	int path_count;
+	int value_type; /* cJSON_Number, cJSON_String, cJSON_True, cJSON_False or cJSON_NULL */
+	double value_number;
+	char *value_string;
+};
+
+struct sub_filter__parser {
+	const char *pos;
+	const char *end;
+	int depth;
+};
+
+/* The parsed payload of the message currently being routed */
+static struct {
+	const struct mosquitto__base_msg *base_msg;
+	cJSON *json;
+} payload_cache;
+
+static struct sub__filter *parse_or(struct sub_filter__parser *p);
+
+
+static void skip_space(struct sub_filter__parser *p)
+{
+	while(p->pos < p->end && isspace((unsigned char)p->pos[0])){
+		p->pos++;
+	}
+}
+
+
+static bool accept_token(struct sub_filter__parser *p, const char *token)
+{
+	size_t len = strlen(token);
+
+	skip_space(p);
+	if((size_t)(p->end - p->pos) >= len && !strncmp(p->pos, token, len)){
+		p->pos += len;
+		return true;
+	}
+	return false;
+}
+
+
+static bool is_name_char(char c)
+{
+	return isalnum((unsigned char)c) || c == '_' || c == '-' || c == '$' || c == '@';
+}
+
+
+static struct sub__filter *node__new(enum sub_filter__op op, struct sub__filter *left, struct sub__filter *right)
+{
+	struct sub__filter *node;
+
+	node = mosquitto_calloc(1, sizeof(struct sub__filter));
+	if(node == NULL){
+		sub_filter__free(&left);
+		sub_filter__free(&right);
+		return NULL;
+	}
+	node->op = op;
+	node->left = left;
+	node->right = right;
+	return node;
+}
+
+
+static int parse_path(struct sub_filter__parser *p, struct sub__filter *node)
+{
+	const char *start;
+	size_t len;
+
+	skip_space(p);
+	start = p->pos;
+	while(p->pos < p->end && (is_name_char(p->pos[0]) || p->pos[0] == '.')){
+		p->pos++;
+	}
+	len = (size_t)(p->pos - start);
+	if(len == 0 || start[0] == '.' || start[len-1] == '.'){
+		return MOSQ_ERR_INVAL;
+	}
+
+	node->path = mosquitto_strndup(start, len);
+	if(node->path == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	node->path_count = 1;
+	for(size_t i=0; i<len; i++){
+		if(node->path[i] == '.'){
+			if(node->path[i+1] == '.'){
+				return MOSQ_ERR_INVAL;
+			}
+			node->path[i] = '\0';
+			node->path_count++;
+		}
+	}
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+static int parse_string(struct sub_filter__parser *p, struct sub__filter *node)
+{
+	char quote = p->pos[0];
+	size_t len = 0;
+
+	p->pos++;
+	node->value_string = mosquitto_malloc((size_t)(p->end - p->pos) + 1);
+	if(node->value_string == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	while(p->pos < p->end && p->pos[0] != quote){
+		if(p->pos[0] == '\\' && p->pos+1 < p->end){
+			p->pos++;
+		}
+		node->value_string[len++] = p->pos[0];
+		p->pos++;
+	}
+	if(p->pos == p->end){
+		return MOSQ_ERR_INVAL;
+	}
+	p->pos++;
+	node->value_string[len] = '\0';
+	node->value_type = cJSON_String;
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+static int parse_value(struct sub_filter__parser *p, struct sub__filter *node)
+{
+	char *endptr;
+	char buf[64];
+	size_t len;
+
+	skip_space(p);
+	if(p->pos == p->end){
+		return MOSQ_ERR_INVAL;
+	}
+
+	if(p->pos[0] == '"' || p->pos[0] == '\''){
+		return parse_string(p, node);
+	}else if(accept_token(p, "true")){
+		node->value_type = cJSON_True;
+	}else if(accept_token(p, "false")){
+		node->value_type = cJSON_False;
+	}else if(accept_token(p, "null")){
+		node->value_type = cJSON_NULL;
+	}else{
+		/* The predicate isn't nul terminated where the value ends */
+		len = 0;
+		while(p->pos+len < p->end && len < sizeof(buf)-1
+				&& (isalnum((unsigned char)p->pos[len]) || strchr("+-.", p->pos[len]))){
+			buf[len] = p->pos[len];
+			len++;
+		}
+		buf[len] = '\0';
+		node->value_number = strtod(buf, &endptr);
+		if(len == 0 || endptr != &buf[len]){
+			return MOSQ_ERR_INVAL;
+		}
+		p->pos += len;
+		node->value_type = cJSON_Number;
+	}
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+static struct sub__filter *parse_compare(struct sub_filter__parser *p)
+{
+	static const struct {
+		const char *token;
+		enum sub_filter__op op;
+	} ops[] = {
+		/* Two character operators first */
+		{"==", sfo_eq}, {"!=", sfo_ne}, {"<=", sfo_le}, {">=", sfo_ge},
+		{"<", sfo_lt}, {">", sfo_gt},
+	};
+	struct sub__filter *node;
+
+	node = node__new(sfo_exists, NULL, NULL);
+	if(node == NULL){
+		return NULL;
+	}
+	if(parse_path(p, node)){
+		sub_filter__free(&node);
+		return NULL;
+	}
+	for(size_t i=0; i<sizeof(ops)/sizeof(ops[0]); i++){
+		if(accept_token(p, ops[i].token)){
+			node->op = ops[i].op;
+			if(parse_value(p, node)){
+				sub_filter__free(&node);
+				return NULL;
+			}
+			break;
+		}
+	}
+	return node;
+}
+
+
+static struct sub__filter *parse_unary(struct sub_filter__parser *p)
+{
+	struct sub__filter *node;
+
+	if(p->depth >= SUB_FILTER_MAX_DEPTH){
+		return NULL;
+	}
+
+	skip_space(p);
+	if(p->pos < p->end && p->pos[0] == '!'){
+		p->pos++;
+		p->depth++;
+		node = parse_unary(p);
+		p->depth--;
+		if(node == NULL){
+			return NULL;
+		}
+		return node__new(sfo_not, node, NULL);
+	}else if(accept_token(p, "(")){
+		p->depth++;
+		node = parse_or(p);
+		p->depth--;
+		if(node && !accept_token(p, ")")){
+			sub_filter__free(&node);
+		}
+		return node;
+	}else{
+		return parse_compare(p);
+	}
+}
+
+
+static struct sub__filter *parse_and(struct sub_filter__parser *p)
+{
+	struct sub__filter *left, *right;
+
+	left = parse_unary(p);
+	while(left && accept_token(p, "&&")){
+		right = parse_unary(p);
+		if(right == NULL){
+			sub_filter__free(&left);
+			return NULL;
+		}
+		left = node__new(sfo_and, left, right);
+	}
+	return left;
+}
+
+
+static struct sub__filter *parse_or(struct sub_filter__parser *p)
+{
+	struct sub__filter *left, *right;
+
+	left = parse_and(p);
+	while(left && accept_token(p, "||")){
+		right = parse_and(p);
+		if(right == NULL){
+			sub_filter__free(&left);
+			return NULL;
+		}
+		left = node__new(sfo_or, left, right);
+	}
+	return left;
+}
+
+
+/* Returns the topic filter part of a subscription, which is the whole
+ * subscription if it has no payload filter, or NULL if the $filter/ prefix
+ * is incomplete. */
+const char *sub_filter__topic(const char *topic_filter)
+{
+	const char *end;
+
+	if(strncmp(topic_filter, SUB_FILTER_PREFIX, SUB_FILTER_PREFIX_LEN)){
+		return topic_filter;
+	}
+	end = strchr(&topic_filter[SUB_FILTER_PREFIX_LEN], '/');
+	if(end == NULL || end == &topic_filter[SUB_FILTER_PREFIX_LEN] || end[1] == '\0'){
+		return NULL;
+	}
+	return end+1;
+}
+
+
+/* Sets *filter to the compiled payload filter of a subscription, or NULL if
+ * the subscription doesn't have one. */
+int sub_filter__compile(const char *topic_filter, struct sub__filter **filter)
+{
+	struct sub_filter__parser p;
+	const char *topic;
+
+	*filter = NULL;
+
+	topic = sub_filter__topic(topic_filter);
+	if(topic == NULL){
+		return MOSQ_ERR_INVAL;
+	}else if(topic == topic_filter){
+		return MOSQ_ERR_SUCCESS;
+	}else if(!strncmp(topic, "$share/", strlen("$share/"))){
+		/* Not supported */
+		return MOSQ_ERR_INVAL;
+	}
+
+	memset(&p, 0, sizeof(p));
+	p.pos = &topic_filter[SUB_FILTER_PREFIX_LEN];
+	p.end = topic-1;
+
+	*filter = parse_or(&p);
+	if(*filter == NULL){
+		return MOSQ_ERR_INVAL;
+	}
+	skip_space(&p);
+	if(p.pos != p.end){
+		sub_filter__free(filter);
+		return MOSQ_ERR_INVAL;
+	}
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+int sub_filter__check(const char *topic_filter)
+{
+	struct sub__filter *filter;
+	int rc;
+
+	rc = sub_filter__compile(topic_filter, &filter);
+	sub_filter__free(&filter);
+	return rc;
+}
+
+
+void sub_filter__free(struct sub__filter **filter)
+{
+	if(*filter == NULL){
+		return;
+	}
+	sub_filter__free(&(*filter)->left);
+	sub_filter__free(&(*filter)->right);
+	mosquitto_FREE((*filter)->path);
+	mosquitto_FREE((*filter)->value_string);
+	mosquitto_FREE(*filter);
+}
+
+
+static const cJSON *payload_field(const cJSON *json, const struct sub__filter *node)
+{
+	const char *name = node->path;
+	char *endptr;
+	long index;
+
+	for(int i=0; i<node->path_count && json; i++){
+		if(cJSON_IsObject(json)){
+			json = cJSON_GetObjectItemCaseSensitive(json, name);
+		}else if(cJSON_IsArray(json)){
+			index = strtol(name, &endptr, 10);
+			if(endptr[0] != '\0' || index < 0 || index > INT_MAX){
+				return NULL;
+			}
+			json = cJSON_GetArrayItem(json, (int)index);
+		}else{
+			return NULL;
+		}
+		name += strlen(name)+1;
+	}
+	return json;
+}
+
+
+static bool sub_filter__eval(const struct sub__filter *node, const cJSON *json)
+{
+	const cJSON *field;
+	int cmp;
+
+	switch(node->op){
+		case sfo_or:
+			return sub_filter__eval(node->left, json) || sub_filter__eval(node->right, json);
+		case sfo_and:
+			return sub_filter__eval(node->left, json) && sub_filter__eval(node->right, json);
+		case sfo_not:
+			return !sub_filter__eval(node->left, json);
+		default:
+			break;
+	}
+
+	field = payload_field(json, node);
+	if(field == NULL){
+		return false;
+	}
+	if(node->op == sfo_exists){
+		return !cJSON_IsFalse(field) && !cJSON_IsNull(field);
+	}
+
+	if(node->value_type == cJSON_Number && cJSON_IsNumber(field)){
+		if(field->valuedouble < node->value_number){
+			cmp = -1;
+		}else if(field->valuedouble > node->value_number){
+			cmp = 1;
+		}else{
+			cmp = 0;
+		}
+	}else if(node->value_type == cJSON_String && cJSON_IsString(field)){
+		cmp = strcmp(field->valuestring, node->value_string);
+	}else if((field->type & 0xFF) == node->value_type){
+		/* true, false or null */
+		cmp = 0;
+	}else if((node->value_type == cJSON_True || node->value_type == cJSON_False)
+			&& cJSON_IsBool(field)){
+
+		cmp = 1;
+	}else{
+		return false;
+	}
+
+	if(node->op == sfo_eq){
+		return cmp == 0;
+	}else if(node->op == sfo_ne){
+		return cmp != 0;
+	}else if(node->value_type != cJSON_Number && node->value_type != cJSON_String){
+		/* true, false and null can't be ordered */
+		return false;
+	}
+
+	switch(node->op){
+		case sfo_lt:
+			return cmp < 0;
+		case sfo_le:
+			return cmp <= 0;
+		case sfo_gt:
+			return cmp > 0;
+		case sfo_ge:
+			return cmp >= 0;
+		default:
+			return false;
+	}
+}
+
+
+/* Returns true if the payload of base_msg matches the filter. Payloads that
+ * aren't valid JSON never match. */
+bool sub_filter__match(const struct sub__filter *filter, const struct mosquitto__base_msg *base_msg)
+{
+	if(payload_cache.base_msg != base_msg){
+		sub_filter__payload_release();
+		payload_cache.base_msg = base_msg;
+		if(base_msg->data.payloadlen > 0){
+			/* Payloads always have an extra 0 on the end, see
+			 * control_common.c */
+#if CJSON_VERSION_FULL < 1007013
+			payload_cache.json = cJSON_Parse(base_msg->data.payload);
+#else
+			payload_cache.json = cJSON_ParseWithLength(base_msg->data.payload, base_msg->data.payloadlen);
+#endif
+		}
+	}
+	if(payload_cache.json == NULL){
+		return false;
+	}
+	return sub_filter__eval(filter, payload_cache.json);
+}
+
+
+/* Must be called once a message has been routed, before base_msg can be
+ * freed and its address reused. */
+void sub_filter__payload_release(void)
+{
+	cJSON_Delete(payload_cache.json);
+	payload_cache.json = NULL;
+	payload_cache.base_msg = NULL;
+}
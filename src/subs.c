@@ -65,6 +65,41 @@ static unsigned int hashv_plus = 0;
 static unsigned int hashv_hash = 0;
 
 
+/* A subscription without wildcards only ever matches one topic, so if all of
+ * the ACL check plugins have said their result depends only on the client and
+ * the topic, the result of the first check can be reused for every later
+ * message until db.acl_generation changes.
+ */
+static int subs__acl_check_read(struct mosquitto__subleaf *leaf, const char *topic, struct mosquitto__base_msg *stored)
+{
+	int rc;
+	bool cacheable;
+
+	if(leaf->acl_read != 0 && leaf->acl_read_generation == db.acl_generation){
+		return leaf->acl_read > 0?MOSQ_ERR_SUCCESS:MOSQ_ERR_ACL_DENIED;
+	}
+
+	cacheable = strpbrk(leaf->topic_filter, "+#") == NULL && acl__read_cacheable(leaf->context);
+
+	rc = mosquitto_acl_check(leaf->context, topic, stored->data.payloadlen, stored->data.payload, stored->data.qos, stored->data.retain, stored->data.properties, MOSQ_ACL_READ);
+	if(cacheable && (rc == MOSQ_ERR_SUCCESS || rc == MOSQ_ERR_ACL_DENIED)){
+		leaf->acl_read = rc == MOSQ_ERR_SUCCESS?1:-1;
+		leaf->acl_read_generation = db.acl_generation;
+	}
+	return rc;
+}
+
+
+void sub__acl_cache_reset(struct mosquitto *context)
+{
+	for(int i=0; i<context->subs_capacity; i++){
+		if(context->subs[i]){
+			context->subs[i]->acl_read = 0;
+		}
+	}
+}
+
+
 static int subs__send(struct mosquitto__subleaf *leaf, const char *topic, uint8_t qos, int retain, struct mosquitto__base_msg *stored)
 {
 	bool client_retain;
@@ -72,8 +107,12 @@ static int subs__send(struct mosquitto__subleaf *leaf, const char *topic, uint8_
 	uint8_t client_qos, msg_qos;
 	int rc2;
 
+	if(leaf->payload_filter && !sub_filter__match(leaf->payload_filter, stored)){
+		return MOSQ_ERR_SUCCESS;
+	}
+
 	/* Check for ACL topic access. */
-	rc2 = mosquitto_acl_check(leaf->context, topic, stored->data.payloadlen, stored->data.payload, stored->data.qos, stored->data.retain, stored->data.properties, MOSQ_ACL_READ);
+	rc2 = subs__acl_check_read(leaf, topic, stored);
 	if(rc2 == MOSQ_ERR_ACL_DENIED){
 		return MOSQ_ERR_SUCCESS;
 	}else if(rc2 == MOSQ_ERR_SUCCESS){
@@ -158,15 +197,38 @@ static int subs__process(struct mosquitto__subhier *hier, const char *source_id,
 }
 
 
+/* A client can have one subscription to a topic filter without a payload
+ * filter, and one for each different payload filter. */
+static bool sub__leaf_matches(const struct mosquitto__subleaf *leaf, const char *topic_filter)
+{
+	if(leaf->payload_filter == NULL && sub_filter__topic(topic_filter) == topic_filter){
+		return true;
+	}
+	return !strcmp(leaf->topic_filter, topic_filter);
+}
+
+
+void sub__leaf_free(struct mosquitto__subleaf **leaf)
+{
+	if(*leaf){
+		sub_filter__free(&(*leaf)->payload_filter);
+		mosquitto_FREE(*leaf);
+	}
+}
+
+
 static int sub__add_leaf(struct mosquitto *context, const struct mosquitto_subscription *sub, struct mosquitto__subleaf **head, struct mosquitto__subleaf **newleaf)
 {
 	struct mosquitto__subleaf *leaf;
+	int rc;
 
 	*newleaf = NULL;
 	leaf = *head;
 
 	while(leaf){
-		if(leaf->context && leaf->context->id && !strcmp(leaf->context->id, context->id)){
+		if(leaf->context && leaf->context->id && !strcmp(leaf->context->id, context->id)
+				&& sub__leaf_matches(leaf, sub->topic_filter)){
+
 			/* Client making a second subscription to same topic. Only
 			 * need to update QoS. Return MOSQ_ERR_SUB_EXISTS to
 			 * indicate this to the calling function. */
@@ -180,6 +242,11 @@ static int sub__add_leaf(struct mosquitto *context, const struct mosquitto_subsc
 	if(!leaf){
 		return MOSQ_ERR_NOMEM;
 	}
+	rc = sub_filter__compile(sub->topic_filter, &leaf->payload_filter);
+	if(rc){
+		mosquitto_FREE(leaf);
+		return rc;
+	}
 	leaf->context = context;
 	leaf->identifier = sub->identifier;
 	leaf->subscription_options = sub->options;
@@ -252,7 +319,7 @@ static int sub__add_shared(struct mosquitto *context, const struct mosquitto_sub
 			subs = mosquitto_realloc(context->subs, sizeof(struct mosquitto__subleaf *)*(size_t)(context->subs_capacity + 1));
 			if(!subs){
 				sub__remove_shared_leaf(subhier, shared, newleaf);
-				mosquitto_FREE(newleaf);
+				sub__leaf_free(&newleaf);
 				return MOSQ_ERR_NOMEM;
 			}
 			context->subs = subs;
@@ -303,7 +370,7 @@ static int sub__add_normal(struct mosquitto *context, const struct mosquitto_sub
 			subs = mosquitto_realloc(context->subs, sizeof(struct mosquitto__subleaf *)*(size_t)(context->subs_capacity + 1));
 			if(!subs){
 				DL_DELETE(subhier->subs, newleaf);
-				mosquitto_FREE(newleaf);
+				sub__leaf_free(&newleaf);
 				return MOSQ_ERR_NOMEM;
 			}
 			context->subs = subs;
@@ -363,13 +430,13 @@ static int sub__add_context(struct mosquitto *context, const struct mosquitto_su
 }
 
 
-static int sub__remove_normal(struct mosquitto *context, struct mosquitto__subhier *subhier, uint8_t *reason)
+static int sub__remove_normal(struct mosquitto *context, struct mosquitto__subhier *subhier, const char *topic_filter, uint8_t *reason)
 {
 	struct mosquitto__subleaf *leaf;
 
 	leaf = subhier->subs;
 	while(leaf){
-		if(leaf->context==context){
+		if(leaf->context==context && sub__leaf_matches(leaf, topic_filter)){
 #ifdef WITH_SYS_TREE
 			db.subscription_count--;
 #endif
@@ -380,10 +447,9 @@ static int sub__remove_normal(struct mosquitto *context, struct mosquitto__subhi
 			 * but that would involve keeping a copy of the topic string in
 			 * each subleaf. Might be worth considering though. */
 			for(int i=0; i<context->subs_capacity; i++){
-				if(context->subs[i] && context->subs[i]->hier == subhier){
+				if(context->subs[i] == leaf){
 					context->subs_count--;
-					mosquitto_free(context->subs[i]);
-					context->subs[i] = NULL;
+					sub__leaf_free(&context->subs[i]);
 					break;
 				}
 			}
@@ -419,8 +485,7 @@ static int sub__remove_shared(struct mosquitto *context, struct mosquitto__subhi
 							&& context->subs[i]->hier == subhier
 							&& context->subs[i]->shared == shared){
 
-						mosquitto_free(context->subs[i]);
-						context->subs[i] = NULL;
+						sub__leaf_free(&context->subs[i]);
 						context->subs_count--;
 						break;
 					}
@@ -443,7 +508,7 @@ static int sub__remove_shared(struct mosquitto *context, struct mosquitto__subhi
 }
 
 
-static int sub__remove_recurse(struct mosquitto *context, struct mosquitto__subhier *subhier, char **topics, uint8_t *reason, const char *sharename)
+static int sub__remove_recurse(struct mosquitto *context, struct mosquitto__subhier *subhier, char **topics, const char *topic_filter, uint8_t *reason, const char *sharename)
 {
 	struct mosquitto__subhier *branch;
 
@@ -451,13 +516,13 @@ static int sub__remove_recurse(struct mosquitto *context, struct mosquitto__subh
 		if(sharename){
 			return sub__remove_shared(context, subhier, reason, sharename);
 		}else{
-			return sub__remove_normal(context, subhier, reason);
+			return sub__remove_normal(context, subhier, topic_filter, reason);
 		}
 	}
 
 	HASH_FIND(hh, subhier->children, topics[0], strlen(topics[0]), branch);
 	if(branch){
-		sub__remove_recurse(context, branch, &(topics[1]), reason, sharename);
+		sub__remove_recurse(context, branch, &(topics[1]), topic_filter, reason, sharename);
 		if(!branch->children && !branch->subs && !branch->shared){
 			HASH_DELETE(hh, subhier->children, branch);
 			mosquitto_FREE(branch);
@@ -570,11 +635,18 @@ int sub__add(struct mosquitto *context, const struct mosquitto_subscription *sub
 	char *local_sub;
 	char **topics;
 	size_t topiclen;
+	const char *topic_filter;
 
 	assert(sub);
 	assert(sub->topic_filter);
 
-	rc = sub__topic_tokenise(sub->topic_filter, &local_sub, &topics, &sharename);
+	/* Any payload filter is compiled when the leaf is added */
+	topic_filter = sub_filter__topic(sub->topic_filter);
+	if(topic_filter == NULL){
+		return MOSQ_ERR_INVAL;
+	}
+
+	rc = sub__topic_tokenise(topic_filter, &local_sub, &topics, &sharename);
 	if(rc){
 		return rc;
 	}
@@ -625,10 +697,18 @@ int sub__remove(struct mosquitto *context, const char *sub, uint8_t *reason)
 	const char *sharename = NULL;
 	char *local_sub = NULL;
 	char **topics = NULL;
+	const char *topic_filter;
 
 	assert(sub);
 
-	rc = sub__topic_tokenise(sub, &local_sub, &topics, &sharename);
+	topic_filter = sub_filter__topic(sub);
+	if(topic_filter == NULL){
+		/* Could never have been subscribed to */
+		*reason = MQTT_RC_NO_SUBSCRIPTION_EXISTED;
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	rc = sub__topic_tokenise(topic_filter, &local_sub, &topics, &sharename);
 	if(rc){
 		return rc;
 	}
@@ -640,7 +720,7 @@ int sub__remove(struct mosquitto *context, const char *sub, uint8_t *reason)
 	}
 	if(subhier){
 		*reason = MQTT_RC_NO_SUBSCRIPTION_EXISTED;
-		rc = sub__remove_recurse(context, subhier, topics, reason, sharename);
+		rc = sub__remove_recurse(context, subhier, topics, sub, reason, sharename);
 	}
 
 	mosquitto_FREE(local_sub);
@@ -671,6 +751,7 @@ int sub__messages_queue(const char *source_id, const char *topic, uint8_t qos, i
 	db__message_write(), which could remove the message if ref_count==0.
 	*/
 	db__msg_store_ref_inc(*stored);
+	(*stored)->fanout_depth++;
 
 	topiclen = strlen(split_topics[0]);
 	HASH_VALUE(split_topics[0], topiclen, hashv);
@@ -704,8 +785,14 @@ int sub__messages_queue(const char *source_id, const char *topic, uint8_t qos, i
 	}
 
 end:
+	sub_filter__payload_release();
 	mosquitto_FREE(split_topics);
 	mosquitto_FREE(local_topic);
+	/* The shared MOSQ_EVT_MESSAGE_OUT results are only for this fan-out */
+	(*stored)->fanout_depth--;
+	if((*stored)->fanout_depth == 0){
+		plugin__message_out_free(*stored);
+	}
 	/* Remove our reference and free if needed. */
 	db__msg_store_ref_dec(stored);
 
@@ -768,19 +855,14 @@ int sub__clean_session(struct mosquitto *context)
 				leaf = leaf->next;
 			}
 		}else{
-			leaf = hier->subs;
-			while(leaf){
-				if(leaf->context==context){
+			/* The client may have more than one leaf here if it has
+			 * payload filtered subscriptions, so remove this one. */
 #ifdef WITH_SYS_TREE
-					db.subscription_count--;
+			db.subscription_count--;
 #endif
-					DL_DELETE(hier->subs, leaf);
-					break;
-				}
-				leaf = leaf->next;
-			}
+			DL_DELETE(hier->subs, context->subs[i]);
 		}
-		mosquitto_FREE(context->subs[i]);
+		sub__leaf_free(&context->subs[i]);
 
 		if(hier->subs == NULL
 				&& hier->children == NULL
@@ -292,6 +292,8 @@ void sys_tree__update(bool force)
 			}
 		}
 
+		plugin_stats__sys_tree_update();
+
 		last_update = db.now_s;
 		last_update_real = db.now_real_s;
 	}
@@ -0,0 +1,373 @@
+/*
+Copyright (c) 2026 Roger Light <roger@atchoo.org>
+
+All rights reserved. This program and the accompanying materials
+are made available under the terms of the Eclipse Public License 2.0
+and Eclipse Distribution License v1.0 which accompany this distribution.
+
+The Eclipse Public License is available at
+   https://www.eclipse.org/legal/epl-2.0/
+and the Eclipse Distribution License is available at
+  http://www.eclipse.org/org/documents/edl-v10.php.
+
+SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+
+Contributors:
+   Roger Light - initial implementation and documentation.
+*/
+
+/* Topic rewriting of incoming messages, configured with `topic_rewrite`.
+ *
+ * The rule filters are held in a tree with one level per topic level, in the
+ * same way as subscriptions. Matching walks the levels of the incoming topic
+ * in place, so a message that matches no rule costs no allocations. When a
+ * rule matches, the new topic is built in a single allocation.
+ *
+ * Only one rule is applied to a topic. Where more than one rule matches, at
+ * each level an exact match is preferred over `+`, and `+` over `#`.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "mosquitto_broker_internal.h"
+#include "uthash.h"
+
+#define TOPIC_REWRITE_MAX_CAPTURES 9
+
+struct topic_rewrite__rule {
+	char *replacement;
+	bool needs_username; /* Replacement contains %u */
+};
+
+struct topic_rewrite__node {
+	UT_hash_handle hh;
+	struct topic_rewrite__node *children;
+	struct topic_rewrite__node *plus;
+	struct topic_rewrite__rule *rule;      /* Filter ends at this level */
+	struct topic_rewrite__rule *hash_rule; /* Filter ends with # at this level */
+	uint16_t level_len;
+	char level[];
+};
+
+struct topic_rewrite__capture {
+	const char *start;
+	size_t len;
+};
+
+
+static struct topic_rewrite__node *node__new(const char *level, size_t level_len)
+{
+	struct topic_rewrite__node *node;
+
+	node = mosquitto_calloc(1, sizeof(struct topic_rewrite__node) + level_len + 1);
+	if(node){
+		node->level_len = (uint16_t)level_len;
+		memcpy(node->level, level, level_len);
+	}
+	return node;
+}
+
+
+static int replacement__check(const char *replacement, int capture_count, bool *needs_username)
+{
+	const char *c;
+
+	if(replacement[0] == '\0'){
+		return MOSQ_ERR_INVAL;
+	}
+	for(c=replacement; *c; c++){
+		if(*c == '+' || *c == '#'){
+			return MOSQ_ERR_INVAL;
+		}else if(*c == '%'){
+			c++;
+			if(*c >= '1' && *c <= '9'){
+				if(*c - '0' > capture_count){
+					return MOSQ_ERR_INVAL;
+				}
+			}else if(*c == 'u'){
+				*needs_username = true;
+			}else if(*c != 'c' && *c != '%'){
+				return MOSQ_ERR_INVAL;
+			}
+		}
+	}
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+int topic_rewrite__add(struct topic_rewrite__node **root, const char *filter, const char *replacement)
+{
+	struct topic_rewrite__node *node, *child;
+	struct topic_rewrite__rule *rule;
+	struct topic_rewrite__rule **slot;
+	const char *level, *end;
+	size_t level_len;
+	int capture_count = 0;
+	bool needs_username = false;
+
+	if(mosquitto_sub_topic_check(filter) != MOSQ_ERR_SUCCESS
+			|| !strncmp(filter, "$share/", strlen("$share/"))){
+
+		return MOSQ_ERR_INVAL;
+	}
+	for(const char *c=filter; *c; c++){
+		if(*c == '+' || *c == '#'){
+			capture_count++;
+		}
+	}
+	if(capture_count > TOPIC_REWRITE_MAX_CAPTURES || replacement__check(replacement, capture_count, &needs_username)){
+		return MOSQ_ERR_INVAL;
+	}
+
+	if(*root == NULL){
+		*root = node__new("", 0);
+		if(*root == NULL){
+			return MOSQ_ERR_NOMEM;
+		}
+	}
+
+	node = *root;
+	slot = NULL;
+	level = filter;
+	while(level){
+		end = strchr(level, '/');
+		level_len = end ? (size_t)(end - level) : strlen(level);
+
+		if(level_len == 1 && level[0] == '#'){
+			slot = &node->hash_rule;
+			break;
+		}else if(level_len == 1 && level[0] == '+'){
+			if(node->plus == NULL){
+				node->plus = node__new(level, level_len);
+				if(node->plus == NULL){
+					return MOSQ_ERR_NOMEM;
+				}
+			}
+			node = node->plus;
+		}else{
+			HASH_FIND(hh, node->children, level, level_len, child);
+			if(child == NULL){
+				child = node__new(level, level_len);
+				if(child == NULL){
+					return MOSQ_ERR_NOMEM;
+				}
+				HASH_ADD(hh, node->children, level, level_len, child);
+			}
+			node = child;
+		}
+		level = end ? end+1 : NULL;
+	}
+	if(slot == NULL){
+		slot = &node->rule;
+	}
+	if(*slot){
+		/* The same filter has been given twice */
+		return MOSQ_ERR_ALREADY_EXISTS;
+	}
+
+	rule = mosquitto_calloc(1, sizeof(struct topic_rewrite__rule));
+	if(rule == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	rule->replacement = mosquitto_strdup(replacement);
+	if(rule->replacement == NULL){
+		mosquitto_FREE(rule);
+		return MOSQ_ERR_NOMEM;
+	}
+	rule->needs_username = needs_username;
+	*slot = rule;
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+static void rule__free(struct topic_rewrite__rule **rule)
+{
+	if(*rule){
+		mosquitto_FREE((*rule)->replacement);
+		mosquitto_FREE(*rule);
+	}
+}
+
+
+void topic_rewrite__cleanup(struct topic_rewrite__node **root)
+{
+	struct topic_rewrite__node *node, *child, *child_tmp;
+
+	node = *root;
+	if(node == NULL){
+		return;
+	}
+
+	HASH_ITER(hh, node->children, child, child_tmp){
+		HASH_DELETE(hh, node->children, child);
+		topic_rewrite__cleanup(&child);
+	}
+	topic_rewrite__cleanup(&node->plus);
+	rule__free(&node->rule);
+	rule__free(&node->hash_rule);
+	mosquitto_FREE(*root);
+}
+
+
+/* level is the start of the current topic level, or NULL once all levels have
+ * been used. */
+static const struct topic_rewrite__rule *topic_rewrite__match(const struct topic_rewrite__node *node,
+		const char *level, bool first, struct topic_rewrite__capture *captures, int capture_index)
+{
+	const struct topic_rewrite__rule *rule;
+	struct topic_rewrite__node *child;
+	const char *end, *next;
+	size_t level_len;
+
+	if(level == NULL){
+		if(node->rule){
+			return node->rule;
+		}else if(node->hash_rule){
+			/* "a/#" also matches "a" */
+			captures[capture_index].start = NULL;
+			captures[capture_index].len = 0;
+			return node->hash_rule;
+		}
+		return NULL;
+	}
+
+	end = strchr(level, '/');
+	if(end){
+		level_len = (size_t)(end - level);
+		next = end+1;
+	}else{
+		level_len = strlen(level);
+		next = NULL;
+	}
+
+	HASH_FIND(hh, node->children, level, level_len, child);
+	if(child){
+		rule = topic_rewrite__match(child, next, false, captures, capture_index);
+		if(rule){
+			return rule;
+		}
+	}
+
+	/* Wildcards do not match a first level starting with $ */
+	if(first && level[0] == '$'){
+		return NULL;
+	}
+	if(node->plus){
+		captures[capture_index].start = level;
+		captures[capture_index].len = level_len;
+		rule = topic_rewrite__match(node->plus, next, false, captures, capture_index+1);
+		if(rule){
+			return rule;
+		}
+	}
+	if(node->hash_rule){
+		captures[capture_index].start = level;
+		captures[capture_index].len = strlen(level);
+		return node->hash_rule;
+	}
+	return NULL;
+}
+
+
+/* Writes the new topic to buf if it is not NULL, and returns its length. */
+static size_t topic_rewrite__expand(const char *replacement, const struct topic_rewrite__capture *captures,
+		const char *clientid, const char *username, char *buf)
+{
+	size_t len = 0;
+	const char *value;
+	size_t value_len;
+
+	for(const char *c=replacement; *c; c++){
+		if(*c != '%'){
+			if(buf){
+				buf[len] = *c;
+			}
+			len++;
+			continue;
+		}
+
+		c++;
+		if(*c >= '1' && *c <= '9'){
+			value = captures[*c - '1'].start;
+			value_len = captures[*c - '1'].len;
+			if(value == NULL){
+				/* # matched no levels. If it is at the end of the
+				 * replacement, drop the separator before it as well, so
+				 * "out/%1" gives "out" rather than "out/". */
+				if(c[1] == '\0' && c - replacement >= 2 && c[-2] == '/'){
+					len--;
+				}
+				continue;
+			}
+		}else if(*c == 'c'){
+			value = clientid;
+			value_len = strlen(clientid);
+		}else if(*c == 'u'){
+			value = username;
+			value_len = strlen(username);
+		}else{
+			value = "%";
+			value_len = 1;
+		}
+		if(buf){
+			memcpy(&buf[len], value, value_len);
+		}
+		len += value_len;
+	}
+	return len;
+}
+
+
+/* Rewrite *topic if it matches a rule. On success *topic is either unchanged,
+ * or has been freed and replaced with the new topic. Returns MOSQ_ERR_INVAL if
+ * the rewritten topic would not be a valid topic name. */
+int topic_rewrite__apply(struct topic_rewrite__node *root, const char *clientid, const char *username, char **topic)
+{
+	const struct topic_rewrite__rule *rule;
+	struct topic_rewrite__capture captures[TOPIC_REWRITE_MAX_CAPTURES];
+	char *new_topic;
+	size_t len;
+
+	if(root == NULL){
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	rule = topic_rewrite__match(root, *topic, true, captures, 0);
+	if(rule == NULL){
+		return MOSQ_ERR_SUCCESS;
+	}
+	if(clientid == NULL){
+		clientid = "";
+	}
+	if(username == NULL){
+		if(rule->needs_username){
+			/* Rules that need a username do not apply to clients without one */
+			return MOSQ_ERR_SUCCESS;
+		}
+		username = "";
+	}
+
+	len = topic_rewrite__expand(rule->replacement, captures, clientid, username, NULL);
+	if(len == 0 || len > UINT16_MAX){
+		return MOSQ_ERR_INVAL;
+	}
+	new_topic = mosquitto_malloc(len+1);
+	if(new_topic == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	topic_rewrite__expand(rule->replacement, captures, clientid, username, new_topic);
+	new_topic[len] = '\0';
+
+	/* Client ids and usernames may contain wildcard characters */
+	if(mosquitto_pub_topic_check(new_topic) != MOSQ_ERR_SUCCESS){
+		mosquitto_FREE(new_topic);
+		return MOSQ_ERR_INVAL;
+	}
+
+	mosquitto_FREE(*topic);
+	*topic = new_topic;
+	return MOSQ_ERR_SUCCESS;
+}
@@ -0,0 +1,230 @@
+/*
+Copyright (c) 2026 Roger Light <roger@atchoo.org>
+
+All rights reserved. This program and the accompanying materials
+are made available under the terms of the Eclipse Public License 2.0
+and Eclipse Distribution License v1.0 which accompany this distribution.
+
+The Eclipse Public License is available at
+   https://www.eclipse.org/legal/epl-2.0/
+and the Eclipse Distribution License is available at
+  http://www.eclipse.org/org/documents/edl-v10.php.
+
+SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+
+Contributors:
+   Roger Light - initial implementation and documentation.
+*/
+
+/* Worker thread pools
+ *
+ * A pool runs jobs on its own threads and hands them back to the main loop
+ * once they are finished. Jobs are queued in the order they are submitted,
+ * and each job's run function is called on one of the threads. The job is
+ * then moved to the done list and the main loop is woken with mux__wakeup(),
+ * so the owner of the pool can collect it with worker_pool__take_done() on
+ * the next pass of the loop.
+ *
+ * Callers embed struct mosquitto__worker_job at the start of their own job
+ * structure. The pool never allocates or frees jobs itself.
+ */
+
+#include "config.h"
+
+#if defined(WITH_THREADING) && !defined(WIN32)
+#  include <pthread.h>
+#endif
+
+#include "mosquitto_broker_internal.h"
+
+#if defined(WITH_THREADING) && !defined(WIN32)
+
+struct mosquitto__worker_pool {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	pthread_t *threads;
+	int thread_count;
+	bool stopping;
+	/* Protected by mutex */
+	struct mosquitto__worker_job *pending_head;
+	struct mosquitto__worker_job *pending_tail;
+	struct mosquitto__worker_job *done_head;
+	struct mosquitto__worker_job *done_tail;
+};
+
+
+static void job__append(struct mosquitto__worker_job **head, struct mosquitto__worker_job **tail, struct mosquitto__worker_job *job)
+{
+	job->next = NULL;
+	if(*tail){
+		(*tail)->next = job;
+	}else{
+		*head = job;
+	}
+	*tail = job;
+}
+
+
+static void *worker_pool__thread(void *userdata)
+{
+	struct mosquitto__worker_pool *pool = userdata;
+	struct mosquitto__worker_job *job;
+
+	pthread_mutex_lock(&pool->mutex);
+	while(!pool->stopping){
+		job = pool->pending_head;
+		if(job == NULL){
+			pthread_cond_wait(&pool->cond, &pool->mutex);
+			continue;
+		}
+		pool->pending_head = job->next;
+		if(pool->pending_head == NULL){
+			pool->pending_tail = NULL;
+		}
+		pthread_mutex_unlock(&pool->mutex);
+
+		job->run(job);
+
+		pthread_mutex_lock(&pool->mutex);
+		job__append(&pool->done_head, &pool->done_tail, job);
+		pthread_mutex_unlock(&pool->mutex);
+
+		(void)mux__wakeup();
+
+		pthread_mutex_lock(&pool->mutex);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	return NULL;
+}
+
+
+/* Start a pool of `count` threads. Returns NULL if count is zero or no
+ * threads could be started, in which case the caller should run its jobs
+ * itself. `name` is only used in log messages. */
+struct mosquitto__worker_pool *worker_pool__new(const char *name, int count)
+{
+	struct mosquitto__worker_pool *pool;
+
+	if(count <= 0){
+		return NULL;
+	}
+
+	pool = mosquitto_calloc(1, sizeof(struct mosquitto__worker_pool));
+	if(pool == NULL){
+		return NULL;
+	}
+	pool->threads = mosquitto_calloc((size_t)count, sizeof(pthread_t));
+	if(pool->threads == NULL){
+		mosquitto_FREE(pool);
+		return NULL;
+	}
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->cond, NULL);
+
+	for(pool->thread_count=0; pool->thread_count<count; pool->thread_count++){
+		if(pthread_create(&pool->threads[pool->thread_count], NULL, worker_pool__thread, pool)){
+			log__printf(NULL, MOSQ_LOG_WARNING, "Warning: Unable to start %s thread, %d started.", name, pool->thread_count);
+			break;
+		}
+	}
+	if(pool->thread_count == 0){
+		pthread_cond_destroy(&pool->cond);
+		pthread_mutex_destroy(&pool->mutex);
+		mosquitto_FREE(pool->threads);
+		mosquitto_FREE(pool);
+		return NULL;
+	}
+	return pool;
+}
+
+
+void worker_pool__submit(struct mosquitto__worker_pool *pool, struct mosquitto__worker_job *job)
+{
+	pthread_mutex_lock(&pool->mutex);
+	job__append(&pool->pending_head, &pool->pending_tail, job);
+	pthread_cond_signal(&pool->cond);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+
+/* Returns the finished jobs in the order they finished, and empties the done
+ * list. */
+struct mosquitto__worker_job *worker_pool__take_done(struct mosquitto__worker_pool *pool)
+{
+	struct mosquitto__worker_job *job;
+
+	pthread_mutex_lock(&pool->mutex);
+	job = pool->done_head;
+	pool->done_head = NULL;
+	pool->done_tail = NULL;
+	pthread_mutex_unlock(&pool->mutex);
+
+	return job;
+}
+
+
+/* Stop and join the threads, then free the pool. Jobs that were never started
+ * are returned in `pending`, and finished jobs that haven't been collected in
+ * `done`. */
+void worker_pool__free(struct mosquitto__worker_pool *pool, struct mosquitto__worker_job **pending, struct mosquitto__worker_job **done)
+{
+	*pending = NULL;
+	*done = NULL;
+	if(pool == NULL){
+		return;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->stopping = true;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for(int i=0; i<pool->thread_count; i++){
+		pthread_join(pool->threads[i], NULL);
+	}
+
+	*pending = pool->pending_head;
+	*done = pool->done_head;
+
+	pthread_cond_destroy(&pool->cond);
+	pthread_mutex_destroy(&pool->mutex);
+	mosquitto_FREE(pool->threads);
+	mosquitto_FREE(pool);
+}
+
+#else
+
+struct mosquitto__worker_pool *worker_pool__new(const char *name, int count)
+{
+	UNUSED(name);
+	UNUSED(count);
+
+	return NULL;
+}
+
+
+void worker_pool__submit(struct mosquitto__worker_pool *pool, struct mosquitto__worker_job *job)
+{
+	UNUSED(pool);
+	UNUSED(job);
+}
+
+
+struct mosquitto__worker_job *worker_pool__take_done(struct mosquitto__worker_pool *pool)
+{
+	UNUSED(pool);
+
+	return NULL;
+}
+
+
+void worker_pool__free(struct mosquitto__worker_pool *pool, struct mosquitto__worker_job **pending, struct mosquitto__worker_job **done)
+{
+	UNUSED(pool);
+
+	*pending = NULL;
+	*done = NULL;
+}
+
+#endif
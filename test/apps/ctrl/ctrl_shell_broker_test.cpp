@@ -474,3 +474,42 @@ TEST_F(CtrlShellBrokerTest, ListPluginsInvalidResponse)
 
 	ctrl_shell__main(&config);
 }
+
+
+TEST_F(CtrlShellBrokerTest, GetPluginStats)
+{
+	mosq_config config{};
+	mosquitto mosq{};
+	const char host[] = "localhost";
+	int port = 1883;
+
+	expect_setup(&config);
+	expect_connect(&mosq, host, port);
+	expect_broker(host, port);
+
+	EXPECT_CALL(editline_mock_, readline(t::StrEq("mqtt://localhost:1883|broker> ")))
+		.WillOnce(t::Return(strdup("getPluginStats")))
+		.WillOnce(t::Return(strdup("exit")));
+
+	expect_connect_and_messages(&mosq);
+
+	const char request[] = "{\"commands\":[{\"command\":\"getPluginStats\"}]}";
+	const char response[] = "{\"responses\":[{\"command\":\"getPluginStats\",\"data\":{"
+			"\"plugins\":["
+			"{\"name\":\"plugin1\",\"events\":["
+			"{\"event\":\"basic-auth\",\"count\":3,\"total-ns\":4500,\"max-ns\":2500,\"p50-ns\":1000,\"p90-ns\":2000,\"p99-ns\":2000}"
+			"]}"
+			"]}}]}";
+	expect_request_response(&mosq, request, response);
+
+	const char *outputs[] = {
+		"Plugin:",
+		"  plugin1\n",
+		"  basic-auth",
+		"    3 calls, p50 1.0us, p99 2.0us, max 2.5us\n",
+		"\n",
+	};
+	expect_outputs(outputs, sizeof(outputs)/sizeof(char *));
+
+	ctrl_shell__main(&config);
+}
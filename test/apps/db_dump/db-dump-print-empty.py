@@ -56,3 +56,14 @@ DB_CHUNK_CFG:
 	Last DB ID: 208485212291791
 """
 do_test('v6-empty.test-db', v6_empty)
+
+v7_empty = """Mosquitto DB dump
+CRC: 0
+DB version: 7
+DB_CHUNK_CFG:
+	Length: 16
+	Shutdown: 1
+	DB ID size: 8
+	Last DB ID: 8671175384462524416
+"""
+do_test('v7-empty.test-db', v7_empty)
@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+
+# Check $filter/ subscriptions only receive messages with matching payloads
+
+from mosq_test_helper import *
+
+def do_test(proto_ver):
+    rc = 1
+
+    if proto_ver == 5:
+        invalid_rc = mqtt5_rc.TOPIC_FILTER_INVALID
+    else:
+        invalid_rc = 0x80
+
+    filtered = "$filter/temp>20 && unit==\"C\"/sensors/+"
+    sub_connect_packet = mosq_test.gen_connect("sub", proto_ver=proto_ver)
+    connack_packet = mosq_test.gen_connack(rc=0, proto_ver=proto_ver)
+
+    subscribe1_packet = mosq_test.gen_subscribe(1, filtered, 0, proto_ver=proto_ver)
+    suback1_packet = mosq_test.gen_suback(1, 0, proto_ver=proto_ver)
+
+    subscribe2_packet = mosq_test.gen_subscribe(2, "$filter/temp >/sensors/+", 0, proto_ver=proto_ver)
+    suback2_packet = mosq_test.gen_suback(2, invalid_rc, proto_ver=proto_ver)
+
+    subscribe3_packet = mosq_test.gen_subscribe(3, "$filter/!alarm/plain/#", 0, proto_ver=proto_ver)
+    suback3_packet = mosq_test.gen_suback(3, 0, proto_ver=proto_ver)
+
+    subscribe4_packet = mosq_test.gen_subscribe(4, "plain/#", 0, proto_ver=proto_ver)
+    suback4_packet = mosq_test.gen_suback(4, 0, proto_ver=proto_ver)
+
+    subscribe5_packet = mosq_test.gen_subscribe(5, "$filter/level>=3/retained", 0, proto_ver=proto_ver)
+    suback5_packet = mosq_test.gen_suback(5, 0, proto_ver=proto_ver)
+
+    unsubscribe_packet = mosq_test.gen_unsubscribe(6, filtered, proto_ver=proto_ver)
+    unsuback_packet = mosq_test.gen_unsuback(6, proto_ver=proto_ver)
+
+    pub_connect_packet = mosq_test.gen_connect("pub", proto_ver=proto_ver)
+
+    port = mosq_test.get_port()
+    broker = mosq_test.start_broker(filename=os.path.basename(__file__), port=port)
+
+    def publish(sock, topic, payload, retain=False):
+        sock.send(mosq_test.gen_publish(topic, qos=0, payload=payload, retain=retain, proto_ver=proto_ver))
+
+    def expect(sock, topic, payload, retain=False):
+        packet = mosq_test.gen_publish(topic, qos=0, payload=payload, retain=retain, proto_ver=proto_ver)
+        mosq_test.expect_packet(sock, f"publish {topic} {payload}", packet)
+
+    try:
+        pub_sock = mosq_test.do_client_connect(pub_connect_packet, connack_packet, port=port)
+        publish(pub_sock, "retained", '{"level":1}', retain=True)
+        mosq_test.do_ping(pub_sock)
+
+        sub_sock = mosq_test.do_client_connect(sub_connect_packet, connack_packet, port=port)
+        mosq_test.do_send_receive(sub_sock, subscribe1_packet, suback1_packet, "suback1")
+        mosq_test.do_send_receive(sub_sock, subscribe2_packet, suback2_packet, "suback2")
+
+        # Only payloads matching the predicate are delivered
+        publish(pub_sock, "sensors/a", '{"temp":18,"unit":"C"}')
+        publish(pub_sock, "sensors/a", '{"temp":22,"unit":"F"}')
+        publish(pub_sock, "sensors/a", 'not json')
+        publish(pub_sock, "sensors/a", '{"unit":"C"}')
+        publish(pub_sock, "sensors/b", '{"temp":22.5,"unit":"C"}')
+        expect(sub_sock, "sensors/b", '{"temp":22.5,"unit":"C"}')
+
+        # A filtered and a plain subscription to the same topic coexist
+        mosq_test.do_send_receive(sub_sock, subscribe3_packet, suback3_packet, "suback3")
+        mosq_test.do_send_receive(sub_sock, subscribe4_packet, suback4_packet, "suback4")
+        publish(pub_sock, "plain/x", '{"alarm":true}')
+        expect(sub_sock, "plain/x", '{"alarm":true}')
+        publish(pub_sock, "plain/x", '{"alarm":false}')
+        expect(sub_sock, "plain/x", '{"alarm":false}')
+        expect(sub_sock, "plain/x", '{"alarm":false}')
+
+        # Retained messages are filtered as well
+        mosq_test.do_send_receive(sub_sock, subscribe5_packet, suback5_packet, "suback5")
+        mosq_test.do_ping(sub_sock)
+        publish(pub_sock, "retained", '{"level":3}', retain=True)
+        expect(sub_sock, "retained", '{"level":3}')
+        sub_sock.send(subscribe5_packet)
+        mosq_test.expect_packet(sub_sock, "suback5", suback5_packet)
+        expect(sub_sock, "retained", '{"level":3}', retain=True)
+
+        # Unsubscribing uses the same string
+        mosq_test.do_send_receive(sub_sock, unsubscribe_packet, unsuback_packet, "unsuback")
+        publish(pub_sock, "sensors/b", '{"temp":30,"unit":"C"}')
+        mosq_test.do_ping(pub_sock)
+        mosq_test.do_ping(sub_sock)
+        rc = 0
+
+        pub_sock.close()
+        sub_sock.close()
+    except mosq_test.TestError:
+        pass
+    finally:
+        broker.terminate()
+        if mosq_test.wait_for_subprocess(broker):
+            print("broker not terminated")
+            if rc == 0: rc=1
+        (stdo, stde) = broker.communicate()
+        if rc:
+            print(stde.decode('utf-8'))
+            print("proto_ver=%d" % (proto_ver))
+            exit(rc)
+
+do_test(proto_ver=4)
+do_test(proto_ver=5)
+exit(0)
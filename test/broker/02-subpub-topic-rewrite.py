@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+
+# Check topic_rewrite changes the topic of incoming messages
+
+from mosq_test_helper import *
+
+def write_config(filename, port):
+    with open(filename, 'w') as f:
+        f.write("listener %d\n" % (port))
+        f.write("allow_anonymous true\n")
+        f.write("topic_rewrite device/+/data/uplink device/%1/data\n")
+        f.write("topic_rewrite jail/# jails/%c/%1\n")
+
+def do_test():
+    port = mosq_test.get_port()
+    conf_file = os.path.basename(__file__).replace('.py', '.conf')
+    write_config(conf_file, port)
+
+    rc = 1
+    proto_ver = 5
+
+    sub_connect_packet = mosq_test.gen_connect("sub", proto_ver=proto_ver)
+    connack_packet = mosq_test.gen_connack(rc=0, proto_ver=proto_ver)
+    subscribe_packet = mosq_test.gen_subscribe(1, "#", 0, proto_ver=proto_ver)
+    suback_packet = mosq_test.gen_suback(1, 0, proto_ver=proto_ver)
+
+    pub_connect_packet = mosq_test.gen_connect("pub", proto_ver=proto_ver)
+    bad_connect_packet = mosq_test.gen_connect("bad+id", proto_ver=proto_ver)
+
+    broker = mosq_test.start_broker(filename=os.path.basename(__file__), use_conf=True, port=port)
+
+    try:
+        sub_sock = mosq_test.do_client_connect(sub_connect_packet, connack_packet, port=port)
+        mosq_test.do_send_receive(sub_sock, subscribe_packet, suback_packet, "suback")
+
+        pub_sock = mosq_test.do_client_connect(pub_connect_packet, connack_packet, port=port)
+
+        for (topic, expected) in [
+                ("device/0001/data/uplink", "device/0001/data"),
+                ("device/0001/data/downlink", "device/0001/data/downlink"),
+                ("jail/a/b", "jails/pub/a/b"),
+                ("jail", "jails/pub"),
+                ]:
+            publish_packet = mosq_test.gen_publish(topic, qos=0, payload="message", proto_ver=proto_ver)
+            expected_packet = mosq_test.gen_publish(expected, qos=0, payload="message", proto_ver=proto_ver)
+            pub_sock.send(publish_packet)
+            mosq_test.expect_packet(sub_sock, f"publish {topic}", expected_packet)
+
+        # The client id makes the new topic invalid, so the message is rejected
+        bad_sock = mosq_test.do_client_connect(bad_connect_packet, connack_packet, port=port)
+        publish_packet = mosq_test.gen_publish("jail/a", qos=1, mid=1, payload="message", proto_ver=proto_ver)
+        puback_packet = mosq_test.gen_puback(1, proto_ver=proto_ver, reason_code=mqtt5_rc.TOPIC_NAME_INVALID)
+        mosq_test.do_send_receive(bad_sock, publish_packet, puback_packet, "puback")
+
+        mosq_test.do_ping(sub_sock)
+        rc = 0
+
+        bad_sock.close()
+        pub_sock.close()
+        sub_sock.close()
+    except mosq_test.TestError:
+        pass
+    finally:
+        os.remove(conf_file)
+        broker.terminate()
+        if mosq_test.wait_for_subprocess(broker):
+            print("broker not terminated")
+            if rc == 0: rc=1
+        (stdo, stde) = broker.communicate()
+        if rc:
+            print(stde.decode('utf-8'))
+            exit(rc)
+
+do_test()
+exit(0)
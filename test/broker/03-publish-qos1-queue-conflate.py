@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+
+# Test whether conflate_queued_messages replaces queued messages for offline
+# and slow clients with newer messages on the same topic, keeping their place
+# in the queue, and that listeners without the option queue every message.
+
+from mosq_test_helper import *
+
+def write_config(filename, port1, port2):
+    with open(filename, 'w') as f:
+        f.write("max_inflight_messages 1\n")
+        f.write("listener %d\n" % (port1))
+        f.write("allow_anonymous true\n")
+        f.write("conflate_queued_messages true\n")
+        f.write("\n")
+        f.write("listener %d\n" % (port2))
+        f.write("allow_anonymous true\n")
+
+def gen_connack(proto_ver, flags=0):
+    properties = mqtt5_props.gen_uint16_prop(mqtt5_props.TOPIC_ALIAS_MAXIMUM, 10) \
+        + mqtt5_props.gen_uint32_prop(mqtt5_props.MAXIMUM_PACKET_SIZE, 2000000) \
+        + mqtt5_props.gen_uint16_prop(mqtt5_props.RECEIVE_MAXIMUM, 1)
+    return mosq_test.gen_connack(rc=0, flags=flags, proto_ver=proto_ver, properties=properties, property_helper=False)
+
+def subscribe(port, client_id, proto_ver):
+    connect_packet = mosq_test.gen_connect(client_id, clean_session=False, proto_ver=proto_ver, session_expiry=60)
+    connack_packet = gen_connack(proto_ver)
+    subscribe_packet = mosq_test.gen_subscribe(1, "state/#", 1, proto_ver=proto_ver)
+    suback_packet = mosq_test.gen_suback(1, 1, proto_ver=proto_ver)
+
+    sock = mosq_test.do_client_connect(connect_packet, connack_packet, timeout=20, port=port)
+    mosq_test.do_send_receive(sock, subscribe_packet, suback_packet, "suback")
+    sock.close()
+
+def receive(port, client_id, proto_ver, expected):
+    connect_packet = mosq_test.gen_connect(client_id, clean_session=False, proto_ver=proto_ver, session_expiry=60)
+    connack_packet = gen_connack(proto_ver, flags=1)
+
+    sock = mosq_test.do_client_connect(connect_packet, connack_packet, timeout=20, port=port)
+    for (mid, topic, qos, payload) in expected:
+        publish_packet = mosq_test.gen_publish(topic, qos=qos, mid=mid, payload=payload, proto_ver=proto_ver)
+        mosq_test.expect_packet(sock, "publish %s %s" % (topic, payload), publish_packet)
+        if qos == 1:
+            sock.send(mosq_test.gen_puback(mid, proto_ver=proto_ver))
+    mosq_test.do_ping(sock)
+    sock.close()
+
+def do_test(proto_ver):
+    (port1, port2) = mosq_test.get_port(2)
+    conf_file = os.path.basename(__file__).replace('.py', '.conf')
+    write_config(conf_file, port1, port2)
+
+    rc = 1
+    messages = [
+        ("state/a", 1, "a1"),
+        ("state/b", 1, "b1"),
+        ("state/a", 1, "a2"),
+        ("state/c", 1, "c1"),
+        ("state/a", 0, "a3"),
+        ("state/b", 1, "b2"),
+    ]
+
+    connack_packet = gen_connack(proto_ver)
+    pub_connect_packet = mosq_test.gen_connect("pub", proto_ver=proto_ver)
+
+    broker = mosq_test.start_broker(filename=os.path.basename(__file__), use_conf=True, port=port1)
+
+    try:
+        subscribe(port1, "conflate", proto_ver)
+        subscribe(port2, "no-conflate", proto_ver)
+
+        pub_sock = mosq_test.do_client_connect(pub_connect_packet, connack_packet, timeout=20, port=port1)
+        mid = 1
+        for (topic, qos, payload) in messages:
+            publish_packet = mosq_test.gen_publish(topic, qos=qos, mid=mid, payload=payload, proto_ver=proto_ver)
+            if qos == 1:
+                puback_packet = mosq_test.gen_puback(mid, proto_ver=proto_ver)
+                mosq_test.do_send_receive(pub_sock, publish_packet, puback_packet, "puback %s" % (payload))
+            else:
+                pub_sock.send(publish_packet)
+            mid += 1
+        mosq_test.do_ping(pub_sock)
+        pub_sock.close()
+
+        # Only the latest value of each topic, in the order the topics were
+        # first queued. Each replacement takes the mid of the newer message.
+        # The QoS 0 message isn't queued for an offline client, so doesn't
+        # replace anything.
+        receive(port1, "conflate", proto_ver, [
+            (3, "state/a", 1, "a2"),
+            (5, "state/b", 1, "b2"),
+            (4, "state/c", 1, "c1"),
+        ])
+
+        receive(port2, "no-conflate", proto_ver, [
+            (1, "state/a", 1, "a1"),
+            (2, "state/b", 1, "b1"),
+            (3, "state/a", 1, "a2"),
+            (4, "state/c", 1, "c1"),
+            (5, "state/b", 1, "b2"),
+        ])
+
+        # A connected client that hasn't acknowledged its inflight message
+        properties = mqtt5_props.gen_uint16_prop(mqtt5_props.RECEIVE_MAXIMUM, 1)
+        connect_packet = mosq_test.gen_connect("slow", proto_ver=proto_ver, properties=properties)
+        subscribe_packet = mosq_test.gen_subscribe(1, "slow/#", 1, proto_ver=proto_ver)
+        suback_packet = mosq_test.gen_suback(1, 1, proto_ver=proto_ver)
+        sock = mosq_test.do_client_connect(connect_packet, connack_packet, timeout=20, port=port1)
+        mosq_test.do_send_receive(sock, subscribe_packet, suback_packet, "suback")
+
+        pub_sock = mosq_test.do_client_connect(pub_connect_packet, connack_packet, timeout=20, port=port1)
+        for i in range(1, 4):
+            publish_packet = mosq_test.gen_publish("slow/x", qos=1, mid=i, payload="x%d" % (i), proto_ver=proto_ver)
+            puback_packet = mosq_test.gen_puback(i, proto_ver=proto_ver)
+            mosq_test.do_send_receive(pub_sock, publish_packet, puback_packet, "puback x%d" % (i))
+        pub_sock.close()
+
+        publish_packet = mosq_test.gen_publish("slow/x", qos=1, mid=1, payload="x1", proto_ver=proto_ver)
+        mosq_test.expect_packet(sock, "publish x1", publish_packet)
+        sock.send(mosq_test.gen_puback(1, proto_ver=proto_ver))
+        publish_packet = mosq_test.gen_publish("slow/x", qos=1, mid=3, payload="x3", proto_ver=proto_ver)
+        mosq_test.expect_packet(sock, "publish x3", publish_packet)
+        sock.send(mosq_test.gen_puback(3, proto_ver=proto_ver))
+        mosq_test.do_ping(sock)
+        sock.close()
+        rc = 0
+    except mosq_test.TestError:
+        pass
+    finally:
+        os.remove(conf_file)
+        broker.terminate()
+        if mosq_test.wait_for_subprocess(broker):
+            print("broker not terminated")
+            if rc == 0: rc=1
+        (stdo, stde) = broker.communicate()
+        if rc:
+            print(stde.decode('utf-8'))
+            print("proto_ver=%d" % (proto_ver))
+            exit(rc)
+
+do_test(proto_ver=4)
+do_test(proto_ver=5)
+exit(0)
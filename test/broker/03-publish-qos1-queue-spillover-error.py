@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+
+# Test that when writing to the spillover file fails part way through a spill,
+# the queued messages that are still delivered arrive in order. The broker is
+# run with a small file size limit so the writes to the spillover file start
+# failing once it reaches that size.
+
+from mosq_test_helper import *
+import glob
+import struct
+
+def write_config(filename, port):
+    with open(filename, 'w') as f:
+        f.write("listener %d\n" % (port))
+        f.write("allow_anonymous true\n")
+        f.write("queue_spillover_bytes 100\n")
+        f.write("queue_spillover_location spill-%d\n" % (port))
+
+def read_packet(sock):
+    hdr = sock.recv(1)
+    if len(hdr) == 0:
+        raise mosq_test.TestError("connection closed")
+    rl = 0
+    multiplier = 1
+    while True:
+        byte, = struct.unpack("!B", sock.recv(1))
+        rl += (byte & 127) * multiplier
+        multiplier *= 128
+        if byte & 128 == 0:
+            break
+    body = b""
+    while len(body) < rl:
+        chunk = sock.recv(rl - len(body))
+        if len(chunk) == 0:
+            raise mosq_test.TestError("connection closed")
+        body += chunk
+    return hdr[0], body
+
+count = 60
+
+port = mosq_test.get_port()
+conf_file = os.path.basename(__file__).replace('.py', '.conf')
+write_config(conf_file, port)
+spill_dir = 'spill-%d' % (port)
+os.mkdir(spill_dir)
+os.chmod(spill_dir, 0o777)
+
+rc = 1
+connect_packet = mosq_test.gen_connect("spillover-error", clean_session=False)
+connack_packet = mosq_test.gen_connack(rc=0)
+connack_packet2 = mosq_test.gen_connack(rc=0, flags=1)
+
+subscribe_packet = mosq_test.gen_subscribe(1, "spillover/error", 1)
+suback_packet = mosq_test.gen_suback(1, 1)
+
+pub_connect_packet = mosq_test.gen_connect("spillover-error-pub")
+
+# A limit of 4 blocks allows a few dozen spilled messages. The shell ignores
+# SIGXFSZ so the broker sees the write errors rather than being killed.
+cmd = ['sh', '-c', 'ulimit -f 4; trap "" XFSZ; exec "$@"', 'sh',
+        mosq_test.get_build_root() + '/src/mosquitto', '-v', '-c', conf_file]
+broker = mosq_test.start_broker(filename=os.path.basename(__file__), cmd=cmd, port=port)
+
+try:
+    sock = mosq_test.do_client_connect(connect_packet, connack_packet, timeout=20, port=port)
+    mosq_test.do_send_receive(sock, subscribe_packet, suback_packet, "suback")
+    sock.close()
+
+    pub_sock = mosq_test.do_client_connect(pub_connect_packet, connack_packet, timeout=20, port=port)
+    for i in range(1, count+1):
+        publish_packet = mosq_test.gen_publish("spillover/error", qos=1, mid=i, payload="message-%04d-%s" % (i, "x"*40))
+        puback_packet = mosq_test.gen_puback(i)
+        mosq_test.do_send_receive(pub_sock, publish_packet, puback_packet, "puback%d" % (i))
+    pub_sock.close()
+
+    sock = mosq_test.do_client_connect(connect_packet, connack_packet2, timeout=20, port=port)
+    sock.send(mosq_test.gen_pingreq())
+    received = []
+    while True:
+        cmd, body = read_packet(sock)
+        if cmd == 0xD0:
+            if len(received) == count:
+                break
+            # Keep going until nothing else is delivered
+            time.sleep(0.5)
+            sock.send(mosq_test.gen_pingreq())
+            cmd, body = read_packet(sock)
+            if cmd == 0xD0:
+                break
+        if cmd & 0xF0 != 0x30:
+            raise mosq_test.TestError("unexpected packet %02x" % (cmd))
+        topic_len, = struct.unpack("!H", body[0:2])
+        mid, = struct.unpack("!H", body[2+topic_len:4+topic_len])
+        payload = body[4+topic_len:].decode('utf-8')
+        received.append(int(payload.split('-')[1]))
+        sock.send(mosq_test.gen_puback(mid))
+    sock.close()
+
+    if received != sorted(received):
+        raise mosq_test.TestError("messages out of order: %s" % (received))
+    if len(received) == count:
+        raise mosq_test.TestError("spillover file writes did not fail")
+    # The message queued in memory before spilling started is never lost
+    if received[0] != 1:
+        raise mosq_test.TestError("messages missing: %s" % (received))
+    rc = 0
+except mosq_test.TestError as e:
+    print(e)
+finally:
+    os.remove(conf_file)
+    broker.terminate()
+    if mosq_test.wait_for_subprocess(broker):
+        print("broker not terminated")
+        if rc == 0: rc=1
+    (stdo, stde) = broker.communicate()
+    for f in glob.glob(os.path.join(spill_dir, '*')):
+        os.unlink(f)
+    os.rmdir(spill_dir)
+    if rc:
+        print(stde.decode('utf-8'))
+
+exit(rc)
@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+
+# Test whether queued messages for an offline client that have been spilled to
+# disk with queue_spillover_bytes are delivered in order, both before and after
+# a restart, and whether the spillover files are removed afterwards.
+
+from mosq_test_helper import *
+import glob
+
+def write_config(filename, port):
+    with open(filename, 'w') as f:
+        f.write("listener %d\n" % (port))
+        f.write("allow_anonymous true\n")
+        f.write("persistence true\n")
+        f.write("persistence_file mosquitto-%d.db\n" % (port))
+        f.write("queue_spillover_bytes 100\n")
+        f.write("queue_spillover_location spill-%d\n" % (port))
+
+def restart_broker(broker, port):
+    broker.terminate()
+    if mosq_test.wait_for_subprocess(broker):
+        raise mosq_test.TestError("broker not terminated")
+    broker.communicate()
+    return mosq_test.start_broker(filename=os.path.basename(__file__), use_conf=True, port=port)
+
+def publish_messages(port, proto_ver, first, last):
+    connack_packet = mosq_test.gen_connack(rc=0, proto_ver=proto_ver)
+    pub_connect_packet = mosq_test.gen_connect("spillover-pub", proto_ver=proto_ver)
+
+    pub_sock = mosq_test.do_client_connect(pub_connect_packet, connack_packet, timeout=20, port=port)
+    for i in range(first, last+1):
+        publish_packet = mosq_test.gen_publish("spillover/queue", qos=1, mid=i, payload="message-%04d" % (i), proto_ver=proto_ver)
+        puback_packet = mosq_test.gen_puback(i, proto_ver=proto_ver)
+        mosq_test.do_send_receive(pub_sock, publish_packet, puback_packet, "puback%d" % (i))
+    pub_sock.close()
+
+def receive_messages(sock, proto_ver, first, last, first_mid):
+    for i in range(first, last+1):
+        mid = first_mid + i - first
+        publish_packet = mosq_test.gen_publish("spillover/queue", qos=1, mid=mid, payload="message-%04d" % (i), proto_ver=proto_ver)
+        puback_packet = mosq_test.gen_puback(mid, proto_ver=proto_ver)
+        mosq_test.expect_packet(sock, "publish%d" % (i), publish_packet)
+        sock.send(puback_packet)
+
+def do_test(proto_ver, restart):
+    port = mosq_test.get_port()
+    conf_file = os.path.basename(__file__).replace('.py', '.conf')
+    write_config(conf_file, port)
+    spill_dir = 'spill-%d' % (port)
+    os.mkdir(spill_dir)
+    os.chmod(spill_dir, 0o777)
+
+    rc = 1
+    connect_packet = mosq_test.gen_connect(
+        "spillover-test", clean_session=False, proto_ver=proto_ver, session_expiry=60
+    )
+    connack_packet = mosq_test.gen_connack(rc=0, proto_ver=proto_ver)
+    connack_packet2 = mosq_test.gen_connack(rc=0, flags=1, proto_ver=proto_ver)
+
+    subscribe_packet = mosq_test.gen_subscribe(1, "spillover/queue", 1, proto_ver=proto_ver)
+    suback_packet = mosq_test.gen_suback(1, 1, proto_ver=proto_ver)
+
+    broker = mosq_test.start_broker(filename=os.path.basename(__file__), use_conf=True, port=port)
+
+    try:
+        sock = mosq_test.do_client_connect(connect_packet, connack_packet, timeout=20, port=port)
+        mosq_test.do_send_receive(sock, subscribe_packet, suback_packet, "suback")
+        sock.close()
+
+        # 12 bytes per payload, so most of these end up on disk
+        publish_messages(port, proto_ver, 1, 30)
+        if len(glob.glob(os.path.join(spill_dir, 'mosquitto-spill-*.seg'))) == 0:
+            raise mosq_test.TestError("no spillover file")
+
+        if restart:
+            broker = restart_broker(broker, port)
+            # Queued behind the restored messages
+            publish_messages(port, proto_ver, 31, 35)
+            last = 35
+        else:
+            last = 30
+
+        sock = mosq_test.do_client_connect(connect_packet, connack_packet2, timeout=20, port=port)
+        receive_messages(sock, proto_ver, 1, last, 1)
+        mosq_test.do_ping(sock)
+        sock.close()
+
+        # Spilling again once the queue has been emptied
+        publish_messages(port, proto_ver, 36, 50)
+        sock = mosq_test.do_client_connect(connect_packet, connack_packet2, timeout=20, port=port)
+        receive_messages(sock, proto_ver, 36, 50, last+1)
+        mosq_test.do_ping(sock)
+        sock.close()
+        rc = 0
+    except mosq_test.TestError:
+        pass
+    finally:
+        os.remove(conf_file)
+        broker.terminate()
+        if mosq_test.wait_for_subprocess(broker):
+            print("broker not terminated")
+            if rc == 0: rc=1
+        (stdo, stde) = broker.communicate()
+        if os.path.exists('mosquitto-%d.db' % (port)):
+            os.unlink('mosquitto-%d.db' % (port))
+        leftover = glob.glob(os.path.join(spill_dir, '*'))
+        if leftover:
+            print("spillover files not removed: %s" % (leftover))
+            for f in leftover:
+                os.unlink(f)
+            if rc == 0: rc=1
+        os.rmdir(spill_dir)
+        if rc:
+            print(stde.decode('utf-8'))
+            print("proto_ver=%d restart=%s" % (proto_ver, restart))
+            exit(rc)
+
+
+do_test(proto_ver=4, restart=False)
+do_test(proto_ver=4, restart=True)
+do_test(proto_ver=5, restart=False)
+do_test(proto_ver=5, restart=True)
+exit(0)
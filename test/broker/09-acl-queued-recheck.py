@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+
+# Check that a long queue of messages for an offline client is checked against
+# the ACLs again when the client reconnects, so messages that are no longer
+# allowed are never delivered, and the allowed messages arrive in order.
+
+from mosq_test_helper import *
+import signal
+
+def write_config(filename, port):
+    with open(filename, 'w') as f:
+        f.write("listener %d\n" % (port))
+        f.write("allow_anonymous true\n")
+        f.write("max_queued_messages 5000\n")
+        f.write("acl_file %s\n" % (filename.replace('.conf', '.acl')))
+
+def write_acl(filename, en):
+    with open(filename, 'w') as f:
+        f.write('user username\n')
+        f.write('topic readwrite topic/one\n')
+        if en:
+            f.write('topic readwrite topic/two\n')
+
+count = 3000
+
+port = mosq_test.get_port()
+conf_file = os.path.basename(__file__).replace('.py', '.conf')
+write_config(conf_file, port)
+acl_file = os.path.basename(__file__).replace('.py', '.acl')
+write_acl(acl_file, True)
+
+rc = 1
+connect_packet = mosq_test.gen_connect("acl-recheck", username="username", clean_session=False)
+connack_packet = mosq_test.gen_connack(rc=0)
+connack_packet_resumed = mosq_test.gen_connack(rc=0, flags=1)
+
+subscribe_packet = mosq_test.gen_subscribe(mid=1, topic="topic/+", qos=1)
+suback_packet = mosq_test.gen_suback(mid=1, qos=1)
+
+helper_connect_packet = mosq_test.gen_connect("helper", username="username")
+
+# Logging is disabled because the volume of messages would fill the pipe
+broker = mosq_test.start_broker(filename=os.path.basename(__file__), use_conf=True, port=port, nolog=True)
+
+try:
+    sock = mosq_test.do_client_connect(connect_packet, connack_packet, port=port)
+    mosq_test.do_send_receive(sock, subscribe_packet, suback_packet, "suback")
+    sock.close()
+
+    # Queue alternating messages on topic/one and topic/two
+    helper = mosq_test.do_client_connect(helper_connect_packet, connack_packet, port=port)
+    for i in range(count):
+        topic = "topic/one" if i % 2 == 0 else "topic/two"
+        publish_packet = mosq_test.gen_publish(topic=topic, mid=1, qos=1, payload="message%d" % (i))
+        mosq_test.do_send_receive(helper, publish_packet, mosq_test.gen_puback(1), "helper puback")
+    helper.close()
+
+    # Revoke access to topic/two
+    write_acl(acl_file, False)
+    broker.send_signal(signal.SIGHUP)
+    time.sleep(0.5)
+
+    sock = mosq_test.do_client_connect(connect_packet, connack_packet_resumed, port=port, timeout=20)
+    for i in range(0, count, 2):
+        mid = i + 1
+        publish_packet = mosq_test.gen_publish(topic="topic/one", mid=mid, qos=1, payload="message%d" % (i))
+        mosq_test.expect_packet(sock, "publish %d" % (i), publish_packet)
+        sock.send(mosq_test.gen_puback(mid))
+
+    # No topic/two messages
+    mosq_test.do_ping(sock)
+    sock.close()
+    rc = 0
+except mosq_test.TestError:
+    pass
+finally:
+    os.remove(conf_file)
+    os.remove(acl_file)
+    broker.terminate()
+    if mosq_test.wait_for_subprocess(broker):
+        print("broker not terminated")
+        if rc == 0: rc=1
+    broker.communicate()
+
+exit(rc)
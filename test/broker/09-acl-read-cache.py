@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+
+# Check that remembered read ACL results for subscriptions without wildcards
+# are discarded when the ACL file is reloaded, and when a client resumes its
+# session with a different username. Run with both the acl_file option and the
+# acl-file plugin.
+
+from mosq_test_helper import *
+import signal
+
+def write_config_default(filename, port):
+    with open(filename, 'w') as f:
+        f.write("listener %d\n" % (port))
+        f.write("allow_anonymous true\n")
+        f.write("acl_file %s\n" % (filename.replace('.conf', '.acl')))
+
+def write_config_plugin(filename, port):
+    with open(filename, 'w') as f:
+        f.write("listener %d\n" % (port))
+        f.write("allow_anonymous true\n")
+        f.write(f"plugin {mosq_test.get_build_root()}/plugins/acl-file/mosquitto_acl_file.so\n")
+        f.write("plugin_opt_acl_file %s\n" % (filename.replace('.conf', '.acl')))
+
+def write_acl(filename, en):
+    with open(filename, 'w') as f:
+        f.write('user username\n')
+        f.write('topic readwrite topic/one\n')
+        if en:
+            f.write('topic readwrite topic/two\n')
+        f.write('user other\n')
+        f.write('topic readwrite topic/one\n')
+
+
+def publish_helper(port, topic, payload):
+    connect_packet = mosq_test.gen_connect("helper", username="username")
+    connack_packet = mosq_test.gen_connack(rc=0)
+    publish_packet = mosq_test.gen_publish(topic=topic, mid=1, qos=1, payload=payload)
+    puback_packet = mosq_test.gen_puback(1)
+
+    sock = mosq_test.do_client_connect(connect_packet, connack_packet, port=port)
+    mosq_test.do_send_receive(sock, publish_packet, puback_packet, "helper puback")
+    sock.close()
+
+
+def do_test(write_config_func):
+    port = mosq_test.get_port()
+    conf_file = os.path.basename(__file__).replace('.py', '.conf')
+    acl_file = os.path.basename(__file__).replace('.py', '.acl')
+    write_config_func(conf_file, port)
+    write_acl(acl_file, True)
+
+    rc = 1
+    connect_packet = mosq_test.gen_connect("acl-cache", username="username", clean_session=False)
+    connect_packet_other = mosq_test.gen_connect("acl-cache", username="other", clean_session=False)
+    connack_packet = mosq_test.gen_connack(rc=0)
+    connack_packet_resumed = mosq_test.gen_connack(rc=0, flags=1)
+
+    subscribe_packet = mosq_test.gen_subscribe(mid=1, topic="topic/two", qos=0)
+    suback_packet = mosq_test.gen_suback(mid=1, qos=0)
+
+    publish1_packet = mosq_test.gen_publish(topic="topic/two", qos=0, payload="message1")
+    publish2_packet = mosq_test.gen_publish(topic="topic/two", qos=0, payload="message2")
+
+    broker = mosq_test.start_broker(filename=os.path.basename(__file__), use_conf=True, port=port)
+
+    try:
+        sock = mosq_test.do_client_connect(connect_packet, connack_packet, port=port)
+        mosq_test.do_send_receive(sock, subscribe_packet, suback_packet, "suback")
+
+        # Delivered twice, the second time from the remembered result
+        for payload in ["message1", "message2"]:
+            publish_helper(port, "topic/two", payload)
+            mosq_test.expect_packet(sock, "publish", mosq_test.gen_publish(topic="topic/two", qos=0, payload=payload))
+
+        # Resume the session as a user without access to topic/two
+        sock.close()
+        sock = mosq_test.do_client_connect(connect_packet_other, connack_packet_resumed, port=port)
+        publish_helper(port, "topic/two", "message3")
+        mosq_test.do_ping(sock)
+
+        # And back again
+        sock.close()
+        sock = mosq_test.do_client_connect(connect_packet, connack_packet_resumed, port=port)
+        publish_helper(port, "topic/two", "message1")
+        mosq_test.expect_packet(sock, "publish1", publish1_packet)
+
+        # Revoke access to topic/two while the client stays connected
+        write_acl(acl_file, False)
+        broker.send_signal(signal.SIGHUP)
+        time.sleep(0.5)
+        publish_helper(port, "topic/two", "message2")
+        mosq_test.do_ping(sock)
+
+        # Restore access
+        write_acl(acl_file, True)
+        broker.send_signal(signal.SIGHUP)
+        time.sleep(0.5)
+        publish_helper(port, "topic/two", "message2")
+        mosq_test.expect_packet(sock, "publish2", publish2_packet)
+
+        sock.close()
+        rc = 0
+    except mosq_test.TestError:
+        pass
+    finally:
+        os.remove(conf_file)
+        os.remove(acl_file)
+        broker.terminate()
+        if mosq_test.wait_for_subprocess(broker):
+            print("broker not terminated")
+            if rc == 0: rc=1
+        (stdo, stde) = broker.communicate()
+        if rc:
+            print(stde.decode('utf-8'))
+            exit(rc)
+
+do_test(write_config_default)
+do_test(write_config_plugin)
+exit(0)
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+
+# Check "subscribe" ACLs in an ACL file, with both the acl_file option and the
+# acl-file plugin. Subscriptions must be covered by a "subscribe" topic or
+# pattern for the client, and "deny" topics deny subscriptions they cover.
+
+from mosq_test_helper import *
+
+def write_config_default(filename, port):
+    with open(filename, 'w') as f:
+        f.write("listener %d\n" % (port))
+        f.write("allow_anonymous true\n")
+        f.write("acl_file %s\n" % (filename.replace('.conf', '.acl')))
+
+def write_config_plugin(filename, port):
+    with open(filename, 'w') as f:
+        f.write("listener %d\n" % (port))
+        f.write("allow_anonymous true\n")
+        f.write(f"plugin {mosq_test.get_build_root()}/plugins/acl-file/mosquitto_acl_file.so\n")
+        f.write("plugin_opt_acl_file %s\n" % (filename.replace('.conf', '.acl')))
+
+def write_acl(filename):
+    with open(filename, 'w') as f:
+        f.write('topic subscribe sensors/#\n')
+        f.write('topic read sensors/#\n')
+        f.write('topic deny sensors/secret\n')
+        f.write('user username\n')
+        f.write('topic readwrite user/#\n')
+        f.write('topic subscribe user/+/data\n')
+        f.write('pattern subscribe client/%c/#\n')
+
+
+def check_subscribe(sock, topic, allowed):
+    mid = 10
+    subscribe_packet = mosq_test.gen_subscribe(mid, topic, 1)
+    suback_packet = mosq_test.gen_suback(mid, 1 if allowed else 128)
+    mosq_test.do_send_receive(sock, subscribe_packet, suback_packet, "suback %s" % (topic))
+
+
+def do_test(write_config_func):
+    port = mosq_test.get_port()
+    conf_file = os.path.basename(__file__).replace('.py', '.conf')
+    acl_file = os.path.basename(__file__).replace('.py', '.acl')
+    write_config_func(conf_file, port)
+    write_acl(acl_file)
+
+    rc = 1
+    connect_packet_anon = mosq_test.gen_connect("acl-sub")
+    connect_packet_user = mosq_test.gen_connect("acl-sub-user", username="username")
+    connack_packet = mosq_test.gen_connack(rc=0)
+
+    broker = mosq_test.start_broker(filename=os.path.basename(__file__), use_conf=True, port=port)
+
+    try:
+        sock = mosq_test.do_client_connect(connect_packet_anon, connack_packet, port=port)
+        check_subscribe(sock, "sensors/#", True)
+        check_subscribe(sock, "sensors/+/temperature", True)
+        check_subscribe(sock, "sensors", True)
+        check_subscribe(sock, "sensors/secret", False)
+        check_subscribe(sock, "#", False)
+        check_subscribe(sock, "+/temperature", False)
+        check_subscribe(sock, "client/acl-sub/#", True)
+        check_subscribe(sock, "client/other/#", False)
+        check_subscribe(sock, "client/+/#", False)
+        sock.close()
+
+        sock = mosq_test.do_client_connect(connect_packet_user, connack_packet, port=port)
+        check_subscribe(sock, "user/a/data", True)
+        check_subscribe(sock, "user/+/data", True)
+        check_subscribe(sock, "user/#", False)
+        check_subscribe(sock, "sensors/#", False)
+        check_subscribe(sock, "client/acl-sub-user/a", True)
+
+        # Read access is still checked for messages
+        publish_packet = mosq_test.gen_publish("user/a/data", qos=0, payload="message")
+        sock.send(publish_packet)
+        mosq_test.expect_packet(sock, "publish", publish_packet)
+        sock.close()
+        rc = 0
+    except mosq_test.TestError:
+        pass
+    finally:
+        os.remove(conf_file)
+        os.remove(acl_file)
+        broker.terminate()
+        if mosq_test.wait_for_subprocess(broker):
+            print("broker not terminated")
+            if rc == 0: rc=1
+        (stdo, stde) = broker.communicate()
+        if rc:
+            print(stde.decode('utf-8'))
+            exit(rc)
+
+do_test(write_config_default)
+do_test(write_config_plugin)
+exit(0)
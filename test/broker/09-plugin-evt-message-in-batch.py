@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+
+# Check that accepted incoming messages are passed to MOSQ_EVT_MESSAGE_IN_BATCH
+# callbacks in order, and that a plugin can keep hold of them after they have
+# been delivered.
+
+from mosq_test_helper import *
+
+def write_config(filename, port):
+    with open(filename, 'w') as f:
+        f.write("listener %d\n" % (port))
+        f.write("plugin c/plugin_evt_message_in_batch.so\n")
+        f.write("allow_anonymous true\n")
+
+
+def do_test():
+    rc = 1
+    connect_packet_sub = mosq_test.gen_connect("plugin-evt-message-in-batch-sub", proto_ver=5)
+    connect_packet_pub = mosq_test.gen_connect("plugin-evt-message-in-batch-pub", proto_ver=5)
+    connack_packet = mosq_test.gen_connack(rc=0, proto_ver=5)
+
+    mid = 1
+    subscribe_packet = mosq_test.gen_subscribe(mid, "batch/#", 0, proto_ver=5)
+    suback_packet = mosq_test.gen_suback(mid, 0, proto_ver=5)
+
+    publish_packet1 = mosq_test.gen_publish("data/1", qos=0, payload="one", proto_ver=5)
+    publish_packet2 = mosq_test.gen_publish("data/2", qos=1, mid=2, payload="two", proto_ver=5)
+    puback_packet2 = mosq_test.gen_puback(2, proto_ver=5, reason_code=mqtt5_rc.NO_MATCHING_SUBSCRIBERS)
+    publish_packet3 = mosq_test.gen_publish("data/3", qos=2, mid=3, payload="three", proto_ver=5)
+    pubrec_packet3 = mosq_test.gen_pubrec(3, proto_ver=5)
+    pubrel_packet3 = mosq_test.gen_pubrel(3, proto_ver=5)
+    pubcomp_packet3 = mosq_test.gen_pubcomp(3, proto_ver=5)
+    # A resent QoS 2 message is not passed on again
+    publish_packet3_dup = mosq_test.gen_publish("data/3", qos=2, mid=3, payload="three", proto_ver=5, dup=True)
+
+    publish_packet_release = mosq_test.gen_publish("release", qos=0, payload="", proto_ver=5)
+    publish_packet_held = mosq_test.gen_publish("batch/held", qos=0, payload="one,two,three", proto_ver=5)
+    publish_packet_empty = mosq_test.gen_publish("batch/held", qos=0, payload="", proto_ver=5)
+
+    port = mosq_test.get_port()
+    conf_file = os.path.basename(__file__).replace('.py', '.conf')
+    write_config(conf_file, port)
+    broker = mosq_test.start_broker(filename=os.path.basename(__file__), port=port, use_conf=True)
+
+    try:
+        sock_sub = mosq_test.do_client_connect(connect_packet_sub, connack_packet, timeout=20, port=port)
+        mosq_test.do_send_receive(sock_sub, subscribe_packet, suback_packet, "suback")
+        sock_pub = mosq_test.do_client_connect(connect_packet_pub, connack_packet, timeout=20, port=port)
+
+        sock_pub.send(publish_packet1 + publish_packet2 + publish_packet3)
+        mosq_test.expect_packet(sock_pub, "puback2", puback_packet2)
+        mosq_test.expect_packet(sock_pub, "pubrec3", pubrec_packet3)
+        mosq_test.do_send_receive(sock_pub, publish_packet3_dup, pubrec_packet3, "pubrec3 dup")
+        mosq_test.do_send_receive(sock_pub, pubrel_packet3, pubcomp_packet3, "pubcomp3")
+
+        sock_pub.send(publish_packet_release)
+        mosq_test.expect_packet(sock_sub, "held", publish_packet_held)
+
+        sock_pub.send(publish_packet_release)
+        mosq_test.expect_packet(sock_sub, "held empty", publish_packet_empty)
+        mosq_test.do_ping(sock_sub)
+
+        # Held until shutdown
+        sock_pub.send(publish_packet1)
+        mosq_test.do_ping(sock_pub)
+
+        rc = 0
+
+        sock_sub.close()
+        sock_pub.close()
+    except mosq_test.TestError:
+        pass
+    finally:
+        os.remove(conf_file)
+        broker.terminate()
+        if mosq_test.wait_for_subprocess(broker):
+            print("broker not terminated")
+            if rc == 0: rc=1
+        (stdo, stde) = broker.communicate()
+        if rc:
+            print(stde.decode('utf-8'))
+            exit(rc)
+
+
+do_test()
@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+
+# Check that the MOSQ_EVT_MESSAGE_OUT callback of a shared plugin is called
+# once per message, and its result is sent to every subscriber. Later
+# receivers of a retained message get the result of a new call. With
+# per_listener_settings, the callback is called once per listener even when
+# the subscribers on each listener are interleaved.
+
+from mosq_test_helper import *
+
+def write_config(filename, port):
+    with open(filename, 'w') as f:
+        f.write("listener %d\n" % (port))
+        f.write("plugin c/plugin_evt_message_out_shared.so\n")
+        f.write("allow_anonymous true\n")
+
+def write_config_per_listener(filename, port1, port2):
+    with open(filename, 'w') as f:
+        f.write("per_listener_settings true\n")
+        f.write("listener %d\n" % (port1))
+        f.write("plugin c/plugin_evt_message_out_shared.so\n")
+        f.write("allow_anonymous true\n")
+        f.write("listener %d\n" % (port2))
+        f.write("plugin c/plugin_evt_message_out_shared.so\n")
+        f.write("allow_anonymous true\n")
+
+
+def do_test():
+    rc = 1
+    connect_packet1 = mosq_test.gen_connect("plugin-evt-message-out-shared1", proto_ver=5)
+    connect_packet2 = mosq_test.gen_connect("plugin-evt-message-out-shared2", proto_ver=5)
+    connect_packet_pub = mosq_test.gen_connect("plugin-evt-message-out-shared-pub", proto_ver=5)
+    connack_packet = mosq_test.gen_connack(rc=0, proto_ver=5)
+
+    mid = 1
+    subscribe_packet = mosq_test.gen_subscribe(mid, "#", 1, proto_ver=5)
+    suback_packet = mosq_test.gen_suback(mid, 1, proto_ver=5)
+
+    publish_packet_deny = mosq_test.gen_publish("deny", qos=0, payload="message", proto_ver=5)
+    publish_packet_in = mosq_test.gen_publish("topic", qos=0, payload="message", proto_ver=5, retain=True)
+    publish_packet_out = mosq_test.gen_publish("topic", qos=0, payload="shared-1", proto_ver=5)
+    publish_packet_retained = mosq_test.gen_publish("topic", qos=0, payload="shared-3", proto_ver=5, retain=True)
+
+    mid = 1
+    publish_packet_in2 = mosq_test.gen_publish("topic2", qos=1, mid=mid, payload="message", proto_ver=5)
+    puback_packet_in2 = mosq_test.gen_puback(mid, proto_ver=5)
+    publish_packet_out2 = mosq_test.gen_publish("topic2", qos=1, mid=mid, payload="shared-2", proto_ver=5)
+
+    port = mosq_test.get_port()
+    conf_file = os.path.basename(__file__).replace('.py', '.conf')
+    write_config(conf_file, port)
+    broker = mosq_test.start_broker(filename=os.path.basename(__file__), port=port, use_conf=True)
+
+    try:
+        sock1 = mosq_test.do_client_connect(connect_packet1, connack_packet, timeout=20, port=port)
+        mosq_test.do_send_receive(sock1, subscribe_packet, suback_packet, "suback1")
+        sock2 = mosq_test.do_client_connect(connect_packet2, connack_packet, timeout=20, port=port)
+        mosq_test.do_send_receive(sock2, subscribe_packet, suback_packet, "suback2")
+        sock_pub = mosq_test.do_client_connect(connect_packet_pub, connack_packet, timeout=20, port=port)
+
+        # Denied for every subscriber
+        sock_pub.send(publish_packet_deny)
+        mosq_test.do_ping(sock1)
+        mosq_test.do_ping(sock2)
+
+        sock_pub.send(publish_packet_in)
+        mosq_test.expect_packet(sock1, "publish1", publish_packet_out)
+        mosq_test.expect_packet(sock2, "publish2", publish_packet_out)
+
+        mosq_test.do_send_receive(sock_pub, publish_packet_in2, puback_packet_in2, "puback")
+        mosq_test.expect_packet(sock1, "publish1-2", publish_packet_out2)
+        mosq_test.expect_packet(sock2, "publish2-2", publish_packet_out2)
+        sock1.send(mosq_test.gen_puback(mid, proto_ver=5))
+        sock2.send(mosq_test.gen_puback(mid, proto_ver=5))
+        sock2.close()
+
+        # The retained message gets a new result
+        sock3 = mosq_test.do_client_connect(connect_packet2, connack_packet, timeout=20, port=port)
+        mosq_test.do_send_receive(sock3, mosq_test.gen_subscribe(2, "topic", 0, proto_ver=5),
+                mosq_test.gen_suback(2, 0, proto_ver=5), "suback3")
+        mosq_test.expect_packet(sock3, "retained", publish_packet_retained)
+        mosq_test.do_ping(sock3)
+        mosq_test.do_ping(sock1)
+
+        rc = 0
+
+        sock1.close()
+        sock3.close()
+        sock_pub.close()
+    except mosq_test.TestError:
+        pass
+    finally:
+        os.remove(conf_file)
+        broker.terminate()
+        if mosq_test.wait_for_subprocess(broker):
+            print("broker not terminated")
+            if rc == 0: rc=1
+        (stdo, stde) = broker.communicate()
+        if rc:
+            print(stde.decode('utf-8'))
+            exit(rc)
+
+
+def do_test_per_listener():
+    rc = 1
+    connack_packet = mosq_test.gen_connack(rc=0, proto_ver=5)
+    subscribe_packet = mosq_test.gen_subscribe(1, "#", 0, proto_ver=5)
+    suback_packet = mosq_test.gen_suback(1, 0, proto_ver=5)
+
+    (port1, port2) = mosq_test.get_port(2)
+    conf_file = os.path.basename(__file__).replace('.py', '.conf')
+    write_config_per_listener(conf_file, port1, port2)
+    broker = mosq_test.start_broker(filename=os.path.basename(__file__), port=port1, use_conf=True)
+
+    try:
+        socks = []
+        for i in range(4):
+            connect_packet = mosq_test.gen_connect("plugin-evt-message-out-shared-%d" % (i), proto_ver=5)
+            sock = mosq_test.do_client_connect(connect_packet, connack_packet, timeout=20, port=[port1, port2][i%2])
+            mosq_test.do_send_receive(sock, subscribe_packet, suback_packet, "suback%d" % (i))
+            socks.append(sock)
+
+        connect_packet_pub = mosq_test.gen_connect("plugin-evt-message-out-shared-pub", proto_ver=5)
+        sock_pub = mosq_test.do_client_connect(connect_packet_pub, connack_packet, timeout=20, port=port1)
+
+        # Two calls for each message, one per listener
+        for count in [1, 3]:
+            sock_pub.send(mosq_test.gen_publish("topic", qos=0, payload="message", proto_ver=5))
+            payloads = [mosq_test.read_publish(sock, proto_ver=5) for sock in socks]
+            if payloads[0] != payloads[2] or payloads[1] != payloads[3] \
+                    or sorted([payloads[0], payloads[1]]) != ["shared-%d" % (count), "shared-%d" % (count+1)]:
+                raise mosq_test.TestError("unexpected payloads %s" % (payloads))
+
+        for sock in socks:
+            mosq_test.do_ping(sock)
+            sock.close()
+        sock_pub.close()
+        rc = 0
+    except mosq_test.TestError as e:
+        print(e)
+    finally:
+        os.remove(conf_file)
+        broker.terminate()
+        if mosq_test.wait_for_subprocess(broker):
+            print("broker not terminated")
+            if rc == 0: rc=1
+        (stdo, stde) = broker.communicate()
+        if rc:
+            print(stde.decode('utf-8'))
+            exit(rc)
+
+
+do_test()
+do_test_per_listener()
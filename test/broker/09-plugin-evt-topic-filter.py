@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+
+# Check that message in, message out and ACL check callbacks registered with a
+# topic filter are only called for matching topics.
+
+from mosq_test_helper import *
+
+def write_config(filename, port):
+    with open(filename, 'w') as f:
+        f.write("listener %d\n" % (port))
+        f.write("plugin c/plugin_evt_topic_filter.so\n")
+        f.write("allow_anonymous true\n")
+
+
+def do_test():
+    rc = 1
+    connect_packet = mosq_test.gen_connect("plugin-evt-topic-filter", proto_ver=5)
+    connack_packet = mosq_test.gen_connack(rc=0, proto_ver=5)
+
+    mid = 1
+    subscribe_packet = mosq_test.gen_subscribe(mid, "#", 0, proto_ver=5)
+    suback_packet = mosq_test.gen_suback(mid, 0, proto_ver=5)
+
+    mid = 2
+    publish_packet_deny = mosq_test.gen_publish("deny/one", qos=1, mid=mid, payload="message", proto_ver=5)
+    puback_packet_deny = mosq_test.gen_puback(mid, proto_ver=5, reason_code=mqtt5_rc.NOT_AUTHORIZED)
+
+    port = mosq_test.get_port()
+    conf_file = os.path.basename(__file__).replace('.py', '.conf')
+    write_config(conf_file, port)
+    broker = mosq_test.start_broker(filename=os.path.basename(__file__), port=port, use_conf=True)
+
+    try:
+        sock = mosq_test.do_client_connect(connect_packet, connack_packet, timeout=20, port=port)
+
+        mosq_test.do_send_receive(sock, subscribe_packet, suback_packet, "suback")
+
+        for (topic, payload) in [
+                ("in/one/two", "in-modified"),
+                ("out/one", "out-modified"),
+                ("out/one/two", "message"),
+                ("other", "message"),
+                ("denied", "message"),
+                ]:
+
+            sock.send(mosq_test.gen_publish(topic, qos=0, payload="message", proto_ver=5))
+            publish_packet = mosq_test.gen_publish(topic, qos=0, payload=payload, proto_ver=5)
+            mosq_test.expect_packet(sock, topic, publish_packet)
+
+        mosq_test.do_send_receive(sock, publish_packet_deny, puback_packet_deny, "puback deny")
+        mosq_test.do_ping(sock)
+
+        rc = 0
+
+        sock.close()
+    except mosq_test.TestError:
+        pass
+    finally:
+        os.remove(conf_file)
+        broker.terminate()
+        if mosq_test.wait_for_subprocess(broker):
+            print("broker not terminated")
+            if rc == 0: rc=1
+        (stdo, stde) = broker.communicate()
+        if rc:
+            print(stde.decode('utf-8'))
+            exit(rc)
+
+
+do_test()
@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+
+# Check that a plugin can authenticate a client with mosquitto_job_submit()
+# without holding up other clients, and publish from the complete function.
+
+from mosq_test_helper import *
+
+def write_config(filename, port, threads):
+    with open(filename, 'w') as f:
+        f.write("listener %d\n" % (port))
+        f.write("plugin c/plugin_job.so\n")
+        f.write("allow_anonymous false\n")
+        f.write("plugin_worker_threads %d\n" % (threads))
+
+
+def do_test(threads):
+    rc = 1
+    connect_packet_fast = mosq_test.gen_connect("fast-client", username="fast")
+    connack_packet_fast = mosq_test.gen_connack(rc=0)
+
+    connect_packet_good = mosq_test.gen_connect("slow-client", username="slow", password="good")
+    connack_packet_good = mosq_test.gen_connack(rc=0)
+    connect_packet_bad = mosq_test.gen_connect("slow-client-bad", username="slow", password="bad")
+    connack_packet_bad = mosq_test.gen_connack(rc=5)
+
+    mid = 1
+    subscribe_packet = mosq_test.gen_subscribe(mid, "job/#", 0)
+    suback_packet = mosq_test.gen_suback(mid, 0)
+
+    publish_packet = mosq_test.gen_publish("job/complete", qos=0, payload="slow-client")
+
+    port = mosq_test.get_port()
+    conf_file = os.path.basename(__file__).replace('.py', '.conf')
+    write_config(conf_file, port, threads)
+    broker = mosq_test.start_broker(filename=os.path.basename(__file__), port=port, use_conf=True)
+
+    try:
+        sock_fast = mosq_test.do_client_connect(connect_packet_fast, connack_packet_fast, timeout=20, port=port)
+        mosq_test.do_send_receive(sock_fast, subscribe_packet, suback_packet, "suback")
+
+        sock_good = mosq_test.client_connect_only(port=port, timeout=20)
+        sock_good.send(connect_packet_good)
+
+        if threads > 0:
+            # The broker is not blocked while the job runs
+            start = time.time()
+            mosq_test.do_ping(sock_fast)
+            if time.time() - start > 0.5:
+                raise mosq_test.TestError("ping delayed by job")
+
+        mosq_test.expect_packet(sock_good, "connack good", connack_packet_good)
+        mosq_test.expect_packet(sock_fast, "publish", publish_packet)
+
+        sock_bad = mosq_test.do_client_connect(connect_packet_bad, connack_packet_bad, timeout=20, port=port)
+        sock_bad.close()
+
+        mosq_test.do_ping(sock_good)
+        rc = 0
+
+        sock_good.close()
+        sock_fast.close()
+    except mosq_test.TestError as e:
+        print(e)
+    finally:
+        os.remove(conf_file)
+        broker.terminate()
+        if mosq_test.wait_for_subprocess(broker):
+            print("broker not terminated")
+            if rc == 0: rc=1
+        (stdo, stde) = broker.communicate()
+        if rc:
+            print(stde.decode('utf-8'))
+            exit(rc)
+
+
+do_test(2)
+do_test(0)
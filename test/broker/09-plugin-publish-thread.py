@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+
+# Check that messages published with mosquitto_broker_publish() from threads
+# started by a plugin are all delivered, in order for each thread, without
+# waiting for the broker to wake up for some other reason.
+
+from mosq_test_helper import *
+
+MESSAGE_COUNT = 200
+
+def write_config(filename, port):
+    with open(filename, 'w') as f:
+        f.write("listener %d\n" % (port))
+        f.write("plugin c/plugin_publish_thread.so\n")
+        f.write("allow_anonymous true\n")
+
+
+def do_test():
+    rc = 1
+    connect_packet = mosq_test.gen_connect("plugin-publish-thread")
+    connack_packet = mosq_test.gen_connack(rc=0)
+
+    mid = 1
+    subscribe_packet = mosq_test.gen_subscribe(mid, "thread/out", 0)
+    suback_packet = mosq_test.gen_suback(mid, 0)
+
+    publish_packet_start = mosq_test.gen_publish("thread/start", qos=0, payload=str(MESSAGE_COUNT))
+
+    port = mosq_test.get_port()
+    conf_file = os.path.basename(__file__).replace('.py', '.conf')
+    write_config(conf_file, port)
+    broker = mosq_test.start_broker(filename=os.path.basename(__file__), port=port, use_conf=True)
+
+    try:
+        sock = mosq_test.do_client_connect(connect_packet, connack_packet, timeout=5, port=port)
+        mosq_test.do_send_receive(sock, subscribe_packet, suback_packet, "suback")
+
+        sock.send(publish_packet_start)
+
+        expected = {"a": 0, "b": 0}
+        for i in range(2*MESSAGE_COUNT):
+            name, index = mosq_test.read_publish(sock).split(":")
+            if int(index) != expected[name]:
+                raise mosq_test.TestError(f"thread {name}: got {index}, expected {expected[name]}")
+            expected[name] += 1
+
+        mosq_test.do_ping(sock)
+        rc = 0
+
+        sock.close()
+    except mosq_test.TestError as e:
+        print(e)
+    finally:
+        os.remove(conf_file)
+        broker.terminate()
+        if mosq_test.wait_for_subprocess(broker):
+            print("broker not terminated")
+            if rc == 0: rc=1
+        (stdo, stde) = broker.communicate()
+        if rc:
+            print(stde.decode('utf-8'))
+            exit(rc)
+
+
+do_test()
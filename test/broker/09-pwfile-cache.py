@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+
+# Test whether the verified password cache accepts a repeated good password,
+# still rejects bad passwords, and stops accepting an old password once the
+# password has been changed and the broker reloaded.
+
+from mosq_test_helper import *
+import signal
+
+PASSWORD_HASH = "$7$1000$2WHtreODvxCPn++l7GrbFqQU5qSoXCrj5jbIbAHVeTq1YiA8x2XQiW9g3iwyZz09yv9gAZ0/SHmwT7yBkI0eIw==$KvOPxpK2uF+oprZ742Us2+bPy7g0VP+VKAHnkfZxfWcvrZzjiiyB+jF5f6RiNQs8UQs9GDqoXSZL2OeAwg3Klg=="
+NEW_PASSWORD_HASH = "$7$1000$2BEEwX/vniCirT6z9OVeSMLNp87Mp9QtuDHVAEFnXJpAUBIzrBfThc5iKg+t6welPk4y7W0bfcQ7fpDLAsWjQg==$qSP+A1c4Z98fRnvBWAeweg16m4B/v0uMQfSDluG6UwjEE8plYvKyrKHhHwl9sScl4m2Gte1sOQPxoLVkDgYnbg=="
+
+def write_config_default(filename, port):
+    with open(filename, 'w') as f:
+        f.write("listener %d\n" % (port))
+        f.write("password_file %d.password\n" % (port))
+        f.write("password_cache_size 10\n")
+
+def write_config_plugin(filename, port):
+    with open(filename, 'w') as f:
+        f.write("listener %d\n" % (port))
+        f.write(f"plugin {mosq_test.get_build_root()}/plugins/password-file/mosquitto_password_file.so\n")
+        f.write("plugin_opt_password_file %d.password\n" % (port))
+        f.write("password_cache_size 10\n")
+
+def do_connect(port, password, connack_packet):
+    connect_packet = mosq_test.gen_connect("cache-test", username="verify-user", password=password)
+    sock = mosq_test.do_client_connect(connect_packet, connack_packet, port=port, timeout=20)
+    sock.close()
+
+def do_test(write_config_func):
+    port = mosq_test.get_port()
+    conf_file = os.path.basename(__file__).replace('.py', '.conf')
+    write_config_func(conf_file, port)
+
+    with open("%d.password" % (port), "wt") as f:
+        f.write("verify-user:%s\n" % (PASSWORD_HASH))
+
+    rc = 1
+    connack_success = mosq_test.gen_connack(rc=0)
+    connack_denied = mosq_test.gen_connack(rc=5)
+
+    broker = mosq_test.start_broker(filename=os.path.basename(__file__), use_conf=True, port=port)
+
+    try:
+        do_connect(port, "verify-password", connack_success)
+        do_connect(port, "verify-password", connack_success)
+        do_connect(port, "wrong-password", connack_denied)
+        do_connect(port, "verify-password", connack_success)
+
+        with open("%d.password" % (port), "wt") as f:
+            f.write("verify-user:%s\n" % (NEW_PASSWORD_HASH))
+        broker.send_signal(signal.SIGHUP)
+        time.sleep(0.5)
+
+        do_connect(port, "verify-password", connack_denied)
+        do_connect(port, "new-password", connack_success)
+        do_connect(port, "new-password", connack_success)
+        rc = 0
+    except mosq_test.TestError:
+        pass
+    finally:
+        os.remove(conf_file)
+        os.remove("%d.password" % (port))
+        broker.terminate()
+        if mosq_test.wait_for_subprocess(broker):
+            print("broker not terminated")
+            if rc == 0: rc=1
+        (stdo, stde) = broker.communicate()
+        if rc:
+            print(stde.decode('utf-8'))
+            exit(rc)
+
+do_test(write_config_default)
+do_test(write_config_plugin)
+exit(0)
@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+
+# Test whether password checks carried out on the password verifier threads
+# give the right result to each of many clients connecting at once, including
+# clients that disconnect before their check has finished.
+
+from mosq_test_helper import *
+
+PASSWORD_HASH = "$7$1000$2WHtreODvxCPn++l7GrbFqQU5qSoXCrj5jbIbAHVeTq1YiA8x2XQiW9g3iwyZz09yv9gAZ0/SHmwT7yBkI0eIw==$KvOPxpK2uF+oprZ742Us2+bPy7g0VP+VKAHnkfZxfWcvrZzjiiyB+jF5f6RiNQs8UQs9GDqoXSZL2OeAwg3Klg=="
+
+def write_config_default(filename, port):
+    with open(filename, 'w') as f:
+        f.write("listener %d\n" % (port))
+        f.write("password_file %d.password\n" % (port))
+        f.write("password_verify_threads 2\n")
+
+def write_config_plugin(filename, port):
+    with open(filename, 'w') as f:
+        f.write("listener %d\n" % (port))
+        f.write(f"plugin {mosq_test.get_build_root()}/plugins/password-file/mosquitto_password_file.so\n")
+        f.write("plugin_opt_password_file %d.password\n" % (port))
+        f.write("password_verify_threads 2\n")
+
+def do_test(write_config_func):
+    port = mosq_test.get_port()
+    conf_file = os.path.basename(__file__).replace('.py', '.conf')
+    write_config_func(conf_file, port)
+
+    with open("%d.password" % (port), "wt") as f:
+        f.write("verify-user:%s\n" % (PASSWORD_HASH))
+
+    rc = 1
+    connack_success = mosq_test.gen_connack(rc=0)
+    connack_denied = mosq_test.gen_connack(rc=5)
+
+    broker = mosq_test.start_broker(filename=os.path.basename(__file__), use_conf=True, port=port)
+
+    try:
+        socks = []
+        for i in range(20):
+            password = "verify-password" if i % 2 == 0 else "wrong-password"
+            connect_packet = mosq_test.gen_connect("verify-%d" % (i), username="verify-user", password=password)
+            sock = mosq_test.client_connect_only(port=port, timeout=20)
+            sock.send(connect_packet)
+            socks.append(sock)
+
+            # This client goes away before its check can have finished
+            connect_packet = mosq_test.gen_connect("verify-gone-%d" % (i), username="verify-user", password="verify-password")
+            sock = mosq_test.client_connect_only(port=port, timeout=20)
+            sock.send(connect_packet)
+            sock.close()
+
+        for i in range(20):
+            if i % 2 == 0:
+                mosq_test.expect_packet(socks[i], "connack %d" % (i), connack_success)
+                mosq_test.do_ping(socks[i])
+            else:
+                mosq_test.expect_packet(socks[i], "connack %d" % (i), connack_denied)
+            socks[i].close()
+
+        # Reusing a client id whose earlier check was abandoned
+        connect_packet = mosq_test.gen_connect("verify-gone-0", username="verify-user", password="verify-password")
+        sock = mosq_test.do_client_connect(connect_packet, connack_success, port=port, timeout=20)
+        mosq_test.do_ping(sock)
+        sock.close()
+        rc = 0
+    except mosq_test.TestError:
+        pass
+    finally:
+        os.remove(conf_file)
+        os.remove("%d.password" % (port))
+        broker.terminate()
+        if mosq_test.wait_for_subprocess(broker):
+            print("broker not terminated")
+            if rc == 0: rc=1
+        (stdo, stde) = broker.communicate()
+        if rc:
+            print(stde.decode('utf-8'))
+            exit(rc)
+
+do_test(write_config_default)
+do_test(write_config_plugin)
+exit(0)
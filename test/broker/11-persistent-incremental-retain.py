@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+
+# Test whether retained messages set, replaced and cleared are restored from
+# the retain log written with persistence_incremental_retain, and whether they
+# move back to the main file when the option is turned off.
+
+from mosq_test_helper import *
+
+def write_config(filename, port, incremental):
+    with open(filename, 'w') as f:
+        f.write("listener %d\n" % (port))
+        f.write("allow_anonymous true\n")
+        f.write("persistence true\n")
+        f.write("persistence_file mosquitto-%d.db\n" % (port))
+        f.write("persistence_incremental_retain %s\n" % ("true" if incremental else "false"))
+
+def restart_broker(broker, port):
+    broker.terminate()
+    if mosq_test.wait_for_subprocess(broker):
+        raise mosq_test.TestError("broker not terminated")
+    broker.communicate()
+    return mosq_test.start_broker(filename=os.path.basename(__file__), use_conf=True, port=port)
+
+def publish(port, topic, payload):
+    connect_packet = mosq_test.gen_connect("retain-log-pub", proto_ver=4)
+    connack_packet = mosq_test.gen_connack(rc=0, proto_ver=4)
+    publish_packet = mosq_test.gen_publish(topic, qos=1, mid=1, payload=payload, retain=True, proto_ver=4)
+    puback_packet = mosq_test.gen_puback(1, proto_ver=4)
+
+    sock = mosq_test.do_client_connect(connect_packet, connack_packet, timeout=20, port=port)
+    mosq_test.do_send_receive(sock, publish_packet, puback_packet, "puback")
+    sock.close()
+
+# Retained messages are sent in no particular order
+def check_retained(port, expected):
+    connect_packet = mosq_test.gen_connect("retain-log-sub", proto_ver=4)
+    connack_packet = mosq_test.gen_connack(rc=0, proto_ver=4)
+    sock = mosq_test.do_client_connect(connect_packet, connack_packet, timeout=20, port=port)
+
+    for (mid, sub) in [(1, "#"), (2, "$test/#")]:
+        subscribe_packet = mosq_test.gen_subscribe(mid, sub, 0, proto_ver=4)
+        suback_packet = mosq_test.gen_suback(mid, 0, proto_ver=4)
+        mosq_test.do_send_receive(sock, subscribe_packet, suback_packet, "suback")
+
+        packets = []
+        for (topic, payload) in expected:
+            if topic.startswith("$") == sub.startswith("$"):
+                packets.append(mosq_test.gen_publish(topic, qos=0, payload=payload, retain=True, proto_ver=4))
+        recvd = b''
+        while len(recvd) < sum(len(p) for p in packets):
+            r = sock.recv(1)
+            if len(r) == 0:
+                raise mosq_test.TestError("retained")
+            recvd += r
+        for p in packets:
+            if p not in recvd:
+                raise mosq_test.TestError("missing retained message %s" % (p))
+        mosq_test.do_ping(sock)
+    sock.close()
+
+port = mosq_test.get_port()
+conf_file = os.path.basename(__file__).replace('.py', '.conf')
+db_file = 'mosquitto-%d.db' % (port)
+log_file = db_file + '.retain'
+write_config(conf_file, port, True)
+
+rc = 1
+for f in [db_file, log_file]:
+    if os.path.exists(f):
+        os.unlink(f)
+
+broker = mosq_test.start_broker(filename=os.path.basename(__file__), use_conf=True, port=port)
+
+try:
+    publish(port, "retain/one", "one")
+    publish(port, "retain/two", "two")
+    publish(port, "single", "single")
+    publish(port, "$test/dollar", "dollar")
+
+    broker = restart_broker(broker, port)
+    if not os.path.exists(log_file):
+        raise mosq_test.TestError("retain log not written")
+    check_retained(port, [("retain/one", "one"), ("retain/two", "two"),
+            ("single", "single"), ("$test/dollar", "dollar")])
+
+    # Replace and clear retained messages that are already in the log
+    publish(port, "retain/one", "one-replaced")
+    publish(port, "single", "")
+    publish(port, "$test/dollar", "")
+
+    broker = restart_broker(broker, port)
+    check_retained(port, [("retain/one", "one-replaced"), ("retain/two", "two")])
+
+    # Turning the option off moves the retained messages to the main file
+    write_config(conf_file, port, False)
+    broker = restart_broker(broker, port)
+    broker = restart_broker(broker, port)
+    if os.path.exists(log_file):
+        raise mosq_test.TestError("retain log not removed")
+    check_retained(port, [("retain/one", "one-replaced"), ("retain/two", "two")])
+    rc = 0
+except mosq_test.TestError as e:
+    print(e)
+finally:
+    os.remove(conf_file)
+    broker.terminate()
+    if mosq_test.wait_for_subprocess(broker):
+        print("broker not terminated")
+        if rc == 0: rc=1
+    (stdo, stde) = broker.communicate()
+    for f in [db_file, log_file]:
+        if os.path.exists(f):
+            os.unlink(f)
+    if rc:
+        print(stde.decode('utf-8'))
+
+exit(rc)
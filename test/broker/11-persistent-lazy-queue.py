@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+
+# Test whether queued messages for an offline client are delivered in order
+# when persistence_lazy_queues leaves them on disk across restarts, including
+# messages queued after the restart.
+
+from mosq_test_helper import *
+
+def write_config(filename, port):
+    with open(filename, 'w') as f:
+        f.write("listener %d\n" % (port))
+        f.write("allow_anonymous true\n")
+        f.write("persistence true\n")
+        f.write("persistence_file mosquitto-%d.db\n" % (port))
+        f.write("persistence_lazy_queues true\n")
+
+def restart_broker(broker, port):
+    broker.terminate()
+    if mosq_test.wait_for_subprocess(broker):
+        raise mosq_test.TestError("broker not terminated")
+    broker.communicate()
+    return mosq_test.start_broker(filename=os.path.basename(__file__), use_conf=True, port=port)
+
+def do_test(proto_ver):
+    port = mosq_test.get_port()
+    conf_file = os.path.basename(__file__).replace('.py', '.conf')
+    write_config(conf_file, port)
+
+    rc = 1
+    connect_packet = mosq_test.gen_connect(
+        "lazy-queue-test", clean_session=False, proto_ver=proto_ver, session_expiry=60
+    )
+    connack_packet = mosq_test.gen_connack(rc=0, proto_ver=proto_ver)
+    connack_packet2 = mosq_test.gen_connack(rc=0, flags=1, proto_ver=proto_ver)
+
+    subscribe_packet = mosq_test.gen_subscribe(1, "lazy/queue", 1, proto_ver=proto_ver)
+    suback_packet = mosq_test.gen_suback(1, 1, proto_ver=proto_ver)
+
+    pub_connect_packet = mosq_test.gen_connect("lazy-queue-pub", proto_ver=proto_ver)
+
+    if os.path.exists('mosquitto-%d.db' % (port)):
+        os.unlink('mosquitto-%d.db' % (port))
+
+    broker = mosq_test.start_broker(filename=os.path.basename(__file__), use_conf=True, port=port)
+
+    try:
+        sock = mosq_test.do_client_connect(connect_packet, connack_packet, timeout=20, port=port)
+        mosq_test.do_send_receive(sock, subscribe_packet, suback_packet, "suback")
+        sock.close()
+
+        pub_sock = mosq_test.do_client_connect(pub_connect_packet, connack_packet, timeout=20, port=port)
+        for i in range(1, 4):
+            publish_packet = mosq_test.gen_publish("lazy/queue", qos=1, mid=i, payload="message%d" % (i), proto_ver=proto_ver)
+            puback_packet = mosq_test.gen_puback(i, proto_ver=proto_ver)
+            mosq_test.do_send_receive(pub_sock, publish_packet, puback_packet, "puback%d" % (i))
+        pub_sock.close()
+
+        broker = restart_broker(broker, port)
+
+        # Queued behind the messages still on disk
+        pub_sock = mosq_test.do_client_connect(pub_connect_packet, connack_packet, timeout=20, port=port)
+        publish_packet = mosq_test.gen_publish("lazy/queue", qos=1, mid=4, payload="message4", proto_ver=proto_ver)
+        puback_packet = mosq_test.gen_puback(4, proto_ver=proto_ver)
+        mosq_test.do_send_receive(pub_sock, publish_packet, puback_packet, "puback4")
+        pub_sock.close()
+
+        # The unloaded queue must survive being saved again
+        broker = restart_broker(broker, port)
+
+        sock = mosq_test.do_client_connect(connect_packet, connack_packet2, timeout=20, port=port)
+        for i in range(1, 5):
+            publish_packet = mosq_test.gen_publish("lazy/queue", qos=1, mid=i, payload="message%d" % (i), proto_ver=proto_ver)
+            puback_packet = mosq_test.gen_puback(i, proto_ver=proto_ver)
+            mosq_test.expect_packet(sock, "publish%d" % (i), publish_packet)
+            sock.send(puback_packet)
+        mosq_test.do_ping(sock)
+        rc = 0
+
+        sock.close()
+    except mosq_test.TestError:
+        pass
+    finally:
+        os.remove(conf_file)
+        broker.terminate()
+        if mosq_test.wait_for_subprocess(broker):
+            print("broker not terminated")
+            if rc == 0: rc=1
+        (stdo, stde) = broker.communicate()
+        if os.path.exists('mosquitto-%d.db' % (port)):
+            os.unlink('mosquitto-%d.db' % (port))
+        if rc:
+            print(stde.decode('utf-8'))
+            print("proto_ver=%d" % (proto_ver))
+            exit(rc)
+
+
+do_test(proto_ver=4)
+do_test(proto_ver=5)
+exit(0)
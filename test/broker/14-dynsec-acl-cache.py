@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+
+# Check that cached publish ACL decisions are discarded when roles, role ACLs
+# or client role assignments change. Clients affected by a change are kicked
+# by the plugin, so the client reconnects after each change. Changes to the
+# default access do not kick clients, so are checked on the same connection.
+
+from mosq_test_helper import *
+from dynsec_helper import *
+import json
+import shutil
+
+def write_config(filename, port):
+    with open(filename, 'w') as f:
+        f.write("listener %d\n" % (port))
+        f.write("allow_anonymous false\n")
+        f.write(f"plugin {mosq_test.get_build_root()}/plugins/dynamic-security/mosquitto_dynamic_security.so\n")
+        f.write("plugin_opt_config_file %d/dynamic-security.json\n" % (port))
+
+
+def simple_command(command, correlation_data, **kwargs):
+    cmd = {"command": command, "correlationData": correlation_data}
+    cmd.update(kwargs)
+    return ({"commands": [cmd]}, {"responses": [{"command": command, "correlationData": correlation_data}]})
+
+
+port = mosq_test.get_port()
+conf_file = os.path.basename(__file__).replace('.py', '.conf')
+write_config(conf_file, port)
+
+create_role = simple_command("createRole", "1", rolename="cache-role")
+add_send_acl = simple_command("addRoleACL", "2", rolename="cache-role", acltype="publishClientSend", topic="topic/#", allow=True)
+add_sub_acl = simple_command("addRoleACL", "3", rolename="cache-role", acltype="subscribePattern", topic="topic/#", allow=True)
+create_client = simple_command("createClient", "4", username="user_one", password="password", clientid="cid")
+add_client_role = simple_command("addClientRole", "5", username="user_one", rolename="cache-role")
+deny_recv_acl = simple_command("addRoleACL", "6", rolename="cache-role", acltype="publishClientReceive", topic="topic/#", allow=False)
+remove_recv_acl = simple_command("removeRoleACL", "7", rolename="cache-role", acltype="publishClientReceive", topic="topic/#")
+deny_recv_default = simple_command("setDefaultACLAccess", "10", acls=[{"acltype": "publishClientReceive", "allow": False}])
+allow_recv_default = simple_command("setDefaultACLAccess", "11", acls=[{"acltype": "publishClientReceive", "allow": True}])
+remove_client_role = simple_command("removeClientRole", "8", username="user_one", rolename="cache-role")
+add_client_role2 = simple_command("addClientRole", "9", username="user_one", rolename="cache-role")
+
+rc = 1
+connect_packet_admin = mosq_test.gen_connect("ctrl-test", username="admin", password="admin")
+connack_packet_admin = mosq_test.gen_connack(rc=0)
+
+mid = 2
+subscribe_packet_admin = mosq_test.gen_subscribe(mid, "$CONTROL/dynamic-security/#", 1)
+suback_packet_admin = mosq_test.gen_suback(mid, 1)
+
+connect_packet = mosq_test.gen_connect("cid", username="user_one", password="password", proto_ver=5)
+connack_packet = mosq_test.gen_connack(rc=0, proto_ver=5)
+
+mid = 3
+subscribe_packet = mosq_test.gen_subscribe(mid, "topic/#", 0, proto_ver=5)
+suback_packet = mosq_test.gen_suback(mid, 0, proto_ver=5)
+
+mid = 4
+publish_packet = mosq_test.gen_publish(topic="topic/a", mid=mid, qos=1, payload="message", proto_ver=5)
+puback_packet_fail = mosq_test.gen_puback(mid, proto_ver=5, reason_code=mqtt5_rc.NOT_AUTHORIZED)
+puback_packet_success = mosq_test.gen_puback(mid, proto_ver=5)
+
+publish_packet_recv = mosq_test.gen_publish(topic="topic/a", qos=0, payload="message", proto_ver=5)
+
+def client_connect(csock, port):
+    if csock is not None:
+        csock.close()
+    csock = mosq_test.do_client_connect(connect_packet, connack_packet, timeout=5, port=port)
+    mosq_test.do_send_receive(csock, subscribe_packet, suback_packet, "suback")
+    return csock
+
+try:
+    os.mkdir(str(port))
+    shutil.copyfile(str(Path(__file__).resolve().parent / "dynamic-security-init.json"), "%d/dynamic-security.json" % (port))
+except FileExistsError:
+    pass
+
+broker = mosq_test.start_broker(filename=os.path.basename(__file__), use_conf=True, port=port)
+
+try:
+    sock = mosq_test.do_client_connect(connect_packet_admin, connack_packet_admin, timeout=5, port=port)
+    mosq_test.do_send_receive(sock, subscribe_packet_admin, suback_packet_admin, "admin suback")
+
+    for cmd in [create_role, add_send_acl, add_sub_acl, create_client, add_client_role]:
+        command_check(sock, cmd[0], cmd[1])
+
+    csock = client_connect(None, port)
+
+    # Allowed to send, and receive falls through to the default of allow.
+    # Publish twice so the second check comes from the cache.
+    for i in range(2):
+        csock.send(publish_packet)
+        mosq_test.receive_unordered(csock, puback_packet_success, publish_packet_recv, "puback success / publish recv %d" % (i))
+
+    # Default receive access changed, without the client being kicked
+    command_check(sock, deny_recv_default[0], deny_recv_default[1])
+    for i in range(2):
+        mosq_test.do_send_receive(csock, publish_packet, puback_packet_success, "puback success, default deny %d" % (i))
+    mosq_test.do_ping(csock)
+    command_check(sock, allow_recv_default[0], allow_recv_default[1])
+    csock.send(publish_packet)
+    mosq_test.receive_unordered(csock, puback_packet_success, publish_packet_recv, "puback success / publish recv default allow")
+
+    # Receive now explicitly denied
+    command_check(sock, deny_recv_acl[0], deny_recv_acl[1])
+    csock = client_connect(csock, port)
+    for i in range(2):
+        mosq_test.do_send_receive(csock, publish_packet, puback_packet_success, "puback success, no recv %d" % (i))
+    mosq_test.do_ping(csock)
+
+    # Receive deny removed again
+    command_check(sock, remove_recv_acl[0], remove_recv_acl[1])
+    csock = client_connect(csock, port)
+    csock.send(publish_packet)
+    mosq_test.receive_unordered(csock, puback_packet_success, publish_packet_recv, "puback success / publish recv after remove")
+
+    # Client no longer has the role, so sending is denied
+    command_check(sock, remove_client_role[0], remove_client_role[1])
+    csock.close()
+    csock = mosq_test.do_client_connect(connect_packet, connack_packet, timeout=5, port=port)
+    for i in range(2):
+        mosq_test.do_send_receive(csock, publish_packet, puback_packet_fail, "puback fail %d" % (i))
+
+    # Role restored
+    command_check(sock, add_client_role2[0], add_client_role2[1])
+    csock = client_connect(csock, port)
+    csock.send(publish_packet)
+    mosq_test.receive_unordered(csock, puback_packet_success, publish_packet_recv, "puback success / publish recv after restore")
+
+    csock.close()
+    rc = 0
+
+    sock.close()
+except mosq_test.TestError:
+    pass
+finally:
+    os.remove(conf_file)
+    try:
+        os.remove(f"{port}/dynamic-security.json")
+    except FileNotFoundError:
+        pass
+    os.rmdir(f"{port}")
+    broker.terminate()
+    if mosq_test.wait_for_subprocess(broker):
+        print("broker not terminated")
+        if rc == 0: rc=1
+    (stdo, stde) = broker.communicate()
+    if rc:
+        print(stde.decode('utf-8'))
+
+
+exit(rc)
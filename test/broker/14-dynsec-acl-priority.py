@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+
+# Test publish ACL priority with overlapping wildcard, pattern and literal
+# ACLs in a role that also holds a large number of unrelated ACLs, and that
+# the result follows the role ACLs as they are removed and replaced.
+
+from mosq_test_helper import *
+from dynsec_helper import *
+import json
+import shutil
+
+def write_config(filename, port):
+    with open(filename, 'w') as f:
+        f.write("listener %d\n" % (port))
+        f.write("allow_anonymous false\n")
+        f.write(f"plugin {mosq_test.get_build_root()}/plugins/dynamic-security/mosquitto_dynamic_security.so\n")
+        f.write("plugin_opt_config_file %d/dynamic-security.json\n" % (port))
+
+
+def acl_command(command, **kwargs):
+    cmd = {"command": command, "rolename": "prio-role"}
+    cmd.update(kwargs)
+    return cmd
+
+
+def batch(commands):
+    return ({"commands": commands}, {"responses": [{"command": c["command"]} for c in commands]})
+
+
+port = mosq_test.get_port()
+conf_file = os.path.basename(__file__).replace('.py', '.conf')
+write_config(conf_file, port)
+
+setup_commands = [
+    {"command": "createRole", "rolename": "prio-role"},
+    {"command": "createClient", "username": "user_one", "password": "password", "clientid": "cid"},
+    {"command": "addClientRole", "username": "user_one", "rolename": "prio-role"},
+]
+for i in range(300):
+    setup_commands.append(acl_command("addRoleACL", acltype="publishClientSend", topic="filler/%d/+/#" % (i), allow=(i % 2 == 0), priority=i % 7))
+setup_commands += [
+    acl_command("addRoleACL", acltype="publishClientSend", topic="prio/#", allow=True),
+    acl_command("addRoleACL", acltype="publishClientSend", topic="prio/deny/#", allow=False, priority=1),
+    acl_command("addRoleACL", acltype="publishClientSend", topic="prio/+/secret", allow=False, priority=5),
+    acl_command("addRoleACL", acltype="publishClientSend", topic="prio/%c/secret", allow=True, priority=10),
+    acl_command("addRoleACL", acltype="publishClientSend", topic="prio/%u/+", allow=False, priority=3),
+]
+setup = batch(setup_commands)
+remove_pattern = batch([acl_command("removeRoleACL", acltype="publishClientSend", topic="prio/%c/secret")])
+modify_role = batch([acl_command("modifyRole", acls=[
+    {"acltype": "publishClientSend", "topic": "prio/+/secret", "allow": True, "priority": 2},
+    {"acltype": "publishClientSend", "topic": "prio/#", "allow": False, "priority": 1},
+    ])])
+
+rc = 1
+connect_packet_admin = mosq_test.gen_connect("ctrl-test", username="admin", password="admin")
+connack_packet_admin = mosq_test.gen_connack(rc=0)
+
+mid = 2
+subscribe_packet_admin = mosq_test.gen_subscribe(mid, "$CONTROL/dynamic-security/#", 1)
+suback_packet_admin = mosq_test.gen_suback(mid, 1)
+
+connect_packet = mosq_test.gen_connect("cid", username="user_one", password="password", proto_ver=5)
+connack_packet = mosq_test.gen_connack(rc=0, proto_ver=5)
+
+
+def check_publish(csock, topic, allowed):
+    mid = 10
+    publish_packet = mosq_test.gen_publish(topic=topic, mid=mid, qos=1, payload="message", proto_ver=5)
+    if allowed:
+        puback_packet = mosq_test.gen_puback(mid, proto_ver=5, reason_code=mqtt5_rc.NO_MATCHING_SUBSCRIBERS)
+    else:
+        puback_packet = mosq_test.gen_puback(mid, proto_ver=5, reason_code=mqtt5_rc.NOT_AUTHORIZED)
+    mosq_test.do_send_receive(csock, publish_packet, puback_packet, "puback %s %s" % (topic, allowed))
+
+
+def client_connect(csock, port):
+    if csock is not None:
+        csock.close()
+    return mosq_test.do_client_connect(connect_packet, connack_packet, timeout=5, port=port)
+
+try:
+    os.mkdir(str(port))
+    shutil.copyfile(str(Path(__file__).resolve().parent / "dynamic-security-init.json"), "%d/dynamic-security.json" % (port))
+except FileExistsError:
+    pass
+
+broker = mosq_test.start_broker(filename=os.path.basename(__file__), use_conf=True, port=port)
+
+try:
+    sock = mosq_test.do_client_connect(connect_packet_admin, connack_packet_admin, timeout=5, port=port)
+    mosq_test.do_send_receive(sock, subscribe_packet_admin, suback_packet_admin, "admin suback")
+
+    command_check(sock, setup[0], setup[1])
+
+    csock = client_connect(None, port)
+    check_publish(csock, "prio/topic", True)
+    check_publish(csock, "prio/topic/other", True)
+    check_publish(csock, "prio/deny", False)
+    check_publish(csock, "prio/deny/topic", False)
+    check_publish(csock, "prio/topic/secret", False)
+    check_publish(csock, "prio/cid/secret", True)
+    check_publish(csock, "prio/user_one/topic", False)
+    check_publish(csock, "prio/user_one/secret", False)
+    check_publish(csock, "prio/user_one/topic/other", True)
+    check_publish(csock, "filler/10/a", True)
+    check_publish(csock, "filler/11/a/b", False)
+    check_publish(csock, "filler/12", False)
+    check_publish(csock, "other/topic", False)
+    check_publish(csock, "$SYS/prio", False)
+
+    command_check(sock, remove_pattern[0], remove_pattern[1])
+    csock = client_connect(csock, port)
+    check_publish(csock, "prio/cid/secret", False)
+    check_publish(csock, "prio/topic", True)
+
+    command_check(sock, modify_role[0], modify_role[1])
+    csock = client_connect(csock, port)
+    check_publish(csock, "prio/cid/secret", True)
+    check_publish(csock, "prio/topic", False)
+    check_publish(csock, "filler/10/a", False)
+
+    csock.close()
+    rc = 0
+
+    sock.close()
+except mosq_test.TestError:
+    pass
+finally:
+    os.remove(conf_file)
+    try:
+        os.remove(f"{port}/dynamic-security.json")
+    except FileNotFoundError:
+        pass
+    os.rmdir(f"{port}")
+    broker.terminate()
+    if mosq_test.wait_for_subprocess(broker):
+        print("broker not terminated")
+        if rc == 0: rc=1
+    (stdo, stde) = broker.communicate()
+    if rc:
+        print(stde.decode('utf-8'))
+
+
+exit(rc)
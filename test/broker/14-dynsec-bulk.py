@@ -0,0 +1,218 @@
+#!/usr/bin/env python3
+
+# Check the createClients, addGroupClients and setClientRolesBulk commands,
+# including that a batch with an invalid item changes nothing.
+
+from mosq_test_helper import *
+from dynsec_helper import *
+import json
+import shutil
+
+def write_config(filename, port):
+    with open(filename, 'w') as f:
+        f.write("listener %d\n" % (port))
+        f.write("allow_anonymous false\n")
+        f.write(f"plugin {mosq_test.get_build_root()}/plugins/dynamic-security/mosquitto_dynamic_security.so\n")
+        f.write("plugin_opt_config_file %d/dynamic-security.json\n" % (port))
+
+
+def command(name, **kwargs):
+    cmd = {"command": name}
+    cmd.update(kwargs)
+    return cmd
+
+
+def send_commands(sock, commands):
+    payload = json.dumps({"commands": commands})
+    sock.send(mosq_test.gen_publish(topic="$CONTROL/dynamic-security/v1", qos=0, payload=payload))
+    return json.loads(mosq_test.read_publish(sock))["responses"]
+
+
+def expect_ok(sock, commands):
+    responses = send_commands(sock, commands)
+    for r in responses:
+        if "error" in r:
+            raise mosq_test.TestError(f"unexpected error: {responses}")
+    return responses
+
+
+def expect_error(sock, cmd, error):
+    responses = send_commands(sock, [cmd])
+    if responses[0].get("error") != error:
+        raise mosq_test.TestError(f"expected '{error}': {responses}")
+
+
+def list_clients(sock):
+    return expect_ok(sock, [command("listClients")])[0]["data"]["clients"]
+
+
+def get_client(sock, username):
+    client = expect_ok(sock, [command("getClient", username=username)])[0]["data"]["client"]
+    return ([r["rolename"] for r in client["roles"]], [g["groupname"] for g in client["groups"]])
+
+
+def group_clients(sock, groupname):
+    group = expect_ok(sock, [command("getGroup", groupname=groupname)])[0]["data"]["group"]
+    return [c["username"] for c in group["clients"]]
+
+
+port = mosq_test.get_port()
+conf_file = os.path.basename(__file__).replace('.py', '.conf')
+write_config(conf_file, port)
+config_path = f"{port}/dynamic-security.json"
+
+connect_packet_admin = mosq_test.gen_connect("ctrl-test", username="admin", password="admin")
+connack_packet_admin = mosq_test.gen_connack(rc=0)
+
+mid = 2
+subscribe_packet_admin = mosq_test.gen_subscribe(mid, "$CONTROL/dynamic-security/#", 1)
+suback_packet_admin = mosq_test.gen_suback(mid, 1)
+
+connect_packet_c = mosq_test.gen_connect("cid-c", username="user-c", password="password-c")
+connack_packet_c = mosq_test.gen_connack(rc=0)
+
+try:
+    os.mkdir(str(port))
+    shutil.copyfile(str(Path(__file__).resolve().parent / "dynamic-security-init.json"), config_path)
+except FileExistsError:
+    pass
+
+rc = 1
+broker = mosq_test.start_broker(filename=os.path.basename(__file__), use_conf=True, port=port)
+
+try:
+    sock = mosq_test.do_client_connect(connect_packet_admin, connack_packet_admin, timeout=5, port=port)
+    mosq_test.do_send_receive(sock, subscribe_packet_admin, suback_packet_admin, "admin suback")
+
+    expect_ok(sock, [
+        command("createRole", rolename="role-one"),
+        command("createRole", rolename="role-two"),
+        command("createGroup", groupname="group-one"),
+        command("createGroup", groupname="group-two"),
+    ])
+
+    # Invalid batches change nothing
+    expect_error(sock, command("createClients", clients=[
+            {"username": "user-x"},
+            {"username": "user-y", "roles": [{"rolename": "no-such-role"}]},
+        ]), "clients[1]: Role not found")
+    expect_error(sock, command("createClients", clients=[
+            {"username": "user-x"},
+            {"username": "user-x"},
+        ]), "clients[1]: Duplicate username")
+    expect_error(sock, command("createClients", clients=[
+            {"username": "user-x", "groups": [{"groupname": "no-such-group"}]},
+        ]), "clients[0]: Group not found")
+    expect_error(sock, command("createClients", clients=[
+            {"username": "user-x"},
+            {"username": "admin"},
+        ]), "clients[1]: Client already exists")
+    expect_error(sock, command("createClients"), "Invalid/missing clients")
+    if list_clients(sock) != ["admin"]:
+        raise mosq_test.TestError("invalid createClients applied")
+
+    # Given out of order, stored in order
+    expect_ok(sock, [command("createClients", clients=[
+            {"username": "user-c", "password": "password-c", "roles": [{"rolename": "role-one"}],
+                "groups": [{"groupname": "group-one", "priority": 2}]},
+            {"username": "user-a", "roles": [{"rolename": "role-one"}, {"rolename": "role-two"}]},
+            {"username": "user-b", "clientid": "cid-b", "groups": [{"groupname": "group-one"}]},
+        ])])
+    if list_clients(sock) != ["admin", "user-a", "user-b", "user-c"]:
+        raise mosq_test.TestError(f"clients: {list_clients(sock)}")
+    if get_client(sock, "user-a") != (["role-one", "role-two"], []):
+        raise mosq_test.TestError(f"user-a: {get_client(sock, 'user-a')}")
+    if get_client(sock, "user-c") != (["role-one"], ["group-one"]):
+        raise mosq_test.TestError(f"user-c: {get_client(sock, 'user-c')}")
+    if group_clients(sock, "group-one") != ["user-b", "user-c"]:
+        raise mosq_test.TestError(f"group-one: {group_clients(sock, 'group-one')}")
+
+    # The password given in the batch works
+    csock = mosq_test.do_client_connect(connect_packet_c, connack_packet_c, timeout=5, port=port)
+    csock.close()
+
+    expect_error(sock, command("addGroupClients", groupname="group-two", clients=[
+            {"username": "user-c"},
+            {"username": "no-such-user"},
+        ]), "clients[1]: Client not found")
+    expect_error(sock, command("addGroupClients", groupname="group-one", clients=[
+            {"username": "user-a"},
+            {"username": "user-b"},
+        ]), "clients[1]: Client is already in this group")
+    expect_error(sock, command("addGroupClients", groupname="group-two", clients=[
+            {"username": "user-a"},
+            {"username": "user-a"},
+        ]), "clients[1]: Client is already in this group")
+    expect_error(sock, command("addGroupClients", groupname="no-such-group", clients=[]), "Group not found")
+    if group_clients(sock, "group-two") != [] or group_clients(sock, "group-one") != ["user-b", "user-c"]:
+        raise mosq_test.TestError("invalid addGroupClients applied")
+    if get_client(sock, "user-a") != (["role-one", "role-two"], []):
+        raise mosq_test.TestError("invalid addGroupClients applied to client")
+
+    expect_ok(sock, [command("addGroupClients", groupname="group-two", clients=[
+            {"username": "user-c", "priority": 5},
+            {"username": "user-a"},
+        ])])
+    if group_clients(sock, "group-two") != ["user-a", "user-c"]:
+        raise mosq_test.TestError(f"group-two: {group_clients(sock, 'group-two')}")
+    if get_client(sock, "user-c") != (["role-one"], ["group-two", "group-one"]):
+        raise mosq_test.TestError(f"user-c groups: {get_client(sock, 'user-c')}")
+
+    expect_error(sock, command("setClientRolesBulk", clients=[
+            {"username": "user-a", "roles": []},
+            {"username": "user-b", "roles": [{"rolename": "no-such-role"}]},
+        ]), "clients[1]: Role not found")
+    expect_error(sock, command("setClientRolesBulk", clients=[
+            {"username": "user-a", "roles": []},
+            {"username": "user-b"},
+        ]), "clients[1]: Invalid/missing roles")
+    if get_client(sock, "user-a") != (["role-one", "role-two"], ["group-two"]):
+        raise mosq_test.TestError("invalid setClientRolesBulk applied")
+
+    expect_ok(sock, [command("setClientRolesBulk", clients=[
+            {"username": "user-a", "roles": []},
+            {"username": "user-b", "roles": [{"rolename": "role-two"}, {"rolename": "role-one", "priority": 3}]},
+        ])])
+    if get_client(sock, "user-a")[0] != []:
+        raise mosq_test.TestError(f"user-a roles: {get_client(sock, 'user-a')}")
+    if get_client(sock, "user-b")[0] != ["role-one", "role-two"]:
+        raise mosq_test.TestError(f"user-b roles: {get_client(sock, 'user-b')}")
+
+    # Roles added in bulk refer back to their clients, so deleting a role
+    # removes it from them
+    expect_ok(sock, [command("deleteRole", rolename="role-two")])
+    if get_client(sock, "user-b")[0] != ["role-one"]:
+        raise mosq_test.TestError(f"user-b roles after delete: {get_client(sock, 'user-b')}")
+    expect_ok(sock, [command("deleteRole", rolename="role-one")])
+    if get_client(sock, "user-c")[0] != []:
+        raise mosq_test.TestError(f"user-c roles after delete: {get_client(sock, 'user-c')}")
+
+    sock.close()
+
+    with open(config_path, 'r') as f:
+        saved = json.load(f)
+    if [c["username"] for c in saved["clients"]] != ["admin", "user-a", "user-b", "user-c"]:
+        raise mosq_test.TestError("config not saved")
+
+    rc = 0
+except mosq_test.TestError as e:
+    print(e)
+except ValueError as e:
+    print(e)
+finally:
+    os.remove(conf_file)
+    try:
+        os.remove(config_path)
+    except FileNotFoundError:
+        pass
+    os.rmdir(f"{port}")
+    broker.terminate()
+    if mosq_test.wait_for_subprocess(broker):
+        print("broker not terminated")
+        if rc == 0: rc=1
+    (stdo, stde) = broker.communicate()
+    if rc:
+        print(stde.decode('utf-8'))
+
+
+exit(rc)
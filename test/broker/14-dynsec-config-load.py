@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+
+# Check that a config file with the clients listed before the groups and roles
+# they refer to is loaded correctly, that the different password forms work,
+# and that a password that hasn't been used yet is saved again unchanged.
+
+from mosq_test_helper import *
+from dynsec_helper import *
+import json
+
+def write_config(filename, port):
+    with open(filename, 'w') as f:
+        f.write("listener %d\n" % (port))
+        f.write("allow_anonymous false\n")
+        f.write(f"plugin {mosq_test.get_build_root()}/plugins/dynamic-security/mosquitto_dynamic_security.so\n")
+        f.write("plugin_opt_config_file %d/dynamic-security.json\n" % (port))
+
+
+def send_commands(sock, commands):
+    payload = json.dumps({"commands": commands})
+    sock.send(mosq_test.gen_publish(topic="$CONTROL/dynamic-security/v1", qos=0, payload=payload))
+    response = json.loads(mosq_test.read_publish(sock))
+    for r in response["responses"]:
+        if "error" in r:
+            raise ValueError(response)
+    return response["responses"]
+
+
+port = mosq_test.get_port()
+conf_file = os.path.basename(__file__).replace('.py', '.conf')
+write_config(conf_file, port)
+config_path = f"{port}/dynamic-security.json"
+
+# All of these are the password "admin"
+salt = "Ezuo4G1TqYtTQDL/"
+hashed = "Rko31yHY12ryMoyZTBNIUsCPb5SDa4WmUP3Xe2+V6P+QOSW3Gj6IDmpl6zQsAjutb476zEYdBeTw9tU7WZ1new=="
+encoded = f"$7$101${salt}${hashed}"
+
+admin_acls = []
+for acltype in ["publishClientSend", "publishClientReceive", "subscribePattern"]:
+    admin_acls.append({"acltype": acltype, "topic": "$CONTROL/dynamic-security/#", "allow": True})
+
+config = {
+    "comment": {"text": "Brackets ]}[{ and \"quotes\\\" in a string", "list": [[], {}]},
+    "clients": [
+        {"username": "admin", "password": hashed, "salt": salt, "iterations": 101, "roles": [{"rolename": "admin"}]},
+        "not a client",
+        {"username": "user-enc", "encoded_password": encoded},
+        {"username": "user-lazy", "encoded_password": encoded},
+        {"username": "user-bad", "encoded_password": "not-a-hash"},
+    ],
+    "groups": [
+        {"groupname": "group-one", "roles": [{"rolename": "role-one"}], "clients": [{"username": "user-enc"}]},
+    ],
+    "anonymousGroup": "group-one",
+    "roles": [
+        {"rolename": "admin", "acls": admin_acls},
+        {"rolename": "role-one", "acls": [{"acltype": "publishClientSend", "topic": "topic/#", "allow": True}]},
+    ],
+    "defaultACLAccess": {
+        "publishClientSend": False,
+        "publishClientReceive": True,
+        "subscribe": False,
+        "unsubscribe": True
+    }
+}
+
+connect_packet_admin = mosq_test.gen_connect("ctrl-test", username="admin", password="admin")
+connack_packet_admin = mosq_test.gen_connack(rc=0)
+
+mid = 2
+subscribe_packet_admin = mosq_test.gen_subscribe(mid, "$CONTROL/dynamic-security/#", 1)
+suback_packet_admin = mosq_test.gen_suback(mid, 1)
+
+connect_packet_enc = mosq_test.gen_connect("cid-enc", username="user-enc", password="admin", proto_ver=5)
+connack_packet_enc = mosq_test.gen_connack(rc=0, proto_ver=5)
+
+mid = 3
+publish_packet_allowed = mosq_test.gen_publish("topic/one", qos=1, mid=mid, payload="message", proto_ver=5)
+puback_packet_allowed = mosq_test.gen_puback(mid, proto_ver=5, reason_code=mqtt5_rc.NO_MATCHING_SUBSCRIBERS)
+
+mid = 4
+publish_packet_denied = mosq_test.gen_publish("other/one", qos=1, mid=mid, payload="message", proto_ver=5)
+puback_packet_denied = mosq_test.gen_puback(mid, proto_ver=5, reason_code=mqtt5_rc.NOT_AUTHORIZED)
+
+connect_packet_bad = mosq_test.gen_connect("cid-bad", username="user-bad", password="admin")
+connack_packet_bad = mosq_test.gen_connack(rc=5)
+
+try:
+    os.mkdir(str(port))
+except FileExistsError:
+    pass
+with open(config_path, 'wb') as f:
+    f.write(b"\xef\xbb\xbf")
+    f.write(json.dumps(config, indent=4).encode('utf-8'))
+
+rc = 1
+broker = mosq_test.start_broker(filename=os.path.basename(__file__), use_conf=True, port=port)
+
+try:
+    sock = mosq_test.do_client_connect(connect_packet_admin, connack_packet_admin, timeout=5, port=port)
+    mosq_test.do_send_receive(sock, subscribe_packet_admin, suback_packet_admin, "admin suback")
+
+    responses = send_commands(sock, [
+        {"command": "getClient", "username": "user-enc"},
+        {"command": "getGroup", "groupname": "group-one"},
+        {"command": "getAnonymousGroup"},
+        {"command": "listClients"},
+    ])
+    if responses[0]["data"]["client"]["groups"] != [{"groupname": "group-one"}]:
+        raise mosq_test.TestError(f"client groups: {responses[0]}")
+    group = responses[1]["data"]["group"]
+    if group["clients"] != [{"username": "user-enc"}] or group["roles"] != [{"rolename": "role-one"}]:
+        raise mosq_test.TestError(f"group: {responses[1]}")
+    if responses[2]["data"]["group"]["groupname"] != "group-one":
+        raise mosq_test.TestError(f"anonymous group: {responses[2]}")
+    if responses[3]["data"]["clients"] != ["admin", "user-bad", "user-enc", "user-lazy"]:
+        raise mosq_test.TestError(f"clients: {responses[3]}")
+
+    # The role is granted through a group loaded after the client
+    enc_sock = mosq_test.do_client_connect(connect_packet_enc, connack_packet_enc, timeout=5, port=port)
+    mosq_test.do_send_receive(enc_sock, publish_packet_allowed, puback_packet_allowed, "puback allowed")
+    mosq_test.do_send_receive(enc_sock, publish_packet_denied, puback_packet_denied, "puback denied")
+    enc_sock.close()
+
+    bad_sock = mosq_test.do_client_connect(connect_packet_bad, connack_packet_bad, timeout=5, port=port)
+    bad_sock.close()
+
+    # Force the config to be saved
+    send_commands(sock, [{"command": "createRole", "rolename": "role-two"}])
+    sock.close()
+
+    with open(config_path, 'r') as f:
+        saved = json.load(f)
+    clients = {c["username"]: c for c in saved["clients"]}
+    if clients["user-lazy"].get("encoded_password") != encoded:
+        raise mosq_test.TestError(f"unused password not kept: {clients['user-lazy']}")
+    if "encoded_password" not in clients["admin"] or "encoded_password" not in clients["user-enc"]:
+        raise mosq_test.TestError("used passwords not saved")
+    if "encoded_password" in clients["user-bad"]:
+        raise mosq_test.TestError("invalid password saved")
+
+    rc = 0
+except mosq_test.TestError as e:
+    print(e)
+except ValueError as e:
+    print(e)
+finally:
+    os.remove(conf_file)
+    try:
+        os.remove(config_path)
+    except FileNotFoundError:
+        pass
+    os.rmdir(f"{port}")
+    broker.terminate()
+    if mosq_test.wait_for_subprocess(broker):
+        print("broker not terminated")
+        if rc == 0: rc=1
+    (stdo, stde) = broker.communicate()
+    if rc:
+        print(stde.decode('utf-8'))
+
+
+exit(rc)
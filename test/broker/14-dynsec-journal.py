@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+
+# Check that changes saved to the dynamic security journal are restored when
+# the broker is killed and started again, and that the journal is folded into
+# the config file when the broker stops cleanly.
+
+from mosq_test_helper import *
+from dynsec_helper import *
+import json
+import shutil
+
+def write_config(filename, port):
+    with open(filename, 'w') as f:
+        f.write("listener %d\n" % (port))
+        f.write("allow_anonymous false\n")
+        f.write(f"plugin {mosq_test.get_build_root()}/plugins/dynamic-security/mosquitto_dynamic_security.so\n")
+        f.write("plugin_opt_config_file %d/dynamic-security.json\n" % (port))
+        f.write("plugin_opt_journal true\n")
+
+
+def command(name, **kwargs):
+    cmd = {"command": name}
+    cmd.update(kwargs)
+    return cmd
+
+
+def send_commands(sock, commands):
+    payload = json.dumps({"commands": commands})
+    sock.send(mosq_test.gen_publish(topic="$CONTROL/dynamic-security/v1", qos=0, payload=payload))
+    response = json.loads(mosq_test.read_publish(sock))
+    for r in response["responses"]:
+        if "error" in r:
+            raise ValueError(response)
+    return response
+
+
+port = mosq_test.get_port()
+conf_file = os.path.basename(__file__).replace('.py', '.conf')
+write_config(conf_file, port)
+config_path = f"{port}/dynamic-security.json"
+journal_path = f"{port}/dynamic-security.json.journal"
+
+changes = [
+    [
+        command("createRole", rolename="role-one", acls=[{"acltype": "publishClientSend", "topic": "topic/#", "allow": True}]),
+        command("createRole", rolename="role-two"),
+        command("createGroup", groupname="group-one"),
+        command("addGroupRole", groupname="group-one", rolename="role-two", priority=2),
+        command("createClient", username="user-one", password="password-one", clientid="cid-one",
+            roles=[{"rolename": "role-one"}], groups=[{"groupname": "group-one", "priority": 3}]),
+        command("createClient", username="user-two", password="password-two"),
+        command("createClient", username="user-three", password="password-three"),
+    ],
+    [
+        command("addGroupClient", groupname="group-one", username="user-two", priority=5),
+        command("addRoleACL", rolename="role-two", acltype="subscribePattern", topic="sub/#", allow=False, priority=4),
+        command("modifyRole", rolename="role-one", textname="Role one"),
+        command("setClientPassword", username="user-two", password="new-password"),
+        command("disableClient", username="user-three"),
+        command("setDefaultACLAccess", acls=[{"acltype": "publishClientReceive", "allow": False}]),
+        command("createClients", clients=[
+            {"username": "user-four", "groups": [{"groupname": "group-one"}]},
+            {"username": "user-five", "roles": [{"rolename": "role-one"}]},
+        ]),
+        command("setClientRolesBulk", clients=[{"username": "user-two", "roles": [{"rolename": "role-one"}]}]),
+    ],
+    [
+        # Deleted and created again in one batch, the new role is not held by anyone
+        command("deleteRole", rolename="role-two"),
+        command("createRole", rolename="role-two", textname="New role two"),
+        command("deleteClient", username="user-three"),
+        command("createGroup", groupname="group-two"),
+        command("addGroupClient", groupname="group-two", username="user-one"),
+        command("setAnonymousGroup", groupname="group-two"),
+    ],
+]
+
+snapshot_commands = [
+    command("getClient", username="user-one"),
+    command("getClient", username="user-two"),
+    command("getClient", username="user-four"),
+    command("getClient", username="user-five"),
+    command("getGroup", groupname="group-one"),
+    command("getGroup", groupname="group-two"),
+    command("getRole", rolename="role-one"),
+    command("getRole", rolename="role-two"),
+    command("listClients", verbose=False),
+    command("listGroups", verbose=False),
+    command("listRoles", verbose=False),
+    command("getDefaultACLAccess"),
+    command("getAnonymousGroup"),
+    command("getDetails"),
+]
+
+connect_packet_admin = mosq_test.gen_connect("ctrl-test", username="admin", password="admin")
+connack_packet_admin = mosq_test.gen_connack(rc=0)
+
+mid = 2
+subscribe_packet_admin = mosq_test.gen_subscribe(mid, "$CONTROL/dynamic-security/#", 1)
+suback_packet_admin = mosq_test.gen_suback(mid, 1)
+
+connect_packet_two = mosq_test.gen_connect("cid-two", username="user-two", password="new-password")
+connack_packet_two = mosq_test.gen_connack(rc=0)
+
+
+def admin_connect():
+    sock = mosq_test.do_client_connect(connect_packet_admin, connack_packet_admin, timeout=5, port=port)
+    mosq_test.do_send_receive(sock, subscribe_packet_admin, suback_packet_admin, "admin suback")
+    return sock
+
+
+try:
+    os.mkdir(str(port))
+    shutil.copyfile(str(Path(__file__).resolve().parent / "dynamic-security-init.json"), config_path)
+except FileExistsError:
+    pass
+
+rc = 1
+broker = mosq_test.start_broker(filename=os.path.basename(__file__), use_conf=True, port=port)
+
+try:
+    sock = admin_connect()
+    for batch in changes:
+        send_commands(sock, batch)
+    snapshot = send_commands(sock, snapshot_commands)
+    sock.close()
+
+    # Changes are in the journal, not the config file
+    with open(config_path, 'r') as f:
+        if "user-one" in f.read():
+            raise mosq_test.TestError("config file rewritten")
+    if not os.path.exists(journal_path):
+        raise mosq_test.TestError("no journal")
+
+    broker.kill()
+    broker.communicate()
+    broker = mosq_test.start_broker(filename=os.path.basename(__file__), use_conf=True, port=port)
+
+    sock = admin_connect()
+    restored = send_commands(sock, snapshot_commands)
+    if restored != snapshot:
+        print(snapshot)
+        print(restored)
+        raise mosq_test.TestError("state not restored")
+    sock.close()
+
+    # The replayed password works
+    sock = mosq_test.do_client_connect(connect_packet_two, connack_packet_two, timeout=5, port=port)
+    sock.close()
+
+    # A clean stop folds the journal into the config file
+    broker.terminate()
+    if mosq_test.wait_for_subprocess(broker):
+        raise mosq_test.TestError("broker not terminated")
+    broker.communicate()
+    if os.path.exists(journal_path):
+        raise mosq_test.TestError("journal not removed")
+    with open(config_path, 'r') as f:
+        if "user-one" not in f.read():
+            raise mosq_test.TestError("config file not rewritten")
+
+    broker = mosq_test.start_broker(filename=os.path.basename(__file__), use_conf=True, port=port)
+    sock = admin_connect()
+    restored = send_commands(sock, snapshot_commands)
+    if restored != snapshot:
+        print(snapshot)
+        print(restored)
+        raise mosq_test.TestError("state not restored from compacted config")
+    sock.close()
+
+    rc = 0
+except mosq_test.TestError as e:
+    print(e)
+except ValueError as e:
+    print(e)
+finally:
+    os.remove(conf_file)
+    for path in [config_path, journal_path]:
+        try:
+            os.remove(path)
+        except FileNotFoundError:
+            pass
+    os.rmdir(f"{port}")
+    broker.terminate()
+    if mosq_test.wait_for_subprocess(broker):
+        print("broker not terminated")
+        if rc == 0: rc=1
+    (stdo, stde) = broker.communicate()
+    if rc:
+        print(stde.decode('utf-8'))
+
+
+exit(rc)
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+
+# Test $CONTROL/broker/v1 getPluginStats, and the $SYS plugin stats, including
+# for a plugin whose name has characters that can't be used in a topic level
+
+from mosq_test_helper import *
+import json
+
+def write_config(filename, port):
+    with open(filename, 'w') as f:
+        f.write("enable_control_api true\n")
+        f.write("allow_anonymous true\n")
+        f.write("sys_interval 1\n")
+        f.write("listener %d\n" % (port))
+        f.write("plugin c/auth_plugin_v5_control.so\n")
+        f.write("plugin c/plugin_stats_name.so\n")
+
+def check_event(plugin, name, count=None):
+    for event in plugin['events']:
+        if event['event'] == name:
+            break
+    else:
+        raise ValueError(f"{name} missing")
+
+    if count is not None and event['count'] != count:
+        raise ValueError(f"{name} count {event['count']}")
+    if event['count'] < 1:
+        raise ValueError(f"{name} count {event['count']}")
+    if not (0 <= event['p50-ns'] <= event['p90-ns'] <= event['p99-ns'] <= event['max-ns'] <= event['total-ns']):
+        raise ValueError(f"{name} times {event}")
+
+
+port = mosq_test.get_port()
+conf_file = os.path.basename(__file__).replace('.py', '.conf')
+write_config(conf_file, port)
+
+rc = 1
+connect_packet = mosq_test.gen_connect("17-plugin-stats")
+connack_packet = mosq_test.gen_connack(rc=0)
+
+mid = 2
+subscribe_packet = mosq_test.gen_subscribe(mid, "$CONTROL/broker/#", 0)
+suback_packet = mosq_test.gen_suback(mid, 0)
+
+mid = 3
+sys_subscribe_packet = mosq_test.gen_subscribe(mid, "$SYS/broker/plugins/test-plugin/basic-auth/count", 0)
+sys_suback_packet = mosq_test.gen_suback(mid, 0)
+
+mid = 4
+sys_name_subscribe_packet = mosq_test.gen_subscribe(mid, "$SYS/broker/plugins/stats_name__/message-in/count", 0)
+sys_name_suback_packet = mosq_test.gen_suback(mid, 0)
+
+broker = mosq_test.start_broker(filename=os.path.basename(__file__), use_conf=True, port=port)
+
+try:
+    sock = mosq_test.do_client_connect(connect_packet, connack_packet, port=port)
+    mosq_test.do_send_receive(sock, subscribe_packet, suback_packet, "suback")
+
+    cmd = {"commands":[{"command": "getPluginStats", "correlationData": "nXSV2GJ3a0m0rG6HqIFlq7HX"}]}
+    command_packet = mosq_test.gen_publish(topic="$CONTROL/broker/v1", qos=0, payload=json.dumps(cmd))
+    sock.send(command_packet)
+    response = json.loads(mosq_test.read_publish(sock))
+
+    r = response['responses'][0]
+    if r['command'] != 'getPluginStats' or r['correlationData'] != "nXSV2GJ3a0m0rG6HqIFlq7HX":
+        raise ValueError(response)
+    plugins = r['data']['plugins']
+    if len(plugins) != 2 or plugins[0]['name'] != 'test-plugin' or plugins[1]['name'] != 'stats/name+#':
+        raise ValueError(response)
+    check_event(plugins[0], "basic-auth", 1)
+    check_event(plugins[0], "acl-check")
+
+    # The $SYS value is published on the next update, and retained
+    mosq_test.do_send_receive(sock, sys_subscribe_packet, sys_suback_packet, "sys suback")
+    payload = mosq_test.read_publish(sock)
+    if payload != "1":
+        raise ValueError(f"$SYS count {payload}")
+
+    sock.send(mosq_test.gen_publish(topic="plugin-stats", qos=0, payload="message"))
+    mosq_test.do_send_receive(sock, sys_name_subscribe_packet, sys_name_suback_packet, "sys name suback")
+    payload = mosq_test.read_publish(sock)
+    if int(payload) < 1:
+        raise ValueError(f"$SYS name count {payload}")
+
+    mosq_test.do_ping(sock)
+
+    rc = 0
+
+    sock.close()
+except mosq_test.TestError:
+    pass
+except Exception as e:
+    print(e)
+finally:
+    os.remove(conf_file)
+    broker.terminate()
+    if mosq_test.wait_for_subprocess(broker):
+        print("broker not terminated")
+        if rc == 0: rc=1
+    (stdo, stde) = broker.communicate()
+    if rc:
+        print(stde.decode('utf-8'))
+
+
+exit(rc)
@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+
+# Check the shm-tap plugin copies matching messages into its shared memory
+# ring, in the layout described in plugins/shm-tap/shm_tap.h, and that it
+# replaces a symlink at the ring path rather than writing through it.
+
+from mosq_test_helper import *
+import mmap
+import struct
+
+HEADER_FORMAT = "<IIIIQQQQQII64x"
+SLOT_FORMAT = "<QQQIIBB6x"
+SLOT_COUNT = 4
+DATA_SIZE = 256
+
+def write_config(filename, port, tap_path):
+    with open(filename, 'w') as f:
+        f.write("listener %d\n" % (port))
+        f.write("allow_anonymous true\n")
+        f.write(f"plugin {mosq_test.get_build_root()}/plugins/shm-tap/mosquitto_shm_tap.so\n")
+        f.write(f"plugin_opt_path {tap_path}\n")
+        f.write(f"plugin_opt_slots {SLOT_COUNT}\n")
+        f.write(f"plugin_opt_data_size {DATA_SIZE}\n")
+        f.write("plugin_opt_topic tap/#\n")
+
+def read_header(m):
+    (magic, version, header_size, slot_count, data_offset, data_size,
+            write_seq, data_head, dropped, wake, waiters) = struct.unpack_from(HEADER_FORMAT, m, 0)
+    if magic != 0x5041544D or version != 1 or header_size != 128:
+        raise ValueError(f"header {magic:x} {version} {header_size}")
+    if slot_count != SLOT_COUNT or data_size != DATA_SIZE:
+        raise ValueError(f"sizes {slot_count} {data_size}")
+    return data_offset, write_seq, data_head, dropped
+
+def read_message(m, seq):
+    data_offset, write_seq, data_head, dropped = read_header(m)
+    if seq >= write_seq:
+        raise ValueError(f"message {seq} not written, write_seq {write_seq}")
+    (slot_seq, data_pos, store_id, topic_len, payload_len, qos, retain) = \
+        struct.unpack_from(SLOT_FORMAT, m, 128 + (seq % SLOT_COUNT)*40)
+    if slot_seq != seq:
+        return None
+    offset = data_offset + (data_pos % DATA_SIZE)
+    topic = m[offset:offset+topic_len].decode('utf-8')
+    payload = m[offset+topic_len:offset+topic_len+payload_len]
+    if data_head - data_pos > DATA_SIZE:
+        return None
+    return (topic, payload, qos, retain)
+
+def do_publish(sock, mid, topic, payload, retain=False):
+    publish_packet = mosq_test.gen_publish(topic, qos=1, mid=mid, payload=payload, retain=retain)
+    puback_packet = mosq_test.gen_puback(mid)
+    mosq_test.do_send_receive(sock, publish_packet, puback_packet, f"puback {mid}")
+
+def do_test():
+    port = mosq_test.get_port()
+    conf_file = os.path.basename(__file__).replace('.py', '.conf')
+    tap_path = os.path.abspath(f"{port}.shm-tap")
+    victim_path = os.path.abspath(f"{port}.shm-tap-victim")
+    write_config(conf_file, port, tap_path)
+
+    with open(victim_path, "wb") as f:
+        f.write(b"victim")
+    os.symlink(victim_path, tap_path)
+
+    rc = 1
+    connect_packet = mosq_test.gen_connect("shm-tap-test")
+    connack_packet = mosq_test.gen_connack(rc=0)
+
+    broker = mosq_test.start_broker(filename=os.path.basename(__file__), use_conf=True, port=port)
+
+    try:
+        sock = mosq_test.do_client_connect(connect_packet, connack_packet, port=port)
+
+        if os.path.islink(tap_path):
+            raise ValueError("tap path is still a symlink")
+        with open(tap_path, "rb") as f:
+            m = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+
+        do_publish(sock, 1, "tap/one", b"message one")
+        do_publish(sock, 2, "other", b"not tapped")
+        do_publish(sock, 3, "tap/two", b"", retain=True)
+        mosq_test.do_ping(sock)
+
+        if read_message(m, 0) != ("tap/one", b"message one", 1, 0):
+            raise ValueError(f"message 0 {read_message(m, 0)}")
+        if read_message(m, 1) != ("tap/two", b"", 1, 1):
+            raise ValueError(f"message 1 {read_message(m, 1)}")
+        if read_header(m)[1] != 2:
+            raise ValueError(f"write_seq {read_header(m)[1]}")
+
+        # Too large for the data area
+        do_publish(sock, 4, "tap/big", b"x"*200)
+        mosq_test.do_ping(sock)
+        if read_header(m)[3] != 1:
+            raise ValueError(f"dropped {read_header(m)[3]}")
+
+        # Wrap around the slots and the data area, the oldest messages are lost
+        for i in range(6):
+            do_publish(sock, 5+i, f"tap/{i}", b"y"*40)
+        mosq_test.do_ping(sock)
+
+        data_offset, write_seq, data_head, dropped = read_header(m)
+        if write_seq != 8:
+            raise ValueError(f"write_seq {write_seq}")
+        if read_message(m, 0) is not None or read_message(m, 3) is not None:
+            raise ValueError("overwritten message still valid")
+        for seq in range(4, 8):
+            if read_message(m, seq) != (f"tap/{seq-2}", b"y"*40, 1, 0):
+                raise ValueError(f"message {seq} {read_message(m, seq)}")
+
+        m.close()
+        sock.close()
+        rc = 0
+    except mosq_test.TestError:
+        pass
+    except Exception as e:
+        print(e)
+    finally:
+        os.remove(conf_file)
+        broker.terminate()
+        if mosq_test.wait_for_subprocess(broker):
+            print("broker not terminated")
+            if rc == 0: rc=1
+        (stdo, stde) = broker.communicate()
+        if os.path.lexists(tap_path):
+            print("tap file not removed")
+            rc = 1
+        with open(victim_path, "rb") as f:
+            if f.read() != b"victim":
+                print("symlink target modified")
+                rc = 1
+        os.remove(victim_path)
+        if rc:
+            print(stde.decode('utf-8'))
+            exit(rc)
+
+do_test()
+exit(0)
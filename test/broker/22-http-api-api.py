@@ -135,6 +135,16 @@ try:
     if payload != expected_payload:
         raise ValueError(f"/api/v1/systree payload\n{payload}\n{expected_payload}")
 
+    # Plugin stats API
+    http_conn.request("GET", "/api/v1/plugin-stats")
+    response = http_conn.getresponse()
+    if response.status != 200:
+        raise ValueError(f"/api/v1/plugin-stats {response.status}")
+    payload = json.loads(response.read().decode('utf-8'))
+    expected_payload = {"plugins": []}
+    if payload != expected_payload:
+        raise ValueError(f"/api/v1/plugin-stats payload\n{payload}\n{expected_payload}")
+
     # Version API
     http_conn.request("GET", "/api/v1/version")
     response = http_conn.getresponse()
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mosquitto.h>
+#include <mosquitto/broker.h>
+#include <mosquitto/broker_plugin.h>
+
+MOSQUITTO_PLUGIN_DECLARE_VERSION(5);
+
+#define MAX_HELD 10
+
+static mosquitto_plugin_id_t *plg_id;
+static const struct mosquitto_base_msg *held[MAX_HELD];
+static int held_count = 0;
+
+
+static void release_held(void)
+{
+	char buf[200];
+	size_t len = 0;
+
+	buf[0] = '\0';
+	for(int i=0; i<held_count; i++){
+		len += (size_t)snprintf(&buf[len], sizeof(buf)-len, "%s%.*s",
+				i?",":"", (int)held[i]->payloadlen, (const char *)held[i]->payload);
+		mosquitto_base_msg_ref_dec(held[i]);
+	}
+	held_count = 0;
+
+	mosquitto_broker_publish_copy(NULL, "batch/held", (int)len, buf, 0, false, NULL);
+}
+
+
+int callback_message_in_batch(int event, void *event_data, void *user_data)
+{
+	struct mosquitto_evt_message_batch *ed = event_data;
+
+	(void)user_data;
+
+	if(event != MOSQ_EVT_MESSAGE_IN_BATCH || ed->message_count < 1){
+		abort();
+	}
+
+	for(int i=0; i<ed->message_count; i++){
+		if(!strcmp(ed->messages[i]->topic, "release")){
+			release_held();
+		}else if(held_count < MAX_HELD){
+			/* Keep hold of the message after its subscribers are done with it */
+			mosquitto_base_msg_ref_inc(ed->messages[i]);
+			held[held_count] = ed->messages[i];
+			held_count++;
+		}
+	}
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+int mosquitto_plugin_init(mosquitto_plugin_id_t *identifier, void **user_data, struct mosquitto_opt *opts, int opt_count)
+{
+	(void)user_data;
+	(void)opts;
+	(void)opt_count;
+
+	plg_id = identifier;
+
+	mosquitto_callback_register(plg_id, MOSQ_EVT_MESSAGE_IN_BATCH, callback_message_in_batch, NULL, NULL);
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+int mosquitto_plugin_cleanup(void *user_data, struct mosquitto_opt *opts, int opt_count)
+{
+	(void)user_data;
+	(void)opts;
+	(void)opt_count;
+
+	mosquitto_callback_unregister(plg_id, MOSQ_EVT_MESSAGE_IN_BATCH, callback_message_in_batch, NULL);
+
+	return MOSQ_ERR_SUCCESS;
+}
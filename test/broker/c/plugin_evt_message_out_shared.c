@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mosquitto.h>
+#include <mosquitto/broker.h>
+#include <mosquitto/broker_plugin.h>
+
+MOSQUITTO_PLUGIN_DECLARE_VERSION(5);
+
+static mosquitto_plugin_id_t *plg_id;
+static int call_count = 0;
+
+
+int callback_message_out(int event, void *event_data, void *user_data)
+{
+	struct mosquitto_evt_message *ed = event_data;
+	char buf[50];
+
+	(void)user_data;
+
+	if(event != MOSQ_EVT_MESSAGE_OUT || ed->client != NULL){
+		abort();
+	}
+	if(!strcmp(ed->topic, "deny")){
+		return MOSQ_ERR_ACL_DENIED;
+	}
+
+	/* The count shows how many times the callback has been called */
+	call_count++;
+	snprintf(buf, sizeof(buf), "shared-%d", call_count);
+	ed->payload = mosquitto_strdup(buf);
+	ed->payloadlen = (uint32_t)strlen(ed->payload);
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+int mosquitto_plugin_init(mosquitto_plugin_id_t *identifier, void **user_data, struct mosquitto_opt *opts, int opt_count)
+{
+	(void)user_data;
+	(void)opts;
+	(void)opt_count;
+
+	plg_id = identifier;
+
+	mosquitto_plugin_set_message_out_shared(plg_id, true);
+	mosquitto_callback_register(plg_id, MOSQ_EVT_MESSAGE_OUT, callback_message_out, NULL, NULL);
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+int mosquitto_plugin_cleanup(void *user_data, struct mosquitto_opt *opts, int opt_count)
+{
+	(void)user_data;
+	(void)opts;
+	(void)opt_count;
+
+	mosquitto_callback_unregister(plg_id, MOSQ_EVT_MESSAGE_OUT, callback_message_out, NULL);
+
+	return MOSQ_ERR_SUCCESS;
+}
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mosquitto.h>
+#include <mosquitto/broker.h>
+#include <mosquitto/broker_plugin.h>
+
+MOSQUITTO_PLUGIN_DECLARE_VERSION(5);
+
+static mosquitto_plugin_id_t *plg_id;
+
+
+static void check_match(const char *sub, const char *topic)
+{
+	bool match = false;
+
+	mosquitto_topic_matches_sub(sub, topic, &match);
+	if(!match){
+		abort();
+	}
+}
+
+
+static void set_payload(struct mosquitto_evt_message *ed, const char *payload)
+{
+	ed->payload = mosquitto_strdup(payload);
+	ed->payloadlen = (uint32_t)strlen(payload);
+}
+
+
+static int callback_message_in(int event, void *event_data, void *user_data)
+{
+	struct mosquitto_evt_message *ed = event_data;
+
+	(void)event;
+	(void)user_data;
+
+	check_match("in/#", ed->topic);
+	set_payload(ed, "in-modified");
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+static int callback_message_out(int event, void *event_data, void *user_data)
+{
+	struct mosquitto_evt_message *ed = event_data;
+
+	(void)event;
+	(void)user_data;
+
+	check_match("out/+", ed->topic);
+	set_payload(ed, "out-modified");
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+static int callback_acl_check(int event, void *event_data, void *user_data)
+{
+	struct mosquitto_evt_acl_check *ed = event_data;
+
+	(void)event;
+	(void)user_data;
+
+	if(ed->access == MOSQ_ACL_SUBSCRIBE || ed->access == MOSQ_ACL_UNSUBSCRIBE){
+		return MOSQ_ERR_SUCCESS;
+	}
+	check_match("deny/#", ed->topic);
+	if(ed->access == MOSQ_ACL_WRITE){
+		return MOSQ_ERR_ACL_DENIED;
+	}
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+int mosquitto_plugin_init(mosquitto_plugin_id_t *identifier, void **user_data, struct mosquitto_opt *opts, int opt_count)
+{
+	(void)user_data;
+	(void)opts;
+	(void)opt_count;
+
+	plg_id = identifier;
+
+	if(mosquitto_callback_register(plg_id, MOSQ_EVT_MESSAGE_IN, callback_message_in, "in/#/bad", NULL) != MOSQ_ERR_INVAL){
+		return MOSQ_ERR_UNKNOWN;
+	}
+	if(mosquitto_callback_register(plg_id, MOSQ_EVT_MESSAGE_IN, callback_message_in, "in/#", NULL)
+			|| mosquitto_callback_register(plg_id, MOSQ_EVT_MESSAGE_OUT, callback_message_out, "out/+", NULL)
+			|| mosquitto_callback_register(plg_id, MOSQ_EVT_ACL_CHECK, callback_acl_check, "deny/#", NULL)){
+
+		return MOSQ_ERR_UNKNOWN;
+	}
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+int mosquitto_plugin_cleanup(void *user_data, struct mosquitto_opt *opts, int opt_count)
+{
+	(void)user_data;
+	(void)opts;
+	(void)opt_count;
+
+	mosquitto_callback_unregister(plg_id, MOSQ_EVT_MESSAGE_IN, callback_message_in, NULL);
+	mosquitto_callback_unregister(plg_id, MOSQ_EVT_MESSAGE_OUT, callback_message_out, NULL);
+	mosquitto_callback_unregister(plg_id, MOSQ_EVT_ACL_CHECK, callback_acl_check, NULL);
+
+	return MOSQ_ERR_SUCCESS;
+}
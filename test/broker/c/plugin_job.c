@@ -0,0 +1,103 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <mosquitto.h>
+#include <mosquitto/broker.h>
+#include <mosquitto/broker_plugin.h>
+
+MOSQUITTO_PLUGIN_DECLARE_VERSION(5);
+
+static mosquitto_plugin_id_t *plg_id;
+
+struct auth_job {
+	char *clientid;
+	char *password;
+};
+
+
+/* Called on a worker thread, standing in for a request to an external
+ * authentication service. */
+static int auth_job_run(void *job_data)
+{
+	struct auth_job *job = job_data;
+
+	usleep(1000000);
+	if(job->password && !strcmp(job->password, "good")){
+		return MOSQ_ERR_SUCCESS;
+	}else{
+		return MOSQ_ERR_AUTH;
+	}
+}
+
+
+static void auth_job_complete(void *job_data, int result)
+{
+	struct auth_job *job = job_data;
+
+	mosquitto_complete_basic_auth(job->clientid, result);
+	if(result == MOSQ_ERR_SUCCESS){
+		mosquitto_broker_publish_copy(NULL, "job/complete", (int)strlen(job->clientid), job->clientid, 0, false, NULL);
+	}
+	free(job->clientid);
+	free(job->password);
+	free(job);
+}
+
+
+static int basic_auth_callback(int event, void *event_data, void *user_data)
+{
+	struct mosquitto_evt_basic_auth *ed = event_data;
+	struct auth_job *job;
+	const char *username = mosquitto_client_username(ed->client);
+
+	(void)event;
+	(void)user_data;
+
+	if(username == NULL || strcmp(username, "slow")){
+		return MOSQ_ERR_SUCCESS;
+	}
+
+	job = calloc(1, sizeof(struct auth_job));
+	if(job == NULL){
+		return MOSQ_ERR_NOMEM;
+	}
+	job->clientid = strdup(mosquitto_client_id(ed->client));
+	if(ed->password){
+		job->password = strdup(ed->password);
+	}
+	if(mosquitto_job_submit(plg_id, auth_job_run, auth_job_complete, job) != MOSQ_ERR_SUCCESS){
+		free(job->clientid);
+		free(job->password);
+		free(job);
+		return MOSQ_ERR_AUTH;
+	}
+	return MOSQ_ERR_AUTH_DELAYED;
+}
+
+
+int mosquitto_plugin_init(mosquitto_plugin_id_t *identifier, void **user_data, struct mosquitto_opt *opts, int opt_count)
+{
+	(void)user_data;
+	(void)opts;
+	(void)opt_count;
+
+	plg_id = identifier;
+
+	if(mosquitto_job_submit(plg_id, NULL, auth_job_complete, NULL) != MOSQ_ERR_INVAL){
+		return MOSQ_ERR_UNKNOWN;
+	}
+	return mosquitto_callback_register(plg_id, MOSQ_EVT_BASIC_AUTH, basic_auth_callback, NULL, NULL);
+}
+
+
+int mosquitto_plugin_cleanup(void *user_data, struct mosquitto_opt *opts, int opt_count)
+{
+	(void)user_data;
+	(void)opts;
+	(void)opt_count;
+
+	mosquitto_callback_unregister(plg_id, MOSQ_EVT_BASIC_AUTH, basic_auth_callback, NULL);
+
+	return MOSQ_ERR_SUCCESS;
+}
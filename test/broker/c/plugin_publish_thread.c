@@ -0,0 +1,87 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mosquitto.h>
+#include <mosquitto/broker.h>
+#include <mosquitto/broker_plugin.h>
+
+MOSQUITTO_PLUGIN_DECLARE_VERSION(5);
+
+#define THREAD_COUNT 2
+
+static mosquitto_plugin_id_t *plg_id;
+static pthread_t threads[THREAD_COUNT];
+static const char *thread_names[THREAD_COUNT] = {"a", "b"};
+static bool started = false;
+static int message_count = 0;
+
+
+static void *publish_thread(void *userdata)
+{
+	const char *name = userdata;
+	char buf[50];
+
+	for(int i=0; i<message_count; i++){
+		snprintf(buf, sizeof(buf), "%s:%d", name, i);
+		mosquitto_broker_publish_copy(NULL, "thread/out", (int)strlen(buf), buf, 0, false, NULL);
+	}
+	return NULL;
+}
+
+
+int callback_message_in(int event, void *event_data, void *user_data)
+{
+	struct mosquitto_evt_message *ed = event_data;
+	char buf[20];
+
+	(void)event;
+	(void)user_data;
+
+	if(started || ed->payloadlen == 0 || ed->payloadlen >= sizeof(buf)){
+		return MOSQ_ERR_SUCCESS;
+	}
+	memcpy(buf, ed->payload, ed->payloadlen);
+	buf[ed->payloadlen] = '\0';
+	message_count = atoi(buf);
+
+	started = true;
+	for(int i=0; i<THREAD_COUNT; i++){
+		if(pthread_create(&threads[i], NULL, publish_thread, (void *)thread_names[i])){
+			abort();
+		}
+	}
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+int mosquitto_plugin_init(mosquitto_plugin_id_t *identifier, void **user_data, struct mosquitto_opt *opts, int opt_count)
+{
+	(void)user_data;
+	(void)opts;
+	(void)opt_count;
+
+	plg_id = identifier;
+
+	mosquitto_callback_register(plg_id, MOSQ_EVT_MESSAGE_IN, callback_message_in, "thread/start", NULL);
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+int mosquitto_plugin_cleanup(void *user_data, struct mosquitto_opt *opts, int opt_count)
+{
+	(void)user_data;
+	(void)opts;
+	(void)opt_count;
+
+	if(started){
+		for(int i=0; i<THREAD_COUNT; i++){
+			pthread_join(threads[i], NULL);
+		}
+	}
+	mosquitto_callback_unregister(plg_id, MOSQ_EVT_MESSAGE_IN, callback_message_in, "thread/start");
+
+	return MOSQ_ERR_SUCCESS;
+}
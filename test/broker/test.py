@@ -32,6 +32,7 @@ tests = [
     (1, './02-shared-qos0-v5.py'),
     (1, './02-subhier-crash.py'),
     (1, './02-subpub-b2c-topic-alias.py'),
+    (1, './02-subpub-payload-filter.py'),
     (1, './02-subpub-qos0-long-topic.py'),
     (1, './02-subpub-qos0-oversize-payload.py'),
     (1, './02-subpub-qos0-queued-bytes.py'),
@@ -53,6 +54,7 @@ tests = [
     (1, './02-subpub-qos2-receive-maximum-2.py'),
     (1, './02-subpub-qos2.py'),
     (1, './02-subpub-recover-subscriptions.py'),
+    (1, './02-subpub-topic-rewrite.py'),
     (1, './02-subscribe-dollar-v5.py'),
     (1, './02-subscribe-invalid-utf8.py'),
     (1, './02-subscribe-long-topic.py'),
@@ -74,6 +76,9 @@ tests = [
     (1, './03-publish-qos1-max-inflight-expire.py'),
     (1, './03-publish-qos1-max-inflight.py'),
     (1, './03-publish-qos1-no-subscribers-v5.py'),
+    (2, './03-publish-qos1-queue-conflate.py'),
+    (1, './03-publish-qos1-queue-spillover.py'),
+    (1, './03-publish-qos1-queue-spillover-error.py'),
     (1, './03-publish-qos1-retain-disabled.py'),
     (1, './03-publish-qos1.py'),
     (1, './03-publish-qos2-dup.py'),
@@ -159,6 +164,9 @@ tests = [
     (1, './09-acl-access-variants.py'),
     (1, './09-acl-change.py'),
     (1, './09-acl-empty-file.py'),
+    (1, './09-acl-queued-recheck.py'),
+    (1, './09-acl-read-cache.py'),
+    (1, './09-acl-subscribe.py'),
     (1, './09-auth-bad-method.py'),
     (1, './09-extended-auth-change-username.py'),
     (1, './09-extended-auth-multistep-reauth.py'),
@@ -189,24 +197,33 @@ tests = [
     (1, './09-plugin-change-id.py'),
     (1, './09-plugin-evt-client-offline.py'),
     (1, './09-plugin-evt-message-in.py'),
+    (1, './09-plugin-evt-message-in-batch.py'),
     (1, './09-plugin-evt-message-out.py'),
+    (2, './09-plugin-evt-message-out-shared.py'),
     (1, './09-plugin-evt-psk-key.py'),
     (1, './09-plugin-evt-reload.py'),
     (1, './09-plugin-evt-subscribe.py'),
     (1, './09-plugin-evt-tick.py'),
+    (1, './09-plugin-evt-topic-filter.py'),
     (1, './09-plugin-evt-unsubscribe.py'),
     (1, './09-plugin-delayed-auth.py'),
+    (1, './09-plugin-job.py'),
     (2, './09-plugin-load-acl.py'),
     (3, './09-plugin-load-basic-auth.py'),
     (2, './09-plugin-load-extended-auth.py'),
     (1, './09-plugin-publish.py'),
+    (1, './09-plugin-publish-thread.py'),
     (1, './09-plugin-unsupported.py'),
+    (1, './09-pwfile-cache.py'),
     (1, './09-pwfile-parse-invalid.py'),
+    (1, './09-pwfile-verify-threads.py'),
 
     (2, './10-listener-mount-point.py'),
 
     (1, './11-message-expiry.py'),
     (1, './11-persistence-autosave-changes.py'),
+    (1, './11-persistent-incremental-retain.py'),
+    (1, './11-persistent-lazy-queue.py'),
     (1, './11-persistent-subscription.py'),
     (1, './11-persistent-subscription-no-local.py'),
     (1, './11-pub-props.py'),
@@ -224,19 +241,24 @@ tests = [
 
     (1, './13-websocket-bad-origin.py'),
 
+    (1, './14-dynsec-acl-cache.py'),
+    (1, './14-dynsec-acl-priority.py'),
     (1, './14-dynsec-acl.py'),
     (1, './14-dynsec-allow-wildcard.py'),
     (1, './14-dynsec-anon-group.py'),
     (1, './14-dynsec-auth.py'),
+    (1, './14-dynsec-bulk.py'),
     (1, './14-dynsec-client-invalid.py'),
     (1, './14-dynsec-client.py'),
     (1, './14-dynsec-config-init-env.py'),
     (1, './14-dynsec-config-init-file.py'),
     (1, './14-dynsec-config-init-random.py'),
+    (1, './14-dynsec-config-load.py'),
     (1, './14-dynsec-default-access.py'),
     (1, './14-dynsec-disable-client.py'),
     (1, './14-dynsec-group-invalid.py'),
     (1, './14-dynsec-group.py'),
+    (1, './14-dynsec-journal.py'),
     (1, './14-dynsec-modify-client.py'),
     (1, './14-dynsec-modify-group.py'),
     (1, './14-dynsec-modify-role.py'),
@@ -273,9 +295,11 @@ tests = [
     (4, './17-control-list-listeners.py'),
     (1, './17-control-list-plugins.py'),
     (1, './17-control-missing-endpoint.py'),
+    (1, './17-control-plugin-stats.py'),
 
     (1, './20-sparkplug-compliance.py'),
     (1, './20-sparkplug-aware.py'),
+    (1, './20-shm-tap.py'),
 
     (1, './21-proxy-bad-version.py'),
     (1, './21-proxy-v1-bad.py'),
@@ -182,6 +182,11 @@ struct mosquitto__subhier *sub__add_hier_entry(struct mosquitto__subhier *parent
 	return NULL;
 }
 
+void sub__leaf_free(struct mosquitto__subleaf **leaf)
+{
+	UNUSED(leaf);
+}
+
 
 void plugin_persist__handle_client_msg_add(struct mosquitto *context, const struct mosquitto__client_msg *cmsg)
 {
@@ -217,6 +222,28 @@ void plugin_persist__handle_base_msg_delete(struct mosquitto__base_msg *msg)
 }
 
 
+int plugin__handle_message_out_shared(struct mosquitto *context, struct mosquitto__base_msg *base_msg, struct mosquitto__message_out *local, const struct mosquitto_base_msg **msg_out)
+{
+	UNUSED(context);
+	UNUSED(local);
+
+	*msg_out = &base_msg->data;
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+void plugin__message_out_cleanup(struct mosquitto__message_out *out)
+{
+	UNUSED(out);
+}
+
+
+void plugin__message_out_free(struct mosquitto__base_msg *base_msg)
+{
+	UNUSED(base_msg);
+}
+
+
 void plugin_persist__handle_subscription_delete(struct mosquitto *context, char *sub)
 {
 	UNUSED(context);
@@ -302,3 +329,20 @@ int sub__init(void)
 {
 	return MOSQ_ERR_SUCCESS;
 }
+
+
+void persist__retain_log_compact_next(void)
+{
+}
+
+
+void persist__retain_log_restored(unsigned long records, unsigned long live)
+{
+	UNUSED(records); UNUSED(live);
+}
+
+
+void loop__update_next_event(time_t new_ms)
+{
+	UNUSED(new_ms);
+}
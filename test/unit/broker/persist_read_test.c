@@ -38,6 +38,7 @@ static void test_cleanup(void)
 		db__messages_delete(ctxt, true);
 		mosquitto_free(ctxt);
 	}
+	persist__lazy_close();
 	db__close();
 }
 
@@ -785,6 +786,127 @@ static void TEST_v6_client_message_props(void)
 }
 
 
+static void TEST_v7_client_message_props(void)
+{
+	struct mosquitto__config config;
+	struct mosquitto *context;
+	int rc;
+
+	memset(&db, 0, sizeof(struct mosquitto_db));
+	memset(&config, 0, sizeof(struct mosquitto__config));
+	db.config = &config;
+
+	config.persistence = true;
+	char persistence_filepath[4096];
+	cat_sourcedir_with_relpath(persistence_filepath, "/files/persist_read/v7-client-message-props.test-db");
+	config.persistence_filepath = persistence_filepath;
+
+	rc = persist__restore();
+	CU_ASSERT_EQUAL(rc, MOSQ_ERR_SUCCESS);
+
+	CU_ASSERT_PTR_NOT_NULL(db.contexts_by_id);
+	HASH_FIND(hh_id, db.contexts_by_id, "client-id", strlen("client-id"), context);
+	CU_ASSERT_PTR_NOT_NULL(context);
+	if(context){
+		CU_ASSERT_PTR_NOT_NULL(context->msgs_out.inflight);
+		if(context->msgs_out.inflight){
+			CU_ASSERT_PTR_NULL(context->msgs_out.inflight->next);
+			CU_ASSERT_PTR_NOT_NULL(context->msgs_out.inflight->base_msg);
+			if(context->msgs_out.inflight->base_msg){
+				CU_ASSERT_EQUAL(context->msgs_out.inflight->base_msg->ref_count, 1);
+				CU_ASSERT_STRING_EQUAL(context->msgs_out.inflight->base_msg->data.source_id, "source_id");
+				CU_ASSERT_EQUAL(context->msgs_out.inflight->base_msg->data.source_mid, 2);
+				CU_ASSERT_EQUAL(context->msgs_out.inflight->base_msg->data.qos, 2);
+				CU_ASSERT_EQUAL(context->msgs_out.inflight->base_msg->data.retain, 1);
+				CU_ASSERT_STRING_EQUAL(context->msgs_out.inflight->base_msg->data.topic, "topic");
+				CU_ASSERT_EQUAL(context->msgs_out.inflight->base_msg->data.payloadlen, 7);
+				if(context->msgs_out.inflight->base_msg->data.payloadlen == 7){
+					CU_ASSERT_NSTRING_EQUAL(context->msgs_out.inflight->base_msg->data.payload, "payload", 7);
+				}
+			}
+			CU_ASSERT_EQUAL(context->msgs_out.inflight->data.mid, 0x73);
+			CU_ASSERT_EQUAL(context->msgs_out.inflight->data.qos, 1);
+			CU_ASSERT_EQUAL(context->msgs_out.inflight->data.retain, 0);
+			CU_ASSERT_EQUAL(context->msgs_out.inflight->data.direction, mosq_md_out);
+			CU_ASSERT_EQUAL(context->msgs_out.inflight->data.state, mosq_ms_wait_for_puback);
+			CU_ASSERT_EQUAL(context->msgs_out.inflight->data.dup, 0);
+			CU_ASSERT_EQUAL(context->msgs_out.inflight->data.subscription_identifier, 1);
+		}
+	}
+	test_cleanup();
+}
+
+
+static void TEST_v7_lazy_client_message(void)
+{
+	struct mosquitto__config config;
+	struct mosquitto *context;
+	int rc;
+
+	memset(&db, 0, sizeof(struct mosquitto_db));
+	memset(&config, 0, sizeof(struct mosquitto__config));
+	db.config = &config;
+
+	config.persistence = true;
+	config.persistence_lazy_queues = true;
+	char persistence_filepath[4096];
+	cat_sourcedir_with_relpath(persistence_filepath, "/files/persist_read/v7-client-message-props.test-db");
+	config.persistence_filepath = persistence_filepath;
+
+	rc = persist__restore();
+	CU_ASSERT_EQUAL(rc, MOSQ_ERR_SUCCESS);
+
+	HASH_FIND(hh_id, db.contexts_by_id, "client-id", strlen("client-id"), context);
+	CU_ASSERT_PTR_NOT_NULL(context);
+	if(context){
+		/* Queue left on disk until asked for */
+		CU_ASSERT_PTR_NULL(context->msgs_out.inflight);
+		CU_ASSERT_EQUAL(context->lazy_queue_first, 0);
+		CU_ASSERT_EQUAL(context->lazy_queue_count, 1);
+
+		rc = persist__lazy_queue_load(context);
+		CU_ASSERT_EQUAL(rc, MOSQ_ERR_SUCCESS);
+		CU_ASSERT_EQUAL(context->lazy_queue_count, 0);
+		CU_ASSERT_EQUAL(context->msgs_out.inflight_count, 1);
+		CU_ASSERT_PTR_NOT_NULL(context->msgs_out.inflight);
+		if(context->msgs_out.inflight){
+			CU_ASSERT_PTR_NULL(context->msgs_out.inflight->next);
+			CU_ASSERT_PTR_NOT_NULL(context->msgs_out.inflight->base_msg);
+			if(context->msgs_out.inflight->base_msg){
+				CU_ASSERT_STRING_EQUAL(context->msgs_out.inflight->base_msg->data.topic, "topic");
+				CU_ASSERT_EQUAL(context->msgs_out.inflight->base_msg->data.payloadlen, 7);
+				if(context->msgs_out.inflight->base_msg->data.payloadlen == 7){
+					CU_ASSERT_NSTRING_EQUAL(context->msgs_out.inflight->base_msg->data.payload, "payload", 7);
+				}
+			}
+			CU_ASSERT_EQUAL(context->msgs_out.inflight->data.mid, 0x73);
+			CU_ASSERT_EQUAL(context->msgs_out.inflight->data.state, mosq_ms_wait_for_puback);
+		}
+	}
+	CU_ASSERT_PTR_NULL(persist__lazy_file());
+	test_cleanup();
+}
+
+
+static void TEST_v7_bad_section(void)
+{
+	struct mosquitto__config config;
+	int rc;
+
+	memset(&db, 0, sizeof(struct mosquitto_db));
+	memset(&config, 0, sizeof(struct mosquitto__config));
+	db.config = &config;
+
+	config.persistence = true;
+	char persistence_filepath[4096];
+	cat_sourcedir_with_relpath(persistence_filepath, "/files/persist_read/v7-bad-section.test-db");
+	config.persistence_filepath = persistence_filepath;
+
+	rc = persist__restore();
+	CU_ASSERT_EQUAL(rc, MOSQ_ERR_INVAL);
+}
+
+
 static void TEST_v6_retain(void)
 {
 	struct mosquitto__config config;
@@ -937,6 +1059,9 @@ int init_persist_read_tests(void)
 			|| !CU_add_test(test_suite, "v6 retain", TEST_v6_retain)
 			|| !CU_add_test(test_suite, "v6 sub", TEST_v6_sub)
 			|| !CU_add_test(test_suite, "v6 base msg topic 0", TEST_v6_base_msg_topic_0)
+			|| !CU_add_test(test_suite, "v7 client message+props", TEST_v7_client_message_props)
+			|| !CU_add_test(test_suite, "v7 lazy client message", TEST_v7_lazy_client_message)
+			|| !CU_add_test(test_suite, "v7 bad section", TEST_v7_bad_section)
 			){
 
 		printf("Error adding persist CUnit tests.\n");
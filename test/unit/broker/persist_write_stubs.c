@@ -73,6 +73,14 @@ int mosquitto_acl_check(struct mosquitto *context, const char *topic, uint32_t p
 }
 
 
+bool acl__read_cacheable(struct mosquitto *context)
+{
+	UNUSED(context);
+
+	return false;
+}
+
+
 int acl__find_acls(struct mosquitto *context)
 {
 	UNUSED(context);
@@ -235,6 +243,28 @@ void plugin_persist__handle_base_msg_delete(struct mosquitto__base_msg *msg)
 }
 
 
+int plugin__handle_message_out_shared(struct mosquitto *context, struct mosquitto__base_msg *base_msg, struct mosquitto__message_out *local, const struct mosquitto_base_msg **msg_out)
+{
+	UNUSED(context);
+	UNUSED(local);
+
+	*msg_out = &base_msg->data;
+	return MOSQ_ERR_SUCCESS;
+}
+
+
+void plugin__message_out_cleanup(struct mosquitto__message_out *out)
+{
+	UNUSED(out);
+}
+
+
+void plugin__message_out_free(struct mosquitto__base_msg *base_msg)
+{
+	UNUSED(base_msg);
+}
+
+
 void plugin_persist__handle_retain_msg_set(struct mosquitto__base_msg *msg)
 {
 	UNUSED(msg);
@@ -341,3 +371,9 @@ void metrics__int_dec(enum mosq_metric_type m, int64_t value)
 	UNUSED(m); UNUSED(value);
 }
 #endif
+
+
+void loop__update_next_event(time_t new_ms)
+{
+	UNUSED(new_ms);
+}
@@ -37,6 +37,7 @@ static void test_cleanup(void)
 		mosquitto_free(ctxt);
 	}
 
+	persist__lazy_close();
 	db__close();
 }
 
@@ -105,6 +106,32 @@ static int file_diff(const char *one, const char *two)
 }
 
 
+/* Restore a file written by persist__backup() and write it out again, the
+ * result must be identical. */
+static void v7_roundtrip(struct mosquitto__config *config, const char *filename)
+{
+	char filename2[100];
+	int rc;
+
+	test_cleanup();
+	memset(&db, 0, sizeof(struct mosquitto_db));
+	db.config = config;
+
+	/* db__open() restores from persistence_filepath */
+	config->persistence_filepath = (char *)filename;
+	rc = db__open(config);
+	CU_ASSERT_EQUAL(rc, MOSQ_ERR_SUCCESS);
+
+	snprintf(filename2, sizeof(filename2), "%s.2", filename);
+	config->persistence_filepath = filename2;
+	rc = persist__backup(true);
+	CU_ASSERT_EQUAL(rc, MOSQ_ERR_SUCCESS);
+
+	CU_ASSERT_EQUAL(0, file_diff(filename, filename2));
+	unlink(filename2);
+}
+
+
 static void TEST_persistence_disabled(void)
 {
 	struct mosquitto__config config;
@@ -165,12 +192,14 @@ static void TEST_v6_config_ok(void)
 	rc = persist__restore();
 	CU_ASSERT_EQUAL(rc, MOSQ_ERR_SUCCESS);
 
-	config.persistence_filepath = "v6-cfg.db";
+	config.persistence_filepath = "v7-cfg.db";
 	rc = persist__backup(true);
 	CU_ASSERT_EQUAL(rc, MOSQ_ERR_SUCCESS);
 
-	CU_ASSERT_EQUAL(0, file_diff(persistence_filepath, "v6-cfg.db"));
-	unlink("v6-cfg.db");
+	cat_sourcedir_with_relpath(persistence_filepath, "/files/persist_write/v7-cfg.test-db");
+	CU_ASSERT_EQUAL(0, file_diff(persistence_filepath, "v7-cfg.db"));
+	v7_roundtrip(&config, "v7-cfg.db");
+	unlink("v7-cfg.db");
 
 	test_cleanup();
 }
@@ -192,14 +221,15 @@ static void TEST_v6_message_store_no_ref(void)
 	rc = persist__restore();
 	CU_ASSERT_EQUAL(rc, MOSQ_ERR_SUCCESS);
 
-	config.persistence_filepath = "v6-message-store-no-ref.db";
+	config.persistence_filepath = "v7-message-store-no-ref.db";
 	rc = persist__backup(true);
 	CU_ASSERT_EQUAL(rc, MOSQ_ERR_SUCCESS);
 
 	char persistence_filepath_no_ref[4096];
-	cat_sourcedir_with_relpath(persistence_filepath_no_ref, "/files/persist_write/v6-message-store-no-ref.test-db");
-	CU_ASSERT_EQUAL(0, file_diff(persistence_filepath_no_ref, "v6-message-store-no-ref.db"));
-	unlink("v6-message-store-no-ref.db");
+	cat_sourcedir_with_relpath(persistence_filepath_no_ref, "/files/persist_write/v7-message-store-no-ref.test-db");
+	CU_ASSERT_EQUAL(0, file_diff(persistence_filepath_no_ref, "v7-message-store-no-ref.db"));
+	v7_roundtrip(&config, "v7-message-store-no-ref.db");
+	unlink("v7-message-store-no-ref.db");
 
 	test_cleanup();
 }
@@ -227,12 +257,14 @@ static void TEST_v6_message_store_props(void)
 	rc = persist__restore();
 	CU_ASSERT_EQUAL(rc, MOSQ_ERR_SUCCESS);
 
-	config.persistence_filepath = "v6-message-store-props.db";
+	config.persistence_filepath = "v7-message-store-props.db";
 	rc = persist__backup(true);
 	CU_ASSERT_EQUAL(rc, MOSQ_ERR_SUCCESS);
 
-	CU_ASSERT_EQUAL(0, file_diff(persistence_filepath, "v6-message-store-props.db"));
-	unlink("v6-message-store-props.db");
+	cat_sourcedir_with_relpath(persistence_filepath, "/files/persist_write/v7-message-store-props.test-db");
+	CU_ASSERT_EQUAL(0, file_diff(persistence_filepath, "v7-message-store-props.db"));
+	v7_roundtrip(&config, "v7-message-store-props.db");
+	unlink("v7-message-store-props.db");
 
 	test_cleanup();
 }
@@ -260,12 +292,14 @@ static void TEST_v6_client(void)
 	rc = persist__restore();
 	CU_ASSERT_EQUAL(rc, MOSQ_ERR_SUCCESS);
 
-	config.persistence_filepath = "v6-client.db";
+	config.persistence_filepath = "v7-client.db";
 	rc = persist__backup(true);
 	CU_ASSERT_EQUAL(rc, MOSQ_ERR_SUCCESS);
 
-	CU_ASSERT_EQUAL(0, file_diff(persistence_filepath, "v6-client.db"));
-	unlink("v6-client.db");
+	cat_sourcedir_with_relpath(persistence_filepath, "/files/persist_write/v7-client.test-db");
+	CU_ASSERT_EQUAL(0, file_diff(persistence_filepath, "v7-client.db"));
+	v7_roundtrip(&config, "v7-client.db");
+	unlink("v7-client.db");
 
 	test_cleanup();
 }
@@ -293,12 +327,76 @@ static void TEST_v6_client_message(void)
 	rc = persist__restore();
 	CU_ASSERT_EQUAL(rc, MOSQ_ERR_SUCCESS);
 
-	config.persistence_filepath = "v6-client-message.db";
+	config.persistence_filepath = "v7-client-message.db";
+	rc = persist__backup(true);
+	CU_ASSERT_EQUAL(rc, MOSQ_ERR_SUCCESS);
+
+	cat_sourcedir_with_relpath(persistence_filepath, "/files/persist_write/v7-client-message.test-db");
+	CU_ASSERT_EQUAL(0, file_diff(persistence_filepath, "v7-client-message.db"));
+	v7_roundtrip(&config, "v7-client-message.db");
+	unlink("v7-client-message.db");
+
+	test_cleanup();
+}
+
+
+/* Queues left on disk by persistence_lazy_queues must be carried over to each
+ * new file. */
+static void TEST_v7_lazy_client_message(void)
+{
+	struct mosquitto__config config;
+	struct mosquitto__listener listener;
+	struct mosquitto *context;
+	int rc;
+
+	memset(&db, 0, sizeof(struct mosquitto_db));
+	memset(&config, 0, sizeof(struct mosquitto__config));
+	memset(&listener, 0, sizeof(struct mosquitto__listener));
+	db.config = &config;
+	listener.port = 1883;
+	config.per_listener_settings = true;
+	config.listeners = &listener;
+	config.listener_count = 1;
+
+	config.persistence = true;
+	config.persistence_lazy_queues = true;
+	char persistence_filepath[4096];
+	cat_sourcedir_with_relpath(persistence_filepath, "/files/persist_write/v7-client-message.test-db");
+	config.persistence_filepath = persistence_filepath;
+	rc = persist__restore();
+	CU_ASSERT_EQUAL(rc, MOSQ_ERR_SUCCESS);
+
+	HASH_FIND(hh_id, db.contexts_by_id, "client-id", strlen("client-id"), context);
+	CU_ASSERT_PTR_NOT_NULL(context);
+	if(context){
+		CU_ASSERT_EQUAL(context->lazy_queue_count, 1);
+	}
+
+	/* The second save copies from the file written by the first */
+	config.persistence_filepath = "v7-lazy-client-message.db";
+	rc = persist__backup(true);
+	CU_ASSERT_EQUAL(rc, MOSQ_ERR_SUCCESS);
+	config.persistence_filepath = "v7-lazy-client-message.db.2";
+	rc = persist__backup(true);
+	CU_ASSERT_EQUAL(rc, MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(0, file_diff("v7-lazy-client-message.db", "v7-lazy-client-message.db.2"));
+	CU_ASSERT_PTR_NOT_NULL(persist__lazy_file());
+
+	/* Restoring the lazily written file in full gives the original */
+	test_cleanup();
+	memset(&db, 0, sizeof(struct mosquitto_db));
+	db.config = &config;
+	config.persistence_lazy_queues = false;
+	config.persistence_filepath = "v7-lazy-client-message.db.2";
+	rc = persist__restore();
+	CU_ASSERT_EQUAL(rc, MOSQ_ERR_SUCCESS);
+	config.persistence_filepath = "v7-lazy-client-message.db";
 	rc = persist__backup(true);
 	CU_ASSERT_EQUAL(rc, MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(0, file_diff(persistence_filepath, "v7-lazy-client-message.db"));
 
-	CU_ASSERT_EQUAL(0, file_diff(persistence_filepath, "v6-client-message.db"));
-	unlink("v6-client-message.db");
+	unlink("v7-lazy-client-message.db");
+	unlink("v7-lazy-client-message.db.2");
 
 	test_cleanup();
 }
@@ -334,12 +432,14 @@ static void TEST_v6_client_message_props(void)
 		}
 	}
 
-	config.persistence_filepath = "v6-client-message-props.db";
+	config.persistence_filepath = "v7-client-message-props.db";
 	rc = persist__backup(true);
 	CU_ASSERT_EQUAL(rc, MOSQ_ERR_SUCCESS);
 
-	CU_ASSERT_EQUAL(0, file_diff(persistence_filepath, "v6-client-message-props.db"));
-	//unlink("v6-client-message-props.db");
+	cat_sourcedir_with_relpath(persistence_filepath, "/files/persist_write/v7-client-message-props.test-db");
+	CU_ASSERT_EQUAL(0, file_diff(persistence_filepath, "v7-client-message-props.db"));
+	v7_roundtrip(&config, "v7-client-message-props.db");
+	unlink("v7-client-message-props.db");
 
 	test_cleanup();
 }
@@ -369,12 +469,14 @@ static void TEST_v6_sub(void)
 	rc = persist__restore();
 	CU_ASSERT_EQUAL(rc, MOSQ_ERR_SUCCESS);
 
-	config.persistence_filepath = "v6-sub.db";
+	config.persistence_filepath = "v7-sub.db";
 	rc = persist__backup(true);
 	CU_ASSERT_EQUAL(rc, MOSQ_ERR_SUCCESS);
 
-	CU_ASSERT_EQUAL(0, file_diff(persistence_filepath, "v6-sub.db"));
-	unlink("v6-sub.db");
+	cat_sourcedir_with_relpath(persistence_filepath, "/files/persist_write/v7-sub.test-db");
+	CU_ASSERT_EQUAL(0, file_diff(persistence_filepath, "v7-sub.db"));
+	v7_roundtrip(&config, "v7-sub.db");
+	unlink("v7-sub.db");
 
 	test_cleanup();
 }
@@ -448,6 +550,7 @@ int main(int argc, char *argv[])
 			|| !CU_add_test(test_suite, "v6 client", TEST_v6_client)
 			|| !CU_add_test(test_suite, "v6 client message", TEST_v6_client_message)
 			|| !CU_add_test(test_suite, "v6 client message+props", TEST_v6_client_message_props)
+			|| !CU_add_test(test_suite, "v7 lazy client message", TEST_v7_lazy_client_message)
 			|| !CU_add_test(test_suite, "v6 sub", TEST_v6_sub)
 	        //|| !CU_add_test(test_suite, "v5 full", TEST_v5_full)
 			){
@@ -0,0 +1,164 @@
+#include "config.h"
+#include <stdio.h>
+
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+
+#include "mosquitto_broker_internal.h"
+
+
+static void match_helper(const char *topic_filter, const char *payload, bool expected)
+{
+	struct sub__filter *filter = NULL;
+	struct mosquitto__base_msg base_msg;
+	int rc;
+
+	rc = sub_filter__compile(topic_filter, &filter);
+	CU_ASSERT_EQUAL(rc, MOSQ_ERR_SUCCESS);
+	CU_ASSERT_PTR_NOT_NULL(filter);
+	if(filter == NULL){
+		return;
+	}
+
+	memset(&base_msg, 0, sizeof(base_msg));
+	base_msg.data.payload = mosquitto_strdup(payload);
+	base_msg.data.payloadlen = (uint32_t)strlen(payload);
+
+	CU_ASSERT_EQUAL(sub_filter__match(filter, &base_msg), expected);
+	if(sub_filter__match(filter, &base_msg) != expected){
+		printf("%s : %s\n", topic_filter, payload);
+	}
+	sub_filter__payload_release();
+
+	mosquitto_free(base_msg.data.payload);
+	sub_filter__free(&filter);
+}
+
+
+static void TEST_topic(void)
+{
+	CU_ASSERT_STRING_EQUAL(sub_filter__topic("a/b"), "a/b");
+	CU_ASSERT_STRING_EQUAL(sub_filter__topic("$filter/x>1/a/b"), "a/b");
+	CU_ASSERT_STRING_EQUAL(sub_filter__topic("$filter/x/#"), "#");
+	CU_ASSERT_PTR_NULL(sub_filter__topic("$filter/"));
+	CU_ASSERT_PTR_NULL(sub_filter__topic("$filter/x"));
+	CU_ASSERT_PTR_NULL(sub_filter__topic("$filter/x/"));
+	CU_ASSERT_PTR_NULL(sub_filter__topic("$filter//a"));
+}
+
+
+static void TEST_compile_valid(void)
+{
+	struct sub__filter *filter = NULL;
+
+	CU_ASSERT_EQUAL(sub_filter__compile("a/b", &filter), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_PTR_NULL(filter);
+
+	CU_ASSERT_EQUAL(sub_filter__check("$filter/x/a"), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(sub_filter__check("$filter/!x/a"), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(sub_filter__check("$filter/x.y.0 == 'z'/a"), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(sub_filter__check("$filter/ (x<1 || x>=2.5e3) && y!=null /a"), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(sub_filter__check("$filter/x==true&&y==false/a"), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(sub_filter__check("$filter/x==-1/a"), MOSQ_ERR_SUCCESS);
+}
+
+
+static void TEST_compile_invalid(void)
+{
+	CU_ASSERT_EQUAL(sub_filter__check("$filter/x/"), MOSQ_ERR_INVAL);
+	CU_ASSERT_EQUAL(sub_filter__check("$filter//a"), MOSQ_ERR_INVAL);
+	CU_ASSERT_EQUAL(sub_filter__check("$filter/x>/a"), MOSQ_ERR_INVAL);
+	CU_ASSERT_EQUAL(sub_filter__check("$filter/x=1/a"), MOSQ_ERR_INVAL);
+	CU_ASSERT_EQUAL(sub_filter__check("$filter/x==y/a"), MOSQ_ERR_INVAL);
+	CU_ASSERT_EQUAL(sub_filter__check("$filter/x==1 y/a"), MOSQ_ERR_INVAL);
+	CU_ASSERT_EQUAL(sub_filter__check("$filter/(x/a"), MOSQ_ERR_INVAL);
+	CU_ASSERT_EQUAL(sub_filter__check("$filter/x)/a"), MOSQ_ERR_INVAL);
+	CU_ASSERT_EQUAL(sub_filter__check("$filter/x=='a/a"), MOSQ_ERR_INVAL);
+	CU_ASSERT_EQUAL(sub_filter__check("$filter/x.==1/a"), MOSQ_ERR_INVAL);
+	CU_ASSERT_EQUAL(sub_filter__check("$filter/x&&/a"), MOSQ_ERR_INVAL);
+	CU_ASSERT_EQUAL(sub_filter__check("$filter/x/$share/g/a"), MOSQ_ERR_INVAL);
+	CU_ASSERT_EQUAL(sub_filter__check("$filter/((((((((((((((((((((((((((((((((((x))))))))))))))))))))))))))))))))))/a"), MOSQ_ERR_INVAL);
+}
+
+
+static void TEST_match(void)
+{
+	match_helper("$filter/temp>20/a", "{\"temp\":21}", true);
+	match_helper("$filter/temp>20/a", "{\"temp\":20}", false);
+	match_helper("$filter/temp>=20/a", "{\"temp\":20}", true);
+	match_helper("$filter/temp<20/a", "{\"temp\":\"10\"}", false);
+	match_helper("$filter/temp!=20/a", "{}", false);
+	match_helper("$filter/unit=='C'/a", "{\"unit\":\"C\"}", true);
+	match_helper("$filter/unit==\"C\"/a", "{\"unit\":\"F\"}", false);
+	match_helper("$filter/unit!='C'/a", "{\"unit\":\"F\"}", true);
+	match_helper("$filter/a.b.1==2/a", "{\"a\":{\"b\":[1,2]}}", true);
+	match_helper("$filter/a.b.2==2/a", "{\"a\":{\"b\":[1,2]}}", false);
+	match_helper("$filter/ok/a", "{\"ok\":0}", true);
+	match_helper("$filter/ok/a", "{\"ok\":false}", false);
+	match_helper("$filter/ok/a", "{\"ok\":null}", false);
+	match_helper("$filter/ok==null/a", "{\"ok\":null}", true);
+	match_helper("$filter/!ok/a", "{}", true);
+	match_helper("$filter/x==1 || y==2 && z==3/a", "{\"x\":1}", true);
+	match_helper("$filter/x==1 || y==2 && z==3/a", "{\"y\":2}", false);
+	match_helper("$filter/(x==1 || y==2) && z==3/a", "{\"y\":2,\"z\":3}", true);
+	match_helper("$filter/x/a", "not json", false);
+	match_helper("$filter/x/a", "", false);
+}
+
+
+/* ========================================================================
+ * TEST SUITE SETUP
+ * ======================================================================== */
+
+int init_sub_filter_tests(void)
+{
+	CU_pSuite test_suite = NULL;
+
+	test_suite = CU_add_suite("Subscription payload filter", NULL, NULL);
+	if(!test_suite){
+		printf("Error adding CUnit Subscription payload filter test suite.\n");
+		return 1;
+	}
+
+	if(0
+			|| !CU_add_test(test_suite, "Topic", TEST_topic)
+			|| !CU_add_test(test_suite, "Compile valid", TEST_compile_valid)
+			|| !CU_add_test(test_suite, "Compile invalid", TEST_compile_invalid)
+			|| !CU_add_test(test_suite, "Match", TEST_match)
+			){
+
+		printf("Error adding Subscription payload filter CUnit tests.\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+	unsigned int fails;
+
+	UNUSED(argc);
+	UNUSED(argv);
+
+	if(CU_initialize_registry() != CUE_SUCCESS){
+		printf("Error initializing CUnit registry.\n");
+		return 1;
+	}
+
+	if(0
+			|| init_sub_filter_tests()
+			){
+
+		CU_cleanup_registry();
+		return 1;
+	}
+
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+	CU_basic_run_tests();
+	fails = CU_get_number_of_failures();
+	CU_cleanup_registry();
+
+	return (int)fails;
+}
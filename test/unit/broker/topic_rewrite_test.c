@@ -0,0 +1,183 @@
+#include "config.h"
+#include <stdio.h>
+
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+
+#include "mosquitto_broker_internal.h"
+
+
+static void rewrite_helper(struct topic_rewrite__node *root, const char *clientid, const char *username,
+		const char *incoming, const char *expected)
+{
+	char *topic;
+	char *orig;
+	int rc;
+
+	topic = mosquitto_strdup(incoming);
+	CU_ASSERT_PTR_NOT_NULL(topic);
+	if(topic == NULL){
+		return;
+	}
+	orig = topic;
+
+	rc = topic_rewrite__apply(root, clientid, username, &topic);
+	CU_ASSERT_EQUAL(rc, MOSQ_ERR_SUCCESS);
+	CU_ASSERT_STRING_EQUAL(topic, expected);
+	if(!strcmp(incoming, expected)){
+		/* No rule fired, so the topic must not have been reallocated */
+		CU_ASSERT_PTR_EQUAL(topic, orig);
+	}
+	mosquitto_free(topic);
+}
+
+
+static void TEST_no_rules(void)
+{
+	rewrite_helper(NULL, "id", NULL, "a/b/c", "a/b/c");
+}
+
+
+static void TEST_rewrite_valid(void)
+{
+	struct topic_rewrite__node *root = NULL;
+
+	/* Equivalents of the topic-modification, topic-hierarchy-flatten and
+	 * topic-jail example plugins */
+	CU_ASSERT_EQUAL(topic_rewrite__add(&root, "device/+/data/uplink", "device/%1/data"), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(topic_rewrite__add(&root, "my/+/topics", "the/single/output/topic"), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(topic_rewrite__add(&root, "jail/#", "%c/%1"), MOSQ_ERR_SUCCESS);
+
+	CU_ASSERT_EQUAL(topic_rewrite__add(&root, "a/+/c", "plus/%1"), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(topic_rewrite__add(&root, "a/b/c", "exact"), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(topic_rewrite__add(&root, "a/#", "hash/%1"), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(topic_rewrite__add(&root, "+/+/x/#", "%3/%2/%1"), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(topic_rewrite__add(&root, "user/+", "users/%u/%1/100%%"), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(topic_rewrite__add(&root, "pct/+", "literal/%%u/%1"), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(topic_rewrite__add(&root, "#", "all/%1"), MOSQ_ERR_SUCCESS);
+
+	rewrite_helper(root, "id", NULL, "device/0001/data/uplink", "device/0001/data");
+	rewrite_helper(root, "id", NULL, "my/first/topics", "the/single/output/topic");
+	rewrite_helper(root, "jailed1", NULL, "jail/some/topic", "jailed1/some/topic");
+
+	/* Exact is preferred over +, which is preferred over # */
+	rewrite_helper(root, "id", NULL, "a/b/c", "exact");
+	rewrite_helper(root, "id", NULL, "a/z/c", "plus/z");
+	rewrite_helper(root, "id", NULL, "a/z/d", "hash/z/d");
+	rewrite_helper(root, "id", NULL, "a", "hash");
+	rewrite_helper(root, "id", NULL, "a/", "hash/");
+
+	rewrite_helper(root, "id", NULL, "p/q/x/r/s", "r/s/q/p");
+	rewrite_helper(root, "id", "bob", "user/x", "users/bob/x/100%");
+	rewrite_helper(root, "id", NULL, "other/topic", "all/other/topic");
+
+	/* Needs a username, so doesn't fire */
+	rewrite_helper(root, "id", NULL, "user/x", "user/x");
+
+	/* An escaped %%u is a literal, so still fires without a username */
+	rewrite_helper(root, "id", NULL, "pct/x", "literal/%u/x");
+
+	/* Wildcards don't match $ topics */
+	rewrite_helper(root, "id", NULL, "$SYS/broker", "$SYS/broker");
+
+	topic_rewrite__cleanup(&root);
+	CU_ASSERT_PTR_NULL(root);
+}
+
+
+static void TEST_rewrite_invalid_result(void)
+{
+	struct topic_rewrite__node *root = NULL;
+	char *topic;
+	int rc;
+
+	CU_ASSERT_EQUAL(topic_rewrite__add(&root, "jail/#", "%c/%1"), MOSQ_ERR_SUCCESS);
+
+	topic = mosquitto_strdup("jail/topic");
+	rc = topic_rewrite__apply(root, "bad+id", NULL, &topic);
+	CU_ASSERT_EQUAL(rc, MOSQ_ERR_INVAL);
+	CU_ASSERT_STRING_EQUAL(topic, "jail/topic");
+	mosquitto_free(topic);
+
+	topic_rewrite__cleanup(&root);
+}
+
+
+static void TEST_add_invalid(void)
+{
+	struct topic_rewrite__node *root = NULL;
+
+	CU_ASSERT_EQUAL(topic_rewrite__add(&root, "a/#/b", "x"), MOSQ_ERR_INVAL);
+	CU_ASSERT_EQUAL(topic_rewrite__add(&root, "a/b+", "x"), MOSQ_ERR_INVAL);
+	CU_ASSERT_EQUAL(topic_rewrite__add(&root, "$share/group/a", "x"), MOSQ_ERR_INVAL);
+	CU_ASSERT_EQUAL(topic_rewrite__add(&root, "a/+", "x/+"), MOSQ_ERR_INVAL);
+	CU_ASSERT_EQUAL(topic_rewrite__add(&root, "a/+", "x/#"), MOSQ_ERR_INVAL);
+	CU_ASSERT_EQUAL(topic_rewrite__add(&root, "a/+", "x/%2"), MOSQ_ERR_INVAL);
+	CU_ASSERT_EQUAL(topic_rewrite__add(&root, "a/+", "x/%x"), MOSQ_ERR_INVAL);
+	CU_ASSERT_EQUAL(topic_rewrite__add(&root, "a/+", "x/%"), MOSQ_ERR_INVAL);
+	CU_ASSERT_EQUAL(topic_rewrite__add(&root, "a/+", ""), MOSQ_ERR_INVAL);
+	CU_ASSERT_EQUAL(topic_rewrite__add(&root, "+/+/+/+/+/+/+/+/+/+", "x"), MOSQ_ERR_INVAL);
+
+	CU_ASSERT_EQUAL(topic_rewrite__add(&root, "a/+", "x/%1"), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(topic_rewrite__add(&root, "a/+", "y/%1"), MOSQ_ERR_ALREADY_EXISTS);
+
+	topic_rewrite__cleanup(&root);
+}
+
+
+/* ========================================================================
+ * TEST SUITE SETUP
+ * ======================================================================== */
+
+int init_topic_rewrite_tests(void)
+{
+	CU_pSuite test_suite = NULL;
+
+	test_suite = CU_add_suite("Topic rewrite", NULL, NULL);
+	if(!test_suite){
+		printf("Error adding CUnit Topic rewrite test suite.\n");
+		return 1;
+	}
+
+	if(0
+			|| !CU_add_test(test_suite, "No rules", TEST_no_rules)
+			|| !CU_add_test(test_suite, "Rewrite valid", TEST_rewrite_valid)
+			|| !CU_add_test(test_suite, "Rewrite invalid result", TEST_rewrite_invalid_result)
+			|| !CU_add_test(test_suite, "Add invalid", TEST_add_invalid)
+			){
+
+		printf("Error adding Topic rewrite CUnit tests.\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+	unsigned int fails;
+
+	UNUSED(argc);
+	UNUSED(argv);
+
+	if(CU_initialize_registry() != CUE_SUCCESS){
+		printf("Error initializing CUnit registry.\n");
+		return 1;
+	}
+
+	if(0
+			|| init_topic_rewrite_tests()
+			){
+
+		CU_cleanup_registry();
+		return 1;
+	}
+
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+	CU_basic_run_tests();
+	fails = CU_get_number_of_failures();
+	CU_cleanup_registry();
+
+	return (int)fails;
+}
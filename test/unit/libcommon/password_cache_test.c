@@ -0,0 +1,143 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+
+#include "mosquitto.h"
+
+#ifdef WITH_TLS
+
+
+static struct mosquitto_pw *new_pw(const char *password)
+{
+	struct mosquitto_pw *pw = NULL;
+
+	CU_ASSERT_EQUAL(mosquitto_pw_new(&pw, MOSQ_PW_SHA512), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(mosquitto_pw_hash_encoded(pw, password), MOSQ_ERR_SUCCESS);
+	return pw;
+}
+
+
+static void TEST_disabled(void)
+{
+	struct mosquitto_pw *pw = new_pw("password");
+
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_init(0, 60), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_add("user", pw, "password"), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_check("user", pw, "password"), MOSQ_ERR_NOT_FOUND);
+
+	mosquitto_pw_cache_cleanup();
+	mosquitto_pw_cleanup(pw);
+}
+
+
+static void TEST_hit_and_miss(void)
+{
+	struct mosquitto_pw *pw = new_pw("password");
+
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_init(10, 60), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_check("user", pw, "password"), MOSQ_ERR_NOT_FOUND);
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_add("user", pw, "password"), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_check("user", pw, "password"), MOSQ_ERR_SUCCESS);
+
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_check("user", pw, "passwore"), MOSQ_ERR_NOT_FOUND);
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_check("user", pw, "passwor"), MOSQ_ERR_NOT_FOUND);
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_check("usex", pw, "password"), MOSQ_ERR_NOT_FOUND);
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_check(NULL, pw, "password"), MOSQ_ERR_NOT_FOUND);
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_check("user", NULL, "password"), MOSQ_ERR_NOT_FOUND);
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_check("user", pw, NULL), MOSQ_ERR_NOT_FOUND);
+
+	mosquitto_pw_cache_cleanup();
+	mosquitto_pw_cleanup(pw);
+}
+
+
+static void TEST_password_changed(void)
+{
+	struct mosquitto_pw *pw1 = new_pw("password");
+	struct mosquitto_pw *pw2 = new_pw("password");
+
+	/* Same password, new salt, so the stored hash differs */
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_init(10, 60), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_add("user", pw1, "password"), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_check("user", pw1, "password"), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_check("user", pw2, "password"), MOSQ_ERR_NOT_FOUND);
+
+	mosquitto_pw_cache_cleanup();
+	mosquitto_pw_cleanup(pw1);
+	mosquitto_pw_cleanup(pw2);
+}
+
+
+static void TEST_clear(void)
+{
+	struct mosquitto_pw *pw = new_pw("password");
+
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_init(10, 60), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_add("user", pw, "password"), MOSQ_ERR_SUCCESS);
+	mosquitto_pw_cache_clear();
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_check("user", pw, "password"), MOSQ_ERR_NOT_FOUND);
+
+	/* Still enabled after a clear */
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_add("user", pw, "password"), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_check("user", pw, "password"), MOSQ_ERR_SUCCESS);
+
+	mosquitto_pw_cache_cleanup();
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_check("user", pw, "password"), MOSQ_ERR_NOT_FOUND);
+	mosquitto_pw_cleanup(pw);
+}
+
+
+static void TEST_lru_eviction(void)
+{
+	struct mosquitto_pw *pw = new_pw("password");
+
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_init(2, 60), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_add("user1", pw, "password"), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_add("user2", pw, "password"), MOSQ_ERR_SUCCESS);
+
+	/* user1 is now the most recently used, so user2 is evicted */
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_check("user1", pw, "password"), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_add("user3", pw, "password"), MOSQ_ERR_SUCCESS);
+
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_check("user1", pw, "password"), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_check("user2", pw, "password"), MOSQ_ERR_NOT_FOUND);
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_check("user3", pw, "password"), MOSQ_ERR_SUCCESS);
+
+	/* Adding an existing entry does not evict anything */
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_add("user3", pw, "password"), MOSQ_ERR_SUCCESS);
+	CU_ASSERT_EQUAL(mosquitto_pw_cache_check("user1", pw, "password"), MOSQ_ERR_SUCCESS);
+
+	mosquitto_pw_cache_cleanup();
+	mosquitto_pw_cleanup(pw);
+}
+
+
+/* ========================================================================
+ * TEST SUITE SETUP
+ * ======================================================================== */
+
+
+int init_password_cache_tests(void)
+{
+	CU_pSuite test_suite = NULL;
+
+	test_suite = CU_add_suite("Password cache", NULL, NULL);
+	if(!test_suite){
+		printf("Error adding CUnit password cache test suite.\n");
+		return 1;
+	}
+
+	if(0
+			|| !CU_add_test(test_suite, "Disabled", TEST_disabled)
+			|| !CU_add_test(test_suite, "Hit and miss", TEST_hit_and_miss)
+			|| !CU_add_test(test_suite, "Password changed", TEST_password_changed)
+			|| !CU_add_test(test_suite, "Clear", TEST_clear)
+			|| !CU_add_test(test_suite, "LRU eviction", TEST_lru_eviction)
+			){
+
+		printf("Error adding Password cache CUnit tests.\n");
+		return 1;
+	}
+
+	return 0;
+}
+#endif
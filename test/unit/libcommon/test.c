@@ -6,6 +6,7 @@
 
 int init_base64_tests(void);
 int init_file_tests(void);
+int init_password_cache_tests(void);
 int init_property_add_tests(void);
 int init_property_value_tests(void);
 int init_strings_tests(void);
@@ -29,6 +30,7 @@ int main(int argc, char *argv[])
 	if(0
 #ifdef WITH_TLS
 			|| init_base64_tests()
+			|| init_password_cache_tests()
 #endif
 			|| init_file_tests()
 			|| init_property_add_tests()